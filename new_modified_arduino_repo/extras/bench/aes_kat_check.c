@@ -0,0 +1,397 @@
+/*!
+ * \file      aes_kat_check.c
+ *
+ * \brief     Known answer check of the AES and AES-CMAC implementations
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs the FIPS-197 vectors (appendix B and C.1 to C.3, 128, 192
+ *            and 256 bit keys) through lora_aes_encrypt, in place and not,
+ *            lora_aes_ecb_encrypt, lora_aes_cbc_encrypt and
+ *            lora_aes_multi_encrypt with mixed key lengths, and the RFC 4493
+ *            vectors (subkeys and examples 1 to 4) through AES_CMAC_Update
+ *            in one call, byte by byte and split at every offset.
+ *
+ *            The AES implementation is chosen at build time, the check
+ *            reports which one it runs: the byte implementation by default,
+ *            the T-table one with -DAES_ENC_TTABLE, the 1 KB T-table one
+ *            with -DAES_ENC_TTABLE_COMPACT. Without -DAES_NO_HW_ACCEL on an
+ *            x86 host with AES-NI, the vectors run once on the portable code
+ *            and once on AES-NI (lora_aes_use_hw_accel), then random keys of
+ *            each length, ECB, CBC, mixed key multi blocks and CMAC messages
+ *            are compared between both. The results are written to stdout
+ *            as JSON, the exit code is 1 if a vector or comparison fails.
+ *
+ *            Build from the repository root, once per implementation:
+ *
+ *            cc -O2 -DAES_NO_HW_ACCEL -Isystem -Isystem/crypto -Iradio -Imac \
+ *               extras/bench/aes_kat_check.c system/crypto/aes.c \
+ *               system/crypto/aes_hw.c system/crypto/cmac.c \
+ *               system/utilities.c -o aes_kat_check
+ *
+ *            cc -O2 -DAES_NO_HW_ACCEL -DAES_ENC_TTABLE ... -o aes_kat_check_ttable
+ *            cc -O2 -DAES_NO_HW_ACCEL -DAES_ENC_TTABLE_COMPACT ... -o aes_kat_check_compact
+ *            cc -O2 -DAES_ENC_TTABLE ... -o aes_kat_check_aesni
+ *
+ *            Usage: aes_kat_check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "aes.h"
+#include "cmac.h"
+#if defined(AES_HW_ACCEL)
+#include "aes_hw.h"
+#endif
+
+#define NB_COPIES 7
+
+// Random comparisons between AES-NI and the portable code
+#define NB_RANDOM_ROUNDS 200
+#define NB_RANDOM_BLOCKS 13
+
+/*!
+ * FIPS-197 example vector
+ */
+typedef struct sAesVector
+{
+	const char *Name;
+	const char *Key;
+	const char *Plain;
+	const char *Cipher;
+} AesVector_t;
+
+/*!
+ * RFC 4493 example
+ */
+typedef struct sCmacVector
+{
+	const char *Name;
+	uint8_t Length;
+	const char *Mac;
+} CmacVector_t;
+
+static const AesVector_t AesVectors[] = {
+	{"fips197_b", "2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734", "3925841d02dc09fbdc118597196a0b32"},
+	{"fips197_c1", "000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a"},
+	{"fips197_c2", "000102030405060708090a0b0c0d0e0f1011121314151617", "00112233445566778899aabbccddeeff",
+	 "dda97ca4864cdfe06eaf70a0ec0d7191"},
+	{"fips197_c3", "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", "00112233445566778899aabbccddeeff",
+	 "8ea2b7ca516745bfeafc49904b496089"},
+};
+
+#define NB_AES_VECTORS (sizeof(AesVectors) / sizeof(AesVectors[0]))
+
+static const char CmacKey[] = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char CmacK1[] = "fbeed618357133667c85e08f7236a8de";
+static const char CmacK2[] = "f7ddac306ae266ccf90bc11ee46d513b";
+static const char CmacMessage[] = "6bc1bee22e409f96e93d7e117393172a"
+								  "ae2d8a571e03ac9c9eb76fac45af8e51"
+								  "30c81c46a35ce411e5fbc1191a0a52ef"
+								  "f69f2445df4f9b17ad2b417be66c3710";
+
+static const CmacVector_t CmacVectors[] = {
+	{"rfc4493_1", 0, "bb1d6929e95937287fa37d129b756746"},
+	{"rfc4493_2", 16, "070a16b46b4d4144f79bdd9dd04a287c"},
+	{"rfc4493_3", 40, "dfa66747de9ae63030ca32611497c827"},
+	{"rfc4493_4", 64, "51f0bebf7e3b9d92fc49741779363cfe"},
+};
+
+#define NB_CMAC_VECTORS (sizeof(CmacVectors) / sizeof(CmacVectors[0]))
+
+static bool FirstResult = true;
+static uint32_t Failures;
+static const char *Path = "portable";
+
+static uint8_t Hex(const char *hex, uint8_t *out)
+{
+	uint8_t size = 0;
+
+	while ((hex[0] != '\0') && (hex[1] != '\0'))
+	{
+		unsigned int byte;
+
+		sscanf(hex, "%2x", &byte);
+		out[size++] = byte;
+		hex += 2;
+	}
+	return size;
+}
+
+static void Report(const char *name, bool ok)
+{
+	printf("%s\n    {\"case\": \"%s\", \"path\": \"%s\", \"ok\": %s}", (FirstResult == true) ? "" : ",", name, Path,
+		   (ok == true) ? "true" : "false");
+	FirstResult = false;
+	if (ok == false)
+	{
+		Failures++;
+	}
+}
+
+static void SetKey(const AesVector_t *vector, lora_aes_context *ctx)
+{
+	uint8_t key[32];
+	uint8_t size = Hex(vector->Key, key);
+
+	memset(ctx, 0, sizeof(lora_aes_context));
+	lora_aes_set_key(key, size, ctx);
+}
+
+/*!
+ * \brief Single block, ECB, CBC with a zero IV and in place encryption of a
+ *        FIPS-197 vector
+ */
+static bool CheckAes(const AesVector_t *vector)
+{
+	lora_aes_context ctx;
+	uint8_t plain[N_BLOCK];
+	uint8_t cipher[N_BLOCK];
+	uint8_t out[N_BLOCK];
+	uint8_t blocks[NB_COPIES * N_BLOCK];
+	uint8_t iv[N_BLOCK];
+	bool ok = true;
+
+	SetKey(vector, &ctx);
+	Hex(vector->Plain, plain);
+	Hex(vector->Cipher, cipher);
+
+	ok = ok && (lora_aes_encrypt(plain, out, &ctx) == 0) && (memcmp(out, cipher, N_BLOCK) == 0);
+	memcpy(out, plain, N_BLOCK);
+	ok = ok && (lora_aes_encrypt(out, out, &ctx) == 0) && (memcmp(out, cipher, N_BLOCK) == 0);
+
+	// Enough blocks for the interleaved groups and a tail
+	for (uint8_t i = 0; i < NB_COPIES; i++)
+	{
+		memcpy(blocks + i * N_BLOCK, plain, N_BLOCK);
+	}
+	ok = ok && (lora_aes_ecb_encrypt(blocks, blocks, NB_COPIES, &ctx) == 0);
+	for (uint8_t i = 0; i < NB_COPIES; i++)
+	{
+		ok = ok && (memcmp(blocks + i * N_BLOCK, cipher, N_BLOCK) == 0);
+	}
+
+	memset(iv, 0, sizeof(iv));
+	ok = ok && (lora_aes_cbc_encrypt(plain, out, 1, iv, &ctx) == 0) && (memcmp(out, cipher, N_BLOCK) == 0) &&
+		 (memcmp(iv, cipher, N_BLOCK) == 0);
+	return ok;
+}
+
+/*!
+ * \brief All vectors in one lora_aes_multi_encrypt call, twice over, so the
+ *        key lengths differ inside the interleaved groups
+ */
+static bool CheckMulti(void)
+{
+	lora_aes_context ctxs[NB_AES_VECTORS];
+	const lora_aes_context *ctx[2 * NB_AES_VECTORS];
+	uint8_t blocks[2 * NB_AES_VECTORS * N_BLOCK];
+	uint8_t cipher[N_BLOCK];
+	bool ok = true;
+
+	for (uint8_t i = 0; i < 2 * NB_AES_VECTORS; i++)
+	{
+		const AesVector_t *vector = &AesVectors[i % NB_AES_VECTORS];
+
+		if (i < NB_AES_VECTORS)
+		{
+			SetKey(vector, &ctxs[i]);
+		}
+		ctx[i] = &ctxs[i % NB_AES_VECTORS];
+		Hex(vector->Plain, blocks + i * N_BLOCK);
+	}
+	ok = lora_aes_multi_encrypt(blocks, 2 * NB_AES_VECTORS, ctx) == 0;
+	for (uint8_t i = 0; i < 2 * NB_AES_VECTORS; i++)
+	{
+		Hex(AesVectors[i % NB_AES_VECTORS].Cipher, cipher);
+		ok = ok && (memcmp(blocks + i * N_BLOCK, cipher, N_BLOCK) == 0);
+	}
+	return ok;
+}
+
+static bool CheckCmacSubkeys(void)
+{
+	AES_CMAC_CTX ctx;
+	uint8_t key[16];
+	uint8_t k1[16];
+	uint8_t k2[16];
+
+	Hex(CmacKey, key);
+	Hex(CmacK1, k1);
+	Hex(CmacK2, k2);
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, key);
+	return (memcmp(ctx.K1, k1, 16) == 0) && (memcmp(ctx.K2, k2, 16) == 0);
+}
+
+/*!
+ * \brief A RFC 4493 example in one update, byte by byte and in two updates
+ *        split at every offset
+ */
+static bool CheckCmac(const CmacVector_t *vector)
+{
+	AES_CMAC_CTX ctx;
+	uint8_t key[16];
+	uint8_t message[64];
+	uint8_t mac[16];
+	uint8_t digest[16];
+	bool ok = true;
+
+	Hex(CmacKey, key);
+	Hex(CmacMessage, message);
+	Hex(vector->Mac, mac);
+	AES_CMAC_Init(&ctx);
+	AES_CMAC_SetKey(&ctx, key);
+
+	AES_CMAC_Update(&ctx, message, vector->Length);
+	AES_CMAC_Final(digest, &ctx);
+	ok = ok && (memcmp(digest, mac, 16) == 0);
+
+	AES_CMAC_Reset(&ctx);
+	for (uint8_t i = 0; i < vector->Length; i++)
+	{
+		AES_CMAC_Update(&ctx, message + i, 1);
+	}
+	AES_CMAC_Final(digest, &ctx);
+	ok = ok && (memcmp(digest, mac, 16) == 0);
+
+	for (uint8_t split = 0; split <= vector->Length; split++)
+	{
+		AES_CMAC_Reset(&ctx);
+		AES_CMAC_Update(&ctx, message, split);
+		AES_CMAC_Update(&ctx, message + split, vector->Length - split);
+		AES_CMAC_Final(digest, &ctx);
+		ok = ok && (memcmp(digest, mac, 16) == 0);
+	}
+	return ok;
+}
+
+static void RunVectors(void)
+{
+	for (uint8_t i = 0; i < NB_AES_VECTORS; i++)
+	{
+		Report(AesVectors[i].Name, CheckAes(&AesVectors[i]));
+	}
+	Report("fips197_multi", CheckMulti());
+	Report("rfc4493_subkeys", CheckCmacSubkeys());
+	for (uint8_t i = 0; i < NB_CMAC_VECTORS; i++)
+	{
+		Report(CmacVectors[i].Name, CheckCmac(&CmacVectors[i]));
+	}
+}
+
+#if defined(AES_HW_ACCEL)
+/*!
+ * Output of one random round, computed once per path
+ */
+typedef struct sRandomOutput
+{
+	uint8_t Ecb[NB_RANDOM_BLOCKS * N_BLOCK];
+	uint8_t Cbc[NB_RANDOM_BLOCKS * N_BLOCK];
+	uint8_t CbcIv[N_BLOCK];
+	uint8_t Multi[NB_RANDOM_BLOCKS * N_BLOCK];
+	uint8_t Cmac[16];
+} RandomOutput_t;
+
+static void RunRandom(const lora_aes_context ctxs[3], const uint8_t *data, uint16_t cmacSize, RandomOutput_t *out)
+{
+	const lora_aes_context *ctx[NB_RANDOM_BLOCKS];
+	AES_CMAC_CTX cmac;
+
+	// Key length of the round, 128, 192 or 256 bit, for ECB and CBC
+	lora_aes_ecb_encrypt(data, out->Ecb, NB_RANDOM_BLOCKS, &ctxs[0]);
+	memset(out->CbcIv, 0, N_BLOCK);
+	lora_aes_cbc_encrypt(data, out->Cbc, NB_RANDOM_BLOCKS, out->CbcIv, &ctxs[0]);
+
+	for (uint8_t i = 0; i < NB_RANDOM_BLOCKS; i++)
+	{
+		ctx[i] = &ctxs[(i * 7) % 3];
+	}
+	memcpy(out->Multi, data, sizeof(out->Multi));
+	lora_aes_multi_encrypt(out->Multi, NB_RANDOM_BLOCKS, ctx);
+
+	AES_CMAC_Init(&cmac);
+	AES_CMAC_SetKey(&cmac, data);
+	AES_CMAC_Update(&cmac, data, cmacSize);
+	AES_CMAC_Final(out->Cmac, &cmac);
+}
+
+/*!
+ * \brief Random keys and data through AES-NI and the portable code
+ */
+static bool CheckRandom(void)
+{
+	static const uint8_t keySizes[] = {16, 24, 32};
+	lora_aes_context ctxs[3];
+	uint8_t key[32];
+	uint8_t data[NB_RANDOM_BLOCKS * N_BLOCK];
+	RandomOutput_t portable;
+	RandomOutput_t aesni;
+	bool ok = true;
+
+	srand(1);
+	for (uint16_t round = 0; round < NB_RANDOM_ROUNDS; round++)
+	{
+		for (uint8_t i = 0; i < 3; i++)
+		{
+			for (uint8_t j = 0; j < sizeof(key); j++)
+			{
+				key[j] = rand();
+			}
+			memset(&ctxs[i], 0, sizeof(lora_aes_context));
+			lora_aes_set_key(key, keySizes[(round + i) % 3], &ctxs[i]);
+		}
+		for (uint16_t j = 0; j < sizeof(data); j++)
+		{
+			data[j] = rand();
+		}
+
+		lora_aes_use_hw_accel(0);
+		RunRandom(ctxs, data, round % (sizeof(data) + 1), &portable);
+		lora_aes_use_hw_accel(1);
+		RunRandom(ctxs, data, round % (sizeof(data) + 1), &aesni);
+		ok = ok && (memcmp(&portable, &aesni, sizeof(RandomOutput_t)) == 0);
+	}
+	return ok;
+}
+#endif
+
+int main(void)
+{
+#if defined(AES_ENC_TTABLE_COMPACT)
+	const char *impl = "ttable_compact";
+#elif defined(AES_ENC_TTABLE)
+	const char *impl = "ttable";
+#else
+	const char *impl = "byte";
+#endif
+
+#if defined(AES_HW_ACCEL)
+	bool aesni = lora_aes_hw_available() == 1;
+#else
+	bool aesni = false;
+#endif
+
+	printf("{\n  \"check\": \"aes_kat\",\n  \"aes\": \"%s\",\n  \"aesni\": %s,\n  \"results\": [", impl,
+		   (aesni == true) ? "true" : "false");
+#if defined(AES_HW_ACCEL)
+	lora_aes_use_hw_accel(0);
+#endif
+	RunVectors();
+#if defined(AES_HW_ACCEL)
+	if (aesni == true)
+	{
+		Path = "aesni";
+		lora_aes_use_hw_accel(1);
+		RunVectors();
+		Path = "aesni_vs_portable";
+		Report("random", CheckRandom());
+	}
+#endif
+	printf("\n  ],\n  \"failures\": %u\n}\n", Failures);
+
+	return (Failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,417 @@
+/*!
+ * \file      airtime_ledger_check.c
+ *
+ * \brief     Host check and benchmark of the airtime ledger of the MAC
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs random sequences of uplinks of random time on air on the 5
+ *            EU868 bands, with random time steps, and keeps the exact list of
+ *            the uplinks next to the ledger. After each step the consumed
+ *            airtime of every band must be at least the exact airtime of the
+ *            last hour and at most the one of the last hour and a slot. The
+ *            delay of LoRaMacAirtimeGetWindowDelay for a random frame must be
+ *            the first time the frame fits in the budget of the ledger, and
+ *            at that time the exact airtime of the last hour plus the frame
+ *            must fit in the budget too.
+ *
+ *            Back to back uplinks are then requested right after the last
+ *            TxDone, with the duty cycle of DutyCycleReq changed at random
+ *            between them, and sent once the aggregated time off allows. The
+ *            delay of LoRaMacAirtimeGetNextTx, given the aggregated time off
+ *            as the MAC passes it, must be the one the ScheduleTx of the MAC
+ *            applies: CalculateBackOff adds the time off of the last uplink
+ *            to the accumulated one, the region clears it once it has
+ *            elapsed. Then times LoRaMacAirtimeTxDone and
+ *            LoRaMacAirtimeGetNextTx on the EU868 channels, in ns per call
+ *            (best of several runs). The results are written to stdout as
+ *            JSON, the exit code is 1 on a mismatch.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/airtime_ledger_check.c mac/LoRaMacAirtime.c \
+ *               mac/region/RegionCommon.c radio/sx126x/radio_toa.c \
+ *               system/utilities.c -o airtime_ledger_check
+ *
+ *            Usage: airtime_ledger_check [calls]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "utilities.h"
+#include "radio.h"
+#include "Region.h"
+#include "RegionCommon.h"
+#include "RegionEU868.h"
+#include "LoRaMacAirtime.h"
+
+#define NB_BANDS 5
+#define NB_CHANNELS 8
+#define NB_RUNS 5
+#define NB_STEPS 100000
+#define NB_BACK_TO_BACK 10000
+#define MAX_FRAMES 4096
+
+/*!
+ * Uplink of the exact list
+ */
+typedef struct sFrame
+{
+	uint8_t Band;
+	TimerTime_t TxDoneTime;
+	TimerTime_t TimeOnAir;
+} Frame_t;
+
+static Band_t Bands[NB_BANDS] = {
+	EU868_BAND0,
+	EU868_BAND1,
+	EU868_BAND2,
+	EU868_BAND3,
+	EU868_BAND4,
+};
+
+/*!
+ * Channel n is in band n, 3 more channels in band 1
+ */
+static ChannelParams_t Channels[NB_CHANNELS];
+static uint16_t ChannelsMask[1] = {0xFF};
+
+/*!
+ * Aggregated time off state of the MAC
+ */
+typedef struct sMacModel
+{
+	uint8_t MaxDCycle;
+	TimerTime_t AggregatedTimeOff;
+	TimerTime_t AggregatedLastTxDoneTime;
+	TimerTime_t TxTimeOnAir;
+} MacModel_t;
+
+static LoRaMacAirtime_t Airtime;
+static Frame_t Frames[MAX_FRAMES];
+static uint32_t NbFrames;
+
+static TimerTime_t Now;
+static volatile uint32_t Sink;
+
+const struct Radio_s Radio;
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t past)
+{
+	return Now - past;
+}
+
+static void Reset(void)
+{
+	for (uint8_t i = 0; i < NB_CHANNELS; i++)
+	{
+		Channels[i].Frequency = 868100000 + i * 200000;
+		Channels[i].DrRange.Value = (DR_5 << 4) | DR_0;
+		Channels[i].Band = (i < NB_BANDS) ? i : 1;
+	}
+	LoRaMacAirtimeInit(&Airtime, Now);
+	NbFrames = 0;
+}
+
+static void Uplink(uint8_t channel, TimerTime_t timeOnAir)
+{
+	LoRaMacAirtimeTxDoneParams_t txDone;
+
+	txDone.Channels = Channels;
+	txDone.Bands = Bands;
+	txDone.Channel = channel;
+	txDone.Joined = true;
+	txDone.DutyCycleEnabled = true;
+	txDone.LastTxIsJoinRequest = false;
+	txDone.ElapsedTime = 0;
+	txDone.TxDoneTime = Now;
+	txDone.TxTimeOnAir = timeOnAir;
+	LoRaMacAirtimeTxDone(&Airtime, &txDone);
+
+	// Drop the frames older than the window and a slot, keep the others
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < NbFrames; i++)
+	{
+		if ((Now - Frames[i].TxDoneTime) < (LORAMAC_AIRTIME_WINDOW + LORAMAC_AIRTIME_SLOT_LENGTH))
+		{
+			Frames[kept++] = Frames[i];
+		}
+	}
+	NbFrames = kept;
+	if (NbFrames < MAX_FRAMES)
+	{
+		Frames[NbFrames].Band = Channels[channel].Band;
+		Frames[NbFrames].TxDoneTime = Now;
+		Frames[NbFrames].TimeOnAir = timeOnAir;
+		NbFrames++;
+	}
+}
+
+/*!
+ * \brief Exact airtime of a band over the given length before the time
+ */
+static TimerTime_t ExactConsumed(uint8_t band, TimerTime_t now, TimerTime_t length)
+{
+	TimerTime_t consumed = 0;
+
+	for (uint32_t i = 0; i < NbFrames; i++)
+	{
+		if ((Frames[i].Band == band) && ((now - Frames[i].TxDoneTime) < length))
+		{
+			consumed += Frames[i].TimeOnAir;
+		}
+	}
+	return consumed;
+}
+
+static uint32_t CheckDelay(uint8_t band)
+{
+	LoRaMacAirtime_t copy;
+	TimerTime_t budget = LoRaMacAirtimeGetBudget(&Bands[band], true, 0);
+	TimerTime_t timeOnAir = 20 + rand() % 3000;
+	TimerTime_t delay = LoRaMacAirtimeGetWindowDelay(&Airtime, band, budget, timeOnAir, Now);
+	uint32_t nbMismatches = 0;
+
+	if (delay == LORAMAC_AIRTIME_NO_TX)
+	{
+		return (timeOnAir > budget) ? 0 : 1;
+	}
+	// Fits at the delay, in the ledger and exactly
+	copy = Airtime;
+	if ((LoRaMacAirtimeGetConsumed(&copy, band, Now + delay) + timeOnAir) > budget)
+	{
+		nbMismatches++;
+	}
+	if ((ExactConsumed(band, Now + delay, LORAMAC_AIRTIME_WINDOW) + timeOnAir) > budget)
+	{
+		nbMismatches++;
+	}
+	// Does not fit a ms before
+	copy = Airtime;
+	if ((delay > 0) && ((LoRaMacAirtimeGetConsumed(&copy, band, Now + delay - 1) + timeOnAir) <= budget))
+	{
+		nbMismatches++;
+	}
+	return nbMismatches;
+}
+
+static uint32_t Check(void)
+{
+	uint32_t nbMismatches = 0;
+
+	Now = (TimerTime_t)(-7200000);
+	Reset();
+	for (uint32_t i = 0; i < NB_STEPS; i++)
+	{
+		uint8_t event = rand() % 16;
+
+		if (event < 6)
+		{
+			// Bursts up to several times the budget of the 0.1 % bands
+			Uplink(rand() % NB_CHANNELS, 20 + rand() % 3000);
+		}
+		else if (event < 15)
+		{
+			Now += rand() % 120000;
+		}
+		else
+		{
+			Now += rand() % (2 * LORAMAC_AIRTIME_WINDOW);
+		}
+
+		for (uint8_t band = 0; band < NB_BANDS; band++)
+		{
+			TimerTime_t consumed = LoRaMacAirtimeGetConsumed(&Airtime, band, Now);
+
+			if ((consumed < ExactConsumed(band, Now, LORAMAC_AIRTIME_WINDOW)) ||
+				(consumed > ExactConsumed(band, Now, LORAMAC_AIRTIME_WINDOW + LORAMAC_AIRTIME_SLOT_LENGTH)))
+			{
+				nbMismatches++;
+			}
+		}
+		nbMismatches += CheckDelay(rand() % NB_BANDS);
+	}
+	return nbMismatches;
+}
+
+/*!
+ * \brief Applies the aggregated time off like ScheduleTx, CalculateBackOff
+ *        and RegionNextChannel of the MAC
+ *
+ * \retval Delay before the uplink, 0 if it is sent
+ */
+static TimerTime_t MacScheduleTx(MacModel_t *mac)
+{
+	TimerTime_t elapsed = Now - mac->AggregatedLastTxDoneTime;
+
+	if (mac->MaxDCycle == 0)
+	{
+		mac->AggregatedTimeOff = 0;
+	}
+	mac->AggregatedTimeOff += mac->TxTimeOnAir * (1 << mac->MaxDCycle) - mac->TxTimeOnAir;
+	if (mac->AggregatedTimeOff <= elapsed)
+	{
+		mac->AggregatedTimeOff = 0;
+		return 0;
+	}
+	return mac->AggregatedTimeOff - elapsed;
+}
+
+/*!
+ * \brief Gets the delay of the ledger, with the aggregated time off the MAC
+ *        passes in GetAirtimeChannels
+ */
+static TimerTime_t GetNextTx(const MacModel_t *mac)
+{
+	LoRaMacAirtimeNextTxParams_t params;
+
+	params.Channels = Channels;
+	params.Bands = Bands;
+	params.ChannelsMask = ChannelsMask;
+	params.NbChannels = NB_CHANNELS;
+	params.Datarate = DR_0;
+	params.TimeOnAir = 50;
+	// Only the aggregated time off applies
+	params.Joined = true;
+	params.DutyCycleEnabled = false;
+	params.ElapsedTime = 0;
+	params.AggregatedLastTxDoneTime = mac->AggregatedLastTxDoneTime;
+	params.AggregatedTimeOff = (mac->MaxDCycle == 0) ? 0 : mac->AggregatedTimeOff;
+	params.AggregatedTimeOff += mac->TxTimeOnAir * (1 << mac->MaxDCycle) - mac->TxTimeOnAir;
+	return LoRaMacAirtimeGetNextTx(&Airtime, &params, Now);
+}
+
+static uint32_t CheckBackToBack(void)
+{
+	MacModel_t mac = {0, 0, 0, 0};
+	uint32_t nbMismatches = 0;
+
+	Now = 1000;
+	Reset();
+	for (uint32_t i = 0; i < NB_BACK_TO_BACK; i++)
+	{
+		TimerTime_t delay;
+		MacModel_t early;
+
+		// Uplink requested right after the last one. If it is delayed, the
+		// MAC keeps the time off accumulated by its ScheduleTx.
+		if (MacScheduleTx(&mac) != 0)
+		{
+			// Not sent a ms before the delay, nor kept
+			delay = GetNextTx(&mac);
+			early = mac;
+			Now += delay - 1;
+			if ((delay == 0) || (MacScheduleTx(&early) != 1))
+			{
+				nbMismatches++;
+			}
+			Now++;
+			// Sent at the delay
+			if (MacScheduleTx(&mac) != 0)
+			{
+				nbMismatches++;
+			}
+		}
+
+		mac.TxTimeOnAir = 20 + rand() % 3000;
+		Now += mac.TxTimeOnAir;
+		mac.AggregatedLastTxDoneTime = Now;
+		Uplink(rand() % NB_CHANNELS, mac.TxTimeOnAir);
+		NbFrames = 0;
+
+		// DutyCycleReq in the downlink of the uplink
+		if ((rand() % 4) == 0)
+		{
+			mac.MaxDCycle = rand() % 8;
+		}
+		Now += rand() % 3000;
+	}
+	return nbMismatches;
+}
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double Bench(uint32_t nbCalls, bool nextTx)
+{
+	LoRaMacAirtimeNextTxParams_t params;
+	double best = 0;
+
+	params.Channels = Channels;
+	params.Bands = Bands;
+	params.ChannelsMask = ChannelsMask;
+	params.NbChannels = NB_CHANNELS;
+	params.Datarate = DR_0;
+	params.TimeOnAir = 1500;
+	params.Joined = true;
+	params.DutyCycleEnabled = true;
+	params.ElapsedTime = 0;
+	params.AggregatedLastTxDoneTime = 0;
+	params.AggregatedTimeOff = 0;
+
+	for (uint8_t run = 0; run < NB_RUNS; run++)
+	{
+		uint64_t ns;
+		double runNs;
+
+		Now = 0;
+		Reset();
+		ns = NowNs();
+		for (uint32_t i = 0; i < nbCalls; i++)
+		{
+			// An uplink every 10 s
+			Now += 10000;
+			if (nextTx == true)
+			{
+				Sink += LoRaMacAirtimeGetNextTx(&Airtime, &params, Now);
+			}
+			else
+			{
+				LoRaMacAirtimeBand_t *band = &Airtime.Bands[1];
+
+				Sink += band->TimeOff;
+				Uplink(i % NB_CHANNELS, 50);
+				NbFrames = 0;
+			}
+		}
+		ns = NowNs() - ns;
+		runNs = (double)ns / nbCalls;
+		if ((run == 0) || (runNs < best))
+		{
+			best = runNs;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t nbCalls = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	uint32_t nbMismatches;
+	uint32_t nbBackToBackMismatches;
+	double txDoneNs, nextTxNs;
+
+	srand(1);
+	nbMismatches = Check();
+	nbBackToBackMismatches = CheckBackToBack();
+	txDoneNs = Bench(nbCalls, false);
+	nextTxNs = Bench(nbCalls, true);
+
+	printf("{\n  \"steps\": %u,\n  \"mismatches\": %u,\n  \"back_to_back_uplinks\": %u,\n  \"back_to_back_mismatches\": %u,\n"
+		   "  \"ledger_bytes\": %u,\n  \"calls\": %u,\n  \"tx_done_ns\": %.1f,\n  \"next_tx_ns\": %.1f\n}\n",
+		   NB_STEPS, nbMismatches, NB_BACK_TO_BACK, nbBackToBackMismatches, (unsigned)sizeof(LoRaMacAirtime_t), nbCalls,
+		   txDoneNs, nextTxNs);
+	return ((nbMismatches == 0) && (nbBackToBackMismatches == 0)) ? 0 : 1;
+}
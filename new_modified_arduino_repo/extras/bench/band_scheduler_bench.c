@@ -0,0 +1,241 @@
+/*!
+ * \file      band_scheduler_bench.c
+ *
+ * \brief     Host check and benchmark of the band scheduler of RegionCommon
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs random sequences of uplinks, join state and duty cycle
+ *            changes and time steps, some of them exactly to the next
+ *            release, on two copies of the 5 EU868 bands. One copy is
+ *            released by RegionCommonUpdateBandTimeOff, the other one by
+ *            RegionCommonBandSchedulerRelease: after each step both must
+ *            have the same time off in every band and give the same delay to
+ *            the next release. RegionCommonBandSchedulerNextRelease is
+ *            checked against the smallest delay of a random set of bands.
+ *            Then times both releases with 2 bands under time off, in ns per
+ *            call (best of several runs). The results are written to stdout
+ *            as JSON, the exit code is 1 on a mismatch.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/band_scheduler_bench.c mac/region/RegionCommon.c \
+ *               radio/sx126x/radio_toa.c system/utilities.c -o band_scheduler_bench
+ *
+ *            Usage: band_scheduler_bench [calls]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "utilities.h"
+#include "radio.h"
+#include "Region.h"
+#include "RegionCommon.h"
+#include "RegionEU868.h"
+
+#define NB_BANDS 5
+#define NB_RUNS 5
+#define NB_STEPS 200000
+
+static const Band_t DefaultBands[NB_BANDS] = {
+	EU868_BAND0,
+	EU868_BAND1,
+	EU868_BAND2,
+	EU868_BAND3,
+	EU868_BAND4,
+};
+
+/*!
+ * Channel n is in band n
+ */
+static ChannelParams_t Channels[NB_BANDS];
+
+static Band_t ScanBands[NB_BANDS];
+static Band_t IndexBands[NB_BANDS];
+static RegionCommonBandScheduler_t BandScheduler;
+
+static TimerTime_t Now;
+static volatile uint32_t Sink;
+
+const struct Radio_s Radio;
+
+TimerTime_t TimerGetCurrentTime(void)
+{
+	return Now;
+}
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t past)
+{
+	return Now - past;
+}
+
+static void Reset(void)
+{
+	memcpy(ScanBands, DefaultBands, sizeof(ScanBands));
+	memcpy(IndexBands, DefaultBands, sizeof(IndexBands));
+	RegionCommonBandSchedulerReset(&BandScheduler);
+	for (uint8_t i = 0; i < NB_BANDS; i++)
+	{
+		Channels[i].Band = i;
+	}
+}
+
+/*!
+ * \brief Uplink on a band, as OnRadioTxDone then the next ScheduleTx do it
+ */
+static void Uplink(uint8_t band, bool joined, bool dutyCycle, bool joinRequest, TimerTime_t timeOnAir)
+{
+	RegionCommonCalcBackOffParams_t calcBackOff;
+
+	RegionCommonSetBandTxDone(joined, &ScanBands[band], Now);
+	RegionCommonSetBandTxDone(joined, &IndexBands[band], Now);
+	RegionCommonBandSchedulerUpdateBand(&BandScheduler, IndexBands, band);
+
+	calcBackOff.Channels = Channels;
+	calcBackOff.LastTxIsJoinRequest = joinRequest;
+	calcBackOff.Joined = joined;
+	calcBackOff.DutyCycleEnabled = dutyCycle;
+	calcBackOff.Channel = band;
+	calcBackOff.ElapsedTime = Now;
+	calcBackOff.TxTimeOnAir = timeOnAir;
+	calcBackOff.Bands = ScanBands;
+	RegionCommonCalcBackOff(&calcBackOff);
+	calcBackOff.Bands = IndexBands;
+	RegionCommonCalcBackOff(&calcBackOff);
+	RegionCommonBandSchedulerUpdateBand(&BandScheduler, IndexBands, band);
+}
+
+static uint32_t Check(void)
+{
+	uint32_t nbMismatches = 0;
+	bool joined = false;
+	bool dutyCycle = true;
+	TimerTime_t scanDelay = (TimerTime_t)(-1);
+
+	Reset();
+	Now = (TimerTime_t)(-600000);
+	for (uint32_t i = 0; i < NB_STEPS; i++)
+	{
+		uint8_t event = rand() % 64;
+		TimerTime_t indexDelay;
+		Band_t bands[NB_BANDS];
+		uint8_t bandsMask = rand() % (1 << NB_BANDS);
+		TimerTime_t nextDelay = (TimerTime_t)(-1);
+
+		if (event == 0)
+		{
+			joined = !joined;
+		}
+		else if (event == 1)
+		{
+			dutyCycle = !dutyCycle;
+		}
+		else if (event < 24)
+		{
+			Uplink(rand() % NB_BANDS, joined, dutyCycle, (joined == false) && ((rand() % 2) == 0), 20 + rand() % 3000);
+		}
+		else if ((event < 40) && (scanDelay != (TimerTime_t)(-1)))
+		{
+			// Exactly at the next release
+			Now += scanDelay;
+		}
+		else
+		{
+			Now += rand() % 60000;
+		}
+
+		scanDelay = RegionCommonUpdateBandTimeOff(joined, dutyCycle, ScanBands, NB_BANDS);
+		indexDelay = RegionCommonBandSchedulerRelease(&BandScheduler, joined, dutyCycle, IndexBands, NB_BANDS, Now);
+		if ((scanDelay != indexDelay) || (memcmp(ScanBands, IndexBands, sizeof(ScanBands)) != 0))
+		{
+			nbMismatches++;
+			memcpy(IndexBands, ScanBands, sizeof(IndexBands));
+			RegionCommonBandSchedulerReset(&BandScheduler);
+			continue;
+		}
+
+		if ((joined == false) || (dutyCycle == true))
+		{
+			// Delay of each band on its own
+			memcpy(bands, ScanBands, sizeof(bands));
+			for (uint8_t band = 0; band < NB_BANDS; band++)
+			{
+				if ((bandsMask & (1 << band)) != 0)
+				{
+					nextDelay = T_MIN(nextDelay, RegionCommonUpdateBandTimeOff(joined, dutyCycle, &bands[band], 1));
+				}
+			}
+			if (RegionCommonBandSchedulerNextRelease(&BandScheduler, bandsMask, Now) != nextDelay)
+			{
+				nbMismatches++;
+			}
+		}
+	}
+	return nbMismatches;
+}
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double Bench(uint32_t nbCalls, bool scheduler)
+{
+	double best = 0;
+
+	Reset();
+	Now = 0;
+	Uplink(1, true, true, false, 1500);
+	Uplink(2, true, true, false, 1500);
+
+	for (uint8_t run = 0; run < NB_RUNS; run++)
+	{
+		uint64_t ns = NowNs();
+		double runNs;
+
+		for (uint32_t i = 0; i < nbCalls; i++)
+		{
+			Now = i % 1000;
+			if (scheduler == true)
+			{
+				Sink += RegionCommonBandSchedulerRelease(&BandScheduler, true, true, IndexBands, NB_BANDS, TimerGetCurrentTime());
+			}
+			else
+			{
+				Sink += RegionCommonUpdateBandTimeOff(true, true, ScanBands, NB_BANDS);
+			}
+		}
+		ns = NowNs() - ns;
+		runNs = (double)ns / nbCalls;
+		if ((run == 0) || (runNs < best))
+		{
+			best = runNs;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t nbCalls = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+	uint32_t nbMismatches;
+	double scanNs, schedulerNs;
+
+	srand(1);
+	nbMismatches = Check();
+	scanNs = Bench(nbCalls, false);
+	schedulerNs = Bench(nbCalls, true);
+
+	printf("{\n  \"steps\": %u,\n  \"mismatches\": %u,\n  \"calls\": %u,\n  \"scan_ns\": %.1f,\n  \"scheduler_ns\": %.1f\n}\n",
+		   NB_STEPS, nbMismatches, nbCalls, scanNs, schedulerNs);
+	return (nbMismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+/*!
+ * \file      channel_select_bench.c
+ *
+ * \brief     Host check and benchmark of the channel selection of the 72 and
+ *            96 channel regions
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Compares the channel bitmaps of RegionCommon
+ *            (RegionCommonChanBitmapsCount and RegionCommonChanFind) with the
+ *            channel by channel search the regions used before: for random
+ *            channels masks, datarates and band time off, both must give the
+ *            same number of channels, the same delay and the same channel for
+ *            each draw. Then times both searches, counting and drawing one
+ *            channel, in ns per selection (best of several runs). The results
+ *            are written to stdout as JSON, the exit code is 1 on a mismatch.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/channel_select_bench.c mac/region/RegionCommon.c \
+ *               radio/sx126x/radio_toa.c system/utilities.c -o channel_select_bench
+ *
+ *            Usage: channel_select_bench [selections]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "utilities.h"
+#include "radio.h"
+#include "Region.h"
+#include "RegionCommon.h"
+
+#define NB_RUNS 5
+#define NB_CHECKS 20000
+
+/*!
+ * Channel plan of the benchmark
+ */
+typedef struct sBenchPlan
+{
+	const char *Name;
+	uint8_t NbChannels;
+	uint8_t NbDatarates;
+} BenchPlan_t;
+
+static const BenchPlan_t BenchPlans[] = {
+	{"US915", 72, 5},
+	{"AU915", 72, 7},
+	{"CN470", 96, 6},
+};
+
+static ChannelParams_t Channels[96];
+static Band_t Bands[1];
+static RegionCommonChannelBitmaps_t ChannelBitmaps;
+
+static volatile uint32_t Sink;
+
+const struct Radio_s Radio;
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t past)
+{
+	(void)past;
+	return 0;
+}
+
+/*!
+ * \brief Channel by channel search, as the regions did before the bitmaps
+ */
+static uint8_t CountNbOfEnabledChannels(uint8_t nbChannels, uint8_t datarate, uint16_t *channelsMask, ChannelParams_t *channels, Band_t *bands, uint8_t *enabledChannels, uint8_t *delayTx)
+{
+	uint8_t nbEnabledChannels = 0;
+	uint8_t delayTransmission = 0;
+
+	for (uint8_t i = 0, k = 0; i < nbChannels; i += 16, k++)
+	{
+		for (uint8_t j = 0; j < 16; j++)
+		{
+			if ((channelsMask[k] & (1 << j)) != 0)
+			{
+				if (channels[i + j].Frequency == 0)
+				{
+					continue;
+				}
+				if (RegionCommonValueInRange(datarate, channels[i + j].DrRange.Fields.Min,
+											 channels[i + j].DrRange.Fields.Max) == false)
+				{
+					continue;
+				}
+				if (bands[channels[i + j].Band].TimeOff > 0)
+				{
+					delayTransmission++;
+					continue;
+				}
+				enabledChannels[nbEnabledChannels++] = i + j;
+			}
+		}
+	}
+
+	*delayTx = delayTransmission;
+	return nbEnabledChannels;
+}
+
+/*!
+ * \brief Sets up the channels of a plan, as the regions do: 125 kHz channels
+ *        up to the datarate before the last, then 500 kHz channels on the last
+ *        datarate for the 72 channel plans. Some channels are left undefined
+ *        to check the frequency test.
+ */
+static void InitPlan(const BenchPlan_t *plan)
+{
+	uint8_t nb125kHz = (plan->NbChannels == 72) ? 64 : plan->NbChannels;
+	uint8_t lastDr = plan->NbDatarates - 1;
+	uint8_t maxDr125kHz = (nb125kHz < plan->NbChannels) ? (lastDr - 1) : lastDr;
+
+	memset(Channels, 0, sizeof(Channels));
+	for (uint8_t i = 0; i < plan->NbChannels; i++)
+	{
+		Channels[i].Frequency = 470000000 + i * 200000;
+		Channels[i].DrRange.Value = (i < nb125kHz) ? ((maxDr125kHz << 4) | DR_0) : ((lastDr << 4) | lastDr);
+		Channels[i].Band = 0;
+	}
+	Channels[plan->NbChannels / 3].Frequency = 0;
+	RegionCommonChanBitmapsInit(&ChannelBitmaps, Channels, plan->NbChannels);
+}
+
+static void RandomMask(uint16_t *mask, uint8_t nbChannels)
+{
+	// Full, sparse or random masks
+	uint8_t kind = rand() % 4;
+
+	memset(mask, 0, 6 * sizeof(uint16_t));
+	for (uint8_t i = 0; i < nbChannels; i++)
+	{
+		bool active = (kind == 0) || ((kind == 1) && ((rand() % 16) == 0)) || ((kind >= 2) && ((rand() % 2) == 0));
+
+		if (active == true)
+		{
+			mask[i / 16] |= 1 << (i % 16);
+		}
+	}
+}
+
+static uint32_t CheckPlan(const BenchPlan_t *plan)
+{
+	uint32_t nbMismatches = 0;
+	uint16_t mask[6];
+	uint16_t enabledMask[6];
+	uint8_t enabledChannels[96];
+
+	for (uint32_t i = 0; i < NB_CHECKS; i++)
+	{
+		uint8_t datarate = rand() % (plan->NbDatarates + 1);
+		uint8_t delayRef, delay, nbRef, nb;
+
+		RandomMask(mask, plan->NbChannels);
+		Bands[0].TimeOff = ((rand() % 8) == 0) ? 1000 : 0;
+		nbRef = CountNbOfEnabledChannels(plan->NbChannels, datarate, mask, Channels, Bands, enabledChannels, &delayRef);
+		nb = RegionCommonChanBitmapsCount(&ChannelBitmaps, mask, 6, datarate, Bands, 1, enabledMask, &delay);
+		if ((nb != nbRef) || (delay != delayRef))
+		{
+			nbMismatches++;
+			continue;
+		}
+		for (uint8_t n = 0; n < nb; n++)
+		{
+			if (RegionCommonChanFind(enabledMask, 6, n) != enabledChannels[n])
+			{
+				nbMismatches++;
+			}
+		}
+		if (RegionCommonChanFind(enabledMask, 6, nb) != 0xFF)
+		{
+			nbMismatches++;
+		}
+	}
+	return nbMismatches;
+}
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double BenchPlan(const BenchPlan_t *plan, uint32_t nbSelections, bool bitmaps)
+{
+	uint16_t masks[16][6];
+	double best = 0;
+
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		RandomMask(masks[i], plan->NbChannels);
+	}
+	Bands[0].TimeOff = 0;
+
+	for (uint8_t run = 0; run < NB_RUNS; run++)
+	{
+		uint64_t ns = NowNs();
+		double runNs;
+
+		for (uint32_t i = 0; i < nbSelections; i++)
+		{
+			uint16_t *mask = masks[i % 16];
+			uint8_t datarate = (i / 16) % plan->NbDatarates;
+			uint8_t delayTx;
+			uint8_t nb;
+
+			if (bitmaps == true)
+			{
+				uint16_t enabledMask[6];
+
+				nb = RegionCommonChanBitmapsCount(&ChannelBitmaps, mask, 6, datarate, Bands, 1, enabledMask, &delayTx);
+				Sink += (nb > 0) ? RegionCommonChanFind(enabledMask, 6, i % nb) : delayTx;
+			}
+			else
+			{
+				uint8_t enabledChannels[96];
+
+				nb = CountNbOfEnabledChannels(plan->NbChannels, datarate, mask, Channels, Bands, enabledChannels, &delayTx);
+				Sink += (nb > 0) ? enabledChannels[i % nb] : delayTx;
+			}
+		}
+		ns = NowNs() - ns;
+		runNs = (double)ns / nbSelections;
+		if ((run == 0) || (runNs < best))
+		{
+			best = runNs;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t nbSelections = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	uint8_t nbPlans = sizeof(BenchPlans) / sizeof(BenchPlans[0]);
+	uint32_t nbMismatches = 0;
+
+	srand(1);
+	printf("{\n  \"selections\": %u,\n  \"bitmap_bytes\": %u,\n  \"plans\": [\n", nbSelections, (unsigned)sizeof(RegionCommonChannelBitmaps_t));
+	for (uint8_t p = 0; p < nbPlans; p++)
+	{
+		const BenchPlan_t *plan = &BenchPlans[p];
+		uint32_t mismatches;
+		double loopNs, bitmapNs;
+
+		InitPlan(plan);
+		mismatches = CheckPlan(plan);
+		loopNs = BenchPlan(plan, nbSelections, false);
+		bitmapNs = BenchPlan(plan, nbSelections, true);
+		nbMismatches += mismatches;
+		printf("    {\"plan\": \"%s\", \"checks\": %u, \"mismatches\": %u, \"loop_ns\": %.1f, \"bitmap_ns\": %.1f}%s\n",
+			   plan->Name, NB_CHECKS, mismatches, loopNs, bitmapNs, (p == (nbPlans - 1)) ? "" : ",");
+	}
+	printf("  ]\n}\n");
+	return (nbMismatches == 0) ? 0 : 1;
+}
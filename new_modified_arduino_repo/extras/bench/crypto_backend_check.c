@@ -0,0 +1,411 @@
+/*!
+ * \file      crypto_backend_check.c
+ *
+ * \brief     Host check of the crypto backends
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs the LoRaMac crypto functions over random frames and keys
+ *            without backend, with the software backend and with the mock
+ *            peripheral backend, and compares the results:
+ *
+ *            blocking  - ComputeMic, PayloadEncrypt, VerifyAndDecrypt,
+ *                        EncryptAndSign, also writing the frame over its
+ *                        input, JoinComputeMic, JoinDecrypt and
+ *                        JoinComputeSKeys
+ *            async     - ComputeMicAsync and PayloadEncryptAsync on the mock
+ *                        return LORAMAC_CRYPTO_PENDING, the callback reports
+ *                        the result and a second operation started
+ *                        meanwhile returns LORAMAC_CRYPTO_BUSY
+ *            failure   - a backend failing every operation makes the
+ *                        functions return its status, VerifyAndDecrypt
+ *                        reject the frame and clear the decrypted buffer,
+ *                        even if the MIC of the previous frame matches, and
+ *                        EncryptAndSign not write the MIC
+ *
+ *            The results are written to stdout as JSON. The exit code is 1
+ *            if a result differs.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -pthread -Isystem -Isystem/crypto -Iradio -Imac \
+ *               extras/bench/crypto_backend_check.c mac/LoRaMacCrypto.c \
+ *               mac/LoRaMacCryptoBackend.c mac/LoRaMacCryptoBackendMock.c \
+ *               system/crypto/aes.c system/crypto/aes_hw.c \
+ *               system/crypto/cmac.c system/utilities.c \
+ *               -o crypto_backend_check
+ *
+ *            Usage: crypto_backend_check [frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "LoRaMacCrypto.h"
+
+#if !defined(LORAMAC_CRYPTO_BACKEND_MOCK)
+#error "The check needs the mock backend (LORAMAC_CRYPTO_BACKEND_MOCK)"
+#endif
+
+/*!
+ * Largest frame size
+ */
+#define MAX_SIZE 255
+
+/*!
+ * Time the mock takes for the asynchronous MIC [us]
+ */
+#define BUSY_LATENCY 500
+
+typedef enum eCheck
+{
+	CHECK_MIC,
+	CHECK_ENCRYPT,
+	CHECK_VERIFY,
+	CHECK_ENCRYPT_AND_SIGN,
+	CHECK_JOIN_MIC,
+	CHECK_JOIN_DECRYPT,
+	CHECK_JOIN_SKEYS,
+	CHECK_ASYNC_MIC,
+	CHECK_ASYNC_ENCRYPT,
+	CHECK_ASYNC_BUSY,
+	CHECK_FAIL_STATUS,
+	CHECK_FAIL_VERIFY,
+	CHECK_FAIL_CLEAR,
+	CHECK_MAX,
+} Check_t;
+
+static const char *CheckNames[] = {"compute_mic", "payload_encrypt", "verify_and_decrypt", "encrypt_and_sign",
+								   "join_compute_mic",
+								   "join_decrypt", "join_compute_skeys", "async_compute_mic",
+								   "async_payload_encrypt", "async_busy", "failure_status", "failure_verify",
+								   "failure_clear"};
+
+static uint32_t Runs[CHECK_MAX];
+static uint32_t Failures[CHECK_MAX];
+
+/*!
+ * Contexts without backend, with the software, the mock and the failing
+ * backend
+ */
+static LoRaMacCryptoCtx_t RefCtx;
+static LoRaMacCryptoCtx_t SwCtx;
+static LoRaMacCryptoCtx_t MockCtx;
+static LoRaMacCryptoCtx_t BusyCtx;
+static LoRaMacCryptoCtx_t FailCtx;
+
+static pthread_mutex_t DoneLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t DoneCond = PTHREAD_COND_INITIALIZER;
+static bool DoneCalled;
+static LoRaMacCryptoStatus_t DoneStatus;
+
+/*!
+ * Frame written by EncryptAndSign
+ */
+static uint8_t Written[MAX_SIZE + 4];
+static uint16_t WrittenSize;
+
+static void Check(Check_t check, bool ok)
+{
+	Runs[check]++;
+	if (ok == false)
+	{
+		Failures[check]++;
+	}
+}
+
+static void RandomFill(uint8_t *buffer, uint16_t size)
+{
+	for (uint16_t i = 0; i < size; i++)
+	{
+		buffer[i] = rand();
+	}
+}
+
+static bool IsZero(const uint8_t *buffer, uint16_t size)
+{
+	for (uint16_t i = 0; i < size; i++)
+	{
+		if (buffer[i] != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static LoRaMacCryptoStatus_t FailEcb(const LoRaMacCryptoKey_t *key, const uint8_t *in, uint8_t *out, uint16_t nbBlocks, LoRaMacCryptoDone_t done, void *context)
+{
+	return LORAMAC_CRYPTO_ERROR;
+}
+
+static LoRaMacCryptoStatus_t FailCtr(const LoRaMacCryptoKey_t *key, const uint8_t counter[16], const uint8_t *in, uint8_t *out, uint16_t size, LoRaMacCryptoDone_t done, void *context)
+{
+	return LORAMAC_CRYPTO_ERROR;
+}
+
+static LoRaMacCryptoStatus_t FailCmac(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t mac[16], LoRaMacCryptoDone_t done, void *context)
+{
+	return LORAMAC_CRYPTO_ERROR;
+}
+
+static LoRaMacCryptoStatus_t FailCmacUpdate(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t chain[16], LoRaMacCryptoDone_t done, void *context)
+{
+	return LORAMAC_CRYPTO_ERROR;
+}
+
+/*!
+ * Backend of a peripheral that fails every operation
+ */
+static const LoRaMacCryptoBackend_t FailBackend = {"fail", FailEcb, FailCtr, FailCmac, FailCmacUpdate};
+
+static void Write(uint8_t offset, const uint8_t *data, uint8_t size)
+{
+	memcpy(Written + offset, data, size);
+	if (offset + size > WrittenSize)
+	{
+		WrittenSize = offset + size;
+	}
+}
+
+/*!
+ * \brief Encrypts and signs a frame, the first hdrSize bytes are the header
+ *
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t EncryptAndSign(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, const uint8_t *frame, uint16_t size, uint8_t hdrSize, uint32_t address, uint8_t dir, uint32_t fCnt, uint8_t *out)
+{
+	LoRaMacCryptoStatus_t status;
+
+	WrittenSize = 0;
+	status = LoRaMacCryptoCtxEncryptAndSign(ctx, frame, hdrSize, frame + hdrSize, size - hdrSize, key, key, address, dir, fCnt, Write);
+	memcpy(out, Written, WrittenSize);
+	return status;
+}
+
+/*!
+ * \brief Same as EncryptAndSign, the frame is written over its input
+ *
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t EncryptAndSignInPlace(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, const uint8_t *frame, uint16_t size, uint8_t hdrSize, uint32_t address, uint8_t dir, uint32_t fCnt, uint8_t *out)
+{
+	LoRaMacCryptoStatus_t status;
+
+	memcpy(Written, frame, size);
+	WrittenSize = 0;
+	status = LoRaMacCryptoCtxEncryptAndSign(ctx, Written, hdrSize, Written + hdrSize, size - hdrSize, key, key, address, dir, fCnt, Write);
+	memcpy(out, Written, WrittenSize);
+	return status;
+}
+
+static void OnDone(void *context, LoRaMacCryptoStatus_t status)
+{
+	pthread_mutex_lock(&DoneLock);
+	DoneStatus = status;
+	DoneCalled = true;
+	pthread_cond_broadcast(&DoneCond);
+	pthread_mutex_unlock(&DoneLock);
+}
+
+static LoRaMacCryptoStatus_t WaitDone(void)
+{
+	LoRaMacCryptoStatus_t status;
+
+	pthread_mutex_lock(&DoneLock);
+	while (DoneCalled == false)
+	{
+		pthread_cond_wait(&DoneCond, &DoneLock);
+	}
+	DoneCalled = false;
+	status = DoneStatus;
+	pthread_mutex_unlock(&DoneLock);
+	// Wait until the callback has returned
+	LoRaMacCryptoBackendMockWaitIdle();
+	return status;
+}
+
+/*!
+ * \brief Checks the blocking functions of a backend context against the
+ *        context without backend
+ */
+static void CheckBlocking(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, const uint8_t *frame, uint16_t size, uint32_t address, uint8_t dir, uint32_t fCnt)
+{
+	uint8_t refOut[MAX_SIZE + 4];
+	uint8_t out[MAX_SIZE + 4];
+	uint8_t refKeys[32];
+	uint8_t keys[32];
+	uint32_t refMic;
+	uint32_t mic;
+	uint8_t payloadIndex = (size > 8) ? 8 : 0;
+	bool ok;
+
+	LoRaMacCryptoCtxComputeMic(&RefCtx, frame, size, key, address, dir, fCnt, &refMic);
+	ok = LoRaMacCryptoCtxComputeMic(ctx, frame, size, key, address, dir, fCnt, &mic) == LORAMAC_CRYPTO_SUCCESS;
+	Check(CHECK_MIC, (ok == true) && (mic == refMic));
+
+	LoRaMacCryptoCtxPayloadEncrypt(&RefCtx, frame, size, key, address, dir, fCnt, refOut);
+	ok = LoRaMacCryptoCtxPayloadEncrypt(ctx, frame, size, key, address, dir, fCnt, out) == LORAMAC_CRYPTO_SUCCESS;
+	Check(CHECK_ENCRYPT, (ok == true) && (memcmp(out, refOut, size) == 0));
+
+	// The frame carries its own MIC, the FRMPayload starts at payloadIndex
+	LoRaMacCryptoCtxPayloadEncrypt(&RefCtx, frame + payloadIndex, size - payloadIndex, key, address, dir, fCnt, refOut);
+	ok = LoRaMacCryptoCtxVerifyAndDecrypt(ctx, frame, size, refMic, key, key, payloadIndex, address, dir, fCnt, out);
+	Check(CHECK_VERIFY, (ok == true) && (memcmp(out, refOut, size - payloadIndex) == 0));
+	ok = LoRaMacCryptoCtxVerifyAndDecrypt(ctx, frame, size, refMic ^ 1, key, key, payloadIndex, address, dir, fCnt, out);
+	Check(CHECK_VERIFY, (ok == false) && (IsZero(out, size - payloadIndex) == true));
+
+	if (size <= MAX_SIZE - 4)
+	{
+		EncryptAndSign(&RefCtx, key, frame, size, payloadIndex, address, dir, fCnt, refOut);
+		ok = EncryptAndSign(ctx, key, frame, size, payloadIndex, address, dir, fCnt, out) == LORAMAC_CRYPTO_SUCCESS;
+		Check(CHECK_ENCRYPT_AND_SIGN, (ok == true) && (WrittenSize == size + 4) && (memcmp(out, refOut, size + 4) == 0));
+		ok = EncryptAndSignInPlace(ctx, key, frame, size, payloadIndex, address, dir, fCnt, out) == LORAMAC_CRYPTO_SUCCESS;
+		Check(CHECK_ENCRYPT_AND_SIGN, (ok == true) && (WrittenSize == size + 4) && (memcmp(out, refOut, size + 4) == 0));
+		ok = EncryptAndSignInPlace(&RefCtx, key, frame, size, payloadIndex, address, dir, fCnt, out) == LORAMAC_CRYPTO_SUCCESS;
+		Check(CHECK_ENCRYPT_AND_SIGN, (ok == true) && (WrittenSize == size + 4) && (memcmp(out, refOut, size + 4) == 0));
+	}
+
+	LoRaMacCryptoCtxJoinComputeMic(&RefCtx, frame, size, key, &refMic);
+	ok = LoRaMacCryptoCtxJoinComputeMic(ctx, frame, size, key, &mic) == LORAMAC_CRYPTO_SUCCESS;
+	Check(CHECK_JOIN_MIC, (ok == true) && (mic == refMic));
+
+	LoRaMacCryptoCtxJoinDecrypt(&RefCtx, frame, 32, key, refOut);
+	ok = LoRaMacCryptoCtxJoinDecrypt(ctx, frame, 32, key, out) == LORAMAC_CRYPTO_SUCCESS;
+	Check(CHECK_JOIN_DECRYPT, (ok == true) && (memcmp(out, refOut, 32) == 0));
+
+	LoRaMacCryptoCtxJoinComputeSKeys(&RefCtx, key, frame, fCnt & 0xFFFF, refKeys, refKeys + 16);
+	ok = LoRaMacCryptoCtxJoinComputeSKeys(ctx, key, frame, fCnt & 0xFFFF, keys, keys + 16) == LORAMAC_CRYPTO_SUCCESS;
+	Check(CHECK_JOIN_SKEYS, (ok == true) && (memcmp(keys, refKeys, 32) == 0));
+}
+
+/*!
+ * \brief Checks the asynchronous functions of the mock backend
+ */
+static void CheckAsync(const uint8_t *key, const uint8_t *frame, uint16_t size, uint32_t address, uint8_t dir, uint32_t fCnt)
+{
+	uint8_t refOut[MAX_SIZE];
+	uint8_t out[MAX_SIZE];
+	uint32_t refMic;
+	uint32_t mic = 0;
+	uint32_t busyMic;
+	LoRaMacCryptoStatus_t status;
+
+	LoRaMacCryptoCtxComputeMic(&RefCtx, frame, size, key, address, dir, fCnt, &refMic);
+	// Long enough for the second operation to find the peripheral busy
+	LoRaMacCryptoBackendMockSetLatency(BUSY_LATENCY, 0);
+	status = LoRaMacCryptoCtxComputeMicAsync(&MockCtx, frame, size, key, address, dir, fCnt, &mic, OnDone, NULL);
+	LoRaMacCryptoBackendMockSetLatency(0, 0);
+	Check(CHECK_ASYNC_MIC, status == LORAMAC_CRYPTO_PENDING);
+	if (status == LORAMAC_CRYPTO_PENDING)
+	{
+		// The peripheral runs one operation at a time
+		status = LoRaMacCryptoCtxComputeMicAsync(&BusyCtx, frame, size, key, address, dir, fCnt, &busyMic, OnDone, NULL);
+		Check(CHECK_ASYNC_BUSY, status == LORAMAC_CRYPTO_BUSY);
+
+		status = WaitDone();
+		Check(CHECK_ASYNC_MIC, (status == LORAMAC_CRYPTO_SUCCESS) && (mic == refMic));
+	}
+
+	LoRaMacCryptoCtxPayloadEncrypt(&RefCtx, frame, size, key, address, dir, fCnt, refOut);
+	status = LoRaMacCryptoCtxPayloadEncryptAsync(&MockCtx, frame, size, key, address, dir, fCnt, out, OnDone, NULL);
+	Check(CHECK_ASYNC_ENCRYPT, status == LORAMAC_CRYPTO_PENDING);
+	if (status == LORAMAC_CRYPTO_PENDING)
+	{
+		status = WaitDone();
+		Check(CHECK_ASYNC_ENCRYPT, (status == LORAMAC_CRYPTO_SUCCESS) && (memcmp(out, refOut, size) == 0));
+	}
+}
+
+/*!
+ * \brief Checks that the failures of a backend are reported
+ */
+static void CheckFailure(const uint8_t *key, const uint8_t *frame, uint16_t size, uint32_t address, uint8_t dir, uint32_t fCnt)
+{
+	uint8_t out[MAX_SIZE];
+	uint8_t keys[32];
+	uint32_t refMic;
+	uint32_t mic;
+	uint8_t payloadIndex = (size > 8) ? 8 : 0;
+	bool ok;
+
+	// Leave the MIC of the frame in the context, as a working backend would
+	LoRaMacCryptoCtxSetBackend(&FailCtx, NULL);
+	LoRaMacCryptoCtxComputeMic(&FailCtx, frame, size, key, address, dir, fCnt, &refMic);
+	LoRaMacCryptoCtxSetBackend(&FailCtx, &FailBackend);
+
+	memset(out, 0xA5, sizeof(out));
+	ok = LoRaMacCryptoCtxVerifyAndDecrypt(&FailCtx, frame, size, refMic, key, key, payloadIndex, address, dir, fCnt, out);
+	Check(CHECK_FAIL_VERIFY, ok == false);
+	Check(CHECK_FAIL_CLEAR, IsZero(out, size - payloadIndex) == true);
+
+	Check(CHECK_FAIL_STATUS, LoRaMacCryptoCtxComputeMic(&FailCtx, frame, size, key, address, dir, fCnt, &mic) == LORAMAC_CRYPTO_ERROR);
+	Check(CHECK_FAIL_STATUS, LoRaMacCryptoCtxPayloadEncrypt(&FailCtx, frame, size, key, address, dir, fCnt, out) == LORAMAC_CRYPTO_ERROR);
+	Check(CHECK_FAIL_STATUS, LoRaMacCryptoCtxJoinComputeMic(&FailCtx, frame, size, key, &mic) == LORAMAC_CRYPTO_ERROR);
+	Check(CHECK_FAIL_STATUS, LoRaMacCryptoCtxJoinDecrypt(&FailCtx, frame, 32, key, out) == LORAMAC_CRYPTO_ERROR);
+	memset(keys, 0xA5, sizeof(keys));
+	ok = LoRaMacCryptoCtxJoinComputeSKeys(&FailCtx, key, frame, fCnt & 0xFFFF, keys, keys + 16) == LORAMAC_CRYPTO_ERROR;
+	Check(CHECK_FAIL_STATUS, (ok == true) && (keys[0] == 0xA5) && (keys[31] == 0xA5));
+	if (size <= MAX_SIZE - 4)
+	{
+		ok = EncryptAndSign(&FailCtx, key, frame, size, payloadIndex, address, dir, fCnt, out) == LORAMAC_CRYPTO_ERROR;
+		// The header may be written, the MIC never is
+		Check(CHECK_FAIL_STATUS, (ok == true) && (WrittenSize < size + 4));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t frames = (argc > 1) ? atoi(argv[1]) : 2000;
+	uint8_t keys[4][16];
+	uint8_t frame[MAX_SIZE];
+	uint32_t failures = 0;
+
+	if (frames == 0)
+	{
+		fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	RandomFill((uint8_t *)keys, sizeof(keys));
+
+	LoRaMacCryptoCtxInit(&RefCtx);
+	LoRaMacCryptoCtxInit(&SwCtx);
+	LoRaMacCryptoCtxInit(&MockCtx);
+	LoRaMacCryptoCtxInit(&BusyCtx);
+	LoRaMacCryptoCtxInit(&FailCtx);
+	LoRaMacCryptoCtxSetBackend(&SwCtx, &LoRaMacCryptoBackendSoftware);
+	LoRaMacCryptoCtxSetBackend(&MockCtx, &LoRaMacCryptoBackendMock);
+	LoRaMacCryptoCtxSetBackend(&BusyCtx, &LoRaMacCryptoBackendMock);
+	LoRaMacCryptoBackendMockSetLatency(0, 0);
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		uint16_t size = 1 + rand() % MAX_SIZE;
+		uint32_t address = rand();
+		uint8_t dir = rand() & 1;
+		uint32_t fCnt = rand();
+		const uint8_t *key = keys[rand() % 4];
+
+		RandomFill(frame, sizeof(frame));
+		CheckBlocking(&SwCtx, key, frame, size, address, dir, fCnt);
+		CheckBlocking(&MockCtx, key, frame, size, address, dir, fCnt);
+		CheckAsync(key, frame, size, address, dir, fCnt);
+		CheckFailure(key, frame, size, address, dir, fCnt);
+	}
+
+	printf("{\n  \"check\": \"crypto_backend\",\n  \"frames\": %u,\n  \"results\": [", frames);
+	for (Check_t check = CHECK_MIC; check < CHECK_MAX; check++)
+	{
+		printf("%s\n    {\"check\": \"%s\", \"runs\": %u, \"failures\": %u}", (check == CHECK_MIC) ? "" : ",",
+			   CheckNames[check], Runs[check], Failures[check]);
+		failures += Failures[check];
+	}
+	printf("\n  ],\n  \"failures\": %u\n}\n", failures);
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/*!
+ * \file      crypto_batch_bench.c
+ *
+ * \brief     Host benchmark of the batch frame MIC verification
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Verifies frames from many devices (each with its own NwkSKey)
+ *            with LoRaMacComputeMic one at a time, with
+ *            LoRaMacCryptoBatchVerify and with a worker pool, and reports
+ *            frames/second and frames/second per core.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -pthread -Isystem -Isystem/crypto -Iradio -Imac \
+ *               extras/bench/crypto_batch_bench.c mac/LoRaMacCrypto.c \
+ *               mac/LoRaMacCryptoBatch.c system/crypto/aes.c \
+ *               system/crypto/aes_hw.c system/crypto/cmac.c \
+ *               system/utilities.c -o crypto_batch_bench
+ *
+ *            Usage: crypto_batch_bench [frames] [devices] [threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cmac.h"
+#include "LoRaMacCrypto.h"
+#include "LoRaMacCryptoBatch.h"
+
+static double Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void Report(const char *name, uint32_t nbFrames, uint32_t nbValid, double seconds, uint32_t nbCores)
+{
+	printf("%-24s %10.0f frames/s %10.0f frames/s/core (%u valid)\n",
+		   name, nbFrames / seconds, nbFrames / seconds / nbCores, nbValid);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t nbFrames = (argc > 1) ? atoi(argv[1]) : 1000000;
+	uint32_t nbDevices = (argc > 2) ? atoi(argv[2]) : 10000;
+	uint32_t nbThreads = (argc > 3) ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+	uint8_t(*keys)[16] = malloc(nbDevices * 16);
+	AES_CMAC_CTX *cmacKeys = malloc(nbDevices * sizeof(AES_CMAC_CTX));
+	LoRaMacCryptoBatchFrame_t *frames = calloc(nbFrames, sizeof(LoRaMacCryptoBatchFrame_t));
+	uint8_t *buffers = malloc(nbFrames * 64);
+	uint32_t nbValid;
+	uint32_t mic;
+	double t;
+
+	srand(1);
+	for (uint32_t i = 0; i < nbDevices; i++)
+	{
+		for (uint8_t j = 0; j < 16; j++)
+		{
+			keys[i][j] = rand();
+		}
+		AES_CMAC_SetKey(&cmacKeys[i], keys[i]);
+	}
+
+	// Uplinks of 12 (empty) to 64 bytes, without the MIC
+	for (uint32_t i = 0; i < nbFrames; i++)
+	{
+		uint32_t device = rand() % nbDevices;
+		LoRaMacCryptoBatchFrame_t *frame = &frames[i];
+
+		frame->Buffer = &buffers[i * 64];
+		frame->Size = 12 + rand() % 53;
+		for (uint16_t j = 0; j < frame->Size; j++)
+		{
+			buffers[i * 64 + j] = rand();
+		}
+		frame->MicKey = &cmacKeys[device];
+		frame->Address = device;
+		frame->Dir = 0;
+		frame->SequenceCounter = rand();
+		LoRaMacComputeMic(frame->Buffer, frame->Size, keys[device], frame->Address, frame->Dir, frame->SequenceCounter, &frame->Mic);
+	}
+
+	t = Now();
+	nbValid = 0;
+	for (uint32_t i = 0; i < nbFrames; i++)
+	{
+		LoRaMacComputeMic(frames[i].Buffer, frames[i].Size, keys[frames[i].Address], frames[i].Address, frames[i].Dir, frames[i].SequenceCounter, &mic);
+		nbValid += (mic == frames[i].Mic);
+	}
+	Report("LoRaMacComputeMic", nbFrames, nbValid, Now() - t, 1);
+
+	t = Now();
+	nbValid = LoRaMacCryptoBatchVerify(frames, nbFrames);
+	Report("LoRaMacCryptoBatchVerify", nbFrames, nbValid, Now() - t, 1);
+
+#if defined(LORAMAC_CRYPTO_BATCH_POOL)
+	LoRaMacCryptoBatchPool_t *pool = LoRaMacCryptoBatchPoolCreate(nbThreads - 1);
+	char name[32];
+
+	if (pool != NULL)
+	{
+		t = Now();
+		nbValid = LoRaMacCryptoBatchPoolVerify(pool, frames, nbFrames);
+		snprintf(name, sizeof(name), "pool, %u threads", nbThreads);
+		Report(name, nbFrames, nbValid, Now() - t, nbThreads);
+		LoRaMacCryptoBatchPoolDestroy(pool);
+	}
+#endif
+
+	free(buffers);
+	free(frames);
+	free(cmacKeys);
+	free(keys);
+	return 0;
+}
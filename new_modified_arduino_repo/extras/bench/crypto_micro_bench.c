@@ -0,0 +1,333 @@
+/*!
+ * \file      crypto_micro_bench.c
+ *
+ * \brief     Host microbenchmark of the crypto primitives
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Measures lora_aes_set_key, lora_aes_encrypt,
+ *            AES_CMAC_Update/Final, LoRaMacComputeMic and
+ *            LoRaMacPayloadEncrypt. The size dependent functions are swept
+ *            over the payload sizes 1..242, the LoRaMac functions with
+ *            three key reuse patterns:
+ *
+ *            same      - every frame uses the same key (key cache hit)
+ *            alternate - frames alternate between two keys, like the
+ *                        NwkSKey/AppSKey use of a device
+ *            unique    - every frame uses another key (key cache miss)
+ *
+ *            Each result is the best of several runs. Cycles are read from
+ *            perf_event (core cycles) if the kernel allows it, otherwise
+ *            from rdtsc (reference cycles) on x86. The results are written
+ *            to stdout as JSON.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -Isystem -Isystem/crypto -Iradio -Imac \
+ *               extras/bench/crypto_micro_bench.c mac/LoRaMacCrypto.c \
+ *               system/crypto/aes.c system/crypto/aes_hw.c \
+ *               system/crypto/cmac.c system/utilities.c \
+ *               -o crypto_micro_bench
+ *
+ *            Usage: crypto_micro_bench [iterations] [size step]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "aes.h"
+#include "cmac.h"
+#include "LoRaMacCrypto.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*!
+ * Largest FRMPayload size
+ */
+#define MAX_SIZE 242
+
+/*!
+ * Number of keys cycled through by the unique pattern, larger than the key
+ * cache
+ */
+#define NB_KEYS 64
+
+/*!
+ * Number of runs per measurement, the fastest one is reported
+ */
+#define NB_RUNS 5
+
+typedef enum eKeyPattern
+{
+	PATTERN_SAME,
+	PATTERN_ALTERNATE,
+	PATTERN_UNIQUE,
+	PATTERN_NONE,
+} KeyPattern_t;
+
+static const char *PatternNames[] = {"same", "alternate", "unique", "none"};
+
+typedef enum eCycleSource
+{
+	CYCLES_NONE,
+	CYCLES_PERF,
+	CYCLES_RDTSC,
+} CycleSource_t;
+
+static const char *CycleSourceNames[] = {"none", "perf_event", "rdtsc"};
+
+static CycleSource_t CycleSource = CYCLES_NONE;
+static int PerfFd = -1;
+
+static uint8_t Keys[NB_KEYS][16];
+static uint8_t Buffer[MAX_SIZE + 16];
+static uint8_t Out[MAX_SIZE + 16];
+static volatile uint32_t Sink;
+
+static bool FirstResult = true;
+
+static void InitCycles(void)
+{
+#if defined(__linux__)
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	PerfFd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (PerfFd >= 0)
+	{
+		ioctl(PerfFd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(PerfFd, PERF_EVENT_IOC_ENABLE, 0);
+		CycleSource = CYCLES_PERF;
+		return;
+	}
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	CycleSource = CYCLES_RDTSC;
+#endif
+}
+
+static uint64_t ReadCycles(void)
+{
+	uint64_t cycles = 0;
+
+	switch (CycleSource)
+	{
+	case CYCLES_PERF:
+#if defined(__linux__)
+		if (read(PerfFd, &cycles, sizeof(cycles)) != sizeof(cycles))
+		{
+			cycles = 0;
+		}
+#endif
+		break;
+	case CYCLES_RDTSC:
+#if defined(__x86_64__) || defined(__i386__)
+		cycles = __rdtsc();
+#endif
+		break;
+	default:
+		break;
+	}
+	return cycles;
+}
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*!
+ * Operations under test
+ */
+typedef enum eOp
+{
+	OP_SET_KEY,
+	OP_AES_ENCRYPT,
+	OP_CMAC,
+	OP_COMPUTE_MIC,
+	OP_PAYLOAD_ENCRYPT,
+} Op_t;
+
+static const char *OpNames[] = {"lora_aes_set_key", "lora_aes_encrypt", "AES_CMAC_Update_Final",
+								"LoRaMacComputeMic", "LoRaMacPayloadEncrypt"};
+
+static const uint8_t *GetKey(KeyPattern_t pattern, uint32_t i)
+{
+	switch (pattern)
+	{
+	case PATTERN_ALTERNATE:
+		return Keys[i & 1];
+	case PATTERN_UNIQUE:
+		return Keys[i % NB_KEYS];
+	default:
+		return Keys[0];
+	}
+}
+
+/*!
+ * \brief Runs an operation iterations times
+ */
+static void Run(Op_t op, KeyPattern_t pattern, uint16_t size, uint32_t iterations)
+{
+	static lora_aes_context aesContext;
+	static AES_CMAC_CTX cmacContext;
+	uint32_t mic = 0;
+
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		switch (op)
+		{
+		case OP_SET_KEY:
+			lora_aes_set_key(Keys[i % NB_KEYS], 16, &aesContext);
+			mic ^= aesContext.ksch[16];
+			break;
+		case OP_AES_ENCRYPT:
+			lora_aes_encrypt(Out, Out, &aesContext);
+			break;
+		case OP_CMAC:
+			AES_CMAC_Reset(&cmacContext);
+			AES_CMAC_Update(&cmacContext, Buffer, size);
+			AES_CMAC_Final(Out, &cmacContext);
+			break;
+		case OP_COMPUTE_MIC:
+			LoRaMacComputeMic(Buffer, size, GetKey(pattern, i), 0x26011234, 0, i, &mic);
+			break;
+		case OP_PAYLOAD_ENCRYPT:
+			LoRaMacPayloadEncrypt(Buffer, size, GetKey(pattern, i), 0x26011234, 0, i, Out);
+			break;
+		}
+	}
+	Sink ^= mic ^ Out[0];
+
+	if (op == OP_SET_KEY)
+	{
+		// Leave a valid schedule for the other operations
+		AES_CMAC_SetKey(&cmacContext, Keys[0]);
+		lora_aes_set_key(Keys[0], 16, &aesContext);
+	}
+}
+
+/*!
+ * \brief Measures an operation and prints the result as JSON object
+ */
+static void Measure(Op_t op, KeyPattern_t pattern, uint16_t size, uint32_t iterations)
+{
+	uint64_t bestNs = UINT64_MAX;
+	uint64_t bestCycles = UINT64_MAX;
+	uint64_t ns;
+	uint64_t cycles;
+	double nsPerOp;
+
+	// Warm up the caches and the key cache
+	Run(op, pattern, size, iterations / 10 + 1);
+
+	for (uint8_t run = 0; run < NB_RUNS; run++)
+	{
+		cycles = ReadCycles();
+		ns = NowNs();
+		Run(op, pattern, size, iterations);
+		ns = NowNs() - ns;
+		cycles = ReadCycles() - cycles;
+		if (ns < bestNs)
+		{
+			bestNs = ns;
+		}
+		if (cycles < bestCycles)
+		{
+			bestCycles = cycles;
+		}
+	}
+
+	nsPerOp = (double)bestNs / iterations;
+	printf("%s\n    {\"op\": \"%s\", \"pattern\": \"%s\", \"size\": %u, \"iterations\": %u, "
+		   "\"ns_per_op\": %.2f, \"ns_per_byte\": %.3f",
+		   (FirstResult == true) ? "" : ",", OpNames[op], PatternNames[pattern], size, iterations,
+		   nsPerOp, (size > 0) ? nsPerOp / size : 0.0);
+	if (CycleSource != CYCLES_NONE)
+	{
+		printf(", \"cycles_per_op\": %.1f", (double)bestCycles / iterations);
+	}
+	else
+	{
+		printf(", \"cycles_per_op\": null");
+	}
+	printf("}");
+	FirstResult = false;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+	uint16_t step = (argc > 2) ? atoi(argv[2]) : 1;
+	const char *aesImpl = "sw";
+
+	if ((iterations == 0) || (step == 0))
+	{
+		fprintf(stderr, "usage: %s [iterations] [size step]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	for (uint32_t i = 0; i < NB_KEYS; i++)
+	{
+		for (uint8_t j = 0; j < 16; j++)
+		{
+			Keys[i][j] = rand();
+		}
+	}
+	for (uint16_t i = 0; i < sizeof(Buffer); i++)
+	{
+		Buffer[i] = rand();
+	}
+
+	InitCycles();
+
+#if defined(AES_HW_ACCEL)
+	aesImpl = "hw_dispatch";
+#elif defined(AES_ENC_TTABLE_COMPACT)
+	aesImpl = "ttable_compact";
+#elif defined(AES_ENC_TTABLE)
+	aesImpl = "ttable";
+#endif
+
+	printf("{\n  \"benchmark\": \"crypto_micro\",\n  \"aes_impl\": \"%s\",\n  \"cycle_source\": \"%s\",\n"
+		   "  \"key_cache_size\": %u,\n  \"results\": [",
+		   aesImpl, CycleSourceNames[CycleSource], LORAMAC_CRYPTO_KEY_CACHE_SIZE);
+
+	Measure(OP_SET_KEY, PATTERN_NONE, 16, iterations);
+	Measure(OP_AES_ENCRYPT, PATTERN_NONE, 16, iterations * 10);
+
+	for (uint16_t size = 1; size <= MAX_SIZE; size += step)
+	{
+		Measure(OP_CMAC, PATTERN_NONE, size, iterations);
+		for (KeyPattern_t pattern = PATTERN_SAME; pattern <= PATTERN_UNIQUE; pattern++)
+		{
+			Measure(OP_COMPUTE_MIC, pattern, size, iterations);
+			Measure(OP_PAYLOAD_ENCRYPT, pattern, size, iterations);
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	return (int)(Sink & 0);
+}
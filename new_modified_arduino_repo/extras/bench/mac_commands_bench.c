@@ -0,0 +1,450 @@
+/*!
+ * \file      mac_commands_bench.c
+ *
+ * \brief     Host benchmark of the MAC command parsing over fuzzed FOpts
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Parses random FOpts fields like ProcessMacCommands, a switch on
+ *            the CID after LoRaMacCommandsGetDownlink has checked the size
+ *            against a descriptor table with the command sizes of LoRaWAN
+ *            1.0.x, and with the unchecked switch of the former
+ *            ProcessMacCommands. The handlers only fold the commands into a
+ *            checksum, so the dispatch itself is measured. Two workloads
+ *            are run:
+ *
+ *            valid  - sequences of well formed server commands filling up
+ *                     to 15 bytes. Both parsers must agree on the checksum.
+ *            fuzzed - random bytes with mostly valid CIDs, including
+ *                     truncated and unknown commands. The checked parser
+ *                     stops at the first malformed command; the number of
+ *                     frames in which the switch reads past the end of the
+ *                     FOpts is reported.
+ *
+ *            The results are written to stdout as JSON. The exit code is 1
+ *            if the parsers disagree on the valid frames.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/mac_commands_bench.c mac/LoRaMacCommands.c \
+ *               system/utilities.c -o mac_commands_bench
+ *
+ *            Usage: mac_commands_bench [frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "LoRaMacCommands.h"
+
+/*!
+ * Maximum size of the FOpts field
+ */
+#define FOPTS_MAX_SIZE 15
+
+/*!
+ * Frame slot, padded so that the switch parser may read past the FOpts
+ */
+#define FRAME_SLOT_SIZE 32
+
+/*!
+ * Number of timed passes of each parser
+ */
+#define NB_PASSES 5
+
+static const char *WorkloadNames[] = {"valid", "fuzzed"};
+
+typedef enum eWorkload
+{
+	WORKLOAD_VALID,
+	WORKLOAD_FUZZED,
+} Workload_t;
+
+/*!
+ * Checksum and number of commands of a run
+ */
+typedef struct sBenchState
+{
+	uint64_t Checksum;
+	uint32_t NbCommands;
+} BenchState_t;
+
+static uint64_t RandomState;
+static bool FirstResult = true;
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint32_t Random(void)
+{
+	RandomState ^= RandomState << 13;
+	RandomState ^= RandomState >> 7;
+	RandomState ^= RandomState << 17;
+	return (uint32_t)RandomState;
+}
+
+static void Fold(BenchState_t *state, uint8_t cid, const uint8_t *payload, uint8_t size)
+{
+	uint64_t checksum = (state->Checksum ^ cid) * 0x100000001B3ull;
+
+	for (uint8_t i = 0; i < size; i++)
+	{
+		checksum = (checksum ^ payload[i]) * 0x100000001B3ull;
+	}
+	state->Checksum = checksum;
+	state->NbCommands++;
+}
+
+static uint8_t OnCommand(uint8_t cid, const uint8_t *payload, uint8_t size, void *arg)
+{
+	Fold((BenchState_t *)arg, cid, payload, size);
+	return size;
+}
+
+static uint8_t OnLinkCheckAns(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x02, payload, 2, arg);
+}
+
+/*!
+ * \brief Consumes a block of LinkADRReq commands like the regions do
+ */
+static uint8_t OnLinkAdrReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	uint8_t consumed = 4;
+
+	while (((consumed + 5) <= size) && (payload[consumed] == 0x03))
+	{
+		consumed += 5;
+	}
+	return OnCommand(0x03, payload, consumed, arg);
+}
+
+static uint8_t OnDutyCycleReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x04, payload, 1, arg);
+}
+
+static uint8_t OnRxParamSetupReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x05, payload, 4, arg);
+}
+
+static uint8_t OnDevStatusReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x06, payload, 0, arg);
+}
+
+static uint8_t OnNewChannelReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x07, payload, 5, arg);
+}
+
+static uint8_t OnRxTimingSetupReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x08, payload, 1, arg);
+}
+
+static uint8_t OnTxParamSetupReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x09, payload, 1, arg);
+}
+
+static uint8_t OnDlChannelReq(const uint8_t *payload, uint8_t size, void *arg)
+{
+	return OnCommand(0x0A, payload, 4, arg);
+}
+
+/*!
+ * Same sizes and flags as the table of LoRaMac.c
+ */
+static const LoRaMacCommand_t Commands[] =
+{
+	{0, 0, 0},
+	{0, 0, 0},
+	{2, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	{4, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	{1, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	{4, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_STICKY | LORAMAC_COMMAND_DOWNLINK},
+	{0, 2, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	{5, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	{1, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_STICKY | LORAMAC_COMMAND_DOWNLINK},
+	{1, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	{4, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_STICKY | LORAMAC_COMMAND_DOWNLINK},
+};
+
+#define NB_COMMANDS (sizeof(Commands) / sizeof(Commands[0]))
+
+/*!
+ * \brief Parses the commands like ProcessMacCommands: the size is checked
+ *        with the table, then the CID selects a case
+ *
+ * \retval Number of bytes processed
+ */
+static uint8_t TableProcess(const uint8_t *payload, uint8_t size, BenchState_t *state)
+{
+	uint8_t index = 0;
+
+	while (index < size)
+	{
+		uint8_t cid = payload[index++];
+		uint8_t remaining = size - index;
+		const LoRaMacCommand_t *command = LoRaMacCommandsGetDownlink(Commands, NB_COMMANDS, cid, remaining);
+		uint8_t consumed;
+
+		if (command == NULL)
+		{
+			// Without the CID
+			return index - 1;
+		}
+
+		switch (cid)
+		{
+		case 0x02:
+			consumed = OnLinkCheckAns(&payload[index], remaining, state);
+			break;
+		case 0x03:
+			consumed = OnLinkAdrReq(&payload[index], remaining, state);
+			break;
+		case 0x04:
+			consumed = OnDutyCycleReq(&payload[index], remaining, state);
+			break;
+		case 0x05:
+			consumed = OnRxParamSetupReq(&payload[index], remaining, state);
+			break;
+		case 0x06:
+			consumed = OnDevStatusReq(&payload[index], remaining, state);
+			break;
+		case 0x07:
+			consumed = OnNewChannelReq(&payload[index], remaining, state);
+			break;
+		case 0x08:
+			consumed = OnRxTimingSetupReq(&payload[index], remaining, state);
+			break;
+		case 0x09:
+			consumed = OnTxParamSetupReq(&payload[index], remaining, state);
+			break;
+		case 0x0A:
+			consumed = OnDlChannelReq(&payload[index], remaining, state);
+			break;
+		default:
+			consumed = command->RxSize;
+			break;
+		}
+		index += consumed;
+	}
+	return index;
+}
+
+/*!
+ * \brief Parses the commands like the former ProcessMacCommands: the CID
+ *        selects a case which reads its payload without checking the size
+ *
+ * \retval true if the parser read past the end of the commands
+ */
+static bool SwitchProcess(const uint8_t *payload, uint8_t size, BenchState_t *state)
+{
+	uint8_t index = 0;
+
+	while (index < size)
+	{
+		uint8_t cid = payload[index++];
+
+		switch (cid)
+		{
+		case 0x02:
+			index += OnLinkCheckAns(&payload[index], size - index, state);
+			break;
+		case 0x03:
+			index += OnLinkAdrReq(&payload[index], size - index, state);
+			break;
+		case 0x04:
+			index += OnDutyCycleReq(&payload[index], size - index, state);
+			break;
+		case 0x05:
+			index += OnRxParamSetupReq(&payload[index], size - index, state);
+			break;
+		case 0x06:
+			index += OnDevStatusReq(&payload[index], size - index, state);
+			break;
+		case 0x07:
+			index += OnNewChannelReq(&payload[index], size - index, state);
+			break;
+		case 0x08:
+			index += OnRxTimingSetupReq(&payload[index], size - index, state);
+			break;
+		case 0x09:
+			index += OnTxParamSetupReq(&payload[index], size - index, state);
+			break;
+		case 0x0A:
+			index += OnDlChannelReq(&payload[index], size - index, state);
+			break;
+		default:
+			return false;
+		}
+	}
+	return index > size;
+}
+
+/*!
+ * \brief Fills a frame slot with FOpts
+ *
+ * \retval Size of the FOpts
+ */
+static uint8_t Generate(Workload_t workload, uint8_t *frame)
+{
+	uint8_t size = 0;
+
+	memset(frame, 0, FRAME_SLOT_SIZE);
+	if (workload == WORKLOAD_FUZZED)
+	{
+		size = 1 + Random() % FOPTS_MAX_SIZE;
+		for (uint8_t i = 0; i < size; i++)
+		{
+			uint32_t r = Random();
+
+			// Mostly known CIDs, so the parsers get past the first byte
+			frame[i] = ((r & 0x300) != 0) ? 0x02 + (r & 0xFF) % 9 : (uint8_t)r;
+		}
+		return size;
+	}
+
+	while (true)
+	{
+		uint8_t cid = 0x02 + Random() % 9;
+		uint8_t commandSize = Commands[cid].RxSize + 1;
+
+		if ((size + commandSize) > FOPTS_MAX_SIZE)
+		{
+			break;
+		}
+		frame[size] = cid;
+		for (uint8_t i = 1; i < commandSize; i++)
+		{
+			frame[size + i] = (uint8_t)Random();
+		}
+		size += commandSize;
+	}
+	return size;
+}
+
+static void PrintResult(const char *impl, Workload_t workload, uint32_t nbFrames, uint32_t nbBytes, uint64_t ns,
+						const BenchState_t *state, uint32_t nbMalformed)
+{
+	printf("%s\n    {\"impl\": \"%s\", \"workload\": \"%s\", \"frames\": %u, \"commands\": %u, \"ns_per_frame\": %.1f, "
+		   "\"mbytes_per_s\": %.1f, \"malformed_frames\": %u, \"checksum\": \"%016llx\"}",
+		   (FirstResult == true) ? "" : ",", impl, WorkloadNames[workload], nbFrames, state->NbCommands,
+		   (double)ns / nbFrames, (double)nbBytes * 1000.0 / ns, nbMalformed, (unsigned long long)state->Checksum);
+	FirstResult = false;
+}
+
+/*!
+ * \brief Times one pass of a parser over the frames
+ *
+ * \retval Time [ns]
+ */
+static uint64_t TimePass(bool checked, const uint8_t *frames, const uint8_t *sizes, uint32_t nbFrames, BenchState_t *state, uint32_t *nbMalformed)
+{
+	uint64_t start;
+
+	state->Checksum = 0;
+	state->NbCommands = 0;
+	*nbMalformed = 0;
+
+	start = NowNs();
+	for (uint32_t i = 0; i < nbFrames; i++)
+	{
+		if (checked == true)
+		{
+			if (TableProcess(&frames[i * FRAME_SLOT_SIZE], sizes[i], state) < sizes[i])
+			{
+				(*nbMalformed)++;
+			}
+		}
+		else if (SwitchProcess(&frames[i * FRAME_SLOT_SIZE], sizes[i], state) == true)
+		{
+			(*nbMalformed)++;
+		}
+	}
+	return NowNs() - start;
+}
+
+/*!
+ * \brief Runs a workload with both parsers. The passes alternate between
+ *        the parsers and the fastest pass of each is reported, so a slow
+ *        first pass or a noisy host does not favour one of them.
+ *
+ * \retval true if both parsers processed the valid frames identically
+ */
+static bool Run(Workload_t workload, uint8_t *frames, uint8_t *sizes, uint32_t nbFrames)
+{
+	BenchState_t table = {0, 0};
+	BenchState_t other = {0, 0};
+	uint32_t nbBytes = 0;
+	uint32_t nbRejected = 0;
+	uint32_t nbOverread = 0;
+	uint64_t tableNs = UINT64_MAX;
+	uint64_t switchNs = UINT64_MAX;
+	uint64_t ns;
+
+	RandomState = 0x9E3779B97F4A7C15ull + workload;
+	for (uint32_t i = 0; i < nbFrames; i++)
+	{
+		sizes[i] = Generate(workload, &frames[i * FRAME_SLOT_SIZE]);
+		nbBytes += sizes[i];
+	}
+
+	for (uint8_t pass = 0; pass < NB_PASSES; pass++)
+	{
+		ns = TimePass(true, frames, sizes, nbFrames, &table, &nbRejected);
+		tableNs = (ns < tableNs) ? ns : tableNs;
+		ns = TimePass(false, frames, sizes, nbFrames, &other, &nbOverread);
+		switchNs = (ns < switchNs) ? ns : switchNs;
+	}
+	PrintResult("table", workload, nbFrames, nbBytes, tableNs, &table, nbRejected);
+	PrintResult("switch", workload, nbFrames, nbBytes, switchNs, &other, nbOverread);
+
+	return (workload != WORKLOAD_VALID) || ((table.Checksum == other.Checksum) && (nbRejected == 0));
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t nbFrames = (argc > 1) ? atoi(argv[1]) : 1000000;
+	uint8_t *frames;
+	uint8_t *sizes;
+	bool match;
+
+	if (nbFrames == 0)
+	{
+		fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+		return 1;
+	}
+	frames = malloc((size_t)nbFrames * FRAME_SLOT_SIZE);
+	sizes = malloc(nbFrames);
+	if ((frames == NULL) || (sizes == NULL))
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	printf("{\n  \"benchmark\": \"mac_commands\",\n  \"descriptor_size\": %u,\n  \"results\": [",
+		   (unsigned)sizeof(LoRaMacCommand_t));
+	match = Run(WORKLOAD_VALID, frames, sizes, nbFrames);
+	Run(WORKLOAD_FUZZED, frames, sizes, nbFrames);
+	printf("\n  ],\n  \"valid_match\": %s\n}\n", (match == true) ? "true" : "false");
+
+	free(frames);
+	free(sizes);
+
+	return (match == true) ? 0 : 1;
+}
@@ -0,0 +1,448 @@
+/*!
+ * \file      nvm_power_loss_check.c
+ *
+ * \brief     Power loss check of the session log on the file backed storage
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Drives LoRaMacNvm.c on a LoRaMacNvmFile.c storage the way the
+ *            MAC does: a frame counter checkpoint before each uplink which
+ *            reaches the stored ceiling (the uplink is not sent if it
+ *            fails), a checkpoint every Stride downlinks, a snapshot when
+ *            the MAC parameters change and a clear and snapshot on a new
+ *            join. The storage is wrapped to inject faults:
+ *
+ *            power loss      - a write programs part of its bytes and a
+ *                              partly programmed last byte, an erase sets
+ *                              random bits of the sector, then nothing is
+ *                              written until the device resets
+ *            storage error   - a write is torn the same way and reports an
+ *                              error, the device goes on
+ *            reset           - the device restarts without a fault
+ *
+ *            A torn write always leaves bits of its data unprogrammed. At
+ *            each restart the file is reopened, the log scanned and the
+ *            session read. The restored session must be the last one whose
+ *            write completed, and a session must be found if one was
+ *            written since the last clear. The
+ *            uplink counter must be above every counter used by the
+ *            session, the downlink counter between the last one written
+ *            and the current one. The results are written to stdout as
+ *            JSON, the exit code is 1 if an invariant is broken.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem \
+ *               -Isystem/crypto -Iradio -Iradio/sx126x/sx126x_driver/src \
+ *               -Imac -Imac/region extras/bench/nvm_power_loss_check.c \
+ *               mac/LoRaMacNvm.c mac/LoRaMacNvmFile.c system/utilities.c \
+ *               -o nvm_power_loss_check
+ *
+ *            Usage: nvm_power_loss_check [steps]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utilities.h"
+#include "LoRaMacNvm.h"
+
+#define SECTOR_SIZE 4096
+#define NB_SECTORS 4
+#define STRIDE 16
+
+/*!
+ * Cost of an erase in the power loss budget, a write costs its size
+ */
+#define ERASE_COST 256
+
+/*!
+ * Largest power loss budget [byte]
+ */
+#define MAX_BUDGET 16384
+
+#define MAX_SESSIONS 4096
+
+/*!
+ * Session fields the check compares
+ */
+typedef struct sState
+{
+	bool HasSession;
+	uint32_t DevAddr;
+	int8_t Datarate;
+	uint32_t DownLinkCounter;
+} State_t;
+
+static LoRaMacNvmFile_t File;
+static LoRaMacNvmStorage_t Storage;
+static LoRaMacNvm_t Nvm;
+
+/*!
+ * Remaining bytes before the power is lost, 0 if no loss is planned
+ */
+static uint32_t Budget;
+static bool PowerLost;
+static bool StorageError;
+static uint32_t EraseCounts[NB_SECTORS];
+
+/*!
+ * Device RAM
+ */
+static uint32_t DevAddr;
+static int8_t Datarate;
+static uint32_t UpLinkCounter;
+static uint32_t DownLinkCounter;
+
+/*!
+ * State of the last completed write
+ */
+static State_t Written;
+
+/*!
+ * Highest uplink counter sent by each session, -1 if none
+ */
+static int64_t LastUsed[MAX_SESSIONS];
+
+static uint32_t NbSteps;
+static uint32_t NbUplinks;
+static uint32_t NbAborted;
+static uint32_t NbResets;
+static uint32_t NbPowerLosses;
+static uint32_t NbStorageErrors;
+static uint32_t NbFailures;
+
+/******************************************************************************
+ * Faulty storage
+ *****************************************************************************/
+static bool FaultRead(void *context, uint32_t address, uint8_t *buffer, uint16_t size)
+{
+	return File.Storage.Read(&File, address, buffer, size);
+}
+
+/*!
+ * \brief Programs the first bytes of a write and part of the bits of the
+ *        next byte. At least one bit to be programmed is left erased.
+ */
+static void TearWrite(uint32_t address, const uint8_t *buffer, uint16_t size)
+{
+	uint16_t last = size;
+	uint16_t programmed;
+	uint8_t partial;
+
+	while ((last > 0) && (buffer[last - 1] == 0xFF))
+	{
+		last--;
+	}
+	if (last == 0)
+	{
+		// Nothing to program, the write cannot be torn
+		return;
+	}
+	programmed = rand() % last;
+	partial = buffer[programmed];
+	// Lowest programmed bit erased, others at random
+	partial |= (~partial & (partial + 1)) | ((uint8_t)rand() & ~buffer[programmed]);
+
+	if (programmed > 0)
+	{
+		File.Storage.Write(&File, address, buffer, programmed);
+	}
+	File.Storage.Write(&File, address + programmed, &partial, 1);
+}
+
+static bool FaultWrite(void *context, uint32_t address, const uint8_t *buffer, uint16_t size)
+{
+	if (PowerLost == true)
+	{
+		return false;
+	}
+	if ((Budget > 0) && (Budget <= size))
+	{
+		TearWrite(address, buffer, size);
+		PowerLost = true;
+		return false;
+	}
+	if (Budget > 0)
+	{
+		Budget -= size;
+	}
+	if (StorageError == true)
+	{
+		StorageError = false;
+		TearWrite(address, buffer, size);
+		NbStorageErrors++;
+		return false;
+	}
+	return File.Storage.Write(&File, address, buffer, size);
+}
+
+static bool FaultErase(void *context, uint8_t sector)
+{
+	uint8_t data[SECTOR_SIZE];
+
+	if (PowerLost == true)
+	{
+		return false;
+	}
+	EraseCounts[sector]++;
+	if ((Budget > 0) && (Budget <= ERASE_COST))
+	{
+		// Interrupted erase, part of the bits are set
+		if (pread(File.Fd, data, SECTOR_SIZE, (off_t)sector * SECTOR_SIZE) == SECTOR_SIZE)
+		{
+			for (uint32_t i = 0; i < SECTOR_SIZE; i++)
+			{
+				data[i] |= (uint8_t)(rand() & rand());
+			}
+			if (pwrite(File.Fd, data, SECTOR_SIZE, (off_t)sector * SECTOR_SIZE) != SECTOR_SIZE)
+			{
+				fprintf(stderr, "pwrite failed\n");
+			}
+		}
+		PowerLost = true;
+		return false;
+	}
+	if (Budget > 0)
+	{
+		Budget -= ERASE_COST;
+	}
+	return File.Storage.Erase(&File, sector);
+}
+
+/******************************************************************************
+ * Device
+ *****************************************************************************/
+static void Fail(const char *invariant)
+{
+	if (NbFailures < 10)
+	{
+		fprintf(stderr, "step %u: %s\n", NbSteps, invariant);
+	}
+	NbFailures++;
+}
+
+static void Snapshot(void)
+{
+	LoRaMacNvmSession_t session;
+	State_t state = {true, DevAddr, Datarate, DownLinkCounter};
+
+	memset1((uint8_t *)&session, 0, sizeof(session));
+	session.Region = LORAMAC_REGION_EU868;
+	session.DevAddr = DevAddr;
+	memset1(session.NwkSKey, 0x11, sizeof(session.NwkSKey));
+	memset1(session.AppSKey, 0x22, sizeof(session.AppSKey));
+	session.UpLinkCounter = UpLinkCounter + STRIDE;
+	session.DownLinkCounter = DownLinkCounter;
+	session.Params.ChannelsDatarate = Datarate;
+	if (LoRaMacNvmWriteSession(&Nvm, &session) == LORAMAC_NVM_SUCCESS)
+	{
+		Written = state;
+	}
+}
+
+/*!
+ * \brief Same decisions as NvmCheckpoint of the MAC
+ *
+ * \retval false if the uplink counter must not be used
+ */
+static bool Checkpoint(void)
+{
+	uint32_t ceiling = Nvm.UpLinkCounter;
+	bool ceilingReached = false;
+
+	if (Nvm.HasSession == false)
+	{
+		// Nothing to protect, the session is not restored
+		return true;
+	}
+	if (UpLinkCounter >= ceiling)
+	{
+		ceiling = UpLinkCounter + STRIDE;
+		ceilingReached = true;
+	}
+	else if ((DownLinkCounter - Nvm.DownLinkCounter) < STRIDE)
+	{
+		return true;
+	}
+	if (LoRaMacNvmWriteCounters(&Nvm, ceiling, DownLinkCounter) != LORAMAC_NVM_SUCCESS)
+	{
+		return ceilingReached == false;
+	}
+	Written.DownLinkCounter = DownLinkCounter;
+	return true;
+}
+
+static void Join(void)
+{
+	if (Nvm.HasSession == true)
+	{
+		if (LoRaMacNvmClear(&Nvm) != LORAMAC_NVM_SUCCESS)
+		{
+			return;
+		}
+		Written.HasSession = false;
+	}
+	DevAddr = (DevAddr + 1) % MAX_SESSIONS;
+	LastUsed[DevAddr] = -1;
+	Datarate = DR_0;
+	UpLinkCounter = 0;
+	DownLinkCounter = 0;
+	Snapshot();
+}
+
+static void Uplink(void)
+{
+	if (Checkpoint() == false)
+	{
+		NbAborted++;
+		return;
+	}
+	LastUsed[DevAddr] = UpLinkCounter;
+	UpLinkCounter++;
+	NbUplinks++;
+}
+
+static bool SameSession(const State_t *state, const LoRaMacNvmSession_t *session)
+{
+	return (state->HasSession == true) && (state->DevAddr == session->DevAddr) &&
+		   (state->Datarate == session->Params.ChannelsDatarate);
+}
+
+/*!
+ * \brief Restarts the device and checks the restored session
+ */
+static void Restart(void)
+{
+	LoRaMacNvmSession_t session;
+	LoRaMacNvmStatus_t status;
+	bool found;
+
+	NbResets++;
+	LoRaMacNvmFileClose(&File);
+	if (LoRaMacNvmFileOpen(&File, "nvm_power_loss_check.bin", SECTOR_SIZE, NB_SECTORS) == false)
+	{
+		fprintf(stderr, "cannot open the storage file\n");
+		exit(1);
+	}
+	PowerLost = false;
+	Budget = 0;
+
+	status = LoRaMacNvmInit(&Nvm, &Storage, STRIDE);
+	found = (status == LORAMAC_NVM_SUCCESS) && (LoRaMacNvmReadSession(&Nvm, &session) == LORAMAC_NVM_SUCCESS);
+	if ((status != LORAMAC_NVM_SUCCESS) && (status != LORAMAC_NVM_EMPTY))
+	{
+		Fail("log scan failed");
+	}
+
+	if (found == false)
+	{
+		if (Written.HasSession == true)
+		{
+			Fail("session lost");
+		}
+		Join();
+		return;
+	}
+	if (SameSession(&Written, &session) == false)
+	{
+		Fail("restored session is not the last one written");
+	}
+	if ((session.DevAddr >= MAX_SESSIONS) || ((int64_t)session.UpLinkCounter <= LastUsed[session.DevAddr]))
+	{
+		Fail("uplink counter reused");
+	}
+	if ((session.DevAddr == DevAddr) &&
+		((session.DownLinkCounter < Written.DownLinkCounter) || (session.DownLinkCounter > DownLinkCounter)))
+	{
+		Fail("downlink counter out of range");
+	}
+
+	// Resume as LoRaMacRestoreSession does
+	DevAddr = session.DevAddr % MAX_SESSIONS;
+	Datarate = session.Params.ChannelsDatarate;
+	UpLinkCounter = session.UpLinkCounter;
+	DownLinkCounter = session.DownLinkCounter;
+	Written.HasSession = true;
+	Written.DevAddr = DevAddr;
+	Written.Datarate = Datarate;
+	Written.DownLinkCounter = DownLinkCounter;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t steps = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+	uint32_t minErases = UINT32_MAX;
+	uint32_t maxErases = 0;
+
+	srand(1);
+	unlink("nvm_power_loss_check.bin");
+	File.Fd = -1;
+	Storage.SectorSize = SECTOR_SIZE;
+	Storage.NbSectors = NB_SECTORS;
+	Storage.Read = FaultRead;
+	Storage.Write = FaultWrite;
+	Storage.Erase = FaultErase;
+	Storage.Context = NULL;
+	DevAddr = MAX_SESSIONS - 1;
+	Restart();
+	NbResets = 0;
+
+	for (NbSteps = 0; NbSteps < steps; NbSteps++)
+	{
+		uint32_t event = rand() % 1000;
+
+		if ((Budget == 0) && ((rand() % 50) == 0))
+		{
+			Budget = 1 + rand() % MAX_BUDGET;
+		}
+		if ((rand() % 500) == 0)
+		{
+			StorageError = true;
+		}
+
+		if (event < 700)
+		{
+			Uplink();
+		}
+		else if (event < 950)
+		{
+			DownLinkCounter++;
+			Checkpoint();
+		}
+		else if (event < 990)
+		{
+			Datarate = rand() % (DR_5 + 1);
+			Snapshot();
+		}
+		else if (event < 993)
+		{
+			Join();
+		}
+		else
+		{
+			Restart();
+		}
+
+		if (PowerLost == true)
+		{
+			NbPowerLosses++;
+			Restart();
+		}
+	}
+	LoRaMacNvmFileClose(&File);
+	unlink("nvm_power_loss_check.bin");
+
+	for (uint8_t i = 0; i < NB_SECTORS; i++)
+	{
+		minErases = (EraseCounts[i] < minErases) ? EraseCounts[i] : minErases;
+		maxErases = (EraseCounts[i] > maxErases) ? EraseCounts[i] : maxErases;
+	}
+	printf("{\n  \"steps\": %u,\n  \"uplinks\": %u,\n  \"aborted_uplinks\": %u,\n  \"resets\": %u,\n  \"power_losses\": %u,\n"
+		   "  \"storage_errors\": %u,\n  \"erases_min\": %u,\n  \"erases_max\": %u,\n  \"failures\": %u\n}\n",
+		   steps, NbUplinks, NbAborted, NbResets, NbPowerLosses, NbStorageErrors, minErases, maxErases, NbFailures);
+	return (NbFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,739 @@
+/*!
+ * \file      precompute_check.c
+ *
+ * \brief     Checks the precomputed uplink crypto against the plain one
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    LoRaMacCryptoCtxPrecompute is called for a predicted frame,
+ *            then LoRaMacCryptoCtxEncryptAndSign, LoRaMacCryptoCtxComputeMic
+ *            and LoRaMacCryptoCtxPayloadEncrypt run on the actual frame. The
+ *            output must equal the one of a context without precomputed
+ *            state, with the software code and with the software backend,
+ *            for a correct prediction and for a wrong FCnt, direction,
+ *            address, frame length and payload key.
+ *
+ *            To tell whether the precomputed state was used, each case runs
+ *            a second time with the precomputed CMAC state and keystream
+ *            corrupted: the output must then differ for the parts which
+ *            match the prediction and still be correct for the others.
+ *
+ *            LoRaMacCtxPrecomputeUplink is checked the same way on a MAC
+ *            instance (EU868, ABP) with a stub radio which captures the
+ *            frame: the frame must carry the MIC computed by
+ *            LoRaMacCryptoCtxComputeMic and decrypt to the application
+ *            payload, for a correct prediction, a correct prediction with a
+ *            pending MAC command in FOpts, and a wrong FCnt, address, size
+ *            and FOpts length.
+ *
+ *            The results are written to stdout as JSON, the exit code is 1
+ *            if a case fails.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -DLORAMAC_SINGLE_REGION=EU868 \
+ *               -Iextras/sim/host -I. -Isystem -Isystem/crypto -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/precompute_check.c mac/LoRaMac.c \
+ *               mac/LoRaMacCommands.c mac/LoRaMacCrypto.c \
+ *               mac/LoRaMacCryptoBackend.c mac/LoRaMacNvm.c \
+ *               mac/LoRaMacAirtime.c mac/region/Region.c \
+ *               mac/region/RegionCommon.c mac/region/RegionEU868.c \
+ *               radio/sx126x/radio_toa.c system/utilities.c \
+ *               system/crypto/aes.c system/crypto/aes_hw.c \
+ *               system/crypto/cmac.c -lm -o precompute_check
+ *
+ *            Usage: precompute_check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "LoRaMac.h"
+#include "LoRaMacContext.h"
+#include "LoRaMacCrypto.h"
+#include "LoRaMacCryptoBackend.h"
+#include "radio.h"
+#include "timer.h"
+#include "utilities.h"
+
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS == 0)
+#error "The check needs the precomputation (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)"
+#endif
+
+/*!
+ * Size of the frame header with the FPort field (MHDR + FHDR + FPort)
+ */
+#define HEADER_SIZE 9
+
+/*!
+ * Largest FRMPayload checked, bigger than the precomputed keystream and
+ * than one keystream chunk
+ */
+#define MAX_PAYLOAD 222
+
+/*!
+ * Application port used by the MAC cases
+ */
+#define APP_PORT 2
+
+/*!
+ * Number of timers of the MAC instance
+ */
+#define MAX_TIMERS 16
+
+/*!
+ * Prediction passed to LoRaMacCryptoCtxPrecompute, relative to the frame
+ */
+typedef struct sPrediction
+{
+	const char *Name;
+	uint32_t FCntDelta;
+	uint8_t DirXor;
+	uint32_t AddressXor;
+	int16_t SizeDelta;
+	bool OtherPayloadKey;
+	/*!
+	 * Expected use of the precomputed CMAC state and keystream
+	 */
+	bool MicUsed;
+	bool KeystreamUsed;
+} Prediction_t;
+
+static const Prediction_t Predictions[] = {
+	{"correct", 0, 0, 0, 0, false, true, true},
+	{"fcnt", 1, 0, 0, 0, false, false, false},
+	{"dir", 0, 1, 0, 0, false, false, false},
+	{"address", 0, 0, 0x00000100, 0, false, false, false},
+	// The keystream does not depend on the length
+	{"shorter", 0, 0, 0, -1, false, false, true},
+	{"longer", 0, 0, 0, 17, false, false, true},
+	{"payload_key", 0, 0, 0, 0, true, true, false},
+};
+
+#define NB_PREDICTIONS (sizeof(Predictions) / sizeof(Predictions[0]))
+
+static const uint8_t PayloadSizes[] = {0, 1, 15, 16, 17, 63, 64, 65, 100, MAX_PAYLOAD};
+
+#define NB_PAYLOAD_SIZES (sizeof(PayloadSizes) / sizeof(PayloadSizes[0]))
+
+static const uint8_t NwkSKey[16] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+static const uint8_t AppSKey[16] = {0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB, 0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B};
+static const uint8_t OtherKey[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+
+#define DEV_ADDR 0x26011BDA
+#define FCNT 0x00012345
+
+static bool FirstResult = true;
+static uint32_t Failures;
+
+/*!
+ * Output of LoRaMacCryptoCtxEncryptAndSign
+ */
+static uint8_t *WriteBuffer;
+
+static void Report(const char *name, const char *path, bool ok)
+{
+	printf("%s\n    {\"case\": \"%s\", \"path\": \"%s\", \"ok\": %s}", (FirstResult == true) ? "" : ",", name, path,
+		   (ok == true) ? "true" : "false");
+	FirstResult = false;
+	if (ok == false)
+	{
+		Failures++;
+	}
+}
+
+static void Write(uint8_t offset, const uint8_t *buffer, uint8_t size)
+{
+	memcpy(WriteBuffer + offset, buffer, size);
+}
+
+/******************************************************************************
+ * Crypto layer
+ *****************************************************************************/
+/*!
+ * Frame output of one crypto context
+ */
+typedef struct sCryptoOutput
+{
+	uint8_t Frame[HEADER_SIZE + MAX_PAYLOAD + 4];
+	uint8_t Retransmission[HEADER_SIZE + MAX_PAYLOAD + 4];
+	uint32_t Mic;
+	uint8_t Payload[MAX_PAYLOAD];
+} CryptoOutput_t;
+
+static void InitCtx(LoRaMacCryptoCtx_t *ctx, const LoRaMacCryptoBackend_t *backend)
+{
+	LoRaMacCryptoCtxInit(ctx);
+	LoRaMacCryptoCtxSetBackend(ctx, backend);
+}
+
+/*!
+ * \brief Runs the frame through EncryptAndSign twice (a retransmission),
+ *        ComputeMic and PayloadEncrypt
+ */
+static void RunCrypto(LoRaMacCryptoCtx_t *ctx, const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint8_t payloadSize, CryptoOutput_t *out)
+{
+	uint8_t frame[HEADER_SIZE + MAX_PAYLOAD];
+	uint8_t size = headerSize + payloadSize;
+
+	// The MIC input does not depend on the keystream
+	memcpy(frame, header, headerSize);
+	memcpy(frame + headerSize, payload, payloadSize);
+
+	memset(out, 0, sizeof(CryptoOutput_t));
+	WriteBuffer = out->Frame;
+	LoRaMacCryptoCtxEncryptAndSign(ctx, header, headerSize, payload, payloadSize, NwkSKey, AppSKey, DEV_ADDR, UP_LINK, FCNT, Write);
+	WriteBuffer = out->Retransmission;
+	LoRaMacCryptoCtxEncryptAndSign(ctx, header, headerSize, payload, payloadSize, NwkSKey, AppSKey, DEV_ADDR, UP_LINK, FCNT, Write);
+	LoRaMacCryptoCtxComputeMic(ctx, frame, size, NwkSKey, DEV_ADDR, UP_LINK, FCNT, &out->Mic);
+	if (payloadSize > 0)
+	{
+		LoRaMacCryptoCtxPayloadEncrypt(ctx, payload, payloadSize, AppSKey, DEV_ADDR, UP_LINK, FCNT, out->Payload);
+	}
+}
+
+/*!
+ * \brief Checks one prediction for one payload size
+ *
+ * \param  corrupt         Corrupts the precomputed state after the
+ *                         precomputation
+ */
+static bool CheckPrediction(const LoRaMacCryptoBackend_t *backend, const Prediction_t *prediction, uint8_t payloadSize, bool corrupt)
+{
+	static LoRaMacCryptoCtx_t ctx;
+	static LoRaMacCryptoCtx_t refCtx;
+	static CryptoOutput_t out;
+	static CryptoOutput_t ref;
+	uint8_t header[HEADER_SIZE];
+	uint8_t payload[MAX_PAYLOAD];
+	uint8_t headerSize = (payloadSize > 0) ? HEADER_SIZE : HEADER_SIZE - 1;
+	uint8_t size = headerSize + payloadSize;
+	int16_t predictedPayloadSize = T_MAX(payloadSize + prediction->SizeDelta, 0);
+	bool micUsed = prediction->MicUsed;
+	bool keystreamUsed = (prediction->KeystreamUsed == true) && (payloadSize > 0) && (predictedPayloadSize > 0);
+	bool ok = true;
+
+	for (uint8_t i = 0; i < sizeof(header); i++)
+	{
+		header[i] = 0x40 + i;
+	}
+	for (uint8_t i = 0; i < payloadSize; i++)
+	{
+		payload[i] = i * 7;
+	}
+
+	InitCtx(&refCtx, backend);
+	RunCrypto(&refCtx, header, headerSize, payload, payloadSize, &ref);
+
+	InitCtx(&ctx, backend);
+	LoRaMacCryptoCtxPrecompute(&ctx, NwkSKey, (prediction->OtherPayloadKey == true) ? OtherKey : AppSKey, DEV_ADDR ^ prediction->AddressXor,
+							   UP_LINK ^ prediction->DirXor, FCNT + prediction->FCntDelta, size + prediction->SizeDelta, predictedPayloadSize);
+	if (corrupt == true)
+	{
+		ctx.Precompute.MicState[0] ^= 0x01;
+		ctx.Precompute.Keystream[0] ^= 0x01;
+	}
+	RunCrypto(&ctx, header, headerSize, payload, payloadSize, &out);
+
+	if (corrupt == false)
+	{
+		return memcmp(&out, &ref, sizeof(CryptoOutput_t)) == 0;
+	}
+
+	// A corrupted keystream changes the FRMPayload and so the MIC of
+	// EncryptAndSign, a corrupted CMAC state only the MIC
+	ok = ok && ((memcmp(out.Frame, ref.Frame, sizeof(out.Frame)) != 0) == (micUsed || keystreamUsed));
+	ok = ok && ((memcmp(out.Retransmission, ref.Retransmission, sizeof(out.Retransmission)) != 0) == (micUsed || keystreamUsed));
+	ok = ok && (memcmp(out.Frame + headerSize + 1, ref.Frame + headerSize + 1, T_MAX(payloadSize, 1) - 1) == 0);
+	ok = ok && ((out.Mic != ref.Mic) == micUsed);
+	ok = ok && ((memcmp(out.Payload, ref.Payload, sizeof(out.Payload)) != 0) == keystreamUsed);
+	return ok;
+}
+
+static void CheckCrypto(const LoRaMacCryptoBackend_t *backend, const char *path)
+{
+	for (uint8_t i = 0; i < NB_PREDICTIONS; i++)
+	{
+		bool ok = true;
+
+		for (uint8_t j = 0; j < NB_PAYLOAD_SIZES; j++)
+		{
+			ok = ok && CheckPrediction(backend, &Predictions[i], PayloadSizes[j], false);
+			ok = ok && CheckPrediction(backend, &Predictions[i], PayloadSizes[j], true);
+		}
+		Report(Predictions[i].Name, path, ok);
+	}
+}
+
+/******************************************************************************
+ * Stub radio and timers of the MAC cases
+ *****************************************************************************/
+static TimerTime_t Now = 1000;
+static TimerEvent_t *Timers[MAX_TIMERS];
+static uint8_t NbTimers;
+static uint8_t TxBuffer[256];
+static uint8_t TxSize;
+
+void TimerInit(TimerEvent_t *obj, void (*callback)(void))
+{
+	obj->Callback = callback;
+	obj->IsRunning = false;
+	obj->ReloadValue = 0;
+	for (uint8_t i = 0; i < NbTimers; i++)
+	{
+		if (Timers[i] == obj)
+		{
+			return;
+		}
+	}
+	if (NbTimers < MAX_TIMERS)
+	{
+		Timers[NbTimers++] = obj;
+	}
+}
+
+void TimerSetValue(TimerEvent_t *obj, uint32_t value)
+{
+	obj->ReloadValue = value;
+}
+
+void TimerStart(TimerEvent_t *obj)
+{
+	obj->IsRunning = true;
+}
+
+void TimerStop(TimerEvent_t *obj)
+{
+	obj->IsRunning = false;
+}
+
+TimerTime_t TimerGetCurrentTime(void)
+{
+	return Now;
+}
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t past)
+{
+	return Now - past;
+}
+
+/*!
+ * \brief Runs the timers in expiry order until the MAC transmits, a duty
+ *        cycle wait delays the first uplink
+ */
+static void RunTimersUntilTx(void)
+{
+	while (TxSize == 0)
+	{
+		TimerEvent_t *next = NULL;
+
+		for (uint8_t i = 0; i < NbTimers; i++)
+		{
+			if ((Timers[i]->IsRunning == true) && ((next == NULL) || (Timers[i]->ReloadValue < next->ReloadValue)))
+			{
+				next = Timers[i];
+			}
+		}
+		if (next == NULL)
+		{
+			return;
+		}
+		Now += next->ReloadValue;
+		next->IsRunning = false;
+		next->Callback();
+	}
+}
+
+// Globals of LoRaMacHelper.c used by the MAC
+LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[6];
+bool lmh_mac_is_busy = false;
+bool singleChannelGateway = false;
+uint8_t singleChannelSelected = 0;
+int8_t singleChannelDatarate = DR_3;
+
+static void RadioInit(RadioEvents_t *events)
+{
+	(void)events;
+}
+
+static RadioState_t RadioGetStatus(void)
+{
+	return RF_IDLE;
+}
+
+static void RadioSetChannel(uint32_t freq)
+{
+	(void)freq;
+}
+
+static bool RadioIsChannelFree(RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime)
+{
+	(void)modem;
+	(void)freq;
+	(void)rssiThresh;
+	(void)maxCarrierSenseTime;
+	return true;
+}
+
+static uint32_t RadioRandom(void)
+{
+	return 0x12345678;
+}
+
+static void RadioSetRxConfig(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate, uint32_t bandwidthAfc, uint16_t preambleLen, uint16_t symbTimeout, bool fixLen, uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, bool rxContinuous)
+{
+	(void)modem;
+	(void)bandwidth;
+	(void)datarate;
+	(void)coderate;
+	(void)bandwidthAfc;
+	(void)preambleLen;
+	(void)symbTimeout;
+	(void)fixLen;
+	(void)payloadLen;
+	(void)crcOn;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+	(void)rxContinuous;
+}
+
+static void RadioSetTxConfig(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth, uint32_t datarate, uint8_t coderate, uint16_t preambleLen, bool fixLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, uint32_t timeout)
+{
+	(void)modem;
+	(void)power;
+	(void)fdev;
+	(void)bandwidth;
+	(void)datarate;
+	(void)coderate;
+	(void)preambleLen;
+	(void)fixLen;
+	(void)crcOn;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+	(void)timeout;
+}
+
+static bool RadioCheckRfFrequency(uint32_t frequency)
+{
+	(void)frequency;
+	return true;
+}
+
+static uint32_t RadioTimeOnAir(RadioModems_t modem, uint8_t pktLen)
+{
+	(void)modem;
+	return 50 + pktLen;
+}
+
+static void RadioSleep(void)
+{
+}
+
+static void RadioRx(uint32_t timeout)
+{
+	(void)timeout;
+}
+
+static void RadioSetTxContinuousWave(uint32_t freq, int8_t power, uint16_t time)
+{
+	(void)freq;
+	(void)power;
+	(void)time;
+}
+
+static void RadioSetMaxPayloadLength(RadioModems_t modem, uint8_t max)
+{
+	(void)modem;
+	(void)max;
+}
+
+static void RadioSetPublicNetwork(bool enable)
+{
+	(void)enable;
+}
+
+static void RadioWriteTxBuffer(uint8_t offset, const uint8_t *buffer, uint8_t size)
+{
+	for (uint8_t i = 0; i < size; i++)
+	{
+		TxBuffer[(uint8_t)(offset + i)] = buffer[i];
+	}
+}
+
+static void RadioSendTxBuffer(uint8_t size)
+{
+	TxSize = size;
+}
+
+const struct Radio_s Radio = {
+	.Init = RadioInit,
+	.GetStatus = RadioGetStatus,
+	.SetChannel = RadioSetChannel,
+	.IsChannelFree = RadioIsChannelFree,
+	.Random = RadioRandom,
+	.SetRxConfig = RadioSetRxConfig,
+	.SetTxConfig = RadioSetTxConfig,
+	.CheckRfFrequency = RadioCheckRfFrequency,
+	.TimeOnAir = RadioTimeOnAir,
+	.Sleep = RadioSleep,
+	.Standby = RadioSleep,
+	.Rx = RadioRx,
+	.SetTxContinuousWave = RadioSetTxContinuousWave,
+	.SetMaxPayloadLength = RadioSetMaxPayloadLength,
+	.SetPublicNetwork = RadioSetPublicNetwork,
+	.WriteTxBuffer = RadioWriteTxBuffer,
+	.SendTxBuffer = RadioSendTxBuffer,
+};
+
+/******************************************************************************
+ * MAC layer
+ *****************************************************************************/
+static void OnMcpsConfirm(McpsConfirm_t *mcpsConfirm)
+{
+	(void)mcpsConfirm;
+}
+
+static void OnMcpsIndication(McpsIndication_t *mcpsIndication)
+{
+	(void)mcpsIndication;
+}
+
+static void OnMlmeConfirm(MlmeConfirm_t *mlmeConfirm)
+{
+	(void)mlmeConfirm;
+}
+
+static LoRaMacPrimitives_t Primitives = {OnMcpsConfirm, OnMcpsIndication, OnMlmeConfirm};
+static LoRaMacCallback_t Callbacks;
+
+/*!
+ * Change between LoRaMacCtxPrecomputeUplink and the uplink
+ */
+typedef enum eMacChange
+{
+	MAC_CHANGE_NONE,
+	MAC_CHANGE_FCNT,
+	MAC_CHANGE_ADDRESS,
+	MAC_CHANGE_SIZE,
+	MAC_CHANGE_FOPTS,
+} MacChange_t;
+
+/*!
+ * Uplink prediction case
+ */
+typedef struct sMacCase
+{
+	const char *Name;
+	/*!
+	 * LinkCheckReq pending before the precomputation
+	 */
+	bool FOptsPredicted;
+	MacChange_t Change;
+	/*!
+	 * Expected use of the precomputed CMAC state and keystream
+	 */
+	bool MicUsed;
+	bool KeystreamUsed;
+} MacCase_t;
+
+static const MacCase_t MacCases[] = {
+	{"uplink_correct", false, MAC_CHANGE_NONE, true, true},
+	{"uplink_fopts", true, MAC_CHANGE_NONE, true, true},
+	{"uplink_fcnt", false, MAC_CHANGE_FCNT, false, false},
+	{"uplink_address", false, MAC_CHANGE_ADDRESS, false, false},
+	{"uplink_size", false, MAC_CHANGE_SIZE, false, true},
+	{"uplink_fopts_added", false, MAC_CHANGE_FOPTS, false, true},
+};
+
+#define NB_MAC_CASES (sizeof(MacCases) / sizeof(MacCases[0]))
+
+static void MibSet(LoRaMacContext_t *mac, MibRequestConfirm_t *mibReq)
+{
+	if (LoRaMacCtxMibSetRequestConfirm(mac, mibReq) != LORAMAC_STATUS_OK)
+	{
+		fprintf(stderr, "MIB %d set failed\n", mibReq->Type);
+		exit(1);
+	}
+}
+
+static void AddLinkCheckReq(LoRaMacContext_t *mac)
+{
+	MlmeReq_t mlmeReq;
+
+	mlmeReq.Type = MLME_LINK_CHECK;
+	LoRaMacCtxMlmeRequest(mac, &mlmeReq);
+}
+
+/*!
+ * \brief Sends one uplink after LoRaMacCtxPrecomputeUplink and checks the
+ *        frame with a separate crypto context
+ *
+ * \param  corrupt         Corrupts the precomputed state after the
+ *                         precomputation
+ */
+static bool CheckUplink(const MacCase_t *macCase, uint8_t payloadSize, bool corrupt)
+{
+	static LoRaMacContext_t mac;
+	static LoRaMacCryptoCtx_t crypto;
+	static LoRaMacCryptoCtx_t refCrypto;
+	LoRaMacInitParams_t params;
+	MibRequestConfirm_t mibReq;
+	McpsReq_t mcpsReq;
+	uint8_t payload[MAX_PAYLOAD];
+	uint8_t decrypted[MAX_PAYLOAD];
+	uint32_t devAddr = DEV_ADDR;
+	uint32_t fCnt = FCNT;
+	uint8_t fOptsLen = ((macCase->FOptsPredicted == true) || (macCase->Change == MAC_CHANGE_FOPTS)) ? 1 : 0;
+	uint8_t size;
+	uint32_t mic;
+	uint32_t micRx;
+	bool micValid;
+	bool payloadValid;
+
+	LoRaMacContextInit(&mac, &crypto);
+	params.primitives = &Primitives;
+	params.callbacks = &Callbacks;
+	params.Region = LORAMAC_REGION_EU868;
+	params.nodeClass = CLASS_A;
+	params.region_change = false;
+	if (LoRaMacCtxInitialization(&mac, &params) != LORAMAC_STATUS_OK)
+	{
+		fprintf(stderr, "MAC initialization failed\n");
+		exit(1);
+	}
+	mibReq.Type = MIB_DEV_ADDR;
+	mibReq.Param.DevAddr = devAddr;
+	MibSet(&mac, &mibReq);
+	mibReq.Type = MIB_NWK_SKEY;
+	mibReq.Param.NwkSKey = (uint8_t *)NwkSKey;
+	MibSet(&mac, &mibReq);
+	mibReq.Type = MIB_APP_SKEY;
+	mibReq.Param.AppSKey = (uint8_t *)AppSKey;
+	MibSet(&mac, &mibReq);
+	mibReq.Type = MIB_NETWORK_JOINED;
+	mibReq.Param.IsNetworkJoined = JOIN_OK;
+	MibSet(&mac, &mibReq);
+	mibReq.Type = MIB_ADR;
+	mibReq.Param.AdrEnable = false;
+	MibSet(&mac, &mibReq);
+	mibReq.Type = MIB_UPLINK_COUNTER;
+	mibReq.Param.UpLinkCounter = fCnt;
+	MibSet(&mac, &mibReq);
+
+	if (macCase->FOptsPredicted == true)
+	{
+		AddLinkCheckReq(&mac);
+	}
+	if (LoRaMacCtxPrecomputeUplink(&mac, APP_PORT, payloadSize) != LORAMAC_STATUS_OK)
+	{
+		return false;
+	}
+	if (corrupt == true)
+	{
+		crypto.Precompute.MicState[0] ^= 0x01;
+		crypto.Precompute.Keystream[0] ^= 0x01;
+	}
+
+	switch (macCase->Change)
+	{
+	case MAC_CHANGE_FCNT:
+		fCnt++;
+		mibReq.Type = MIB_UPLINK_COUNTER;
+		mibReq.Param.UpLinkCounter = fCnt;
+		MibSet(&mac, &mibReq);
+		break;
+	case MAC_CHANGE_ADDRESS:
+		devAddr ^= 0x00000100;
+		mibReq.Type = MIB_DEV_ADDR;
+		mibReq.Param.DevAddr = devAddr;
+		MibSet(&mac, &mibReq);
+		break;
+	case MAC_CHANGE_SIZE:
+		payloadSize++;
+		break;
+	case MAC_CHANGE_FOPTS:
+		AddLinkCheckReq(&mac);
+		break;
+	default:
+		break;
+	}
+
+	for (uint8_t i = 0; i < payloadSize; i++)
+	{
+		payload[i] = 0xA5 ^ i;
+	}
+	TxSize = 0;
+	mcpsReq.Type = MCPS_UNCONFIRMED;
+	mcpsReq.Req.Unconfirmed.fPort = APP_PORT;
+	mcpsReq.Req.Unconfirmed.fBuffer = payload;
+	mcpsReq.Req.Unconfirmed.fBufferSize = payloadSize;
+	mcpsReq.Req.Unconfirmed.Datarate = DR_5;
+	if (LoRaMacCtxMcpsRequest(&mac, &mcpsReq) != LORAMAC_STATUS_OK)
+	{
+		return false;
+	}
+	RunTimersUntilTx();
+
+	// MHDR(1) + FHDR(7 + FOpts) + Port(1) + FRMPayload + MIC(4)
+	size = 9 + fOptsLen + payloadSize;
+	if (TxSize != size + 4)
+	{
+		return false;
+	}
+	if ((TxBuffer[1] != (devAddr & 0xFF)) || (TxBuffer[2] != ((devAddr >> 8) & 0xFF)) || (TxBuffer[3] != ((devAddr >> 16) & 0xFF)) ||
+		(TxBuffer[4] != (devAddr >> 24)) || ((TxBuffer[5] & 0x0F) != fOptsLen) || (TxBuffer[6] != (fCnt & 0xFF)) ||
+		(TxBuffer[7] != ((fCnt >> 8) & 0xFF)) || (TxBuffer[8 + fOptsLen] != APP_PORT))
+	{
+		return false;
+	}
+
+	LoRaMacCryptoCtxInit(&refCrypto);
+	LoRaMacCryptoCtxComputeMic(&refCrypto, TxBuffer, size, NwkSKey, devAddr, UP_LINK, fCnt, &mic);
+	micRx = TxBuffer[size] | ((uint32_t)TxBuffer[size + 1] << 8) | ((uint32_t)TxBuffer[size + 2] << 16) | ((uint32_t)TxBuffer[size + 3] << 24);
+	LoRaMacCryptoCtxPayloadDecrypt(&refCrypto, TxBuffer + 9 + fOptsLen, payloadSize, AppSKey, devAddr, UP_LINK, fCnt, decrypted);
+	micValid = mic == micRx;
+	payloadValid = memcmp(decrypted, payload, payloadSize) == 0;
+
+	if (corrupt == false)
+	{
+		return (micValid == true) && (payloadValid == true);
+	}
+	// A corrupted keystream changes the FRMPayload, the MIC is computed over
+	// the encrypted FRMPayload and stays valid
+	return (micValid == !macCase->MicUsed) && (payloadValid == !macCase->KeystreamUsed);
+}
+
+static void CheckMac(void)
+{
+	static const uint8_t payloadSizes[] = {1, 16, 40, 100};
+
+	for (uint8_t i = 0; i < NB_MAC_CASES; i++)
+	{
+		bool ok = true;
+
+		for (uint8_t j = 0; j < sizeof(payloadSizes); j++)
+		{
+			ok = ok && CheckUplink(&MacCases[i], payloadSizes[j], false);
+			ok = ok && CheckUplink(&MacCases[i], payloadSizes[j], true);
+		}
+		Report(MacCases[i].Name, "mac", ok);
+	}
+}
+
+int main(void)
+{
+	printf("{\n  \"check\": \"precompute\",\n  \"precompute_blocks\": %u,\n  \"results\": [", LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS);
+	CheckCrypto(NULL, "software");
+	CheckCrypto(&LoRaMacCryptoBackendSoftware, "backend");
+	CheckMac();
+	printf("\n  ],\n  \"failures\": %u\n}\n", Failures);
+
+	return (Failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+/*!
+ * \file      region_timing_bench.c
+ *
+ * \brief     Host benchmark of the timing part of the TX scheduling of each
+ *            region
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs, for each region, the region calls ScheduleTx and SendFrame
+ *            make for an uplink: RX1 and RX2 window parameters
+ *            (RegionComputeRxWindowParameters) and the TX configuration with
+ *            the time on air (RegionTxConfig). The radio is a stub, its
+ *            TimeOnAir computes the time on air of the SX126x driver with
+ *            RadioLoRaTimeOnAir/RadioFskTimeOnAir.
+ *
+ *            The device keeps a datarate for 256 uplinks (ADR) and sends
+ *            frames of 4 sizes, with the default MinRxSymbols and
+ *            SystemMaxRxError. Each result is the best of several runs, in
+ *            ns and cycles per uplink. Cycles are read from perf_event (core
+ *            cycles) if the kernel allows it, otherwise from rdtsc
+ *            (reference cycles) on x86. symbol_table_bytes is the flash size
+ *            of the symbol time table of the region. The results are
+ *            written to stdout as JSON.
+ *
+ *            Build from the repository root, once as is and once with
+ *            -DREGION_COMMON_TIMING_CACHE_BITS=0 (no memo caches) to compare:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/region_timing_bench.c mac/region/Region*.c \
+ *               -x c mac/region/RegionUS915.cpp -x none system/utilities.c \
+ *               radio/sx126x/radio_toa.c -o region_timing_bench
+ *
+ *            Usage: region_timing_bench [uplinks]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "utilities.h"
+#include "radio.h"
+#include "radio_toa.h"
+#include "Region.h"
+#include "RegionCommon.h"
+#include "RegionAS923.h"
+#include "RegionAU915.h"
+#include "RegionCN470.h"
+#include "RegionCN779.h"
+#include "RegionEU433.h"
+#include "RegionEU868.h"
+#include "RegionIN865.h"
+#include "RegionKR920.h"
+#include "RegionRU864.h"
+#include "RegionUS915.h"
+
+#define NB_RUNS 5
+
+/*!
+ * Region of the benchmark
+ */
+typedef struct sBenchRegion
+{
+	const char *Name;
+	LoRaMacRegion_t Region;
+	uint32_t SymbolTableSize;
+} BenchRegion_t;
+
+#define BENCH_REGION(name)                                          \
+	{                                                               \
+		#name, LORAMAC_REGION_##name, sizeof(SymbolTimes##name) \
+	}
+
+static const BenchRegion_t BenchRegions[] = {
+	BENCH_REGION(EU868),
+	BENCH_REGION(US915),
+	BENCH_REGION(AU915),
+	BENCH_REGION(AS923),
+	BENCH_REGION(KR920),
+	BENCH_REGION(IN865),
+	BENCH_REGION(RU864),
+	BENCH_REGION(CN470),
+	BENCH_REGION(CN779),
+	BENCH_REGION(EU433),
+};
+
+/*!
+ * Frame sizes of the uplinks: empty frame, small and large application
+ * payloads, with and without MAC commands
+ */
+static const uint8_t FrameSizes[] = {13, 24, 27, 64};
+
+typedef enum eCycleSource
+{
+	CYCLES_NONE,
+	CYCLES_PERF,
+	CYCLES_RDTSC,
+} CycleSource_t;
+
+static const char *CycleSourceNames[] = {"none", "perf_event", "rdtsc"};
+
+static CycleSource_t CycleSource = CYCLES_NONE;
+static int PerfFd = -1;
+
+static volatile uint32_t Sink;
+
+/*
+ * Symbols of the MAC and the board layer used by the regions
+ */
+
+LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[6];
+
+TimerTime_t TimerGetCurrentTime(void)
+{
+	return 0;
+}
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t past)
+{
+	(void)past;
+	return 0;
+}
+
+void HAL_Delay(uint32_t delay)
+{
+	(void)delay;
+}
+
+/*
+ * Radio stub, keeps the TX configuration for the time on air
+ */
+
+static RadioModems_t TxModem;
+static uint32_t TxBandwidth;
+static uint32_t TxDatarate;
+static uint8_t TxCoderate;
+static uint16_t TxPreambleLen;
+static bool TxFixLen;
+static bool TxCrcOn;
+
+static void BenchRadioSetChannel(uint32_t freq)
+{
+	Sink += freq;
+}
+
+static void BenchRadioSetTxConfig(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth, uint32_t datarate, uint8_t coderate, uint16_t preambleLen,
+								  bool fixLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, uint32_t timeout)
+{
+	(void)power;
+	(void)fdev;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+	(void)timeout;
+
+	TxModem = modem;
+	TxBandwidth = bandwidth;
+	TxDatarate = datarate;
+	TxCoderate = coderate;
+	TxPreambleLen = preambleLen;
+	TxFixLen = fixLen;
+	TxCrcOn = crcOn;
+}
+
+static uint32_t BenchRadioTimeOnAir(RadioModems_t modem, uint8_t pktLen)
+{
+	if (modem == MODEM_FSK)
+	{
+		return RadioFskTimeOnAir(TxDatarate, TxPreambleLen, 24, TxFixLen, (TxCrcOn == true) ? 2 : 0, pktLen);
+	}
+	// Low datarate optimization as the SX126x driver sets it
+	bool ldro = ((TxBandwidth == 0) && ((TxDatarate == 11) || (TxDatarate == 12))) || ((TxBandwidth == 1) && (TxDatarate == 12));
+
+	return RadioLoRaTimeOnAir(TxDatarate, 125000 << TxBandwidth, TxCoderate, TxPreambleLen, TxFixLen, ldro, pktLen);
+}
+
+static void BenchRadioSetMaxPayloadLength(RadioModems_t modem, uint8_t max)
+{
+	Sink += modem + max;
+}
+
+const struct Radio_s Radio = {
+	.SetChannel = BenchRadioSetChannel,
+	.SetTxConfig = BenchRadioSetTxConfig,
+	.TimeOnAir = BenchRadioTimeOnAir,
+	.SetMaxPayloadLength = BenchRadioSetMaxPayloadLength,
+};
+
+static void InitCycles(void)
+{
+#if defined(__linux__)
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	PerfFd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (PerfFd >= 0)
+	{
+		ioctl(PerfFd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(PerfFd, PERF_EVENT_IOC_ENABLE, 0);
+		CycleSource = CYCLES_PERF;
+		return;
+	}
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	CycleSource = CYCLES_RDTSC;
+#endif
+}
+
+static uint64_t ReadCycles(void)
+{
+	uint64_t cycles = 0;
+
+	switch (CycleSource)
+	{
+	case CYCLES_PERF:
+#if defined(__linux__)
+		if (read(PerfFd, &cycles, sizeof(cycles)) != sizeof(cycles))
+		{
+			cycles = 0;
+		}
+#endif
+		break;
+	case CYCLES_RDTSC:
+#if defined(__x86_64__) || defined(__i386__)
+		cycles = __rdtsc();
+#endif
+		break;
+	default:
+		break;
+	}
+	return cycles;
+}
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int8_t GetPhyValue(LoRaMacRegion_t region, PhyAttribute_t attribute)
+{
+	GetPhyParams_t getPhy;
+
+	getPhy.Attribute = attribute;
+	getPhy.UplinkDwellTime = 0;
+	getPhy.DownlinkDwellTime = 0;
+	return RegionGetPhyParam(region, &getPhy).Value;
+}
+
+/*!
+ * \brief Runs the uplinks, as ScheduleTx and SendFrame do
+ */
+static void RunUplinks(LoRaMacRegion_t region, uint32_t nbUplinks, int8_t minDr, int8_t maxDr, int8_t rx2Dr)
+{
+	RxConfigParams_t rxWindow1Config;
+	RxConfigParams_t rxWindow2Config;
+	TxConfigParams_t txConfig;
+	TimerTime_t txTimeOnAir;
+	int8_t txPower;
+
+	memset(&txConfig, 0, sizeof(txConfig));
+	txConfig.MaxEirp = 16;
+	txConfig.AntennaGain = 2;
+
+	for (uint32_t i = 0; i < nbUplinks; i++)
+	{
+		int8_t dr = minDr + ((i / 256) % (maxDr - minDr + 1));
+
+		RegionComputeRxWindowParameters(region, RegionApplyDrOffset(region, 0, dr, 0), 6, 10, &rxWindow1Config);
+		RegionComputeRxWindowParameters(region, rx2Dr, 6, 10, &rxWindow2Config);
+
+		txConfig.Datarate = dr;
+		txConfig.PktLen = FrameSizes[i % sizeof(FrameSizes)];
+		RegionTxConfig(region, &txConfig, &txPower, &txTimeOnAir);
+		Sink += rxWindow1Config.WindowTimeout + rxWindow1Config.WindowOffset + rxWindow2Config.WindowOffset + txTimeOnAir;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t nbUplinks = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+	uint8_t nbRegions = sizeof(BenchRegions) / sizeof(BenchRegions[0]);
+
+	InitCycles();
+
+	printf("{\n  \"timing_cache_bits\": %u,\n  \"cycles\": \"%s\",\n  \"uplinks\": %u,\n  \"regions\": [\n",
+		   REGION_COMMON_TIMING_CACHE_BITS, CycleSourceNames[CycleSource], nbUplinks);
+	for (uint8_t r = 0; r < nbRegions; r++)
+	{
+		const BenchRegion_t *bench = &BenchRegions[r];
+		double bestNs = 0;
+		double bestCycles = 0;
+		int8_t minDr, maxDr, rx2Dr;
+
+		RegionInitDefaults(bench->Region, INIT_TYPE_INIT);
+		RegionCommonClearTimingCache();
+		minDr = GetPhyValue(bench->Region, PHY_MIN_TX_DR);
+		maxDr = GetPhyValue(bench->Region, PHY_MAX_TX_DR);
+		rx2Dr = GetPhyValue(bench->Region, PHY_DEF_RX2_DR);
+
+		for (uint8_t run = 0; run < NB_RUNS; run++)
+		{
+			uint64_t ns = NowNs();
+			uint64_t cycles = ReadCycles();
+			double runNs, runCycles;
+
+			RunUplinks(bench->Region, nbUplinks, minDr, maxDr, rx2Dr);
+			cycles = ReadCycles() - cycles;
+			ns = NowNs() - ns;
+			runNs = (double)ns / nbUplinks;
+			runCycles = (double)cycles / nbUplinks;
+			if ((run == 0) || (runNs < bestNs))
+			{
+				bestNs = runNs;
+				bestCycles = runCycles;
+			}
+		}
+		printf("    {\"region\": \"%s\", \"symbol_table_bytes\": %u, \"ns_per_uplink\": %.1f, \"cycles_per_uplink\": %.0f}%s\n",
+			   bench->Name, bench->SymbolTableSize, bestNs, bestCycles, (r == (nbRegions - 1)) ? "" : ",");
+	}
+	printf("  ]\n}\n");
+	return 0;
+}
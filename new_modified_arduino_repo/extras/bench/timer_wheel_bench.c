@@ -0,0 +1,311 @@
+/*!
+ * \file      timer_wheel_bench.c
+ *
+ * \brief     Host microbenchmark of the timer wheel against a sorted list
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Compares the hierarchical timer wheel of system/timer_wheel.c
+ *            with a sorted singly linked list, the structure of the usual
+ *            TimerEvent_t implementation of the board layer, for a range of
+ *            concurrently running timers. Two workloads are measured:
+ *
+ *            churn         - tickless loop: query the next deadline, expire
+ *                            the timer, start it again and restart another
+ *                            random timer, like the MAC does with its RX
+ *                            window and ACK timers. The delays mix short
+ *                            radio timeouts (up to 5 s) and long application
+ *                            periods (up to 10 min), in 1 ms ticks.
+ *            insert_cancel - start all timers, then stop them in random
+ *                            order.
+ *
+ *            Both implementations process the same sequence, the order of
+ *            the expired timers is checked to be identical. The results are
+ *            written to stdout as JSON.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -Isystem extras/bench/timer_wheel_bench.c \
+ *               system/timer_wheel.c -o timer_wheel_bench
+ *
+ *            Usage: timer_wheel_bench [churn operations]
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "timer_wheel.h"
+
+/*!
+ * Numbers of concurrently running timers
+ */
+static const uint32_t NbTimersList[] = {16, 128, 1024, 4096, 16384};
+
+/*!
+ * Timer of the sorted list
+ */
+typedef struct sListTimer
+{
+	struct sListTimer *Next;
+	TimerWheelTime_t Expiry;
+	bool IsRunning;
+} ListTimer_t;
+
+/*!
+ * Timer of the benchmark, usable by both implementations
+ */
+typedef struct sBenchTimer
+{
+	TimerWheelNode_t Node;
+	ListTimer_t List;
+	uint32_t Id;
+} BenchTimer_t;
+
+typedef enum eImpl
+{
+	IMPL_WHEEL,
+	IMPL_SORTED_LIST,
+} Impl_t;
+
+static const char *ImplNames[] = {"wheel", "sorted_list"};
+
+static BenchTimer_t *Timers;
+static TimerWheel_t Wheel;
+static ListTimer_t *ListHead;
+static TimerWheelTime_t ListNow;
+static uint64_t RandomState;
+static bool FirstResult = true;
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint32_t Random(void)
+{
+	RandomState ^= RandomState << 13;
+	RandomState ^= RandomState >> 7;
+	RandomState ^= RandomState << 17;
+	return (uint32_t)RandomState;
+}
+
+/*!
+ * \brief Returns the delay of a timer start [ms]
+ */
+static uint32_t RandomDelay(void)
+{
+	uint32_t r = Random();
+
+	return ((r & 1) == 0) ? 1 + (r >> 1) % 5000 : 1 + (r >> 1) % 600000;
+}
+
+static void ListInsert(ListTimer_t *timer, TimerWheelTime_t expiry)
+{
+	ListTimer_t **link = &ListHead;
+
+	// Timers with the same expiry expire in start order
+	while ((*link != NULL) && ((*link)->Expiry <= expiry))
+	{
+		link = &(*link)->Next;
+	}
+	timer->Expiry = expiry;
+	timer->Next = *link;
+	timer->IsRunning = true;
+	*link = timer;
+}
+
+static void ListRemove(ListTimer_t *timer)
+{
+	ListTimer_t **link = &ListHead;
+
+	while (*link != timer)
+	{
+		link = &(*link)->Next;
+	}
+	*link = timer->Next;
+	timer->IsRunning = false;
+}
+
+static void Start(Impl_t impl, BenchTimer_t *timer, uint32_t delay)
+{
+	if (impl == IMPL_WHEEL)
+	{
+		TimerWheelInsert(&Wheel, &timer->Node, Wheel.Now + delay);
+	}
+	else
+	{
+		ListInsert(&timer->List, ListNow + delay);
+	}
+}
+
+static void Stop(Impl_t impl, BenchTimer_t *timer)
+{
+	if (impl == IMPL_WHEEL)
+	{
+		if (TimerWheelIsQueued(&timer->Node) == true)
+		{
+			TimerWheelRemove(&Wheel, &timer->Node);
+		}
+	}
+	else if (timer->List.IsRunning == true)
+	{
+		ListRemove(&timer->List);
+	}
+}
+
+/*!
+ * \brief Expires the next timer like a tickless timer interrupt
+ *
+ * \retval Expired timer
+ */
+static BenchTimer_t *ExpireNext(Impl_t impl)
+{
+	if (impl == IMPL_WHEEL)
+	{
+		TimerWheelTime_t next;
+
+		TimerWheelNextExpiry(&Wheel, &next);
+		return (BenchTimer_t *)TimerWheelExpire(&Wheel, next);
+	}
+	else
+	{
+		ListTimer_t *timer = ListHead;
+
+		ListNow = timer->Expiry;
+		ListHead = timer->Next;
+		timer->IsRunning = false;
+		return (BenchTimer_t *)((uint8_t *)timer - offsetof(BenchTimer_t, List));
+	}
+}
+
+static void Reset(uint32_t nbTimers)
+{
+	TimerWheelInit(&Wheel, 0);
+	ListHead = NULL;
+	ListNow = 0;
+	RandomState = 0x9E3779B97F4A7C15ull;
+	for (uint32_t i = 0; i < nbTimers; i++)
+	{
+		memset(&Timers[i], 0, sizeof(BenchTimer_t));
+		Timers[i].Id = i;
+	}
+}
+
+static void PrintResult(Impl_t impl, const char *workload, uint32_t nbTimers, uint32_t operations, uint64_t ns, uint64_t checksum)
+{
+	printf("%s\n    {\"impl\": \"%s\", \"workload\": \"%s\", \"timers\": %u, \"operations\": %u, \"ns_per_op\": %.1f, "
+		   "\"checksum\": \"%016llx\"}",
+		   (FirstResult == true) ? "" : ",", ImplNames[impl], workload, nbTimers, operations, (double)ns / operations,
+		   (unsigned long long)checksum);
+	FirstResult = false;
+}
+
+/*!
+ * \brief Runs the churn workload
+ *
+ * \retval Checksum of the expired timers and their expiry times
+ */
+static uint64_t Churn(Impl_t impl, uint32_t nbTimers, uint32_t operations)
+{
+	uint64_t checksum = 0;
+	uint64_t start;
+
+	Reset(nbTimers);
+	for (uint32_t i = 0; i < nbTimers; i++)
+	{
+		Start(impl, &Timers[i], RandomDelay());
+	}
+
+	start = NowNs();
+	for (uint32_t i = 0; i < operations; i++)
+	{
+		BenchTimer_t *timer = ExpireNext(impl);
+		BenchTimer_t *other = &Timers[Random() % nbTimers];
+
+		checksum = (checksum ^ timer->Id) * 0x100000001B3ull + ((impl == IMPL_WHEEL) ? Wheel.Now : ListNow);
+		Start(impl, timer, RandomDelay());
+		Stop(impl, other);
+		Start(impl, other, RandomDelay());
+	}
+	PrintResult(impl, "churn", nbTimers, operations, NowNs() - start, checksum);
+	return checksum;
+}
+
+static void InsertCancel(Impl_t impl, uint32_t nbTimers)
+{
+	uint32_t *order = malloc(nbTimers * sizeof(uint32_t));
+	uint64_t start;
+
+	Reset(nbTimers);
+	for (uint32_t i = 0; i < nbTimers; i++)
+	{
+		order[i] = i;
+	}
+	for (uint32_t i = nbTimers - 1; i > 0; i--)
+	{
+		uint32_t j = Random() % (i + 1);
+		uint32_t tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	start = NowNs();
+	for (uint32_t i = 0; i < nbTimers; i++)
+	{
+		Start(impl, &Timers[i], RandomDelay());
+	}
+	for (uint32_t i = 0; i < nbTimers; i++)
+	{
+		Stop(impl, &Timers[order[i]]);
+	}
+	PrintResult(impl, "insert_cancel", nbTimers, 2 * nbTimers, NowNs() - start, 0);
+	free(order);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t operations = (argc > 1) ? atoi(argv[1]) : 20000;
+	uint32_t maxTimers = NbTimersList[sizeof(NbTimersList) / sizeof(NbTimersList[0]) - 1];
+	bool match = true;
+
+	if (operations == 0)
+	{
+		fprintf(stderr, "usage: %s [churn operations]\n", argv[0]);
+		return 1;
+	}
+	Timers = malloc(maxTimers * sizeof(BenchTimer_t));
+	if (Timers == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	printf("{\n  \"benchmark\": \"timer_wheel\",\n  \"slot_bits\": %u,\n  \"levels\": %u,\n  \"wheel_size\": %u,\n"
+		   "  \"results\": [",
+		   TIMER_WHEEL_SLOT_BITS, TIMER_WHEEL_LEVELS, (unsigned)sizeof(TimerWheel_t));
+
+	for (uint32_t i = 0; i < sizeof(NbTimersList) / sizeof(NbTimersList[0]); i++)
+	{
+		uint32_t nbTimers = NbTimersList[i];
+
+		if (Churn(IMPL_WHEEL, nbTimers, operations) != Churn(IMPL_SORTED_LIST, nbTimers, operations))
+		{
+			match = false;
+		}
+		InsertCancel(IMPL_WHEEL, nbTimers);
+		InsertCancel(IMPL_SORTED_LIST, nbTimers);
+	}
+
+	printf("\n  ],\n  \"expiry_order_match\": %s\n}\n", (match == true) ? "true" : "false");
+	free(Timers);
+
+	return (match == true) ? 0 : 1;
+}
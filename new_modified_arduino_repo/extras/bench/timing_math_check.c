@@ -0,0 +1,438 @@
+/*!
+ * \file      timing_math_check.c
+ *
+ * \brief     Exhaustive check of the integer timing math against the former
+ *            floating point implementation
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Compares RegionCommonComputeSymbolTimeLoRa/Fsk,
+ *            RegionCommonComputeRxWindowParameters, RadioLoRaTimeOnAir and
+ *            RadioFskTimeOnAir with the double versions they replace, copied
+ *            below, over their whole domain:
+ *
+ *            symbol_time - SF7..12 x 125/250/500 kHz, FSK 50 kbps
+ *            rx_window   - each symbol time x minRxSymbols 4..255 x
+ *                          rxError 0..2000 ms x wakeUpTime 0..3 ms
+ *            lora_toa    - SF7..12 x 125/250/500 kHz x CR 4/5..4/8 x
+ *                          preamble 0..255 and 1023, 4095, 65535 symbols x
+ *                          explicit/implicit header x LDRO off/on x
+ *                          payload 0..255 bytes
+ *            fsk_toa     - bitrates 600..300000 bps x preamble 0..16 bytes x
+ *                          sync word 0..64 bits x length byte x CRC 0..2
+ *                          bytes x payload 0..255 bytes
+ *
+ *            Where the exact value to round is an integer (RX window) or
+ *            lies halfway between two (FSK time on air, rounded to the
+ *            nearest), the rounding error of the double computation decides
+ *            the result: the double RX window gets one symbol or 1 ms more
+ *            than the formula gives, the double FSK time on air goes up or
+ *            down. The integer versions give the exact result. These points
+ *            are checked to be such ties and reported as double_rounding,
+ *            any other difference as a mismatch. The run fails on a
+ *            mismatch.
+ *
+ *            The time per call of both implementations is reported too.
+ *            This host has an FPU, an MCU without one runs the double
+ *            versions in the soft float library.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/bench/timing_math_check.c mac/region/RegionCommon.c \
+ *               radio/sx126x/radio_toa.c system/utilities.c -lm \
+ *               -o timing_math_check
+ *
+ *            Usage: timing_math_check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include "utilities.h"
+#include "RegionCommon.h"
+#include "radio_toa.h"
+
+static const uint32_t Bandwidths[] = {125000, 250000, 500000};
+
+/*!
+ * Symbol time of the timing checks, LoRa or FSK
+ */
+typedef struct sSymbolConfig
+{
+	uint8_t PhyDr;
+	uint32_t Bandwidth;
+	bool Fsk;
+} SymbolConfig_t;
+
+static SymbolConfig_t SymbolConfigs[19];
+static uint8_t NbSymbolConfigs;
+
+/*!
+ * Counters of a check
+ */
+typedef struct sCheckResult
+{
+	uint64_t NbCases;
+	uint64_t NbDoubleRounding;
+	uint64_t NbMismatches;
+} CheckResult_t;
+
+/*
+ * Double versions, as they were before the integer implementation
+ */
+
+static double RefSymbolTimeLoRa(uint8_t phyDr, uint32_t bandwidth)
+{
+	return ((double)(1 << phyDr) / (double)bandwidth) * 1000;
+}
+
+static double RefSymbolTimeFsk(uint8_t phyDr)
+{
+	return (8.0 / (double)phyDr); // 1 symbol equals 1 byte
+}
+
+static void RefRxWindowParameters(double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset)
+{
+	*windowTimeout = T_MAX((uint32_t)ceil(((2 * minRxSymbols - 8) * tSymbol + 2 * rxError) / tSymbol), minRxSymbols); // Computed number of symbols
+	*windowOffset = (int32_t)ceil((4.0 * tSymbol) - ((*windowTimeout * tSymbol) / 2.0) - wakeUpTime);
+}
+
+//                                          SF12    SF11    SF10    SF9    SF8    SF7
+static double RadioLoRaSymbTime[3][6] = {{32.768, 16.384, 8.192, 4.096, 2.048, 1.024}, // 125 KHz
+										 {16.384, 8.192, 4.096, 2.048, 1.024, 0.512},  // 250 KHz
+										 {8.192, 4.096, 2.048, 1.024, 0.512, 0.256}};  // 500 KHz
+
+static uint32_t RefLoRaTimeOnAir(uint8_t sf, uint8_t bwIndex, uint8_t cr, uint16_t preambleLen, bool fixLen, bool ldro, uint8_t pktLen)
+{
+	double ts = RadioLoRaSymbTime[bwIndex][12 - sf];
+	// time of preamble
+	double tPreamble = (preambleLen + 4.25) * ts;
+	// Symbol length of payload and time
+	double tmp = ceil((8 * pktLen - 4 * sf + 28 + 16 * cr - ((fixLen == true) ? 20 : 0)) /
+					  (double)(4 * (sf - ((ldro == true) ? 2 : 0)))) *
+				 ((cr % 4) + 4);
+	double nPayload = 8 + ((tmp > 0) ? tmp : 0);
+	double tPayload = nPayload * ts;
+	// Time on air
+	double tOnAir = tPreamble + tPayload;
+	// return milli seconds
+	return floor(tOnAir + 0.999);
+}
+
+static uint32_t RefFskTimeOnAir(uint32_t bitrate, uint16_t preambleLen, uint8_t syncWordLen, bool fixLen, uint8_t crcLen, uint8_t pktLen)
+{
+	return rint((8 * (preambleLen + (syncWordLen >> 3) + ((fixLen == true) ? 0.0 : 1.0) + pktLen + (crcLen)) / bitrate) * 1e3);
+}
+
+/*!
+ * RegionCommon.c uses the timer layer for the band time off and the radio
+ * for the time on air memo cache, which are not checked here
+ */
+TimerTime_t TimerGetElapsedTime(TimerTime_t past)
+{
+	(void)past;
+	return 0;
+}
+
+const struct Radio_s Radio;
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void InitSymbolConfigs(void)
+{
+	for (uint8_t sf = 7; sf <= 12; sf++)
+	{
+		for (uint8_t bw = 0; bw < 3; bw++)
+		{
+			SymbolConfigs[NbSymbolConfigs++] = (SymbolConfig_t){sf, Bandwidths[bw], false};
+		}
+	}
+	SymbolConfigs[NbSymbolConfigs++] = (SymbolConfig_t){50, 0, true};
+}
+
+static double RefSymbolTime(const SymbolConfig_t *config)
+{
+	return (config->Fsk == true) ? RefSymbolTimeFsk(config->PhyDr) : RefSymbolTimeLoRa(config->PhyDr, config->Bandwidth);
+}
+
+static uint32_t SymbolTime(const SymbolConfig_t *config)
+{
+	return (config->Fsk == true) ? RegionCommonComputeSymbolTimeFsk(config->PhyDr) : RegionCommonComputeSymbolTimeLoRa(config->PhyDr, config->Bandwidth);
+}
+
+static void PrintResult(const char *name, const CheckResult_t *result, bool last)
+{
+	printf("    \"%s\": {\"cases\": %llu, \"double_rounding\": %llu, \"mismatches\": %llu}%s\n", name,
+		   (unsigned long long)result->NbCases, (unsigned long long)result->NbDoubleRounding,
+		   (unsigned long long)result->NbMismatches, (last == true) ? "" : ",");
+}
+
+static void CheckSymbolTime(CheckResult_t *result)
+{
+	for (uint8_t i = 0; i < NbSymbolConfigs; i++)
+	{
+		result->NbCases++;
+		if (RefSymbolTime(&SymbolConfigs[i]) * 1000 != (double)SymbolTime(&SymbolConfigs[i]))
+		{
+			result->NbMismatches++;
+		}
+	}
+}
+
+/*!
+ * \brief Checks that a difference of the RX window parameters comes from the
+ *        double rounding: each double result is the integer one, or one
+ *        above where the exact quotient is an integer
+ */
+static bool IsRxWindowDoubleRounding(uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime,
+									 uint32_t refTimeout, int32_t refOffset, uint32_t timeout)
+{
+	int32_t timeoutNum = (2 * minRxSymbols - 8) * (int32_t)tSymbol + 2000 * (int32_t)rxError;
+	// Offset of the window of the double timeout [ms / 2000]
+	int32_t offsetNum = (8 - (int32_t)refTimeout) * (int32_t)tSymbol;
+	int32_t offset = ((offsetNum > 0) ? ((offsetNum + 1999) / 2000) : (offsetNum / 2000)) - (int32_t)wakeUpTime;
+
+	if ((refTimeout != timeout) && (((timeoutNum % (int32_t)tSymbol) != 0) || (refTimeout != (timeout + 1))))
+	{
+		return false;
+	}
+	return (refOffset == offset) || (((offsetNum % 2000) == 0) && (refOffset == (offset + 1)));
+}
+
+static void CheckRxWindow(CheckResult_t *result)
+{
+	for (uint8_t i = 0; i < NbSymbolConfigs; i++)
+	{
+		double refTSymbol = RefSymbolTime(&SymbolConfigs[i]);
+		uint32_t tSymbol = SymbolTime(&SymbolConfigs[i]);
+
+		for (uint32_t minRxSymbols = 4; minRxSymbols <= 255; minRxSymbols++)
+		{
+			for (uint32_t rxError = 0; rxError <= 2000; rxError++)
+			{
+				for (uint32_t wakeUpTime = 0; wakeUpTime <= 3; wakeUpTime++)
+				{
+					uint32_t refTimeout, timeout;
+					int32_t refOffset, offset;
+
+					RefRxWindowParameters(refTSymbol, minRxSymbols, rxError, wakeUpTime, &refTimeout, &refOffset);
+					RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, wakeUpTime, &timeout, &offset);
+					result->NbCases++;
+					if ((refTimeout == timeout) && (refOffset == offset))
+					{
+						continue;
+					}
+
+					if (IsRxWindowDoubleRounding(tSymbol, minRxSymbols, rxError, wakeUpTime, refTimeout, refOffset, timeout) == true)
+					{
+						result->NbDoubleRounding++;
+					}
+					else
+					{
+						result->NbMismatches++;
+						if (result->NbMismatches <= 10)
+						{
+							fprintf(stderr, "rx_window phyDr %u bw %u m %u e %u w %u: double %u %d, integer %u %d\n",
+									SymbolConfigs[i].PhyDr, SymbolConfigs[i].Bandwidth, minRxSymbols, rxError, wakeUpTime,
+									refTimeout, refOffset, timeout, offset);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+static void CheckLoRaTimeOnAir(CheckResult_t *result)
+{
+	static const uint16_t longPreambles[] = {1023, 4095, 65535};
+
+	for (uint8_t sf = 7; sf <= 12; sf++)
+	{
+		for (uint8_t bw = 0; bw < 3; bw++)
+		{
+			for (uint8_t cr = 1; cr <= 4; cr++)
+			{
+				for (uint32_t p = 0; p < (256 + sizeof(longPreambles) / sizeof(longPreambles[0])); p++)
+				{
+					uint16_t preambleLen = (p < 256) ? p : longPreambles[p - 256];
+
+					for (uint8_t flags = 0; flags < 4; flags++)
+					{
+						bool fixLen = (flags & 0x01) != 0;
+						bool ldro = (flags & 0x02) != 0;
+
+						for (uint32_t pktLen = 0; pktLen <= 255; pktLen++)
+						{
+							uint32_t ref = RefLoRaTimeOnAir(sf, bw, cr, preambleLen, fixLen, ldro, pktLen);
+							uint32_t toa = RadioLoRaTimeOnAir(sf, Bandwidths[bw], cr, preambleLen, fixLen, ldro, pktLen);
+
+							result->NbCases++;
+							if (ref != toa)
+							{
+								result->NbMismatches++;
+								if (result->NbMismatches <= 10)
+								{
+									fprintf(stderr, "lora_toa sf %u bw %u cr %u p %u fix %u ldro %u len %u: double %u, integer %u\n",
+											sf, Bandwidths[bw], cr, preambleLen, fixLen, ldro, pktLen, ref, toa);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+static void CheckFskTimeOnAir(CheckResult_t *result)
+{
+	for (uint32_t bitrate = 600; bitrate <= 300000; bitrate += (bitrate < 10000) ? 100 : 1000)
+	{
+		for (uint16_t preambleLen = 0; preambleLen <= 16; preambleLen++)
+		{
+			for (uint8_t syncWordLen = 0; syncWordLen <= 64; syncWordLen += 8)
+			{
+				for (uint8_t flags = 0; flags < 6; flags++)
+				{
+					bool fixLen = (flags & 0x01) != 0;
+					uint8_t crcLen = flags >> 1;
+
+					for (uint32_t pktLen = 0; pktLen <= 255; pktLen++)
+					{
+						uint32_t ref = RefFskTimeOnAir(bitrate, preambleLen, syncWordLen, fixLen, crcLen, pktLen);
+						uint32_t toa = RadioFskTimeOnAir(bitrate, preambleLen, syncWordLen, fixLen, crcLen, pktLen);
+						uint32_t nBits = 8 * (preambleLen + (syncWordLen >> 3) + ((fixLen == true) ? 0 : 1) + pktLen + crcLen);
+
+						result->NbCases++;
+						if (ref == toa)
+						{
+							continue;
+						}
+						// A tie is rounded either way by the double rounding noise
+						if (((2 * ((nBits * 1000) % bitrate)) == bitrate) && (((ref + 1) == toa) || (ref == (toa + 1))))
+						{
+							result->NbDoubleRounding++;
+						}
+						else
+						{
+							result->NbMismatches++;
+							if (result->NbMismatches <= 10)
+							{
+								fprintf(stderr, "fsk_toa br %u p %u sync %u fix %u crc %u len %u: double %u, integer %u\n",
+										bitrate, preambleLen, syncWordLen, fixLen, crcLen, pktLen, ref, toa);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Timings, over the LoRa symbol times with the default minRxSymbols and
+ * rxError, and over all payload lengths. The volatile sink keeps the calls.
+ */
+
+static volatile uint32_t Sink;
+
+static double TimeRefRxWindow(uint32_t rounds)
+{
+	uint64_t start = NowNs();
+
+	for (uint32_t r = 0; r < rounds; r++)
+	{
+		for (uint8_t i = 0; i < (NbSymbolConfigs - 1); i++)
+		{
+			uint32_t timeout;
+			int32_t offset;
+
+			RefRxWindowParameters(RefSymbolTimeLoRa(SymbolConfigs[i].PhyDr, SymbolConfigs[i].Bandwidth), 6, 10 + (r & 0x07), 1, &timeout, &offset);
+			Sink += timeout + offset;
+		}
+	}
+	return (double)(NowNs() - start) / ((double)rounds * (NbSymbolConfigs - 1));
+}
+
+static double TimeRxWindow(uint32_t rounds)
+{
+	uint64_t start = NowNs();
+
+	for (uint32_t r = 0; r < rounds; r++)
+	{
+		for (uint8_t i = 0; i < (NbSymbolConfigs - 1); i++)
+		{
+			uint32_t timeout;
+			int32_t offset;
+
+			RegionCommonComputeRxWindowParameters(RegionCommonComputeSymbolTimeLoRa(SymbolConfigs[i].PhyDr, SymbolConfigs[i].Bandwidth), 6, 10 + (r & 0x07), 1, &timeout, &offset);
+			Sink += timeout + offset;
+		}
+	}
+	return (double)(NowNs() - start) / ((double)rounds * (NbSymbolConfigs - 1));
+}
+
+static double TimeRefLoRaTimeOnAir(uint32_t rounds)
+{
+	uint64_t start = NowNs();
+
+	for (uint32_t r = 0; r < rounds; r++)
+	{
+		for (uint32_t pktLen = 0; pktLen <= 255; pktLen++)
+		{
+			Sink += RefLoRaTimeOnAir(7 + (r % 6), r % 3, 1, 8, false, (r % 6) >= 4, pktLen);
+		}
+	}
+	return (double)(NowNs() - start) / ((double)rounds * 256);
+}
+
+static double TimeLoRaTimeOnAir(uint32_t rounds)
+{
+	uint64_t start = NowNs();
+
+	for (uint32_t r = 0; r < rounds; r++)
+	{
+		for (uint32_t pktLen = 0; pktLen <= 255; pktLen++)
+		{
+			Sink += RadioLoRaTimeOnAir(7 + (r % 6), Bandwidths[r % 3], 1, 8, false, (r % 6) >= 4, pktLen);
+		}
+	}
+	return (double)(NowNs() - start) / ((double)rounds * 256);
+}
+
+int main(void)
+{
+	CheckResult_t symbolTime = {0}, rxWindow = {0}, loraToa = {0}, fskToa = {0};
+	bool success;
+
+	InitSymbolConfigs();
+	CheckSymbolTime(&symbolTime);
+	CheckRxWindow(&rxWindow);
+	CheckLoRaTimeOnAir(&loraToa);
+	CheckFskTimeOnAir(&fskToa);
+	success = (symbolTime.NbMismatches + rxWindow.NbMismatches + loraToa.NbMismatches + fskToa.NbMismatches) == 0;
+
+	printf("{\n  \"checks\": {\n");
+	PrintResult("symbol_time", &symbolTime, false);
+	PrintResult("rx_window", &rxWindow, false);
+	PrintResult("lora_toa", &loraToa, false);
+	PrintResult("fsk_toa", &fskToa, true);
+	printf("  },\n  \"ns_per_call\": {\n");
+	printf("    \"rx_window\": {\"double\": %.2f, \"integer\": %.2f},\n", TimeRefRxWindow(200000), TimeRxWindow(200000));
+	printf("    \"lora_toa\": {\"double\": %.2f, \"integer\": %.2f}\n", TimeRefLoRaTimeOnAir(20000), TimeLoRaTimeOnAir(20000));
+	printf("  },\n  \"success\": %s\n}\n", (success == true) ? "true" : "false");
+
+	return (success == true) ? 0 : 1;
+}
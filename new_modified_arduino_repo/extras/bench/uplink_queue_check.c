@@ -0,0 +1,533 @@
+/*!
+ * \file      uplink_queue_check.c
+ *
+ * \brief     Host check of the coalescing uplink queue of the LoRaMac helper
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs lmh_queue_send, lmh_queue_flush and the queue timer of
+ *            LoRaMacHelper.c on a virtual clock, against a model of the MAC:
+ *            the maximum payload is set by the check, an uplink keeps the MAC
+ *            busy for its time on air and the receive windows and starts a
+ *            1 % duty cycle time off, which LoRaMacQueryTxDelay reports.
+ *            The frames handed to LoRaMacMcpsRequest are recorded and
+ *            compared with the expected ones:
+ *
+ *            size         - a record larger than the maximum payload is
+ *                           rejected, a full frame is sent at once
+ *            age          - a record waits for the maximum age, not longer
+ *            merge        - records of the same port and confirmation type
+ *                           share a frame, in the order they were queued
+ *            duty_cycle   - a due frame waits for the time off and takes
+ *                           the records queued meanwhile
+ *            back_pressure - a full queue returns LMH_BUSY, sends what it
+ *                           holds and accepts records again once drained
+ *            drop         - a record which does not fit anymore after the
+ *                           datarate dropped is counted by lmh_queue_dropped
+ *
+ *            The results are written to stdout as JSON. The exit code is 1
+ *            if a case fails.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -DLIB_DEBUG=0 -Iextras/sim/host -I. -Isystem \
+ *               -Isystem/crypto -Iradio -Iradio/sx126x/sx126x_driver/src \
+ *               -Imac -Imac/region extras/bench/uplink_queue_check.c mac/LoRaMacHelper.c \
+ *               system/utilities.c -o uplink_queue_check
+ *
+ *            Usage: uplink_queue_check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "utilities.h"
+#include "timer.h"
+#include "LoRaMac.h"
+#include "LoRaMacContext.h"
+#include "LoRaMacHelper.h"
+#include "RegionCommon.h"
+
+extern bool lmh_mac_is_busy;
+
+#define MAX_TIMERS 8
+#define MAX_FRAMES 64
+
+/*!
+ * Time the receive windows keep the MAC busy after an uplink [ms]
+ */
+#define RX_WINDOWS_TIME 2000
+
+/*!
+ * Maximum age used by the check [ms]
+ */
+#define MAX_AGE 10000
+
+/*!
+ * Uplink handed to the MAC
+ */
+typedef struct sFrame
+{
+	TimerTime_t Time;
+	uint8_t Port;
+	bool Confirmed;
+	uint8_t Size;
+	uint8_t Data[LORAWAN_APP_DATA_MAX_SIZE];
+} Frame_t;
+
+static TimerTime_t Now;
+static TimerEvent_t *Timers[MAX_TIMERS];
+static TimerTime_t Expiry[MAX_TIMERS];
+static uint8_t NbTimers;
+
+static LoRaMacContext_t DefaultCtx;
+static LoRaMacPrimitives_t *Primitives;
+static McpsConfirm_t Confirm;
+static TimerEvent_t ConfirmTimer;
+static uint8_t MaxPayload = 51;
+static TimerTime_t NextTxTime;
+
+static Frame_t Frames[MAX_FRAMES];
+static uint8_t NbFrames;
+
+static bool FirstResult = true;
+static uint32_t Failures;
+
+/******************************************************************************
+ * Virtual clock
+ *****************************************************************************/
+void TimerInit(TimerEvent_t *obj, void (*callback)(void))
+{
+	obj->Callback = callback;
+	obj->IsRunning = false;
+	obj->ReloadValue = 0;
+	if (NbTimers < MAX_TIMERS)
+	{
+		Timers[NbTimers++] = obj;
+	}
+}
+
+void TimerSetValue(TimerEvent_t *obj, uint32_t value)
+{
+	obj->ReloadValue = value;
+}
+
+void TimerStart(TimerEvent_t *obj)
+{
+	for (uint8_t i = 0; i < NbTimers; i++)
+	{
+		if (Timers[i] == obj)
+		{
+			Expiry[i] = Now + obj->ReloadValue;
+			obj->IsRunning = true;
+		}
+	}
+}
+
+void TimerStop(TimerEvent_t *obj)
+{
+	obj->IsRunning = false;
+}
+
+TimerTime_t TimerGetCurrentTime(void)
+{
+	return Now;
+}
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t savedTime)
+{
+	return Now - savedTime;
+}
+
+/*!
+ * \brief Advances the clock to the given time, running the timers due
+ */
+static void RunUntil(TimerTime_t time)
+{
+	while (1)
+	{
+		int8_t next = -1;
+
+		for (uint8_t i = 0; i < NbTimers; i++)
+		{
+			if ((Timers[i]->IsRunning == true) && (Expiry[i] <= time) &&
+				((next < 0) || (Expiry[i] < Expiry[next])))
+			{
+				next = i;
+			}
+		}
+		if (next < 0)
+		{
+			break;
+		}
+		Now = Expiry[next];
+		Timers[next]->IsRunning = false;
+		Timers[next]->Callback();
+	}
+	Now = time;
+}
+
+/******************************************************************************
+ * MAC model
+ *****************************************************************************/
+static void OnConfirm(void)
+{
+	lmh_mac_is_busy = false;
+	Primitives->MacMcpsConfirm(&Confirm);
+}
+
+LoRaMacStatus_t LoRaMacInitialization(const LoRaMacInitParams_t *params)
+{
+	Primitives = params->primitives;
+	TimerInit(&ConfirmTimer, OnConfirm);
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo)
+{
+	txInfo->CurrentPayloadSize = MaxPayload;
+	txInfo->MaxPossiblePayload = MaxPayload;
+	return (size > MaxPayload) ? LORAMAC_STATUS_LENGTH_ERROR : LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacQueryTxDelay(TimerTime_t *delay)
+{
+	if (ConfirmTimer.IsRunning == true)
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
+	*delay = ((int32_t)(NextTxTime - Now) > 0) ? (NextTxTime - Now) : 0;
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
+{
+	Frame_t *frame = &Frames[NbFrames % MAX_FRAMES];
+	TimerTime_t timeOnAir;
+
+	if ((ConfirmTimer.IsRunning == true) || ((int32_t)(NextTxTime - Now) > 0))
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
+
+	frame->Time = Now;
+	frame->Confirmed = (mcpsRequest->Type == MCPS_CONFIRMED);
+	if (frame->Confirmed == true)
+	{
+		frame->Port = mcpsRequest->Req.Confirmed.fPort;
+		frame->Size = mcpsRequest->Req.Confirmed.fBufferSize;
+		memcpy(frame->Data, mcpsRequest->Req.Confirmed.fBuffer, frame->Size);
+	}
+	else
+	{
+		frame->Port = mcpsRequest->Req.Unconfirmed.fPort;
+		frame->Size = mcpsRequest->Req.Unconfirmed.fBufferSize;
+		memcpy(frame->Data, mcpsRequest->Req.Unconfirmed.fBuffer, frame->Size);
+	}
+	NbFrames++;
+
+	timeOnAir = 50 + 2 * frame->Size;
+	NextTxTime = Now + timeOnAir * 100;
+	Confirm.McpsRequest = mcpsRequest->Type;
+	Confirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+	Confirm.AckReceived = frame->Confirmed;
+	TimerSetValue(&ConfirmTimer, timeOnAir + RX_WINDOWS_TIME);
+	TimerStart(&ConfirmTimer);
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacContext_t *LoRaMacGetDefaultContext(void)
+{
+	return &DefaultCtx;
+}
+
+LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
+{
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
+{
+	memset(&mibGet->Param, 0, sizeof(mibGet->Param));
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest)
+{
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacPrecomputeUplink(uint8_t fPort, uint8_t size)
+{
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacRestoreSession(struct sLoRaMacNvm *nvm)
+{
+	return LORAMAC_STATUS_NO_NETWORK_JOINED;
+}
+
+LoRaMacStatus_t LoRaMacStoreSession(void)
+{
+	return LORAMAC_STATUS_OK;
+}
+
+uint32_t LoRaMacGetOTAADevId(void)
+{
+	return 0;
+}
+
+void LoRaMacTestSetDutyCycleOn(bool enable)
+{
+}
+
+void ResetMacCounters(void)
+{
+}
+
+void RegionCommonChanMaskCopy(uint16_t *channelsMaskDest, uint16_t *channelsMaskSrc, uint8_t len)
+{
+	memcpy(channelsMaskDest, channelsMaskSrc, len * sizeof(uint16_t));
+}
+
+bool RegionAS923SetVersion(uint8_t version)
+{
+	return true;
+}
+
+void HAL_Delay(uint32_t delay)
+{
+	RunUntil(Now + delay);
+}
+
+/******************************************************************************
+ * Check
+ *****************************************************************************/
+static void BoardGetUniqueId(uint8_t *id)
+{
+	memset(id, 0x42, 8);
+}
+
+static uint32_t BoardGetRandomSeed(void)
+{
+	return 1;
+}
+
+static lmh_callback_t Callbacks = {BoardGetUniqueId, BoardGetRandomSeed};
+
+static lmh_error_status Queue(uint8_t port, bool confirmed, uint8_t size, uint8_t fill)
+{
+	uint8_t data[LORAWAN_APP_DATA_MAX_SIZE];
+	lmh_app_data_t appData = {data, size, port, 0, 0};
+
+	memset(data, fill, size);
+	return lmh_queue_send(&appData, (confirmed == true) ? LMH_CONFIRMED_MSG : LMH_UNCONFIRMED_MSG);
+}
+
+/*!
+ * \brief Checks that a frame holds the given records, each size bytes of fill
+ */
+static bool FrameIs(uint8_t index, uint8_t port, bool confirmed, const uint8_t *sizes, const uint8_t *fills, uint8_t nbRecords)
+{
+	const Frame_t *frame = &Frames[index];
+	uint8_t offset = 0;
+
+	if ((index >= NbFrames) || (frame->Port != port) || (frame->Confirmed != confirmed))
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < nbRecords; i++)
+	{
+		for (uint8_t j = 0; j < sizes[i]; j++)
+		{
+			if ((offset >= frame->Size) || (frame->Data[offset++] != fills[i]))
+			{
+				return false;
+			}
+		}
+	}
+	return offset == frame->Size;
+}
+
+/*!
+ * \brief Lets the MAC finish and the duty cycle time off pass
+ */
+static void Settle(void)
+{
+	RunUntil(Now + 1000000);
+}
+
+static void Report(const char *name, bool ok)
+{
+	printf("%s\n    {\"case\": \"%s\", \"ok\": %s}", (FirstResult == true) ? "" : ",", name, (ok == true) ? "true" : "false");
+	FirstResult = false;
+	if (ok == false)
+	{
+		Failures++;
+	}
+}
+
+static bool CheckSize(void)
+{
+	uint8_t size = MaxPayload;
+	uint8_t fill = 1;
+	bool ok;
+
+	NbFrames = 0;
+	ok = (Queue(1, false, MaxPayload + 1, 0) == LMH_ERROR) && (lmh_queue_count() == 0);
+	ok = ok && (Queue(1, false, MaxPayload, 1) == LMH_SUCCESS);
+	ok = ok && (NbFrames == 1) && (Frames[0].Time == Now) && FrameIs(0, 1, false, &size, &fill, 1);
+	Settle();
+	return ok && (lmh_queue_count() == 0);
+}
+
+static bool CheckAge(void)
+{
+	TimerTime_t start = Now;
+	uint8_t size = 10;
+	uint8_t fill = 2;
+	bool ok;
+
+	NbFrames = 0;
+	ok = Queue(1, false, size, fill) == LMH_SUCCESS;
+	RunUntil(start + MAX_AGE - 1);
+	ok = ok && (NbFrames == 0) && (lmh_queue_count() == 1);
+	RunUntil(start + MAX_AGE);
+	ok = ok && (NbFrames == 1) && (Frames[0].Time == start + MAX_AGE) && FrameIs(0, 1, false, &size, &fill, 1);
+	Settle();
+	return ok && (lmh_queue_count() == 0);
+}
+
+static bool CheckMerge(void)
+{
+	const uint8_t sizes[] = {10, 12};
+	const uint8_t fills[] = {3, 5};
+	uint8_t size;
+	uint8_t fill;
+	bool ok;
+
+	NbFrames = 0;
+	ok = Queue(1, false, 10, 3) == LMH_SUCCESS;
+	ok = ok && (Queue(2, false, 5, 4) == LMH_SUCCESS);
+	ok = ok && (Queue(1, false, 12, 5) == LMH_SUCCESS);
+	ok = ok && (Queue(1, true, 3, 6) == LMH_SUCCESS);
+	ok = ok && (lmh_queue_flush() == LMH_SUCCESS);
+	Settle();
+
+	ok = ok && (NbFrames == 3) && FrameIs(0, 1, false, sizes, fills, 2);
+	size = 5;
+	fill = 4;
+	ok = ok && FrameIs(1, 2, false, &size, &fill, 1);
+	size = 3;
+	fill = 6;
+	ok = ok && FrameIs(2, 1, true, &size, &fill, 1);
+	return ok && (lmh_queue_count() == 0);
+}
+
+static bool CheckDutyCycle(void)
+{
+	const uint8_t sizes[] = {20, 20};
+	const uint8_t fills[] = {8, 9};
+	uint8_t size = 5;
+	uint8_t fill = 7;
+	TimerTime_t timeOff;
+	bool ok;
+
+	NbFrames = 0;
+	ok = (Queue(1, false, size, fill) == LMH_SUCCESS) && (lmh_queue_flush() == LMH_SUCCESS);
+	ok = ok && (NbFrames == 1) && FrameIs(0, 1, false, &size, &fill, 1);
+	timeOff = NextTxTime;
+
+	// Due after the receive windows, held back by the time off
+	RunUntil(Now + 5000);
+	ok = ok && (Queue(1, false, 20, 8) == LMH_SUCCESS) && (lmh_queue_flush() == LMH_SUCCESS);
+	RunUntil(Now + 500);
+	ok = ok && (Queue(1, false, 20, 9) == LMH_SUCCESS);
+	RunUntil(timeOff - 1);
+	ok = ok && (NbFrames == 1);
+	RunUntil(timeOff);
+	ok = ok && (NbFrames == 2) && (Frames[1].Time == timeOff) && FrameIs(1, 1, false, sizes, fills, 2);
+	Settle();
+	return ok && (lmh_queue_count() == 0);
+}
+
+static bool CheckBackPressure(void)
+{
+	uint16_t accepted = 0;
+	lmh_error_status status;
+	bool ok;
+
+	// Keep the MAC busy
+	NbFrames = 0;
+	ok = Queue(3, false, MaxPayload, 0) == LMH_SUCCESS;
+
+	while ((status = Queue(1, false, 30, accepted)) == LMH_SUCCESS)
+	{
+		accepted++;
+	}
+	ok = ok && (status == LMH_BUSY) && (accepted == LMH_QUEUE_BUFFER_SIZE / (LMH_QUEUE_RECORD_OVERHEAD + 30));
+	Settle();
+
+	// 2 records of 30 bytes do not fit into one frame
+	ok = ok && (NbFrames == accepted + 1) && (lmh_queue_count() == 0);
+	for (uint16_t i = 0; i < accepted; i++)
+	{
+		uint8_t size = 30;
+		uint8_t fill = i;
+
+		ok = ok && FrameIs(i + 1, 1, false, &size, &fill, 1);
+	}
+	ok = ok && (Queue(1, false, 30, 0) == LMH_SUCCESS);
+	lmh_queue_flush();
+	Settle();
+	return ok && (lmh_queue_count() == 0);
+}
+
+static bool CheckDrop(void)
+{
+	uint8_t maxPayload = MaxPayload;
+	uint16_t dropped = lmh_queue_dropped();
+	bool ok;
+
+	NbFrames = 0;
+	ok = Queue(1, false, 40, 1) == LMH_SUCCESS;
+	MaxPayload = 11;
+	ok = ok && (lmh_queue_flush() == LMH_SUCCESS);
+	Settle();
+	MaxPayload = maxPayload;
+	return ok && (NbFrames == 0) && (lmh_queue_count() == 0) && (lmh_queue_dropped() == dropped + 1);
+}
+
+int main(void)
+{
+	lmh_init_params_t params;
+
+	memset(&params, 0, sizeof(params));
+	params.callbacks = &Callbacks;
+	params.lora_param.tx_data_rate = DR_0;
+	params.lora_param.duty_cycle = true;
+	params.otaa = false;
+	params.nodeClass = CLASS_A;
+	params.user_region = LORAMAC_REGION_EU868;
+	Now = 1000;
+	if (lmh_init(&params) != LMH_SUCCESS)
+	{
+		fprintf(stderr, "lmh_init failed\n");
+		return 1;
+	}
+	lmh_queue_set_max_age(MAX_AGE);
+
+	printf("{\n  \"check\": \"uplink_queue\",\n  \"max_payload\": %u,\n  \"queue_size\": %u,\n  \"results\": [", MaxPayload,
+		   LMH_QUEUE_BUFFER_SIZE);
+	Report("size", CheckSize());
+	Report("age", CheckAge());
+	Report("merge", CheckMerge());
+	Report("duty_cycle", CheckDutyCycle());
+	Report("back_pressure", CheckBackPressure());
+	Report("drop", CheckDrop());
+	printf("\n  ],\n  \"failures\": %u\n}\n", Failures);
+
+	return (Failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+/*!
+ * \file      board.h
+ *
+ * \brief     Board definitions for host builds of the fleet simulator
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+#include "timer.h"
+#include "radio.h"
+
+#endif // __BOARD_H__
@@ -0,0 +1,38 @@
+/*!
+ * \file      stm32f4xx_hal.h
+ *
+ * \brief     HAL types needed by the radio headers in host builds of the
+ *            fleet simulator
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#ifndef __STM32F4XX_HAL_H__
+#define __STM32F4XX_HAL_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+	int Instance;
+} SPI_HandleTypeDef;
+
+typedef struct
+{
+	int Instance;
+} GPIO_TypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET,
+} GPIO_PinState;
+
+/*!
+ * \brief Busy wait, used by the blocking helper functions. Returns at once
+ *        in the simulator.
+ *
+ * \param   delay           - Delay [ms]
+ */
+void HAL_Delay(uint32_t delay);
+
+#endif // __STM32F4XX_HAL_H__
@@ -0,0 +1,105 @@
+/*!
+ * \file      timer.h
+ *
+ * \brief     Virtual time timer API of the fleet simulator
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Replaces the timer of the board layer in host builds of the
+ *            simulator. The timers run on the virtual clock of the shard
+ *            which owns the device, see sim_timer.c.
+ */
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "timer_wheel.h"
+
+/*!
+ * Timer time variable definition [ms]
+ */
+typedef uint32_t TimerTime_t;
+
+/*!
+ * Timer object description
+ */
+typedef struct TimerEvent_s
+{
+	/*!
+	 * Timer period [ms]
+	 */
+	uint32_t ReloadValue;
+	/*!
+	 * Set while the timer is queued
+	 */
+	bool IsRunning;
+	/*!
+	 * Function called at the expiry
+	 */
+	void (*Callback)(void);
+	/*!
+	 * MAC instance active at TimerInit, made the active one again before
+	 * the callback is called
+	 */
+	void *Owner;
+	/*!
+	 * Node in the timer wheel of the shard, expiry in virtual time [ms]
+	 */
+	TimerWheelNode_t Node;
+} TimerEvent_t;
+
+/*!
+ * \brief Initializes the timer object
+ *
+ * \param   obj             - Structure containing the timer object parameters
+ * \param   callback        - Function callback called at the end of the timeout
+ */
+void TimerInit(TimerEvent_t *obj, void (*callback)(void));
+
+/*!
+ * \brief Starts the timer, does nothing if it is already running
+ *
+ * \param   obj             - Structure containing the timer object parameters
+ */
+void TimerStart(TimerEvent_t *obj);
+
+/*!
+ * \brief Stops the timer
+ *
+ * \param   obj             - Structure containing the timer object parameters
+ */
+void TimerStop(TimerEvent_t *obj);
+
+/*!
+ * \brief Restarts the timer
+ *
+ * \param   obj             - Structure containing the timer object parameters
+ */
+void TimerReset(TimerEvent_t *obj);
+
+/*!
+ * \brief Stops the timer and sets its new period
+ *
+ * \param   obj             - Structure containing the timer object parameters
+ * \param   value           - New timer timeout value [ms]
+ */
+void TimerSetValue(TimerEvent_t *obj, uint32_t value);
+
+/*!
+ * \brief Returns the current virtual time
+ *
+ * \retval  Current time [ms]
+ */
+TimerTime_t TimerGetCurrentTime(void);
+
+/*!
+ * \brief Returns the virtual time elapsed since a given time
+ *
+ * \param   savedTime       - Fixed moment in time [ms]
+ * \retval  Elapsed time [ms]
+ */
+TimerTime_t TimerGetElapsedTime(TimerTime_t savedTime);
+
+#endif // __TIMER_H__
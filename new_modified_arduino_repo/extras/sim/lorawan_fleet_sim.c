@@ -0,0 +1,1383 @@
+/*!
+ * \file      lorawan_fleet_sim.c
+ *
+ * \brief     Discrete-event simulator of a fleet of devices running the MAC
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Runs thousands of unmodified LoRaMac instances on a virtual
+ *            clock against a single gateway and a network server, faster
+ *            than real time and in several threads. Meant to evaluate duty
+ *            cycle, ADR and channel selection at fleet scale.
+ *
+ *            Devices are placed uniformly in a disc around the gateway. The
+ *            link budget uses a log-distance path loss with per device
+ *            shadowing and the noise floor of the receiver bandwidth. An
+ *            uplink is lost when its SNR is below the demodulator limit of
+ *            its spreading factor, when the gateway transmits during it, or
+ *            when another uplink with the same frequency, spreading factor
+ *            and bandwidth overlaps it and is not at least 6 dB weaker
+ *            (capture effect). Different spreading factors are orthogonal.
+ *
+ *            The devices are activated by personalization (ABP). The network
+ *            server checks the MIC and the frame counter of each uplink,
+ *            acknowledges confirmed ones, answers ADRACKReq and runs the
+ *            usual SNR margin ADR with LinkADRReq in FOpts. Downlinks go to
+ *            RX1 if the gateway is free and within its duty cycle, else to
+ *            RX2, else they are dropped.
+ *
+ *            The results are written to stdout as JSON. For a given seed
+ *            they do not depend on the number of threads, except mac_cycles
+ *            and the wall time: mac_cycles is the mean number of host cycles
+ *            (SimCycles) of a LoRaMacCtxMcpsRequest, which sends the frame
+ *            through ScheduleTx, and of the RxDone event of the MAC
+ *            (OnRadioRxDone).
+ *
+ *            Add -DLORAMAC_SINGLE_REGION=<region> to build the MAC for one
+ *            region only, see Commissioning.h; -R must then select it.
+ *
+ *            Build from the repository root:
+ *
+ *            cc -O2 -pthread -DLORAMAC_THREAD_LOCAL=_Thread_local -DLIB_DEBUG=0 \
+ *               -Iextras/sim/host -I. -Isystem -Isystem/crypto -Iradio \
+ *               -Iradio/sx126x/sx126x_driver/src -Imac -Imac/region \
+ *               extras/sim/lorawan_fleet_sim.c extras/sim/sim_timer.c \
+ *               extras/sim/sim_radio.c mac/LoRaMac.c mac/LoRaMacCommands.c mac/LoRaMacHelper.c \
+ *               mac/LoRaMacCrypto.c mac/LoRaMacCryptoBackend.c mac/LoRaMacNvm.c mac/LoRaMacAirtime.c \
+ *               mac/region/Region*.c -x c mac/region/RegionUS915.cpp -x none \
+ *               radio/sx126x/radio_toa.c system/utilities.c system/timer_wheel.c system/crypto/aes.c \
+ *               system/crypto/aes_hw.c system/crypto/cmac.c -lm -o lorawan_fleet_sim
+ *
+ *            Usage: lorawan_fleet_sim [-R region] [-n devices] [-t seconds]
+ *                   [-j threads] [-p period s] [-s payload size]
+ *                   [-c confirmed %] [-a adr 0/1] [-D initial datarate]
+ *                   [-r radius m] [-e path loss exponent] [-g shadowing dB]
+ *                   [-d gateway duty cycle %] [-w window ms] [-S seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sim.h"
+#include "utilities.h"
+#include "region/Region.h"
+#include "RegionAS923.h"
+#include "RegionAU915.h"
+#include "RegionCN470.h"
+#include "RegionCN779.h"
+#include "RegionEU433.h"
+#include "RegionEU868.h"
+#include "RegionIN865.h"
+#include "RegionKR920.h"
+#include "RegionRU864.h"
+#include "RegionUS915.h"
+
+/*!
+ * First device address, the device index is added
+ */
+#define DEVADDR_BASE 0x26000000
+
+/*!
+ * Application port of the uplinks
+ */
+#define APP_PORT 2
+
+/*!
+ * ADR installation margin [dB]
+ */
+#define ADR_MARGIN 10.0
+
+/*!
+ * Minimum power difference to the interferers to capture a frame [dB]
+ */
+#define CAPTURE_THRESHOLD 6.0
+
+/*!
+ * Gateway transmit power [dBm]
+ */
+#define GATEWAY_TX_POWER 14.0
+
+/*!
+ * Maximum number of distinct uplink frequencies in the statistics
+ */
+#define MAX_FREQUENCIES 96
+
+/*!
+ * Number of datarates
+ */
+#define NB_DATARATES 16
+
+/*!
+ * Frequency plan of the RX1 window
+ */
+typedef enum eRx1Plan
+{
+	/*!
+	 * RX1 on the uplink channel
+	 */
+	RX1_UPLINK_CHANNEL,
+	/*!
+	 * RX1 on one of 8 downlink channels, selected by the uplink channel
+	 * modulo 8 (US915, AU915)
+	 */
+	RX1_MODULO_8,
+	/*!
+	 * RX1 on one of 48 downlink channels (CN470)
+	 */
+	RX1_MODULO_48,
+} Rx1Plan_t;
+
+/*!
+ * Region description of the network server
+ */
+typedef struct sSimRegion
+{
+	const char *Name;
+	LoRaMacRegion_t Region;
+	const uint8_t *Datarates;
+	const uint32_t *Bandwidths;
+	uint8_t NbDatarates;
+	/*!
+	 * Highest TX power index
+	 */
+	uint8_t MinTxPower;
+	Rx1Plan_t Rx1Plan;
+	/*!
+	 * First 125 kHz and 500 kHz uplink channel, first RX1 channel and
+	 * RX1 channel spacing for the fixed channel plans
+	 */
+	uint32_t Uplink125k;
+	uint32_t Uplink500k;
+	uint32_t FirstRx1;
+	uint32_t StepRx1;
+} SimRegion_t;
+
+#define REGION_ENTRY(name, plan, up125, up500, rx1, step)                                                                 \
+	{                                                                                                                     \
+		#name, LORAMAC_REGION_##name, Datarates##name, Bandwidths##name, sizeof(Datarates##name) / sizeof(uint8_t), \
+			name##_MIN_TX_POWER, plan, up125, up500, rx1, step                                                            \
+	}
+
+static const SimRegion_t Regions[] =
+	{
+		REGION_ENTRY(EU868, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+		REGION_ENTRY(US915, RX1_MODULO_8, 902300000, 903000000, US915_FIRST_RX1_CHANNEL, US915_STEPWIDTH_RX1_CHANNEL),
+		REGION_ENTRY(AU915, RX1_MODULO_8, 915200000, 915900000, AU915_FIRST_RX1_CHANNEL, AU915_STEPWIDTH_RX1_CHANNEL),
+		REGION_ENTRY(AS923, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+		REGION_ENTRY(KR920, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+		REGION_ENTRY(IN865, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+		REGION_ENTRY(CN470, RX1_MODULO_48, 470300000, 0, CN470_FIRST_RX1_CHANNEL, CN470_STEPWIDTH_RX1_CHANNEL),
+		REGION_ENTRY(CN779, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+		REGION_ENTRY(EU433, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+		REGION_ENTRY(RU864, RX1_UPLINK_CHANNEL, 0, 0, 0, 0),
+};
+
+/*!
+ * Simulation parameters
+ */
+typedef struct sSimConfig
+{
+	const SimRegion_t *Region;
+	uint32_t NbDevices;
+	uint32_t Duration;
+	uint32_t NbThreads;
+	uint32_t Period;
+	uint8_t PayloadSize;
+	uint8_t ConfirmedPercent;
+	bool Adr;
+	int8_t Datarate;
+	double Radius;
+	double PathLossExponent;
+	double Shadowing;
+	double GatewayDutyCycle;
+	uint32_t WindowMs;
+	uint32_t Seed;
+} SimConfig_t;
+
+static SimConfig_t Config =
+	{
+		.Region = &Regions[0],
+		.NbDevices = 1000,
+		.Duration = 3600,
+		.NbThreads = 0,
+		.Period = 300,
+		.PayloadSize = 10,
+		.ConfirmedPercent = 0,
+		.Adr = true,
+		.Datarate = -1,
+		.Radius = 5000.0,
+		.PathLossExponent = 2.7,
+		.Shadowing = 4.0,
+		.GatewayDutyCycle = 10.0,
+		.WindowMs = 500,
+		.Seed = 1,
+};
+
+/*!
+ * Region parameters read from the region implementation at start
+ */
+typedef struct sSimPlan
+{
+	/*!
+	 * Physical layer parameters of the datarates, frequency not set
+	 */
+	SimPhy_t Datarates[NB_DATARATES];
+	bool Valid[NB_DATARATES];
+	uint8_t Rx1Datarate[NB_DATARATES];
+	uint8_t MaxAdrDatarate;
+	uint8_t Rx2Datarate;
+	uint32_t Rx2Frequency;
+	uint32_t ReceiveDelay1;
+	uint32_t ReceiveDelay2;
+} SimPlan_t;
+
+static SimPlan_t Plan;
+
+/*!
+ * Network side statistics
+ */
+typedef struct sSimNsStats
+{
+	uint64_t UplinksSent;
+	uint64_t UplinksReceived;
+	uint64_t UplinksUnique;
+	uint64_t UplinksCollided;
+	uint64_t UplinksCaptured;
+	uint64_t UplinksTooWeak;
+	uint64_t UplinksGatewayTx;
+	uint64_t MicErrors;
+	uint64_t DownlinksRx1;
+	uint64_t DownlinksRx2;
+	uint64_t DownlinksDropped;
+	uint64_t LinkAdrReq;
+	uint64_t LinkAdrAnsOk;
+	uint64_t LinkAdrAnsNok;
+	uint64_t Datarates[NB_DATARATES];
+	uint32_t NbFrequencies;
+	uint32_t Frequencies[MAX_FREQUENCIES];
+	uint64_t FrequencyUplinks[MAX_FREQUENCIES];
+	uint64_t FrequencyAirtimeUs[MAX_FREQUENCIES];
+} SimNsStats_t;
+
+static SimNsStats_t NsStats;
+
+/*!
+ * Gateway transmission
+ */
+typedef struct sSimGatewayTx
+{
+	uint64_t StartUs;
+	uint64_t EndUs;
+} SimGatewayTx_t;
+
+static SimDevice_t *Devices;
+static SimShard_t *Shards;
+static pthread_barrier_t Barrier;
+
+/*!
+ * Coordinator state
+ */
+static LoRaMacCryptoCtx_t NsCrypto;
+static SimUplink_t *Active;
+static uint32_t NbActive;
+static uint32_t ActiveCapacity;
+static SimUplink_t **Resolve;
+static uint32_t ResolveCapacity;
+static SimGatewayTx_t *GatewayTx;
+static uint32_t NbGatewayTx;
+static uint32_t GatewayTxCapacity;
+static uint64_t GatewayNextTxUs;
+static uint64_t MaxToaUs;
+
+static void *Grow(void *array, uint32_t *capacity, size_t size)
+{
+	*capacity = (*capacity == 0) ? 256 : 2 * *capacity;
+	array = realloc(array, *capacity * size);
+	if (array == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	return array;
+}
+
+/*!
+ * \brief Returns a uniform random number in [0, 1) derived from two values
+ */
+static double Uniform(uint32_t a, uint32_t b)
+{
+	return (SimHash(a, b) + 0.5) / 4294967296.0;
+}
+
+double SimPathLoss(const SimDevice_t *device, uint32_t frequency)
+{
+	double distance = (device->Distance > 1.0) ? device->Distance : 1.0;
+
+	// Free space loss at 1 m, then log-distance
+	return 20.0 * log10(frequency) - 147.55 + 10.0 * Config.PathLossExponent * log10(distance) + device->Shadowing;
+}
+
+void HAL_Delay(uint32_t delay)
+{
+	(void)delay;
+}
+
+/*!
+ * \brief Reads the datarates, RX windows and ADR limits of the region
+ */
+static void InitPlan(void)
+{
+	const SimRegion_t *region = Config.Region;
+	GetPhyParams_t getPhy;
+	PhyParam_t phyParam;
+	uint8_t downlinkDwellTime;
+
+	memset1((uint8_t *)&Plan, 0, sizeof(Plan));
+
+	for (uint8_t dr = 0; dr < region->NbDatarates; dr++)
+	{
+		SimPhy_t *phy = &Plan.Datarates[dr];
+
+		if (region->Datarates[dr] == 0)
+		{
+			continue;
+		}
+		if (region->Bandwidths[dr] == 0)
+		{
+			phy->Sf = SIM_SF_FSK;
+			phy->Bandwidth = region->Datarates[dr] * 1000;
+			phy->PreambleLen = 5;
+			phy->CrcOn = true;
+		}
+		else
+		{
+			phy->Sf = region->Datarates[dr];
+			phy->Bandwidth = region->Bandwidths[dr];
+			phy->Coderate = 1;
+			phy->PreambleLen = 8;
+			if ((region->Bandwidths[dr] == 125000) && (dr > Plan.MaxAdrDatarate))
+			{
+				Plan.MaxAdrDatarate = dr;
+			}
+		}
+		Plan.Valid[dr] = true;
+	}
+
+	getPhy.Attribute = PHY_DEF_DOWNLINK_DWELL_TIME;
+	downlinkDwellTime = RegionGetPhyParam(region->Region, &getPhy).Value;
+	for (uint8_t dr = 0; dr < region->NbDatarates; dr++)
+	{
+		Plan.Rx1Datarate[dr] = RegionApplyDrOffset(region->Region, downlinkDwellTime, dr, 0);
+	}
+
+	getPhy.Attribute = PHY_DEF_RX2_DR;
+	Plan.Rx2Datarate = RegionGetPhyParam(region->Region, &getPhy).Value;
+	getPhy.Attribute = PHY_DEF_RX2_FREQUENCY;
+	Plan.Rx2Frequency = RegionGetPhyParam(region->Region, &getPhy).Value;
+	getPhy.Attribute = PHY_RECEIVE_DELAY1;
+	phyParam = RegionGetPhyParam(region->Region, &getPhy);
+	Plan.ReceiveDelay1 = phyParam.Value;
+	getPhy.Attribute = PHY_RECEIVE_DELAY2;
+	phyParam = RegionGetPhyParam(region->Region, &getPhy);
+	Plan.ReceiveDelay2 = phyParam.Value;
+}
+
+/*!
+ * \brief Returns the datarate of an uplink
+ */
+static uint8_t GetDatarate(const SimPhy_t *phy)
+{
+	for (uint8_t dr = 0; dr < Config.Region->NbDatarates; dr++)
+	{
+		if ((Plan.Valid[dr] == true) && (Plan.Datarates[dr].Sf == phy->Sf) && (Plan.Datarates[dr].Bandwidth == phy->Bandwidth))
+		{
+			return dr;
+		}
+	}
+	return 0;
+}
+
+/*!
+ * \brief Returns the RX1 frequency of an uplink
+ */
+static uint32_t GetRx1Frequency(const SimPhy_t *phy)
+{
+	const SimRegion_t *region = Config.Region;
+	uint32_t channel;
+
+	switch (region->Rx1Plan)
+	{
+	case RX1_MODULO_8:
+		if (phy->Bandwidth == 500000)
+		{
+			channel = (phy->Frequency - region->Uplink500k) / 1600000;
+		}
+		else
+		{
+			channel = (phy->Frequency - region->Uplink125k) / 200000;
+		}
+		return region->FirstRx1 + (channel % 8) * region->StepRx1;
+	case RX1_MODULO_48:
+		channel = (phy->Frequency - region->Uplink125k) / 200000;
+		return region->FirstRx1 + (channel % 48) * region->StepRx1;
+	default:
+		return phy->Frequency;
+	}
+}
+
+/*!
+ * \brief Returns true if the gateway can transmit in the given interval
+ */
+static bool IsGatewayFree(uint64_t startUs, uint64_t endUs)
+{
+	if (startUs < GatewayNextTxUs)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < NbGatewayTx; i++)
+	{
+		if ((GatewayTx[i].StartUs < endUs) && (startUs < GatewayTx[i].EndUs))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*!
+ * \brief Transmits a downlink in RX1 or RX2 of an uplink
+ *
+ * \param  device Destination
+ * \param  uplink Uplink which opened the receive windows
+ * \param  frame Downlink frame
+ * \param  size Size of the frame
+ */
+static void SendDownlink(SimDevice_t *device, const SimUplink_t *uplink, const uint8_t *frame, uint8_t size)
+{
+	SimDownlink_t *downlink = &device->Downlink;
+	uint8_t dr = GetDatarate(&uplink->Phy);
+	SimPhy_t phy;
+	uint64_t startUs;
+	uint32_t toaUs;
+
+	for (uint8_t slot = 0; slot < 2; slot++)
+	{
+		if (slot == 0)
+		{
+			phy = Plan.Datarates[Plan.Rx1Datarate[dr]];
+			phy.Frequency = GetRx1Frequency(&uplink->Phy);
+			startUs = uplink->EndUs + (uint64_t)Plan.ReceiveDelay1 * 1000;
+		}
+		else
+		{
+			phy = Plan.Datarates[Plan.Rx2Datarate];
+			phy.Frequency = Plan.Rx2Frequency;
+			startUs = uplink->EndUs + (uint64_t)Plan.ReceiveDelay2 * 1000;
+		}
+		// Downlinks are sent without payload CRC
+		phy.CrcOn = false;
+		toaUs = SimTimeOnAir(&phy, size);
+
+		if (IsGatewayFree(startUs, startUs + toaUs) == false)
+		{
+			continue;
+		}
+
+		if (NbGatewayTx == GatewayTxCapacity)
+		{
+			GatewayTx = Grow(GatewayTx, &GatewayTxCapacity, sizeof(SimGatewayTx_t));
+		}
+		GatewayTx[NbGatewayTx].StartUs = startUs;
+		GatewayTx[NbGatewayTx].EndUs = startUs + toaUs;
+		NbGatewayTx++;
+		GatewayNextTxUs = startUs + (uint64_t)(toaUs * 100.0 / Config.GatewayDutyCycle);
+
+		downlink->Pending = true;
+		downlink->Phy = phy;
+		downlink->StartUs = startUs;
+		downlink->ToaUs = toaUs;
+		downlink->Rssi = GATEWAY_TX_POWER - SimPathLoss(device, phy.Frequency);
+		downlink->Snr = downlink->Rssi - SimNoiseFloor(&phy);
+		downlink->Size = size;
+		memcpy1(downlink->Payload, frame, size);
+
+		if (slot == 0)
+		{
+			NsStats.DownlinksRx1++;
+		}
+		else
+		{
+			NsStats.DownlinksRx2++;
+		}
+		return;
+	}
+	NsStats.DownlinksDropped++;
+}
+
+/*!
+ * \brief Computes the ADR datarate and TX power of a device from its SNR
+ *        history
+ *
+ * \retval true if they differ from the current ones
+ */
+static bool ComputeAdr(SimDevice_t *device, uint8_t dr, uint8_t *drOut, uint8_t *txPowerOut)
+{
+	SimNsDevice_t *ns = &device->Ns;
+	double snrMax = ns->Snr[0];
+	uint8_t uplinkDr = dr;
+	uint8_t txPower = ns->TxPower;
+	int nStep;
+
+	for (uint8_t i = 1; i < ns->NbSnr; i++)
+	{
+		if (ns->Snr[i] > snrMax)
+		{
+			snrMax = ns->Snr[i];
+		}
+	}
+	nStep = (int)floor((snrMax - SimRequiredSnr(&Plan.Datarates[dr]) - ADR_MARGIN) / 3.0);
+
+	while ((nStep > 0) && (dr < Plan.MaxAdrDatarate))
+	{
+		dr++;
+		nStep--;
+	}
+	while ((nStep > 0) && (txPower < Config.Region->MinTxPower))
+	{
+		txPower++;
+		nStep--;
+	}
+	while ((nStep < 0) && (txPower > 0))
+	{
+		txPower--;
+		nStep++;
+	}
+
+	*drOut = dr;
+	*txPowerOut = txPower;
+	return (dr != uplinkDr) || (txPower != ns->TxPower);
+}
+
+/*!
+ * \brief Processes the MAC commands of an uplink
+ */
+static void ParseFOpts(SimDevice_t *device, const uint8_t *fOpts, uint8_t size)
+{
+	SimNsDevice_t *ns = &device->Ns;
+	uint8_t i = 0;
+
+	while (i < size)
+	{
+		switch (fOpts[i++])
+		{
+		case MOTE_MAC_LINK_ADR_ANS:
+			if ((fOpts[i] & 0x07) == 0x07)
+			{
+				NsStats.LinkAdrAnsOk++;
+				if (ns->AdrPending == true)
+				{
+					ns->TxPower = ns->AdrPendingTxPower;
+				}
+			}
+			else
+			{
+				NsStats.LinkAdrAnsNok++;
+			}
+			ns->AdrPending = false;
+			i += 1;
+			break;
+		case MOTE_MAC_RX_PARAM_SETUP_ANS:
+		case MOTE_MAC_NEW_CHANNEL_ANS:
+		case MOTE_MAC_DL_CHANNEL_ANS:
+			i += 1;
+			break;
+		case MOTE_MAC_DEV_STATUS_ANS:
+			i += 2;
+			break;
+		case MOTE_MAC_LINK_CHECK_REQ:
+		case MOTE_MAC_DUTY_CYCLE_ANS:
+		case MOTE_MAC_RX_TIMING_SETUP_ANS:
+		case MOTE_MAC_TX_PARAM_SETUP_ANS:
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+/*!
+ * \brief Network server processing of a received uplink
+ */
+static void HandleUplink(const SimUplink_t *uplink)
+{
+	LoRaMacHeader_t macHdr;
+	SimDevice_t *device;
+	SimNsDevice_t *ns;
+	uint8_t fCtrl;
+	uint8_t fOptsLen;
+	uint32_t address;
+	uint32_t fCnt;
+	uint32_t mic;
+	uint32_t micRx;
+	uint8_t dr;
+	uint8_t adrDr;
+	uint8_t adrTxPower;
+	bool ack;
+	bool linkAdrReq = false;
+	uint8_t frame[32];
+	uint8_t size = 0;
+
+	if (uplink->Size < 12)
+	{
+		NsStats.MicErrors++;
+		return;
+	}
+	macHdr.Value = uplink->Payload[0];
+	if ((macHdr.Bits.MType != FRAME_TYPE_DATA_UNCONFIRMED_UP) && (macHdr.Bits.MType != FRAME_TYPE_DATA_CONFIRMED_UP))
+	{
+		return;
+	}
+
+	address = uplink->Payload[1] | ((uint32_t)uplink->Payload[2] << 8) | ((uint32_t)uplink->Payload[3] << 16) | ((uint32_t)uplink->Payload[4] << 24);
+	if ((address < DEVADDR_BASE) || (address - DEVADDR_BASE >= Config.NbDevices))
+	{
+		NsStats.MicErrors++;
+		return;
+	}
+	device = &Devices[address - DEVADDR_BASE];
+	ns = &device->Ns;
+
+	fCtrl = uplink->Payload[5];
+	fOptsLen = fCtrl & 0x0F;
+	fCnt = (ns->FCntUp & 0xFFFF0000) | uplink->Payload[6] | ((uint32_t)uplink->Payload[7] << 8);
+	if ((ns->HasFCntUp == true) && (fCnt < ns->FCntUp))
+	{
+		fCnt += 0x10000;
+	}
+
+	micRx = uplink->Payload[uplink->Size - 4] | ((uint32_t)uplink->Payload[uplink->Size - 3] << 8) |
+			((uint32_t)uplink->Payload[uplink->Size - 2] << 16) | ((uint32_t)uplink->Payload[uplink->Size - 1] << 24);
+	LoRaMacCryptoCtxComputeMic(&NsCrypto, uplink->Payload, uplink->Size - LORAMAC_MFR_LEN, device->NwkSKey, address, UP_LINK, fCnt, &mic);
+	if (mic != micRx)
+	{
+		NsStats.MicErrors++;
+		return;
+	}
+
+	NsStats.UplinksReceived++;
+	if ((ns->HasFCntUp == false) || (fCnt != ns->FCntUp))
+	{
+		NsStats.UplinksUnique++;
+		ns->HasFCntUp = true;
+		ns->FCntUp = fCnt;
+	}
+
+	ParseFOpts(device, &uplink->Payload[8], fOptsLen);
+
+	dr = GetDatarate(&uplink->Phy);
+	if ((fCtrl & 0x80) != 0)
+	{
+		// ADR enabled
+		if (ns->NbSnr == SIM_ADR_HISTORY)
+		{
+			memmove(&ns->Snr[0], &ns->Snr[1], (SIM_ADR_HISTORY - 1) * sizeof(double));
+			ns->NbSnr--;
+		}
+		ns->Snr[ns->NbSnr++] = uplink->Snr;
+
+		if ((ns->NbSnr == SIM_ADR_HISTORY) && (ns->AdrPending == false) &&
+			(ComputeAdr(device, dr, &adrDr, &adrTxPower) == true))
+		{
+			linkAdrReq = true;
+			ns->AdrPending = true;
+			ns->AdrPendingDr = adrDr;
+			ns->AdrPendingTxPower = adrTxPower;
+			ns->NbSnr = 0;
+		}
+	}
+
+	ack = (macHdr.Bits.MType == FRAME_TYPE_DATA_CONFIRMED_UP);
+	if ((ack == false) && (linkAdrReq == false) && ((fCtrl & 0x40) == 0))
+	{
+		return;
+	}
+
+	macHdr.Value = 0;
+	macHdr.Bits.MType = FRAME_TYPE_DATA_UNCONFIRMED_DOWN;
+	frame[size++] = macHdr.Value;
+	frame[size++] = address & 0xFF;
+	frame[size++] = (address >> 8) & 0xFF;
+	frame[size++] = (address >> 16) & 0xFF;
+	frame[size++] = (address >> 24) & 0xFF;
+	frame[size++] = ((ack == true) ? 0x20 : 0x00) | ((linkAdrReq == true) ? 5 : 0);
+	frame[size++] = ns->FCntDown & 0xFF;
+	frame[size++] = (ns->FCntDown >> 8) & 0xFF;
+	if (linkAdrReq == true)
+	{
+		// Enable all channels (ChMaskCntl 6), one transmission
+		frame[size++] = SRV_MAC_LINK_ADR_REQ;
+		frame[size++] = (ns->AdrPendingDr << 4) | ns->AdrPendingTxPower;
+		frame[size++] = 0xFF;
+		frame[size++] = 0x00;
+		frame[size++] = (6 << 4) | 1;
+		NsStats.LinkAdrReq++;
+	}
+	LoRaMacCryptoCtxComputeMic(&NsCrypto, frame, size, device->NwkSKey, address, DOWN_LINK, ns->FCntDown, &mic);
+	frame[size++] = mic & 0xFF;
+	frame[size++] = (mic >> 8) & 0xFF;
+	frame[size++] = (mic >> 16) & 0xFF;
+	frame[size++] = (mic >> 24) & 0xFF;
+	ns->FCntDown++;
+
+	SendDownlink(device, uplink, frame, size);
+}
+
+/*!
+ * \brief Decides the fate of an uplink at the gateway
+ */
+static void ResolveUplink(SimUplink_t *uplink)
+{
+	double interference = 0.0;
+
+	uplink->Resolved = true;
+
+	if (uplink->Snr < SimRequiredSnr(&uplink->Phy))
+	{
+		NsStats.UplinksTooWeak++;
+		return;
+	}
+
+	for (uint32_t i = 0; i < NbGatewayTx; i++)
+	{
+		if ((GatewayTx[i].StartUs < uplink->EndUs) && (uplink->StartUs < GatewayTx[i].EndUs))
+		{
+			NsStats.UplinksGatewayTx++;
+			return;
+		}
+	}
+
+	for (uint32_t i = 0; i < NbActive; i++)
+	{
+		SimUplink_t *other = &Active[i];
+
+		if ((other != uplink) && (other->Phy.Frequency == uplink->Phy.Frequency) && (other->Phy.Sf == uplink->Phy.Sf) &&
+			(other->Phy.Bandwidth == uplink->Phy.Bandwidth) && (other->StartUs < uplink->EndUs) && (uplink->StartUs < other->EndUs))
+		{
+			interference += pow(10.0, other->Rssi / 10.0);
+		}
+	}
+	if (interference > 0.0)
+	{
+		if (uplink->Rssi - 10.0 * log10(interference) < CAPTURE_THRESHOLD)
+		{
+			NsStats.UplinksCollided++;
+			return;
+		}
+		NsStats.UplinksCaptured++;
+	}
+
+	HandleUplink(uplink);
+}
+
+static int CompareUplinks(const void *a, const void *b)
+{
+	const SimUplink_t *x = *(SimUplink_t *const *)a;
+	const SimUplink_t *y = *(SimUplink_t *const *)b;
+
+	if (x->EndUs != y->EndUs)
+	{
+		return (x->EndUs < y->EndUs) ? -1 : 1;
+	}
+	return (x->DevId < y->DevId) ? -1 : (x->DevId > y->DevId);
+}
+
+/*!
+ * \brief Adds an uplink to the gateway and the statistics
+ */
+static void AddUplink(const SimUplink_t *uplink)
+{
+	SimUplink_t *active;
+	uint8_t dr = GetDatarate(&uplink->Phy);
+	uint32_t i;
+
+	if (NbActive == ActiveCapacity)
+	{
+		Active = Grow(Active, &ActiveCapacity, sizeof(SimUplink_t));
+	}
+	active = &Active[NbActive++];
+	*active = *uplink;
+	active->Rssi = uplink->TxPower - SimPathLoss(&Devices[uplink->DevId], uplink->Phy.Frequency);
+	active->Snr = active->Rssi - SimNoiseFloor(&uplink->Phy);
+	if (uplink->EndUs - uplink->StartUs > MaxToaUs)
+	{
+		MaxToaUs = uplink->EndUs - uplink->StartUs;
+	}
+
+	NsStats.UplinksSent++;
+	NsStats.Datarates[dr]++;
+	for (i = 0; i < NsStats.NbFrequencies; i++)
+	{
+		if (NsStats.Frequencies[i] == uplink->Phy.Frequency)
+		{
+			break;
+		}
+	}
+	if ((i == NsStats.NbFrequencies) && (i < MAX_FREQUENCIES))
+	{
+		NsStats.Frequencies[NsStats.NbFrequencies++] = uplink->Phy.Frequency;
+	}
+	if (i < MAX_FREQUENCIES)
+	{
+		NsStats.FrequencyUplinks[i]++;
+		NsStats.FrequencyAirtimeUs[i] += uplink->EndUs - uplink->StartUs;
+	}
+}
+
+/*!
+ * \brief Runs at the end of each window while all shards wait. Collects the
+ *        uplinks of the window, resolves the ones which ended and drops
+ *        the ones which can no longer overlap an unresolved uplink.
+ *
+ * \param  windowEnd End of the window [ms]
+ */
+static void Coordinate(uint64_t windowEnd)
+{
+	uint64_t endUs = windowEnd * 1000;
+	uint32_t nbResolve = 0;
+	uint32_t n;
+
+	for (uint32_t s = 0; s < Config.NbThreads; s++)
+	{
+		for (uint32_t i = 0; i < Shards[s].NbUplinks; i++)
+		{
+			AddUplink(&Shards[s].Uplinks[i]);
+		}
+		Shards[s].NbUplinks = 0;
+	}
+
+	if (ResolveCapacity < NbActive)
+	{
+		ResolveCapacity = NbActive;
+		Resolve = realloc(Resolve, ResolveCapacity * sizeof(SimUplink_t *));
+		if (Resolve == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	for (uint32_t i = 0; i < NbActive; i++)
+	{
+		if ((Active[i].Resolved == false) && (Active[i].EndUs <= endUs))
+		{
+			Resolve[nbResolve++] = &Active[i];
+		}
+	}
+	qsort(Resolve, nbResolve, sizeof(SimUplink_t *), CompareUplinks);
+	for (uint32_t i = 0; i < nbResolve; i++)
+	{
+		ResolveUplink(Resolve[i]);
+	}
+
+	n = 0;
+	for (uint32_t i = 0; i < NbActive; i++)
+	{
+		if ((Active[i].Resolved == false) || (Active[i].EndUs + MaxToaUs > endUs))
+		{
+			Active[n++] = Active[i];
+		}
+	}
+	NbActive = n;
+
+	n = 0;
+	for (uint32_t i = 0; i < NbGatewayTx; i++)
+	{
+		if (GatewayTx[i].EndUs + MaxToaUs > endUs)
+		{
+			GatewayTx[n++] = GatewayTx[i];
+		}
+	}
+	NbGatewayTx = n;
+}
+
+static void OnMcpsConfirm(McpsConfirm_t *mcpsConfirm)
+{
+	SimDevice_t *device = SimCurrentDevice();
+	SimDeviceStats_t *stats = &device->Shard->Stats;
+
+	if (mcpsConfirm->McpsRequest == MCPS_CONFIRMED)
+	{
+		stats->ConfirmedDone++;
+		if (mcpsConfirm->AckReceived == true)
+		{
+			stats->ConfirmedAcked++;
+		}
+		if (mcpsConfirm->NbRetries > 1)
+		{
+			stats->Retransmissions += mcpsConfirm->NbRetries - 1;
+		}
+	}
+}
+
+static void OnMcpsIndication(McpsIndication_t *mcpsIndication)
+{
+	SimDevice_t *device = SimCurrentDevice();
+
+	if (mcpsIndication->Status == LORAMAC_EVENT_INFO_STATUS_OK)
+	{
+		device->Shard->Stats.DownlinksReceived++;
+	}
+}
+
+static void OnMlmeConfirm(MlmeConfirm_t *mlmeConfirm)
+{
+	(void)mlmeConfirm;
+}
+
+static LoRaMacPrimitives_t Primitives = {OnMcpsConfirm, OnMcpsIndication, OnMlmeConfirm};
+static LoRaMacCallback_t Callbacks;
+
+/*!
+ * \brief Application timer, sends the next uplink
+ */
+static void OnAppTimer(void)
+{
+	SimDevice_t *device = SimCurrentDevice();
+	SimShard_t *shard = device->Shard;
+	uint32_t period = Config.Period * 1000;
+	McpsReq_t mcpsReq;
+	LoRaMacStatus_t status;
+	uint64_t cycles;
+
+	// Period with +-10 % jitter
+	TimerSetValue(&device->AppTimer, period - period / 10 + randr(0, period / 5));
+	TimerStart(&device->AppTimer);
+
+	for (uint8_t i = 0; i < Config.PayloadSize; i++)
+	{
+		device->AppData[i] = randr(0, 255);
+	}
+
+	if (device->Confirmed == true)
+	{
+		mcpsReq.Type = MCPS_CONFIRMED;
+		mcpsReq.Req.Confirmed.fPort = APP_PORT;
+		mcpsReq.Req.Confirmed.fBuffer = device->AppData;
+		mcpsReq.Req.Confirmed.fBufferSize = Config.PayloadSize;
+		mcpsReq.Req.Confirmed.Datarate = device->Mac.Params.ChannelsDatarate;
+		mcpsReq.Req.Confirmed.NbTrials = 8;
+	}
+	else
+	{
+		mcpsReq.Type = MCPS_UNCONFIRMED;
+		mcpsReq.Req.Unconfirmed.fPort = APP_PORT;
+		mcpsReq.Req.Unconfirmed.fBuffer = device->AppData;
+		mcpsReq.Req.Unconfirmed.fBufferSize = Config.PayloadSize;
+		mcpsReq.Req.Unconfirmed.Datarate = device->Mac.Params.ChannelsDatarate;
+	}
+
+	// The MAC may transmit before the request returns
+	shard->Stats.AppRequests++;
+	device->RequestPending = true;
+	device->RequestTime = shard->Now;
+	cycles = SimCycles();
+	status = LoRaMacCtxMcpsRequest(&device->Mac, &mcpsReq);
+	shard->Stats.McpsRequestCycles += SimCycles() - cycles;
+	switch (status)
+	{
+	case LORAMAC_STATUS_OK:
+		shard->Stats.AppAccepted++;
+		break;
+	case LORAMAC_STATUS_BUSY:
+		shard->Stats.AppBusy++;
+		device->RequestPending = false;
+		break;
+	default:
+		shard->Stats.AppRejected++;
+		device->RequestPending = false;
+		break;
+	}
+}
+
+/*!
+ * \brief Initializes the MAC instance of a device in the calling thread
+ */
+static void InitDevice(SimShard_t *shard, SimDevice_t *device)
+{
+	LoRaMacInitParams_t params;
+	MibRequestConfirm_t mibReq;
+
+	LoRaMacContextInit(&device->Mac, &shard->Crypto);
+
+	params.primitives = &Primitives;
+	params.callbacks = &Callbacks;
+	params.Region = Config.Region->Region;
+	params.nodeClass = CLASS_A;
+	params.region_change = false;
+	if (LoRaMacCtxInitialization(&device->Mac, &params) != LORAMAC_STATUS_OK)
+	{
+		fprintf(stderr, "device %u: MAC initialization failed\n", device->Id);
+		exit(1);
+	}
+
+	mibReq.Type = MIB_NET_ID;
+	mibReq.Param.NetID = 0;
+	LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	mibReq.Type = MIB_DEV_ADDR;
+	mibReq.Param.DevAddr = device->DevAddr;
+	LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	mibReq.Type = MIB_NWK_SKEY;
+	mibReq.Param.NwkSKey = device->NwkSKey;
+	LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	mibReq.Type = MIB_APP_SKEY;
+	mibReq.Param.AppSKey = device->AppSKey;
+	LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	mibReq.Type = MIB_NETWORK_JOINED;
+	mibReq.Param.IsNetworkJoined = JOIN_OK;
+	LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	mibReq.Type = MIB_ADR;
+	mibReq.Param.AdrEnable = Config.Adr;
+	LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	if (Config.Datarate >= 0)
+	{
+		mibReq.Type = MIB_CHANNELS_DATARATE;
+		mibReq.Param.ChannelsDatarate = Config.Datarate;
+		LoRaMacCtxMibSetRequestConfirm(&device->Mac, &mibReq);
+	}
+
+	// The application timer belongs to the device
+	LoRaMacSetContext(&device->Mac);
+	TimerInit(&device->AppTimer, OnAppTimer);
+	TimerSetValue(&device->AppTimer, SimHash(Config.Seed ^ 0x41505020, device->Id) % (Config.Period * 1000));
+	TimerStart(&device->AppTimer);
+}
+
+static void *ShardThread(void *arg)
+{
+	SimShard_t *shard = arg;
+	uint64_t end = (uint64_t)Config.Duration * 1000;
+
+	SimTimerSetShard(shard);
+	LoRaMacCryptoCtxInit(&shard->Crypto);
+	for (uint32_t i = 0; i < shard->NbDevices; i++)
+	{
+		InitDevice(shard, &shard->Devices[i]);
+	}
+
+	for (uint64_t t = 0; t < end; t += Config.WindowMs)
+	{
+		uint64_t windowEnd = (t + Config.WindowMs < end) ? t + Config.WindowMs : end;
+
+		SimTimerRun(windowEnd);
+		if (pthread_barrier_wait(&Barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+		{
+			Coordinate(windowEnd);
+		}
+		pthread_barrier_wait(&Barrier);
+	}
+	return NULL;
+}
+
+static void Usage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [-R region] [-n devices] [-t seconds] [-j threads] [-p period s] [-s payload size]\n"
+			"          [-c confirmed %%] [-a adr 0/1] [-D initial datarate] [-r radius m]\n"
+			"          [-e path loss exponent] [-g shadowing dB] [-d gateway duty cycle %%]\n"
+			"          [-w window ms] [-S seed]\n",
+			name);
+	exit(1);
+}
+
+static void ParseArgs(int argc, char **argv)
+{
+	int opt;
+	uint32_t i;
+
+	while ((opt = getopt(argc, argv, "R:n:t:j:p:s:c:a:D:r:e:g:d:w:S:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'R':
+			for (i = 0; i < sizeof(Regions) / sizeof(Regions[0]); i++)
+			{
+				if (strcmp(optarg, Regions[i].Name) == 0)
+				{
+					Config.Region = &Regions[i];
+					break;
+				}
+			}
+			if (i == sizeof(Regions) / sizeof(Regions[0]))
+			{
+				Usage(argv[0]);
+			}
+			break;
+		case 'n':
+			Config.NbDevices = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			Config.Duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'j':
+			Config.NbThreads = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			Config.Period = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			Config.PayloadSize = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			Config.ConfirmedPercent = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			Config.Adr = (atoi(optarg) != 0);
+			break;
+		case 'D':
+			Config.Datarate = atoi(optarg);
+			break;
+		case 'r':
+			Config.Radius = atof(optarg);
+			break;
+		case 'e':
+			Config.PathLossExponent = atof(optarg);
+			break;
+		case 'g':
+			Config.Shadowing = atof(optarg);
+			break;
+		case 'd':
+			Config.GatewayDutyCycle = atof(optarg);
+			break;
+		case 'w':
+			Config.WindowMs = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			Config.Seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			Usage(argv[0]);
+		}
+	}
+
+	if (Config.NbThreads == 0)
+	{
+		long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		Config.NbThreads = (nbCpus > 0) ? nbCpus : 1;
+	}
+	if (Config.NbThreads > Config.NbDevices)
+	{
+		Config.NbThreads = Config.NbDevices;
+	}
+	if ((Config.NbDevices == 0) || (Config.NbDevices > 0xFFFFFF) || (Config.Duration == 0) || (Config.Duration > 3000000) ||
+		(Config.Period == 0) || (Config.PayloadSize == 0) || (Config.ConfirmedPercent > 100) || (Config.WindowMs == 0) ||
+		(Config.GatewayDutyCycle <= 0.0) || (Config.GatewayDutyCycle > 100.0))
+	{
+		Usage(argv[0]);
+	}
+}
+
+/*!
+ * \brief Places the devices and sets up their keys
+ */
+static void InitDevices(void)
+{
+	for (uint32_t i = 0; i < Config.NbDevices; i++)
+	{
+		SimDevice_t *device = &Devices[i];
+		double u1 = Uniform(Config.Seed, 4 * i);
+		double u2 = Uniform(Config.Seed, 4 * i + 1);
+
+		device->Id = i;
+		device->DevAddr = DEVADDR_BASE + i;
+		for (uint8_t k = 0; k < 16; k++)
+		{
+			device->NwkSKey[k] = SimHash(i, k) & 0xFF;
+			device->AppSKey[k] = SimHash(i, 16 + k) & 0xFF;
+		}
+		device->Distance = Config.Radius * sqrt(Uniform(Config.Seed, 4 * i + 2));
+		device->Shadowing = Config.Shadowing * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+		device->Confirmed = (SimHash(Config.Seed, 4 * i + 3) % 100) < Config.ConfirmedPercent;
+	}
+}
+
+/*!
+ * \brief Sorts the channel statistics by frequency, their order of first use
+ *        depends on the number of threads
+ */
+static void SortFrequencies(void)
+{
+	for (uint32_t i = 1; i < NsStats.NbFrequencies; i++)
+	{
+		for (uint32_t j = i; (j > 0) && (NsStats.Frequencies[j - 1] > NsStats.Frequencies[j]); j--)
+		{
+			uint32_t frequency = NsStats.Frequencies[j];
+			uint64_t uplinks = NsStats.FrequencyUplinks[j];
+			uint64_t airtime = NsStats.FrequencyAirtimeUs[j];
+
+			NsStats.Frequencies[j] = NsStats.Frequencies[j - 1];
+			NsStats.FrequencyUplinks[j] = NsStats.FrequencyUplinks[j - 1];
+			NsStats.FrequencyAirtimeUs[j] = NsStats.FrequencyAirtimeUs[j - 1];
+			NsStats.Frequencies[j - 1] = frequency;
+			NsStats.FrequencyUplinks[j - 1] = uplinks;
+			NsStats.FrequencyAirtimeUs[j - 1] = airtime;
+		}
+	}
+}
+
+static void PrintResults(double wallSeconds)
+{
+	SimDeviceStats_t stats;
+	double duration = Config.Duration;
+	double maxDutyCycle = 0.0;
+	double sumDutyCycle = 0.0;
+	bool first = true;
+
+	memset1((uint8_t *)&stats, 0, sizeof(stats));
+	for (uint32_t s = 0; s < Config.NbThreads; s++)
+	{
+		const SimDeviceStats_t *shardStats = &Shards[s].Stats;
+
+		stats.AppRequests += shardStats->AppRequests;
+		stats.AppAccepted += shardStats->AppAccepted;
+		stats.AppBusy += shardStats->AppBusy;
+		stats.AppRejected += shardStats->AppRejected;
+		stats.ConfirmedDone += shardStats->ConfirmedDone;
+		stats.ConfirmedAcked += shardStats->ConfirmedAcked;
+		stats.Retransmissions += shardStats->Retransmissions;
+		stats.TxStarted += shardStats->TxStarted;
+		stats.DownlinksReceived += shardStats->DownlinksReceived;
+		stats.DownlinksLocked += shardStats->DownlinksLocked;
+		stats.WaitCount += shardStats->WaitCount;
+		stats.WaitSumMs += shardStats->WaitSumMs;
+		stats.McpsRequestCycles += shardStats->McpsRequestCycles;
+		stats.RxDoneCycles += shardStats->RxDoneCycles;
+		if (shardStats->WaitMaxMs > stats.WaitMaxMs)
+		{
+			stats.WaitMaxMs = shardStats->WaitMaxMs;
+		}
+	}
+	for (uint32_t i = 0; i < Config.NbDevices; i++)
+	{
+		double dutyCycle = Devices[i].AirtimeUs / (duration * 1e4);
+
+		sumDutyCycle += dutyCycle;
+		if (dutyCycle > maxDutyCycle)
+		{
+			maxDutyCycle = dutyCycle;
+		}
+	}
+
+	printf("{\n  \"simulator\": \"lorawan_fleet_sim\",\n");
+	printf("  \"config\": {\"region\": \"%s\", \"devices\": %u, \"seconds\": %u, \"threads\": %u, \"window_ms\": %u, "
+		   "\"period_s\": %u, \"payload_size\": %u, \"confirmed_percent\": %u, \"adr\": %s, \"datarate\": %d, "
+		   "\"radius_m\": %.0f, \"path_loss_exponent\": %.2f, \"shadowing_db\": %.1f, \"gateway_duty_cycle_percent\": %.1f, "
+		   "\"seed\": %u},\n",
+		   Config.Region->Name, Config.NbDevices, Config.Duration, Config.NbThreads, Config.WindowMs, Config.Period,
+		   Config.PayloadSize, Config.ConfirmedPercent, (Config.Adr == true) ? "true" : "false", Config.Datarate, Config.Radius,
+		   Config.PathLossExponent, Config.Shadowing, Config.GatewayDutyCycle, Config.Seed);
+	printf("  \"app\": {\"requests\": %llu, \"accepted\": %llu, \"busy\": %llu, \"rejected\": %llu},\n",
+		   (unsigned long long)stats.AppRequests, (unsigned long long)stats.AppAccepted, (unsigned long long)stats.AppBusy,
+		   (unsigned long long)stats.AppRejected);
+	printf("  \"uplinks\": {\"sent\": %llu, \"received\": %llu, \"unique\": %llu, \"collided\": %llu, \"captured\": %llu, "
+		   "\"too_weak\": %llu, \"lost_to_gateway_tx\": %llu, \"mic_errors\": %llu, \"delivery_ratio\": %.4f},\n",
+		   (unsigned long long)NsStats.UplinksSent, (unsigned long long)NsStats.UplinksReceived,
+		   (unsigned long long)NsStats.UplinksUnique, (unsigned long long)NsStats.UplinksCollided,
+		   (unsigned long long)NsStats.UplinksCaptured, (unsigned long long)NsStats.UplinksTooWeak,
+		   (unsigned long long)NsStats.UplinksGatewayTx, (unsigned long long)NsStats.MicErrors,
+		   (stats.AppAccepted > 0) ? (double)NsStats.UplinksUnique / stats.AppAccepted : 0.0);
+	printf("  \"confirmed\": {\"done\": %llu, \"acked\": %llu, \"retransmissions\": %llu},\n",
+		   (unsigned long long)stats.ConfirmedDone, (unsigned long long)stats.ConfirmedAcked,
+		   (unsigned long long)stats.Retransmissions);
+	printf("  \"downlinks\": {\"rx1\": %llu, \"rx2\": %llu, \"dropped\": %llu, \"demodulated\": %llu, \"accepted\": %llu},\n",
+		   (unsigned long long)NsStats.DownlinksRx1, (unsigned long long)NsStats.DownlinksRx2,
+		   (unsigned long long)NsStats.DownlinksDropped, (unsigned long long)stats.DownlinksLocked,
+		   (unsigned long long)stats.DownlinksReceived);
+	printf("  \"adr\": {\"link_adr_req\": %llu, \"link_adr_ans_ok\": %llu, \"link_adr_ans_nok\": %llu},\n",
+		   (unsigned long long)NsStats.LinkAdrReq, (unsigned long long)NsStats.LinkAdrAnsOk,
+		   (unsigned long long)NsStats.LinkAdrAnsNok);
+	printf("  \"datarates\": [");
+	for (uint8_t dr = 0; dr < Config.Region->NbDatarates; dr++)
+	{
+		printf("%s%llu", (dr == 0) ? "" : ", ", (unsigned long long)NsStats.Datarates[dr]);
+	}
+	printf("],\n  \"channels\": [");
+	SortFrequencies();
+	for (uint32_t i = 0; i < NsStats.NbFrequencies; i++)
+	{
+		printf("%s\n    {\"frequency\": %u, \"uplinks\": %llu, \"airtime_ms\": %.1f, \"occupancy_percent\": %.3f}",
+			   (first == true) ? "" : ",", NsStats.Frequencies[i], (unsigned long long)NsStats.FrequencyUplinks[i],
+			   NsStats.FrequencyAirtimeUs[i] / 1e3, NsStats.FrequencyAirtimeUs[i] / (duration * 1e4));
+		first = false;
+	}
+	printf("\n  ],\n");
+	printf("  \"duty_cycle\": {\"max_percent\": %.4f, \"mean_percent\": %.4f, \"tx_started\": %llu, "
+		   "\"mean_wait_ms\": %.1f, \"max_wait_ms\": %llu},\n",
+		   maxDutyCycle, sumDutyCycle / Config.NbDevices, (unsigned long long)stats.TxStarted,
+		   (stats.WaitCount > 0) ? (double)stats.WaitSumMs / stats.WaitCount : 0.0, (unsigned long long)stats.WaitMaxMs);
+	printf("  \"mac_cycles\": {\"mcps_request\": %.0f, \"rx_done\": %.0f},\n",
+		   (stats.AppRequests > 0) ? (double)stats.McpsRequestCycles / stats.AppRequests : 0.0,
+		   (stats.DownlinksLocked > 0) ? (double)stats.RxDoneCycles / stats.DownlinksLocked : 0.0);
+	printf("  \"wall_seconds\": %.3f,\n  \"speedup\": %.1f\n}\n", wallSeconds, (wallSeconds > 0.0) ? duration / wallSeconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	struct timespec start;
+	struct timespec stop;
+	uint32_t first = 0;
+
+	ParseArgs(argc, argv);
+	InitPlan();
+	if (Config.WindowMs > Plan.ReceiveDelay1 / 2)
+	{
+		// Downlinks must reach the devices before RX1 opens
+		Config.WindowMs = Plan.ReceiveDelay1 / 2;
+	}
+
+	Devices = calloc(Config.NbDevices, sizeof(SimDevice_t));
+	Shards = calloc(Config.NbThreads, sizeof(SimShard_t));
+	if ((Devices == NULL) || (Shards == NULL))
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	InitDevices();
+	LoRaMacCryptoCtxInit(&NsCrypto);
+
+	pthread_barrier_init(&Barrier, NULL, Config.NbThreads);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t s = 0; s < Config.NbThreads; s++)
+	{
+		SimShard_t *shard = &Shards[s];
+		uint32_t nbDevices = Config.NbDevices / Config.NbThreads + ((s < Config.NbDevices % Config.NbThreads) ? 1 : 0);
+
+		shard->Index = s;
+		shard->Devices = &Devices[first];
+		shard->NbDevices = nbDevices;
+		for (uint32_t i = 0; i < nbDevices; i++)
+		{
+			Devices[first + i].Shard = shard;
+		}
+		first += nbDevices;
+		if (pthread_create(&shard->Thread, NULL, ShardThread, shard) != 0)
+		{
+			fprintf(stderr, "pthread_create failed\n");
+			return 1;
+		}
+	}
+	for (uint32_t s = 0; s < Config.NbThreads; s++)
+	{
+		pthread_join(Shards[s].Thread, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	PrintResults((stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9);
+
+	return 0;
+}
@@ -0,0 +1,312 @@
+/*!
+ * \file      sim.h
+ *
+ * \brief     Discrete-event fleet simulator shared definitions
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Every simulated device is a complete LoRaMac instance with a
+ *            virtual radio. The devices are split into shards, each shard
+ *            runs in its own thread on its own virtual clock. The shards
+ *            advance in lockstep windows shorter than the RX1 delay; at the
+ *            end of each window the coordinator resolves the uplinks which
+ *            ended in it (link budget, collisions, gateway half duplex),
+ *            passes the received ones to the network server and hands the
+ *            downlinks to the devices before they open their receive
+ *            windows.
+ */
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "LoRaMac.h"
+#include "LoRaMacContext.h"
+#include "LoRaMacCrypto.h"
+#include "radio.h"
+#include "timer_wheel.h"
+
+/*!
+ * Maximum radio payload size
+ */
+#define SIM_MAX_PAYLOAD 255
+
+/*!
+ * Number of uplink SNR values kept by the network server for ADR
+ */
+#define SIM_ADR_HISTORY 20
+
+/*!
+ * Number of preamble symbols the receiver needs to lock on a frame
+ */
+#define SIM_LOCK_SYMBOLS 4
+
+/*!
+ * Spreading factor value of the FSK modem
+ */
+#define SIM_SF_FSK 0
+
+typedef struct sSimShard SimShard_t;
+
+/*!
+ * Physical layer parameters of a frame
+ */
+typedef struct sSimPhy
+{
+	uint32_t Frequency;
+	/*!
+	 * LoRa spreading factor, SIM_SF_FSK for FSK
+	 */
+	uint8_t Sf;
+	/*!
+	 * Bandwidth [Hz], the bitrate [bps] for FSK
+	 */
+	uint32_t Bandwidth;
+	uint8_t Coderate;
+	uint16_t PreambleLen;
+	bool FixLen;
+	bool CrcOn;
+} SimPhy_t;
+
+/*!
+ * Uplink on the air
+ */
+typedef struct sSimUplink
+{
+	uint32_t DevId;
+	SimPhy_t Phy;
+	int8_t TxPower;
+	uint64_t StartUs;
+	uint64_t EndUs;
+	/*!
+	 * Received power and SNR at the gateway
+	 */
+	double Rssi;
+	double Snr;
+	bool Resolved;
+	uint8_t Size;
+	uint8_t Payload[SIM_MAX_PAYLOAD];
+} SimUplink_t;
+
+/*!
+ * Downlink handed to a device
+ */
+typedef struct sSimDownlink
+{
+	bool Pending;
+	SimPhy_t Phy;
+	uint64_t StartUs;
+	uint32_t ToaUs;
+	double Rssi;
+	double Snr;
+	uint8_t Size;
+	uint8_t Payload[SIM_MAX_PAYLOAD];
+} SimDownlink_t;
+
+/*!
+ * Virtual radio of a device
+ */
+typedef struct sSimRadio
+{
+	RadioEvents_t *Events;
+	RadioState_t State;
+	RadioModems_t Modem;
+	uint32_t Frequency;
+	SimPhy_t Tx;
+	int8_t TxPower;
+	SimPhy_t Rx;
+	uint16_t RxSymbTimeout;
+	bool RxContinuous;
+	uint32_t RandomCounter;
+	/*!
+	 * Data buffer of the radio, written with WriteTxBuffer. The offset wraps
+	 * around like on the SX126x.
+	 */
+	uint8_t TxBuffer[256];
+	/*!
+	 * Frame being received
+	 */
+	uint8_t RxSize;
+	uint8_t RxPayload[SIM_MAX_PAYLOAD];
+	int16_t RxRssi;
+	int8_t RxSnr;
+	TimerEvent_t TxDoneTimer;
+	TimerEvent_t RxDoneTimer;
+	TimerEvent_t RxTimeoutTimer;
+} SimRadio_t;
+
+/*!
+ * Network server state of a device, only accessed by the coordinator
+ */
+typedef struct sSimNsDevice
+{
+	bool HasFCntUp;
+	uint32_t FCntUp;
+	uint32_t FCntDown;
+	/*!
+	 * TX power index assumed by the network server
+	 */
+	uint8_t TxPower;
+	bool AdrPending;
+	uint8_t AdrPendingDr;
+	uint8_t AdrPendingTxPower;
+	uint8_t NbSnr;
+	double Snr[SIM_ADR_HISTORY];
+} SimNsDevice_t;
+
+/*!
+ * Simulated device
+ */
+typedef struct sSimDevice
+{
+	/*!
+	 * MAC instance, must stay the first member
+	 */
+	LoRaMacContext_t Mac;
+	SimRadio_t Radio;
+	SimShard_t *Shard;
+	uint32_t Id;
+	uint32_t DevAddr;
+	uint8_t NwkSKey[16];
+	uint8_t AppSKey[16];
+	/*!
+	 * Distance to the gateway [m] and shadowing [dB]
+	 */
+	double Distance;
+	double Shadowing;
+	bool Confirmed;
+	uint32_t NbEvents;
+	TimerEvent_t AppTimer;
+	uint8_t AppData[SIM_MAX_PAYLOAD];
+	/*!
+	 * Set from an accepted application request until its first
+	 * transmission, RequestTime is the time of the request [ms]
+	 */
+	bool RequestPending;
+	uint64_t RequestTime;
+	uint64_t AirtimeUs;
+	SimDownlink_t Downlink;
+	SimNsDevice_t Ns;
+} SimDevice_t;
+
+/*!
+ * Device side statistics, one set per shard
+ */
+typedef struct sSimDeviceStats
+{
+	uint64_t AppRequests;
+	uint64_t AppAccepted;
+	uint64_t AppBusy;
+	uint64_t AppRejected;
+	uint64_t ConfirmedDone;
+	uint64_t ConfirmedAcked;
+	uint64_t Retransmissions;
+	uint64_t TxStarted;
+	uint64_t DownlinksReceived;
+	uint64_t DownlinksLocked;
+	uint64_t WaitCount;
+	uint64_t WaitSumMs;
+	uint64_t WaitMaxMs;
+	/*!
+	 * Cycles spent in LoRaMacCtxMcpsRequest and in the RxDone event of the
+	 * MAC, see SimCycles
+	 */
+	uint64_t McpsRequestCycles;
+	uint64_t RxDoneCycles;
+} SimDeviceStats_t;
+
+/*!
+ * Shard of devices run by one thread
+ */
+struct sSimShard
+{
+	uint32_t Index;
+	pthread_t Thread;
+	SimDevice_t *Devices;
+	uint32_t NbDevices;
+	/*!
+	 * Crypto context shared by the devices of the shard
+	 */
+	LoRaMacCryptoCtx_t Crypto;
+	/*!
+	 * Virtual clock [ms]
+	 */
+	uint64_t Now;
+	TimerWheel_t Timers;
+	/*!
+	 * Uplinks started during the current window
+	 */
+	SimUplink_t *Uplinks;
+	uint32_t NbUplinks;
+	uint32_t UplinksCapacity;
+	SimDeviceStats_t Stats;
+};
+
+/*!
+ * \brief Makes a shard the one of the calling thread
+ *
+ * \param   shard           - Shard run by the calling thread
+ */
+void SimTimerSetShard(SimShard_t *shard);
+
+/*!
+ * \brief Returns the shard of the calling thread
+ */
+SimShard_t *SimTimerGetShard(void);
+
+/*!
+ * \brief Runs the timers of the shard of the calling thread which expire
+ *        before a given time and advances its clock to that time
+ *
+ * \param   until           - End of the window [ms]
+ */
+void SimTimerRun(uint64_t until);
+
+/*!
+ * \brief Returns the device of the active MAC instance
+ */
+SimDevice_t *SimCurrentDevice(void);
+
+/*!
+ * \brief Returns a pseudo random number derived from two values
+ */
+uint32_t SimHash(uint32_t a, uint32_t b);
+
+/*!
+ * \brief Returns a cycle counter of the host: the time stamp counter
+ *        (reference cycles) on x86, else the monotonic clock in ns
+ */
+uint64_t SimCycles(void);
+
+/*!
+ * \brief Computes the time on air of a frame
+ *
+ * \param   phy             - Physical layer parameters
+ * \param   size            - Payload size
+ * \retval  Time on air [us]
+ */
+uint32_t SimTimeOnAir(const SimPhy_t *phy, uint8_t size);
+
+/*!
+ * \brief Returns the symbol time [us], the byte time for FSK
+ */
+double SimSymbolTime(const SimPhy_t *phy);
+
+/*!
+ * \brief Returns the SNR [dB] a frame needs to be demodulated
+ */
+double SimRequiredSnr(const SimPhy_t *phy);
+
+/*!
+ * \brief Returns the noise floor of the receiver [dBm]
+ */
+double SimNoiseFloor(const SimPhy_t *phy);
+
+/*!
+ * \brief Returns the path loss between a device and the gateway [dB]
+ */
+double SimPathLoss(const SimDevice_t *device, uint32_t frequency);
+
+#endif // __SIM_H__
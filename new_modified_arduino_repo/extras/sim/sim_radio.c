@@ -0,0 +1,558 @@
+/*!
+ * \file      sim_radio.c
+ *
+ * \brief     Virtual radio of the fleet simulator
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Implements the Radio driver structure for the device of the
+ *            active MAC instance. A transmission is registered with the
+ *            shard for the coordinator and ends with TxDone after its time
+ *            on air. A reception locks on the pending downlink of the device
+ *            if the frequency, spreading factor and bandwidth match, the
+ *            receiver is open for at least SIM_LOCK_SYMBOLS of its preamble
+ *            and the link budget allows it; RxDone then follows at the end
+ *            of the frame. Otherwise the window ends with RxTimeout after
+ *            the symbol timeout or, without one, after the timeout given to
+ *            Rx, like the SX126x driver does.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "sim.h"
+#include "utilities.h"
+
+/*!
+ * Receiver noise figure [dB]
+ */
+#define NOISE_FIGURE 6.0
+
+/*!
+ * Bandwidths of the LoRa modem, indexed by the bandwidth parameter
+ */
+static const uint32_t LoRaBandwidths[] = {125000, 250000, 500000};
+
+/*!
+ * Demodulator SNR limits of SF5..SF12 [dB]
+ */
+static const double LoRaRequiredSnr[] = {-2.5, -5.0, -7.5, -10.0, -12.5, -15.0, -17.5, -20.0};
+
+uint32_t SimHash(uint32_t a, uint32_t b)
+{
+	uint64_t x = ((uint64_t)a << 32) | b;
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return (uint32_t)x;
+}
+
+uint64_t SimCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+double SimSymbolTime(const SimPhy_t *phy)
+{
+	if (phy->Sf == SIM_SF_FSK)
+	{
+		return 8e6 / phy->Bandwidth;
+	}
+	return (double)(1 << phy->Sf) * 1e6 / phy->Bandwidth;
+}
+
+uint32_t SimTimeOnAir(const SimPhy_t *phy, uint8_t size)
+{
+	double tSym = SimSymbolTime(phy);
+
+	if (phy->Sf == SIM_SF_FSK)
+	{
+		// Preamble, 3 bytes sync word, length byte, payload and CRC
+		return (uint32_t)ceil((phy->PreambleLen + 3 + ((phy->FixLen == true) ? 0 : 1) + size + ((phy->CrcOn == true) ? 2 : 0)) * tSym);
+	}
+
+	// Low data rate optimization above 16 ms symbol time
+	int de = (tSym >= 16000.0) ? 1 : 0;
+	int num = 8 * size - 4 * phy->Sf + 28 + ((phy->CrcOn == true) ? 16 : 0) - ((phy->FixLen == true) ? 20 : 0);
+	int den = 4 * (phy->Sf - 2 * de);
+	int nPayload = 8;
+
+	if (num > 0)
+	{
+		nPayload += ((num + den - 1) / den) * (phy->Coderate + 4);
+	}
+	return (uint32_t)ceil((phy->PreambleLen + 4.25 + nPayload) * tSym);
+}
+
+double SimRequiredSnr(const SimPhy_t *phy)
+{
+	if (phy->Sf == SIM_SF_FSK)
+	{
+		return 10.0;
+	}
+	return LoRaRequiredSnr[phy->Sf - 5];
+}
+
+double SimNoiseFloor(const SimPhy_t *phy)
+{
+	// FSK receiver bandwidth taken as twice the bitrate
+	double bandwidth = (phy->Sf == SIM_SF_FSK) ? 2.0 * phy->Bandwidth : phy->Bandwidth;
+
+	return -174.0 + 10.0 * log10(bandwidth) + NOISE_FIGURE;
+}
+
+static SimRadio_t *GetRadio(void)
+{
+	return &SimCurrentDevice()->Radio;
+}
+
+/*!
+ * \brief Converts the modem parameters of the Radio API to a frame
+ *        description
+ */
+static void SetPhy(SimPhy_t *phy, RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate, uint16_t preambleLen, bool fixLen, bool crcOn)
+{
+	if (modem == MODEM_FSK)
+	{
+		phy->Sf = SIM_SF_FSK;
+		phy->Bandwidth = datarate;
+		phy->Coderate = 0;
+	}
+	else
+	{
+		phy->Sf = (uint8_t)datarate;
+		phy->Bandwidth = LoRaBandwidths[(bandwidth < 3) ? bandwidth : 0];
+		phy->Coderate = coderate;
+	}
+	phy->PreambleLen = preambleLen;
+	phy->FixLen = fixLen;
+	phy->CrcOn = crcOn;
+}
+
+static void StopTimers(SimRadio_t *radio)
+{
+	TimerStop(&radio->TxDoneTimer);
+	TimerStop(&radio->RxDoneTimer);
+	TimerStop(&radio->RxTimeoutTimer);
+}
+
+static void OnTxDone(void)
+{
+	SimRadio_t *radio = GetRadio();
+
+	radio->State = RF_IDLE;
+	if ((radio->Events != NULL) && (radio->Events->TxDone != NULL))
+	{
+		radio->Events->TxDone();
+	}
+}
+
+static void OnRxDone(void)
+{
+	SimDevice_t *device = SimCurrentDevice();
+	SimRadio_t *radio = &device->Radio;
+
+	radio->State = RF_IDLE;
+	device->Shard->Stats.DownlinksLocked++;
+	if ((radio->Events != NULL) && (radio->Events->RxDone != NULL))
+	{
+		uint64_t cycles = SimCycles();
+
+		radio->Events->RxDone(radio->RxPayload, radio->RxSize, radio->RxRssi, radio->RxSnr);
+		device->Shard->Stats.RxDoneCycles += SimCycles() - cycles;
+	}
+}
+
+static void OnRxTimeout(void)
+{
+	SimRadio_t *radio = GetRadio();
+
+	radio->State = RF_IDLE;
+	if ((radio->Events != NULL) && (radio->Events->RxTimeout != NULL))
+	{
+		radio->Events->RxTimeout();
+	}
+}
+
+static void SimRadioInit(RadioEvents_t *events)
+{
+	SimRadio_t *radio = GetRadio();
+
+	radio->Events = events;
+	radio->State = RF_IDLE;
+	TimerInit(&radio->TxDoneTimer, OnTxDone);
+	TimerInit(&radio->RxDoneTimer, OnRxDone);
+	TimerInit(&radio->RxTimeoutTimer, OnRxTimeout);
+}
+
+static void SimRadioReInit(RadioEvents_t *events)
+{
+	GetRadio()->Events = events;
+}
+
+static RadioState_t SimRadioGetStatus(void)
+{
+	return GetRadio()->State;
+}
+
+static void SimRadioSetModem(RadioModems_t modem)
+{
+	GetRadio()->Modem = modem;
+}
+
+static void SimRadioSetChannel(uint32_t freq)
+{
+	GetRadio()->Frequency = freq;
+}
+
+static bool SimRadioIsChannelFree(RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime)
+{
+	(void)modem;
+	(void)freq;
+	(void)rssiThresh;
+	(void)maxCarrierSenseTime;
+	return true;
+}
+
+static uint32_t SimRadioRandom(void)
+{
+	SimDevice_t *device = SimCurrentDevice();
+
+	return SimHash(device->Id ^ 0x52414e44, device->Radio.RandomCounter++);
+}
+
+static void SimRadioSetRxConfig(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate, uint32_t bandwidthAfc, uint16_t preambleLen,
+								uint16_t symbTimeout, bool fixLen, uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, bool rxContinuous)
+{
+	SimRadio_t *radio = GetRadio();
+
+	(void)bandwidthAfc;
+	(void)payloadLen;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+
+	radio->Modem = modem;
+	SetPhy(&radio->Rx, modem, bandwidth, datarate, coderate, preambleLen, fixLen, crcOn);
+	radio->RxSymbTimeout = (modem == MODEM_LORA) ? symbTimeout : 0;
+	radio->RxContinuous = rxContinuous;
+}
+
+static void SimRadioSetTxConfig(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth, uint32_t datarate, uint8_t coderate, uint16_t preambleLen,
+								bool fixLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted, uint32_t timeout)
+{
+	SimRadio_t *radio = GetRadio();
+
+	(void)fdev;
+	(void)freqHopOn;
+	(void)hopPeriod;
+	(void)iqInverted;
+	(void)timeout;
+
+	radio->Modem = modem;
+	radio->TxPower = power;
+	SetPhy(&radio->Tx, modem, bandwidth, datarate, coderate, preambleLen, fixLen, crcOn);
+}
+
+static bool SimRadioCheckRfFrequency(uint32_t frequency)
+{
+	(void)frequency;
+	return true;
+}
+
+static uint32_t SimRadioTimeOnAir(RadioModems_t modem, uint8_t pktLen)
+{
+	(void)modem;
+	return (SimTimeOnAir(&GetRadio()->Tx, pktLen) + 999) / 1000;
+}
+
+static void SimRadioWriteTxBuffer(uint8_t offset, const uint8_t *buffer, uint8_t size)
+{
+	SimRadio_t *radio = GetRadio();
+
+	for (uint8_t i = 0; i < size; i++)
+	{
+		radio->TxBuffer[(uint8_t)(offset + i)] = buffer[i];
+	}
+}
+
+static void SimRadioSendTxBuffer(uint8_t size)
+{
+	SimDevice_t *device = SimCurrentDevice();
+	SimRadio_t *radio = &device->Radio;
+	SimShard_t *shard = device->Shard;
+	SimUplink_t *uplink;
+	uint32_t toaUs;
+
+	StopTimers(radio);
+
+	if (shard->NbUplinks == shard->UplinksCapacity)
+	{
+		shard->UplinksCapacity = (shard->UplinksCapacity == 0) ? 256 : 2 * shard->UplinksCapacity;
+		shard->Uplinks = realloc(shard->Uplinks, shard->UplinksCapacity * sizeof(SimUplink_t));
+		if (shard->Uplinks == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+
+	radio->Tx.Frequency = radio->Frequency;
+	toaUs = SimTimeOnAir(&radio->Tx, size);
+
+	uplink = &shard->Uplinks[shard->NbUplinks++];
+	uplink->DevId = device->Id;
+	uplink->Phy = radio->Tx;
+	uplink->TxPower = radio->TxPower;
+	uplink->StartUs = shard->Now * 1000;
+	uplink->EndUs = uplink->StartUs + toaUs;
+	uplink->Resolved = false;
+	uplink->Size = size;
+	memcpy1(uplink->Payload, radio->TxBuffer, size);
+
+	device->AirtimeUs += toaUs;
+	shard->Stats.TxStarted++;
+	if (device->RequestPending == true)
+	{
+		uint64_t wait = shard->Now - device->RequestTime;
+
+		shard->Stats.WaitCount++;
+		shard->Stats.WaitSumMs += wait;
+		if (wait > shard->Stats.WaitMaxMs)
+		{
+			shard->Stats.WaitMaxMs = wait;
+		}
+		device->RequestPending = false;
+	}
+
+	radio->State = RF_TX_RUNNING;
+	TimerSetValue(&radio->TxDoneTimer, (uint32_t)((uplink->EndUs + 999) / 1000 - shard->Now));
+	TimerStart(&radio->TxDoneTimer);
+}
+
+static void SimRadioSend(uint8_t *buffer, uint8_t size)
+{
+	SimRadioWriteTxBuffer(0, buffer, size);
+	SimRadioSendTxBuffer(size);
+}
+
+static void SimRadioSleep(void)
+{
+	SimRadio_t *radio = GetRadio();
+
+	StopTimers(radio);
+	radio->State = RF_IDLE;
+}
+
+static void SimRadioRx(uint32_t timeout)
+{
+	SimDevice_t *device = SimCurrentDevice();
+	SimRadio_t *radio = &device->Radio;
+	SimDownlink_t *downlink = &device->Downlink;
+	uint64_t nowUs = device->Shard->Now * 1000;
+	uint64_t closeUs = UINT64_MAX;
+	double tSym = SimSymbolTime(&radio->Rx);
+
+	StopTimers(radio);
+	radio->State = RF_RX_RUNNING;
+	radio->Rx.Frequency = radio->Frequency;
+
+	if (radio->RxSymbTimeout != 0)
+	{
+		closeUs = nowUs + (uint64_t)(radio->RxSymbTimeout * tSym);
+	}
+	else if ((timeout != 0) && (radio->RxContinuous == false))
+	{
+		closeUs = nowUs + (uint64_t)timeout * 1000;
+	}
+
+	if (downlink->Pending == true)
+	{
+		uint64_t lockUs = downlink->StartUs + (uint64_t)((downlink->Phy.PreambleLen - SIM_LOCK_SYMBOLS) * SimSymbolTime(&downlink->Phy));
+
+		if (nowUs > lockUs)
+		{
+			// The frame started too long ago
+			downlink->Pending = false;
+		}
+		else if ((downlink->StartUs < closeUs) && (downlink->Phy.Frequency == radio->Rx.Frequency) &&
+				 (downlink->Phy.Sf == radio->Rx.Sf) && (downlink->Phy.Bandwidth == radio->Rx.Bandwidth))
+		{
+			downlink->Pending = false;
+			if (downlink->Snr >= SimRequiredSnr(&downlink->Phy))
+			{
+				uint64_t endMs = (downlink->StartUs + downlink->ToaUs + 999) / 1000;
+
+				radio->RxSize = downlink->Size;
+				memcpy1(radio->RxPayload, downlink->Payload, downlink->Size);
+				radio->RxRssi = (int16_t)lround(downlink->Rssi);
+				radio->RxSnr = (int8_t)lround(downlink->Snr);
+				TimerSetValue(&radio->RxDoneTimer, (uint32_t)(endMs - device->Shard->Now));
+				TimerStart(&radio->RxDoneTimer);
+				return;
+			}
+		}
+	}
+
+	if (closeUs != UINT64_MAX)
+	{
+		TimerSetValue(&radio->RxTimeoutTimer, (uint32_t)((closeUs + 999) / 1000 - device->Shard->Now));
+		TimerStart(&radio->RxTimeoutTimer);
+	}
+}
+
+static void SimRadioSetCadParams(uint8_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, uint8_t cadExitMode, uint32_t cadTimeout)
+{
+	(void)cadSymbolNum;
+	(void)cadDetPeak;
+	(void)cadDetMin;
+	(void)cadExitMode;
+	(void)cadTimeout;
+}
+
+static void SimRadioStartCad(void)
+{
+	SimRadio_t *radio = GetRadio();
+
+	if ((radio->Events != NULL) && (radio->Events->CadDone != NULL))
+	{
+		radio->Events->CadDone(false);
+	}
+}
+
+static void SimRadioSetTxContinuousWave(uint32_t freq, int8_t power, uint16_t time)
+{
+	(void)freq;
+	(void)power;
+	(void)time;
+}
+
+static int16_t SimRadioRssi(RadioModems_t modem)
+{
+	(void)modem;
+	return (int16_t)SimNoiseFloor(&GetRadio()->Rx);
+}
+
+static void SimRadioWrite(uint16_t addr, uint8_t data)
+{
+	(void)addr;
+	(void)data;
+}
+
+static uint8_t SimRadioRead(uint16_t addr)
+{
+	(void)addr;
+	return 0;
+}
+
+static void SimRadioWriteBuffer(uint16_t addr, uint8_t *buffer, uint8_t size)
+{
+	(void)addr;
+	(void)buffer;
+	(void)size;
+}
+
+static void SimRadioReadBuffer(uint16_t addr, uint8_t *buffer, uint8_t size)
+{
+	(void)addr;
+	(void)buffer;
+	(void)size;
+}
+
+static void SimRadioSetMaxPayloadLength(RadioModems_t modem, uint8_t max)
+{
+	(void)modem;
+	(void)max;
+}
+
+static void SimRadioSetPublicNetwork(bool enable)
+{
+	(void)enable;
+}
+
+static void SimRadioSetCustomSyncWord(uint16_t syncword)
+{
+	(void)syncword;
+}
+
+static uint16_t SimRadioGetSyncWord(void)
+{
+	return 0x3444;
+}
+
+static uint32_t SimRadioGetWakeupTime(void)
+{
+	return RADIO_TCXO_SETUP_TIME + RADIO_WAKEUP_TIME;
+}
+
+static void SimRadioIrqProcess(void)
+{
+}
+
+static void SimRadioEnforceLowDRopt(bool enforce)
+{
+	(void)enforce;
+}
+
+static void SimRadioSetRxDutyCycle(uint32_t rxTime, uint32_t sleepTime)
+{
+	(void)sleepTime;
+	SimRadioRx(rxTime);
+}
+
+/*!
+ * Radio driver structure initialization
+ */
+const struct Radio_s Radio =
+	{
+		SimRadioInit,
+		SimRadioReInit,
+		SimRadioGetStatus,
+		SimRadioSetModem,
+		SimRadioSetChannel,
+		SimRadioIsChannelFree,
+		SimRadioRandom,
+		SimRadioSetRxConfig,
+		SimRadioSetTxConfig,
+		SimRadioCheckRfFrequency,
+		SimRadioTimeOnAir,
+		SimRadioSend,
+		SimRadioSleep,
+		SimRadioSleep,
+		SimRadioRx,
+		SimRadioSetCadParams,
+		SimRadioStartCad,
+		SimRadioSetTxContinuousWave,
+		SimRadioRssi,
+		SimRadioWrite,
+		SimRadioRead,
+		SimRadioWriteBuffer,
+		SimRadioReadBuffer,
+		SimRadioSetMaxPayloadLength,
+		SimRadioSetPublicNetwork,
+		SimRadioSetCustomSyncWord,
+		SimRadioGetSyncWord,
+		SimRadioGetWakeupTime,
+		SimRadioIrqProcess,
+		SimRadioIrqProcess,
+		SimRadioIrqProcess,
+		SimRadioRx,
+		SimRadioEnforceLowDRopt,
+		SimRadioSetRxDutyCycle,
+		SimRadioWriteTxBuffer,
+		SimRadioSendTxBuffer,
+};
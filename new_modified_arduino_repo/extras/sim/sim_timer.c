@@ -0,0 +1,110 @@
+/*!
+ * \file      sim_timer.c
+ *
+ * \brief     Virtual time timer backend of the fleet simulator
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Each shard keeps its running timers in a hierarchical timer
+ *            wheel with a 1 ms tick, see timer_wheel.h. Timers with the
+ *            same expiry run in start order. A timer remembers the MAC
+ *            instance which was active when it was initialized and makes it
+ *            the active one again before its callback is called, so the
+ *            callbacks of the MAC and of the virtual radio run on their own
+ *            device. The random generator of the MAC is reseeded from the
+ *            device and its event count before each callback, which makes
+ *            the behaviour of a device independent of the shard it runs in.
+ */
+#include <stddef.h>
+
+#include "sim.h"
+#include "utilities.h"
+
+#define TIMER_OF_NODE(node) ((TimerEvent_t *)((uint8_t *)(node) - offsetof(TimerEvent_t, Node)))
+
+static _Thread_local SimShard_t *Shard;
+
+void SimTimerSetShard(SimShard_t *shard)
+{
+	Shard = shard;
+	TimerWheelInit(&Shard->Timers, Shard->Now);
+}
+
+SimShard_t *SimTimerGetShard(void)
+{
+	return Shard;
+}
+
+SimDevice_t *SimCurrentDevice(void)
+{
+	return (SimDevice_t *)LoRaMacGetContext();
+}
+
+void TimerInit(TimerEvent_t *obj, void (*callback)(void))
+{
+	obj->ReloadValue = 0;
+	obj->IsRunning = false;
+	obj->Callback = callback;
+	obj->Owner = LoRaMacGetContext();
+	obj->Node.Prev = NULL;
+}
+
+void TimerStart(TimerEvent_t *obj)
+{
+	if (obj->IsRunning == true)
+	{
+		return;
+	}
+	obj->IsRunning = true;
+	TimerWheelInsert(&Shard->Timers, &obj->Node, Shard->Now + obj->ReloadValue);
+}
+
+void TimerStop(TimerEvent_t *obj)
+{
+	if (obj->IsRunning == true)
+	{
+		TimerWheelRemove(&Shard->Timers, &obj->Node);
+		obj->IsRunning = false;
+	}
+}
+
+void TimerReset(TimerEvent_t *obj)
+{
+	TimerStop(obj);
+	TimerStart(obj);
+}
+
+void TimerSetValue(TimerEvent_t *obj, uint32_t value)
+{
+	TimerStop(obj);
+	obj->ReloadValue = value;
+}
+
+TimerTime_t TimerGetCurrentTime(void)
+{
+	return (TimerTime_t)Shard->Now;
+}
+
+TimerTime_t TimerGetElapsedTime(TimerTime_t savedTime)
+{
+	return (TimerTime_t)Shard->Now - savedTime;
+}
+
+void SimTimerRun(uint64_t until)
+{
+	TimerWheelNode_t *node;
+
+	// The window ends before until
+	while ((node = TimerWheelExpire(&Shard->Timers, until - 1)) != NULL)
+	{
+		TimerEvent_t *obj = TIMER_OF_NODE(node);
+		SimDevice_t *device = (SimDevice_t *)obj->Owner;
+
+		obj->IsRunning = false;
+		Shard->Now = node->Expiry;
+		LoRaMacSetContext(&device->Mac);
+		srand1(SimHash(device->Id, device->NbEvents++));
+		obj->Callback();
+	}
+	Shard->Now = until;
+}
@@ -40,6 +40,59 @@ Maintainer: Miguel Luis and Gregory Cristian
 #error "SX126x-Arduino V2.0 does support all LoRaWAN regions without definition of 'REGION_XXYYY.\n\nPlease read detailed information how to use it on https://github.com/beegee-tokyo/SX126x-Arduino/blob/master/README_V2.md"
 #endif
 
+/*
+ * Single region build: define LORAMAC_SINGLE_REGION to one of AS923, AU915,
+ * CN470, CN779, EU433, EU868, IN865, KR920, RU864 or US915, e.g.
+ * -DLORAMAC_SINGLE_REGION=EU868, to compile only this region. The MAC then
+ * calls it without the dispatch of Region.c, see Region.h. The AS923 build
+ * supports the AS923 sub-bands too.
+ */
+#if defined(LORAMAC_SINGLE_REGION)
+
+#define LORAMAC_SINGLE_REGION_ID_AS923 1
+#define LORAMAC_SINGLE_REGION_ID_AU915 2
+#define LORAMAC_SINGLE_REGION_ID_CN470 3
+#define LORAMAC_SINGLE_REGION_ID_CN779 4
+#define LORAMAC_SINGLE_REGION_ID_EU433 5
+#define LORAMAC_SINGLE_REGION_ID_EU868 6
+#define LORAMAC_SINGLE_REGION_ID_IN865 7
+#define LORAMAC_SINGLE_REGION_ID_KR920 8
+#define LORAMAC_SINGLE_REGION_ID_RU864 9
+#define LORAMAC_SINGLE_REGION_ID_US915 10
+
+#define LORAMAC_SINGLE_REGION_CAT(a, b) a##b
+#define LORAMAC_SINGLE_REGION_XCAT(a, b) LORAMAC_SINGLE_REGION_CAT(a, b)
+#define LORAMAC_SINGLE_REGION_ID LORAMAC_SINGLE_REGION_XCAT(LORAMAC_SINGLE_REGION_ID_, LORAMAC_SINGLE_REGION)
+
+#if (LORAMAC_SINGLE_REGION_ID == 1)
+#define REGION_AS923
+#define REGION_AS923_1
+#define REGION_AS923_2
+#define REGION_AS923_3
+#elif (LORAMAC_SINGLE_REGION_ID == 2)
+#define REGION_AU915
+#elif (LORAMAC_SINGLE_REGION_ID == 3)
+#define REGION_CN470
+#elif (LORAMAC_SINGLE_REGION_ID == 4)
+#define REGION_CN779
+#elif (LORAMAC_SINGLE_REGION_ID == 5)
+#define REGION_EU433
+#elif (LORAMAC_SINGLE_REGION_ID == 6)
+#define REGION_EU868
+#elif (LORAMAC_SINGLE_REGION_ID == 7)
+#define REGION_IN865
+#elif (LORAMAC_SINGLE_REGION_ID == 8)
+#define REGION_KR920
+#elif (LORAMAC_SINGLE_REGION_ID == 9)
+#define REGION_RU864
+#elif (LORAMAC_SINGLE_REGION_ID == 10)
+#define REGION_US915
+#else
+#error "LORAMAC_SINGLE_REGION must be one of AS923, AU915, CN470, CN779, EU433, EU868, IN865, KR920, RU864, US915"
+#endif
+
+#else
+
 #define REGION_AS923
 #define REGION_AU915
 #define REGION_CN470
@@ -54,6 +107,8 @@ Maintainer: Miguel Luis and Gregory Cristian
 #define REGION_AS923_3
 #define REGION_RU864
 
+#endif
+
 /**@brief Enable or disable duty cycle control
  * LoRaWAN ETSI duty cycle control enable/disable. 
  * Please note that ETSI mandates duty cycled transmissions. 
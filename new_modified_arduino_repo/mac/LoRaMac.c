@@ -18,38 +18,27 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jaeckle ( STACKFORCE )
 */
 // #include "boards/mcu/board.h"
+// Only the instance fields are used here, not the default instance names
+#define LORAMAC_NO_COMPAT_NAMES
 #include "utilities.h"
 #include "LoRaMac.h"
 #include "region/Region.h"
 #include "LoRaMacCrypto.h"
+#include "LoRaMacCommands.h"
+#include "LoRaMacContext.h"
+#include "LoRaMacNvm.h"
 #include "LoRaMacTest.h"
 #include "timer.h"
 #include "radio.h"
 #include "sx126x-debug.h"
 
-
 extern bool lmh_mac_is_busy;
 
-/*!
- * Maximum PHY layer payload size
- */
-#define LORAMAC_PHY_MAXPAYLOAD 255
-
-/*!
- * Maximum MAC commands buffer size
- */
-#define LORA_MAC_COMMAND_MAX_LENGTH 128
-
 /*!
  * Maximum length of the fOpts field
  */
 #define LORA_MAC_COMMAND_MAX_FOPTS_LENGTH 15
 
-/*!
- * LoRaMac region.
- */
-LoRaMacRegion_t LoRaMacRegion;
-
 /*!
  * LoRaMac duty cycle for the back-off procedure during the first hour.
  */
@@ -70,223 +59,6 @@ extern bool singleChannelGateway;
 extern uint8_t singleChannelSelected;
 extern int8_t singleChannelDatarate;
 
-/*!
- * Device IEEE EUI
- */
-static uint8_t *LoRaMacDevEui;
-
-/*!
- * Application IEEE EUI
- */
-static uint8_t *LoRaMacAppEui;
-
-/*!
- * AES encryption/decryption cipher application key
- */
-static uint8_t *LoRaMacAppKey;
-
-/*!
- * AES encryption/decryption cipher network session key
- */
-uint8_t LoRaMacNwkSKey[] =
-	{
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-/*!
- * AES encryption/decryption cipher application session key
- */
-uint8_t LoRaMacAppSKey[] =
-	{
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-/*!
- * Device nonce is a random value extracted by issuing a sequence of RSSI
- * measurements
- */
-static uint16_t LoRaMacDevNonce;
-
-/*!
- * Network ID ( 3 bytes )
- */
-static uint32_t LoRaMacNetID;
-
-/*!
- * Mote Address
- */
-uint32_t LoRaMacDevAddr;
-
-/*!
- * Multicast channels linked list
- */
-static MulticastParams_t *MulticastChannels = NULL;
-
-/*!
- * Actual device class
- */
-static DeviceClass_t LoRaMacDeviceClass;
-
-/*!
- * Indicates if the node is connected to a private or public network
- */
-bool PublicNetwork;
-
-/*!
- * Indicates if the node supports repeaters
- */
-static bool RepeaterSupport;
-
-/*!
- * Buffer containing the data to be sent or received.
- */
-static uint8_t LoRaMacBuffer[LORAMAC_PHY_MAXPAYLOAD];
-
-/*!
- * Length of packet in LoRaMacBuffer
- */
-static uint16_t LoRaMacBufferPktLen = 0;
-
-/*!
- * Length of the payload in LoRaMacBuffer
- */
-static uint8_t LoRaMacTxPayloadLen = 0;
-
-/*!
- * Buffer containing the upper layer data.
- */
-static uint8_t LoRaMacRxPayload[LORAMAC_PHY_MAXPAYLOAD];
-
-/*!
- * LoRaMAC frame counter. Each time a packet is sent the counter is incremented.
- * Only the 16 LSB bits are sent
- */
-static uint32_t UpLinkCounter = 0;
-
-/*!
- * LoRaMAC frame counter. Each time a packet is received the counter is incremented.
- * Only the 16 LSB bits are received
- */
-static uint32_t DownLinkCounter = 0;
-
-/*!
- * IsPacketCounterFixed enables the MIC field tests by fixing the
- * UpLinkCounter value
- */
-static bool IsUpLinkCounterFixed = false;
-
-/*!
- * Used for test purposes. Disables the opening of the reception windows.
- */
-static bool IsRxWindowsEnabled = true;
-
-/*!
- * Indicates if the MAC layer has already joined a network.
- */
-eJoinStatus_t IsLoRaMacNetworkJoined = JOIN_NOT_START;
-
-/*!
- * LoRaMac ADR control status
- */
-static bool AdrCtrlOn = false;
-
-/*!
- * Counts the number of missed ADR acknowledgements
- */
-static uint32_t AdrAckCounter = 0;
-
-/*!
- * If the node has sent a FRAME_TYPE_DATA_CONFIRMED_UP this variable indicates
- * if the nodes needs to manage the server acknowledgement.
- */
-static bool NodeAckRequested = false;
-
-/*!
- * If the server has sent a FRAME_TYPE_DATA_CONFIRMED_DOWN this variable indicates
- * if the ACK bit must be set for the next transmission
- */
-static bool SrvAckRequested = false;
-
-/*!
- * Indicates if the MAC layer wants to send MAC commands
- */
-static bool MacCommandsInNextTx = false;
-
-/*!
- * Contains the current MacCommandsBuffer index
- */
-static uint8_t MacCommandsBufferIndex = 0;
-
-/*!
- * Contains the current MacCommandsBuffer index for MAC commands to repeat
- */
-static uint8_t MacCommandsBufferToRepeatIndex = 0;
-
-/*!
- * Buffer containing the MAC layer commands
- */
-static uint8_t MacCommandsBuffer[LORA_MAC_COMMAND_MAX_LENGTH];
-
-/*!
- * Buffer containing the MAC layer commands which must be repeated
- */
-static uint8_t MacCommandsBufferToRepeat[LORA_MAC_COMMAND_MAX_LENGTH];
-
-/*!
- * LoRaMac parameters
- */
-LoRaMacParams_t LoRaMacParams;
-
-/*!
- * LoRaMac default parameters
- */
-LoRaMacParams_t LoRaMacParamsDefaults;
-
-/*!
- * Uplink messages repetitions counter
- */
-static uint8_t ChannelsNbRepCounter = 0;
-
-/*!
- * Maximum duty cycle
- * \remark Possibility to shutdown the device.
- */
-static uint8_t MaxDCycle = 0;
-
-/*!
- * Aggregated duty cycle management
- */
-static uint16_t AggregatedDCycle;
-static TimerTime_t AggregatedLastTxDoneTime;
-static TimerTime_t AggregatedTimeOff;
-
-/*!
- * Enables/Disables duty cycle management (Test only)
- */
-static bool DutyCycleOn;
-
-/*!
- * Current channel index
- */
-static uint8_t Channel;
-
-/*!
- * Current channel index
- */
-static uint8_t LastTxChannel;
-
-/*!
- * Set to true, if the last uplink was a join request
- */
-static bool LastTxIsJoinRequest;
-
-/*!
- * Stores the time at LoRaMac initialization.
- *
- * \remark Used for the BACKOFF_DC computation.
- */
-static TimerTime_t LoRaMacInitializationTime = 0;
-
 /*!
  * LoRaMac internal states
  */
@@ -302,121 +74,70 @@ enum eLoRaMacState
 	LORAMAC_RX_ABORT = 0x00000040,
 };
 
-/*!
- * LoRaMac internal state
- */
-uint32_t LoRaMacState = LORAMAC_IDLE;
-
-/*!
- * LoRaMac timer used to check the LoRaMacState (runs every second)
- */
-static TimerEvent_t MacStateCheckTimer;
-
-/*!
- * LoRaMac upper layer event functions
- */
-static LoRaMacPrimitives_t *LoRaMacPrimitives;
-
-/*!
- * LoRaMac upper layer callback functions
- */
-static LoRaMacCallback_t *LoRaMacCallbacks;
-
 /*!
  * Radio events function pointer
  */
-static RadioEvents_t RadioEvents;
-
-/*!
- * LoRaMac duty cycle delayed Tx timer
- */
-static TimerEvent_t TxDelayedTimer;
-
-/*!
- * LoRaMac reception windows timers
- */
-static TimerEvent_t RxWindowTimer1;
-static TimerEvent_t RxWindowTimer2;
-
-/*!
- * LoRaMac reception windows delay
- * \remark normal frame: RxWindowXDelay = ReceiveDelayX - RADIO_WAKEUP_TIME
- *         join frame  : RxWindowXDelay = JoinAcceptDelayX - RADIO_WAKEUP_TIME
- */
-static uint32_t RxWindow1Delay;
-static uint32_t RxWindow2Delay;
-
-/*!
- * LoRaMac Rx windows configuration
- */
-static RxConfigParams_t RxWindow1Config;
-static RxConfigParams_t RxWindow2Config;
-
-/*!
- * Maximum number of times the MAC layer tries to get an acknowledge.
- */
-// #define MAX_ACK_RETRIES 8
-uint8_t max_ack_retries = 8;
+static LORAMAC_THREAD_LOCAL RadioEvents_t RadioEvents;
 
 /*!
- * Acknowledge timeout timer. Used for packet retransmissions.
+ * Default LoRaMac instance
  */
-static TimerEvent_t AckTimeoutTimer;
-
-/*!
- * Number of trials to get a frame acknowledged
- */
-static uint8_t AckTimeoutRetries = 1;
-
-/*!
- * Number of trials to get a frame acknowledged
- */
-static uint8_t AckTimeoutRetriesCounter = 1;
-
-/*!
- * Indicates if the AckTimeout timer has expired or not
- */
-static bool AckTimeoutRetry = false;
-
-/*!
- * Last transmission time on air
- */
-TimerTime_t TxTimeOnAir = 0;
-
-/*!
- * Number of trials for the Join Request
- */
-static uint8_t JoinRequestTrials;
-
-/*!
- * Maximum number of trials for the Join Request
- */
-static uint8_t MaxJoinRequestTrials;
-
-/*!
- * Structure to hold an MCPS indication data.
- */
-static McpsIndication_t McpsIndication;
+static LoRaMacContext_t DefaultContext =
+	{
+		.IsRxWindowsEnabled = true,
+		.IsLoRaMacNetworkJoined = JOIN_NOT_START,
+		.State = LORAMAC_IDLE,
+		.MaxAckRetries = 8,
+		.AckTimeoutRetries = 1,
+		.AckTimeoutRetriesCounter = 1,
+		.SendJoinNow = true,
+};
 
 /*!
- * Structure to hold MCPS confirm data.
+ * Active LoRaMac instance
  */
-static McpsConfirm_t McpsConfirm;
+static LORAMAC_THREAD_LOCAL LoRaMacContext_t *MacCtx = &DefaultContext;
 
 /*!
- * Structure to hold MLME confirm data.
+ * \brief Makes an instance the active one. Saves the region state of the
+ *        previous instance and restores the one of the new instance.
+ *
+ * \param  ctx Instance to activate
  */
-static MlmeConfirm_t MlmeConfirm;
+static void SetContext(LoRaMacContext_t *ctx)
+{
+	if (ctx == MacCtx)
+	{
+		return;
+	}
+	if (MacCtx->Initialized == true)
+	{
+		RegionSaveContext(MacCtx->Region, &MacCtx->RegionContext);
+	}
+	MacCtx = ctx;
+	if (MacCtx->Initialized == true)
+	{
+		RegionRestoreContext(MacCtx->Region, &MacCtx->RegionContext);
+	}
+}
 
 /*!
- * Holds the current rx window slot
+ * Session snapshot being written or restored. Too large for the stack of
+ * the timer and radio event handlers.
  */
-static uint8_t RxSlot = 0;
+static LORAMAC_THREAD_LOCAL LoRaMacNvmSession_t NvmSession;
 
 /*!
- * LoRaMac tx/rx operation state
+ * \brief Returns the crypto context of the active instance
  */
-LoRaMacFlags_t LoRaMacFlags;
+static LoRaMacCryptoCtx_t *GetCryptoCtx(void)
+{
+	if (MacCtx->Crypto == NULL)
+	{
+		return LoRaMacCryptoGetDefaultCtx();
+	}
+	return MacCtx->Crypto;
+}
 
 /*!
  * \brief Function to be executed on Radio Tx Done event
@@ -487,13 +208,8 @@ static void RxWindowSetup(bool rxContinuous, uint32_t maxRxWindow);
  *
  * \remark MAC layer internal function
  *
- * \param  cmd MAC command to be added
- *                 [MOTE_MAC_LINK_CHECK_REQ,
- *                  MOTE_MAC_LINK_ADR_ANS,
- *                  MOTE_MAC_DUTY_CYCLE_ANS,
- *                  MOTE_MAC_RX2_PARAM_SET_ANS,
- *                  MOTE_MAC_DEV_STATUS_ANS
- *                  MOTE_MAC_NEW_CHANNEL_ANS]
+ * \param  cmd MAC command to be added, with LORAMAC_COMMAND_UPLINK set in
+ *             MacCommands
  * \param  p1  1st parameter ( optional depends on the command )
  * \param  p2  2nd parameter ( optional depends on the command )
  *
@@ -535,6 +251,14 @@ static bool ValidatePayloadLength(uint8_t lenN, int8_t datarate, uint8_t fOptsLe
 
 /*!
  * \brief Decodes MAC commands in the fOpts field and in the payload
+ *
+ * \remark The commands are dispatched through MacCommands. The parsing stops
+ *         at the first unknown or truncated command.
+ *
+ * \param  payload Frame
+ * \param  macIndex Index of the first command in payload
+ * \param  commandsSize Index following the last command in payload
+ * \param  snr SNR of the frame, answered in DevStatusAns
  */
 static void ProcessMacCommands(uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr);
 
@@ -561,6 +285,37 @@ LoRaMacStatus_t Send(LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uint
  */
 LoRaMacStatus_t PrepareFrame(LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl, uint8_t fPort, void *fBuffer, uint16_t fBufferSize);
 
+/*!
+ * \brief Sets the FRMPayload of the frame to be sent. The payload is copied
+ *        unless LORAMAC_ZERO_COPY_TX is set and it is not a MAC command
+ *        payload.
+ *
+ * \param  payload     FRMPayload, in clear
+ * \param  size        FRMPayload size
+ * \param  isMacCommands Set if the payload is the MAC command buffer
+ */
+static void SetTxPayload(const uint8_t *payload, uint8_t size, bool isMacCommands);
+
+/*!
+ * \brief Writes the prepared frame to the radio, encrypting and signing it on
+ *        the way, and starts the transmission
+ *
+ * \retval Status of the operation, the frame is not sent if the crypto
+ *         backend fails
+ */
+static LoRaMacStatus_t SendTxFrame(void);
+
+/*!
+ * \brief Output of LoRaMacCryptoCtxEncryptAndSign, writes the frame to the
+ *        radio and keeps the encrypted FRMPayload and the MIC for the
+ *        retransmissions
+ *
+ * \param  offset      Offset in the frame
+ * \param  buffer      Part of the frame
+ * \param  size        Size of the part
+ */
+static void WriteTxFrame(uint8_t offset, const uint8_t *buffer, uint8_t size);
+
 /*
  * \brief Schedules the frame according to the duty cycle
  *
@@ -613,6 +368,55 @@ LoRaMacStatus_t SetTxContinuousWave1(uint16_t timeout, uint32_t frequency, uint8
  */
 static void ResetMacParameters(void);
 
+/*!
+ * \brief Accounts the last uplink in the airtime ledger
+ *
+ * \param  txDoneTime  End of transmission of the uplink
+ */
+static void AirtimeTxDone(TimerTime_t txDoneTime);
+
+/*!
+ * \brief Gets the budget, consumed and remaining airtime of a band
+ *
+ * \param  airtime     Band index as input, airtime as output
+ * \retval status       Status of the operation.
+ */
+static LoRaMacStatus_t GetAirtime(MibAirtimeParams_t *airtime);
+
+/*!
+ * \brief Sets the channels, bands and MAC state of the airtime ledger
+ *        parameters
+ *
+ * \param  airtimeNextTx Ledger parameters, Datarate and TimeOnAir are left
+ *                       to the caller
+ */
+static void GetAirtimeChannels(LoRaMacAirtimeNextTxParams_t *airtimeNextTx);
+
+/*!
+ * \brief Projects the earliest time an uplink can be sent
+ *
+ * \param  nextTx      Datarate and payload size as input, time on air and
+ *                     delay as output
+ * \retval status       Status of the operation.
+ */
+static LoRaMacStatus_t GetAirtimeNextTx(MibAirtimeNextTxParams_t *nextTx);
+
+/*!
+ * \brief Writes a snapshot of the session to the session log
+ *
+ * \retval true if the snapshot was written
+ */
+static bool NvmStoreSession(void);
+
+/*!
+ * \brief Writes a frame counter checkpoint if the uplink counter reached the
+ *        stored ceiling or the downlink counter advanced by a stride
+ *
+ * \retval false if the uplink counter reached the stored ceiling and the new
+ *         one could not be written, the counter must not be used then
+ */
+static bool NvmCheckpoint(void);
+
 static void OnRadioTxDone(void)
 {
 	LOG_LIB("LM", "OnRadioTxDone");
@@ -622,86 +426,88 @@ static void OnRadioTxDone(void)
 	SetBandTxDoneParams_t txDone;
 	TimerTime_t curTime = TimerGetCurrentTime();
 
-	if (LoRaMacDeviceClass != CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass != CLASS_C)
 	{
 		Radio.Sleep();
 	}
 
 	// Setup timers
-	if (IsRxWindowsEnabled == true)
+	if (MacCtx->IsRxWindowsEnabled == true)
 	{
-		LOG_LIB("LM", "OnRadioTxDone => RX Windows #1 %d #2 %d", RxWindow1Delay, RxWindow2Delay);
+		LOG_LIB("LM", "OnRadioTxDone => RX Windows #1 %d #2 %d", MacCtx->RxWindow1Delay, MacCtx->RxWindow2Delay);
 
-		TimerSetValue(&RxWindowTimer1, RxWindow1Delay);
-		TimerStart(&RxWindowTimer1);
-		TimerSetValue(&RxWindowTimer2, RxWindow2Delay);
-		TimerStart(&RxWindowTimer2);
-		if ((LoRaMacDeviceClass == CLASS_C) || (NodeAckRequested == true))
+		TimerSetValue(&MacCtx->RxWindowTimer1, MacCtx->RxWindow1Delay);
+		TimerStart(&MacCtx->RxWindowTimer1);
+		TimerSetValue(&MacCtx->RxWindowTimer2, MacCtx->RxWindow2Delay);
+		TimerStart(&MacCtx->RxWindowTimer2);
+		if ((MacCtx->LoRaMacDeviceClass == CLASS_C) || (MacCtx->NodeAckRequested == true))
 		{
 			getPhy.Attribute = PHY_ACK_TIMEOUT;
-			phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-			TimerSetValue(&AckTimeoutTimer, RxWindow2Delay + phyParam.Value);
-			TimerStart(&AckTimeoutTimer);
+			phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+			TimerSetValue(&MacCtx->AckTimeoutTimer, MacCtx->RxWindow2Delay + phyParam.Value);
+			TimerStart(&MacCtx->AckTimeoutTimer);
 		}
 	}
 	else
 	{
-		McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-		MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
+		MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+		MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
 
-		if (LoRaMacFlags.Value == 0)
+		if (MacCtx->LoRaMacFlags.Value == 0)
 		{
-			LoRaMacFlags.Bits.McpsReq = 1;
+			MacCtx->LoRaMacFlags.Bits.McpsReq = 1;
 		}
-		LoRaMacFlags.Bits.MacDone = 1;
+		MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 	}
 
 	// Verify if the last uplink was a join request
-	if ((LoRaMacFlags.Bits.MlmeReq == 1) && (MlmeConfirm.MlmeRequest == MLME_JOIN))
+	if ((MacCtx->LoRaMacFlags.Bits.MlmeReq == 1) && (MacCtx->MlmeConfirm.MlmeRequest == MLME_JOIN))
 	{
 		LOG_LIB("LM", "OnRadioTxDone => TX was Join Request");
 
-		LastTxIsJoinRequest = true;
+		MacCtx->LastTxIsJoinRequest = true;
 	}
 	else
 	{
-		LastTxIsJoinRequest = false;
+		MacCtx->LastTxIsJoinRequest = false;
 	}
 
 	// Store last Tx channel
-	LastTxChannel = Channel;
+	MacCtx->LastTxChannel = MacCtx->Channel;
 	// Update last tx done time for the current channel
-	txDone.Channel = Channel;
+	txDone.Channel = MacCtx->Channel;
 	//		txDone.Joined = IsLoRaMacNetworkJoined;
-	txDone.Joined = (IsLoRaMacNetworkJoined == JOIN_OK);
+	txDone.Joined = (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK);
 	txDone.LastTxDoneTime = curTime;
-	RegionSetBandTxDone(LoRaMacRegion, &txDone);
+	RegionSetBandTxDone(MacCtx->Region, &txDone);
 	// Update Aggregated last tx done time
-	AggregatedLastTxDoneTime = curTime;
+	MacCtx->AggregatedLastTxDoneTime = curTime;
+	// Account the uplink in the airtime ledger
+	AirtimeTxDone(curTime);
 
-	if (NodeAckRequested == false)
+	if (MacCtx->NodeAckRequested == false)
 	{
-		McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-		ChannelsNbRepCounter++;
+		MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+		MacCtx->ChannelsNbRepCounter++;
 	}
 }
 
 static void PrepareRxDoneAbort(void)
 {
-	LoRaMacState |= LORAMAC_RX_ABORT;
+	MacCtx->State |= LORAMAC_RX_ABORT;
 
-	if (NodeAckRequested)
+	if (MacCtx->NodeAckRequested)
 	{
 		OnAckTimeoutTimerEvent();
 	}
 
-	LoRaMacFlags.Bits.McpsInd = 1;
-	LoRaMacFlags.Bits.MacDone = 1;
+	MacCtx->LoRaMacFlags.Bits.McpsInd = 1;
+	MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 
 	// Trig OnMacCheckTimerEvent call as soon as possible
 	// TimerSetValue(&MacStateCheckTimer, 100);
 	// TimerStart(&MacStateCheckTimer);
-	TimerStop(&MacStateCheckTimer);
+	TimerStop(&MacCtx->MacStateCheckTimer);
 	OnMacStateCheckTimerEvent();
 }
 
@@ -723,6 +529,7 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 	uint8_t frameLen = 0;
 	uint32_t mic = 0;
 	uint32_t micRx = 0;
+	LoRaMacCryptoStatus_t cryptoStatus;
 
 	uint16_t sequenceCounter = 0;
 	uint16_t sequenceCounterPrev = 0;
@@ -730,29 +537,30 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 	uint32_t downLinkCounter = 0;
 
 	MulticastParams_t *curMulticastParams = NULL;
-	uint8_t *nwkSKey = LoRaMacNwkSKey;
-	uint8_t *appSKey = LoRaMacAppSKey;
+	uint8_t *nwkSKey = MacCtx->NwkSKey;
+	uint8_t *appSKey = MacCtx->AppSKey;
+	uint8_t *frmPayloadKey = NULL;
 
 	uint8_t multicast = 0;
 
 	bool isMicOk = false;
 
-	McpsConfirm.AckReceived = false;
-	McpsIndication.Rssi = rssi;
-	McpsIndication.Snr = snr;
-	McpsIndication.RxSlot = RxSlot;
-	McpsIndication.Port = 0;
-	McpsIndication.Multicast = 0;
-	McpsIndication.FramePending = 0;
-	McpsIndication.Buffer = NULL;
-	McpsIndication.BufferSize = 0;
-	McpsIndication.RxData = false;
-	McpsIndication.AckReceived = false;
-	McpsIndication.DownLinkCounter = 0;
-	McpsIndication.McpsIndication = MCPS_UNCONFIRMED;
+	MacCtx->McpsConfirm.AckReceived = false;
+	MacCtx->McpsIndication.Rssi = rssi;
+	MacCtx->McpsIndication.Snr = snr;
+	MacCtx->McpsIndication.RxSlot = MacCtx->RxSlot;
+	MacCtx->McpsIndication.Port = 0;
+	MacCtx->McpsIndication.Multicast = 0;
+	MacCtx->McpsIndication.FramePending = 0;
+	MacCtx->McpsIndication.Buffer = NULL;
+	MacCtx->McpsIndication.BufferSize = 0;
+	MacCtx->McpsIndication.RxData = false;
+	MacCtx->McpsIndication.AckReceived = false;
+	MacCtx->McpsIndication.DownLinkCounter = 0;
+	MacCtx->McpsIndication.McpsIndication = MCPS_UNCONFIRMED;
 
 	Radio.Sleep();
-	TimerStop(&RxWindowTimer2);
+	TimerStop(&MacCtx->RxWindowTimer2);
 
 	macHdr.Value = payload[pktHeaderLen++];
 
@@ -761,64 +569,70 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 	case FRAME_TYPE_JOIN_ACCEPT:
 		LOG_LIB("LM", "OnRadioRxDone => FRAME_TYPE_JOIN_ACCEPT");
 
-		if (IsLoRaMacNetworkJoined == JOIN_OK)
+		if (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK)
 		{
-			McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+			MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
 			PrepareRxDoneAbort();
 			return;
 		}
-		LoRaMacJoinDecrypt(payload + 1, size - 1, LoRaMacAppKey, LoRaMacRxPayload + 1);
+		cryptoStatus = LoRaMacCryptoCtxJoinDecrypt(GetCryptoCtx(), payload + 1, size - 1, MacCtx->LoRaMacAppKey, MacCtx->LoRaMacRxPayload + 1);
 
-		LoRaMacRxPayload[0] = macHdr.Value;
+		MacCtx->LoRaMacRxPayload[0] = macHdr.Value;
 
-		LoRaMacJoinComputeMic(LoRaMacRxPayload, size - LORAMAC_MFR_LEN, LoRaMacAppKey, &mic);
+		if (cryptoStatus == LORAMAC_CRYPTO_SUCCESS)
+		{
+			cryptoStatus = LoRaMacCryptoCtxJoinComputeMic(GetCryptoCtx(), MacCtx->LoRaMacRxPayload, size - LORAMAC_MFR_LEN, MacCtx->LoRaMacAppKey, &mic);
+		}
 
-		micRx |= (uint32_t)LoRaMacRxPayload[size - LORAMAC_MFR_LEN];
-		micRx |= ((uint32_t)LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 1] << 8);
-		micRx |= ((uint32_t)LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 2] << 16);
-		micRx |= ((uint32_t)LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 3] << 24);
+		micRx |= (uint32_t)MacCtx->LoRaMacRxPayload[size - LORAMAC_MFR_LEN];
+		micRx |= ((uint32_t)MacCtx->LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 1] << 8);
+		micRx |= ((uint32_t)MacCtx->LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 2] << 16);
+		micRx |= ((uint32_t)MacCtx->LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 3] << 24);
 
-		if (micRx == mic)
+		// A backend failure is handled as a join accept with a wrong MIC
+		if ((cryptoStatus == LORAMAC_CRYPTO_SUCCESS) && (micRx == mic) &&
+			(LoRaMacCryptoCtxJoinComputeSKeys(GetCryptoCtx(), MacCtx->LoRaMacAppKey, MacCtx->LoRaMacRxPayload + 1, MacCtx->LoRaMacDevNonce, MacCtx->NwkSKey, MacCtx->AppSKey) == LORAMAC_CRYPTO_SUCCESS))
 		{
-			LoRaMacJoinComputeSKeys(LoRaMacAppKey, LoRaMacRxPayload + 1, LoRaMacDevNonce, LoRaMacNwkSKey, LoRaMacAppSKey);
+			// Drop the key schedules of the previous session and of the AppKey
+			LoRaMacCryptoCtxInvalidateKeys(GetCryptoCtx());
 
-			LoRaMacNetID = (uint32_t)LoRaMacRxPayload[4];
-			LoRaMacNetID |= ((uint32_t)LoRaMacRxPayload[5] << 8);
-			LoRaMacNetID |= ((uint32_t)LoRaMacRxPayload[6] << 16);
+			MacCtx->LoRaMacNetID = (uint32_t)MacCtx->LoRaMacRxPayload[4];
+			MacCtx->LoRaMacNetID |= ((uint32_t)MacCtx->LoRaMacRxPayload[5] << 8);
+			MacCtx->LoRaMacNetID |= ((uint32_t)MacCtx->LoRaMacRxPayload[6] << 16);
 
-			LoRaMacDevAddr = (uint32_t)LoRaMacRxPayload[7];
-			LoRaMacDevAddr |= ((uint32_t)LoRaMacRxPayload[8] << 8);
-			LoRaMacDevAddr |= ((uint32_t)LoRaMacRxPayload[9] << 16);
-			LoRaMacDevAddr |= ((uint32_t)LoRaMacRxPayload[10] << 24);
+			MacCtx->DevAddr = (uint32_t)MacCtx->LoRaMacRxPayload[7];
+			MacCtx->DevAddr |= ((uint32_t)MacCtx->LoRaMacRxPayload[8] << 8);
+			MacCtx->DevAddr |= ((uint32_t)MacCtx->LoRaMacRxPayload[9] << 16);
+			MacCtx->DevAddr |= ((uint32_t)MacCtx->LoRaMacRxPayload[10] << 24);
 
 			// DLSettings
-			LoRaMacParams.Rx1DrOffset = (LoRaMacRxPayload[11] >> 4) & 0x07;
-			LoRaMacParams.Rx2Channel.Datarate = LoRaMacRxPayload[11] & 0x0F;
+			MacCtx->Params.Rx1DrOffset = (MacCtx->LoRaMacRxPayload[11] >> 4) & 0x07;
+			MacCtx->Params.Rx2Channel.Datarate = MacCtx->LoRaMacRxPayload[11] & 0x0F;
 
 			// RxDelay
-			LoRaMacParams.ReceiveDelay1 = (LoRaMacRxPayload[12] & 0x0F);
-			if (LoRaMacParams.ReceiveDelay1 == 0)
+			MacCtx->Params.ReceiveDelay1 = (MacCtx->LoRaMacRxPayload[12] & 0x0F);
+			if (MacCtx->Params.ReceiveDelay1 == 0)
 			{
-				LoRaMacParams.ReceiveDelay1 = 1;
+				MacCtx->Params.ReceiveDelay1 = 1;
 			}
-			LoRaMacParams.ReceiveDelay1 *= 1000;
-			LoRaMacParams.ReceiveDelay2 = LoRaMacParams.ReceiveDelay1 + 1000;
+			MacCtx->Params.ReceiveDelay1 *= 1000;
+			MacCtx->Params.ReceiveDelay2 = MacCtx->Params.ReceiveDelay1 + 1000;
 
 			// Apply CF list
-			applyCFList.Payload = &LoRaMacRxPayload[13];
+			applyCFList.Payload = &MacCtx->LoRaMacRxPayload[13];
 			// Size of the regular payload is 12. Plus 1 byte MHDR and 4 bytes MIC
 			applyCFList.Size = size - 17;
 
-			RegionApplyCFList(LoRaMacRegion, &applyCFList);
+			RegionApplyCFList(MacCtx->Region, &applyCFList);
 
-			MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-			IsLoRaMacNetworkJoined = JOIN_OK;
-			LoRaMacParams.ChannelsDatarate = LoRaMacParamsDefaults.ChannelsDatarate;
+			MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+			MacCtx->IsLoRaMacNetworkJoined = JOIN_OK;
+			MacCtx->Params.ChannelsDatarate = MacCtx->ParamsDefaults.ChannelsDatarate;
 		}
 		else
 		{
-			IsLoRaMacNetworkJoined = JOIN_FAILED;
-			MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_JOIN_FAIL;
+			MacCtx->IsLoRaMacNetworkJoined = JOIN_FAILED;
+			MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_JOIN_FAIL;
 		}
 		break;
 	case FRAME_TYPE_DATA_CONFIRMED_DOWN:
@@ -831,21 +645,21 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 		}
 
 		// Check if the received payload size is valid
-		getPhy.UplinkDwellTime = LoRaMacParams.DownlinkDwellTime;
-		getPhy.Datarate = McpsIndication.RxDatarate;
+		getPhy.UplinkDwellTime = MacCtx->Params.DownlinkDwellTime;
+		getPhy.Datarate = MacCtx->McpsIndication.RxDatarate;
 		getPhy.Attribute = PHY_MAX_PAYLOAD;
 
 		// Get the maximum payload length
-		if (RepeaterSupport == true)
+		if (MacCtx->RepeaterSupport == true)
 		{
 			getPhy.Attribute = PHY_MAX_PAYLOAD_REPEATER;
 		}
-		phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+		phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 		// if (T_MAX(0, (uint16_t)((int16_t)size - (int16_t)LORA_MAC_FRMPAYLOAD_OVERHEAD)) > phyParam.Value)
 		if ((T_MAX(0, (int16_t)((int16_t)size - (int16_t)LORA_MAC_FRMPAYLOAD_OVERHEAD)) > (int16_t)phyParam.Value) ||
 			(size < LORAMAC_FRAME_PAYLOAD_MIN_SIZE))
 		{
-			McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+			MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
 			PrepareRxDoneAbort();
 			return;
 		}
@@ -855,9 +669,9 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 		address |= ((uint32_t)payload[pktHeaderLen++] << 16);
 		address |= ((uint32_t)payload[pktHeaderLen++] << 24);
 
-		if (address != LoRaMacDevAddr)
+		if (address != MacCtx->DevAddr)
 		{
-			curMulticastParams = MulticastChannels;
+			curMulticastParams = MacCtx->MulticastChannels;
 			while (curMulticastParams != NULL)
 			{
 				if (address == curMulticastParams->Address)
@@ -873,7 +687,7 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 			if (multicast == 0)
 			{
 				// We are not the destination of this frame.
-				McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ADDRESS_FAIL;
+				MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ADDRESS_FAIL;
 				PrepareRxDoneAbort();
 				return;
 			}
@@ -881,9 +695,9 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 		else
 		{
 			multicast = 0;
-			nwkSKey = LoRaMacNwkSKey;
-			appSKey = LoRaMacAppSKey;
-			downLinkCounter = DownLinkCounter;
+			nwkSKey = MacCtx->NwkSKey;
+			appSKey = MacCtx->AppSKey;
+			downLinkCounter = MacCtx->DownLinkCounter;
 		}
 
 		fCtrl.Value = payload[pktHeaderLen++];
@@ -898,65 +712,76 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 		micRx |= ((uint32_t)payload[size - LORAMAC_MFR_LEN + 2] << 16);
 		micRx |= ((uint32_t)payload[size - LORAMAC_MFR_LEN + 3] << 24);
 
+		// The FRMPayload is decrypted while the MIC is verified. Port 0
+		// payloads use the NwkSKey and are only allowed without fOpts.
+		if (((size - 4) - appPayloadStartIndex) > 0)
+		{
+			if (payload[appPayloadStartIndex] != 0)
+			{
+				frmPayloadKey = appSKey;
+			}
+			else if (fCtrl.Bits.FOptsLen == 0)
+			{
+				frmPayloadKey = nwkSKey;
+			}
+		}
+
 		sequenceCounterPrev = (uint16_t)downLinkCounter;
 		sequenceCounterDiff = (sequenceCounter - sequenceCounterPrev);
 
 		if (sequenceCounterDiff < (1 << 15))
 		{
 			downLinkCounter += sequenceCounterDiff;
-			LoRaMacComputeMic(payload, size - LORAMAC_MFR_LEN, nwkSKey, address, DOWN_LINK, downLinkCounter, &mic);
-			if (micRx == mic)
-			{
-				isMicOk = true;
-			}
+			isMicOk = LoRaMacCryptoCtxVerifyAndDecrypt(GetCryptoCtx(), payload, size - LORAMAC_MFR_LEN, micRx, nwkSKey, frmPayloadKey, appPayloadStartIndex + 1,
+											  address, DOWN_LINK, downLinkCounter, MacCtx->LoRaMacRxPayload);
 		}
 		else
 		{
 			// check for sequence roll-over
 			uint32_t downLinkCounterTmp = downLinkCounter + 0x10000 + (int16_t)sequenceCounterDiff;
-			LoRaMacComputeMic(payload, size - LORAMAC_MFR_LEN, nwkSKey, address, DOWN_LINK, downLinkCounterTmp, &mic);
-			if (micRx == mic)
+			isMicOk = LoRaMacCryptoCtxVerifyAndDecrypt(GetCryptoCtx(), payload, size - LORAMAC_MFR_LEN, micRx, nwkSKey, frmPayloadKey, appPayloadStartIndex + 1,
+											  address, DOWN_LINK, downLinkCounterTmp, MacCtx->LoRaMacRxPayload);
+			if (isMicOk == true)
 			{
-				isMicOk = true;
 				downLinkCounter = downLinkCounterTmp;
 			}
 		}
 
 		// Check for a the maximum allowed counter difference
 		getPhy.Attribute = PHY_MAX_FCNT_GAP;
-		phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+		phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 		if (sequenceCounterDiff >= phyParam.Value)
 		{
-			McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_TOO_MANY_FRAMES_LOSS;
-			McpsIndication.DownLinkCounter = downLinkCounter;
+			MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_TOO_MANY_FRAMES_LOSS;
+			MacCtx->McpsIndication.DownLinkCounter = downLinkCounter;
 			PrepareRxDoneAbort();
 			return;
 		}
 
 		if (isMicOk == true)
 		{
-			McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-			McpsIndication.Multicast = multicast;
-			McpsIndication.FramePending = fCtrl.Bits.FPending;
-			McpsIndication.Buffer = NULL;
-			McpsIndication.BufferSize = 0;
-			McpsIndication.DownLinkCounter = downLinkCounter;
+			MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+			MacCtx->McpsIndication.Multicast = multicast;
+			MacCtx->McpsIndication.FramePending = fCtrl.Bits.FPending;
+			MacCtx->McpsIndication.Buffer = NULL;
+			MacCtx->McpsIndication.BufferSize = 0;
+			MacCtx->McpsIndication.DownLinkCounter = downLinkCounter;
 
-			McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+			MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
 
-			AdrAckCounter = 0;
-			MacCommandsBufferToRepeatIndex = 0;
+			MacCtx->AdrAckCounter = 0;
+			MacCtx->MacCommandsBufferToRepeatIndex = 0;
 
 			// Update 32 bits downlink counter
 			if (multicast == 1)
 			{
-				McpsIndication.McpsIndication = MCPS_MULTICAST;
+				MacCtx->McpsIndication.McpsIndication = MCPS_MULTICAST;
 
 				if ((curMulticastParams->DownLinkCounter == downLinkCounter) &&
 					(curMulticastParams->DownLinkCounter != 0))
 				{
-					McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_REPEATED;
-					McpsIndication.DownLinkCounter = downLinkCounter;
+					MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_REPEATED;
+					MacCtx->McpsIndication.DownLinkCounter = downLinkCounter;
 					PrepareRxDoneAbort();
 					return;
 				}
@@ -966,11 +791,11 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 			{
 				if (macHdr.Bits.MType == FRAME_TYPE_DATA_CONFIRMED_DOWN)
 				{
-					SrvAckRequested = true;
-					McpsIndication.McpsIndication = MCPS_CONFIRMED;
+					MacCtx->SrvAckRequested = true;
+					MacCtx->McpsIndication.McpsIndication = MCPS_CONFIRMED;
 
-					if ((DownLinkCounter == downLinkCounter) &&
-						(DownLinkCounter != 0))
+					if ((MacCtx->DownLinkCounter == downLinkCounter) &&
+						(MacCtx->DownLinkCounter != 0))
 					{
 						// Duplicated confirmed downlink. Skip indication.
 						// In this case, the MAC layer shall accept the MAC commands
@@ -982,35 +807,35 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 				}
 				else
 				{
-					SrvAckRequested = false;
-					McpsIndication.McpsIndication = MCPS_UNCONFIRMED;
+					MacCtx->SrvAckRequested = false;
+					MacCtx->McpsIndication.McpsIndication = MCPS_UNCONFIRMED;
 
-					if ((DownLinkCounter == downLinkCounter) &&
-						(DownLinkCounter != 0))
+					if ((MacCtx->DownLinkCounter == downLinkCounter) &&
+						(MacCtx->DownLinkCounter != 0))
 					{
-						McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_REPEATED;
-						McpsIndication.DownLinkCounter = downLinkCounter;
+						MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_REPEATED;
+						MacCtx->McpsIndication.DownLinkCounter = downLinkCounter;
 						PrepareRxDoneAbort();
 						return;
 					}
 				}
-				DownLinkCounter = downLinkCounter;
+				MacCtx->DownLinkCounter = downLinkCounter;
 			}
 
 			// This must be done before parsing the payload and the MAC commands.
 			// We need to reset the MacCommandsBufferIndex here, since we need
 			// to take retransmissions and repetitions into account. Error cases
 			// will be handled in function OnMacStateCheckTimerEvent.
-			if (McpsConfirm.McpsRequest == MCPS_CONFIRMED)
+			if (MacCtx->McpsConfirm.McpsRequest == MCPS_CONFIRMED)
 			{
 				if (fCtrl.Bits.Ack == 1)
 				{ // Reset MacCommandsBufferIndex when we have received an ACK.
-					MacCommandsBufferIndex = 0;
+					MacCtx->MacCommandsBufferIndex = 0;
 				}
 			}
 			else
 			{ // Reset the variable if we have received any valid frame.
-				MacCommandsBufferIndex = 0;
+				MacCtx->MacCommandsBufferIndex = 0;
 			}
 
 			// Process payload and MAC commands
@@ -1019,23 +844,15 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 				port = payload[appPayloadStartIndex++];
 				frameLen = (size - 4) - appPayloadStartIndex;
 
-				McpsIndication.Port = port;
+				MacCtx->McpsIndication.Port = port;
 
 				if (port == 0)
 				{
 					// Only allow frames which do not have fOpts
 					if (fCtrl.Bits.FOptsLen == 0)
 					{
-						LoRaMacPayloadDecrypt(payload + appPayloadStartIndex,
-											  frameLen,
-											  nwkSKey,
-											  address,
-											  DOWN_LINK,
-											  downLinkCounter,
-											  LoRaMacRxPayload);
-
 						// Decode frame payload MAC commands
-						ProcessMacCommands(LoRaMacRxPayload, 0, frameLen, snr);
+						ProcessMacCommands(MacCtx->LoRaMacRxPayload, 0, frameLen, snr);
 					}
 					else
 					{
@@ -1050,19 +867,11 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 						ProcessMacCommands(payload, 8, appPayloadStartIndex - 1, snr);
 					}
 
-					LoRaMacPayloadDecrypt(payload + appPayloadStartIndex,
-										  frameLen,
-										  appSKey,
-										  address,
-										  DOWN_LINK,
-										  downLinkCounter,
-										  LoRaMacRxPayload);
-
 					if (skipIndication == false)
 					{
-						McpsIndication.Buffer = LoRaMacRxPayload;
-						McpsIndication.BufferSize = frameLen;
-						McpsIndication.RxData = true;
+						MacCtx->McpsIndication.Buffer = MacCtx->LoRaMacRxPayload;
+						MacCtx->McpsIndication.BufferSize = frameLen;
+						MacCtx->McpsIndication.RxData = true;
 					}
 				}
 			}
@@ -1080,33 +889,33 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 				// Check if the frame is an acknowledgement
 				if (fCtrl.Bits.Ack == 1)
 				{
-					McpsConfirm.AckReceived = true;
-					McpsIndication.AckReceived = true;
+					MacCtx->McpsConfirm.AckReceived = true;
+					MacCtx->McpsIndication.AckReceived = true;
 
 					// Stop the AckTimeout timer as no more retransmissions
 					// are needed.
-					TimerStop(&AckTimeoutTimer);
+					TimerStop(&MacCtx->AckTimeoutTimer);
 				}
 				else
 				{
-					McpsConfirm.AckReceived = false;
+					MacCtx->McpsConfirm.AckReceived = false;
 
-					if (AckTimeoutRetriesCounter > AckTimeoutRetries)
+					if (MacCtx->AckTimeoutRetriesCounter > MacCtx->AckTimeoutRetries)
 					{
 						// Stop the AckTimeout timer as no more retransmissions
 						// are needed.
-						TimerStop(&AckTimeoutTimer);
+						TimerStop(&MacCtx->AckTimeoutTimer);
 					}
 				}
 			}
 			// Provide always an indication, skip the callback to the user application,
 			// in case of a confirmed downlink retransmission.
-			LoRaMacFlags.Bits.McpsInd = 1;
-			LoRaMacFlags.Bits.McpsIndSkip = skipIndication;
+			MacCtx->LoRaMacFlags.Bits.McpsInd = 1;
+			MacCtx->LoRaMacFlags.Bits.McpsIndSkip = skipIndication;
 		}
 		else
 		{
-			McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_MIC_FAIL;
+			MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_MIC_FAIL;
 
 			PrepareRxDoneAbort();
 			return;
@@ -1117,29 +926,29 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 	{
 		LOG_LIB("LM", "OnRadioRxDone => FRAME_TYPE_PROPRIETARY");
 
-		memcpy1(LoRaMacRxPayload, &payload[pktHeaderLen], size);
+		memcpy1(MacCtx->LoRaMacRxPayload, &payload[pktHeaderLen], size);
 
-		McpsIndication.McpsIndication = MCPS_PROPRIETARY;
-		McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-		McpsIndication.Buffer = LoRaMacRxPayload;
-		McpsIndication.BufferSize = size - pktHeaderLen;
+		MacCtx->McpsIndication.McpsIndication = MCPS_PROPRIETARY;
+		MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+		MacCtx->McpsIndication.Buffer = MacCtx->LoRaMacRxPayload;
+		MacCtx->McpsIndication.BufferSize = size - pktHeaderLen;
 
-		LoRaMacFlags.Bits.McpsInd = 1;
+		MacCtx->LoRaMacFlags.Bits.McpsInd = 1;
 		break;
 	}
 	default:
 		LOG_LIB("LM", "OnRadioRxDone => UNKNOWN FRAME TYPE");
 
-		McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+		MacCtx->McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
 		PrepareRxDoneAbort();
 		break;
 	}
-	LoRaMacFlags.Bits.MacDone = 1;
+	MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 
 	// Trig OnMacCheckTimerEvent call as soon as possible
 	// TimerSetValue(&MacStateCheckTimer, 100);
 	// TimerStart(&MacStateCheckTimer);
-	TimerStop(&MacStateCheckTimer);
+	TimerStop(&MacCtx->MacStateCheckTimer);
 	OnMacStateCheckTimerEvent();
 }
 
@@ -1147,7 +956,7 @@ static void OnRadioTxTimeout(void)
 {
 	LOG_LIB("LM", "OnRadioTxTimeout");
 
-	if (LoRaMacDeviceClass != CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass != CLASS_C)
 	{
 		Radio.Sleep();
 	}
@@ -1156,16 +965,16 @@ static void OnRadioTxTimeout(void)
 		OnRxWindow2TimerEvent();
 	}
 
-	McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT;
-	MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT;
-	LoRaMacFlags.Bits.MacDone = 1;
+	MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT;
+	MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT;
+	MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 }
 
 static void OnRadioRxError(void)
 {
 	LOG_LIB("LM", "OnRadioRxError");
 
-	if (LoRaMacDeviceClass != CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass != CLASS_C)
 	{
 		Radio.Sleep();
 	}
@@ -1174,27 +983,27 @@ static void OnRadioRxError(void)
 		OnRxWindow2TimerEvent();
 	}
 
-	if (RxSlot == 0)
+	if (MacCtx->RxSlot == 0)
 	{
-		if (NodeAckRequested == true)
+		if (MacCtx->NodeAckRequested == true)
 		{
-			McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_ERROR;
+			MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_ERROR;
 		}
-		MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_ERROR;
+		MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_ERROR;
 
-		if (TimerGetElapsedTime(AggregatedLastTxDoneTime) >= RxWindow2Delay)
+		if (TimerGetElapsedTime(MacCtx->AggregatedLastTxDoneTime) >= MacCtx->RxWindow2Delay)
 		{
-			LoRaMacFlags.Bits.MacDone = 1;
+			MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 		}
 	}
 	else
 	{
-		if (NodeAckRequested == true)
+		if (MacCtx->NodeAckRequested == true)
 		{
-			McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_ERROR;
+			MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_ERROR;
 		}
-		MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_ERROR;
-		LoRaMacFlags.Bits.MacDone = 1;
+		MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_ERROR;
+		MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 	}
 }
 
@@ -1202,7 +1011,7 @@ static void OnRadioRxTimeout(void)
 {
 	LOG_LIB("LM", "OnRadioRxTimeout");
 
-	if (LoRaMacDeviceClass != CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass != CLASS_C)
 	{
 		Radio.Sleep();
 	}
@@ -1211,34 +1020,34 @@ static void OnRadioRxTimeout(void)
 		OnRxWindow2TimerEvent();
 	}
 
-	if (RxSlot == 0)
+	if (MacCtx->RxSlot == 0)
 	{
-		if (NodeAckRequested == true)
+		if (MacCtx->NodeAckRequested == true)
 		{
-			McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_TIMEOUT;
+			MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_TIMEOUT;
 		}
-		MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_TIMEOUT;
+		MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_TIMEOUT;
 
-		if (TimerGetElapsedTime(AggregatedLastTxDoneTime) >= RxWindow2Delay)
+		if (TimerGetElapsedTime(MacCtx->AggregatedLastTxDoneTime) >= MacCtx->RxWindow2Delay)
 		{
-			LoRaMacFlags.Bits.MacDone = 1;
+			MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 		}
 	}
 	else
 	{
-		if (NodeAckRequested == true)
+		if (MacCtx->NodeAckRequested == true)
 		{
-			McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
+			MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
 		}
-		MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
+		MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
 
-		if (LoRaMacDeviceClass != CLASS_C)
+		if (MacCtx->LoRaMacDeviceClass != CLASS_C)
 		{
-			LoRaMacFlags.Bits.MacDone = 1;
+			MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 		}
 	}
-	TimerSetValue(&MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
-	TimerStart(&MacStateCheckTimer);
+	TimerSetValue(&MacCtx->MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
+	TimerStart(&MacCtx->MacStateCheckTimer);
 }
 
 static void OnMacStateCheckTimerEvent(void)
@@ -1247,59 +1056,60 @@ static void OnMacStateCheckTimerEvent(void)
 	PhyParam_t phyParam;
 	bool txTimeout = false;
 
-	TimerStop(&MacStateCheckTimer);
+	TimerStop(&MacCtx->MacStateCheckTimer);
 
 	// LOG_LIB("LM", "OnMacStateCheckTimerEvent");
-	if (LoRaMacFlags.Bits.MacDone == 1)
+	if (MacCtx->LoRaMacFlags.Bits.MacDone == 1)
 	{
-		if ((LoRaMacState & LORAMAC_RX_ABORT) == LORAMAC_RX_ABORT)
+		if ((MacCtx->State & LORAMAC_RX_ABORT) == LORAMAC_RX_ABORT)
 		{
-			LoRaMacState &= ~LORAMAC_RX_ABORT;
-			LoRaMacState &= ~LORAMAC_TX_RUNNING;
+			MacCtx->State &= ~LORAMAC_RX_ABORT;
+			MacCtx->State &= ~LORAMAC_TX_RUNNING;
 		}
 
-		if ((LoRaMacFlags.Bits.MlmeReq == 1) || ((LoRaMacFlags.Bits.McpsReq == 1)))
+		if ((MacCtx->LoRaMacFlags.Bits.MlmeReq == 1) || ((MacCtx->LoRaMacFlags.Bits.McpsReq == 1)))
 		{
-			if ((McpsConfirm.Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT) ||
-				(MlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT))
+			if ((MacCtx->McpsConfirm.Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT) ||
+				(MacCtx->MlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT))
 			{
 				// Stop transmit cycle due to tx timeout.
-				LoRaMacState &= ~LORAMAC_TX_RUNNING;
-				MacCommandsBufferIndex = 0;
-				McpsConfirm.NbRetries = AckTimeoutRetriesCounter;
-				McpsConfirm.AckReceived = false;
-				McpsConfirm.TxTimeOnAir = 0;
+				MacCtx->State &= ~LORAMAC_TX_RUNNING;
+				MacCtx->MacCommandsBufferIndex = 0;
+				MacCtx->McpsConfirm.NbRetries = MacCtx->AckTimeoutRetriesCounter;
+				MacCtx->McpsConfirm.AckReceived = false;
+				MacCtx->McpsConfirm.TxTimeOnAir = 0;
 				txTimeout = true;
 			}
 		}
 
-		if ((NodeAckRequested == false) && (txTimeout == false))
+		if ((MacCtx->NodeAckRequested == false) && (txTimeout == false))
 		{
-			if ((LoRaMacFlags.Bits.MlmeReq == 1) || ((LoRaMacFlags.Bits.McpsReq == 1)))
+			if ((MacCtx->LoRaMacFlags.Bits.MlmeReq == 1) || ((MacCtx->LoRaMacFlags.Bits.McpsReq == 1)))
 			{
-				if ((LoRaMacFlags.Bits.MlmeReq == 1) && (MlmeConfirm.MlmeRequest == MLME_JOIN))
+				if ((MacCtx->LoRaMacFlags.Bits.MlmeReq == 1) && (MacCtx->MlmeConfirm.MlmeRequest == MLME_JOIN))
 				{ // Procedure for the join request
-					MlmeConfirm.NbRetries = JoinRequestTrials;
+					MacCtx->MlmeConfirm.NbRetries = MacCtx->JoinRequestTrials;
 
-					if (MlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_OK)
+					if (MacCtx->MlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_OK)
 					{ // Node joined successfully
-						UpLinkCounter = 0;
-						ChannelsNbRepCounter = 0;
-						LoRaMacState &= ~LORAMAC_TX_RUNNING;
+						MacCtx->UpLinkCounter = 0;
+						MacCtx->NvmSessionChanged = true;
+						MacCtx->ChannelsNbRepCounter = 0;
+						MacCtx->State &= ~LORAMAC_TX_RUNNING;
 					}
 					else
 					{
-						LOG_LIB("LM", "Join network failed %d time(s)\n", JoinRequestTrials);
+						LOG_LIB("LM", "Join network failed %d time(s)\n", MacCtx->JoinRequestTrials);
 
-						IsLoRaMacNetworkJoined = JOIN_FAILED;
-						if (JoinRequestTrials >= MaxJoinRequestTrials)
+						MacCtx->IsLoRaMacNetworkJoined = JOIN_FAILED;
+						if (MacCtx->JoinRequestTrials >= MacCtx->MaxJoinRequestTrials)
 						{
-							LoRaMacState &= ~LORAMAC_TX_RUNNING;
+							MacCtx->State &= ~LORAMAC_TX_RUNNING;
 						}
 						else
 						{
-							IsLoRaMacNetworkJoined = JOIN_ONGOING;
-							LoRaMacFlags.Bits.MacDone = 0;
+							MacCtx->IsLoRaMacNetworkJoined = JOIN_ONGOING;
+							MacCtx->LoRaMacFlags.Bits.MacDone = 0;
 							// Sends the same frame again
 							OnTxDelayedTimerEvent();
 						}
@@ -1307,27 +1117,27 @@ static void OnMacStateCheckTimerEvent(void)
 				}
 				else
 				{ // Procedure for all other frames
-					if ((ChannelsNbRepCounter >= LoRaMacParams.ChannelsNbRep) || (LoRaMacFlags.Bits.McpsInd == 1))
+					if ((MacCtx->ChannelsNbRepCounter >= MacCtx->Params.ChannelsNbRep) || (MacCtx->LoRaMacFlags.Bits.McpsInd == 1))
 					{
-						if (LoRaMacFlags.Bits.McpsInd == 0)
+						if (MacCtx->LoRaMacFlags.Bits.McpsInd == 0)
 						{ // Maximum repetitions without downlink. Reset MacCommandsBufferIndex. Increase ADR Ack counter.
 							// Only process the case when the MAC did not receive a downlink.
-							MacCommandsBufferIndex = 0;
-							AdrAckCounter++;
+							MacCtx->MacCommandsBufferIndex = 0;
+							MacCtx->AdrAckCounter++;
 						}
 
-						ChannelsNbRepCounter = 0;
+						MacCtx->ChannelsNbRepCounter = 0;
 
-						if (IsUpLinkCounterFixed == false)
+						if (MacCtx->IsUpLinkCounterFixed == false)
 						{
-							UpLinkCounter++;
+							MacCtx->UpLinkCounter++;
 						}
 
-						LoRaMacState &= ~LORAMAC_TX_RUNNING;
+						MacCtx->State &= ~LORAMAC_TX_RUNNING;
 					}
 					else
 					{
-						LoRaMacFlags.Bits.MacDone = 0;
+						MacCtx->LoRaMacFlags.Bits.MacDone = 0;
 						// Sends the same frame again
 						OnTxDelayedTimerEvent();
 					}
@@ -1335,132 +1145,144 @@ static void OnMacStateCheckTimerEvent(void)
 			}
 		}
 
-		if (LoRaMacFlags.Bits.McpsInd == 1)
+		if (MacCtx->LoRaMacFlags.Bits.McpsInd == 1)
 		{ // Procedure if we received a frame
-			if ((McpsConfirm.AckReceived == true) || (AckTimeoutRetriesCounter > AckTimeoutRetries))
+			if ((MacCtx->McpsConfirm.AckReceived == true) || (MacCtx->AckTimeoutRetriesCounter > MacCtx->AckTimeoutRetries))
 			{
-				AckTimeoutRetry = false;
-				NodeAckRequested = false;
-				if (IsUpLinkCounterFixed == false)
+				MacCtx->AckTimeoutRetry = false;
+				MacCtx->NodeAckRequested = false;
+				if (MacCtx->IsUpLinkCounterFixed == false)
 				{
-					UpLinkCounter++;
+					MacCtx->UpLinkCounter++;
 				}
-				McpsConfirm.NbRetries = AckTimeoutRetriesCounter;
+				MacCtx->McpsConfirm.NbRetries = MacCtx->AckTimeoutRetriesCounter;
 
-				LoRaMacState &= ~LORAMAC_TX_RUNNING;
+				MacCtx->State &= ~LORAMAC_TX_RUNNING;
 			}
 		}
 
-		if ((AckTimeoutRetry == true) && ((LoRaMacState & LORAMAC_TX_DELAYED) == 0))
+		if ((MacCtx->AckTimeoutRetry == true) && ((MacCtx->State & LORAMAC_TX_DELAYED) == 0))
 		{ // Retransmissions procedure for confirmed uplinks
-			AckTimeoutRetry = false;
-			if ((AckTimeoutRetriesCounter < AckTimeoutRetries) && (AckTimeoutRetriesCounter <= max_ack_retries))
+			MacCtx->AckTimeoutRetry = false;
+			if ((MacCtx->AckTimeoutRetriesCounter < MacCtx->AckTimeoutRetries) && (MacCtx->AckTimeoutRetriesCounter <= MacCtx->MaxAckRetries))
 			{
-				AckTimeoutRetriesCounter++;
+				MacCtx->AckTimeoutRetriesCounter++;
 
-				if ((AckTimeoutRetriesCounter % 2) == 1)
+				if ((MacCtx->AckTimeoutRetriesCounter % 2) == 1)
 				{
 					getPhy.Attribute = PHY_NEXT_LOWER_TX_DR;
-					getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
-					getPhy.Datarate = LoRaMacParams.ChannelsDatarate;
-					phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-					LoRaMacParams.ChannelsDatarate = phyParam.Value;
+					getPhy.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
+					getPhy.Datarate = MacCtx->Params.ChannelsDatarate;
+					phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+					MacCtx->Params.ChannelsDatarate = phyParam.Value;
 				}
 				// Try to send the frame again
 				if (ScheduleTx() == LORAMAC_STATUS_OK)
 				{
-					LoRaMacFlags.Bits.MacDone = 0;
+					MacCtx->LoRaMacFlags.Bits.MacDone = 0;
 				}
 				else
 				{
 					// The DR is not applicable for the payload size
-					McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_TX_DR_PAYLOAD_SIZE_ERROR;
-
-					MacCommandsBufferIndex = 0;
-					LoRaMacState &= ~LORAMAC_TX_RUNNING;
-					NodeAckRequested = false;
-					McpsConfirm.AckReceived = false;
-					McpsConfirm.NbRetries = AckTimeoutRetriesCounter;
-					McpsConfirm.Datarate = LoRaMacParams.ChannelsDatarate;
-					if (IsUpLinkCounterFixed == false)
+					MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_TX_DR_PAYLOAD_SIZE_ERROR;
+
+					MacCtx->MacCommandsBufferIndex = 0;
+					MacCtx->State &= ~LORAMAC_TX_RUNNING;
+					MacCtx->NodeAckRequested = false;
+					MacCtx->McpsConfirm.AckReceived = false;
+					MacCtx->McpsConfirm.NbRetries = MacCtx->AckTimeoutRetriesCounter;
+					MacCtx->McpsConfirm.Datarate = MacCtx->Params.ChannelsDatarate;
+					if (MacCtx->IsUpLinkCounterFixed == false)
 					{
-						UpLinkCounter++;
+						MacCtx->UpLinkCounter++;
 					}
 				}
 			}
 			else
 			{
-				RegionInitDefaults(LoRaMacRegion, INIT_TYPE_RESTORE);
+				RegionInitDefaults(MacCtx->Region, INIT_TYPE_RESTORE);
 
-				LoRaMacState &= ~LORAMAC_TX_RUNNING;
+				MacCtx->State &= ~LORAMAC_TX_RUNNING;
 
-				MacCommandsBufferIndex = 0;
-				NodeAckRequested = false;
-				McpsConfirm.AckReceived = false;
-				McpsConfirm.NbRetries = AckTimeoutRetriesCounter;
-				if (IsUpLinkCounterFixed == false)
+				MacCtx->MacCommandsBufferIndex = 0;
+				MacCtx->NodeAckRequested = false;
+				MacCtx->McpsConfirm.AckReceived = false;
+				MacCtx->McpsConfirm.NbRetries = MacCtx->AckTimeoutRetriesCounter;
+				if (MacCtx->IsUpLinkCounterFixed == false)
 				{
-					UpLinkCounter++;
+					MacCtx->UpLinkCounter++;
 				}
 			}
 		}
 	}
 	// Handle reception for Class B and Class C
-	if ((LoRaMacState & LORAMAC_RX) == LORAMAC_RX)
+	if ((MacCtx->State & LORAMAC_RX) == LORAMAC_RX)
 	{
-		LoRaMacState &= ~LORAMAC_RX;
+		MacCtx->State &= ~LORAMAC_RX;
 	}
-	if (LoRaMacState == LORAMAC_IDLE)
+	if (MacCtx->State == LORAMAC_IDLE)
 	{
 		LOG_LIB("LM", "LoRaMacState = idle");
-		lmh_mac_is_busy = false;
-		if (LoRaMacFlags.Bits.McpsReq == 1)
+		if (MacCtx->NvmSessionChanged == true)
+		{
+			NvmStoreSession();
+		}
+		else
+		{
+			NvmCheckpoint();
+		}
+		if (MacCtx == &DefaultContext)
 		{
-			LoRaMacPrimitives->MacMcpsConfirm(&McpsConfirm);
-			LoRaMacFlags.Bits.McpsReq = 0;
+			// The helper drives the default instance only
+			lmh_mac_is_busy = false;
+		}
+		if (MacCtx->LoRaMacFlags.Bits.McpsReq == 1)
+		{
+			MacCtx->LoRaMacPrimitives->MacMcpsConfirm(&MacCtx->McpsConfirm);
+			MacCtx->LoRaMacFlags.Bits.McpsReq = 0;
 		}
 
-		if (LoRaMacFlags.Bits.MlmeReq == 1)
+		if (MacCtx->LoRaMacFlags.Bits.MlmeReq == 1)
 		{
-			LoRaMacPrimitives->MacMlmeConfirm(&MlmeConfirm);
-			if (MlmeConfirm.MlmeRequest == MLME_JOIN && IsLoRaMacNetworkJoined != JOIN_OK)
+			MacCtx->LoRaMacPrimitives->MacMlmeConfirm(&MacCtx->MlmeConfirm);
+			if (MacCtx->MlmeConfirm.MlmeRequest == MLME_JOIN && MacCtx->IsLoRaMacNetworkJoined != JOIN_OK)
 			{
 				// fix the bug: When the number of join times is used up, if call lmh_join() in callback function again cannot work
-				LoRaMacFlags.Bits.MlmeReq = 1;
+				MacCtx->LoRaMacFlags.Bits.MlmeReq = 1;
 			}
 			else
 			{
-				LoRaMacFlags.Bits.MlmeReq = 0;
+				MacCtx->LoRaMacFlags.Bits.MlmeReq = 0;
 			}
 		}
 
 		// Procedure done. Reset variables.
-		LoRaMacFlags.Bits.MacDone = 0;
+		MacCtx->LoRaMacFlags.Bits.MacDone = 0;
 	}
 	else
 	{
 		// Operation not finished restart timer
-		TimerSetValue(&MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
-		TimerStart(&MacStateCheckTimer);
+		TimerSetValue(&MacCtx->MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
+		TimerStart(&MacCtx->MacStateCheckTimer);
 	}
 
-	if (LoRaMacFlags.Bits.McpsInd == 1)
+	if (MacCtx->LoRaMacFlags.Bits.McpsInd == 1)
 	{
-		if (LoRaMacDeviceClass == CLASS_C)
+		if (MacCtx->LoRaMacDeviceClass == CLASS_C)
 		{ // Activate RX2 window for Class C
 			OnRxWindow2TimerEvent();
 		}
-		if (LoRaMacFlags.Bits.McpsIndSkip == 0)
+		if (MacCtx->LoRaMacFlags.Bits.McpsIndSkip == 0)
 		{
 			LOG_LIB("LM", "Calling MacMcpsIndication");
-			LoRaMacPrimitives->MacMcpsIndication(&McpsIndication);
+			MacCtx->LoRaMacPrimitives->MacMcpsIndication(&MacCtx->McpsIndication);
 		}
 		else
 		{
 			LOG_LIB("LM", "Skipped MacMcpsIndication");
 		}
-		LoRaMacFlags.Bits.McpsIndSkip = 0;
-		LoRaMacFlags.Bits.McpsInd = 0;
+		MacCtx->LoRaMacFlags.Bits.McpsIndSkip = 0;
+		MacCtx->LoRaMacFlags.Bits.McpsInd = 0;
 	}
 }
 
@@ -1470,19 +1292,19 @@ static void OnTxDelayedTimerEvent(void)
 	LoRaMacFrameCtrl_t fCtrl;
 	AlternateDrParams_t altDr;
 
-	TimerStop(&TxDelayedTimer);
-	LoRaMacState &= ~LORAMAC_TX_DELAYED;
+	TimerStop(&MacCtx->TxDelayedTimer);
+	MacCtx->State &= ~LORAMAC_TX_DELAYED;
 
-	if ((LoRaMacFlags.Bits.MlmeReq == 1) && (MlmeConfirm.MlmeRequest == MLME_JOIN))
+	if ((MacCtx->LoRaMacFlags.Bits.MlmeReq == 1) && (MacCtx->MlmeConfirm.MlmeRequest == MLME_JOIN))
 	{
-		altDr.NbTrials = JoinRequestTrials + 1;
-		LoRaMacParams.ChannelsDatarate = RegionAlternateDr(LoRaMacRegion, &altDr);
+		altDr.NbTrials = MacCtx->JoinRequestTrials + 1;
+		MacCtx->Params.ChannelsDatarate = RegionAlternateDr(MacCtx->Region, &altDr);
 
 		macHdr.Value = 0;
 		macHdr.Bits.MType = FRAME_TYPE_JOIN_REQ;
 
 		fCtrl.Value = 0;
-		fCtrl.Bits.Adr = AdrCtrlOn;
+		fCtrl.Bits.Adr = MacCtx->AdrCtrlOn;
 
 		/* In case of join request retransmissions, the stack must prepare
 		 * the frame again, because the network server keeps track of the random
@@ -1495,88 +1317,88 @@ static void OnTxDelayedTimerEvent(void)
 
 static void OnRxWindow1TimerEvent(void)
 {
-	TimerStop(&RxWindowTimer1);
-	RxSlot = 0;
+	TimerStop(&MacCtx->RxWindowTimer1);
+	MacCtx->RxSlot = 0;
 
-	RxWindow1Config.Channel = Channel;
-	RxWindow1Config.DrOffset = LoRaMacParams.Rx1DrOffset;
-	RxWindow1Config.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
-	RxWindow1Config.RepeaterSupport = RepeaterSupport;
-	RxWindow1Config.RxContinuous = false;
-	RxWindow1Config.Window = RxSlot;
+	MacCtx->RxWindow1Config.Channel = MacCtx->Channel;
+	MacCtx->RxWindow1Config.DrOffset = MacCtx->Params.Rx1DrOffset;
+	MacCtx->RxWindow1Config.DownlinkDwellTime = MacCtx->Params.DownlinkDwellTime;
+	MacCtx->RxWindow1Config.RepeaterSupport = MacCtx->RepeaterSupport;
+	MacCtx->RxWindow1Config.RxContinuous = false;
+	MacCtx->RxWindow1Config.Window = MacCtx->RxSlot;
 
-	if (LoRaMacDeviceClass == CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass == CLASS_C)
 	{
 		Radio.Standby();
 	}
 
-	RegionRxConfig(LoRaMacRegion, &RxWindow1Config, (int8_t *)&McpsIndication.RxDatarate);
-	RxWindowSetup(RxWindow1Config.RxContinuous, LoRaMacParams.MaxRxWindow);
+	RegionRxConfig(MacCtx->Region, &MacCtx->RxWindow1Config, (int8_t *)&MacCtx->McpsIndication.RxDatarate);
+	RxWindowSetup(MacCtx->RxWindow1Config.RxContinuous, MacCtx->Params.MaxRxWindow);
 }
 
 static void OnRxWindow2TimerEvent(void)
 {
-	TimerStop(&RxWindowTimer2);
+	TimerStop(&MacCtx->RxWindowTimer2);
 
-	RxWindow2Config.Channel = Channel;
-	RxWindow2Config.Frequency = LoRaMacParams.Rx2Channel.Frequency;
-	RxWindow2Config.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
-	RxWindow2Config.RepeaterSupport = RepeaterSupport;
-	RxWindow2Config.Window = 1;
+	MacCtx->RxWindow2Config.Channel = MacCtx->Channel;
+	MacCtx->RxWindow2Config.Frequency = MacCtx->Params.Rx2Channel.Frequency;
+	MacCtx->RxWindow2Config.DownlinkDwellTime = MacCtx->Params.DownlinkDwellTime;
+	MacCtx->RxWindow2Config.RepeaterSupport = MacCtx->RepeaterSupport;
+	MacCtx->RxWindow2Config.Window = 1;
 
 	// Make channel shifts for AS923-2, AS923-3 and AS923-4
-	switch (LoRaMacRegion)
+	switch (MacCtx->Region)
 	{
 	case LORAMAC_REGION_AS923:
 		LOG_LIB("LM", "Using AS923-1");
 		break;
 	case LORAMAC_REGION_AS923_2:
-		RxWindow2Config.Frequency = RxWindow2Config.Frequency - 1800000;
+		MacCtx->RxWindow2Config.Frequency = MacCtx->RxWindow2Config.Frequency - 1800000;
 		LOG_LIB("LM", "Using AS923-2");
 		break;
 	case LORAMAC_REGION_AS923_3:
-		RxWindow2Config.Frequency = RxWindow2Config.Frequency - 6600000;
+		MacCtx->RxWindow2Config.Frequency = MacCtx->RxWindow2Config.Frequency - 6600000;
 		LOG_LIB("LM", "Using AS923-3");
 		break;
 	case LORAMAC_REGION_AS923_4:
-		RxWindow2Config.Frequency = RxWindow2Config.Frequency - 5900000;
+		MacCtx->RxWindow2Config.Frequency = MacCtx->RxWindow2Config.Frequency - 5900000;
 		LOG_LIB("LM", "Using AS923-4");
 		break;
 	default:
 		break;
 	}
 
-	if (LoRaMacDeviceClass != CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass != CLASS_C)
 	{
-		RxWindow2Config.RxContinuous = false;
+		MacCtx->RxWindow2Config.RxContinuous = false;
 	}
 	else
 	{
-		RxWindow2Config.RxContinuous = true;
+		MacCtx->RxWindow2Config.RxContinuous = true;
 	}
 
-	if (RegionRxConfig(LoRaMacRegion, &RxWindow2Config, (int8_t *)&McpsIndication.RxDatarate) == true)
+	if (RegionRxConfig(MacCtx->Region, &MacCtx->RxWindow2Config, (int8_t *)&MacCtx->McpsIndication.RxDatarate) == true)
 	{
-		RxWindowSetup(RxWindow2Config.RxContinuous, LoRaMacParams.MaxRxWindow);
-		RxSlot = RxWindow2Config.Window;
+		RxWindowSetup(MacCtx->RxWindow2Config.RxContinuous, MacCtx->Params.MaxRxWindow);
+		MacCtx->RxSlot = MacCtx->RxWindow2Config.Window;
 	}
 }
 
 static void OnAckTimeoutTimerEvent(void)
 {
-	TimerStop(&AckTimeoutTimer);
+	TimerStop(&MacCtx->AckTimeoutTimer);
 
-	if (NodeAckRequested == true)
+	if (MacCtx->NodeAckRequested == true)
 	{
-		AckTimeoutRetry = true;
-		LoRaMacState &= ~LORAMAC_ACK_REQ;
-		LoRaMacState &= ~LORAMAC_TX_RUNNING;
+		MacCtx->AckTimeoutRetry = true;
+		MacCtx->State &= ~LORAMAC_ACK_REQ;
+		MacCtx->State &= ~LORAMAC_TX_RUNNING;
 	}
-	if (LoRaMacDeviceClass == CLASS_C)
+	if (MacCtx->LoRaMacDeviceClass == CLASS_C)
 	{
-		LoRaMacFlags.Bits.MacDone = 1;
+		MacCtx->LoRaMacFlags.Bits.MacDone = 1;
 	}
-	TimerStop(&MacStateCheckTimer);
+	TimerStop(&MacCtx->MacStateCheckTimer);
 	OnMacStateCheckTimerEvent();
 }
 
@@ -1600,16 +1422,16 @@ static bool ValidatePayloadLength(uint8_t lenN, int8_t datarate, uint8_t fOptsLe
 	uint16_t payloadSize = 0;
 
 	// Setup PHY request
-	getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+	getPhy.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
 	getPhy.Datarate = datarate;
 	getPhy.Attribute = PHY_MAX_PAYLOAD;
 
 	// Get the maximum payload length
-	if (RepeaterSupport == true)
+	if (MacCtx->RepeaterSupport == true)
 	{
 		getPhy.Attribute = PHY_MAX_PAYLOAD_REPEATER;
 	}
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 	maxN = phyParam.Value;
 
 	// Calculate the resulting payload size
@@ -1623,332 +1445,350 @@ static bool ValidatePayloadLength(uint8_t lenN, int8_t datarate, uint8_t fOptsLe
 	return false;
 }
 
-static LoRaMacStatus_t AddMacCommand(uint8_t cmd, uint8_t p1, uint8_t p2)
-{
-	LoRaMacStatus_t status = LORAMAC_STATUS_BUSY;
-	// The maximum buffer length must take MAC commands to re-send into account.
-	uint8_t bufLen = LORA_MAC_COMMAND_MAX_LENGTH - MacCommandsBufferToRepeatIndex;
+/*!
+ * \brief Handles LinkCheckAns
+ */
+static uint8_t OnLinkCheckAns(const uint8_t *payload, uint8_t size)
+{
+	MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+	MacCtx->MlmeConfirm.DemodMargin = payload[0];
+	MacCtx->MlmeConfirm.NbGateways = payload[1];
+	return 2;
+}
+
+/*!
+ * \brief Handles a block of LinkADRReq commands
+ */
+static uint8_t OnLinkAdrReq(const uint8_t *payload, uint8_t size)
+{
+	LinkAdrReqParams_t linkAdrReq;
+	int8_t linkAdrDatarate = DR_0;
+	int8_t linkAdrTxPower = TX_POWER_0;
+	uint8_t linkAdrNbRep = 0;
+	uint8_t linkAdrNbBytesParsed = 0;
+	uint8_t status;
 
-	switch (cmd)
+	// Fill parameter structure, the region parses the commands from the CID
+	linkAdrReq.Payload = (uint8_t *)payload - 1;
+	linkAdrReq.PayloadSize = size + 1;
+	linkAdrReq.AdrEnabled = MacCtx->AdrCtrlOn;
+	linkAdrReq.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
+	linkAdrReq.CurrentDatarate = MacCtx->Params.ChannelsDatarate;
+	linkAdrReq.CurrentTxPower = MacCtx->Params.ChannelsTxPower;
+	linkAdrReq.CurrentNbRep = MacCtx->Params.ChannelsNbRep;
+
+	// Process the ADR requests
+	status = RegionLinkAdrReq(MacCtx->Region, &linkAdrReq, &linkAdrDatarate,
+							  &linkAdrTxPower, &linkAdrNbRep, &linkAdrNbBytesParsed);
+
+	if ((status & 0x07) == 0x07)
 	{
-	case MOTE_MAC_LINK_CHECK_REQ:
-		if (MacCommandsBufferIndex < bufLen)
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// No payload for this command
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_LINK_ADR_ANS:
-		if (MacCommandsBufferIndex < (bufLen - 1))
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// Margin
-			MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_DUTY_CYCLE_ANS:
-		if (MacCommandsBufferIndex < bufLen)
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// No payload for this answer
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_RX_PARAM_SETUP_ANS:
-		if (MacCommandsBufferIndex < (bufLen - 1))
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// Status: Datarate ACK, Channel ACK
-			MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_DEV_STATUS_ANS:
-		if (MacCommandsBufferIndex < (bufLen - 2))
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// 1st byte Battery
-			// 2nd byte Margin
-			MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-			MacCommandsBuffer[MacCommandsBufferIndex++] = p2;
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_NEW_CHANNEL_ANS:
-		if (MacCommandsBufferIndex < (bufLen - 1))
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// Status: Datarate range OK, Channel frequency OK
-			MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_RX_TIMING_SETUP_ANS:
-		if (MacCommandsBufferIndex < bufLen)
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// No payload for this answer
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_TX_PARAM_SETUP_ANS:
-		if (MacCommandsBufferIndex < bufLen)
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// No payload for this answer
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	case MOTE_MAC_DL_CHANNEL_ANS:
-		if (MacCommandsBufferIndex < bufLen)
-		{
-			MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
-			// Status: Uplink frequency exists, Channel frequency OK
-			MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
-			status = LORAMAC_STATUS_OK;
-		}
-		break;
-	default:
-		return LORAMAC_STATUS_SERVICE_UNKNOWN;
+		MacCtx->Params.ChannelsDatarate = linkAdrDatarate;
+		MacCtx->Params.ChannelsTxPower = linkAdrTxPower;
+		MacCtx->Params.ChannelsNbRep = linkAdrNbRep;
+		MacCtx->NvmSessionChanged = true;
 	}
-	if (status == LORAMAC_STATUS_OK)
+
+	// Add the answers to the buffer
+	for (uint8_t i = 0; i < (linkAdrNbBytesParsed / 5); i++)
 	{
-		MacCommandsInNextTx = true;
+		AddMacCommand(MOTE_MAC_LINK_ADR_ANS, status, 0);
 	}
-	return status;
+	// Without the CID of the first command. The region counts a truncated
+	// last command in full.
+	if (linkAdrNbBytesParsed <= 4)
+	{
+		return 4;
+	}
+	return T_MIN(linkAdrNbBytesParsed - 1, size);
 }
 
-static uint8_t ParseMacCommandsToRepeat(uint8_t *cmdBufIn, uint8_t length, uint8_t *cmdBufOut)
+/*!
+ * \brief Handles DutyCycleReq
+ */
+static uint8_t OnDutyCycleReq(const uint8_t *payload, uint8_t size)
 {
-	uint8_t i = 0;
-	uint8_t cmdCount = 0;
+	MacCtx->MaxDCycle = payload[0];
+	MacCtx->AggregatedDCycle = 1 << MacCtx->MaxDCycle;
+	MacCtx->NvmSessionChanged = true;
+	AddMacCommand(MOTE_MAC_DUTY_CYCLE_ANS, 0, 0);
+	return 1;
+}
 
-	if ((cmdBufIn == NULL) || (cmdBufOut == NULL))
+/*!
+ * \brief Handles RXParamSetupReq
+ */
+static uint8_t OnRxParamSetupReq(const uint8_t *payload, uint8_t size)
+{
+	RxParamSetupReqParams_t rxParamSetupReq;
+	uint8_t status;
+
+	rxParamSetupReq.DrOffset = (payload[0] >> 4) & 0x07;
+	rxParamSetupReq.Datarate = payload[0] & 0x0F;
+
+	rxParamSetupReq.Frequency = (uint32_t)payload[1];
+	rxParamSetupReq.Frequency |= (uint32_t)payload[2] << 8;
+	rxParamSetupReq.Frequency |= (uint32_t)payload[3] << 16;
+	rxParamSetupReq.Frequency *= 100;
+
+	// Perform request on region
+	status = RegionRxParamSetupReq(MacCtx->Region, &rxParamSetupReq);
+
+	if ((status & 0x07) == 0x07)
 	{
-		return 0;
+		MacCtx->Params.Rx2Channel.Datarate = rxParamSetupReq.Datarate;
+		MacCtx->Params.Rx2Channel.Frequency = rxParamSetupReq.Frequency;
+		MacCtx->Params.Rx1DrOffset = rxParamSetupReq.DrOffset;
+		MacCtx->NvmSessionChanged = true;
 	}
+	AddMacCommand(MOTE_MAC_RX_PARAM_SETUP_ANS, status, 0);
+	return 4;
+}
+
+/*!
+ * \brief Handles DevStatusReq
+ *
+ * \param  snr SNR of the frame
+ */
+static uint8_t OnDevStatusReq(uint8_t snr)
+{
+	uint8_t batteryLevel = BAT_LEVEL_NO_MEASURE;
+	// if ((LoRaMacCallbacks != NULL) && (LoRaMacCallbacks->GetBatteryLevel != NULL))
+	// {
+	// 	batteryLevel = LoRaMacCallbacks->GetBatteryLevel();
+	// }
+	AddMacCommand(MOTE_MAC_DEV_STATUS_ANS, batteryLevel, snr);
+	return 0;
+}
+
+/*!
+ * \brief Handles NewChannelReq
+ */
+static uint8_t OnNewChannelReq(const uint8_t *payload, uint8_t size)
+{
+	NewChannelReqParams_t newChannelReq;
+	ChannelParams_t chParam;
+	uint8_t status;
+
+	newChannelReq.ChannelId = payload[0];
+	newChannelReq.NewChannel = &chParam;
+
+	chParam.Frequency = (uint32_t)payload[1];
+	chParam.Frequency |= (uint32_t)payload[2] << 8;
+	chParam.Frequency |= (uint32_t)payload[3] << 16;
+	chParam.Frequency *= 100;
+	chParam.Rx1Frequency = 0;
+	chParam.DrRange.Value = payload[4];
 
-	for (i = 0; i < length; i++)
+	status = RegionNewChannelReq(MacCtx->Region, &newChannelReq);
+	if (status == 0x03)
 	{
-		switch (cmdBufIn[i])
-		{
-		// STICKY
-		case MOTE_MAC_DL_CHANNEL_ANS:
-		case MOTE_MAC_RX_PARAM_SETUP_ANS:
-		{ // 1 byte payload
-			cmdBufOut[cmdCount++] = cmdBufIn[i++];
-			cmdBufOut[cmdCount++] = cmdBufIn[i];
-			break;
-		}
-		case MOTE_MAC_RX_TIMING_SETUP_ANS:
-		{ // 0 byte payload
-			cmdBufOut[cmdCount++] = cmdBufIn[i];
-			break;
-		}
-		// NON-STICKY
-		case MOTE_MAC_DEV_STATUS_ANS:
-		{ // 2 bytes payload
-			i += 2;
-			break;
-		}
-		case MOTE_MAC_LINK_ADR_ANS:
-		case MOTE_MAC_NEW_CHANNEL_ANS:
-		{ // 1 byte payload
-			i++;
-			break;
-		}
-		case MOTE_MAC_TX_PARAM_SETUP_ANS:
-		case MOTE_MAC_DUTY_CYCLE_ANS:
-		case MOTE_MAC_LINK_CHECK_REQ:
-		{ // 0 byte payload
-			break;
-		}
-		default:
-			break;
-		}
+		MacCtx->NvmSessionChanged = true;
 	}
 
-	return cmdCount;
+	AddMacCommand(MOTE_MAC_NEW_CHANNEL_ANS, status, 0);
+	return 5;
 }
 
-static void ProcessMacCommands(uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr)
+/*!
+ * \brief Handles RXTimingSetupReq
+ */
+static uint8_t OnRxTimingSetupReq(const uint8_t *payload, uint8_t size)
 {
-	uint8_t status = 0;
+	uint8_t delay = payload[0] & 0x0F;
 
-	while (macIndex < commandsSize)
+	if (delay == 0)
 	{
-		// Decode Frame MAC commands
-		switch (payload[macIndex++])
-		{
-		case SRV_MAC_LINK_CHECK_ANS:
-			MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-			MlmeConfirm.DemodMargin = payload[macIndex++];
-			MlmeConfirm.NbGateways = payload[macIndex++];
-			break;
-		case SRV_MAC_LINK_ADR_REQ:
-		{
-			LinkAdrReqParams_t linkAdrReq;
-			int8_t linkAdrDatarate = DR_0;
-			int8_t linkAdrTxPower = TX_POWER_0;
-			uint8_t linkAdrNbRep = 0;
-			uint8_t linkAdrNbBytesParsed = 0;
-
-			// Fill parameter structure
-			linkAdrReq.Payload = &payload[macIndex - 1];
-			linkAdrReq.PayloadSize = commandsSize - (macIndex - 1);
-			linkAdrReq.AdrEnabled = AdrCtrlOn;
-			linkAdrReq.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
-			linkAdrReq.CurrentDatarate = LoRaMacParams.ChannelsDatarate;
-			linkAdrReq.CurrentTxPower = LoRaMacParams.ChannelsTxPower;
-			linkAdrReq.CurrentNbRep = LoRaMacParams.ChannelsNbRep;
-
-			// Process the ADR requests
-			status = RegionLinkAdrReq(LoRaMacRegion, &linkAdrReq, &linkAdrDatarate,
-									  &linkAdrTxPower, &linkAdrNbRep, &linkAdrNbBytesParsed);
-
-			if ((status & 0x07) == 0x07)
-			{
-				LoRaMacParams.ChannelsDatarate = linkAdrDatarate;
-				LoRaMacParams.ChannelsTxPower = linkAdrTxPower;
-				LoRaMacParams.ChannelsNbRep = linkAdrNbRep;
-			}
+		delay++;
+	}
+	MacCtx->Params.ReceiveDelay1 = delay * 1000;
+	MacCtx->Params.ReceiveDelay2 = MacCtx->Params.ReceiveDelay1 + 1000;
+	MacCtx->NvmSessionChanged = true;
+	AddMacCommand(MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0);
+	return 1;
+}
 
-			// Add the answers to the buffer
-			for (uint8_t i = 0; i < (linkAdrNbBytesParsed / 5); i++)
-			{
-				AddMacCommand(MOTE_MAC_LINK_ADR_ANS, status, 0);
-			}
-			// Update MAC index
-			macIndex += linkAdrNbBytesParsed - 1;
-		}
-		break;
-		case SRV_MAC_DUTY_CYCLE_REQ:
-			MaxDCycle = payload[macIndex++];
-			AggregatedDCycle = 1 << MaxDCycle;
-			AddMacCommand(MOTE_MAC_DUTY_CYCLE_ANS, 0, 0);
-			break;
-		case SRV_MAC_RX_PARAM_SETUP_REQ:
-		{
-			RxParamSetupReqParams_t rxParamSetupReq;
-			status = 0x07;
+/*!
+ * \brief Handles TXParamSetupReq
+ */
+static uint8_t OnTxParamSetupReq(const uint8_t *payload, uint8_t size)
+{
+	TxParamSetupReqParams_t txParamSetupReq;
+	uint8_t eirpDwellTime = payload[0];
 
-			rxParamSetupReq.DrOffset = (payload[macIndex] >> 4) & 0x07;
-			rxParamSetupReq.Datarate = payload[macIndex] & 0x0F;
-			macIndex++;
+	txParamSetupReq.UplinkDwellTime = 0;
+	txParamSetupReq.DownlinkDwellTime = 0;
 
-			rxParamSetupReq.Frequency = (uint32_t)payload[macIndex++];
-			rxParamSetupReq.Frequency |= (uint32_t)payload[macIndex++] << 8;
-			rxParamSetupReq.Frequency |= (uint32_t)payload[macIndex++] << 16;
-			rxParamSetupReq.Frequency *= 100;
+	if ((eirpDwellTime & 0x20) == 0x20)
+	{
+		txParamSetupReq.DownlinkDwellTime = 1;
+	}
+	if ((eirpDwellTime & 0x10) == 0x10)
+	{
+		txParamSetupReq.UplinkDwellTime = 1;
+	}
+	txParamSetupReq.MaxEirp = eirpDwellTime & 0x0F;
 
-			// Perform request on region
-			status = RegionRxParamSetupReq(LoRaMacRegion, &rxParamSetupReq);
+	// Check the status for correctness
+	if (RegionTxParamSetupReq(MacCtx->Region, &txParamSetupReq) != -1)
+	{
+		// Accept command
+		MacCtx->Params.UplinkDwellTime = txParamSetupReq.UplinkDwellTime;
+		MacCtx->Params.DownlinkDwellTime = txParamSetupReq.DownlinkDwellTime;
+		MacCtx->Params.MaxEirp = LoRaMacMaxEirpTable[txParamSetupReq.MaxEirp];
+		MacCtx->NvmSessionChanged = true;
+		// Add command response
+		AddMacCommand(MOTE_MAC_TX_PARAM_SETUP_ANS, 0, 0);
+	}
+	return 1;
+}
 
-			if ((status & 0x07) == 0x07)
-			{
-				LoRaMacParams.Rx2Channel.Datarate = rxParamSetupReq.Datarate;
-				LoRaMacParams.Rx2Channel.Frequency = rxParamSetupReq.Frequency;
-				LoRaMacParams.Rx1DrOffset = rxParamSetupReq.DrOffset;
-			}
-			AddMacCommand(MOTE_MAC_RX_PARAM_SETUP_ANS, status, 0);
-		}
-		break;
-		case SRV_MAC_DEV_STATUS_REQ:
-		{
-			uint8_t batteryLevel = BAT_LEVEL_NO_MEASURE;
-			// if ((LoRaMacCallbacks != NULL) && (LoRaMacCallbacks->GetBatteryLevel != NULL))
-			// {
-			// 	batteryLevel = LoRaMacCallbacks->GetBatteryLevel();
-			// }
-			AddMacCommand(MOTE_MAC_DEV_STATUS_ANS, batteryLevel, snr);
-			break;
-		}
-		case SRV_MAC_NEW_CHANNEL_REQ:
-		{
-			NewChannelReqParams_t newChannelReq;
-			ChannelParams_t chParam;
-			status = 0x03;
+/*!
+ * \brief Handles DlChannelReq
+ */
+static uint8_t OnDlChannelReq(const uint8_t *payload, uint8_t size)
+{
+	DlChannelReqParams_t dlChannelReq;
+	uint8_t status;
 
-			newChannelReq.ChannelId = payload[macIndex++];
-			newChannelReq.NewChannel = &chParam;
+	dlChannelReq.ChannelId = payload[0];
+	dlChannelReq.Rx1Frequency = (uint32_t)payload[1];
+	dlChannelReq.Rx1Frequency |= (uint32_t)payload[2] << 8;
+	dlChannelReq.Rx1Frequency |= (uint32_t)payload[3] << 16;
+	dlChannelReq.Rx1Frequency *= 100;
 
-			chParam.Frequency = (uint32_t)payload[macIndex++];
-			chParam.Frequency |= (uint32_t)payload[macIndex++] << 8;
-			chParam.Frequency |= (uint32_t)payload[macIndex++] << 16;
-			chParam.Frequency *= 100;
-			chParam.Rx1Frequency = 0;
-			chParam.DrRange.Value = payload[macIndex++];
+	status = RegionDlChannelReq(MacCtx->Region, &dlChannelReq);
+	if (status == 0x03)
+	{
+		MacCtx->NvmSessionChanged = true;
+	}
 
-			status = RegionNewChannelReq(LoRaMacRegion, &newChannelReq);
+	AddMacCommand(MOTE_MAC_DL_CHANNEL_ANS, status, 0);
+	return 4;
+}
 
-			AddMacCommand(MOTE_MAC_NEW_CHANNEL_ANS, status, 0);
-		}
-		break;
-		case SRV_MAC_RX_TIMING_SETUP_REQ:
-		{
-			uint8_t delay = payload[macIndex++] & 0x0F;
+/*!
+ * MAC commands, indexed by CID
+ *
+ * LoRaWAN Specification V1.0.2, chapter 5, table 4
+ */
+static const LoRaMacCommand_t MacCommands[] =
+{
+	// 0x00, 0x01: reserved
+	{0, 0, 0},
+	{0, 0, 0},
+	// LinkCheckReq / LinkCheckAns
+	{2, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	// LinkADRReq / LinkADRAns
+	{4, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	// DutyCycleReq / DutyCycleAns
+	{1, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	// RXParamSetupReq / RXParamSetupAns
+	{4, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_STICKY | LORAMAC_COMMAND_DOWNLINK},
+	// DevStatusReq / DevStatusAns
+	{0, 2, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	// NewChannelReq / NewChannelAns
+	{5, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	// RXTimingSetupReq / RXTimingSetupAns
+	{1, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_STICKY | LORAMAC_COMMAND_DOWNLINK},
+	// TXParamSetupReq / TXParamSetupAns
+	{1, 0, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_DOWNLINK},
+	// DlChannelReq / DlChannelAns
+	{4, 1, LORAMAC_COMMAND_UPLINK | LORAMAC_COMMAND_STICKY | LORAMAC_COMMAND_DOWNLINK},
+};
 
-			if (delay == 0)
-			{
-				delay++;
-			}
-			LoRaMacParams.ReceiveDelay1 = delay * 1000;
-			LoRaMacParams.ReceiveDelay2 = LoRaMacParams.ReceiveDelay1 + 1000;
-			AddMacCommand(MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0);
-		}
-		break;
-		case SRV_MAC_TX_PARAM_SETUP_REQ:
-		{
-			TxParamSetupReqParams_t txParamSetupReq;
-			uint8_t eirpDwellTime = payload[macIndex++];
+#define MAC_COMMANDS_NB (sizeof(MacCommands) / sizeof(MacCommands[0]))
 
-			txParamSetupReq.UplinkDwellTime = 0;
-			txParamSetupReq.DownlinkDwellTime = 0;
+static LoRaMacStatus_t AddMacCommand(uint8_t cmd, uint8_t p1, uint8_t p2)
+{
+	const LoRaMacCommand_t *command = LoRaMacCommandsGetUplink(MacCommands, MAC_COMMANDS_NB, cmd);
+	// The maximum buffer length must take MAC commands to re-send into account.
+	uint8_t bufLen = LORA_MAC_COMMAND_MAX_LENGTH - MacCtx->MacCommandsBufferToRepeatIndex;
 
-			if ((eirpDwellTime & 0x20) == 0x20)
-			{
-				txParamSetupReq.DownlinkDwellTime = 1;
-			}
-			if ((eirpDwellTime & 0x10) == 0x10)
-			{
-				txParamSetupReq.UplinkDwellTime = 1;
-			}
-			txParamSetupReq.MaxEirp = eirpDwellTime & 0x0F;
+	if (command == NULL)
+	{
+		return LORAMAC_STATUS_SERVICE_UNKNOWN;
+	}
+	if ((MacCtx->MacCommandsBufferIndex + command->TxSize) >= bufLen)
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
 
-			// Check the status for correctness
-			if (RegionTxParamSetupReq(LoRaMacRegion, &txParamSetupReq) != -1)
-			{
-				// Accept command
-				LoRaMacParams.UplinkDwellTime = txParamSetupReq.UplinkDwellTime;
-				LoRaMacParams.DownlinkDwellTime = txParamSetupReq.DownlinkDwellTime;
-				LoRaMacParams.MaxEirp = LoRaMacMaxEirpTable[txParamSetupReq.MaxEirp];
-				// Add command response
-				AddMacCommand(MOTE_MAC_TX_PARAM_SETUP_ANS, 0, 0);
-			}
-		}
-		break;
-		case SRV_MAC_DL_CHANNEL_REQ:
-		{
-			DlChannelReqParams_t dlChannelReq;
-			status = 0x03;
+	MacCtx->MacCommandsBuffer[MacCtx->MacCommandsBufferIndex++] = cmd;
+	if (command->TxSize > 0)
+	{
+		MacCtx->MacCommandsBuffer[MacCtx->MacCommandsBufferIndex++] = p1;
+	}
+	if (command->TxSize > 1)
+	{
+		MacCtx->MacCommandsBuffer[MacCtx->MacCommandsBufferIndex++] = p2;
+	}
+	MacCtx->MacCommandsInNextTx = true;
+	return LORAMAC_STATUS_OK;
+}
 
-			dlChannelReq.ChannelId = payload[macIndex++];
-			dlChannelReq.Rx1Frequency = (uint32_t)payload[macIndex++];
-			dlChannelReq.Rx1Frequency |= (uint32_t)payload[macIndex++] << 8;
-			dlChannelReq.Rx1Frequency |= (uint32_t)payload[macIndex++] << 16;
-			dlChannelReq.Rx1Frequency *= 100;
+static uint8_t ParseMacCommandsToRepeat(uint8_t *cmdBufIn, uint8_t length, uint8_t *cmdBufOut)
+{
+	if ((cmdBufIn == NULL) || (cmdBufOut == NULL))
+	{
+		return 0;
+	}
+	return LoRaMacCommandsGetSticky(MacCommands, MAC_COMMANDS_NB, cmdBufIn, length, cmdBufOut);
+}
 
-			status = RegionDlChannelReq(LoRaMacRegion, &dlChannelReq);
+static void ProcessMacCommands(uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr)
+{
+	while (macIndex < commandsSize)
+	{
+		uint8_t cid = payload[macIndex++];
+		uint8_t remaining = commandsSize - macIndex;
+		const LoRaMacCommand_t *command = LoRaMacCommandsGetDownlink(MacCommands, MAC_COMMANDS_NB, cid, remaining);
+		uint8_t consumed;
 
-			AddMacCommand(MOTE_MAC_DL_CHANNEL_ANS, status, 0);
+		if (command == NULL)
+		{
+			// Unknown or truncated command, skip the remaining bytes
+			break;
 		}
-		break;
+
+		// Decode Frame MAC commands, the size has been checked. Each handler
+		// returns the number of payload bytes it consumed.
+		switch (cid)
+		{
+		case SRV_MAC_LINK_CHECK_ANS:
+			consumed = OnLinkCheckAns(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_LINK_ADR_REQ:
+			consumed = OnLinkAdrReq(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_DUTY_CYCLE_REQ:
+			consumed = OnDutyCycleReq(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_RX_PARAM_SETUP_REQ:
+			consumed = OnRxParamSetupReq(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_DEV_STATUS_REQ:
+			consumed = OnDevStatusReq(snr);
+			break;
+		case SRV_MAC_NEW_CHANNEL_REQ:
+			consumed = OnNewChannelReq(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_RX_TIMING_SETUP_REQ:
+			consumed = OnRxTimingSetupReq(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_TX_PARAM_SETUP_REQ:
+			consumed = OnTxParamSetupReq(&payload[macIndex], remaining);
+			break;
+		case SRV_MAC_DL_CHANNEL_REQ:
+			consumed = OnDlChannelReq(&payload[macIndex], remaining);
+			break;
 		default:
-			// Unknown command. ABORT MAC commands processing
-			return;
+			// Accepted by the table but not handled
+			consumed = command->RxSize;
+			break;
 		}
+
+		macIndex += consumed;
 	}
 }
 
@@ -1962,7 +1802,7 @@ LoRaMacStatus_t Send(LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uint
 	fCtrl.Bits.FPending = 0;
 	fCtrl.Bits.Ack = false;
 	fCtrl.Bits.AdrAckReq = false;
-	fCtrl.Bits.Adr = AdrCtrlOn;
+	fCtrl.Bits.Adr = MacCtx->AdrCtrlOn;
 
 	// Prepare the frame
 	status = PrepareFrame(macHdr, &fCtrl, fPort, fBuffer, fBufferSize);
@@ -1974,16 +1814,15 @@ LoRaMacStatus_t Send(LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uint
 	}
 
 	// Reset confirm parameters
-	McpsConfirm.NbRetries = 0;
-	McpsConfirm.AckReceived = false;
-	McpsConfirm.UpLinkCounter = UpLinkCounter;
+	MacCtx->McpsConfirm.NbRetries = 0;
+	MacCtx->McpsConfirm.AckReceived = false;
+	MacCtx->McpsConfirm.UpLinkCounter = MacCtx->UpLinkCounter;
 
 	status = ScheduleTx();
 
 	return status;
 }
 
-bool send_join_now = true;
 
 static LoRaMacStatus_t ScheduleTx(void)
 {
@@ -1991,158 +1830,356 @@ static LoRaMacStatus_t ScheduleTx(void)
 	NextChanParams_t nextChan;
 
 	// Check if the device is off
-	if (MaxDCycle == 255)
+	if (MacCtx->MaxDCycle == 255)
 	{
 		return LORAMAC_STATUS_DEVICE_OFF;
 	}
-	if (MaxDCycle == 0)
+	if (MacCtx->MaxDCycle == 0)
 	{
-		AggregatedTimeOff = 0;
+		MacCtx->AggregatedTimeOff = 0;
 	}
 
 	// Update Backoff
-	CalculateBackOff(LastTxChannel);
+	CalculateBackOff(MacCtx->LastTxChannel);
 
-	nextChan.AggrTimeOff = AggregatedTimeOff;
-	nextChan.Datarate = LoRaMacParams.ChannelsDatarate;
-	nextChan.DutyCycleEnabled = DutyCycleOn;
+	nextChan.AggrTimeOff = MacCtx->AggregatedTimeOff;
+	nextChan.Datarate = MacCtx->Params.ChannelsDatarate;
+	nextChan.DutyCycleEnabled = MacCtx->DutyCycleOn;
 	//		nextChan.Joined = IsLoRaMacNetworkJoined;
-	nextChan.Joined = (IsLoRaMacNetworkJoined == JOIN_OK);
-	nextChan.LastAggrTx = AggregatedLastTxDoneTime;
+	nextChan.Joined = (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK);
+	nextChan.LastAggrTx = MacCtx->AggregatedLastTxDoneTime;
 
 	// Select channel
-	while (RegionNextChannel(LoRaMacRegion, &nextChan, &Channel, &dutyCycleTimeOff, &AggregatedTimeOff) == false)
+	while (RegionNextChannel(MacCtx->Region, &nextChan, &MacCtx->Channel, &dutyCycleTimeOff, &MacCtx->AggregatedTimeOff) == false)
 	{
 		// Set the default datarate
-		LoRaMacParams.ChannelsDatarate = LoRaMacParamsDefaults.ChannelsDatarate;
+		MacCtx->Params.ChannelsDatarate = MacCtx->ParamsDefaults.ChannelsDatarate;
 		// Update datarate in the function parameters
-		nextChan.Datarate = LoRaMacParams.ChannelsDatarate;
+		nextChan.Datarate = MacCtx->Params.ChannelsDatarate;
 	}
 
 	// Compute Rx1 windows parameters
-	RegionComputeRxWindowParameters(LoRaMacRegion,
-									RegionApplyDrOffset(LoRaMacRegion, LoRaMacParams.DownlinkDwellTime, LoRaMacParams.ChannelsDatarate, LoRaMacParams.Rx1DrOffset),
-									LoRaMacParams.MinRxSymbols,
-									LoRaMacParams.SystemMaxRxError,
-									&RxWindow1Config);
+	RegionComputeRxWindowParameters(MacCtx->Region,
+									RegionApplyDrOffset(MacCtx->Region, MacCtx->Params.DownlinkDwellTime, MacCtx->Params.ChannelsDatarate, MacCtx->Params.Rx1DrOffset),
+									MacCtx->Params.MinRxSymbols,
+									MacCtx->Params.SystemMaxRxError,
+									&MacCtx->RxWindow1Config);
 	// Compute Rx2 windows parameters
-	RegionComputeRxWindowParameters(LoRaMacRegion,
-									LoRaMacParams.Rx2Channel.Datarate,
-									LoRaMacParams.MinRxSymbols,
-									LoRaMacParams.SystemMaxRxError,
-									&RxWindow2Config);
+	RegionComputeRxWindowParameters(MacCtx->Region,
+									MacCtx->Params.Rx2Channel.Datarate,
+									MacCtx->Params.MinRxSymbols,
+									MacCtx->Params.SystemMaxRxError,
+									&MacCtx->RxWindow2Config);
 
-	if (IsLoRaMacNetworkJoined != JOIN_OK)
+	if (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK)
 	{
-		RxWindow1Delay = LoRaMacParams.JoinAcceptDelay1 + RxWindow1Config.WindowOffset;
-		RxWindow2Delay = LoRaMacParams.JoinAcceptDelay2 + RxWindow2Config.WindowOffset;
+		MacCtx->RxWindow1Delay = MacCtx->Params.JoinAcceptDelay1 + MacCtx->RxWindow1Config.WindowOffset;
+		MacCtx->RxWindow2Delay = MacCtx->Params.JoinAcceptDelay2 + MacCtx->RxWindow2Config.WindowOffset;
 	}
 	else
 	{
-		if (ValidatePayloadLength(LoRaMacTxPayloadLen, LoRaMacParams.ChannelsDatarate, MacCommandsBufferIndex) == false)
+		if (ValidatePayloadLength(MacCtx->LoRaMacTxPayloadLen, MacCtx->Params.ChannelsDatarate, MacCtx->MacCommandsBufferIndex) == false)
 		{
 			return LORAMAC_STATUS_LENGTH_ERROR;
 		}
-		RxWindow1Delay = LoRaMacParams.ReceiveDelay1 + RxWindow1Config.WindowOffset;
-		RxWindow2Delay = LoRaMacParams.ReceiveDelay2 + RxWindow2Config.WindowOffset;
+		MacCtx->RxWindow1Delay = MacCtx->Params.ReceiveDelay1 + MacCtx->RxWindow1Config.WindowOffset;
+		MacCtx->RxWindow2Delay = MacCtx->Params.ReceiveDelay2 + MacCtx->RxWindow2Config.WindowOffset;
 	}
 
 	/*******************************************/
 	/// \todo weak fix for delayed join on EU868
-	if (LoRaMacRegion == LORAMAC_REGION_EU868)
+	if (MacCtx->Region == LORAMAC_REGION_EU868)
 	{
-		if (IsLoRaMacNetworkJoined == JOIN_OK)
+		if (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK)
 		{
 			LOG_LIB("LM", "Reset send_join_now to true");
-			send_join_now = true;
+			MacCtx->SendJoinNow = true;
 		}
 
-		if ((IsLoRaMacNetworkJoined == JOIN_ONGOING) && (send_join_now))
+		if ((MacCtx->IsLoRaMacNetworkJoined == JOIN_ONGOING) && (MacCtx->SendJoinNow))
 		{
 			LOG_LIB("LM", "dutyCycleTimeOff was = %d", dutyCycleTimeOff);
 			dutyCycleTimeOff = 0;
-			send_join_now = false;
+			MacCtx->SendJoinNow = false;
 			LOG_LIB("LM", "Set send_join_now to false");
 		}
 	}
 	/*******************************************/
 
-	// Schedule transmission of frame
-	if (dutyCycleTimeOff == 0)
+	// Schedule transmission of frame
+	if (dutyCycleTimeOff == 0)
+	{
+		// Try to send now
+		return SendFrameOnChannel(MacCtx->Channel);
+	}
+	else
+	{
+		// Send later - prepare timer
+		MacCtx->State |= LORAMAC_TX_DELAYED;
+		TimerSetValue(&MacCtx->TxDelayedTimer, dutyCycleTimeOff);
+		TimerStart(&MacCtx->TxDelayedTimer);
+
+		return LORAMAC_STATUS_OK;
+	}
+}
+
+static void CalculateBackOff(uint8_t channel)
+{
+	CalcBackOffParams_t calcBackOff;
+
+	//		calcBackOff.Joined = IsLoRaMacNetworkJoined;
+	calcBackOff.Joined = (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK);
+	calcBackOff.DutyCycleEnabled = MacCtx->DutyCycleOn;
+	calcBackOff.Channel = channel;
+	calcBackOff.ElapsedTime = TimerGetElapsedTime(MacCtx->LoRaMacInitializationTime);
+	calcBackOff.TxTimeOnAir = MacCtx->TxTimeOnAir;
+	calcBackOff.LastTxIsJoinRequest = MacCtx->LastTxIsJoinRequest;
+
+	// Update regional back-off
+	RegionCalcBackOff(MacCtx->Region, &calcBackOff);
+
+	// Update aggregated time-off
+	MacCtx->AggregatedTimeOff = MacCtx->AggregatedTimeOff + (MacCtx->TxTimeOnAir * MacCtx->AggregatedDCycle - MacCtx->TxTimeOnAir);
+}
+
+static void AirtimeTxDone(TimerTime_t txDoneTime)
+{
+	LoRaMacAirtimeTxDoneParams_t txDone;
+	GetPhyParams_t getPhy;
+	PhyParam_t phyParam;
+
+	getPhy.Attribute = PHY_CHANNELS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	txDone.Channels = phyParam.Channels;
+	getPhy.Attribute = PHY_BANDS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	txDone.Bands = phyParam.Bands;
+
+	txDone.Channel = MacCtx->Channel;
+	txDone.Joined = (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK);
+	txDone.DutyCycleEnabled = MacCtx->DutyCycleOn;
+	txDone.LastTxIsJoinRequest = MacCtx->LastTxIsJoinRequest;
+	txDone.ElapsedTime = TimerGetElapsedTime(MacCtx->LoRaMacInitializationTime);
+	txDone.TxDoneTime = txDoneTime;
+	txDone.TxTimeOnAir = MacCtx->TxTimeOnAir;
+	LoRaMacAirtimeTxDone(&MacCtx->Airtime, &txDone);
+}
+
+static LoRaMacStatus_t GetAirtime(MibAirtimeParams_t *airtime)
+{
+	GetPhyParams_t getPhy;
+	PhyParam_t phyParam;
+	ChannelParams_t *channels;
+	Band_t *bands;
+	uint8_t nbChannels;
+	uint8_t i;
+
+	getPhy.Attribute = PHY_CHANNELS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	channels = phyParam.Channels;
+	getPhy.Attribute = PHY_MAX_NB_CHANNELS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	nbChannels = phyParam.Value;
+	getPhy.Attribute = PHY_BANDS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	bands = phyParam.Bands;
+
+	// The band must be the one of a defined channel
+	for (i = 0; i < nbChannels; i++)
+	{
+		if ((channels[i].Frequency != 0) && (channels[i].Band == airtime->Band))
+		{
+			break;
+		}
+	}
+	if (i == nbChannels)
+	{
+		return LORAMAC_STATUS_PARAMETER_INVALID;
+	}
+
+	airtime->Consumed = LoRaMacAirtimeGetConsumed(&MacCtx->Airtime, airtime->Band, TimerGetCurrentTime());
+	airtime->Budget = LoRaMacAirtimeGetBudget(&bands[airtime->Band], (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK),
+											  TimerGetElapsedTime(MacCtx->LoRaMacInitializationTime));
+	airtime->Remaining = (airtime->Consumed < airtime->Budget) ? (airtime->Budget - airtime->Consumed) : 0;
+	return LORAMAC_STATUS_OK;
+}
+
+static void GetAirtimeChannels(LoRaMacAirtimeNextTxParams_t *airtimeNextTx)
+{
+	GetPhyParams_t getPhy;
+	PhyParam_t phyParam;
+
+	getPhy.Attribute = PHY_CHANNELS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	airtimeNextTx->Channels = phyParam.Channels;
+	getPhy.Attribute = PHY_BANDS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	airtimeNextTx->Bands = phyParam.Bands;
+	getPhy.Attribute = PHY_CHANNELS_MASK;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	airtimeNextTx->ChannelsMask = phyParam.ChannelsMask;
+	getPhy.Attribute = PHY_MAX_NB_CHANNELS;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	airtimeNextTx->NbChannels = phyParam.Value;
+
+	airtimeNextTx->Joined = (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK);
+	airtimeNextTx->DutyCycleEnabled = MacCtx->DutyCycleOn;
+	airtimeNextTx->ElapsedTime = TimerGetElapsedTime(MacCtx->LoRaMacInitializationTime);
+
+	// The aggregated time off ScheduleTx will check: the accumulated one,
+	// cleared without duty cycle, plus the one of the last uplink added by
+	// CalculateBackOff
+	airtimeNextTx->AggregatedLastTxDoneTime = MacCtx->AggregatedLastTxDoneTime;
+	airtimeNextTx->AggregatedTimeOff = (MacCtx->MaxDCycle == 0) ? 0 : MacCtx->AggregatedTimeOff;
+	airtimeNextTx->AggregatedTimeOff += MacCtx->TxTimeOnAir * MacCtx->AggregatedDCycle - MacCtx->TxTimeOnAir;
+}
+
+static LoRaMacStatus_t GetAirtimeNextTx(MibAirtimeNextTxParams_t *nextTx)
+{
+	LoRaMacAirtimeNextTxParams_t airtimeNextTx;
+	VerifyParams_t verify;
+	GetPhyParams_t getPhy;
+	PhyParam_t phyParam;
+
+	verify.DatarateParams.Datarate = nextTx->Datarate;
+	verify.DatarateParams.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
+	if (RegionVerify(MacCtx->Region, &verify, PHY_TX_DR) == false)
+	{
+		return LORAMAC_STATUS_DATARATE_INVALID;
+	}
+	if (nextTx->PayloadSize > (LORAMAC_PHY_MAXPAYLOAD - LORA_MAC_FRMPAYLOAD_OVERHEAD))
+	{
+		return LORAMAC_STATUS_LENGTH_ERROR;
+	}
+
+	getPhy.Attribute = PHY_TIME_ON_AIR;
+	getPhy.Datarate = nextTx->Datarate;
+	getPhy.PktLen = nextTx->PayloadSize + LORA_MAC_FRMPAYLOAD_OVERHEAD;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	nextTx->TimeOnAir = phyParam.Value;
+
+	GetAirtimeChannels(&airtimeNextTx);
+	airtimeNextTx.Datarate = nextTx->Datarate;
+	airtimeNextTx.TimeOnAir = nextTx->TimeOnAir;
+	nextTx->Delay = LoRaMacAirtimeGetNextTx(&MacCtx->Airtime, &airtimeNextTx, TimerGetCurrentTime());
+	if (nextTx->Delay == LORAMAC_AIRTIME_NO_TX)
+	{
+		return LORAMAC_STATUS_PARAMETER_INVALID;
+	}
+	return LORAMAC_STATUS_OK;
+}
+
+static bool NvmStoreSession(void)
+{
+	LoRaMacNvm_t *nvm = MacCtx->Nvm;
+
+	MacCtx->NvmSessionChanged = false;
+	if ((nvm == NULL) || (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK))
 	{
-		// Try to send now
-		return SendFrameOnChannel(Channel);
+		return false;
 	}
-	else
-	{
-		// Send later - prepare timer
-		LoRaMacState |= LORAMAC_TX_DELAYED;
-		TimerSetValue(&TxDelayedTimer, dutyCycleTimeOff);
-		TimerStart(&TxDelayedTimer);
 
-		return LORAMAC_STATUS_OK;
+	memset1((uint8_t *)&NvmSession, 0, sizeof(NvmSession));
+	NvmSession.Region = MacCtx->Region;
+	NvmSession.DevAddr = MacCtx->DevAddr;
+	NvmSession.NetID = MacCtx->LoRaMacNetID;
+	memcpy1(NvmSession.NwkSKey, MacCtx->NwkSKey, sizeof(NvmSession.NwkSKey));
+	memcpy1(NvmSession.AppSKey, MacCtx->AppSKey, sizeof(NvmSession.AppSKey));
+	NvmSession.UpLinkCounter = MacCtx->UpLinkCounter + nvm->Stride;
+	NvmSession.DownLinkCounter = MacCtx->DownLinkCounter;
+	NvmSession.AdrCtrlOn = MacCtx->AdrCtrlOn;
+	NvmSession.MaxDCycle = MacCtx->MaxDCycle;
+	NvmSession.AggregatedDCycle = MacCtx->AggregatedDCycle;
+	NvmSession.Params = MacCtx->Params;
+
+	// The region keeps the channels of the active instance
+	RegionSaveContext(MacCtx->Region, &MacCtx->RegionContext);
+	memcpy1((uint8_t *)NvmSession.Channels, (uint8_t *)MacCtx->RegionContext.Channels, sizeof(NvmSession.Channels));
+	memcpy1((uint8_t *)NvmSession.ChannelsMask, (uint8_t *)MacCtx->RegionContext.ChannelsMask, sizeof(NvmSession.ChannelsMask));
+	memcpy1((uint8_t *)NvmSession.ChannelsDefaultMask, (uint8_t *)MacCtx->RegionContext.ChannelsDefaultMask, sizeof(NvmSession.ChannelsDefaultMask));
+
+	if (LoRaMacNvmWriteSession(nvm, &NvmSession) != LORAMAC_NVM_SUCCESS)
+	{
+		LOG_LIB("LM", "Session snapshot failed");
+		return false;
 	}
+	return true;
 }
 
-static void CalculateBackOff(uint8_t channel)
+static bool NvmCheckpoint(void)
 {
-	CalcBackOffParams_t calcBackOff;
+	LoRaMacNvm_t *nvm = MacCtx->Nvm;
+	uint32_t upLinkCounter;
+	bool ceilingReached = false;
 
-	//		calcBackOff.Joined = IsLoRaMacNetworkJoined;
-	calcBackOff.Joined = (IsLoRaMacNetworkJoined == JOIN_OK);
-	calcBackOff.DutyCycleEnabled = DutyCycleOn;
-	calcBackOff.Channel = channel;
-	calcBackOff.ElapsedTime = TimerGetElapsedTime(LoRaMacInitializationTime);
-	calcBackOff.TxTimeOnAir = TxTimeOnAir;
-	calcBackOff.LastTxIsJoinRequest = LastTxIsJoinRequest;
+	if ((nvm == NULL) || (nvm->HasSession == false) || (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK) ||
+		(MacCtx->IsUpLinkCounterFixed == true))
+	{
+		return true;
+	}
 
-	// Update regional back-off
-	RegionCalcBackOff(LoRaMacRegion, &calcBackOff);
+	upLinkCounter = nvm->UpLinkCounter;
+	if (MacCtx->UpLinkCounter >= upLinkCounter)
+	{
+		upLinkCounter = MacCtx->UpLinkCounter + nvm->Stride;
+		ceilingReached = true;
+	}
+	else if ((MacCtx->DownLinkCounter - nvm->DownLinkCounter) < nvm->Stride)
+	{
+		return true;
+	}
 
-	// Update aggregated time-off
-	AggregatedTimeOff = AggregatedTimeOff + (TxTimeOnAir * AggregatedDCycle - TxTimeOnAir);
+	if (LoRaMacNvmWriteCounters(nvm, upLinkCounter, MacCtx->DownLinkCounter) != LORAMAC_NVM_SUCCESS)
+	{
+		LOG_LIB("LM", "Frame counter checkpoint failed");
+		// A lost downlink checkpoint only widens the replay window, it is
+		// written again with the next one
+		return (ceilingReached == false);
+	}
+	return true;
 }
 
-void ResetMacCounters(void)
+void LoRaMacCtxResetMacCounters(LoRaMacContext_t *ctx)
 {
+	SetContext(ctx);
 
 	// Counters
 	// UpLinkCounter = 0;
 	// DownLinkCounter = 0;
-	AdrAckCounter = 0;
+	MacCtx->AdrAckCounter = 0;
 
-	ChannelsNbRepCounter = 0;
+	MacCtx->ChannelsNbRepCounter = 0;
 
-	AckTimeoutRetries = 1;
-	AckTimeoutRetriesCounter = 1;
-	AckTimeoutRetry = false;
+	MacCtx->AckTimeoutRetries = 1;
+	MacCtx->AckTimeoutRetriesCounter = 1;
+	MacCtx->AckTimeoutRetry = false;
 
-	MaxDCycle = 0;
-	AggregatedDCycle = 1;
+	MacCtx->MaxDCycle = 0;
+	MacCtx->AggregatedDCycle = 1;
 
-	MacCommandsBufferIndex = 0;
-	MacCommandsBufferToRepeatIndex = 0;
+	MacCtx->MacCommandsBufferIndex = 0;
+	MacCtx->MacCommandsBufferToRepeatIndex = 0;
 
-	IsRxWindowsEnabled = true;
+	MacCtx->IsRxWindowsEnabled = true;
 
-	LoRaMacParams.ChannelsTxPower = LoRaMacParamsDefaults.ChannelsTxPower;
-	LoRaMacParams.ChannelsDatarate = LoRaMacParamsDefaults.ChannelsDatarate;
-	LoRaMacParams.Rx1DrOffset = LoRaMacParamsDefaults.Rx1DrOffset;
-	LoRaMacParams.Rx2Channel = LoRaMacParamsDefaults.Rx2Channel;
-	LoRaMacParams.UplinkDwellTime = LoRaMacParamsDefaults.UplinkDwellTime;
-	LoRaMacParams.DownlinkDwellTime = LoRaMacParamsDefaults.DownlinkDwellTime;
-	LoRaMacParams.MaxEirp = LoRaMacParamsDefaults.MaxEirp;
-	LoRaMacParams.AntennaGain = LoRaMacParamsDefaults.AntennaGain;
+	MacCtx->Params.ChannelsTxPower = MacCtx->ParamsDefaults.ChannelsTxPower;
+	MacCtx->Params.ChannelsDatarate = MacCtx->ParamsDefaults.ChannelsDatarate;
+	MacCtx->Params.Rx1DrOffset = MacCtx->ParamsDefaults.Rx1DrOffset;
+	MacCtx->Params.Rx2Channel = MacCtx->ParamsDefaults.Rx2Channel;
+	MacCtx->Params.UplinkDwellTime = MacCtx->ParamsDefaults.UplinkDwellTime;
+	MacCtx->Params.DownlinkDwellTime = MacCtx->ParamsDefaults.DownlinkDwellTime;
+	MacCtx->Params.MaxEirp = MacCtx->ParamsDefaults.MaxEirp;
+	MacCtx->Params.AntennaGain = MacCtx->ParamsDefaults.AntennaGain;
 
 	// Reset to application defaults
-	RegionInitDefaults(LoRaMacRegion, INIT_TYPE_APP_DEFAULTS);
+	RegionInitDefaults(MacCtx->Region, INIT_TYPE_APP_DEFAULTS);
 
-	NodeAckRequested = false;
-	SrvAckRequested = false;
-	MacCommandsInNextTx = false;
+	MacCtx->NodeAckRequested = false;
+	MacCtx->SrvAckRequested = false;
+	MacCtx->MacCommandsInNextTx = false;
 
 	// Reset Multicast downlink counters
-	MulticastParams_t *cur = MulticastChannels;
+	MulticastParams_t *cur = MacCtx->MulticastChannels;
 	while (cur != NULL)
 	{
 		cur->DownLinkCounter = 0;
@@ -2150,49 +2187,49 @@ void ResetMacCounters(void)
 	}
 
 	// Initialize channel index.
-	Channel = 0;
-	LastTxChannel = Channel;
+	MacCtx->Channel = 0;
+	MacCtx->LastTxChannel = MacCtx->Channel;
 }
 
 static void ResetMacParameters(void)
 {
 	// Counters
-	UpLinkCounter = 0;
-	DownLinkCounter = 0;
-	AdrAckCounter = 0;
+	MacCtx->UpLinkCounter = 0;
+	MacCtx->DownLinkCounter = 0;
+	MacCtx->AdrAckCounter = 0;
 
-	ChannelsNbRepCounter = 0;
+	MacCtx->ChannelsNbRepCounter = 0;
 
-	AckTimeoutRetries = 1;
-	AckTimeoutRetriesCounter = 1;
-	AckTimeoutRetry = false;
+	MacCtx->AckTimeoutRetries = 1;
+	MacCtx->AckTimeoutRetriesCounter = 1;
+	MacCtx->AckTimeoutRetry = false;
 
-	MaxDCycle = 0;
-	AggregatedDCycle = 1;
+	MacCtx->MaxDCycle = 0;
+	MacCtx->AggregatedDCycle = 1;
 
-	MacCommandsBufferIndex = 0;
-	MacCommandsBufferToRepeatIndex = 0;
+	MacCtx->MacCommandsBufferIndex = 0;
+	MacCtx->MacCommandsBufferToRepeatIndex = 0;
 
-	IsRxWindowsEnabled = true;
+	MacCtx->IsRxWindowsEnabled = true;
 
-	LoRaMacParams.ChannelsTxPower = LoRaMacParamsDefaults.ChannelsTxPower;
-	LoRaMacParams.ChannelsDatarate = LoRaMacParamsDefaults.ChannelsDatarate;
-	LoRaMacParams.Rx1DrOffset = LoRaMacParamsDefaults.Rx1DrOffset;
-	LoRaMacParams.Rx2Channel = LoRaMacParamsDefaults.Rx2Channel;
-	LoRaMacParams.UplinkDwellTime = LoRaMacParamsDefaults.UplinkDwellTime;
-	LoRaMacParams.DownlinkDwellTime = LoRaMacParamsDefaults.DownlinkDwellTime;
-	LoRaMacParams.MaxEirp = LoRaMacParamsDefaults.MaxEirp;
-	LoRaMacParams.AntennaGain = LoRaMacParamsDefaults.AntennaGain;
+	MacCtx->Params.ChannelsTxPower = MacCtx->ParamsDefaults.ChannelsTxPower;
+	MacCtx->Params.ChannelsDatarate = MacCtx->ParamsDefaults.ChannelsDatarate;
+	MacCtx->Params.Rx1DrOffset = MacCtx->ParamsDefaults.Rx1DrOffset;
+	MacCtx->Params.Rx2Channel = MacCtx->ParamsDefaults.Rx2Channel;
+	MacCtx->Params.UplinkDwellTime = MacCtx->ParamsDefaults.UplinkDwellTime;
+	MacCtx->Params.DownlinkDwellTime = MacCtx->ParamsDefaults.DownlinkDwellTime;
+	MacCtx->Params.MaxEirp = MacCtx->ParamsDefaults.MaxEirp;
+	MacCtx->Params.AntennaGain = MacCtx->ParamsDefaults.AntennaGain;
 
 	// Reset to application defaults
-	RegionInitDefaults(LoRaMacRegion, INIT_TYPE_APP_DEFAULTS);
+	RegionInitDefaults(MacCtx->Region, INIT_TYPE_APP_DEFAULTS);
 
-	NodeAckRequested = false;
-	SrvAckRequested = false;
-	MacCommandsInNextTx = false;
+	MacCtx->NodeAckRequested = false;
+	MacCtx->SrvAckRequested = false;
+	MacCtx->MacCommandsInNextTx = false;
 
 	// Reset Multicast downlink counters
-	MulticastParams_t *cur = MulticastChannels;
+	MulticastParams_t *cur = MacCtx->MulticastChannels;
 	while (cur != NULL)
 	{
 		cur->DownLinkCounter = 0;
@@ -2200,8 +2237,8 @@ static void ResetMacParameters(void)
 	}
 
 	// Initialize channel index.
-	Channel = 0;
-	LastTxChannel = Channel;
+	MacCtx->Channel = 0;
+	MacCtx->LastTxChannel = MacCtx->Channel;
 }
 
 LoRaMacStatus_t PrepareFrame(LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl, uint8_t fPort, void *fBuffer, uint16_t fBufferSize)
@@ -2213,154 +2250,168 @@ LoRaMacStatus_t PrepareFrame(LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl,
 	const void *payload = fBuffer;
 	uint8_t framePort = fPort;
 
-	LoRaMacBufferPktLen = 0;
+	MacCtx->LoRaMacBufferPktLen = 0;
+	MacCtx->TxPayload = NULL;
+	MacCtx->TxPayloadKey = NULL;
+	MacCtx->TxFrameSigned = false;
 
-	NodeAckRequested = false;
+	MacCtx->NodeAckRequested = false;
 
 	if (fBuffer == NULL)
 	{
 		fBufferSize = 0;
 	}
 
-	LoRaMacTxPayloadLen = fBufferSize;
+	MacCtx->LoRaMacTxPayloadLen = fBufferSize;
 
-	LoRaMacBuffer[pktHeaderLen++] = macHdr->Value;
+	MacCtx->TxHeader[pktHeaderLen++] = macHdr->Value;
 
 	switch (macHdr->Bits.MType)
 	{
 	case FRAME_TYPE_JOIN_REQ:
-		LoRaMacBufferPktLen = pktHeaderLen;
+		memcpyr(MacCtx->TxHeader + pktHeaderLen, MacCtx->LoRaMacAppEui, 8);
+		pktHeaderLen += 8;
+		memcpyr(MacCtx->TxHeader + pktHeaderLen, MacCtx->LoRaMacDevEui, 8);
+		pktHeaderLen += 8;
 
-		memcpyr(LoRaMacBuffer + LoRaMacBufferPktLen, LoRaMacAppEui, 8);
-		LoRaMacBufferPktLen += 8;
-		memcpyr(LoRaMacBuffer + LoRaMacBufferPktLen, LoRaMacDevEui, 8);
-		LoRaMacBufferPktLen += 8;
+		MacCtx->LoRaMacDevNonce = Radio.Random();
 
-		LoRaMacDevNonce = Radio.Random();
+		MacCtx->TxHeader[pktHeaderLen++] = MacCtx->LoRaMacDevNonce & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (MacCtx->LoRaMacDevNonce >> 8) & 0xFF;
 
-		LoRaMacBuffer[LoRaMacBufferPktLen++] = LoRaMacDevNonce & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen++] = (LoRaMacDevNonce >> 8) & 0xFF;
-
-		LoRaMacJoinComputeMic(LoRaMacBuffer, LoRaMacBufferPktLen & 0xFF, LoRaMacAppKey, &mic);
+		if (LoRaMacCryptoCtxJoinComputeMic(GetCryptoCtx(), MacCtx->TxHeader, pktHeaderLen, MacCtx->LoRaMacAppKey, &mic) != LORAMAC_CRYPTO_SUCCESS)
+		{
+			return LORAMAC_STATUS_CRYPTO_ERROR;
+		}
 
-		LoRaMacBuffer[LoRaMacBufferPktLen++] = mic & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen++] = (mic >> 8) & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen++] = (mic >> 16) & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen++] = (mic >> 24) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = mic & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (mic >> 8) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (mic >> 16) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (mic >> 24) & 0xFF;
 
+		// The join request is sent as it is
+		MacCtx->LoRaMacTxPayloadLen = 0;
+		MacCtx->TxHeaderLen = pktHeaderLen;
+		MacCtx->LoRaMacBufferPktLen = pktHeaderLen;
 		break;
 	case FRAME_TYPE_DATA_CONFIRMED_UP:
-		NodeAckRequested = true;
+		MacCtx->NodeAckRequested = true;
 		// Intentional fallthrough
 	case FRAME_TYPE_DATA_UNCONFIRMED_UP:
-		if (IsLoRaMacNetworkJoined != JOIN_OK)
+		if (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK)
 		{
 			return LORAMAC_STATUS_NO_NETWORK_JOINED; // No network has been joined yet
 		}
 
+		// The stored ceiling must be above the counter before it is used,
+		// after a reset the counter would be reused otherwise
+		if (NvmCheckpoint() == false)
+		{
+			return LORAMAC_STATUS_NVM_ERROR;
+		}
+
 		// Adr next request
 		adrNext.UpdateChanMask = true;
 		adrNext.AdrEnabled = fCtrl->Bits.Adr;
-		adrNext.AdrAckCounter = AdrAckCounter;
-		adrNext.Datarate = LoRaMacParams.ChannelsDatarate;
-		adrNext.TxPower = LoRaMacParams.ChannelsTxPower;
-		adrNext.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+		adrNext.AdrAckCounter = MacCtx->AdrAckCounter;
+		adrNext.Datarate = MacCtx->Params.ChannelsDatarate;
+		adrNext.TxPower = MacCtx->Params.ChannelsTxPower;
+		adrNext.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
 
-		fCtrl->Bits.AdrAckReq = RegionAdrNext(LoRaMacRegion, &adrNext,
-											  &LoRaMacParams.ChannelsDatarate, &LoRaMacParams.ChannelsTxPower, &AdrAckCounter);
+		fCtrl->Bits.AdrAckReq = RegionAdrNext(MacCtx->Region, &adrNext,
+											  &MacCtx->Params.ChannelsDatarate, &MacCtx->Params.ChannelsTxPower, &MacCtx->AdrAckCounter);
 
-		if (SrvAckRequested == true)
+		if (MacCtx->SrvAckRequested == true)
 		{
-			SrvAckRequested = false;
+			MacCtx->SrvAckRequested = false;
 			fCtrl->Bits.Ack = 1;
 		}
 
-		LoRaMacBuffer[pktHeaderLen++] = (LoRaMacDevAddr) & 0xFF;
-		LoRaMacBuffer[pktHeaderLen++] = (LoRaMacDevAddr >> 8) & 0xFF;
-		LoRaMacBuffer[pktHeaderLen++] = (LoRaMacDevAddr >> 16) & 0xFF;
-		LoRaMacBuffer[pktHeaderLen++] = (LoRaMacDevAddr >> 24) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (MacCtx->DevAddr) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (MacCtx->DevAddr >> 8) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (MacCtx->DevAddr >> 16) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (MacCtx->DevAddr >> 24) & 0xFF;
 
-		LoRaMacBuffer[pktHeaderLen++] = fCtrl->Value;
+		MacCtx->TxHeader[pktHeaderLen++] = fCtrl->Value;
 
-		LoRaMacBuffer[pktHeaderLen++] = UpLinkCounter & 0xFF;
-		LoRaMacBuffer[pktHeaderLen++] = (UpLinkCounter >> 8) & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = MacCtx->UpLinkCounter & 0xFF;
+		MacCtx->TxHeader[pktHeaderLen++] = (MacCtx->UpLinkCounter >> 8) & 0xFF;
 
 		// Copy the MAC commands which must be re-send into the MAC command buffer
-		memcpy1(&MacCommandsBuffer[MacCommandsBufferIndex], MacCommandsBufferToRepeat, MacCommandsBufferToRepeatIndex);
-		MacCommandsBufferIndex += MacCommandsBufferToRepeatIndex;
+		memcpy1(&MacCtx->MacCommandsBuffer[MacCtx->MacCommandsBufferIndex], MacCtx->MacCommandsBufferToRepeat, MacCtx->MacCommandsBufferToRepeatIndex);
+		MacCtx->MacCommandsBufferIndex += MacCtx->MacCommandsBufferToRepeatIndex;
 
-		if ((payload != NULL) && (LoRaMacTxPayloadLen > 0))
+		if ((payload != NULL) && (MacCtx->LoRaMacTxPayloadLen > 0))
 		{
-			if (MacCommandsInNextTx == true)
+			if (MacCtx->MacCommandsInNextTx == true)
 			{
-				if (MacCommandsBufferIndex <= LORA_MAC_COMMAND_MAX_FOPTS_LENGTH)
+				if (MacCtx->MacCommandsBufferIndex <= LORA_MAC_COMMAND_MAX_FOPTS_LENGTH)
 				{
-					fCtrl->Bits.FOptsLen += MacCommandsBufferIndex;
+					fCtrl->Bits.FOptsLen += MacCtx->MacCommandsBufferIndex;
 
 					// Update FCtrl field with new value of OptionsLength
-					LoRaMacBuffer[0x05] = fCtrl->Value;
-					for (i = 0; i < MacCommandsBufferIndex; i++)
+					MacCtx->TxHeader[0x05] = fCtrl->Value;
+					for (i = 0; i < MacCtx->MacCommandsBufferIndex; i++)
 					{
-						LoRaMacBuffer[pktHeaderLen++] = MacCommandsBuffer[i];
+						MacCtx->TxHeader[pktHeaderLen++] = MacCtx->MacCommandsBuffer[i];
 					}
 				}
 				else
 				{
-					LoRaMacTxPayloadLen = MacCommandsBufferIndex;
-					payload = MacCommandsBuffer;
+					MacCtx->LoRaMacTxPayloadLen = MacCtx->MacCommandsBufferIndex;
+					payload = MacCtx->MacCommandsBuffer;
 					framePort = 0;
 				}
 			}
 		}
 		else
 		{
-			if ((MacCommandsBufferIndex > 0) && (MacCommandsInNextTx == true))
+			if ((MacCtx->MacCommandsBufferIndex > 0) && (MacCtx->MacCommandsInNextTx == true))
 			{
-				LoRaMacTxPayloadLen = MacCommandsBufferIndex;
-				payload = MacCommandsBuffer;
+				MacCtx->LoRaMacTxPayloadLen = MacCtx->MacCommandsBufferIndex;
+				payload = MacCtx->MacCommandsBuffer;
 				framePort = 0;
 			}
 		}
-		MacCommandsInNextTx = false;
+		MacCtx->MacCommandsInNextTx = false;
 		// Store MAC commands which must be re-send in case the device does not receive a downlink anymore
-		MacCommandsBufferToRepeatIndex = ParseMacCommandsToRepeat(MacCommandsBuffer, MacCommandsBufferIndex, MacCommandsBufferToRepeat);
-		if (MacCommandsBufferToRepeatIndex > 0)
+		MacCtx->MacCommandsBufferToRepeatIndex = ParseMacCommandsToRepeat(MacCtx->MacCommandsBuffer, MacCtx->MacCommandsBufferIndex, MacCtx->MacCommandsBufferToRepeat);
+		if (MacCtx->MacCommandsBufferToRepeatIndex > 0)
 		{
-			MacCommandsInNextTx = true;
+			MacCtx->MacCommandsInNextTx = true;
 		}
 
-		if ((payload != NULL) && (LoRaMacTxPayloadLen > 0))
+		if ((payload != NULL) && (MacCtx->LoRaMacTxPayloadLen > 0))
 		{
-			LoRaMacBuffer[pktHeaderLen++] = framePort;
+			MacCtx->TxHeader[pktHeaderLen++] = framePort;
 
+			SetTxPayload(payload, MacCtx->LoRaMacTxPayloadLen, framePort == 0);
 			if (framePort == 0)
 			{
 				// Reset buffer index as the mac commands are being sent on port 0
-				MacCommandsBufferIndex = 0;
-				LoRaMacPayloadEncrypt((uint8_t *)payload, LoRaMacTxPayloadLen, LoRaMacNwkSKey, LoRaMacDevAddr, UP_LINK, UpLinkCounter, &LoRaMacBuffer[pktHeaderLen]);
+				MacCtx->MacCommandsBufferIndex = 0;
+				MacCtx->TxPayloadKey = MacCtx->NwkSKey;
 			}
 			else
 			{
-				LoRaMacPayloadEncrypt((uint8_t *)payload, LoRaMacTxPayloadLen, LoRaMacAppSKey, LoRaMacDevAddr, UP_LINK, UpLinkCounter, &LoRaMacBuffer[pktHeaderLen]);
+				MacCtx->TxPayloadKey = MacCtx->AppSKey;
 			}
 		}
-		LoRaMacBufferPktLen = pktHeaderLen + LoRaMacTxPayloadLen;
-
-		LoRaMacComputeMic(LoRaMacBuffer, LoRaMacBufferPktLen, LoRaMacNwkSKey, LoRaMacDevAddr, UP_LINK, UpLinkCounter, &mic);
-
-		LoRaMacBuffer[LoRaMacBufferPktLen + 0] = mic & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen + 1] = (mic >> 8) & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen + 2] = (mic >> 16) & 0xFF;
-		LoRaMacBuffer[LoRaMacBufferPktLen + 3] = (mic >> 24) & 0xFF;
-
-		LoRaMacBufferPktLen += LORAMAC_MFR_LEN;
+		else
+		{
+			MacCtx->TxPayloadKey = MacCtx->AppSKey;
+		}
+		// The FRMPayload is encrypted and the MIC computed by SendTxFrame
+		MacCtx->TxHeaderLen = pktHeaderLen;
+		MacCtx->LoRaMacBufferPktLen = pktHeaderLen + MacCtx->LoRaMacTxPayloadLen + LORAMAC_MFR_LEN;
 
 		break;
 	case FRAME_TYPE_PROPRIETARY:
-		if ((fBuffer != NULL) && (LoRaMacTxPayloadLen > 0))
+		MacCtx->TxHeaderLen = pktHeaderLen;
+		if ((fBuffer != NULL) && (MacCtx->LoRaMacTxPayloadLen > 0))
 		{
-			memcpy1(LoRaMacBuffer + pktHeaderLen, (uint8_t *)fBuffer, LoRaMacTxPayloadLen);
-			LoRaMacBufferPktLen = pktHeaderLen + LoRaMacTxPayloadLen;
+			SetTxPayload(fBuffer, MacCtx->LoRaMacTxPayloadLen, false);
+			MacCtx->LoRaMacBufferPktLen = pktHeaderLen + MacCtx->LoRaMacTxPayloadLen;
 		}
 		break;
 	default:
@@ -2376,44 +2427,115 @@ LoRaMacStatus_t SendFrameOnChannel(uint8_t channel)
 	int8_t txPower = 0;
 
 	txConfig.Channel = channel;
-	txConfig.Datarate = LoRaMacParams.ChannelsDatarate;
-	txConfig.TxPower = LoRaMacParams.ChannelsTxPower;
-	txConfig.MaxEirp = LoRaMacParams.MaxEirp;
-	txConfig.AntennaGain = LoRaMacParams.AntennaGain;
-	txConfig.PktLen = LoRaMacBufferPktLen;
+	txConfig.Datarate = MacCtx->Params.ChannelsDatarate;
+	txConfig.TxPower = MacCtx->Params.ChannelsTxPower;
+	txConfig.MaxEirp = MacCtx->Params.MaxEirp;
+	txConfig.AntennaGain = MacCtx->Params.AntennaGain;
+	txConfig.PktLen = MacCtx->LoRaMacBufferPktLen;
 
 	// If we are connecting to a single channel gateway we use always the same predefined channel and datarate
-	if (singleChannelGateway)
+	if ((singleChannelGateway) && (MacCtx == &DefaultContext))
 	{
 		txConfig.Channel = singleChannelSelected;
 		txConfig.Datarate = singleChannelDatarate;
 	}
 
-	RegionTxConfig(LoRaMacRegion, &txConfig, &txPower, &TxTimeOnAir);
+	RegionTxConfig(MacCtx->Region, &txConfig, &txPower, &MacCtx->TxTimeOnAir);
 
-	MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
-	McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
-	McpsConfirm.Datarate = LoRaMacParams.ChannelsDatarate;
-	McpsConfirm.TxPower = txPower;
+	MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+	MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+	MacCtx->McpsConfirm.Datarate = MacCtx->Params.ChannelsDatarate;
+	MacCtx->McpsConfirm.TxPower = txPower;
 
 	// Store the time on air
-	McpsConfirm.TxTimeOnAir = TxTimeOnAir;
-	MlmeConfirm.TxTimeOnAir = TxTimeOnAir;
+	MacCtx->McpsConfirm.TxTimeOnAir = MacCtx->TxTimeOnAir;
+	MacCtx->MlmeConfirm.TxTimeOnAir = MacCtx->TxTimeOnAir;
 
 	// Starts the MAC layer status check timer
-	TimerSetValue(&MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
-	TimerStart(&MacStateCheckTimer);
+	TimerSetValue(&MacCtx->MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
+	TimerStart(&MacCtx->MacStateCheckTimer);
 
-	if (IsLoRaMacNetworkJoined != JOIN_OK)
+	if (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK)
 	{
-		JoinRequestTrials++;
+		MacCtx->JoinRequestTrials++;
 	}
 
 	// Send now
-	Radio.Send(LoRaMacBuffer, LoRaMacBufferPktLen);
+	if (SendTxFrame() != LORAMAC_STATUS_OK)
+	{
+		TimerStop(&MacCtx->MacStateCheckTimer);
+		return LORAMAC_STATUS_CRYPTO_ERROR;
+	}
+
+	MacCtx->State |= LORAMAC_TX_RUNNING;
+
+	return LORAMAC_STATUS_OK;
+}
+
+static void SetTxPayload(const uint8_t *payload, uint8_t size, bool isMacCommands)
+{
+#if (LORAMAC_ZERO_COPY_TX == 1)
+	if (isMacCommands == false)
+	{
+		// Read again from the buffer of the request on every transmission
+		MacCtx->TxPayload = payload;
+		return;
+	}
+#else
+	(void)isMacCommands;
+#endif
+	// MAC commands may be added to the MAC command buffer before a
+	// retransmission of the frame
+	memcpy1(MacCtx->TxPayloadBuffer, payload, size);
+	MacCtx->TxPayload = MacCtx->TxPayloadBuffer;
+}
 
-	LoRaMacState |= LORAMAC_TX_RUNNING;
+static void WriteTxFrame(uint8_t offset, const uint8_t *buffer, uint8_t size)
+{
+	Radio.WriteTxBuffer(offset, buffer, size);
+	if (offset == (MacCtx->TxHeaderLen + MacCtx->LoRaMacTxPayloadLen))
+	{
+		memcpy1(MacCtx->TxMic, buffer, 4);
+	}
+	else if ((offset >= MacCtx->TxHeaderLen) && (MacCtx->TxPayload == MacCtx->TxPayloadBuffer))
+	{
+		// The clear chunk has been read, it is replaced by the encrypted one
+		memcpy1(MacCtx->TxPayloadBuffer + offset - MacCtx->TxHeaderLen, buffer, size);
+	}
+}
 
+static LoRaMacStatus_t SendTxFrame(void)
+{
+	if (MacCtx->TxFrameSigned == true)
+	{
+		// Retransmission, the frame is unchanged
+		Radio.WriteTxBuffer(0, MacCtx->TxHeader, MacCtx->TxHeaderLen);
+		if (MacCtx->LoRaMacTxPayloadLen > 0)
+		{
+			Radio.WriteTxBuffer(MacCtx->TxHeaderLen, MacCtx->TxPayloadBuffer, MacCtx->LoRaMacTxPayloadLen);
+		}
+		Radio.WriteTxBuffer(MacCtx->TxHeaderLen + MacCtx->LoRaMacTxPayloadLen, MacCtx->TxMic, 4);
+	}
+	else if ((MacCtx->TxPayloadKey != NULL) && (MacCtx->LoRaMacBufferPktLen > 0))
+	{
+		if (LoRaMacCryptoCtxEncryptAndSign(GetCryptoCtx(), MacCtx->TxHeader, MacCtx->TxHeaderLen, MacCtx->TxPayload, MacCtx->LoRaMacTxPayloadLen,
+										   MacCtx->NwkSKey, MacCtx->TxPayloadKey, MacCtx->DevAddr, UP_LINK, MacCtx->UpLinkCounter, WriteTxFrame) != LORAMAC_CRYPTO_SUCCESS)
+		{
+			return LORAMAC_STATUS_CRYPTO_ERROR;
+		}
+		// With LORAMAC_ZERO_COPY_TX the FRMPayload of the request is left
+		// in clear and encrypted again
+		MacCtx->TxFrameSigned = (MacCtx->TxPayload == MacCtx->TxPayloadBuffer) || (MacCtx->LoRaMacTxPayloadLen == 0);
+	}
+	else if (MacCtx->LoRaMacBufferPktLen > 0)
+	{
+		Radio.WriteTxBuffer(0, MacCtx->TxHeader, MacCtx->TxHeaderLen);
+		if (MacCtx->LoRaMacTxPayloadLen > 0)
+		{
+			Radio.WriteTxBuffer(MacCtx->TxHeaderLen, MacCtx->TxPayload, MacCtx->LoRaMacTxPayloadLen);
+		}
+	}
+	Radio.SendTxBuffer(MacCtx->LoRaMacBufferPktLen);
 	return LORAMAC_STATUS_OK;
 }
 
@@ -2421,20 +2543,20 @@ LoRaMacStatus_t SetTxContinuousWave(uint16_t timeout)
 {
 	ContinuousWaveParams_t continuousWave;
 
-	continuousWave.Channel = Channel;
-	continuousWave.Datarate = LoRaMacParams.ChannelsDatarate;
-	continuousWave.TxPower = LoRaMacParams.ChannelsTxPower;
-	continuousWave.MaxEirp = LoRaMacParams.MaxEirp;
-	continuousWave.AntennaGain = LoRaMacParams.AntennaGain;
+	continuousWave.Channel = MacCtx->Channel;
+	continuousWave.Datarate = MacCtx->Params.ChannelsDatarate;
+	continuousWave.TxPower = MacCtx->Params.ChannelsTxPower;
+	continuousWave.MaxEirp = MacCtx->Params.MaxEirp;
+	continuousWave.AntennaGain = MacCtx->Params.AntennaGain;
 	continuousWave.Timeout = timeout;
 
-	RegionSetContinuousWave(LoRaMacRegion, &continuousWave);
+	RegionSetContinuousWave(MacCtx->Region, &continuousWave);
 
 	// Starts the MAC layer status check timer
-	TimerSetValue(&MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
-	TimerStart(&MacStateCheckTimer);
+	TimerSetValue(&MacCtx->MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
+	TimerStart(&MacCtx->MacStateCheckTimer);
 
-	LoRaMacState |= LORAMAC_TX_RUNNING;
+	MacCtx->State |= LORAMAC_TX_RUNNING;
 
 	return LORAMAC_STATUS_OK;
 }
@@ -2444,20 +2566,22 @@ LoRaMacStatus_t SetTxContinuousWave1(uint16_t timeout, uint32_t frequency, uint8
 	Radio.SetTxContinuousWave(frequency, power, timeout);
 
 	// Starts the MAC layer status check timer
-	TimerSetValue(&MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
-	TimerStart(&MacStateCheckTimer);
+	TimerSetValue(&MacCtx->MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
+	TimerStart(&MacCtx->MacStateCheckTimer);
 
-	LoRaMacState |= LORAMAC_TX_RUNNING;
+	MacCtx->State |= LORAMAC_TX_RUNNING;
 
 	return LORAMAC_STATUS_OK;
 }
 
 // LoRaMacStatus_t LoRaMacInitialization(LoRaMacPrimitives_t *primitives, LoRaMacCallback_t *callbacks, LoRaMacRegion_t region, eDeviceClass nodeClass, bool region_change)
-LoRaMacStatus_t LoRaMacInitialization(const LoRaMacInitParams_t *params)
+LoRaMacStatus_t LoRaMacCtxInitialization(LoRaMacContext_t *ctx, const LoRaMacInitParams_t *params)
 {
 	GetPhyParams_t getPhy;
 	PhyParam_t phyParam;
 
+	SetContext(ctx);
+
 	if (params->primitives == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
@@ -2475,116 +2599,118 @@ LoRaMacStatus_t LoRaMacInitialization(const LoRaMacInitParams_t *params)
 		return LORAMAC_STATUS_REGION_NOT_SUPPORTED;
 	}
 
-	LoRaMacPrimitives = params->primitives;
-	LoRaMacCallbacks = params->callbacks;
-	LoRaMacRegion = params->Region;
+	MacCtx->LoRaMacPrimitives = params->primitives;
+	MacCtx->LoRaMacCallbacks = params->callbacks;
+	MacCtx->Region = params->Region;
 
-	LoRaMacFlags.Value = 0;
+	MacCtx->LoRaMacFlags.Value = 0;
 
-	LoRaMacDeviceClass = params->nodeClass;
-	LoRaMacState = LORAMAC_IDLE;
+	MacCtx->LoRaMacDeviceClass = params->nodeClass;
+	MacCtx->State = LORAMAC_IDLE;
 
-	JoinRequestTrials = 0;
-	MaxJoinRequestTrials = 1;
-	RepeaterSupport = false;
+	MacCtx->JoinRequestTrials = 0;
+	MacCtx->MaxJoinRequestTrials = 1;
+	MacCtx->RepeaterSupport = false;
 
 	// Reset duty cycle times
-	AggregatedLastTxDoneTime = 0;
-	AggregatedTimeOff = 0;
+	MacCtx->AggregatedLastTxDoneTime = 0;
+	MacCtx->AggregatedTimeOff = 0;
 
 	// Reset to defaults
 	getPhy.Attribute = PHY_DUTY_CYCLE;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	DutyCycleOn = (bool)phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->DutyCycleOn = (bool)phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_TX_POWER;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.ChannelsTxPower = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.ChannelsTxPower = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_TX_DR;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.ChannelsDatarate = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.ChannelsDatarate = phyParam.Value;
 
 	getPhy.Attribute = PHY_MAX_RX_WINDOW;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.MaxRxWindow = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.MaxRxWindow = phyParam.Value;
 
 	getPhy.Attribute = PHY_RECEIVE_DELAY1;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.ReceiveDelay1 = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.ReceiveDelay1 = phyParam.Value;
 
 	getPhy.Attribute = PHY_RECEIVE_DELAY2;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.ReceiveDelay2 = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.ReceiveDelay2 = phyParam.Value;
 
 	getPhy.Attribute = PHY_JOIN_ACCEPT_DELAY1;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.JoinAcceptDelay1 = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.JoinAcceptDelay1 = phyParam.Value;
 
 	getPhy.Attribute = PHY_JOIN_ACCEPT_DELAY2;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.JoinAcceptDelay2 = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.JoinAcceptDelay2 = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_DR1_OFFSET;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.Rx1DrOffset = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.Rx1DrOffset = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_RX2_FREQUENCY;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.Rx2Channel.Frequency = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.Rx2Channel.Frequency = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_RX2_DR;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.Rx2Channel.Datarate = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.Rx2Channel.Datarate = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_UPLINK_DWELL_TIME;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.UplinkDwellTime = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.UplinkDwellTime = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_DOWNLINK_DWELL_TIME;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.DownlinkDwellTime = phyParam.Value;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.DownlinkDwellTime = phyParam.Value;
 
 	getPhy.Attribute = PHY_DEF_MAX_EIRP;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.MaxEirp = phyParam.fValue;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.MaxEirp = phyParam.fValue;
 
 	getPhy.Attribute = PHY_DEF_ANTENNA_GAIN;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
-	LoRaMacParamsDefaults.AntennaGain = phyParam.fValue;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
+	MacCtx->ParamsDefaults.AntennaGain = phyParam.fValue;
 
-	RegionInitDefaults(LoRaMacRegion, INIT_TYPE_INIT);
+	RegionInitDefaults(MacCtx->Region, INIT_TYPE_INIT);
 
 	// Init parameters which are not set in function ResetMacParameters
-	LoRaMacParamsDefaults.ChannelsNbRep = 1;
-	LoRaMacParamsDefaults.SystemMaxRxError = 10;
-	LoRaMacParamsDefaults.MinRxSymbols = 6;
-
-	LoRaMacParams.SystemMaxRxError = LoRaMacParamsDefaults.SystemMaxRxError;
-	LoRaMacParams.MinRxSymbols = LoRaMacParamsDefaults.MinRxSymbols;
-	LoRaMacParams.MaxRxWindow = LoRaMacParamsDefaults.MaxRxWindow;
-	LoRaMacParams.ReceiveDelay1 = LoRaMacParamsDefaults.ReceiveDelay1;
-	LoRaMacParams.ReceiveDelay2 = LoRaMacParamsDefaults.ReceiveDelay2;
-	LoRaMacParams.JoinAcceptDelay1 = LoRaMacParamsDefaults.JoinAcceptDelay1;
-	LoRaMacParams.JoinAcceptDelay2 = LoRaMacParamsDefaults.JoinAcceptDelay2;
-	LoRaMacParams.ChannelsNbRep = LoRaMacParamsDefaults.ChannelsNbRep;
+	MacCtx->ParamsDefaults.ChannelsNbRep = 1;
+	MacCtx->ParamsDefaults.SystemMaxRxError = 10;
+	MacCtx->ParamsDefaults.MinRxSymbols = 6;
+
+	MacCtx->Params.SystemMaxRxError = MacCtx->ParamsDefaults.SystemMaxRxError;
+	MacCtx->Params.MinRxSymbols = MacCtx->ParamsDefaults.MinRxSymbols;
+	MacCtx->Params.MaxRxWindow = MacCtx->ParamsDefaults.MaxRxWindow;
+	MacCtx->Params.ReceiveDelay1 = MacCtx->ParamsDefaults.ReceiveDelay1;
+	MacCtx->Params.ReceiveDelay2 = MacCtx->ParamsDefaults.ReceiveDelay2;
+	MacCtx->Params.JoinAcceptDelay1 = MacCtx->ParamsDefaults.JoinAcceptDelay1;
+	MacCtx->Params.JoinAcceptDelay2 = MacCtx->ParamsDefaults.JoinAcceptDelay2;
+	MacCtx->Params.ChannelsNbRep = MacCtx->ParamsDefaults.ChannelsNbRep;
 
 	ResetMacParameters();
 
 	if (!params->region_change)
 	{
 		// Initialize timers
-		TimerInit(&MacStateCheckTimer, OnMacStateCheckTimerEvent);
-		TimerSetValue(&MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
+		TimerInit(&MacCtx->MacStateCheckTimer, OnMacStateCheckTimerEvent);
+		TimerSetValue(&MacCtx->MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT);
 
-		TimerInit(&TxDelayedTimer, OnTxDelayedTimerEvent);
-		TimerInit(&RxWindowTimer1, OnRxWindow1TimerEvent);
-		TimerInit(&RxWindowTimer2, OnRxWindow2TimerEvent);
-		TimerInit(&AckTimeoutTimer, OnAckTimeoutTimerEvent);
+		TimerInit(&MacCtx->TxDelayedTimer, OnTxDelayedTimerEvent);
+		TimerInit(&MacCtx->RxWindowTimer1, OnRxWindow1TimerEvent);
+		TimerInit(&MacCtx->RxWindowTimer2, OnRxWindow2TimerEvent);
+		TimerInit(&MacCtx->AckTimeoutTimer, OnAckTimeoutTimerEvent);
 
 		// Store the current initialization time
-		LoRaMacInitializationTime = TimerGetCurrentTime();
+		MacCtx->LoRaMacInitializationTime = TimerGetCurrentTime();
 	}
+	// The bands of another region start with an empty ledger
+	LoRaMacAirtimeInit(&MacCtx->Airtime, TimerGetCurrentTime());
 
 	// Initialize Radio driver
 	RadioEvents.TxDone = OnRadioTxDone;
@@ -2598,34 +2724,42 @@ LoRaMacStatus_t LoRaMacInitialization(const LoRaMacInitParams_t *params)
 	srand1(Radio.Random());
 
 	// PublicNetwork = true;
-	Radio.SetPublicNetwork(PublicNetwork);
+	Radio.SetPublicNetwork(MacCtx->PublicNetwork);
 
 	// Putting the RegionTxConfig here makes the OTAA join more stable
 	TxConfigParams_t txConfig;
 	int8_t txPower = 0;
 
 	txConfig.Channel = 0;
-	txConfig.Datarate = LoRaMacParams.ChannelsDatarate;
-	txConfig.TxPower = LoRaMacParams.ChannelsTxPower;
-	txConfig.MaxEirp = LoRaMacParams.MaxEirp;
-	txConfig.AntennaGain = LoRaMacParams.AntennaGain;
-	txConfig.PktLen = LoRaMacBufferPktLen;
+	txConfig.Datarate = MacCtx->Params.ChannelsDatarate;
+	txConfig.TxPower = MacCtx->Params.ChannelsTxPower;
+	txConfig.MaxEirp = MacCtx->Params.MaxEirp;
+	txConfig.AntennaGain = MacCtx->Params.AntennaGain;
+	txConfig.PktLen = MacCtx->LoRaMacBufferPktLen;
 
-	RegionTxConfig(LoRaMacRegion, &txConfig, &txPower, &TxTimeOnAir);
+	RegionTxConfig(MacCtx->Region, &txConfig, &txPower, &MacCtx->TxTimeOnAir);
 
 	Radio.Sleep();
 
+	MacCtx->Initialized = true;
+
 	return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo)
+LoRaMacStatus_t LoRaMacCtxQueryTxPossible(LoRaMacContext_t *ctx, uint8_t size, LoRaMacTxInfo_t *txInfo)
 {
 	AdrNextParams_t adrNext;
 	GetPhyParams_t getPhy;
 	PhyParam_t phyParam;
-	int8_t datarate = LoRaMacParamsDefaults.ChannelsDatarate;
-	int8_t txPower = LoRaMacParamsDefaults.ChannelsTxPower;
-	uint8_t fOptLen = MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex;
+	int8_t datarate;
+	int8_t txPower;
+	uint8_t fOptLen;
+
+	SetContext(ctx);
+
+	datarate = MacCtx->ParamsDefaults.ChannelsDatarate;
+	txPower = MacCtx->ParamsDefaults.ChannelsTxPower;
+	fOptLen = MacCtx->MacCommandsBufferIndex + MacCtx->MacCommandsBufferToRepeatIndex;
 
 	if (txInfo == NULL)
 	{
@@ -2634,27 +2768,27 @@ LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo)
 
 	// Setup ADR request
 	adrNext.UpdateChanMask = false;
-	adrNext.AdrEnabled = AdrCtrlOn;
-	adrNext.AdrAckCounter = AdrAckCounter;
-	adrNext.Datarate = LoRaMacParams.ChannelsDatarate;
-	adrNext.TxPower = LoRaMacParams.ChannelsTxPower;
-	adrNext.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+	adrNext.AdrEnabled = MacCtx->AdrCtrlOn;
+	adrNext.AdrAckCounter = MacCtx->AdrAckCounter;
+	adrNext.Datarate = MacCtx->Params.ChannelsDatarate;
+	adrNext.TxPower = MacCtx->Params.ChannelsTxPower;
+	adrNext.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
 
 	// We call the function for information purposes only. We don't want to
 	// apply the datarate, the tx power and the ADR ack counter.
-	RegionAdrNext(LoRaMacRegion, &adrNext, &datarate, &txPower, &AdrAckCounter);
+	RegionAdrNext(MacCtx->Region, &adrNext, &datarate, &txPower, &MacCtx->AdrAckCounter);
 
 	// Setup PHY request
-	getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+	getPhy.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
 	getPhy.Datarate = datarate;
 	getPhy.Attribute = PHY_MAX_PAYLOAD;
 
 	// Change request in case repeater is supported
-	if (RepeaterSupport == true)
+	if (MacCtx->RepeaterSupport == true)
 	{
 		getPhy.Attribute = PHY_MAX_PAYLOAD_REPEATER;
 	}
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 	txInfo->CurrentPayloadSize = phyParam.Value;
 
 	// Verify if the fOpts fit into the maximum payload
@@ -2669,8 +2803,8 @@ LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo)
 		// The fOpts don't fit into the maximum payload. Omit the MAC commands to
 		// ensure that another uplink is possible.
 		fOptLen = 0;
-		MacCommandsBufferIndex = 0;
-		MacCommandsBufferToRepeatIndex = 0;
+		MacCtx->MacCommandsBufferIndex = 0;
+		MacCtx->MacCommandsBufferToRepeatIndex = 0;
 	}
 
 	// Verify if the fOpts and the payload fit into the maximum payload
@@ -2683,12 +2817,157 @@ LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo)
 	return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
+LoRaMacStatus_t LoRaMacCtxPrecomputeUplink(LoRaMacContext_t *ctx, uint8_t fPort, uint8_t size)
+{
+	uint8_t fOptsLen = 0;
+	uint8_t macCommandsLen;
+
+	SetContext(ctx);
+
+	macCommandsLen = MacCtx->MacCommandsBufferIndex + MacCtx->MacCommandsBufferToRepeatIndex;
+
+	if (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK)
+	{
+		return LORAMAC_STATUS_NO_NETWORK_JOINED;
+	}
+	if (MacCtx->State != LORAMAC_IDLE)
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
+
+	// Predict the frame layout the same way as PrepareFrame
+	if (MacCtx->MacCommandsInNextTx == true)
+	{
+		if ((size > 0) && (macCommandsLen <= LORA_MAC_COMMAND_MAX_FOPTS_LENGTH))
+		{
+			fOptsLen = macCommandsLen;
+		}
+		else if (macCommandsLen > 0)
+		{
+			fPort = 0;
+			size = macCommandsLen;
+		}
+	}
+
+	// MHDR(1) + FHDR(7 + FOpts) + Port(1) + FRMPayload
+	LoRaMacCryptoCtxPrecompute(GetCryptoCtx(), MacCtx->NwkSKey, (fPort == 0) ? MacCtx->NwkSKey : MacCtx->AppSKey, MacCtx->DevAddr, UP_LINK, MacCtx->UpLinkCounter,
+					  8 + fOptsLen + ((size > 0) ? (1 + size) : 0), size);
+
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacCtxQueryTxDelay(LoRaMacContext_t *ctx, TimerTime_t *delay)
+{
+	LoRaMacAirtimeNextTxParams_t airtimeNextTx;
+	TimerTime_t now;
+
+	SetContext(ctx);
+
+	if (delay == NULL)
+	{
+		return LORAMAC_STATUS_PARAMETER_INVALID;
+	}
+	if (MacCtx->State != LORAMAC_IDLE)
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
+	if (MacCtx->MaxDCycle == 255)
+	{
+		return LORAMAC_STATUS_DEVICE_OFF;
+	}
+
+	// The band time off of the last uplink is read from the airtime ledger,
+	// the aggregated time off from the MAC. Unlike ScheduleTx, neither the
+	// back-off nor the channel selection state of the region are touched.
+	GetAirtimeChannels(&airtimeNextTx);
+	airtimeNextTx.Datarate = MacCtx->Params.ChannelsDatarate;
+	airtimeNextTx.TimeOnAir = 0;
+	now = TimerGetCurrentTime();
+
+	*delay = LoRaMacAirtimeGetNextTx(&MacCtx->Airtime, &airtimeNextTx, now);
+	if (*delay == LORAMAC_AIRTIME_NO_TX)
+	{
+		// The MAC falls back to the default datarate
+		airtimeNextTx.Datarate = MacCtx->ParamsDefaults.ChannelsDatarate;
+		*delay = LoRaMacAirtimeGetNextTx(&MacCtx->Airtime, &airtimeNextTx, now);
+	}
+	if (*delay == LORAMAC_AIRTIME_NO_TX)
+	{
+		*delay = 0;
+	}
+
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacCtxRestoreSession(LoRaMacContext_t *ctx, struct sLoRaMacNvm *nvm)
+{
+	SetContext(ctx);
+
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
+	MacCtx->Nvm = nvm;
+	MacCtx->NvmSessionChanged = false;
+	if ((nvm == NULL) || (LoRaMacNvmReadSession(nvm, &NvmSession) != LORAMAC_NVM_SUCCESS) ||
+		(NvmSession.Region != MacCtx->Region))
+	{
+		return LORAMAC_STATUS_NO_NETWORK_JOINED;
+	}
+
+	LoRaMacCryptoCtxInvalidateKey(GetCryptoCtx(), MacCtx->NwkSKey);
+	LoRaMacCryptoCtxInvalidateKey(GetCryptoCtx(), MacCtx->AppSKey);
+	MacCtx->DevAddr = NvmSession.DevAddr;
+	MacCtx->LoRaMacNetID = NvmSession.NetID;
+	memcpy1(MacCtx->NwkSKey, NvmSession.NwkSKey, sizeof(MacCtx->NwkSKey));
+	memcpy1(MacCtx->AppSKey, NvmSession.AppSKey, sizeof(MacCtx->AppSKey));
+	// Ceiling of the counters used before the reset
+	MacCtx->UpLinkCounter = NvmSession.UpLinkCounter;
+	MacCtx->DownLinkCounter = NvmSession.DownLinkCounter;
+	MacCtx->AdrCtrlOn = NvmSession.AdrCtrlOn;
+	MacCtx->MaxDCycle = NvmSession.MaxDCycle;
+	MacCtx->AggregatedDCycle = NvmSession.AggregatedDCycle;
+	MacCtx->Params = NvmSession.Params;
+
+	RegionSaveContext(MacCtx->Region, &MacCtx->RegionContext);
+	memcpy1((uint8_t *)MacCtx->RegionContext.Channels, (uint8_t *)NvmSession.Channels, sizeof(NvmSession.Channels));
+	memcpy1((uint8_t *)MacCtx->RegionContext.ChannelsMask, (uint8_t *)NvmSession.ChannelsMask, sizeof(NvmSession.ChannelsMask));
+	memcpy1((uint8_t *)MacCtx->RegionContext.ChannelsMaskRemaining, (uint8_t *)NvmSession.ChannelsMask, sizeof(NvmSession.ChannelsMask));
+	memcpy1((uint8_t *)MacCtx->RegionContext.ChannelsDefaultMask, (uint8_t *)NvmSession.ChannelsDefaultMask, sizeof(NvmSession.ChannelsDefaultMask));
+	RegionRestoreContext(MacCtx->Region, &MacCtx->RegionContext);
+
+	MacCtx->IsLoRaMacNetworkJoined = JOIN_OK;
+	LOG_LIB("LM", "Session restored, DevAddr %08lX FCntUp %lu", (unsigned long)MacCtx->DevAddr, (unsigned long)MacCtx->UpLinkCounter);
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacCtxStoreSession(LoRaMacContext_t *ctx)
+{
+	SetContext(ctx);
+
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	{
+		return LORAMAC_STATUS_BUSY;
+	}
+	if (MacCtx->IsLoRaMacNetworkJoined != JOIN_OK)
+	{
+		return LORAMAC_STATUS_NO_NETWORK_JOINED;
+	}
+	if (NvmStoreSession() == false)
+	{
+		return LORAMAC_STATUS_PARAMETER_INVALID;
+	}
+	return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacCtxMibGetRequestConfirm(LoRaMacContext_t *ctx, MibRequestConfirm_t *mibGet)
 {
 	LoRaMacStatus_t status = LORAMAC_STATUS_OK;
 	GetPhyParams_t getPhy;
 	PhyParam_t phyParam;
 
+	SetContext(ctx);
+
 	if (mibGet == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
@@ -2698,71 +2977,71 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
 	{
 	case MIB_DEVICE_CLASS:
 	{
-		mibGet->Param.Class = LoRaMacDeviceClass;
+		mibGet->Param.Class = MacCtx->LoRaMacDeviceClass;
 		break;
 	}
 	case MIB_NETWORK_JOINED:
 	{
-		mibGet->Param.IsNetworkJoined = IsLoRaMacNetworkJoined;
+		mibGet->Param.IsNetworkJoined = MacCtx->IsLoRaMacNetworkJoined;
 		break;
 	}
 	case MIB_ADR:
 	{
-		mibGet->Param.AdrEnable = AdrCtrlOn;
+		mibGet->Param.AdrEnable = MacCtx->AdrCtrlOn;
 		break;
 	}
 	case MIB_NET_ID:
 	{
-		mibGet->Param.NetID = LoRaMacNetID;
+		mibGet->Param.NetID = MacCtx->LoRaMacNetID;
 		break;
 	}
 	case MIB_DEV_ADDR:
 	{
-		mibGet->Param.DevAddr = LoRaMacDevAddr;
+		mibGet->Param.DevAddr = MacCtx->DevAddr;
 		break;
 	}
 	case MIB_NWK_SKEY:
 	{
-		mibGet->Param.NwkSKey = LoRaMacNwkSKey;
+		mibGet->Param.NwkSKey = MacCtx->NwkSKey;
 		break;
 	}
 	case MIB_APP_SKEY:
 	{
-		mibGet->Param.AppSKey = LoRaMacAppSKey;
+		mibGet->Param.AppSKey = MacCtx->AppSKey;
 		break;
 	}
 	case MIB_PUBLIC_NETWORK:
 	{
-		mibGet->Param.EnablePublicNetwork = PublicNetwork;
+		mibGet->Param.EnablePublicNetwork = MacCtx->PublicNetwork;
 		break;
 	}
 	case MIB_REPEATER_SUPPORT:
 	{
-		mibGet->Param.EnableRepeaterSupport = RepeaterSupport;
+		mibGet->Param.EnableRepeaterSupport = MacCtx->RepeaterSupport;
 		break;
 	}
 	case MIB_CHANNELS:
 	{
 		getPhy.Attribute = PHY_CHANNELS;
-		phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+		phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 
 		mibGet->Param.ChannelList = phyParam.Channels;
 		break;
 	}
 	case MIB_RX2_CHANNEL:
 	{
-		mibGet->Param.Rx2Channel = LoRaMacParams.Rx2Channel;
+		mibGet->Param.Rx2Channel = MacCtx->Params.Rx2Channel;
 		break;
 	}
 	case MIB_RX2_DEFAULT_CHANNEL:
 	{
-		mibGet->Param.Rx2Channel = LoRaMacParamsDefaults.Rx2Channel;
+		mibGet->Param.Rx2Channel = MacCtx->ParamsDefaults.Rx2Channel;
 		break;
 	}
 	case MIB_CHANNELS_DEFAULT_MASK:
 	{
 		getPhy.Attribute = PHY_CHANNELS_DEFAULT_MASK;
-		phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+		phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 
 		mibGet->Param.ChannelsDefaultMask = phyParam.ChannelsMask;
 		break;
@@ -2770,89 +3049,99 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
 	case MIB_CHANNELS_MASK:
 	{
 		getPhy.Attribute = PHY_CHANNELS_MASK;
-		phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+		phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 
 		mibGet->Param.ChannelsMask = phyParam.ChannelsMask;
 		break;
 	}
 	case MIB_CHANNELS_NB_REP:
 	{
-		mibGet->Param.ChannelNbRep = LoRaMacParams.ChannelsNbRep;
+		mibGet->Param.ChannelNbRep = MacCtx->Params.ChannelsNbRep;
 		break;
 	}
 	case MIB_MAX_RX_WINDOW_DURATION:
 	{
-		mibGet->Param.MaxRxWindow = LoRaMacParams.MaxRxWindow;
+		mibGet->Param.MaxRxWindow = MacCtx->Params.MaxRxWindow;
 		break;
 	}
 	case MIB_RECEIVE_DELAY_1:
 	{
-		mibGet->Param.ReceiveDelay1 = LoRaMacParams.ReceiveDelay1;
+		mibGet->Param.ReceiveDelay1 = MacCtx->Params.ReceiveDelay1;
 		break;
 	}
 	case MIB_RECEIVE_DELAY_2:
 	{
-		mibGet->Param.ReceiveDelay2 = LoRaMacParams.ReceiveDelay2;
+		mibGet->Param.ReceiveDelay2 = MacCtx->Params.ReceiveDelay2;
 		break;
 	}
 	case MIB_JOIN_ACCEPT_DELAY_1:
 	{
-		mibGet->Param.JoinAcceptDelay1 = LoRaMacParams.JoinAcceptDelay1;
+		mibGet->Param.JoinAcceptDelay1 = MacCtx->Params.JoinAcceptDelay1;
 		break;
 	}
 	case MIB_JOIN_ACCEPT_DELAY_2:
 	{
-		mibGet->Param.JoinAcceptDelay2 = LoRaMacParams.JoinAcceptDelay2;
+		mibGet->Param.JoinAcceptDelay2 = MacCtx->Params.JoinAcceptDelay2;
 		break;
 	}
 	case MIB_CHANNELS_DEFAULT_DATARATE:
 	{
-		mibGet->Param.ChannelsDefaultDatarate = LoRaMacParamsDefaults.ChannelsDatarate;
+		mibGet->Param.ChannelsDefaultDatarate = MacCtx->ParamsDefaults.ChannelsDatarate;
 		break;
 	}
 	case MIB_CHANNELS_DATARATE:
 	{
-		mibGet->Param.ChannelsDatarate = LoRaMacParams.ChannelsDatarate;
+		mibGet->Param.ChannelsDatarate = MacCtx->Params.ChannelsDatarate;
 		break;
 	}
 	case MIB_CHANNELS_DEFAULT_TX_POWER:
 	{
-		mibGet->Param.ChannelsDefaultTxPower = LoRaMacParamsDefaults.ChannelsTxPower;
+		mibGet->Param.ChannelsDefaultTxPower = MacCtx->ParamsDefaults.ChannelsTxPower;
 		break;
 	}
 	case MIB_CHANNELS_TX_POWER:
 	{
-		mibGet->Param.ChannelsTxPower = LoRaMacParams.ChannelsTxPower;
+		mibGet->Param.ChannelsTxPower = MacCtx->Params.ChannelsTxPower;
 		break;
 	}
 	case MIB_UPLINK_COUNTER:
 	{
-		mibGet->Param.UpLinkCounter = UpLinkCounter;
+		mibGet->Param.UpLinkCounter = MacCtx->UpLinkCounter;
 		break;
 	}
 	case MIB_DOWNLINK_COUNTER:
 	{
-		mibGet->Param.DownLinkCounter = DownLinkCounter;
+		mibGet->Param.DownLinkCounter = MacCtx->DownLinkCounter;
 		break;
 	}
 	case MIB_MULTICAST_CHANNEL:
 	{
-		mibGet->Param.MulticastList = MulticastChannels;
+		mibGet->Param.MulticastList = MacCtx->MulticastChannels;
 		break;
 	}
 	case MIB_SYSTEM_MAX_RX_ERROR:
 	{
-		mibGet->Param.SystemMaxRxError = LoRaMacParams.SystemMaxRxError;
+		mibGet->Param.SystemMaxRxError = MacCtx->Params.SystemMaxRxError;
 		break;
 	}
 	case MIB_MIN_RX_SYMBOLS:
 	{
-		mibGet->Param.MinRxSymbols = LoRaMacParams.MinRxSymbols;
+		mibGet->Param.MinRxSymbols = MacCtx->Params.MinRxSymbols;
 		break;
 	}
 	case MIB_ANTENNA_GAIN:
 	{
-		mibGet->Param.AntennaGain = LoRaMacParams.AntennaGain;
+		mibGet->Param.AntennaGain = MacCtx->Params.AntennaGain;
+		break;
+	}
+	case MIB_AIRTIME:
+	{
+		status = GetAirtime(&mibGet->Param.Airtime);
+		break;
+	}
+	case MIB_AIRTIME_NEXT_TX:
+	{
+		status = GetAirtimeNextTx(&mibGet->Param.AirtimeNextTx);
 		break;
 	}
 	default:
@@ -2863,17 +3152,19 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
 	return status;
 }
 
-LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
+LoRaMacStatus_t LoRaMacCtxMibSetRequestConfirm(LoRaMacContext_t *ctx, MibRequestConfirm_t *mibSet)
 {
 	LoRaMacStatus_t status = LORAMAC_STATUS_OK;
 	ChanMaskSetParams_t chanMaskSet;
 	VerifyParams_t verify;
 
+	SetContext(ctx);
+
 	if (mibSet == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
 	}
-	if ((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
 	{
 		return LORAMAC_STATUS_BUSY;
 	}
@@ -2882,8 +3173,8 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	{
 	case MIB_DEVICE_CLASS:
 	{
-		LoRaMacDeviceClass = mibSet->Param.Class;
-		switch (LoRaMacDeviceClass)
+		MacCtx->LoRaMacDeviceClass = mibSet->Param.Class;
+		switch (MacCtx->LoRaMacDeviceClass)
 		{
 		case CLASS_A:
 		{
@@ -2900,7 +3191,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 		case CLASS_C:
 		{
 			// Set the NodeAckRequested indicator to default
-			NodeAckRequested = false;
+			MacCtx->NodeAckRequested = false;
 			OnRxWindow2TimerEvent();
 			break;
 		}
@@ -2909,30 +3200,31 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	}
 	case MIB_NETWORK_JOINED:
 	{
-		IsLoRaMacNetworkJoined = mibSet->Param.IsNetworkJoined;
+		MacCtx->IsLoRaMacNetworkJoined = mibSet->Param.IsNetworkJoined;
 		break;
 	}
 	case MIB_ADR:
 	{
-		AdrCtrlOn = mibSet->Param.AdrEnable;
+		MacCtx->AdrCtrlOn = mibSet->Param.AdrEnable;
 		break;
 	}
 	case MIB_NET_ID:
 	{
-		LoRaMacNetID = mibSet->Param.NetID;
+		MacCtx->LoRaMacNetID = mibSet->Param.NetID;
 		break;
 	}
 	case MIB_DEV_ADDR:
 	{
-		LoRaMacDevAddr = mibSet->Param.DevAddr;
+		MacCtx->DevAddr = mibSet->Param.DevAddr;
 		break;
 	}
 	case MIB_NWK_SKEY:
 	{
 		if (mibSet->Param.NwkSKey != NULL)
 		{
-			memcpy1(LoRaMacNwkSKey, mibSet->Param.NwkSKey,
-					sizeof(LoRaMacNwkSKey));
+			LoRaMacCryptoCtxInvalidateKey(GetCryptoCtx(), MacCtx->NwkSKey);
+			memcpy1(MacCtx->NwkSKey, mibSet->Param.NwkSKey,
+					sizeof(MacCtx->NwkSKey));
 		}
 		else
 		{
@@ -2944,8 +3236,9 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	{
 		if (mibSet->Param.AppSKey != NULL)
 		{
-			memcpy1(LoRaMacAppSKey, mibSet->Param.AppSKey,
-					sizeof(LoRaMacAppSKey));
+			LoRaMacCryptoCtxInvalidateKey(GetCryptoCtx(), MacCtx->AppSKey);
+			memcpy1(MacCtx->AppSKey, mibSet->Param.AppSKey,
+					sizeof(MacCtx->AppSKey));
 		}
 		else
 		{
@@ -2955,44 +3248,44 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	}
 	case MIB_PUBLIC_NETWORK:
 	{
-		PublicNetwork = mibSet->Param.EnablePublicNetwork;
-		Radio.SetPublicNetwork(PublicNetwork);
+		MacCtx->PublicNetwork = mibSet->Param.EnablePublicNetwork;
+		Radio.SetPublicNetwork(MacCtx->PublicNetwork);
 		break;
 	}
 	case MIB_REPEATER_SUPPORT:
 	{
-		RepeaterSupport = mibSet->Param.EnableRepeaterSupport;
+		MacCtx->RepeaterSupport = mibSet->Param.EnableRepeaterSupport;
 		break;
 	}
 	case MIB_RX2_CHANNEL:
 	{
 		verify.DatarateParams.Datarate = mibSet->Param.Rx2Channel.Datarate;
-		verify.DatarateParams.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
+		verify.DatarateParams.DownlinkDwellTime = MacCtx->Params.DownlinkDwellTime;
 
-		if (RegionVerify(LoRaMacRegion, &verify, PHY_RX_DR) == true)
+		if (RegionVerify(MacCtx->Region, &verify, PHY_RX_DR) == true)
 		{
-			LoRaMacParams.Rx2Channel = mibSet->Param.Rx2Channel;
+			MacCtx->Params.Rx2Channel = mibSet->Param.Rx2Channel;
 
-			if ((LoRaMacDeviceClass == CLASS_C) && (IsLoRaMacNetworkJoined == JOIN_OK))
+			if ((MacCtx->LoRaMacDeviceClass == CLASS_C) && (MacCtx->IsLoRaMacNetworkJoined == JOIN_OK))
 			{
 				// Compute Rx2 windows parameters
-				RegionComputeRxWindowParameters(LoRaMacRegion,
-												LoRaMacParams.Rx2Channel.Datarate,
-												LoRaMacParams.MinRxSymbols,
-												LoRaMacParams.SystemMaxRxError,
-												&RxWindow2Config);
-
-				RxWindow2Config.Channel = Channel;
-				RxWindow2Config.Frequency = LoRaMacParams.Rx2Channel.Frequency;
-				RxWindow2Config.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
-				RxWindow2Config.RepeaterSupport = RepeaterSupport;
-				RxWindow2Config.Window = 1;
-				RxWindow2Config.RxContinuous = true;
-
-				if (RegionRxConfig(LoRaMacRegion, &RxWindow2Config, (int8_t *)&McpsIndication.RxDatarate) == true)
+				RegionComputeRxWindowParameters(MacCtx->Region,
+												MacCtx->Params.Rx2Channel.Datarate,
+												MacCtx->Params.MinRxSymbols,
+												MacCtx->Params.SystemMaxRxError,
+												&MacCtx->RxWindow2Config);
+
+				MacCtx->RxWindow2Config.Channel = MacCtx->Channel;
+				MacCtx->RxWindow2Config.Frequency = MacCtx->Params.Rx2Channel.Frequency;
+				MacCtx->RxWindow2Config.DownlinkDwellTime = MacCtx->Params.DownlinkDwellTime;
+				MacCtx->RxWindow2Config.RepeaterSupport = MacCtx->RepeaterSupport;
+				MacCtx->RxWindow2Config.Window = 1;
+				MacCtx->RxWindow2Config.RxContinuous = true;
+
+				if (RegionRxConfig(MacCtx->Region, &MacCtx->RxWindow2Config, (int8_t *)&MacCtx->McpsIndication.RxDatarate) == true)
 				{
-					RxWindowSetup(RxWindow2Config.RxContinuous, LoRaMacParams.MaxRxWindow);
-					RxSlot = RxWindow2Config.Window;
+					RxWindowSetup(MacCtx->RxWindow2Config.RxContinuous, MacCtx->Params.MaxRxWindow);
+					MacCtx->RxSlot = MacCtx->RxWindow2Config.Window;
 				}
 				else
 				{
@@ -3009,11 +3302,11 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	case MIB_RX2_DEFAULT_CHANNEL:
 	{
 		verify.DatarateParams.Datarate = mibSet->Param.Rx2Channel.Datarate;
-		verify.DatarateParams.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
+		verify.DatarateParams.DownlinkDwellTime = MacCtx->Params.DownlinkDwellTime;
 
-		if (RegionVerify(LoRaMacRegion, &verify, PHY_RX_DR) == true)
+		if (RegionVerify(MacCtx->Region, &verify, PHY_RX_DR) == true)
 		{
-			LoRaMacParamsDefaults.Rx2Channel = mibSet->Param.Rx2DefaultChannel;
+			MacCtx->ParamsDefaults.Rx2Channel = mibSet->Param.Rx2DefaultChannel;
 		}
 		else
 		{
@@ -3026,7 +3319,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 		chanMaskSet.ChannelsMaskIn = mibSet->Param.ChannelsMask;
 		chanMaskSet.ChannelsMaskType = CHANNELS_DEFAULT_MASK;
 
-		if (RegionChanMaskSet(LoRaMacRegion, &chanMaskSet) == false)
+		if (RegionChanMaskSet(MacCtx->Region, &chanMaskSet) == false)
 		{
 			status = LORAMAC_STATUS_PARAMETER_INVALID;
 		}
@@ -3037,7 +3330,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 		chanMaskSet.ChannelsMaskIn = mibSet->Param.ChannelsMask;
 		chanMaskSet.ChannelsMaskType = CHANNELS_MASK;
 
-		if (RegionChanMaskSet(LoRaMacRegion, &chanMaskSet) == false)
+		if (RegionChanMaskSet(MacCtx->Region, &chanMaskSet) == false)
 		{
 			status = LORAMAC_STATUS_PARAMETER_INVALID;
 		}
@@ -3048,7 +3341,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 		if ((mibSet->Param.ChannelNbRep >= 1) &&
 			(mibSet->Param.ChannelNbRep <= 15))
 		{
-			LoRaMacParams.ChannelsNbRep = mibSet->Param.ChannelNbRep;
+			MacCtx->Params.ChannelsNbRep = mibSet->Param.ChannelNbRep;
 		}
 		else
 		{
@@ -3058,36 +3351,36 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	}
 	case MIB_MAX_RX_WINDOW_DURATION:
 	{
-		LoRaMacParams.MaxRxWindow = mibSet->Param.MaxRxWindow;
+		MacCtx->Params.MaxRxWindow = mibSet->Param.MaxRxWindow;
 		break;
 	}
 	case MIB_RECEIVE_DELAY_1:
 	{
-		LoRaMacParams.ReceiveDelay1 = mibSet->Param.ReceiveDelay1;
+		MacCtx->Params.ReceiveDelay1 = mibSet->Param.ReceiveDelay1;
 		break;
 	}
 	case MIB_RECEIVE_DELAY_2:
 	{
-		LoRaMacParams.ReceiveDelay2 = mibSet->Param.ReceiveDelay2;
+		MacCtx->Params.ReceiveDelay2 = mibSet->Param.ReceiveDelay2;
 		break;
 	}
 	case MIB_JOIN_ACCEPT_DELAY_1:
 	{
-		LoRaMacParams.JoinAcceptDelay1 = mibSet->Param.JoinAcceptDelay1;
+		MacCtx->Params.JoinAcceptDelay1 = mibSet->Param.JoinAcceptDelay1;
 		break;
 	}
 	case MIB_JOIN_ACCEPT_DELAY_2:
 	{
-		LoRaMacParams.JoinAcceptDelay2 = mibSet->Param.JoinAcceptDelay2;
+		MacCtx->Params.JoinAcceptDelay2 = mibSet->Param.JoinAcceptDelay2;
 		break;
 	}
 	case MIB_CHANNELS_DEFAULT_DATARATE:
 	{
 		verify.DatarateParams.Datarate = mibSet->Param.ChannelsDefaultDatarate;
 
-		if (RegionVerify(LoRaMacRegion, &verify, PHY_DEF_TX_DR) == true)
+		if (RegionVerify(MacCtx->Region, &verify, PHY_DEF_TX_DR) == true)
 		{
-			LoRaMacParamsDefaults.ChannelsDatarate = verify.DatarateParams.Datarate;
+			MacCtx->ParamsDefaults.ChannelsDatarate = verify.DatarateParams.Datarate;
 		}
 		else
 		{
@@ -3099,9 +3392,9 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	{
 		verify.DatarateParams.Datarate = mibSet->Param.ChannelsDatarate;
 
-		if (RegionVerify(LoRaMacRegion, &verify, PHY_TX_DR) == true)
+		if (RegionVerify(MacCtx->Region, &verify, PHY_TX_DR) == true)
 		{
-			LoRaMacParams.ChannelsDatarate = verify.DatarateParams.Datarate;
+			MacCtx->Params.ChannelsDatarate = verify.DatarateParams.Datarate;
 		}
 		else
 		{
@@ -3113,9 +3406,9 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	{
 		verify.TxPower = mibSet->Param.ChannelsDefaultTxPower;
 
-		if (RegionVerify(LoRaMacRegion, &verify, PHY_DEF_TX_POWER) == true)
+		if (RegionVerify(MacCtx->Region, &verify, PHY_DEF_TX_POWER) == true)
 		{
-			LoRaMacParamsDefaults.ChannelsTxPower = verify.TxPower;
+			MacCtx->ParamsDefaults.ChannelsTxPower = verify.TxPower;
 		}
 		else
 		{
@@ -3127,9 +3420,9 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	{
 		verify.TxPower = mibSet->Param.ChannelsTxPower;
 
-		if (RegionVerify(LoRaMacRegion, &verify, PHY_TX_POWER) == true)
+		if (RegionVerify(MacCtx->Region, &verify, PHY_TX_POWER) == true)
 		{
-			LoRaMacParams.ChannelsTxPower = verify.TxPower;
+			MacCtx->Params.ChannelsTxPower = verify.TxPower;
 		}
 		else
 		{
@@ -3139,27 +3432,27 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	}
 	case MIB_UPLINK_COUNTER:
 	{
-		UpLinkCounter = mibSet->Param.UpLinkCounter;
+		MacCtx->UpLinkCounter = mibSet->Param.UpLinkCounter;
 		break;
 	}
 	case MIB_DOWNLINK_COUNTER:
 	{
-		DownLinkCounter = mibSet->Param.DownLinkCounter;
+		MacCtx->DownLinkCounter = mibSet->Param.DownLinkCounter;
 		break;
 	}
 	case MIB_SYSTEM_MAX_RX_ERROR:
 	{
-		LoRaMacParams.SystemMaxRxError = LoRaMacParamsDefaults.SystemMaxRxError = mibSet->Param.SystemMaxRxError;
+		MacCtx->Params.SystemMaxRxError = MacCtx->ParamsDefaults.SystemMaxRxError = mibSet->Param.SystemMaxRxError;
 		break;
 	}
 	case MIB_MIN_RX_SYMBOLS:
 	{
-		LoRaMacParams.MinRxSymbols = LoRaMacParamsDefaults.MinRxSymbols = mibSet->Param.MinRxSymbols;
+		MacCtx->Params.MinRxSymbols = MacCtx->ParamsDefaults.MinRxSymbols = mibSet->Param.MinRxSymbols;
 		break;
 	}
 	case MIB_ANTENNA_GAIN:
 	{
-		LoRaMacParams.AntennaGain = mibSet->Param.AntennaGain;
+		MacCtx->Params.AntennaGain = mibSet->Param.AntennaGain;
 		break;
 	}
 	default:
@@ -3170,14 +3463,16 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
 	return status;
 }
 
-LoRaMacStatus_t LoRaMacChannelAdd(uint8_t id, ChannelParams_t params)
+LoRaMacStatus_t LoRaMacCtxChannelAdd(LoRaMacContext_t *ctx, uint8_t id, ChannelParams_t params)
 {
 	ChannelAddParams_t channelAdd;
 
+	SetContext(ctx);
+
 	// Validate if the MAC is in a correct state
-	if ((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
 	{
-		if ((LoRaMacState & LORAMAC_TX_CONFIG) != LORAMAC_TX_CONFIG)
+		if ((MacCtx->State & LORAMAC_TX_CONFIG) != LORAMAC_TX_CONFIG)
 		{
 			return LORAMAC_STATUS_BUSY;
 		}
@@ -3186,16 +3481,18 @@ LoRaMacStatus_t LoRaMacChannelAdd(uint8_t id, ChannelParams_t params)
 	channelAdd.NewChannel = &params;
 	channelAdd.ChannelId = id;
 
-	return RegionChannelAdd(LoRaMacRegion, &channelAdd);
+	return RegionChannelAdd(MacCtx->Region, &channelAdd);
 }
 
-LoRaMacStatus_t LoRaMacChannelRemove(uint8_t id)
+LoRaMacStatus_t LoRaMacCtxChannelRemove(LoRaMacContext_t *ctx, uint8_t id)
 {
 	ChannelRemoveParams_t channelRemove;
 
-	if ((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	SetContext(ctx);
+
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
 	{
-		if ((LoRaMacState & LORAMAC_TX_CONFIG) != LORAMAC_TX_CONFIG)
+		if ((MacCtx->State & LORAMAC_TX_CONFIG) != LORAMAC_TX_CONFIG)
 		{
 			return LORAMAC_STATUS_BUSY;
 		}
@@ -3203,20 +3500,22 @@ LoRaMacStatus_t LoRaMacChannelRemove(uint8_t id)
 
 	channelRemove.ChannelId = id;
 
-	if (RegionChannelsRemove(LoRaMacRegion, &channelRemove) == false)
+	if (RegionChannelsRemove(MacCtx->Region, &channelRemove) == false)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
 	}
 	return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacMulticastChannelLink(MulticastParams_t *channelParam)
+LoRaMacStatus_t LoRaMacCtxMulticastChannelLink(LoRaMacContext_t *ctx, MulticastParams_t *channelParam)
 {
+	SetContext(ctx);
+
 	if (channelParam == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
 	}
-	if ((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
 	{
 		return LORAMAC_STATUS_BUSY;
 	}
@@ -3224,14 +3523,14 @@ LoRaMacStatus_t LoRaMacMulticastChannelLink(MulticastParams_t *channelParam)
 	// Reset downlink counter
 	channelParam->DownLinkCounter = 0;
 
-	if (MulticastChannels == NULL)
+	if (MacCtx->MulticastChannels == NULL)
 	{
 		// New node is the fist element
-		MulticastChannels = channelParam;
+		MacCtx->MulticastChannels = channelParam;
 	}
 	else
 	{
-		MulticastParams_t *cur = MulticastChannels;
+		MulticastParams_t *cur = MacCtx->MulticastChannels;
 
 		// Search the last node in the list
 		while (cur->Next != NULL)
@@ -3245,27 +3544,29 @@ LoRaMacStatus_t LoRaMacMulticastChannelLink(MulticastParams_t *channelParam)
 	return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacMulticastChannelUnlink(MulticastParams_t *channelParam)
+LoRaMacStatus_t LoRaMacCtxMulticastChannelUnlink(LoRaMacContext_t *ctx, MulticastParams_t *channelParam)
 {
+	SetContext(ctx);
+
 	if (channelParam == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
 	}
-	if ((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
 	{
 		return LORAMAC_STATUS_BUSY;
 	}
 
-	if (MulticastChannels != NULL)
+	if (MacCtx->MulticastChannels != NULL)
 	{
-		if (MulticastChannels == channelParam)
+		if (MacCtx->MulticastChannels == channelParam)
 		{
 			// First element
-			MulticastChannels = channelParam->Next;
+			MacCtx->MulticastChannels = channelParam->Next;
 		}
 		else
 		{
-			MulticastParams_t *cur = MulticastChannels;
+			MulticastParams_t *cur = MacCtx->MulticastChannels;
 
 			// Search the node in the list
 			while (cur->Next && cur->Next != channelParam)
@@ -3281,33 +3582,38 @@ LoRaMacStatus_t LoRaMacMulticastChannelUnlink(MulticastParams_t *channelParam)
 		channelParam->Next = NULL;
 	}
 
+	LoRaMacCryptoCtxInvalidateKey(GetCryptoCtx(), channelParam->NwkSKey);
+	LoRaMacCryptoCtxInvalidateKey(GetCryptoCtx(), channelParam->AppSKey);
+
 	return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest)
+LoRaMacStatus_t LoRaMacCtxMlmeRequest(LoRaMacContext_t *ctx, MlmeReq_t *mlmeRequest)
 {
 	LoRaMacStatus_t status = LORAMAC_STATUS_SERVICE_UNKNOWN;
 	LoRaMacHeader_t macHdr;
 	AlternateDrParams_t altDr;
 
+	SetContext(ctx);
+
 	if (mlmeRequest == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
 	}
-	if ((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
+	if ((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING)
 	{
 		return LORAMAC_STATUS_BUSY;
 	}
 
-	memset1((uint8_t *)&MlmeConfirm, 0, sizeof(MlmeConfirm));
+	memset1((uint8_t *)&MacCtx->MlmeConfirm, 0, sizeof(MacCtx->MlmeConfirm));
 
-	MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+	MacCtx->MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
 
 	switch (mlmeRequest->Type)
 	{
 	case MLME_JOIN:
 	{
-		if ((LoRaMacState & LORAMAC_TX_DELAYED) == LORAMAC_TX_DELAYED)
+		if ((MacCtx->State & LORAMAC_TX_DELAYED) == LORAMAC_TX_DELAYED)
 		{
 			return LORAMAC_STATUS_BUSY;
 		}
@@ -3331,16 +3637,16 @@ LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest)
 		// 	mlmeRequest->Req.Join.NbTrials = (uint8_t)phyParam.Value;
 		// }
 
-		LoRaMacFlags.Bits.MlmeReq = 1;
-		MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+		MacCtx->LoRaMacFlags.Bits.MlmeReq = 1;
+		MacCtx->MlmeConfirm.MlmeRequest = mlmeRequest->Type;
 
-		LoRaMacDevEui = mlmeRequest->Req.Join.DevEui;
-		LoRaMacAppEui = mlmeRequest->Req.Join.AppEui;
-		LoRaMacAppKey = mlmeRequest->Req.Join.AppKey;
-		MaxJoinRequestTrials = mlmeRequest->Req.Join.NbTrials;
+		MacCtx->LoRaMacDevEui = mlmeRequest->Req.Join.DevEui;
+		MacCtx->LoRaMacAppEui = mlmeRequest->Req.Join.AppEui;
+		MacCtx->LoRaMacAppKey = mlmeRequest->Req.Join.AppKey;
+		MacCtx->MaxJoinRequestTrials = mlmeRequest->Req.Join.NbTrials;
 
 		// Reset variable JoinRequestTrials
-		JoinRequestTrials = 0;
+		MacCtx->JoinRequestTrials = 0;
 
 		// Setup header information
 		macHdr.Value = 0;
@@ -3348,35 +3654,35 @@ LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest)
 
 		ResetMacParameters();
 
-		altDr.NbTrials = JoinRequestTrials + 1;
+		altDr.NbTrials = MacCtx->JoinRequestTrials + 1;
 
-		LoRaMacParams.ChannelsDatarate = RegionAlternateDr(LoRaMacRegion, &altDr);
+		MacCtx->Params.ChannelsDatarate = RegionAlternateDr(MacCtx->Region, &altDr);
 
-		IsLoRaMacNetworkJoined = JOIN_ONGOING;
+		MacCtx->IsLoRaMacNetworkJoined = JOIN_ONGOING;
 
 		status = Send(&macHdr, 0, NULL, 0);
 		break;
 	}
 	case MLME_LINK_CHECK:
 	{
-		LoRaMacFlags.Bits.MlmeReq = 1;
+		MacCtx->LoRaMacFlags.Bits.MlmeReq = 1;
 		// LoRaMac will send this command piggy-pack
-		MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+		MacCtx->MlmeConfirm.MlmeRequest = mlmeRequest->Type;
 
 		status = AddMacCommand(MOTE_MAC_LINK_CHECK_REQ, 0, 0);
 		break;
 	}
 	case MLME_TXCW:
 	{
-		MlmeConfirm.MlmeRequest = mlmeRequest->Type;
-		LoRaMacFlags.Bits.MlmeReq = 1;
+		MacCtx->MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+		MacCtx->LoRaMacFlags.Bits.MlmeReq = 1;
 		status = SetTxContinuousWave(mlmeRequest->Req.TxCw.Timeout);
 		break;
 	}
 	case MLME_TXCW_1:
 	{
-		MlmeConfirm.MlmeRequest = mlmeRequest->Type;
-		LoRaMacFlags.Bits.MlmeReq = 1;
+		MacCtx->MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+		MacCtx->LoRaMacFlags.Bits.MlmeReq = 1;
 		status = SetTxContinuousWave1(mlmeRequest->Req.TxCw.Timeout, mlmeRequest->Req.TxCw.Frequency, mlmeRequest->Req.TxCw.Power);
 		break;
 	}
@@ -3386,14 +3692,14 @@ LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest)
 
 	if (status != LORAMAC_STATUS_OK)
 	{
-		NodeAckRequested = false;
-		LoRaMacFlags.Bits.MlmeReq = 0;
+		MacCtx->NodeAckRequested = false;
+		MacCtx->LoRaMacFlags.Bits.MlmeReq = 0;
 	}
 
 	return status;
 }
 
-LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
+LoRaMacStatus_t LoRaMacCtxMcpsRequest(LoRaMacContext_t *ctx, McpsReq_t *mcpsRequest)
 {
 	GetPhyParams_t getPhy;
 	PhyParam_t phyParam;
@@ -3406,12 +3712,14 @@ LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
 	int8_t datarate;
 	bool readyToSend = false;
 
+	SetContext(ctx);
+
 	if (mcpsRequest == NULL)
 	{
 		return LORAMAC_STATUS_PARAMETER_INVALID;
 	}
-	if (((LoRaMacState & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING) ||
-		((LoRaMacState & LORAMAC_TX_DELAYED) == LORAMAC_TX_DELAYED))
+	if (((MacCtx->State & LORAMAC_TX_RUNNING) == LORAMAC_TX_RUNNING) ||
+		((MacCtx->State & LORAMAC_TX_DELAYED) == LORAMAC_TX_DELAYED))
 	{
 		LOG_LIB("LM", "LoRaMacMcpsRequest LORAMAC_STATUS_BUSY");
 
@@ -3419,18 +3727,18 @@ LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
 	}
 
 	macHdr.Value = 0;
-	memset1((uint8_t *)&McpsConfirm, 0, sizeof(McpsConfirm));
-	McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
+	memset1((uint8_t *)&MacCtx->McpsConfirm, 0, sizeof(MacCtx->McpsConfirm));
+	MacCtx->McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
 
 	// AckTimeoutRetriesCounter must be reset every time a new request (unconfirmed or confirmed) is performed.
-	AckTimeoutRetriesCounter = 1;
+	MacCtx->AckTimeoutRetriesCounter = 1;
 
 	switch (mcpsRequest->Type)
 	{
 	case MCPS_UNCONFIRMED:
 	{
 		readyToSend = true;
-		AckTimeoutRetries = 1;
+		MacCtx->AckTimeoutRetries = 1;
 
 		macHdr.Bits.MType = FRAME_TYPE_DATA_UNCONFIRMED_UP;
 		fPort = mcpsRequest->Req.Unconfirmed.fPort;
@@ -3442,7 +3750,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
 	case MCPS_CONFIRMED:
 	{
 		readyToSend = true;
-		AckTimeoutRetries = mcpsRequest->Req.Confirmed.NbTrials;
+		MacCtx->AckTimeoutRetries = mcpsRequest->Req.Confirmed.NbTrials;
 
 		macHdr.Bits.MType = FRAME_TYPE_DATA_CONFIRMED_UP;
 		fPort = mcpsRequest->Req.Confirmed.fPort;
@@ -3454,7 +3762,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
 	case MCPS_PROPRIETARY:
 	{
 		readyToSend = true;
-		AckTimeoutRetries = 1;
+		MacCtx->AckTimeoutRetries = 1;
 
 		macHdr.Bits.MType = FRAME_TYPE_PROPRIETARY;
 		fBuffer = mcpsRequest->Req.Proprietary.fBuffer;
@@ -3468,22 +3776,22 @@ LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
 
 	// Get the minimum possible datarate
 	getPhy.Attribute = PHY_MIN_TX_DR;
-	getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
-	phyParam = RegionGetPhyParam(LoRaMacRegion, &getPhy);
+	getPhy.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
+	phyParam = RegionGetPhyParam(MacCtx->Region, &getPhy);
 	// Apply the minimum possible datarate.
 	// Some regions have limitations for the minimum datarate.
 	datarate = T_MAX((uint8_t)datarate, phyParam.Value);
 
 	if (readyToSend == true)
 	{
-		if (AdrCtrlOn == false)
+		if (MacCtx->AdrCtrlOn == false)
 		{
 			verify.DatarateParams.Datarate = datarate;
-			verify.DatarateParams.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+			verify.DatarateParams.UplinkDwellTime = MacCtx->Params.UplinkDwellTime;
 
-			if (RegionVerify(LoRaMacRegion, &verify, PHY_TX_DR) == true)
+			if (RegionVerify(MacCtx->Region, &verify, PHY_TX_DR) == true)
 			{
-				LoRaMacParams.ChannelsDatarate = verify.DatarateParams.Datarate;
+				MacCtx->Params.ChannelsDatarate = verify.DatarateParams.Datarate;
 			}
 			else
 			{
@@ -3494,47 +3802,186 @@ LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
 		status = Send(&macHdr, fPort, fBuffer, fBufferSize);
 		if (status == LORAMAC_STATUS_OK)
 		{
-			McpsConfirm.McpsRequest = mcpsRequest->Type;
-			LoRaMacFlags.Bits.McpsReq = 1;
+			MacCtx->McpsConfirm.McpsRequest = mcpsRequest->Type;
+			MacCtx->LoRaMacFlags.Bits.McpsReq = 1;
 		}
 		else
 		{
-			NodeAckRequested = false;
+			MacCtx->NodeAckRequested = false;
 		}
 	}
 
 	return status;
 }
 
-void LoRaMacTestRxWindowsOn(bool enable)
+void LoRaMacCtxTestRxWindowsOn(LoRaMacContext_t *ctx, bool enable)
 {
-	IsRxWindowsEnabled = enable;
+	SetContext(ctx);
+
+	MacCtx->IsRxWindowsEnabled = enable;
 }
 
-void LoRaMacTestSetMic(uint16_t txPacketCounter)
+void LoRaMacCtxTestSetMic(LoRaMacContext_t *ctx, uint16_t txPacketCounter)
 {
-	UpLinkCounter = txPacketCounter;
-	IsUpLinkCounterFixed = true;
+	SetContext(ctx);
+
+	MacCtx->UpLinkCounter = txPacketCounter;
+	MacCtx->IsUpLinkCounterFixed = true;
 }
 
-void LoRaMacTestSetDutyCycleOn(bool enable)
+void LoRaMacCtxTestSetDutyCycleOn(LoRaMacContext_t *ctx, bool enable)
 {
 	VerifyParams_t verify;
 
+	SetContext(ctx);
+
 	verify.DutyCycle = enable;
 
-	if (RegionVerify(LoRaMacRegion, &verify, PHY_DUTY_CYCLE) == true)
+	if (RegionVerify(MacCtx->Region, &verify, PHY_DUTY_CYCLE) == true)
 	{
-		DutyCycleOn = enable;
+		MacCtx->DutyCycleOn = enable;
 	}
 }
 
+void LoRaMacCtxTestSetChannel(LoRaMacContext_t *ctx, uint8_t channel)
+{
+	SetContext(ctx);
+
+	MacCtx->Channel = channel;
+}
+
+uint32_t LoRaMacCtxGetOTAADevId(LoRaMacContext_t *ctx)
+{
+	SetContext(ctx);
+
+	return MacCtx->DevAddr;
+}
+
+void LoRaMacContextInit(LoRaMacContext_t *ctx, struct sLoRaMacCryptoCtx *crypto)
+{
+	memset1((uint8_t *)ctx, 0, sizeof(LoRaMacContext_t));
+
+	ctx->IsRxWindowsEnabled = true;
+	ctx->IsLoRaMacNetworkJoined = JOIN_NOT_START;
+	ctx->State = LORAMAC_IDLE;
+	ctx->MaxAckRetries = 8;
+	ctx->AckTimeoutRetries = 1;
+	ctx->AckTimeoutRetriesCounter = 1;
+	ctx->SendJoinNow = true;
+	ctx->Crypto = crypto;
+}
+
+LoRaMacContext_t *LoRaMacGetDefaultContext(void)
+{
+	return &DefaultContext;
+}
+
+LoRaMacContext_t *LoRaMacGetContext(void)
+{
+	return MacCtx;
+}
+
+void LoRaMacSetContext(LoRaMacContext_t *ctx)
+{
+	SetContext((ctx != NULL) ? ctx : &DefaultContext);
+}
+
+void ResetMacCounters(void)
+{
+	LoRaMacCtxResetMacCounters(&DefaultContext);
+}
+
+LoRaMacStatus_t LoRaMacInitialization(const LoRaMacInitParams_t *params)
+{
+	return LoRaMacCtxInitialization(&DefaultContext, params);
+}
+
+LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo)
+{
+	return LoRaMacCtxQueryTxPossible(&DefaultContext, size, txInfo);
+}
+
+LoRaMacStatus_t LoRaMacPrecomputeUplink(uint8_t fPort, uint8_t size)
+{
+	return LoRaMacCtxPrecomputeUplink(&DefaultContext, fPort, size);
+}
+
+LoRaMacStatus_t LoRaMacQueryTxDelay(TimerTime_t *delay)
+{
+	return LoRaMacCtxQueryTxDelay(&DefaultContext, delay);
+}
+
+LoRaMacStatus_t LoRaMacRestoreSession(struct sLoRaMacNvm *nvm)
+{
+	return LoRaMacCtxRestoreSession(&DefaultContext, nvm);
+}
+
+LoRaMacStatus_t LoRaMacStoreSession(void)
+{
+	return LoRaMacCtxStoreSession(&DefaultContext);
+}
+
+LoRaMacStatus_t LoRaMacMibGetRequestConfirm(MibRequestConfirm_t *mibGet)
+{
+	return LoRaMacCtxMibGetRequestConfirm(&DefaultContext, mibGet);
+}
+
+LoRaMacStatus_t LoRaMacMibSetRequestConfirm(MibRequestConfirm_t *mibSet)
+{
+	return LoRaMacCtxMibSetRequestConfirm(&DefaultContext, mibSet);
+}
+
+LoRaMacStatus_t LoRaMacChannelAdd(uint8_t id, ChannelParams_t params)
+{
+	return LoRaMacCtxChannelAdd(&DefaultContext, id, params);
+}
+
+LoRaMacStatus_t LoRaMacChannelRemove(uint8_t id)
+{
+	return LoRaMacCtxChannelRemove(&DefaultContext, id);
+}
+
+LoRaMacStatus_t LoRaMacMulticastChannelLink(MulticastParams_t *channelParam)
+{
+	return LoRaMacCtxMulticastChannelLink(&DefaultContext, channelParam);
+}
+
+LoRaMacStatus_t LoRaMacMulticastChannelUnlink(MulticastParams_t *channelParam)
+{
+	return LoRaMacCtxMulticastChannelUnlink(&DefaultContext, channelParam);
+}
+
+LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest)
+{
+	return LoRaMacCtxMlmeRequest(&DefaultContext, mlmeRequest);
+}
+
+LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest)
+{
+	return LoRaMacCtxMcpsRequest(&DefaultContext, mcpsRequest);
+}
+
+void LoRaMacTestRxWindowsOn(bool enable)
+{
+	LoRaMacCtxTestRxWindowsOn(&DefaultContext, enable);
+}
+
+void LoRaMacTestSetMic(uint16_t txPacketCounter)
+{
+	LoRaMacCtxTestSetMic(&DefaultContext, txPacketCounter);
+}
+
+void LoRaMacTestSetDutyCycleOn(bool enable)
+{
+	LoRaMacCtxTestSetDutyCycleOn(&DefaultContext, enable);
+}
+
 void LoRaMacTestSetChannel(uint8_t channel)
 {
-	Channel = channel;
+	LoRaMacCtxTestSetChannel(&DefaultContext, channel);
 }
 
 uint32_t LoRaMacGetOTAADevId(void)
 {
-	return LoRaMacDevAddr;
+	return LoRaMacCtxGetOTAADevId(&DefaultContext);
 }
@@ -52,9 +52,7 @@
  * Maximum number of times the MAC layer tries to get an acknowledge.
  */
 // #define MAX_ACK_RETRIES 8
-extern uint8_t max_ack_retries;
-
-extern uint32_t LoRaMacState;
+// The maximum number of retries is held by the instance context (MaxAckRetries)
 
 /*!
  * Frame direction definition for up-link communications
@@ -699,6 +697,9 @@ typedef struct sMcpsReqUnconfirmed
 	uint8_t fPort;
 	/*!
      * Pointer to the buffer of the frame payload
+     *
+     * \remark With LORAMAC_ZERO_COPY_TX the buffer must stay valid and
+     *         unchanged until McpsConfirm
      */
 	void *fBuffer;
 	/*!
@@ -725,6 +726,9 @@ typedef struct sMcpsReqConfirmed
 	uint8_t fPort;
 	/*!
      * Pointer to the buffer of the frame payload
+     *
+     * \remark With LORAMAC_ZERO_COPY_TX the buffer must stay valid and
+     *         unchanged until McpsConfirm
      */
 	void *fBuffer;
 	/*!
@@ -765,6 +769,9 @@ typedef struct sMcpsReqProprietary
 {
 	/*!
      * Pointer to the buffer of the frame payload
+     *
+     * \remark With LORAMAC_ZERO_COPY_TX the buffer must stay valid and
+     *         unchanged until McpsConfirm
      */
 	void *fBuffer;
 	/*!
@@ -1105,6 +1112,8 @@ typedef struct sMlmeConfirm
  * \ref MIB_SYSTEM_MAX_RX_ERROR      | YES | YES
  * \ref MIB_MIN_RX_SYMBOLS           | YES | YES
  * \ref MIB_ANTENNA_GAIN             | YES | YES
+ * \ref MIB_AIRTIME                  | YES | NO
+ * \ref MIB_AIRTIME_NEXT_TX          | YES | NO
  *
  * The following table provides links to the function implementations of the
  * related MIB primitives:
@@ -1311,7 +1320,21 @@ typedef enum eMib
      * The formula is:
      * radioTxPower = ( int8_t )floor( maxEirp - antennaGain )
      */
-	MIB_ANTENNA_GAIN
+	MIB_ANTENNA_GAIN,
+	/*!
+     * Airtime of a band over the last hour: consumed, budget allowed by the
+     * duty cycle and remaining. Set Param.Airtime.Band before the request,
+     * to the band of a defined channel.
+     */
+	MIB_AIRTIME,
+	/*!
+     * Time on air of an uplink and delay until it can be sent within the
+     * time off and the airtime budget of the bands. Set
+     * Param.AirtimeNextTx.Datarate and PayloadSize before the request. The
+     * request returns LORAMAC_STATUS_PARAMETER_INVALID if no enabled channel
+     * supports the datarate or the uplink exceeds the budget of their bands.
+     */
+	MIB_AIRTIME_NEXT_TX
 } Mib_t;
 
 /*!
@@ -1325,6 +1348,52 @@ typedef enum eJoinStatus
 	JOIN_FAILED
 } eJoinStatus_t;
 
+/*!
+ * Airtime of a band, see \ref MIB_AIRTIME
+ */
+typedef struct sMibAirtimeParams
+{
+	/*!
+     * Band index, input
+     */
+	uint8_t Band;
+	/*!
+     * Airtime consumed over the last hour [ms]
+     */
+	TimerTime_t Consumed;
+	/*!
+     * Airtime the duty cycle of the band allows over one hour [ms]
+     */
+	TimerTime_t Budget;
+	/*!
+     * Budget minus consumed airtime [ms], 0 once the budget is exceeded
+     */
+	TimerTime_t Remaining;
+} MibAirtimeParams_t;
+
+/*!
+ * Earliest uplink, see \ref MIB_AIRTIME_NEXT_TX
+ */
+typedef struct sMibAirtimeNextTxParams
+{
+	/*!
+     * Datarate of the uplink, input
+     */
+	int8_t Datarate;
+	/*!
+     * Application payload size [byte], input
+     */
+	uint8_t PayloadSize;
+	/*!
+     * Time on air of the uplink, without MAC commands [ms]
+     */
+	TimerTime_t TimeOnAir;
+	/*!
+     * Delay from now until the uplink can be sent [ms]
+     */
+	TimerTime_t Delay;
+} MibAirtimeNextTxParams_t;
+
 /*!
  * LoRaMAC MIB parameters
  */
@@ -1510,6 +1579,18 @@ typedef union uMibParam
      * Related MIB type: \ref MIB_ANTENNA_GAIN
      */
 	float AntennaGain;
+	/*!
+     * Airtime of a band
+     *
+     * Related MIB type: \ref MIB_AIRTIME
+     */
+	MibAirtimeParams_t Airtime;
+	/*!
+     * Earliest uplink
+     *
+     * Related MIB type: \ref MIB_AIRTIME_NEXT_TX
+     */
+	MibAirtimeNextTxParams_t AirtimeNextTx;
 } MibParam_t;
 
 /*!
@@ -1592,7 +1673,16 @@ typedef enum eLoRaMacStatus
      * Service not started - the specified region is not supported
      * or not activated with preprocessor definitions.
      */
-	LORAMAC_STATUS_REGION_NOT_SUPPORTED
+	LORAMAC_STATUS_REGION_NOT_SUPPORTED,
+	/*!
+     * Service not started - the crypto backend failed to secure the frame
+     */
+	LORAMAC_STATUS_CRYPTO_ERROR,
+	/*!
+     * Service not started - the frame counter ceiling could not be written
+     * to the NVM
+     */
+	LORAMAC_STATUS_NVM_ERROR
 } LoRaMacStatus_t;
 
 /*!
@@ -1654,7 +1744,6 @@ typedef enum eLoRaMacRegion_t
 	LORAMAC_REGION_RU864,
 } LoRaMacRegion_t;
 
-extern LoRaMacRegion_t LoRaMacRegion;
 /*!
  * LoRaMAC events structure
  * Used to notify upper layers of MAC events
@@ -1739,6 +1828,90 @@ uint32_t LoRaMacGetOTAADevId(void);
  */
 LoRaMacStatus_t LoRaMacQueryTxPossible(uint8_t size, LoRaMacTxInfo_t *txInfo);
 
+/*!
+ * \brief   Precomputes the crypto of the next uplink (CMAC state after B0 and
+ *          the first FRMPayload keystream blocks) while the MAC is idle. The
+ *          next PrepareFrame then only XORs the payload and finishes the MIC.
+ *
+ * \details Opt-in, call it while waiting for the next reporting interval.
+ *          The precomputed state is only used if the frame matches the
+ *          prediction (keys, DevAddr, FCnt, port and size), otherwise the
+ *          frame is processed as usual. Pending MAC commands are taken into
+ *          account like in PrepareFrame.
+ *
+ * \param    fPort - Port of the next uplink
+ *
+ * \param    size - Size of applicative payload to be send next
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED.
+ */
+LoRaMacStatus_t LoRaMacPrecomputeUplink(uint8_t fPort, uint8_t size);
+
+/*!
+ * \brief   Queries the time until the duty cycle allows the next uplink
+ *
+ * \details Takes the band and aggregated duty cycles into account like the
+ *          scheduling of a request does, without sending anything. An upper
+ *          layer can use it to hold back a frame, and keep adding data to it,
+ *          instead of having the MAC wait with it. The time offs are read from
+ *          the airtime ledger, the MAC and region state are left untouched.
+ *
+ * \param    delay - Time until the next uplink is possible [ms], 0 if it is
+ *                   possible now
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_DEVICE_OFF,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID.
+ */
+LoRaMacStatus_t LoRaMacQueryTxDelay(TimerTime_t *delay);
+
+/*!
+ * LoRaMAC session log, see LoRaMacNvm.h
+ */
+struct sLoRaMacNvm;
+
+/*!
+ * \brief   Persists the session and restores the stored one
+ *
+ * \details Attaches the session log to the MAC, which from then on writes a
+ *          snapshot of the session after a join and after MAC commands
+ *          changing it (LinkADRReq, NewChannelReq, ...), and checkpoints the
+ *          frame counters. If the log holds a session of the current region
+ *          it is restored and the device is joined: it can send right away
+ *          instead of joining again. Call it after LoRaMacInitialization.
+ *
+ * \param    nvm - Session log initialized with LoRaMacNvmInit, NULL to stop
+ *                 persisting the session
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED (no session restored).
+ */
+LoRaMacStatus_t LoRaMacRestoreSession(struct sLoRaMacNvm *nvm);
+
+/*!
+ * \brief   Writes a snapshot of the session to the session log
+ *
+ * \details The MAC does this by itself after a join and after MAC commands.
+ *          Call it after changing the session by other means, e.g. after an
+ *          activation by personalization or a channel mask change through
+ *          the MIB.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID (no session log, or it
+ *          could not be written).
+ */
+LoRaMacStatus_t LoRaMacStoreSession(void);
+
 /*!
  * \brief   LoRaMAC channel add service
  *
@@ -1936,16 +2109,13 @@ LoRaMacStatus_t LoRaMacMlmeRequest(MlmeReq_t *mlmeRequest);
  *          \ref LORAMAC_STATUS_PARAMETER_INVALID,
  *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED,
  *          \ref LORAMAC_STATUS_LENGTH_ERROR,
- *          \ref LORAMAC_STATUS_DEVICE_OFF.
+ *          \ref LORAMAC_STATUS_DEVICE_OFF,
+ *          \ref LORAMAC_STATUS_NVM_ERROR.
  */
 LoRaMacStatus_t LoRaMacMcpsRequest(McpsReq_t *mcpsRequest);
 
 void ResetMacCounters(void);
 
-extern uint8_t LoRaMacNwkSKey[];
-extern uint8_t LoRaMacAppSKey[];
-extern uint32_t LoRaMacDevAddr;
-
 /* Loramac Intialization parameters*/
 
 
@@ -1988,4 +2158,75 @@ typedef struct LoRaMacInitParams_s {
 // LoRaMacStatus_t LoRaMacInitialization(LoRaMacPrimitives_t *primitives, LoRaMacCallback_t *callbacks, LoRaMacRegion_t region, DeviceClass_t nodeClass = CLASS_A, bool region_change = false);
 LoRaMacStatus_t LoRaMacInitialization(const LoRaMacInitParams_t *params);
 
+/*!
+ * LoRaMAC instance context, see LoRaMacContext.h
+ */
+typedef struct sLoRaMacContext LoRaMacContext_t;
+
+/*!
+ * Crypto context, see LoRaMacCrypto.h
+ */
+struct sLoRaMacCryptoCtx;
+
+/*!
+ * \brief   Initializes an instance context
+ *
+ * \details Must be called before the context is passed to
+ *          LoRaMacCtxInitialization. The default instance is initialized
+ *          statically.
+ *
+ * \param    ctx - Instance context
+ *
+ * \param    crypto - Crypto context of the instance, NULL to use the one of
+ *                    the crypto functions without a context parameter
+ */
+void LoRaMacContextInit(LoRaMacContext_t *ctx, struct sLoRaMacCryptoCtx *crypto);
+
+/*!
+ * \brief   Returns the default instance, used by the functions without a
+ *          context parameter
+ */
+LoRaMacContext_t *LoRaMacGetDefaultContext(void);
+
+/*!
+ * \brief   Returns the active instance
+ *
+ * \details Radio events, timer events and the primitives of the upper layer
+ *          run on the active instance. A primitive can use this function to
+ *          find the instance it is called for.
+ */
+LoRaMacContext_t *LoRaMacGetContext(void);
+
+/*!
+ * \brief   Makes an instance the active one
+ *
+ * \details Every LoRaMacCtx function activates its instance. A host running
+ *          several instances must activate the owner of a radio or timer
+ *          event before dispatching it.
+ *
+ * \param    ctx - Instance to activate, NULL for the default instance
+ */
+void LoRaMacSetContext(LoRaMacContext_t *ctx);
+
+/*!
+ * The functions below run on the given instance. Apart from that they are
+ * the same as the functions without the Ctx part in their name.
+ */
+LoRaMacStatus_t LoRaMacCtxInitialization(LoRaMacContext_t *ctx, const LoRaMacInitParams_t *params);
+LoRaMacStatus_t LoRaMacCtxQueryTxPossible(LoRaMacContext_t *ctx, uint8_t size, LoRaMacTxInfo_t *txInfo);
+LoRaMacStatus_t LoRaMacCtxPrecomputeUplink(LoRaMacContext_t *ctx, uint8_t fPort, uint8_t size);
+LoRaMacStatus_t LoRaMacCtxQueryTxDelay(LoRaMacContext_t *ctx, TimerTime_t *delay);
+LoRaMacStatus_t LoRaMacCtxRestoreSession(LoRaMacContext_t *ctx, struct sLoRaMacNvm *nvm);
+LoRaMacStatus_t LoRaMacCtxStoreSession(LoRaMacContext_t *ctx);
+LoRaMacStatus_t LoRaMacCtxChannelAdd(LoRaMacContext_t *ctx, uint8_t id, ChannelParams_t params);
+LoRaMacStatus_t LoRaMacCtxChannelRemove(LoRaMacContext_t *ctx, uint8_t id);
+LoRaMacStatus_t LoRaMacCtxMulticastChannelLink(LoRaMacContext_t *ctx, MulticastParams_t *channelParam);
+LoRaMacStatus_t LoRaMacCtxMulticastChannelUnlink(LoRaMacContext_t *ctx, MulticastParams_t *channelParam);
+LoRaMacStatus_t LoRaMacCtxMibGetRequestConfirm(LoRaMacContext_t *ctx, MibRequestConfirm_t *mibGet);
+LoRaMacStatus_t LoRaMacCtxMibSetRequestConfirm(LoRaMacContext_t *ctx, MibRequestConfirm_t *mibSet);
+LoRaMacStatus_t LoRaMacCtxMlmeRequest(LoRaMacContext_t *ctx, MlmeReq_t *mlmeRequest);
+LoRaMacStatus_t LoRaMacCtxMcpsRequest(LoRaMacContext_t *ctx, McpsReq_t *mcpsRequest);
+uint32_t LoRaMacCtxGetOTAADevId(LoRaMacContext_t *ctx);
+void LoRaMacCtxResetMacCounters(LoRaMacContext_t *ctx);
+
 #endif // __LORAMAC_H__
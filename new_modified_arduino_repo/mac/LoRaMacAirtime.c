@@ -0,0 +1,170 @@
+/*!
+ * \file      LoRaMacAirtime.c
+ *
+ * \brief     LoRa MAC layer airtime ledger
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+#include "LoRaMacAirtime.h"
+#include "region/RegionCommon.h"
+
+/*!
+ * \brief Moves the current slot to the one of the given time, emptying the
+ *        slots leaving the window
+ */
+static void AdvanceSlots(LoRaMacAirtime_t *airtime, TimerTime_t now)
+{
+	TimerTime_t elapsed = now - airtime->SlotStartTime;
+	uint32_t nbSlots;
+
+	if (elapsed < LORAMAC_AIRTIME_SLOT_LENGTH)
+	{
+		return;
+	}
+	nbSlots = elapsed / LORAMAC_AIRTIME_SLOT_LENGTH;
+	airtime->SlotStartTime += nbSlots * LORAMAC_AIRTIME_SLOT_LENGTH;
+
+	// Past one turn of the rings, every slot is empty
+	nbSlots = T_MIN(nbSlots, LORAMAC_AIRTIME_NB_SLOTS + 1);
+	for (uint32_t i = 0; i < nbSlots; i++)
+	{
+		airtime->Slot = (airtime->Slot == LORAMAC_AIRTIME_NB_SLOTS) ? 0 : (airtime->Slot + 1);
+		for (uint8_t band = 0; band < REGION_MAX_NB_BANDS; band++)
+		{
+			airtime->Bands[band].Airtime[airtime->Slot] = 0;
+		}
+	}
+}
+
+static TimerTime_t GetTimeOffDelay(TimerTime_t lastTxDoneTime, TimerTime_t timeOff, TimerTime_t now)
+{
+	TimerTime_t elapsed = now - lastTxDoneTime;
+
+	return (timeOff > elapsed) ? (timeOff - elapsed) : 0;
+}
+
+void LoRaMacAirtimeInit(LoRaMacAirtime_t *airtime, TimerTime_t now)
+{
+	memset1((uint8_t *)airtime, 0, sizeof(LoRaMacAirtime_t));
+	airtime->SlotStartTime = now;
+}
+
+void LoRaMacAirtimeTxDone(LoRaMacAirtime_t *airtime, LoRaMacAirtimeTxDoneParams_t *txDone)
+{
+	RegionCommonCalcBackOffParams_t calcBackOff;
+	uint8_t bandIdx = txDone->Channels[txDone->Channel].Band;
+	LoRaMacAirtimeBand_t *band = &airtime->Bands[bandIdx];
+	ChannelParams_t channelCopy = txDone->Channels[txDone->Channel];
+	Band_t bandCopy = txDone->Bands[bandIdx];
+
+	AdvanceSlots(airtime, txDone->TxDoneTime);
+	band->Airtime[airtime->Slot] += txDone->TxTimeOnAir;
+	band->LastTxDoneTime = txDone->TxDoneTime;
+
+	// Time off of the band, on a copy of it
+	channelCopy.Band = 0;
+	calcBackOff.Channels = &channelCopy;
+	calcBackOff.Bands = &bandCopy;
+	calcBackOff.Channel = 0;
+	calcBackOff.Joined = txDone->Joined;
+	calcBackOff.DutyCycleEnabled = txDone->DutyCycleEnabled;
+	calcBackOff.LastTxIsJoinRequest = txDone->LastTxIsJoinRequest;
+	calcBackOff.ElapsedTime = txDone->ElapsedTime;
+	calcBackOff.TxTimeOnAir = txDone->TxTimeOnAir;
+	RegionCommonCalcBackOff(&calcBackOff);
+	band->TimeOff = bandCopy.TimeOff;
+}
+
+TimerTime_t LoRaMacAirtimeGetBudget(Band_t *band, bool joined, TimerTime_t elapsedTime)
+{
+	uint16_t dutyCycle = band->DCycle;
+
+	if (joined == false)
+	{
+		dutyCycle = T_MAX(dutyCycle, RegionCommonGetJoinDc(elapsedTime));
+	}
+	return LORAMAC_AIRTIME_WINDOW / T_MAX(dutyCycle, 1);
+}
+
+TimerTime_t LoRaMacAirtimeGetConsumed(LoRaMacAirtime_t *airtime, uint8_t band, TimerTime_t now)
+{
+	TimerTime_t consumed = 0;
+
+	AdvanceSlots(airtime, now);
+	for (uint8_t i = 0; i <= LORAMAC_AIRTIME_NB_SLOTS; i++)
+	{
+		consumed += airtime->Bands[band].Airtime[i];
+	}
+	return consumed;
+}
+
+TimerTime_t LoRaMacAirtimeGetWindowDelay(LoRaMacAirtime_t *airtime, uint8_t band, TimerTime_t budget, TimerTime_t timeOnAir, TimerTime_t now)
+{
+	TimerTime_t consumed;
+	uint8_t slot;
+
+	if (timeOnAir > budget)
+	{
+		return LORAMAC_AIRTIME_NO_TX;
+	}
+	consumed = LoRaMacAirtimeGetConsumed(airtime, band, now);
+
+	// Oldest slot first, the j-th one leaves the window j slots after the
+	// start of the current one
+	slot = airtime->Slot;
+	for (uint8_t j = 0; j <= LORAMAC_AIRTIME_NB_SLOTS; j++)
+	{
+		if ((consumed + timeOnAir) <= budget)
+		{
+			return (j == 0) ? 0 : (airtime->SlotStartTime + j * LORAMAC_AIRTIME_SLOT_LENGTH - now);
+		}
+		slot = (slot == LORAMAC_AIRTIME_NB_SLOTS) ? 0 : (slot + 1);
+		consumed -= airtime->Bands[band].Airtime[slot];
+	}
+	// The current slot left too
+	return airtime->SlotStartTime + (LORAMAC_AIRTIME_NB_SLOTS + 1) * LORAMAC_AIRTIME_SLOT_LENGTH - now;
+}
+
+TimerTime_t LoRaMacAirtimeGetNextTx(LoRaMacAirtime_t *airtime, LoRaMacAirtimeNextTxParams_t *nextTx, TimerTime_t now)
+{
+	TimerTime_t delay = LORAMAC_AIRTIME_NO_TX;
+	TimerTime_t aggregatedDelay;
+	uint8_t bandsDone = 0;
+
+	for (uint8_t i = 0; i < nextTx->NbChannels; i++)
+	{
+		ChannelParams_t *channel = &nextTx->Channels[i];
+		LoRaMacAirtimeBand_t *band = &airtime->Bands[channel->Band];
+		TimerTime_t bandDelay = 0;
+
+		if (((nextTx->ChannelsMask[i / 16] & (1 << (i % 16))) == 0) || (channel->Frequency == 0) ||
+			(RegionCommonValueInRange(nextTx->Datarate, channel->DrRange.Fields.Min, channel->DrRange.Fields.Max) == false) ||
+			((bandsDone & (1 << channel->Band)) != 0))
+		{
+			continue;
+		}
+		bandsDone |= 1 << channel->Band;
+
+		// Without duty cycle, a joined device is not restricted
+		if ((nextTx->Joined == false) || (nextTx->DutyCycleEnabled == true))
+		{
+			TimerTime_t budget = LoRaMacAirtimeGetBudget(&nextTx->Bands[channel->Band], nextTx->Joined, nextTx->ElapsedTime);
+			TimerTime_t windowDelay = LoRaMacAirtimeGetWindowDelay(airtime, channel->Band, budget, nextTx->TimeOnAir, now);
+
+			bandDelay = GetTimeOffDelay(band->LastTxDoneTime, band->TimeOff, now);
+			bandDelay = T_MAX(bandDelay, windowDelay);
+		}
+		delay = T_MIN(delay, bandDelay);
+	}
+
+	if (delay == LORAMAC_AIRTIME_NO_TX)
+	{
+		return delay;
+	}
+	aggregatedDelay = GetTimeOffDelay(nextTx->AggregatedLastTxDoneTime, nextTx->AggregatedTimeOff, now);
+	return T_MAX(delay, aggregatedDelay);
+}
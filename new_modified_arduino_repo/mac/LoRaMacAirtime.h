@@ -0,0 +1,261 @@
+/*!
+ * \file      LoRaMacAirtime.h
+ *
+ * \brief     LoRa MAC layer airtime ledger
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \defgroup  LORAMAC_AIRTIME LoRa MAC layer airtime ledger
+ *            Accounts the time on air of the uplinks of each band over a
+ *            sliding window of one hour, the observation period of the duty
+ *            cycle of ETSI EN 300 220, and projects the earliest time a
+ *            frame can be sent without exceeding the duty cycle.
+ *
+ *            Window
+ *            The window is split into LORAMAC_AIRTIME_NB_SLOTS slots. Each
+ *            band keeps the airtime of one slot more, the current one, in a
+ *            ring. A frame is accounted to the slot of its end of
+ *            transmission and leaves the window with its slot, so the
+ *            consumed airtime covers between one hour and one hour and a
+ *            slot: it is never less than the airtime of the last hour.
+ *
+ *            Earliest TX
+ *            A frame can be sent on a band once both the time off the MAC
+ *            applies after each uplink (time on air times the duty cycle)
+ *            has elapsed and the airtime of the window plus the one of the
+ *            frame fits in the budget of the band. The MAC itself only
+ *            applies the time off. The aggregated time off is not kept by
+ *            the ledger: the MAC accumulates it over the uplinks, so the
+ *            caller passes the value the MAC will apply.
+ */
+#ifndef __LORAMAC_AIRTIME_H__
+#define __LORAMAC_AIRTIME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "LoRaMac.h"
+#include "region/Region.h"
+
+/*!
+ * Length of the sliding window [ms]
+ */
+#define LORAMAC_AIRTIME_WINDOW 3600000
+
+/*!
+ * Number of slots of the window. More slots release the airtime closer to
+ * one hour after the frame, for 4 * REGION_MAX_NB_BANDS bytes of RAM each.
+ */
+#ifndef LORAMAC_AIRTIME_NB_SLOTS
+#define LORAMAC_AIRTIME_NB_SLOTS 12
+#endif
+
+/*!
+ * Length of a slot [ms]
+ */
+#define LORAMAC_AIRTIME_SLOT_LENGTH (LORAMAC_AIRTIME_WINDOW / LORAMAC_AIRTIME_NB_SLOTS)
+
+/*!
+ * Delay returned when a frame can never be sent: its time on air exceeds the
+ * budget, or no channel is enabled for its datarate
+ */
+#define LORAMAC_AIRTIME_NO_TX ((TimerTime_t)(-1))
+
+/*!
+ * Airtime of a band
+ */
+typedef struct sLoRaMacAirtimeBand
+{
+	/*!
+	 * Airtime of the slots [ms]
+	 */
+	uint32_t Airtime[LORAMAC_AIRTIME_NB_SLOTS + 1];
+	/*!
+	 * End of transmission of the last uplink
+	 */
+	TimerTime_t LastTxDoneTime;
+	/*!
+	 * Time off after the last uplink
+	 */
+	TimerTime_t TimeOff;
+} LoRaMacAirtimeBand_t;
+
+/*!
+ * Airtime ledger
+ */
+typedef struct sLoRaMacAirtime
+{
+	/*!
+	 * Start of the current slot
+	 */
+	TimerTime_t SlotStartTime;
+	/*!
+	 * Index of the current slot in the rings
+	 */
+	uint8_t Slot;
+	/*!
+	 * Bands
+	 */
+	LoRaMacAirtimeBand_t Bands[REGION_MAX_NB_BANDS];
+} LoRaMacAirtime_t;
+
+/*!
+ * Parameter structure for LoRaMacAirtimeTxDone
+ */
+typedef struct sLoRaMacAirtimeTxDoneParams
+{
+	/*!
+	 * Channels of the region
+	 */
+	ChannelParams_t *Channels;
+	/*!
+	 * Bands of the region
+	 */
+	Band_t *Bands;
+	/*!
+	 * Channel of the uplink
+	 */
+	uint8_t Channel;
+	/*!
+	 * Joined set to true, if the node has joined the network
+	 */
+	bool Joined;
+	/*!
+	 * Set to true, if the duty cycle is enabled
+	 */
+	bool DutyCycleEnabled;
+	/*!
+	 * Set to true, if the uplink is a join request
+	 */
+	bool LastTxIsJoinRequest;
+	/*!
+	 * Time since the initialization of the MAC
+	 */
+	TimerTime_t ElapsedTime;
+	/*!
+	 * End of transmission of the uplink
+	 */
+	TimerTime_t TxDoneTime;
+	/*!
+	 * Time on air of the uplink
+	 */
+	TimerTime_t TxTimeOnAir;
+} LoRaMacAirtimeTxDoneParams_t;
+
+/*!
+ * Parameter structure for LoRaMacAirtimeGetNextTx
+ */
+typedef struct sLoRaMacAirtimeNextTxParams
+{
+	/*!
+	 * Channels of the region
+	 */
+	ChannelParams_t *Channels;
+	/*!
+	 * Bands of the region
+	 */
+	Band_t *Bands;
+	/*!
+	 * Channels mask
+	 */
+	uint16_t *ChannelsMask;
+	/*!
+	 * Number of channels of the region
+	 */
+	uint8_t NbChannels;
+	/*!
+	 * Datarate of the frame
+	 */
+	int8_t Datarate;
+	/*!
+	 * Time on air of the frame
+	 */
+	TimerTime_t TimeOnAir;
+	/*!
+	 * Joined set to true, if the node has joined the network
+	 */
+	bool Joined;
+	/*!
+	 * Set to true, if the duty cycle is enabled
+	 */
+	bool DutyCycleEnabled;
+	/*!
+	 * Time since the initialization of the MAC
+	 */
+	TimerTime_t ElapsedTime;
+	/*!
+	 * End of transmission of the last uplink, on any band
+	 */
+	TimerTime_t AggregatedLastTxDoneTime;
+	/*!
+	 * Aggregated time off the MAC applies from AggregatedLastTxDoneTime,
+	 * including the one of the last uplink
+	 */
+	TimerTime_t AggregatedTimeOff;
+} LoRaMacAirtimeNextTxParams_t;
+
+/*!
+ * \brief Empties the ledger
+ *
+ * \param   airtime         - Airtime ledger
+ * \param   now             - Current time
+ */
+void LoRaMacAirtimeInit(LoRaMacAirtime_t *airtime, TimerTime_t now);
+
+/*!
+ * \brief Accounts an uplink, at its end of transmission
+ *
+ * \remark Computes the time off of the band as RegionCommonCalcBackOff
+ *         does it before the next uplink.
+ *
+ * \param   airtime         - Airtime ledger
+ * \param   txDone          - Uplink
+ */
+void LoRaMacAirtimeTxDone(LoRaMacAirtime_t *airtime, LoRaMacAirtimeTxDoneParams_t *txDone);
+
+/*!
+ * \brief Gets the budget of a band: the airtime its duty cycle allows over
+ *        the window. Before the join, the join duty cycle applies too.
+ *
+ * \param   band            - Band of the region
+ * \param   joined          - Set to true, if the node has joined the network
+ * \param   elapsedTime     - Time since the initialization of the MAC
+ * \retval  Budget [ms]
+ */
+TimerTime_t LoRaMacAirtimeGetBudget(Band_t *band, bool joined, TimerTime_t elapsedTime);
+
+/*!
+ * \brief Gets the airtime a band consumed over the window
+ *
+ * \param   airtime         - Airtime ledger
+ * \param   band            - Index of the band
+ * \param   now             - Current time
+ * \retval  Consumed airtime [ms]
+ */
+TimerTime_t LoRaMacAirtimeGetConsumed(LoRaMacAirtime_t *airtime, uint8_t band, TimerTime_t now);
+
+/*!
+ * \brief Gets the delay until a frame fits in the budget of a band
+ *
+ * \param   airtime         - Airtime ledger
+ * \param   band            - Index of the band
+ * \param   budget          - Budget of the band
+ * \param   timeOnAir       - Time on air of the frame
+ * \param   now             - Current time
+ * \retval  Delay [ms], LORAMAC_AIRTIME_NO_TX if the frame exceeds the budget
+ */
+TimerTime_t LoRaMacAirtimeGetWindowDelay(LoRaMacAirtime_t *airtime, uint8_t band, TimerTime_t budget, TimerTime_t timeOnAir, TimerTime_t now);
+
+/*!
+ * \brief Gets the delay until a frame can be sent on the enabled channels of
+ *        its datarate: the smallest one of their bands, after the
+ *        aggregated time off. The budget applies when the duty cycle is
+ *        enabled or before the join, as the time off does.
+ *
+ * \param   airtime         - Airtime ledger
+ * \param   nextTx          - Frame and channels
+ * \param   now             - Current time
+ * \retval  Delay [ms], LORAMAC_AIRTIME_NO_TX if the frame can not be sent
+ */
+TimerTime_t LoRaMacAirtimeGetNextTx(LoRaMacAirtime_t *airtime, LoRaMacAirtimeNextTxParams_t *nextTx, TimerTime_t now);
+
+#endif // __LORAMAC_AIRTIME_H__
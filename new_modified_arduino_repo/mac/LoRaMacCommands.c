@@ -0,0 +1,51 @@
+/*!
+ * \file      LoRaMacCommands.c
+ *
+ * \brief     Table driven LoRaMAC command parsing
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+#include "LoRaMacCommands.h"
+
+const LoRaMacCommand_t *LoRaMacCommandsGetUplink(const LoRaMacCommand_t *table, uint8_t nbCommands, uint8_t cid)
+{
+	if ((cid >= nbCommands) || ((table[cid].Flags & LORAMAC_COMMAND_UPLINK) == 0))
+	{
+		return NULL;
+	}
+	return &table[cid];
+}
+
+uint8_t LoRaMacCommandsGetSticky(const LoRaMacCommand_t *table, uint8_t nbCommands, const uint8_t *buffer, uint8_t size, uint8_t *sticky)
+{
+	uint8_t index = 0;
+	uint8_t stickySize = 0;
+
+	while (index < size)
+	{
+		const LoRaMacCommand_t *command = LoRaMacCommandsGetUplink(table, nbCommands, buffer[index]);
+		uint8_t commandSize;
+
+		if (command == NULL)
+		{
+			break;
+		}
+		commandSize = command->TxSize + 1;
+		if (commandSize > (size - index))
+		{
+			break;
+		}
+		if ((command->Flags & LORAMAC_COMMAND_STICKY) != 0)
+		{
+			memcpy1(&sticky[stickySize], &buffer[index], commandSize);
+			stickySize += commandSize;
+		}
+		index += commandSize;
+	}
+	return stickySize;
+}
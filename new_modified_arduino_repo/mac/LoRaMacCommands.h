@@ -0,0 +1,104 @@
+/*!
+ * \file      LoRaMacCommands.h
+ *
+ * \brief     Table driven LoRaMAC command parsing
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \defgroup  LORAMAC_COMMANDS LoRa MAC layer command descriptors
+ *            A MAC command is described once by an entry of a table indexed
+ *            by its CID: the payload sizes in both directions, whether the
+ *            device accepts it from the server and whether the device answer
+ *            must be repeated until a downlink is received (sticky).
+ *
+ *            The received commands are parsed in a single pass, the caller
+ *            dispatches on the CID with a switch so the handlers stay
+ *            inlined. The size of each command is checked against the
+ *            remaining bytes with LoRaMacCommandsGetDownlink before it is
+ *            handled, an unknown CID or a truncated command stops the
+ *            parsing.
+ */
+#ifndef __LORAMAC_COMMANDS_H__
+#define __LORAMAC_COMMANDS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * The device may send the command
+ */
+#define LORAMAC_COMMAND_UPLINK 0x01
+
+/*!
+ * The device command is repeated in each uplink until a downlink is received
+ */
+#define LORAMAC_COMMAND_STICKY 0x02
+
+/*!
+ * The device accepts the command from the server
+ */
+#define LORAMAC_COMMAND_DOWNLINK 0x04
+
+/*!
+ * MAC command descriptor
+ */
+typedef struct sLoRaMacCommand
+{
+	/*!
+	 * Payload size of the command received from the server
+	 */
+	uint8_t RxSize;
+	/*!
+	 * Payload size of the command sent by the device
+	 */
+	uint8_t TxSize;
+	/*!
+	 * LORAMAC_COMMAND_UPLINK, LORAMAC_COMMAND_STICKY,
+	 * LORAMAC_COMMAND_DOWNLINK
+	 */
+	uint8_t Flags;
+} LoRaMacCommand_t;
+
+/*!
+ * \brief Returns the descriptor of a command the device may send
+ *
+ * \param   table           - Descriptors, indexed by CID
+ * \param   nbCommands      - Number of descriptors
+ * \param   cid             - Command identifier
+ * \retval  Descriptor, NULL if the device may not send the command
+ */
+const LoRaMacCommand_t *LoRaMacCommandsGetUplink(const LoRaMacCommand_t *table, uint8_t nbCommands, uint8_t cid);
+
+/*!
+ * \brief Returns the descriptor of a command received from the server if it
+ *        is complete. Inlined, it is called for every received command.
+ *
+ * \param   table           - Descriptors, indexed by CID
+ * \param   nbCommands      - Number of descriptors
+ * \param   cid             - Command identifier
+ * \param   remaining       - Number of bytes following the CID
+ * \retval  Descriptor, NULL if the device does not accept the command or if
+ *          it is truncated. The parsing must then stop.
+ */
+static inline const LoRaMacCommand_t *LoRaMacCommandsGetDownlink(const LoRaMacCommand_t *table, uint8_t nbCommands, uint8_t cid, uint8_t remaining)
+{
+	if ((cid >= nbCommands) || ((table[cid].Flags & LORAMAC_COMMAND_DOWNLINK) == 0) || (table[cid].RxSize > remaining))
+	{
+		return NULL;
+	}
+	return &table[cid];
+}
+
+/*!
+ * \brief Copies the sticky commands of the device commands
+ *
+ * \param   table           - Descriptors, indexed by CID
+ * \param   nbCommands      - Number of descriptors
+ * \param   buffer          - Device commands
+ * \param   size            - Size of the device commands
+ * \param   sticky          - Buffer receiving the sticky commands, size bytes
+ * \retval  Size of the sticky commands
+ */
+uint8_t LoRaMacCommandsGetSticky(const LoRaMacCommand_t *table, uint8_t nbCommands, const uint8_t *buffer, uint8_t size, uint8_t *sticky);
+
+#endif // __LORAMAC_COMMANDS_H__
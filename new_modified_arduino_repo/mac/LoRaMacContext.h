@@ -0,0 +1,413 @@
+/*!
+ * \file      LoRaMacContext.h
+ *
+ * \brief     LoRa MAC layer instance context
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \defgroup  LORAMAC_CONTEXT LoRa MAC layer instance context
+ *            Holds the complete state of a LoRaMAC instance. The
+ *            LoRaMacCtx functions run on the given instance, the functions
+ *            without a context parameter on the default instance.
+ *
+ *            Only one instance is active at a time. Radio events, timer
+ *            events and the primitives of the upper layer run on the active
+ *            instance. Every LoRaMacCtx call makes its instance the active
+ *            one, a host running several instances selects the owner of an
+ *            event with LoRaMacSetContext before dispatching it. On a switch
+ *            the region state (channels, bands, channel masks) of the
+ *            previous instance is saved to its context and the one of the
+ *            new instance is restored.
+ */
+#ifndef __LORAMAC_CONTEXT_H__
+#define __LORAMAC_CONTEXT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "LoRaMac.h"
+#include "region/Region.h"
+#include "LoRaMacCrypto.h"
+#include "LoRaMacAirtime.h"
+
+/*!
+ * Maximum PHY layer payload size
+ */
+#define LORAMAC_PHY_MAXPAYLOAD 255
+
+/*!
+ * Maximum MAC commands buffer size
+ */
+#define LORA_MAC_COMMAND_MAX_LENGTH 128
+
+/*!
+ * Maximum size of the uplink frame header: MHDR, FHDR with 15 bytes of
+ * FOpts and FPort. A join request (23 bytes including its MIC) fits too.
+ */
+#define LORAMAC_TX_HEADER_MAX_SIZE 24
+
+/*!
+ * Set to 1 to send the FRMPayload of an uplink directly from the buffer
+ * given to LoRaMacMcpsRequest instead of a copy kept by the MAC. Only MAC
+ * command payloads (FPort 0) are still copied, which saves
+ * LORAMAC_PHY_MAXPAYLOAD - LORA_MAC_COMMAND_MAX_LENGTH bytes of RAM per
+ * instance.
+ *
+ * \remark The payload is read again and encrypted again for every
+ *         (re)transmission of the frame, so the buffer must stay valid and
+ *         unchanged until McpsConfirm.
+ */
+#ifndef LORAMAC_ZERO_COPY_TX
+#define LORAMAC_ZERO_COPY_TX 0
+#endif
+
+#if (LORAMAC_ZERO_COPY_TX == 0)
+#define LORAMAC_TX_PAYLOAD_BUFFER_SIZE LORAMAC_PHY_MAXPAYLOAD
+#else
+#define LORAMAC_TX_PAYLOAD_BUFFER_SIZE LORA_MAC_COMMAND_MAX_LENGTH
+#endif
+
+/*!
+ * LoRaMAC instance context
+ */
+struct sLoRaMacContext
+{
+	/*!
+	 * LoRaMac region.
+	 */
+	LoRaMacRegion_t Region;
+	/*!
+	 * Device IEEE EUI
+	 */
+	uint8_t *LoRaMacDevEui;
+	/*!
+	 * Application IEEE EUI
+	 */
+	uint8_t *LoRaMacAppEui;
+	/*!
+	 * AES encryption/decryption cipher application key
+	 */
+	uint8_t *LoRaMacAppKey;
+	/*!
+	 * AES encryption/decryption cipher network session key
+	 */
+	uint8_t NwkSKey[16];
+	/*!
+	 * AES encryption/decryption cipher application session key
+	 */
+	uint8_t AppSKey[16];
+	/*!
+	 * Device nonce is a random value extracted by issuing a sequence of RSSI
+	 * measurements
+	 */
+	uint16_t LoRaMacDevNonce;
+	/*!
+	 * Network ID ( 3 bytes )
+	 */
+	uint32_t LoRaMacNetID;
+	/*!
+	 * Mote Address
+	 */
+	uint32_t DevAddr;
+	/*!
+	 * Multicast channels linked list
+	 */
+	MulticastParams_t *MulticastChannels;
+	/*!
+	 * Actual device class
+	 */
+	DeviceClass_t LoRaMacDeviceClass;
+	/*!
+	 * Indicates if the node is connected to a private or public network
+	 */
+	bool PublicNetwork;
+	/*!
+	 * Indicates if the node supports repeaters
+	 */
+	bool RepeaterSupport;
+	/*!
+	 * Header of the frame to be sent: MHDR, FHDR and FPort, or the whole
+	 * join request. The FRMPayload and the MIC are only assembled when the
+	 * frame is written to the radio.
+	 */
+	uint8_t TxHeader[LORAMAC_TX_HEADER_MAX_SIZE];
+	/*!
+	 * Length of TxHeader
+	 */
+	uint8_t TxHeaderLen;
+	/*!
+	 * Copy of the FRMPayload of the frame to be sent, in clear until the
+	 * frame is signed, encrypted after
+	 */
+	uint8_t TxPayloadBuffer[LORAMAC_TX_PAYLOAD_BUFFER_SIZE];
+	/*!
+	 * FRMPayload of the frame to be sent, in clear
+	 */
+	const uint8_t *TxPayload;
+	/*!
+	 * Set once TxPayloadBuffer holds the encrypted FRMPayload and TxMic the
+	 * MIC, retransmissions are then written without encrypting again
+	 */
+	bool TxFrameSigned;
+	/*!
+	 * MIC field of the signed frame
+	 */
+	uint8_t TxMic[4];
+	/*!
+	 * Key of the FRMPayload, NULL if the frame is sent without encryption
+	 * and MIC (proprietary frames, join request)
+	 */
+	const uint8_t *TxPayloadKey;
+	/*!
+	 * Length of the frame to be sent
+	 */
+	uint16_t LoRaMacBufferPktLen;
+	/*!
+	 * Length of the FRMPayload of the frame to be sent
+	 */
+	uint8_t LoRaMacTxPayloadLen;
+	/*!
+	 * Buffer containing the upper layer data.
+	 */
+	uint8_t LoRaMacRxPayload[LORAMAC_PHY_MAXPAYLOAD];
+	/*!
+	 * LoRaMAC frame counter. Each time a packet is sent the counter is incremented.
+	 * Only the 16 LSB bits are sent
+	 */
+	uint32_t UpLinkCounter;
+	/*!
+	 * LoRaMAC frame counter. Each time a packet is received the counter is incremented.
+	 * Only the 16 LSB bits are received
+	 */
+	uint32_t DownLinkCounter;
+	/*!
+	 * IsPacketCounterFixed enables the MIC field tests by fixing the
+	 * UpLinkCounter value
+	 */
+	bool IsUpLinkCounterFixed;
+	/*!
+	 * Used for test purposes. Disables the opening of the reception windows.
+	 */
+	bool IsRxWindowsEnabled;
+	/*!
+	 * Indicates if the MAC layer has already joined a network.
+	 */
+	eJoinStatus_t IsLoRaMacNetworkJoined;
+	/*!
+	 * LoRaMac ADR control status
+	 */
+	bool AdrCtrlOn;
+	/*!
+	 * Counts the number of missed ADR acknowledgements
+	 */
+	uint32_t AdrAckCounter;
+	/*!
+	 * If the node has sent a FRAME_TYPE_DATA_CONFIRMED_UP this variable indicates
+	 * if the nodes needs to manage the server acknowledgement.
+	 */
+	bool NodeAckRequested;
+	/*!
+	 * If the server has sent a FRAME_TYPE_DATA_CONFIRMED_DOWN this variable indicates
+	 * if the ACK bit must be set for the next transmission
+	 */
+	bool SrvAckRequested;
+	/*!
+	 * Indicates if the MAC layer wants to send MAC commands
+	 */
+	bool MacCommandsInNextTx;
+	/*!
+	 * Contains the current MacCommandsBuffer index
+	 */
+	uint8_t MacCommandsBufferIndex;
+	/*!
+	 * Contains the current MacCommandsBuffer index for MAC commands to repeat
+	 */
+	uint8_t MacCommandsBufferToRepeatIndex;
+	/*!
+	 * Buffer containing the MAC layer commands
+	 */
+	uint8_t MacCommandsBuffer[LORA_MAC_COMMAND_MAX_LENGTH];
+	/*!
+	 * Buffer containing the MAC layer commands which must be repeated
+	 */
+	uint8_t MacCommandsBufferToRepeat[LORA_MAC_COMMAND_MAX_LENGTH];
+	/*!
+	 * LoRaMac parameters
+	 */
+	LoRaMacParams_t Params;
+	/*!
+	 * LoRaMac default parameters
+	 */
+	LoRaMacParams_t ParamsDefaults;
+	/*!
+	 * Uplink messages repetitions counter
+	 */
+	uint8_t ChannelsNbRepCounter;
+	/*!
+	 * Maximum duty cycle
+	 * \remark Possibility to shutdown the device.
+	 */
+	uint8_t MaxDCycle;
+	/*!
+	 * Aggregated duty cycle management
+	 */
+	uint16_t AggregatedDCycle;
+	TimerTime_t AggregatedLastTxDoneTime;
+	TimerTime_t AggregatedTimeOff;
+	/*!
+	 * Airtime of the uplinks over the last hour, see LoRaMacAirtime.h
+	 */
+	LoRaMacAirtime_t Airtime;
+	/*!
+	 * Enables/Disables duty cycle management (Test only)
+	 */
+	bool DutyCycleOn;
+	/*!
+	 * Current channel index
+	 */
+	uint8_t Channel;
+	/*!
+	 * Current channel index
+	 */
+	uint8_t LastTxChannel;
+	/*!
+	 * Set to true, if the last uplink was a join request
+	 */
+	bool LastTxIsJoinRequest;
+	/*!
+	 * Stores the time at LoRaMac initialization.
+	 *
+	 * \remark Used for the BACKOFF_DC computation.
+	 */
+	TimerTime_t LoRaMacInitializationTime;
+	/*!
+	 * LoRaMac internal state
+	 */
+	uint32_t State;
+	/*!
+	 * LoRaMac timer used to check the LoRaMacState (runs every second)
+	 */
+	TimerEvent_t MacStateCheckTimer;
+	/*!
+	 * LoRaMac upper layer event functions
+	 */
+	LoRaMacPrimitives_t *LoRaMacPrimitives;
+	/*!
+	 * LoRaMac upper layer callback functions
+	 */
+	LoRaMacCallback_t *LoRaMacCallbacks;
+	/*!
+	 * LoRaMac duty cycle delayed Tx timer
+	 */
+	TimerEvent_t TxDelayedTimer;
+	/*!
+	 * LoRaMac reception windows timers
+	 */
+	TimerEvent_t RxWindowTimer1;
+	TimerEvent_t RxWindowTimer2;
+	/*!
+	 * LoRaMac reception windows delay
+	 * \remark normal frame: RxWindowXDelay = ReceiveDelayX - RADIO_WAKEUP_TIME
+	 *         join frame  : RxWindowXDelay = JoinAcceptDelayX - RADIO_WAKEUP_TIME
+	 */
+	uint32_t RxWindow1Delay;
+	uint32_t RxWindow2Delay;
+	/*!
+	 * LoRaMac Rx windows configuration
+	 */
+	RxConfigParams_t RxWindow1Config;
+	RxConfigParams_t RxWindow2Config;
+	/*!
+	 * Maximum number of times the MAC layer tries to get an acknowledge.
+	 */
+	uint8_t MaxAckRetries;
+	/*!
+	 * Acknowledge timeout timer. Used for packet retransmissions.
+	 */
+	TimerEvent_t AckTimeoutTimer;
+	/*!
+	 * Number of trials to get a frame acknowledged
+	 */
+	uint8_t AckTimeoutRetries;
+	/*!
+	 * Number of trials to get a frame acknowledged
+	 */
+	uint8_t AckTimeoutRetriesCounter;
+	/*!
+	 * Indicates if the AckTimeout timer has expired or not
+	 */
+	bool AckTimeoutRetry;
+	/*!
+	 * Last transmission time on air
+	 */
+	TimerTime_t TxTimeOnAir;
+	/*!
+	 * Number of trials for the Join Request
+	 */
+	uint8_t JoinRequestTrials;
+	/*!
+	 * Maximum number of trials for the Join Request
+	 */
+	uint8_t MaxJoinRequestTrials;
+	/*!
+	 * Structure to hold an MCPS indication data.
+	 */
+	McpsIndication_t McpsIndication;
+	/*!
+	 * Structure to hold MCPS confirm data.
+	 */
+	McpsConfirm_t McpsConfirm;
+	/*!
+	 * Structure to hold MLME confirm data.
+	 */
+	MlmeConfirm_t MlmeConfirm;
+	/*!
+	 * Holds the current rx window slot
+	 */
+	uint8_t RxSlot;
+	/*!
+	 * LoRaMac tx/rx operation state
+	 */
+	LoRaMacFlags_t LoRaMacFlags;
+	/*!
+	 * Set until the first join request after the initialization is sent
+	 */
+	bool SendJoinNow;
+	/*!
+	 * Crypto context, NULL to use the one shared with the crypto functions
+	 * without a context parameter. Instances may share a crypto context as
+	 * long as they run in the same thread.
+	 */
+	LoRaMacCryptoCtx_t *Crypto;
+	/*!
+	 * Region state, valid while the instance is not the active one
+	 */
+	RegionContext_t RegionContext;
+	/*!
+	 * Session log, NULL if the session is not persisted
+	 */
+	struct sLoRaMacNvm *Nvm;
+	/*!
+	 * Set when the session changed (join, accepted MAC command) and a
+	 * snapshot must be written once the MAC is idle
+	 */
+	bool NvmSessionChanged;
+	/*!
+	 * Set to true, once the instance is initialized
+	 */
+	bool Initialized;
+};
+
+/*!
+ * The names below used to be globals of the MAC layer. They now refer to
+ * the default instance. Define LORAMAC_NO_COMPAT_NAMES to hide them.
+ */
+#if !defined(LORAMAC_NO_COMPAT_NAMES)
+#define LoRaMacState (LoRaMacGetDefaultContext()->State)
+#define LoRaMacRegion (LoRaMacGetDefaultContext()->Region)
+#define LoRaMacNwkSKey (LoRaMacGetDefaultContext()->NwkSKey)
+#define LoRaMacAppSKey (LoRaMacGetDefaultContext()->AppSKey)
+#define LoRaMacDevAddr (LoRaMacGetDefaultContext()->DevAddr)
+#define max_ack_retries (LoRaMacGetDefaultContext()->MaxAckRetries)
+#endif
+
+#endif // __LORAMAC_CONTEXT_H__
@@ -19,6 +19,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 */
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include "utilities.h"
 
 #include "aes.h"
@@ -26,79 +28,266 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 
 #include "LoRaMacCrypto.h"
 
+/*
+ * LoRaMacCryptoCtxVerifyAndDecrypt holds the entries of the MIC and the
+ * payload key at the same time
+ */
+#if LORAMAC_CRYPTO_KEY_CACHE_SIZE < 2
+#error "LORAMAC_CRYPTO_KEY_CACHE_SIZE must be at least 2"
+#endif
+
 /*!
  * CMAC/AES Message Integrity Code (MIC) Block B0 size
  */
 #define LORAMAC_MIC_BLOCK_B0_SIZE 16
 
 /*!
- * MIC field computation initial data
+ * Context used by the functions without a context parameter
  */
-static uint8_t MicBlockB0[] = {0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-							   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+static LORAMAC_THREAD_LOCAL LoRaMacCryptoCtx_t DefaultCtx;
 
 /*!
- * Contains the computed MIC field.
+ * \brief Compares two AES keys
  *
- * \remark Only the 4 first bytes are used
+ * \param  a First key
+ * \param  b Second key
+ * \retval [true: keys are equal, false: keys differ]
  */
-static uint8_t Mic[16];
+static bool KeyEquals(const uint8_t *a, const uint8_t *b)
+{
+	uint8_t diff = 0;
+
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		diff |= a[i] ^ b[i];
+	}
+	return diff == 0;
+}
 
 /*!
- * Encryption aBlock and sBlock
+ * \brief Returns the key cache entry of the given key. The key schedule and
+ *        the CMAC subkeys are computed only if the key is not yet part of
+ *        the cache.
+ *
+ * \param  ctx Crypto context
+ * \param  key AES key
+ * \retval Key cache entry
  */
-static uint8_t aBlock[] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-						   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-static uint8_t sBlock[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-						   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+static LoRaMacCryptoKey_t *GetKey(LoRaMacCryptoCtx_t *ctx, const uint8_t *key)
+{
+	LoRaMacCryptoKey_t *keyCache = ctx->KeyCache;
+	LoRaMacCryptoKey_t *entry = &keyCache[0];
+
+	for (uint8_t i = 0; i < LORAMAC_CRYPTO_KEY_CACHE_SIZE; i++)
+	{
+		if ((keyCache[i].Valid == true) && (KeyEquals(keyCache[i].Key, key) == true))
+		{
+			keyCache[i].LastUse = ++ctx->KeyCacheUseCounter;
+			return &keyCache[i];
+		}
+		// Keep track of the slot to replace in case of a miss
+		if ((entry->Valid == true) && ((keyCache[i].Valid == false) || (keyCache[i].LastUse < entry->LastUse)))
+		{
+			entry = &keyCache[i];
+		}
+	}
+
+	AES_CMAC_SetKey(&entry->CmacContext, key);
+	memcpy1(entry->Key, key, 16);
+	entry->LastUse = ++ctx->KeyCacheUseCounter;
+	entry->Valid = true;
+
+	return entry;
+}
+
+void LoRaMacCryptoCtxInit(LoRaMacCryptoCtx_t *ctx)
+{
+	memset1((uint8_t *)ctx, 0, sizeof(LoRaMacCryptoCtx_t));
+}
+
+void LoRaMacCryptoCtxInvalidateKey(LoRaMacCryptoCtx_t *ctx, const uint8_t *key)
+{
+	for (uint8_t i = 0; i < LORAMAC_CRYPTO_KEY_CACHE_SIZE; i++)
+	{
+		if ((ctx->KeyCache[i].Valid == true) && (KeyEquals(ctx->KeyCache[i].Key, key) == true))
+		{
+			memset1((uint8_t *)&ctx->KeyCache[i], 0, sizeof(LoRaMacCryptoKey_t));
+		}
+	}
+}
+
+void LoRaMacCryptoCtxInvalidateKeys(LoRaMacCryptoCtx_t *ctx)
+{
+	memset1((uint8_t *)ctx->KeyCache, 0, sizeof(ctx->KeyCache));
+	ctx->KeyCacheUseCounter = 0;
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	memset1((uint8_t *)&ctx->Precompute, 0, sizeof(ctx->Precompute));
+#endif
+}
 
 /*!
- * AES computation context variable
+ * \brief Fills the MIC computation block B0
+ *
+ * \param  ctx             Crypto context
+ * \param  address         Frame address
+ * \param  dir             Frame direction [0: uplink, 1: downlink]
+ * \param  sequenceCounter Frame sequence counter
+ * \param  size            Size of the data the MIC is computed over
  */
-static lora_aes_context AesContext;
+static void SetMicBlockB0(LoRaMacCryptoCtx_t *ctx, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t size)
+{
+	uint8_t *micBlockB0 = ctx->MicBlockB0;
+
+	micBlockB0[0] = 0x49;
+	micBlockB0[1] = 0x00;
+	micBlockB0[2] = 0x00;
+	micBlockB0[3] = 0x00;
+	micBlockB0[4] = 0x00;
+
+	micBlockB0[5] = dir;
+
+	micBlockB0[6] = (address)&0xFF;
+	micBlockB0[7] = (address >> 8) & 0xFF;
+	micBlockB0[8] = (address >> 16) & 0xFF;
+	micBlockB0[9] = (address >> 24) & 0xFF;
+
+	micBlockB0[10] = (sequenceCounter)&0xFF;
+	micBlockB0[11] = (sequenceCounter >> 8) & 0xFF;
+	micBlockB0[12] = (sequenceCounter >> 16) & 0xFF;
+	micBlockB0[13] = (sequenceCounter >> 24) & 0xFF;
+
+	micBlockB0[14] = 0x00;
+	micBlockB0[15] = size & 0xFF;
+}
 
 /*!
- * CMAC computation context variable
+ * \brief Returns the first 4 bytes of the computed MIC as MIC field
+ *
+ * \param  ctx             Crypto context
+ * \retval MIC field
  */
-static AES_CMAC_CTX AesCmacCtx[1];
+static uint32_t GetMic(const LoRaMacCryptoCtx_t *ctx)
+{
+	const uint8_t *mic = ctx->Mic;
 
-void LoRaMacComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic)
+	return (uint32_t)((uint32_t)mic[3] << 24 | (uint32_t)mic[2] << 16 | (uint32_t)mic[1] << 8 | (uint32_t)mic[0]);
+}
+
+/*!
+ * \brief Computes the MIC of a frame into ctx->Mic
+ *
+ * \param  ctx             Crypto context
+ * \param  buffer          Data buffer
+ * \param  size            Data buffer size
+ * \param  key             AES key
+ * \param  address         Frame address
+ * \param  dir             Frame direction [0: uplink, 1: downlink]
+ * \param  sequenceCounter Frame sequence counter
+ * \param  done            Completion callback, NULL to block
+ * \param  context         Completion callback context
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t ComputeMic(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, LoRaMacCryptoDone_t done, void *context)
 {
-	MicBlockB0[5] = dir;
+	LoRaMacCryptoKey_t *entry = GetKey(ctx, key);
+	AES_CMAC_CTX *cmacContext = &entry->CmacContext;
+	const uint8_t *micState = NULL;
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	const LoRaMacCryptoPrecompute_t *precompute = &ctx->Precompute;
+
+	if ((precompute->MicValid == true) && (precompute->MicSize == (size & 0xFF)) &&
+		(precompute->Address == address) && (precompute->Dir == dir) &&
+		(precompute->SequenceCounter == sequenceCounter) && (KeyEquals(precompute->MicKey, key) == true))
+	{
+		// Continue after B0
+		micState = precompute->MicState;
+	}
+#endif
+	if (micState == NULL)
+	{
+		SetMicBlockB0(ctx, address, dir, sequenceCounter, size);
+	}
 
-	MicBlockB0[6] = (address)&0xFF;
-	MicBlockB0[7] = (address >> 8) & 0xFF;
-	MicBlockB0[8] = (address >> 16) & 0xFF;
-	MicBlockB0[9] = (address >> 24) & 0xFF;
+	if (ctx->Backend != NULL)
+	{
+		return ctx->Backend->Cmac(entry, micState, (micState == NULL) ? ctx->MicBlockB0 : NULL, buffer, size & 0xFF, ctx->Mic, done, context);
+	}
+
+	if (micState != NULL)
+	{
+		AES_CMAC_Restore(cmacContext, micState);
+	}
+	else
+	{
+		AES_CMAC_Reset(cmacContext);
 
-	MicBlockB0[10] = (sequenceCounter)&0xFF;
-	MicBlockB0[11] = (sequenceCounter >> 8) & 0xFF;
-	MicBlockB0[12] = (sequenceCounter >> 16) & 0xFF;
-	MicBlockB0[13] = (sequenceCounter >> 24) & 0xFF;
+		AES_CMAC_Update(cmacContext, ctx->MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE);
+	}
 
-	MicBlockB0[15] = size & 0xFF;
+	AES_CMAC_Update(cmacContext, buffer, size & 0xFF);
 
-	AES_CMAC_Init(AesCmacCtx);
+	AES_CMAC_Final(ctx->Mic, cmacContext);
 
-	AES_CMAC_SetKey(AesCmacCtx, key);
+	return LORAMAC_CRYPTO_SUCCESS;
+}
 
-	AES_CMAC_Update(AesCmacCtx, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE);
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxComputeMic(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic)
+{
+	LoRaMacCryptoStatus_t status = ComputeMic(ctx, buffer, size, key, address, dir, sequenceCounter, NULL, NULL);
 
-	AES_CMAC_Update(AesCmacCtx, buffer, size & 0xFF);
+	*mic = (status == LORAMAC_CRYPTO_SUCCESS) ? GetMic(ctx) : 0;
+	return status;
+}
 
-	AES_CMAC_Final(Mic, AesCmacCtx);
+/*!
+ * \brief Completion callback of an asynchronous MIC computation
+ *
+ * \param  context         Crypto context
+ * \param  status          Operation status
+ */
+static void OnMicDone(void *context, LoRaMacCryptoStatus_t status)
+{
+	LoRaMacCryptoCtx_t *ctx = (LoRaMacCryptoCtx_t *)context;
 
-	*mic = (uint32_t)((uint32_t)Mic[3] << 24 | (uint32_t)Mic[2] << 16 | (uint32_t)Mic[1] << 8 | (uint32_t)Mic[0]);
+	if (status == LORAMAC_CRYPTO_SUCCESS)
+	{
+		*ctx->MicOut = GetMic(ctx);
+	}
+	ctx->MicDone(ctx->MicDoneContext, status);
 }
 
-void LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer)
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxComputeMicAsync(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic, LoRaMacCryptoDone_t done, void *context)
 {
-	uint16_t i;
-	uint8_t bufferIndex = 0;
-	uint16_t ctr = 1;
+	LoRaMacCryptoStatus_t status;
+
+	ctx->MicDone = done;
+	ctx->MicDoneContext = context;
+	ctx->MicOut = mic;
 
-	memset1(AesContext.ksch, '\0', 240);
-	lora_aes_set_key(key, 16, &AesContext);
+	status = ComputeMic(ctx, buffer, size, key, address, dir, sequenceCounter, OnMicDone, ctx);
+	if (status == LORAMAC_CRYPTO_SUCCESS)
+	{
+		*mic = GetMic(ctx);
+	}
+	return status;
+}
+
+/*!
+ * \brief Fills a CTR counter block Ai
+ *
+ * \param  aBlock          Counter block
+ * \param  address         Frame address
+ * \param  dir             Frame direction [0: uplink, 1: downlink]
+ * \param  sequenceCounter Frame sequence counter
+ * \param  ctr             Block counter
+ */
+static void SetBlockA(uint8_t *aBlock, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t ctr)
+{
+	aBlock[0] = 0x01;
+	aBlock[1] = 0x00;
+	aBlock[2] = 0x00;
+	aBlock[3] = 0x00;
+	aBlock[4] = 0x00;
 
 	aBlock[5] = dir;
 
@@ -112,77 +301,675 @@ void LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *
 	aBlock[12] = (sequenceCounter >> 16) & 0xFF;
 	aBlock[13] = (sequenceCounter >> 24) & 0xFF;
 
-	while (size >= 16)
+	aBlock[14] = 0x00;
+	aBlock[15] = ctr;
+}
+
+/*!
+ * \brief Encrypts independent AES blocks with the backend of the context
+ *
+ * \param  ctx             Crypto context
+ * \param  key             Key cache entry
+ * \param  in              Input blocks
+ * \param  out             Encrypted blocks, may be the same as in
+ * \param  nbBlocks        Number of blocks
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t EncryptBlocks(const LoRaMacCryptoCtx_t *ctx, const LoRaMacCryptoKey_t *key, const uint8_t *in, uint8_t *out, uint16_t nbBlocks)
+{
+	if (ctx->Backend != NULL)
+	{
+		return ctx->Backend->Ecb(key, in, out, nbBlocks, NULL, NULL);
+	}
+	lora_aes_ecb_encrypt(in, out, nbBlocks, &key->CmacContext.rijndael);
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+/*!
+ * \brief Computes a sequence of CTR keystream blocks
+ *
+ * \param  ctx             Crypto context
+ * \param  key             Key cache entry
+ * \param  address         Frame address
+ * \param  dir             Frame direction [0: uplink, 1: downlink]
+ * \param  sequenceCounter Frame sequence counter
+ * \param  ctr             Counter of the first block
+ * \param  nbBlocks        Number of blocks to compute
+ * \param  keystream       Keystream, nbBlocks * 16 bytes
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t ComputeKeystream(const LoRaMacCryptoCtx_t *ctx, const LoRaMacCryptoKey_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t ctr, uint8_t nbBlocks, uint8_t *keystream)
+{
+	for (uint8_t i = 0; i < nbBlocks; i++)
+	{
+		SetBlockA(keystream + i * 16, address, dir, sequenceCounter, ctr++);
+	}
+
+	return EncryptBlocks(ctx, key, keystream, keystream, nbBlocks);
+}
+
+/*!
+ * \brief XORs a buffer with the keystream, one 32 bit word at a time
+ *
+ * \remark The buffers have no alignment requirements, the word accesses are
+ *         done through memcpy which compiles to plain loads/stores on targets
+ *         supporting unaligned accesses.
+ *
+ * \param  dst             Destination buffer, may be the same as src
+ * \param  src             Source buffer
+ * \param  keystream       Keystream
+ * \param  size            Number of bytes
+ */
+static void XorKeystream(uint8_t *dst, const uint8_t *src, const uint8_t *keystream, uint16_t size)
+{
+	uint32_t a;
+	uint32_t b;
+
+	while (size >= 4)
 	{
-		aBlock[15] = ((ctr)&0xFF);
-		ctr++;
-		lora_aes_encrypt(aBlock, sBlock, &AesContext);
-		for (i = 0; i < 16; i++)
+		memcpy(&a, src, 4);
+		memcpy(&b, keystream, 4);
+		a ^= b;
+		memcpy(dst, &a, 4);
+		dst += 4;
+		src += 4;
+		keystream += 4;
+		size -= 4;
+	}
+	while (size-- > 0)
+	{
+		*dst++ = *src++ ^ *keystream++;
+	}
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxComputeKeystream(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t size, uint8_t *keystream)
+{
+	return ComputeKeystream(ctx, GetKey(ctx, key), address, dir, sequenceCounter, 1, (size + 15) / 16, keystream);
+}
+
+/*!
+ * \brief Encrypts a FRMPayload
+ *
+ * \param  ctx             Crypto context
+ * \param  buffer          Data buffer
+ * \param  size            Data buffer size
+ * \param  key             AES key
+ * \param  address         Frame address
+ * \param  dir             Frame direction [0: uplink, 1: downlink]
+ * \param  sequenceCounter Frame sequence counter
+ * \param  encBuffer       Encrypted buffer
+ * \param  done            Completion callback, NULL to block
+ * \param  context         Completion callback context
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t PayloadEncrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer, LoRaMacCryptoDone_t done, void *context)
+{
+	uint16_t chunkSize;
+	uint8_t ctr = 1;
+	const LoRaMacCryptoKey_t *entry;
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	const LoRaMacCryptoPrecompute_t *precompute = &ctx->Precompute;
+
+	if ((precompute->NbBlocks > 0) && (precompute->Address == address) && (precompute->Dir == dir) &&
+		(precompute->SequenceCounter == sequenceCounter) && (KeyEquals(precompute->PayloadKey, key) == true))
+	{
+		chunkSize = T_MIN(size, precompute->NbBlocks * 16);
+		XorKeystream(encBuffer, buffer, (const uint8_t *)precompute->Keystream, chunkSize);
+		ctr += precompute->NbBlocks;
+		buffer += chunkSize;
+		encBuffer += chunkSize;
+		size -= chunkSize;
+	}
+#endif
+	if (size == 0)
+	{
+		return LORAMAC_CRYPTO_SUCCESS;
+	}
+
+	entry = GetKey(ctx, key);
+
+	if (ctx->Backend != NULL)
+	{
+		SetBlockA((uint8_t *)ctx->Keystream, address, dir, sequenceCounter, ctr);
+		return ctx->Backend->Ctr(entry, (uint8_t *)ctx->Keystream, buffer, encBuffer, size, done, context);
+	}
+
+	while (size > 0)
+	{
+		chunkSize = T_MIN(size, sizeof(ctx->Keystream));
+		if (ComputeKeystream(ctx, entry, address, dir, sequenceCounter, ctr, (chunkSize + 15) / 16, (uint8_t *)ctx->Keystream) != LORAMAC_CRYPTO_SUCCESS)
 		{
-			encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
+			return LORAMAC_CRYPTO_ERROR;
 		}
-		size -= 16;
-		bufferIndex += 16;
+		XorKeystream(encBuffer, buffer, (uint8_t *)ctx->Keystream, chunkSize);
+		ctr += LORAMAC_CRYPTO_CTR_BLOCKS;
+		buffer += chunkSize;
+		encBuffer += chunkSize;
+		size -= chunkSize;
 	}
 
-	if (size > 0)
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxPayloadEncrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer)
+{
+	return PayloadEncrypt(ctx, buffer, size, key, address, dir, sequenceCounter, encBuffer, NULL, NULL);
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxPayloadEncryptAsync(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer, LoRaMacCryptoDone_t done, void *context)
+{
+	return PayloadEncrypt(ctx, buffer, size, key, address, dir, sequenceCounter, encBuffer, done, context);
+}
+
+void LoRaMacCryptoCtxPrecompute(LoRaMacCryptoCtx_t *ctx, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t micSize, uint16_t payloadSize)
+{
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	LoRaMacCryptoPrecompute_t *precompute = &ctx->Precompute;
+
+	memset1((uint8_t *)precompute, 0, sizeof(LoRaMacCryptoPrecompute_t));
+
+	precompute->Address = address;
+	precompute->Dir = dir;
+	precompute->SequenceCounter = sequenceCounter;
+
+	// AES_CMAC_Restore needs data after B0
+	if ((micKey != NULL) && ((micSize & 0xFF) > 0))
 	{
-		aBlock[15] = ((ctr)&0xFF);
-		lora_aes_encrypt(aBlock, sBlock, &AesContext);
-		for (i = 0; i < size; i++)
+		SetMicBlockB0(ctx, address, dir, sequenceCounter, micSize);
+		// The chaining value after the first block is E( B0 )
+		if (EncryptBlocks(ctx, GetKey(ctx, micKey), ctx->MicBlockB0, precompute->MicState, 1) == LORAMAC_CRYPTO_SUCCESS)
+		{
+			memcpy1(precompute->MicKey, micKey, 16);
+			precompute->MicSize = micSize & 0xFF;
+			precompute->MicValid = true;
+		}
+	}
+
+	if ((payloadKey != NULL) && (payloadSize > 0))
+	{
+		uint8_t nbBlocks = T_MIN((payloadSize + 15) / 16, LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS);
+
+		// Nothing is precomputed if the backend fails
+		if (ComputeKeystream(ctx, GetKey(ctx, payloadKey), address, dir, sequenceCounter, 1, nbBlocks, (uint8_t *)precompute->Keystream) == LORAMAC_CRYPTO_SUCCESS)
 		{
-			encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
+			precompute->NbBlocks = nbBlocks;
+			memcpy1(precompute->PayloadKey, payloadKey, 16);
 		}
 	}
+#else
+	(void)ctx;
+	(void)micKey;
+	(void)payloadKey;
+	(void)address;
+	(void)dir;
+	(void)sequenceCounter;
+	(void)micSize;
+	(void)payloadSize;
+#endif
 }
 
-void LoRaMacPayloadDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer)
+/*!
+ * \brief Compares the received MIC with the computed one and clears the
+ *        decrypted FRMPayload on a mismatch, so a forged frame leaves no
+ *        plaintext behind
+ *
+ * \param  ctx             Crypto context
+ * \param  mic             Received MIC
+ * \param  computed        Set to false if the backend failed, the frame is
+ *                         then rejected
+ * \param  decBuffer       Decrypted FRMPayload
+ * \param  decSize         Size of the decrypted FRMPayload
+ * \retval                 True if the MIC matches
+ */
+static bool CheckMic(const LoRaMacCryptoCtx_t *ctx, uint32_t mic, bool computed, uint8_t *decBuffer, uint16_t decSize)
 {
-	LoRaMacPayloadEncrypt(buffer, size, key, address, dir, sequenceCounter, decBuffer);
+	if ((computed == true) && (mic == GetMic(ctx)))
+	{
+		return true;
+	}
+	if (decSize > 0)
+	{
+		memset1(decBuffer, 0, decSize);
+	}
+	return false;
 }
 
-void LoRaMacJoinComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic)
+bool LoRaMacCryptoCtxVerifyAndDecrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, uint32_t mic, const uint8_t *micKey, const uint8_t *payloadKey, uint8_t payloadIndex, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer)
 {
-	AES_CMAC_Init(AesCmacCtx);
+	LoRaMacCryptoKey_t *entry = GetKey(ctx, micKey);
+	AES_CMAC_CTX *cmacContext = &entry->CmacContext;
+	const LoRaMacCryptoKey_t *payloadEntry = NULL;
+	uint8_t *decStart = decBuffer;
+	uint16_t decSize;
+	uint16_t chunkSize;
+	uint8_t ctr = 1;
 
-	AES_CMAC_SetKey(AesCmacCtx, key);
+	size &= 0xFF;
 
-	AES_CMAC_Update(AesCmacCtx, buffer, size & 0xFF);
+	SetMicBlockB0(ctx, address, dir, sequenceCounter, size);
 
-	AES_CMAC_Final(Mic, AesCmacCtx);
+	if ((payloadKey == NULL) || (payloadIndex >= size))
+	{
+		payloadIndex = size;
+	}
+	decSize = size - payloadIndex;
 
-	*mic = (uint32_t)((uint32_t)Mic[3] << 24 | (uint32_t)Mic[2] << 16 | (uint32_t)Mic[1] << 8 | (uint32_t)Mic[0]);
+	if (ctx->Backend != NULL)
+	{
+		// Authenticate the whole frame, then decrypt the FRMPayload. A backend
+		// failure leaves ctx->Mic from an earlier frame, so it fails the check.
+		if (ctx->Backend->Cmac(entry, NULL, ctx->MicBlockB0, buffer, size, ctx->Mic, NULL, NULL) != LORAMAC_CRYPTO_SUCCESS)
+		{
+			return CheckMic(ctx, mic, false, decStart, decSize);
+		}
+		if (payloadIndex < size)
+		{
+			SetBlockA((uint8_t *)ctx->Keystream, address, dir, sequenceCounter, ctr);
+			if (ctx->Backend->Ctr(GetKey(ctx, payloadKey), (uint8_t *)ctx->Keystream, buffer + payloadIndex, decBuffer, size - payloadIndex, NULL, NULL) != LORAMAC_CRYPTO_SUCCESS)
+			{
+				return CheckMic(ctx, mic, false, decStart, decSize);
+			}
+		}
+		return CheckMic(ctx, mic, true, decStart, decSize);
+	}
+
+	if (payloadIndex < size)
+	{
+		payloadEntry = GetKey(ctx, payloadKey);
+	}
+
+	AES_CMAC_Reset(cmacContext);
+
+	AES_CMAC_Update(cmacContext, ctx->MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE);
+
+	// Frame header, authenticated only
+	AES_CMAC_Update(cmacContext, buffer, payloadIndex);
+	buffer += payloadIndex;
+	size -= payloadIndex;
+
+	// FRMPayload, each chunk is authenticated and then decrypted
+	while (size > 0)
+	{
+		chunkSize = T_MIN(size, sizeof(ctx->Keystream));
+		AES_CMAC_Update(cmacContext, buffer, chunkSize);
+		if (ComputeKeystream(ctx, payloadEntry, address, dir, sequenceCounter, ctr, (chunkSize + 15) / 16, (uint8_t *)ctx->Keystream) != LORAMAC_CRYPTO_SUCCESS)
+		{
+			return CheckMic(ctx, mic, false, decStart, decSize);
+		}
+		XorKeystream(decBuffer, buffer, (uint8_t *)ctx->Keystream, chunkSize);
+		ctr += LORAMAC_CRYPTO_CTR_BLOCKS;
+		buffer += chunkSize;
+		decBuffer += chunkSize;
+		size -= chunkSize;
+	}
+
+	AES_CMAC_Final(ctx->Mic, cmacContext);
+
+	return CheckMic(ctx, mic, true, decStart, decSize);
 }
 
-void LoRaMacJoinDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer)
+#if (LORAMAC_CRYPTO_CTR_BLOCKS < 2)
+#error "LORAMAC_CRYPTO_CTR_BLOCKS must be at least 2, the backend frame window keeps a partial block"
+#endif
+
+/*!
+ * \brief Encrypts and signs a frame with the crypto backend. The frame goes
+ *        through ctx->Keystream: each FRMPayload chunk is encrypted into it
+ *        and written, and the whole blocks in front of it are fed to the
+ *        CMAC chaining before the window is reused.
+ *
+ * \param  ctx             Crypto context
+ * \param  header          Frame header
+ * \param  headerSize      Frame header size
+ * \param  payload         FRMPayload, in clear
+ * \param  payloadSize     FRMPayload size
+ * \param  micKey          AES key used for the MIC
+ * \param  payloadKey      AES key used for the FRMPayload
+ * \param  address         Frame address
+ * \param  dir             Frame direction [0: uplink, 1: downlink]
+ * \param  sequenceCounter Frame sequence counter
+ * \param  write           Frame output
+ * \retval Operation status, the frame written so far is incomplete on failure
+ */
+static LoRaMacCryptoStatus_t BackendEncryptAndSign(LoRaMacCryptoCtx_t *ctx, const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint8_t payloadSize, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, LoRaMacCryptoWrite_t write)
 {
-	memset1(AesContext.ksch, '\0', 240);
-	lora_aes_set_key(key, 16, &AesContext);
-	lora_aes_encrypt(buffer, decBuffer, &AesContext);
-	// Check if optional CFList is included
-	if (size >= 16)
+	const LoRaMacCryptoBackend_t *backend = ctx->Backend;
+	const LoRaMacCryptoKey_t *entry = GetKey(ctx, micKey);
+	const LoRaMacCryptoKey_t *payloadEntry = NULL;
+	uint8_t *window = (uint8_t *)ctx->Keystream;
+	uint16_t size = headerSize + payloadSize;
+	const uint8_t *iv = NULL;
+	const uint8_t *prefix = ctx->MicBlockB0;
+	uint8_t counter[16];
+	uint16_t fill = 0;
+	uint16_t chunkSize;
+	uint16_t blocksSize;
+	uint8_t offset = headerSize;
+	uint8_t ctr = 1;
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	const LoRaMacCryptoPrecompute_t *precompute = &ctx->Precompute;
+	bool precomputed = (precompute->Address == address) && (precompute->Dir == dir) && (precompute->SequenceCounter == sequenceCounter);
+	bool keystreamPrecomputed = (precomputed == true) && (precompute->NbBlocks > 0) && (payloadSize > 0) &&
+								(KeyEquals(precompute->PayloadKey, payloadKey) == true);
+
+	if ((precomputed == true) && (precompute->MicValid == true) && (precompute->MicSize == (size & 0xFF)) &&
+		(KeyEquals(precompute->MicKey, micKey) == true))
+	{
+		// Continue after B0
+		iv = precompute->MicState;
+		prefix = NULL;
+	}
+	else
+#endif
+	{
+		SetMicBlockB0(ctx, address, dir, sequenceCounter, size);
+	}
+
+	if (payloadSize > 0)
 	{
-		lora_aes_encrypt(buffer + 16, decBuffer + 16, &AesContext);
+		payloadEntry = GetKey(ctx, payloadKey);
 	}
+
+	// Frame header, authenticated only
+	write(0, header, headerSize);
+	for (uint8_t i = 0; i < headerSize;)
+	{
+		chunkSize = T_MIN(headerSize - i, sizeof(ctx->Keystream) - fill);
+		if (chunkSize == 0)
+		{
+			// The window is full and more follows, so the last block is
+			// never chained here
+			if (backend->CmacUpdate(entry, iv, prefix, window, fill, ctx->Mic, NULL, NULL) != LORAMAC_CRYPTO_SUCCESS)
+			{
+				return LORAMAC_CRYPTO_ERROR;
+			}
+			iv = ctx->Mic;
+			prefix = NULL;
+			fill = 0;
+			continue;
+		}
+		memcpy1(window + fill, header + i, chunkSize);
+		fill += chunkSize;
+		i += chunkSize;
+	}
+
+	// FRMPayload, each chunk is encrypted into the window and written
+	while (payloadSize > 0)
+	{
+		if ((sizeof(ctx->Keystream) - fill) < 16)
+		{
+			blocksSize = fill & ~0x0F;
+			if (backend->CmacUpdate(entry, iv, prefix, window, blocksSize, ctx->Mic, NULL, NULL) != LORAMAC_CRYPTO_SUCCESS)
+			{
+				return LORAMAC_CRYPTO_ERROR;
+			}
+			iv = ctx->Mic;
+			prefix = NULL;
+			fill -= blocksSize;
+			memmove(window, window + blocksSize, fill);
+		}
+
+		chunkSize = T_MIN(payloadSize, (sizeof(ctx->Keystream) - fill) & ~0x0F);
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+		if ((keystreamPrecomputed == true) && (ctr <= precompute->NbBlocks))
+		{
+			chunkSize = T_MIN(chunkSize, (precompute->NbBlocks - (ctr - 1)) * 16);
+			XorKeystream(window + fill, payload, (const uint8_t *)precompute->Keystream + (ctr - 1) * 16, chunkSize);
+		}
+		else
+#endif
+		{
+			SetBlockA(counter, address, dir, sequenceCounter, ctr);
+			if (backend->Ctr(payloadEntry, counter, payload, window + fill, chunkSize, NULL, NULL) != LORAMAC_CRYPTO_SUCCESS)
+			{
+				return LORAMAC_CRYPTO_ERROR;
+			}
+		}
+		write(offset, window + fill, chunkSize);
+		fill += chunkSize;
+		ctr += chunkSize / 16;
+		payload += chunkSize;
+		offset += chunkSize;
+		payloadSize -= chunkSize;
+	}
+
+	if (backend->Cmac(entry, iv, prefix, window, fill, ctx->Mic, NULL, NULL) != LORAMAC_CRYPTO_SUCCESS)
+	{
+		return LORAMAC_CRYPTO_ERROR;
+	}
+
+	// The MIC field is the first 4 bytes, least significant byte first
+	write(offset, ctx->Mic, 4);
+	return LORAMAC_CRYPTO_SUCCESS;
 }
 
-void LoRaMacJoinComputeSKeys(const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey)
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxEncryptAndSign(LoRaMacCryptoCtx_t *ctx, const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint8_t payloadSize, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, LoRaMacCryptoWrite_t write)
 {
-	uint8_t nonce[16];
-	uint8_t *pDevNonce = (uint8_t *)&devNonce;
+	LoRaMacCryptoKey_t *entry = GetKey(ctx, micKey);
+	AES_CMAC_CTX *cmacContext = &entry->CmacContext;
+	const LoRaMacCryptoKey_t *payloadEntry = NULL;
+	const uint8_t *keystream;
+	uint16_t size = headerSize + payloadSize;
+	uint8_t offset = headerSize;
+	uint8_t chunkSize;
+	uint8_t ctr = 1;
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	const LoRaMacCryptoPrecompute_t *precompute = &ctx->Precompute;
+	bool precomputed;
+	bool keystreamPrecomputed;
+#endif
+
+	if (ctx->Backend != NULL)
+	{
+		return BackendEncryptAndSign(ctx, header, headerSize, payload, payloadSize, micKey, payloadKey, address, dir, sequenceCounter, write);
+	}
+
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	precomputed = (precompute->Address == address) && (precompute->Dir == dir) && (precompute->SequenceCounter == sequenceCounter);
+	keystreamPrecomputed = (precomputed == true) && (precompute->NbBlocks > 0) && (payloadSize > 0) &&
+								(KeyEquals(precompute->PayloadKey, payloadKey) == true);
+
+	if ((precomputed == true) && (precompute->MicValid == true) && (precompute->MicSize == (size & 0xFF)) &&
+		(KeyEquals(precompute->MicKey, micKey) == true))
+	{
+		// Continue after B0
+		AES_CMAC_Restore(cmacContext, precompute->MicState);
+	}
+	else
+#endif
+	{
+		SetMicBlockB0(ctx, address, dir, sequenceCounter, size);
+
+		AES_CMAC_Reset(cmacContext);
+
+		AES_CMAC_Update(cmacContext, ctx->MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE);
+	}
+
+	// Frame header, authenticated only
+	AES_CMAC_Update(cmacContext, header, headerSize);
+	write(0, header, headerSize);
+
+	// FRMPayload, each chunk is encrypted, authenticated and written
+	while (payloadSize > 0)
+	{
+		chunkSize = T_MIN(payloadSize, sizeof(ctx->Keystream));
+		keystream = (const uint8_t *)ctx->Keystream;
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+		if ((ctr == 1) && (keystreamPrecomputed == true))
+		{
+			chunkSize = T_MIN(chunkSize, precompute->NbBlocks * 16);
+			keystream = (const uint8_t *)precompute->Keystream;
+		}
+		else
+#endif
+		{
+			if (payloadEntry == NULL)
+			{
+				payloadEntry = GetKey(ctx, payloadKey);
+			}
+			// Software only, cannot fail
+			ComputeKeystream(ctx, payloadEntry, address, dir, sequenceCounter, ctr, (chunkSize + 15) / 16, (uint8_t *)ctx->Keystream);
+		}
+		XorKeystream((uint8_t *)ctx->Keystream, payload, keystream, chunkSize);
+		AES_CMAC_Update(cmacContext, (const uint8_t *)ctx->Keystream, chunkSize);
+		write(offset, (const uint8_t *)ctx->Keystream, chunkSize);
+		ctr += chunkSize / 16;
+		payload += chunkSize;
+		offset += chunkSize;
+		payloadSize -= chunkSize;
+	}
+
+	AES_CMAC_Final(ctx->Mic, cmacContext);
+
+	// The MIC field is the first 4 bytes, least significant byte first
+	write(offset, ctx->Mic, 4);
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxPayloadDecrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer)
+{
+	return LoRaMacCryptoCtxPayloadEncrypt(ctx, buffer, size, key, address, dir, sequenceCounter, decBuffer);
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxJoinComputeMic(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic)
+{
+	LoRaMacCryptoKey_t *entry = GetKey(ctx, key);
+	AES_CMAC_CTX *cmacContext = &entry->CmacContext;
 
-	memset1(AesContext.ksch, '\0', 240);
-	lora_aes_set_key(key, 16, &AesContext);
+	if (ctx->Backend != NULL)
+	{
+		LoRaMacCryptoStatus_t status = ctx->Backend->Cmac(entry, NULL, NULL, buffer, size & 0xFF, ctx->Mic, NULL, NULL);
+
+		if (status != LORAMAC_CRYPTO_SUCCESS)
+		{
+			*mic = 0;
+			return status;
+		}
+	}
+	else
+	{
+		AES_CMAC_Reset(cmacContext);
+
+		AES_CMAC_Update(cmacContext, buffer, size & 0xFF);
+
+		AES_CMAC_Final(ctx->Mic, cmacContext);
+	}
+
+	*mic = GetMic(ctx);
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxJoinDecrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer)
+{
+	// Check if optional CFList is included
+	return EncryptBlocks(ctx, GetKey(ctx, key), buffer, decBuffer, (size >= 16) ? 2 : 1);
+}
+
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxJoinComputeSKeys(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey)
+{
+	uint8_t nonce[32];
+	uint8_t *pDevNonce = (uint8_t *)&devNonce;
 
 	memset1(nonce, 0, sizeof(nonce));
 	nonce[0] = 0x01;
 	memcpy1(nonce + 1, appNonce, 6);
 	memcpy1(nonce + 7, pDevNonce, 2);
-	lora_aes_encrypt(nonce, nwkSKey, &AesContext);
 
-	memset1(nonce, 0, sizeof(nonce));
-	nonce[0] = 0x02;
-	memcpy1(nonce + 1, appNonce, 6);
-	memcpy1(nonce + 7, pDevNonce, 2);
-	lora_aes_encrypt(nonce, appSKey, &AesContext);
+	nonce[16] = 0x02;
+	memcpy1(nonce + 17, appNonce, 6);
+	memcpy1(nonce + 23, pDevNonce, 2);
+
+	// Both session keys in a single call
+	if (EncryptBlocks(ctx, GetKey(ctx, key), nonce, nonce, 2) != LORAMAC_CRYPTO_SUCCESS)
+	{
+		return LORAMAC_CRYPTO_ERROR;
+	}
+	memcpy1(nwkSKey, nonce, 16);
+	memcpy1(appSKey, nonce + 16, 16);
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+void LoRaMacCryptoCtxSetBackend(LoRaMacCryptoCtx_t *ctx, const LoRaMacCryptoBackend_t *backend)
+{
+	ctx->Backend = backend;
+}
+
+LoRaMacCryptoStatus_t LoRaMacComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic)
+{
+	return LoRaMacCryptoCtxComputeMic(&DefaultCtx, buffer, size, key, address, dir, sequenceCounter, mic);
+}
+
+LoRaMacCryptoStatus_t LoRaMacComputeKeystream(const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t size, uint8_t *keystream)
+{
+	return LoRaMacCryptoCtxComputeKeystream(&DefaultCtx, key, address, dir, sequenceCounter, size, keystream);
+}
+
+void LoRaMacPrecompute(const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t micSize, uint16_t payloadSize)
+{
+	LoRaMacCryptoCtxPrecompute(&DefaultCtx, micKey, payloadKey, address, dir, sequenceCounter, micSize, payloadSize);
+}
+
+LoRaMacCryptoStatus_t LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer)
+{
+	return LoRaMacCryptoCtxPayloadEncrypt(&DefaultCtx, buffer, size, key, address, dir, sequenceCounter, encBuffer);
+}
+
+bool LoRaMacVerifyAndDecrypt(const uint8_t *buffer, uint16_t size, uint32_t mic, const uint8_t *micKey, const uint8_t *payloadKey, uint8_t payloadIndex, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer)
+{
+	return LoRaMacCryptoCtxVerifyAndDecrypt(&DefaultCtx, buffer, size, mic, micKey, payloadKey, payloadIndex, address, dir, sequenceCounter, decBuffer);
+}
+
+LoRaMacCryptoStatus_t LoRaMacEncryptAndSign(const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint8_t payloadSize, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, LoRaMacCryptoWrite_t write)
+{
+	return LoRaMacCryptoCtxEncryptAndSign(&DefaultCtx, header, headerSize, payload, payloadSize, micKey, payloadKey, address, dir, sequenceCounter, write);
+}
+
+LoRaMacCryptoStatus_t LoRaMacPayloadDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer)
+{
+	return LoRaMacCryptoCtxPayloadEncrypt(&DefaultCtx, buffer, size, key, address, dir, sequenceCounter, decBuffer);
+}
+
+LoRaMacCryptoStatus_t LoRaMacJoinComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic)
+{
+	return LoRaMacCryptoCtxJoinComputeMic(&DefaultCtx, buffer, size, key, mic);
+}
+
+LoRaMacCryptoStatus_t LoRaMacJoinDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer)
+{
+	return LoRaMacCryptoCtxJoinDecrypt(&DefaultCtx, buffer, size, key, decBuffer);
+}
+
+LoRaMacCryptoStatus_t LoRaMacJoinComputeSKeys(const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey)
+{
+	return LoRaMacCryptoCtxJoinComputeSKeys(&DefaultCtx, key, appNonce, devNonce, nwkSKey, appSKey);
+}
+
+LoRaMacCryptoStatus_t LoRaMacComputeMicAsync(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic, LoRaMacCryptoDone_t done, void *context)
+{
+	return LoRaMacCryptoCtxComputeMicAsync(&DefaultCtx, buffer, size, key, address, dir, sequenceCounter, mic, done, context);
+}
+
+LoRaMacCryptoStatus_t LoRaMacPayloadEncryptAsync(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer, LoRaMacCryptoDone_t done, void *context)
+{
+	return LoRaMacCryptoCtxPayloadEncryptAsync(&DefaultCtx, buffer, size, key, address, dir, sequenceCounter, encBuffer, done, context);
+}
+
+void LoRaMacCryptoSetBackend(const LoRaMacCryptoBackend_t *backend)
+{
+	LoRaMacCryptoCtxSetBackend(&DefaultCtx, backend);
+}
+
+void LoRaMacCryptoInvalidateKey(const uint8_t *key)
+{
+	LoRaMacCryptoCtxInvalidateKey(&DefaultCtx, key);
+}
+
+void LoRaMacCryptoInvalidateKeys(void)
+{
+	LoRaMacCryptoCtxInvalidateKeys(&DefaultCtx);
+}
+
+LoRaMacCryptoCtx_t *LoRaMacCryptoGetDefaultCtx(void)
+{
+	return &DefaultCtx;
 }
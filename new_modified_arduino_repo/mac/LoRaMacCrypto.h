@@ -35,6 +35,166 @@
 #ifndef __LORAMAC_CRYPTO_H__
 #define __LORAMAC_CRYPTO_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmac.h"
+#include "LoRaMacCryptoBackend.h"
+
+/*!
+ * Number of expanded AES key schedules kept in the crypto key cache.
+ *
+ * \remark The unicast session uses 2 keys (NwkSKey, AppSKey), each linked
+ *         multicast channel 2 more and the join procedure the AppKey.
+ */
+#ifndef LORAMAC_CRYPTO_KEY_CACHE_SIZE
+#define LORAMAC_CRYPTO_KEY_CACHE_SIZE 4
+#endif
+
+/*!
+ * Number of CTR counter blocks LoRaMacPayloadEncrypt encrypts per batch.
+ *
+ * \remark The keystream buffer uses 16 bytes of RAM per block. 16 blocks
+ *         cover the largest FRMPayload (242 bytes) in a single batch. The
+ *         buffer is also the frame window of LoRaMacEncryptAndSign with a
+ *         crypto backend, which needs at least 2 blocks.
+ */
+#ifndef LORAMAC_CRYPTO_CTR_BLOCKS
+#define LORAMAC_CRYPTO_CTR_BLOCKS 4
+#endif
+
+/*!
+ * Size of the keystream computed by LoRaMacComputeKeystream for a payload
+ * of the given size (rounded up to full AES blocks)
+ */
+#define LORAMAC_CRYPTO_KEYSTREAM_SIZE(size) ((((size) + 15) / 16) * 16)
+
+/*!
+ * Number of keystream blocks LoRaMacPrecompute computes ahead. Set to 0 to
+ * leave the precomputation out.
+ *
+ * \remark Uses 16 bytes of RAM per block plus about 60 bytes.
+ */
+#ifndef LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS
+#define LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS 4
+#endif
+
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+/*!
+ * Crypto state precomputed for a future frame
+ */
+typedef struct sLoRaMacCryptoPrecompute
+{
+	/*!
+	 * Key the MIC state was computed with
+	 */
+	uint8_t MicKey[16];
+	/*!
+	 * Key the keystream was computed with
+	 */
+	uint8_t PayloadKey[16];
+	/*!
+	 * Frame address
+	 */
+	uint32_t Address;
+	/*!
+	 * Frame sequence counter
+	 */
+	uint32_t SequenceCounter;
+	/*!
+	 * Frame direction [0: uplink, 1: downlink]
+	 */
+	uint8_t Dir;
+	/*!
+	 * Frame size (without the MIC field) B0 was computed for
+	 */
+	uint8_t MicSize;
+	/*!
+	 * Set to true, if MicState is valid
+	 */
+	bool MicValid;
+	/*!
+	 * Number of valid keystream blocks
+	 */
+	uint8_t NbBlocks;
+	/*!
+	 * CMAC chaining value after B0
+	 */
+	uint8_t MicState[16];
+	/*!
+	 * First keystream blocks of the FRMPayload
+	 */
+	uint32_t Keystream[LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS * 4];
+} LoRaMacCryptoPrecompute_t;
+#endif
+
+/*!
+ * Output of LoRaMacEncryptAndSign, writes a part of the frame at the given
+ * offset. Radio.WriteTxBuffer can be used directly. Each part is written
+ * after the input it comes from was read, so the output may store the
+ * encrypted FRMPayload over the clear one.
+ */
+typedef void (*LoRaMacCryptoWrite_t)(uint8_t offset, const uint8_t *buffer, uint8_t size);
+
+/*!
+ * Crypto context. Holds the key schedule cache and all scratch buffers of
+ * the crypto functions.
+ *
+ * \remark The LoRaMacCryptoCtx functions only use the given context, so
+ *         threads (or an ISR and a task) using different contexts can run
+ *         them concurrently. The functions without a context parameter use
+ *         a single internal context.
+ */
+typedef struct sLoRaMacCryptoCtx
+{
+	/*!
+	 * Key schedule cache. Entries are looked up by the key value, so a key
+	 * which is overwritten in place (e.g. after a join) can never hit a
+	 * stale schedule.
+	 */
+	LoRaMacCryptoKey_t KeyCache[LORAMAC_CRYPTO_KEY_CACHE_SIZE];
+	/*!
+	 * Key schedule cache use counter
+	 */
+	uint32_t KeyCacheUseCounter;
+	/*!
+	 * CMAC/AES Message Integrity Code (MIC) Block B0
+	 */
+	uint8_t MicBlockB0[16];
+	/*!
+	 * Contains the computed MIC field.
+	 *
+	 * \remark Only the 4 first bytes are used
+	 */
+	uint8_t Mic[16];
+	/*!
+	 * Encryption keystream. Holds the counter blocks Ai which are encrypted
+	 * in place to the keystream blocks Si.
+	 */
+	uint32_t Keystream[LORAMAC_CRYPTO_CTR_BLOCKS * 4];
+#if (LORAMAC_CRYPTO_PRECOMPUTE_BLOCKS > 0)
+	/*!
+	 * State precomputed by LoRaMacCryptoCtxPrecompute
+	 */
+	LoRaMacCryptoPrecompute_t Precompute;
+#endif
+	/*!
+	 * Crypto backend, NULL for the built-in software implementation
+	 */
+	const LoRaMacCryptoBackend_t *Backend;
+	/*!
+	 * Completion callback of the pending asynchronous MIC computation
+	 */
+	LoRaMacCryptoDone_t MicDone;
+	/*!
+	 * Completion callback context of the pending asynchronous MIC computation
+	 */
+	void *MicDoneContext;
+	/*!
+	 * Result of the pending asynchronous MIC computation
+	 */
+	uint32_t *MicOut;
+} LoRaMacCryptoCtx_t;
+
 /*!
  * Computes the LoRaMAC frame MIC field
  *
@@ -44,9 +204,10 @@
  * \param   address         - Frame address
  * \param   dir             - Frame direction [0: uplink, 1: downlink]
  * \param   sequenceCounter - Frame sequence counter
- * \param  mic             - Computed MIC field
+ * \param  mic             - Computed MIC field, 0 if the backend failed
+ * \retval  Operation status
  */
-void LoRaMacComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic);
+LoRaMacCryptoStatus_t LoRaMacComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic);
 
 /*!
  * Computes the LoRaMAC payload encryption
@@ -58,8 +219,24 @@ void LoRaMacComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key,
  * \param   dir             - Frame direction [0: uplink, 1: downlink]
  * \param   sequenceCounter - Frame sequence counter
  * \param  encBuffer       - Encrypted buffer
+ * \retval  Operation status
  */
-void LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer);
+LoRaMacCryptoStatus_t LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer);
+
+/*!
+ * Computes the LoRaMAC payload encryption keystream. All counter blocks are
+ * encrypted in a single call, so they can run interleaved on backends
+ * supporting it. The payload is encrypted by XORing it with the keystream.
+ *
+ * \param   key             - AES key to be used
+ * \param   address         - Frame address
+ * \param   dir             - Frame direction [0: uplink, 1: downlink]
+ * \param   sequenceCounter - Frame sequence counter
+ * \param   size            - Payload size
+ * \param  keystream       - Keystream, LORAMAC_CRYPTO_KEYSTREAM_SIZE( size ) bytes
+ * \retval  Operation status
+ */
+LoRaMacCryptoStatus_t LoRaMacComputeKeystream(const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t size, uint8_t *keystream);
 
 /*!
  * Computes the LoRaMAC payload decryption
@@ -71,8 +248,59 @@ void LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *
  * \param   dir             - Frame direction [0: uplink, 1: downlink]
  * \param   sequenceCounter - Frame sequence counter
  * \param  decBuffer       - Decrypted buffer
+ * \retval  Operation status
+ */
+LoRaMacCryptoStatus_t LoRaMacPayloadDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer);
+
+/*!
+ * Verifies the MIC of a received frame and decrypts its FRMPayload in a
+ * single pass over the frame
+ *
+ * \remark decBuffer is cleared if the MIC check fails. The FRMPayload is
+ *         authenticated before it is decrypted, so decBuffer may be the
+ *         FRMPayload itself (buffer + payloadIndex).
+ *
+ * \param   buffer          - Frame, without the MIC field
+ * \param   size            - Frame size, without the MIC field
+ * \param   mic             - Received MIC field
+ * \param   micKey          - AES key used for the MIC (NwkSKey)
+ * \param   payloadKey      - AES key used for the FRMPayload, NULL to skip
+ *                            the decryption
+ * \param   payloadIndex    - Index of the FRMPayload in buffer
+ * \param   address         - Frame address
+ * \param   dir             - Frame direction [0: uplink, 1: downlink]
+ * \param   sequenceCounter - Frame sequence counter
+ * \param  decBuffer       - Decrypted FRMPayload
+ * \retval  [true: MIC is valid, false: MIC is invalid]
  */
-void LoRaMacPayloadDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer);
+bool LoRaMacVerifyAndDecrypt(const uint8_t *buffer, uint16_t size, uint32_t mic, const uint8_t *micKey, const uint8_t *payloadKey, uint8_t payloadIndex, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer);
+
+/*!
+ * Encrypts the FRMPayload of a frame and computes its MIC in a single pass,
+ * writing the frame in parts to the given output: the header, the encrypted
+ * FRMPayload chunk by chunk and the MIC field. The frame is never assembled
+ * in RAM, at most sizeof( Keystream ) bytes of encrypted payload are kept
+ * at a time.
+ *
+ * \remark With a crypto backend the chunks are encrypted by the backend
+ *         into the same Keystream buffer, the CMAC is chained over the whole
+ *         blocks with CmacUpdate and finished with Cmac. The state
+ *         precomputed by LoRaMacPrecompute is used if its parameters match.
+ *
+ * \param   header          - Frame header (MHDR, FHDR, FPort)
+ * \param   headerSize      - Frame header size
+ * \param   payload         - FRMPayload, in clear
+ * \param   payloadSize     - FRMPayload size
+ * \param   micKey          - AES key used for the MIC (NwkSKey)
+ * \param   payloadKey      - AES key used for the FRMPayload
+ * \param   address         - Frame address
+ * \param   dir             - Frame direction [0: uplink, 1: downlink]
+ * \param   sequenceCounter - Frame sequence counter
+ * \param   write           - Frame output
+ * \retval  Operation status. If the backend fails the frame written so far
+ *          is incomplete, its MIC is not written, and must not be sent.
+ */
+LoRaMacCryptoStatus_t LoRaMacEncryptAndSign(const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint8_t payloadSize, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, LoRaMacCryptoWrite_t write);
 
 /*!
  * Computes the LoRaMAC Join Request frame MIC field
@@ -80,9 +308,10 @@ void LoRaMacPayloadDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *
  * \param   buffer          - Data buffer
  * \param   size            - Data buffer size
  * \param   key             - AES key to be used
- * \param  mic             - Computed MIC field
+ * \param  mic             - Computed MIC field, 0 if the backend failed
+ * \retval  Operation status
  */
-void LoRaMacJoinComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic);
+LoRaMacCryptoStatus_t LoRaMacJoinComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic);
 
 /*!
  * Computes the LoRaMAC join frame decryption
@@ -91,8 +320,9 @@ void LoRaMacJoinComputeMic(const uint8_t *buffer, uint16_t size, const uint8_t *
  * \param   size            - Data buffer size
  * \param   key             - AES key to be used
  * \param  decBuffer       - Decrypted buffer
+ * \retval  Operation status
  */
-void LoRaMacJoinDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer);
+LoRaMacCryptoStatus_t LoRaMacJoinDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer);
 
 /*!
  * Computes the LoRaMAC join frame decryption
@@ -102,7 +332,186 @@ void LoRaMacJoinDecrypt(const uint8_t *buffer, uint16_t size, const uint8_t *key
  * \param   devNonce        - Device nonce
  * \param  nwkSKey         - Network session key
  * \param  appSKey         - Application session key
+ * \retval  Operation status, the keys are only written on success
+ */
+LoRaMacCryptoStatus_t LoRaMacJoinComputeSKeys(const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey);
+
+/*!
+ * Precomputes the parts of the frame crypto which do not depend on the frame
+ * content: the CMAC state after B0 and the first keystream blocks. Meant to
+ * be called while the MCU is idle ahead of a frame.
+ *
+ * LoRaMacComputeMic and LoRaMacPayloadEncrypt use the precomputed state if
+ * their parameters match, otherwise they compute everything as usual.
+ *
+ * \param   micKey          - AES key to be used for the MIC, NULL to skip
+ * \param   payloadKey      - AES key to be used for the payload, NULL to skip
+ * \param   address         - Frame address
+ * \param   dir             - Frame direction [0: uplink, 1: downlink]
+ * \param   sequenceCounter - Frame sequence counter
+ * \param   micSize         - Expected frame size, without the MIC field
+ * \param   payloadSize     - Expected payload size
+ */
+void LoRaMacPrecompute(const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t micSize, uint16_t payloadSize);
+
+/*!
+ * Asynchronous version of LoRaMacComputeMic. With a backend completing in the
+ * background the call returns LORAMAC_CRYPTO_PENDING and done is called once
+ * mic is written.
+ *
+ * \remark buffer must stay valid and no other crypto function may be called
+ *         until the computation is finished
+ *
+ * \param   buffer          - Data buffer
+ * \param   size            - Data buffer size
+ * \param   key             - AES key to be used
+ * \param   address         - Frame address
+ * \param   dir             - Frame direction [0: uplink, 1: downlink]
+ * \param   sequenceCounter - Frame sequence counter
+ * \param  mic             - Computed MIC field
+ * \param   done            - Completion callback
+ * \param   context         - Completion callback context
+ * \retval  Operation status, done is only called for LORAMAC_CRYPTO_PENDING
+ */
+LoRaMacCryptoStatus_t LoRaMacComputeMicAsync(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic, LoRaMacCryptoDone_t done, void *context);
+
+/*!
+ * Asynchronous version of LoRaMacPayloadEncrypt. With a backend completing in
+ * the background the call returns LORAMAC_CRYPTO_PENDING and done is called
+ * once encBuffer is written.
+ *
+ * \remark buffer and encBuffer must stay valid and no other crypto function
+ *         may be called until the encryption is finished
+ *
+ * \param   buffer          - Data buffer
+ * \param   size            - Data buffer size
+ * \param   key             - AES key to be used
+ * \param   address         - Frame address
+ * \param   dir             - Frame direction [0: uplink, 1: downlink]
+ * \param   sequenceCounter - Frame sequence counter
+ * \param  encBuffer       - Encrypted buffer
+ * \param   done            - Completion callback
+ * \param   context         - Completion callback context
+ * \retval  Operation status, done is only called for LORAMAC_CRYPTO_PENDING
+ */
+LoRaMacCryptoStatus_t LoRaMacPayloadEncryptAsync(const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer, LoRaMacCryptoDone_t done, void *context);
+
+/*!
+ * Selects the crypto backend
+ *
+ * \remark The functions without done callback block until the backend is
+ *         finished. If the backend fails, they return its status (or
+ *         LORAMAC_CRYPTO_ERROR) and LoRaMacVerifyAndDecrypt rejects the
+ *         frame.
+ *
+ * \param   backend         - Crypto backend, NULL for the built-in software
+ *                            implementation
+ */
+void LoRaMacCryptoSetBackend(const LoRaMacCryptoBackend_t *backend);
+
+/*!
+ * Removes the expanded key schedule of the given key from the key cache
+ *
+ * \param   key             - AES key to be removed
+ */
+void LoRaMacCryptoInvalidateKey(const uint8_t *key);
+
+/*!
+ * Removes all expanded key schedules from the key cache
+ *
+ * \remark Must be called whenever the session keys change (join, rekey)
+ */
+void LoRaMacCryptoInvalidateKeys(void);
+
+/*!
+ * Returns the context used by the functions without a context parameter
+ *
+ * \retval  Crypto context
+ */
+LoRaMacCryptoCtx_t *LoRaMacCryptoGetDefaultCtx(void);
+
+/*!
+ * Initializes a crypto context
+ *
+ * \remark A zero initialized context (e.g. a static variable) is initialized
+ *
+ * \param   ctx             - Crypto context
+ */
+void LoRaMacCryptoCtxInit(LoRaMacCryptoCtx_t *ctx);
+
+/*!
+ * Same as LoRaMacComputeMic, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxComputeMic(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic);
+
+/*!
+ * Same as LoRaMacPayloadEncrypt, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxPayloadEncrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer);
+
+/*!
+ * Same as LoRaMacComputeKeystream, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxComputeKeystream(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t size, uint8_t *keystream);
+
+/*!
+ * Same as LoRaMacPayloadDecrypt, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxPayloadDecrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer);
+
+/*!
+ * Same as LoRaMacVerifyAndDecrypt, using the given context
+ */
+bool LoRaMacCryptoCtxVerifyAndDecrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, uint32_t mic, const uint8_t *micKey, const uint8_t *payloadKey, uint8_t payloadIndex, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer);
+
+/*!
+ * Same as LoRaMacPrecompute, using the given context
+ */
+void LoRaMacCryptoCtxPrecompute(LoRaMacCryptoCtx_t *ctx, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint16_t micSize, uint16_t payloadSize);
+
+/*!
+ * Same as LoRaMacEncryptAndSign, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxEncryptAndSign(LoRaMacCryptoCtx_t *ctx, const uint8_t *header, uint8_t headerSize, const uint8_t *payload, uint8_t payloadSize, const uint8_t *micKey, const uint8_t *payloadKey, uint32_t address, uint8_t dir, uint32_t sequenceCounter, LoRaMacCryptoWrite_t write);
+
+/*!
+ * Same as LoRaMacJoinComputeMic, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxJoinComputeMic(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic);
+
+/*!
+ * Same as LoRaMacJoinDecrypt, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxJoinDecrypt(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer);
+
+/*!
+ * Same as LoRaMacJoinComputeSKeys, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxJoinComputeSKeys(LoRaMacCryptoCtx_t *ctx, const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey);
+
+/*!
+ * Same as LoRaMacComputeMicAsync, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxComputeMicAsync(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic, LoRaMacCryptoDone_t done, void *context);
+
+/*!
+ * Same as LoRaMacPayloadEncryptAsync, using the given context
+ */
+LoRaMacCryptoStatus_t LoRaMacCryptoCtxPayloadEncryptAsync(LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer, LoRaMacCryptoDone_t done, void *context);
+
+/*!
+ * Same as LoRaMacCryptoSetBackend, using the given context
+ */
+void LoRaMacCryptoCtxSetBackend(LoRaMacCryptoCtx_t *ctx, const LoRaMacCryptoBackend_t *backend);
+
+/*!
+ * Same as LoRaMacCryptoInvalidateKey, using the given context
+ */
+void LoRaMacCryptoCtxInvalidateKey(LoRaMacCryptoCtx_t *ctx, const uint8_t *key);
+
+/*!
+ * Same as LoRaMacCryptoInvalidateKeys, using the given context
  */
-void LoRaMacJoinComputeSKeys(const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey);
+void LoRaMacCryptoCtxInvalidateKeys(LoRaMacCryptoCtx_t *ctx);
 
 #endif // __LORAMAC_CRYPTO_H__
@@ -0,0 +1,188 @@
+/*!
+ * \file      LoRaMacCryptoBackend.c
+ *
+ * \brief     LoRa MAC layer software crypto backend
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include "utilities.h"
+
+#include "aes.h"
+#include "cmac.h"
+
+#include "LoRaMacCryptoBackend.h"
+
+/*!
+ * Number of counter blocks encrypted per batch
+ */
+#define SW_CTR_BLOCKS 4
+
+/*!
+ * \brief XORs a 16 byte block into another one
+ *
+ * \param  dst             Block to be modified
+ * \param  src             Block to XOR in
+ */
+static void XorBlock(uint8_t *dst, const uint8_t *src)
+{
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		dst[i] ^= src[i];
+	}
+}
+
+static LoRaMacCryptoStatus_t SwEcb(const LoRaMacCryptoKey_t *key, const uint8_t *in, uint8_t *out, uint16_t nbBlocks, LoRaMacCryptoDone_t done, void *context)
+{
+	(void)done;
+	(void)context;
+
+	lora_aes_ecb_encrypt(in, out, nbBlocks, &key->CmacContext.rijndael);
+
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+static LoRaMacCryptoStatus_t SwCtr(const LoRaMacCryptoKey_t *key, const uint8_t counter[16], const uint8_t *in, uint8_t *out, uint16_t size, LoRaMacCryptoDone_t done, void *context)
+{
+	uint8_t ctr[16];
+	uint8_t keystream[SW_CTR_BLOCKS * 16];
+	uint16_t chunkSize;
+	uint8_t nbBlocks;
+
+	(void)done;
+	(void)context;
+
+	memcpy1(ctr, counter, 16);
+
+	while (size > 0)
+	{
+		chunkSize = (size < sizeof(keystream)) ? size : sizeof(keystream);
+		nbBlocks = (chunkSize + 15) / 16;
+		for (uint8_t i = 0; i < nbBlocks; i++)
+		{
+			memcpy1(keystream + i * 16, ctr, 16);
+			for (int8_t j = 15; (j >= 0) && (++ctr[j] == 0); j--)
+			{
+			}
+		}
+		lora_aes_ecb_encrypt(keystream, keystream, nbBlocks, &key->CmacContext.rijndael);
+		for (uint16_t i = 0; i < chunkSize; i++)
+		{
+			out[i] = in[i] ^ keystream[i];
+		}
+		in += chunkSize;
+		out += chunkSize;
+		size -= chunkSize;
+	}
+
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+static LoRaMacCryptoStatus_t SwCmac(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t mac[16], LoRaMacCryptoDone_t done, void *context)
+{
+	const AES_CMAC_CTX *cmac = &key->CmacContext;
+	uint8_t x[16];
+
+	(void)done;
+	(void)context;
+
+	if (iv != NULL)
+	{
+		memcpy1(x, iv, 16);
+	}
+	else
+	{
+		memset1(x, 0, 16);
+	}
+
+	if (prefix != NULL)
+	{
+		XorBlock(x, prefix);
+		if (size == 0)
+		{
+			// The prefix is the last, complete block
+			XorBlock(x, cmac->K1);
+			lora_aes_encrypt(x, mac, &cmac->rijndael);
+			return LORAMAC_CRYPTO_SUCCESS;
+		}
+		lora_aes_encrypt(x, x, &cmac->rijndael);
+	}
+
+	while (size > 16)
+	{
+		XorBlock(x, data);
+		lora_aes_encrypt(x, x, &cmac->rijndael);
+		data += 16;
+		size -= 16;
+	}
+
+	// Last block
+	if (size == 16)
+	{
+		XorBlock(x, data);
+		XorBlock(x, cmac->K1);
+	}
+	else
+	{
+		for (uint8_t i = 0; i < size; i++)
+		{
+			x[i] ^= data[i];
+		}
+		x[size] ^= 0x80;
+		XorBlock(x, cmac->K2);
+	}
+	lora_aes_encrypt(x, mac, &cmac->rijndael);
+
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+static LoRaMacCryptoStatus_t SwCmacUpdate(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t chain[16], LoRaMacCryptoDone_t done, void *context)
+{
+	const AES_CMAC_CTX *cmac = &key->CmacContext;
+	uint8_t x[16];
+
+	(void)done;
+	(void)context;
+
+	if ((size % 16) != 0)
+	{
+		return LORAMAC_CRYPTO_ERROR;
+	}
+
+	if (iv != NULL)
+	{
+		memcpy1(x, iv, 16);
+	}
+	else
+	{
+		memset1(x, 0, 16);
+	}
+
+	if (prefix != NULL)
+	{
+		XorBlock(x, prefix);
+		lora_aes_encrypt(x, x, &cmac->rijndael);
+	}
+
+	while (size > 0)
+	{
+		XorBlock(x, data);
+		lora_aes_encrypt(x, x, &cmac->rijndael);
+		data += 16;
+		size -= 16;
+	}
+
+	memcpy1(chain, x, 16);
+
+	return LORAMAC_CRYPTO_SUCCESS;
+}
+
+const LoRaMacCryptoBackend_t LoRaMacCryptoBackendSoftware =
+	{
+		"software",
+		SwEcb,
+		SwCtr,
+		SwCmac,
+		SwCmacUpdate,
+};
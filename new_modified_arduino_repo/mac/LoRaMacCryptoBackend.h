@@ -0,0 +1,203 @@
+/*!
+ * \file      LoRaMacCryptoBackend.h
+ *
+ * \brief     LoRa MAC layer crypto backend interface
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \defgroup  LORAMAC_CRYPTO_BACKEND LoRa MAC layer crypto backends
+ *            A backend runs the AES primitives used by the LoRaMAC crypto
+ *            functions: ECB encryption, CTR encryption and CMAC, in one
+ *            operation or in parts. It is
+ *            selected per crypto context with LoRaMacCryptoCtxSetBackend.
+ *            Without a backend the built-in software implementation is used.
+ *
+ *            Completion model
+ *            Each operation takes a completion callback. If done is NULL the
+ *            call returns once the operation is finished; a DMA backend may
+ *            sleep until the completion interrupt meanwhile. Otherwise the
+ *            backend may start the operation and return
+ *            LORAMAC_CRYPTO_PENDING. done is then called once, possibly from
+ *            interrupt context, when the output is written. For any other
+ *            return value done is not called. The buffers passed in must stay
+ *            valid until the operation is finished.
+ */
+#ifndef __LORAMAC_CRYPTO_BACKEND_H__
+#define __LORAMAC_CRYPTO_BACKEND_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmac.h"
+
+/*!
+ * The mock peripheral backend is available on POSIX hosts. Define
+ * LORAMAC_CRYPTO_BACKEND_NO_MOCK to leave it out.
+ */
+#if !defined(LORAMAC_CRYPTO_BACKEND_NO_MOCK) && !defined(ARDUINO) && \
+	(defined(__linux__) || defined(__APPLE__))
+#define LORAMAC_CRYPTO_BACKEND_MOCK
+#endif
+
+/*!
+ * Expanded AES key schedule cache entry
+ */
+typedef struct sLoRaMacCryptoKey
+{
+	/*!
+	 * CMAC context holding the expanded key schedule and the CMAC subkeys
+	 */
+	AES_CMAC_CTX CmacContext;
+	/*!
+	 * AES key the schedule was expanded from. Backends loading the key into
+	 * a peripheral use this one.
+	 */
+	uint8_t Key[16];
+	/*!
+	 * Last use stamp, used to evict the least recently used entry
+	 */
+	uint32_t LastUse;
+	/*!
+	 * Set to true, if the entry holds a valid key schedule
+	 */
+	bool Valid;
+} LoRaMacCryptoKey_t;
+
+/*!
+ * Crypto operation status
+ */
+typedef enum eLoRaMacCryptoStatus
+{
+	/*!
+	 * Operation finished
+	 */
+	LORAMAC_CRYPTO_SUCCESS = 0,
+	/*!
+	 * Operation started, the completion callback will be called
+	 */
+	LORAMAC_CRYPTO_PENDING,
+	/*!
+	 * Backend is running another operation
+	 */
+	LORAMAC_CRYPTO_BUSY,
+	/*!
+	 * Operation failed
+	 */
+	LORAMAC_CRYPTO_ERROR,
+} LoRaMacCryptoStatus_t;
+
+/*!
+ * Completion callback of an asynchronous operation
+ *
+ * \param   context         - Context given when the operation was started
+ * \param   status          - LORAMAC_CRYPTO_SUCCESS or LORAMAC_CRYPTO_ERROR
+ */
+typedef void (*LoRaMacCryptoDone_t)(void *context, LoRaMacCryptoStatus_t status);
+
+/*!
+ * Crypto backend
+ */
+typedef struct sLoRaMacCryptoBackend
+{
+	/*!
+	 * Backend name
+	 */
+	const char *Name;
+	/*!
+	 * Encrypts nbBlocks independent 16 byte blocks. in and out may be the
+	 * same buffer.
+	 *
+	 * \param   key             - AES key
+	 * \param   in              - Input blocks
+	 * \param   out             - Encrypted blocks
+	 * \param   nbBlocks        - Number of blocks
+	 * \param   done            - Completion callback, NULL to block
+	 * \param   context         - Completion callback context
+	 * \retval  Operation status
+	 */
+	LoRaMacCryptoStatus_t (*Ecb)(const LoRaMacCryptoKey_t *key, const uint8_t *in, uint8_t *out, uint16_t nbBlocks, LoRaMacCryptoDone_t done, void *context);
+	/*!
+	 * Encrypts (or decrypts) size bytes in counter mode. The counter block is
+	 * incremented as a 128 bit big endian number. in and out may be the same
+	 * buffer.
+	 *
+	 * \param   key             - AES key
+	 * \param   counter         - First counter block
+	 * \param   in              - Input data
+	 * \param   out             - Output data
+	 * \param   size            - Number of bytes
+	 * \param   done            - Completion callback, NULL to block
+	 * \param   context         - Completion callback context
+	 * \retval  Operation status
+	 */
+	LoRaMacCryptoStatus_t (*Ctr)(const LoRaMacCryptoKey_t *key, const uint8_t counter[16], const uint8_t *in, uint8_t *out, uint16_t size, LoRaMacCryptoDone_t done, void *context);
+	/*!
+	 * Computes the CMAC over the 16 byte prefix followed by size bytes of
+	 * data
+	 *
+	 * \param   key             - AES key
+	 * \param   iv              - Chaining value to start from, NULL for zero.
+	 *                            Used to continue a CMAC whose first blocks
+	 *                            were computed ahead.
+	 * \param   prefix          - First block of the message (B0), NULL if
+	 *                            the message only consists of data
+	 * \param   data            - Data
+	 * \param   size            - Data size
+	 * \param   mac             - Computed CMAC, may be the same buffer as iv
+	 * \param   done            - Completion callback, NULL to block
+	 * \param   context         - Completion callback context
+	 * \retval  Operation status
+	 */
+	LoRaMacCryptoStatus_t (*Cmac)(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t mac[16], LoRaMacCryptoDone_t done, void *context);
+	/*!
+	 * Runs the CMAC chaining over the 16 byte prefix followed by size bytes
+	 * of data without the final block, so a message can be fed in parts.
+	 * The last part is passed to Cmac with the returned chaining value as
+	 * iv.
+	 *
+	 * \param   key             - AES key
+	 * \param   iv              - Chaining value to start from, NULL for zero
+	 * \param   prefix          - First block of the message (B0), NULL if
+	 *                            there is none
+	 * \param   data            - Data, whole 16 byte blocks
+	 * \param   size            - Data size, a multiple of 16
+	 * \param   chain           - Chaining value after the data, may be the
+	 *                            same buffer as iv
+	 * \param   done            - Completion callback, NULL to block
+	 * \param   context         - Completion callback context
+	 * \retval  Operation status, LORAMAC_CRYPTO_ERROR if size is not a
+	 *          multiple of 16
+	 */
+	LoRaMacCryptoStatus_t (*CmacUpdate)(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t chain[16], LoRaMacCryptoDone_t done, void *context);
+} LoRaMacCryptoBackend_t;
+
+/*!
+ * Software reference backend. Completes all operations in the calling
+ * context and never returns LORAMAC_CRYPTO_PENDING.
+ */
+extern const LoRaMacCryptoBackend_t LoRaMacCryptoBackendSoftware;
+
+#if defined(LORAMAC_CRYPTO_BACKEND_MOCK)
+
+/*!
+ * Mock AES peripheral backend for host tests. Behaves like a DMA capable
+ * peripheral: it runs one operation at a time, takes a configurable time and
+ * completes asynchronous operations from a separate thread.
+ */
+extern const LoRaMacCryptoBackend_t LoRaMacCryptoBackendMock;
+
+/*!
+ * Sets the time the mock peripheral takes for an operation
+ *
+ * \param   setupUs         - Time per operation [us]
+ * \param   blockUs         - Time per AES block [us]
+ */
+void LoRaMacCryptoBackendMockSetLatency(uint32_t setupUs, uint32_t blockUs);
+
+/*!
+ * Waits until the mock peripheral is idle
+ */
+void LoRaMacCryptoBackendMockWaitIdle(void);
+
+#endif
+
+#endif // __LORAMAC_CRYPTO_BACKEND_H__
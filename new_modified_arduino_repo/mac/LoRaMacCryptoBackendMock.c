@@ -0,0 +1,373 @@
+/*!
+ * \file      LoRaMacCryptoBackendMock.c
+ *
+ * \brief     LoRa MAC layer mock AES peripheral backend for host tests
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    The mock behaves like an AES peripheral fed by DMA: the key and
+ *            the counter/chaining registers are loaded when an operation is
+ *            started, the data buffers are only accessed while it runs. An
+ *            operation takes the configured latency and runs on the
+ *            peripheral thread, which also calls the completion callbacks
+ *            like an interrupt handler would. The computation itself is
+ *            done by the software backend.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+#include "LoRaMacCryptoBackend.h"
+
+#if defined(LORAMAC_CRYPTO_BACKEND_MOCK)
+
+#include <pthread.h>
+#include <time.h>
+
+/*!
+ * Mock peripheral operations
+ */
+typedef enum eMockOp
+{
+	MOCK_OP_ECB,
+	MOCK_OP_CTR,
+	MOCK_OP_CMAC,
+	MOCK_OP_CMAC_UPDATE,
+} MockOp_t;
+
+/*!
+ * Operation loaded into the mock peripheral
+ */
+typedef struct sMockJob
+{
+	MockOp_t Op;
+	/*!
+	 * Key register, copied when the operation is started
+	 */
+	LoRaMacCryptoKey_t Key;
+	/*!
+	 * Counter or chaining value register
+	 */
+	uint8_t Iv[16];
+	bool HasIv;
+	/*!
+	 * CMAC first block register
+	 */
+	uint8_t Prefix[16];
+	bool HasPrefix;
+	/*!
+	 * DMA source and destination
+	 */
+	const uint8_t *In;
+	uint8_t *Out;
+	uint16_t Size;
+	/*!
+	 * Time the operation takes [us]
+	 */
+	uint32_t DelayUs;
+	LoRaMacCryptoDone_t Done;
+	void *Context;
+} MockJob_t;
+
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t ThreadOnce = PTHREAD_ONCE_INIT;
+static pthread_t Thread;
+
+/*!
+ * Set while an operation runs
+ */
+static bool Busy = false;
+/*!
+ * Set while an asynchronous operation waits for the peripheral thread
+ */
+static bool Queued = false;
+/*!
+ * Set while the peripheral thread runs a completion callback
+ */
+static bool InCallback = false;
+static MockJob_t Job;
+
+static uint32_t SetupUs = 20;
+static uint32_t BlockUs = 1;
+
+static void Delay(uint32_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (long)(us % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) != 0)
+	{
+	}
+}
+
+/*!
+ * \brief Returns the time an operation takes. Must be called with Lock held.
+ *
+ * \param  job             Operation
+ * \retval Time [us]
+ */
+static uint32_t GetDelay(const MockJob_t *job)
+{
+	uint32_t nbBlocks = (job->Size + 15) / 16;
+
+	if (job->Op == MOCK_OP_ECB)
+	{
+		nbBlocks = job->Size;
+	}
+	else if (((job->Op == MOCK_OP_CMAC) || (job->Op == MOCK_OP_CMAC_UPDATE)) && (job->HasPrefix == true))
+	{
+		nbBlocks++;
+	}
+	return SetupUs + nbBlocks * BlockUs;
+}
+
+/*!
+ * \brief Runs an operation, including the artificial latency
+ *
+ * \param  job             Operation
+ */
+static LoRaMacCryptoStatus_t Run(const MockJob_t *job)
+{
+	const LoRaMacCryptoBackend_t *sw = &LoRaMacCryptoBackendSoftware;
+
+	Delay(job->DelayUs);
+
+	switch (job->Op)
+	{
+	case MOCK_OP_ECB:
+		return sw->Ecb(&job->Key, job->In, job->Out, job->Size, NULL, NULL);
+	case MOCK_OP_CTR:
+		return sw->Ctr(&job->Key, job->Iv, job->In, job->Out, job->Size, NULL, NULL);
+	case MOCK_OP_CMAC:
+		return sw->Cmac(&job->Key, (job->HasIv == true) ? job->Iv : NULL, (job->HasPrefix == true) ? job->Prefix : NULL,
+						job->In, job->Size, job->Out, NULL, NULL);
+	case MOCK_OP_CMAC_UPDATE:
+		return sw->CmacUpdate(&job->Key, (job->HasIv == true) ? job->Iv : NULL, (job->HasPrefix == true) ? job->Prefix : NULL,
+							  job->In, job->Size, job->Out, NULL, NULL);
+	}
+	return LORAMAC_CRYPTO_ERROR;
+}
+
+static void *PeripheralThread(void *arg)
+{
+	MockJob_t job;
+	LoRaMacCryptoStatus_t status;
+
+	(void)arg;
+
+	pthread_mutex_lock(&Lock);
+	while (1)
+	{
+		while (Queued == false)
+		{
+			pthread_cond_wait(&Cond, &Lock);
+		}
+		job = Job;
+		Queued = false;
+		pthread_mutex_unlock(&Lock);
+
+		status = Run(&job);
+
+		pthread_mutex_lock(&Lock);
+		// The callback may start the next operation
+		Busy = false;
+		InCallback = true;
+		pthread_cond_broadcast(&Cond);
+		pthread_mutex_unlock(&Lock);
+
+		job.Done(job.Context, status);
+
+		pthread_mutex_lock(&Lock);
+		InCallback = false;
+		pthread_cond_broadcast(&Cond);
+	}
+	return NULL;
+}
+
+static void StartThread(void)
+{
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_create(&Thread, &attr, PeripheralThread, NULL);
+	pthread_attr_destroy(&attr);
+}
+
+/*!
+ * \brief Starts an operation. Blocking operations wait for the peripheral
+ *        and run in the calling thread, asynchronous ones are handed to the
+ *        peripheral thread.
+ *
+ * \param  job             Operation
+ * \retval Operation status
+ */
+static LoRaMacCryptoStatus_t Start(MockJob_t *job)
+{
+	LoRaMacCryptoStatus_t status;
+
+	if (job->Done == NULL)
+	{
+		pthread_mutex_lock(&Lock);
+		while (Busy == true)
+		{
+			pthread_cond_wait(&Cond, &Lock);
+		}
+		Busy = true;
+		job->DelayUs = GetDelay(job);
+		pthread_mutex_unlock(&Lock);
+
+		status = Run(job);
+
+		pthread_mutex_lock(&Lock);
+		Busy = false;
+		pthread_cond_broadcast(&Cond);
+		pthread_mutex_unlock(&Lock);
+		return status;
+	}
+
+	if (pthread_once(&ThreadOnce, StartThread) != 0)
+	{
+		return LORAMAC_CRYPTO_ERROR;
+	}
+
+	pthread_mutex_lock(&Lock);
+	if (Busy == true)
+	{
+		pthread_mutex_unlock(&Lock);
+		return LORAMAC_CRYPTO_BUSY;
+	}
+	Busy = true;
+	Queued = true;
+	job->DelayUs = GetDelay(job);
+	Job = *job;
+	pthread_cond_broadcast(&Cond);
+	pthread_mutex_unlock(&Lock);
+
+	return LORAMAC_CRYPTO_PENDING;
+}
+
+static LoRaMacCryptoStatus_t MockEcb(const LoRaMacCryptoKey_t *key, const uint8_t *in, uint8_t *out, uint16_t nbBlocks, LoRaMacCryptoDone_t done, void *context)
+{
+	MockJob_t job;
+
+	memset1((uint8_t *)&job, 0, sizeof(job));
+	job.Op = MOCK_OP_ECB;
+	job.Key = *key;
+	job.In = in;
+	job.Out = out;
+	job.Size = nbBlocks;
+	job.Done = done;
+	job.Context = context;
+
+	return Start(&job);
+}
+
+static LoRaMacCryptoStatus_t MockCtr(const LoRaMacCryptoKey_t *key, const uint8_t counter[16], const uint8_t *in, uint8_t *out, uint16_t size, LoRaMacCryptoDone_t done, void *context)
+{
+	MockJob_t job;
+
+	memset1((uint8_t *)&job, 0, sizeof(job));
+	job.Op = MOCK_OP_CTR;
+	job.Key = *key;
+	memcpy1(job.Iv, counter, 16);
+	job.HasIv = true;
+	job.In = in;
+	job.Out = out;
+	job.Size = size;
+	job.Done = done;
+	job.Context = context;
+
+	return Start(&job);
+}
+
+static LoRaMacCryptoStatus_t MockCmac(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t mac[16], LoRaMacCryptoDone_t done, void *context)
+{
+	MockJob_t job;
+
+	memset1((uint8_t *)&job, 0, sizeof(job));
+	job.Op = MOCK_OP_CMAC;
+	job.Key = *key;
+	if (iv != NULL)
+	{
+		memcpy1(job.Iv, iv, 16);
+		job.HasIv = true;
+	}
+	if (prefix != NULL)
+	{
+		memcpy1(job.Prefix, prefix, 16);
+		job.HasPrefix = true;
+	}
+	job.In = data;
+	job.Out = mac;
+	job.Size = size;
+	job.Done = done;
+	job.Context = context;
+
+	return Start(&job);
+}
+
+static LoRaMacCryptoStatus_t MockCmacUpdate(const LoRaMacCryptoKey_t *key, const uint8_t iv[16], const uint8_t prefix[16], const uint8_t *data, uint16_t size, uint8_t chain[16], LoRaMacCryptoDone_t done, void *context)
+{
+	MockJob_t job;
+
+	// Rejected when the operation is started, like a peripheral checking
+	// the DMA length
+	if ((size % 16) != 0)
+	{
+		return LORAMAC_CRYPTO_ERROR;
+	}
+
+	memset1((uint8_t *)&job, 0, sizeof(job));
+	job.Op = MOCK_OP_CMAC_UPDATE;
+	job.Key = *key;
+	if (iv != NULL)
+	{
+		memcpy1(job.Iv, iv, 16);
+		job.HasIv = true;
+	}
+	if (prefix != NULL)
+	{
+		memcpy1(job.Prefix, prefix, 16);
+		job.HasPrefix = true;
+	}
+	job.In = data;
+	job.Out = chain;
+	job.Size = size;
+	job.Done = done;
+	job.Context = context;
+
+	return Start(&job);
+}
+
+void LoRaMacCryptoBackendMockSetLatency(uint32_t setupUs, uint32_t blockUs)
+{
+	pthread_mutex_lock(&Lock);
+	SetupUs = setupUs;
+	BlockUs = blockUs;
+	pthread_mutex_unlock(&Lock);
+}
+
+void LoRaMacCryptoBackendMockWaitIdle(void)
+{
+	pthread_mutex_lock(&Lock);
+	while ((Busy == true) || (InCallback == true))
+	{
+		pthread_cond_wait(&Cond, &Lock);
+	}
+	pthread_mutex_unlock(&Lock);
+}
+
+const LoRaMacCryptoBackend_t LoRaMacCryptoBackendMock =
+	{
+		"mock",
+		MockEcb,
+		MockCtr,
+		MockCmac,
+		MockCmacUpdate,
+};
+
+#endif
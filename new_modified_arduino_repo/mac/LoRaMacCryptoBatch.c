@@ -0,0 +1,456 @@
+/*!
+ * \file      LoRaMacCryptoBatch.c
+ *
+ * \brief     Batch verification of LoRaMAC frame MICs
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Each lane holds the CMAC chain of one frame. All lanes are
+ *            advanced by one block per step, the blocks of the step are
+ *            encrypted with a single lora_aes_multi_encrypt call. A lane
+ *            whose frame is complete is refilled with the next frame, so
+ *            frames of different sizes keep all lanes busy.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+#include "aes.h"
+#include "cmac.h"
+
+#include "LoRaMacCryptoBatch.h"
+
+#if defined(LORAMAC_CRYPTO_BATCH_POOL)
+#include <pthread.h>
+#endif
+
+/*!
+ * Number of frames a pool worker takes at a time
+ */
+#define LORAMAC_CRYPTO_BATCH_CHUNK 256
+
+/*!
+ * CMAC chain state of a frame
+ */
+typedef struct sLoRaMacCryptoBatchLane
+{
+	/*!
+	 * Frame being verified
+	 */
+	LoRaMacCryptoBatchFrame_t *Frame;
+	/*!
+	 * Number of bytes of B0 | Frame absorbed so far
+	 */
+	uint16_t Offset;
+	/*!
+	 * Size of B0 | Frame
+	 */
+	uint16_t Length;
+} LoRaMacCryptoBatchLane_t;
+
+/*!
+ * \brief XORs the CMAC subkey into the last block
+ *
+ * \param  x               CMAC chaining value
+ * \param  subKey          K1 or K2
+ */
+static void XorSubKey(uint8_t *x, const uint8_t *subKey)
+{
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		x[i] ^= subKey[i];
+	}
+}
+
+/*!
+ * \brief Starts the CMAC chain of a frame, the chaining value is set to B0
+ *
+ * \param  lane            Lane
+ * \param  frame           Frame
+ * \param  x               CMAC chaining value
+ */
+static void StartLane(LoRaMacCryptoBatchLane_t *lane, LoRaMacCryptoBatchFrame_t *frame, uint8_t *x)
+{
+	uint8_t size = frame->Size & 0xFF;
+
+	lane->Frame = frame;
+	lane->Offset = 16;
+	lane->Length = 16 + size;
+
+	x[0] = 0x49;
+	x[1] = 0x00;
+	x[2] = 0x00;
+	x[3] = 0x00;
+	x[4] = 0x00;
+
+	x[5] = frame->Dir;
+
+	x[6] = (frame->Address) & 0xFF;
+	x[7] = (frame->Address >> 8) & 0xFF;
+	x[8] = (frame->Address >> 16) & 0xFF;
+	x[9] = (frame->Address >> 24) & 0xFF;
+
+	x[10] = (frame->SequenceCounter) & 0xFF;
+	x[11] = (frame->SequenceCounter >> 8) & 0xFF;
+	x[12] = (frame->SequenceCounter >> 16) & 0xFF;
+	x[13] = (frame->SequenceCounter >> 24) & 0xFF;
+
+	x[14] = 0x00;
+	x[15] = size;
+
+	if (size == 0)
+	{
+		// B0 is the last block
+		XorSubKey(x, frame->MicKey->K1);
+	}
+}
+
+/*!
+ * \brief Absorbs the next block of the frame into the CMAC chaining value
+ *
+ * \param  lane            Lane
+ * \param  x               CMAC chaining value
+ */
+static void AbsorbBlock(LoRaMacCryptoBatchLane_t *lane, uint8_t *x)
+{
+	const uint8_t *data = lane->Frame->Buffer + lane->Offset - 16;
+	uint16_t remaining = lane->Length - lane->Offset;
+
+	if (remaining > 16)
+	{
+		for (uint8_t i = 0; i < 16; i++)
+		{
+			x[i] ^= data[i];
+		}
+		lane->Offset += 16;
+		return;
+	}
+
+	for (uint8_t i = 0; i < remaining; i++)
+	{
+		x[i] ^= data[i];
+	}
+	if (remaining == 16)
+	{
+		XorSubKey(x, lane->Frame->MicKey->K1);
+	}
+	else
+	{
+		x[remaining] ^= 0x80;
+		XorSubKey(x, lane->Frame->MicKey->K2);
+	}
+	lane->Offset = lane->Length;
+}
+
+/*!
+ * \brief Decrypts the FRMPayload of a frame
+ *
+ * \param  frame           Frame
+ */
+static void DecryptPayload(const LoRaMacCryptoBatchFrame_t *frame)
+{
+	uint8_t keystream[4 * 16];
+	const uint8_t *src = frame->Buffer + frame->PayloadIndex;
+	uint8_t *dst = frame->DecBuffer;
+	uint16_t size = (frame->Size & 0xFF) - frame->PayloadIndex;
+	uint16_t chunkSize;
+	uint8_t nbBlocks;
+	uint8_t ctr = 1;
+	uint8_t *aBlock;
+
+	while (size > 0)
+	{
+		chunkSize = T_MIN(size, sizeof(keystream));
+		nbBlocks = (chunkSize + 15) / 16;
+
+		aBlock = keystream;
+		for (uint8_t i = 0; i < nbBlocks; i++)
+		{
+			memset1(aBlock, 0, 16);
+			aBlock[0] = 0x01;
+			aBlock[5] = frame->Dir;
+			aBlock[6] = (frame->Address) & 0xFF;
+			aBlock[7] = (frame->Address >> 8) & 0xFF;
+			aBlock[8] = (frame->Address >> 16) & 0xFF;
+			aBlock[9] = (frame->Address >> 24) & 0xFF;
+			aBlock[10] = (frame->SequenceCounter) & 0xFF;
+			aBlock[11] = (frame->SequenceCounter >> 8) & 0xFF;
+			aBlock[12] = (frame->SequenceCounter >> 16) & 0xFF;
+			aBlock[13] = (frame->SequenceCounter >> 24) & 0xFF;
+			aBlock[15] = ctr++;
+			aBlock += 16;
+		}
+		lora_aes_ecb_encrypt(keystream, keystream, nbBlocks, &frame->PayloadKey->rijndael);
+
+		for (uint16_t i = 0; i < chunkSize; i++)
+		{
+			dst[i] = src[i] ^ keystream[i];
+		}
+		src += chunkSize;
+		dst += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+/*!
+ * \brief Completes the verification of a frame
+ *
+ * \param  frame           Frame
+ * \param  x               Final CMAC value
+ * \retval [true: MIC is valid, false: MIC is invalid]
+ */
+static bool FinishFrame(LoRaMacCryptoBatchFrame_t *frame, const uint8_t *x)
+{
+	uint32_t mic = (uint32_t)((uint32_t)x[3] << 24 | (uint32_t)x[2] << 16 | (uint32_t)x[1] << 8 | (uint32_t)x[0]);
+
+	frame->MicOk = (mic == frame->Mic);
+	if ((frame->MicOk == true) && (frame->PayloadKey != NULL) && (frame->PayloadIndex < (frame->Size & 0xFF)))
+	{
+		DecryptPayload(frame);
+	}
+	return frame->MicOk;
+}
+
+uint32_t LoRaMacCryptoBatchVerify(LoRaMacCryptoBatchFrame_t *frames, uint32_t nbFrames)
+{
+	LoRaMacCryptoBatchLane_t lanes[LORAMAC_CRYPTO_BATCH_LANES];
+	const lora_aes_context *aesContexts[LORAMAC_CRYPTO_BATCH_LANES];
+	uint8_t x[LORAMAC_CRYPTO_BATCH_LANES * 16];
+	uint8_t nbActive = 0;
+	uint32_t next = 0;
+	uint32_t nbValid = 0;
+	uint8_t i;
+
+	while (true)
+	{
+		// Refill the free lanes
+		while ((nbActive < LORAMAC_CRYPTO_BATCH_LANES) && (next < nbFrames))
+		{
+			StartLane(&lanes[nbActive], &frames[next++], &x[nbActive * 16]);
+			nbActive++;
+		}
+		if (nbActive == 0)
+		{
+			break;
+		}
+
+		for (i = 0; i < nbActive; i++)
+		{
+			aesContexts[i] = &lanes[i].Frame->MicKey->rijndael;
+		}
+		lora_aes_multi_encrypt(x, nbActive, aesContexts);
+
+		i = 0;
+		while (i < nbActive)
+		{
+			if (lanes[i].Offset < lanes[i].Length)
+			{
+				AbsorbBlock(&lanes[i], &x[i * 16]);
+				i++;
+				continue;
+			}
+			if (FinishFrame(lanes[i].Frame, &x[i * 16]) == true)
+			{
+				nbValid++;
+			}
+			// Move the last lane into the free one
+			nbActive--;
+			if (i != nbActive)
+			{
+				lanes[i] = lanes[nbActive];
+				memcpy1(&x[i * 16], &x[nbActive * 16], 16);
+			}
+		}
+	}
+	return nbValid;
+}
+
+#if defined(LORAMAC_CRYPTO_BATCH_POOL)
+
+struct sLoRaMacCryptoBatchPool
+{
+	/*!
+	 * Serializes the batches
+	 */
+	pthread_mutex_t CallLock;
+	/*!
+	 * Protects the batch state below
+	 */
+	pthread_mutex_t Lock;
+	/*!
+	 * Signaled when a batch starts or the pool stops
+	 */
+	pthread_cond_t Start;
+	/*!
+	 * Signaled when the last worker finished the batch
+	 */
+	pthread_cond_t Done;
+	pthread_t *Threads;
+	uint8_t NbWorkers;
+	/*!
+	 * Current batch
+	 */
+	LoRaMacCryptoBatchFrame_t *Frames;
+	uint32_t NbFrames;
+	/*!
+	 * Index of the next frame chunk to take, updated atomically
+	 */
+	uint32_t Next;
+	/*!
+	 * Number of valid frames, updated atomically
+	 */
+	uint32_t NbValid;
+	/*!
+	 * Incremented for each batch
+	 */
+	uint32_t Generation;
+	/*!
+	 * Number of workers still working on the batch
+	 */
+	uint8_t NbBusy;
+	bool Stop;
+};
+
+/*!
+ * \brief Takes frame chunks of the current batch until none is left
+ *
+ * \param  pool            Pool
+ */
+static void RunBatch(LoRaMacCryptoBatchPool_t *pool)
+{
+	uint32_t start;
+	uint32_t nbValid = 0;
+
+	while (true)
+	{
+		start = __atomic_fetch_add(&pool->Next, LORAMAC_CRYPTO_BATCH_CHUNK, __ATOMIC_RELAXED);
+		if (start >= pool->NbFrames)
+		{
+			break;
+		}
+		nbValid += LoRaMacCryptoBatchVerify(&pool->Frames[start], T_MIN(LORAMAC_CRYPTO_BATCH_CHUNK, pool->NbFrames - start));
+	}
+	__atomic_fetch_add(&pool->NbValid, nbValid, __ATOMIC_RELAXED);
+}
+
+/*!
+ * \brief Pool worker thread, works on each batch started by
+ *        LoRaMacCryptoBatchPoolVerify
+ *
+ * \param  arg             Pool
+ */
+static void *Worker(void *arg)
+{
+	LoRaMacCryptoBatchPool_t *pool = arg;
+	// The pool starts at generation 0, a worker started after the first
+	// batch still takes part in it
+	uint32_t generation = 0;
+
+	pthread_mutex_lock(&pool->Lock);
+	while (true)
+	{
+		while ((pool->Generation == generation) && (pool->Stop == false))
+		{
+			pthread_cond_wait(&pool->Start, &pool->Lock);
+		}
+		if (pool->Stop == true)
+		{
+			break;
+		}
+		generation = pool->Generation;
+		pthread_mutex_unlock(&pool->Lock);
+
+		RunBatch(pool);
+
+		pthread_mutex_lock(&pool->Lock);
+		if (--pool->NbBusy == 0)
+		{
+			pthread_cond_signal(&pool->Done);
+		}
+	}
+	pthread_mutex_unlock(&pool->Lock);
+	return NULL;
+}
+
+LoRaMacCryptoBatchPool_t *LoRaMacCryptoBatchPoolCreate(uint8_t nbWorkers)
+{
+	LoRaMacCryptoBatchPool_t *pool = calloc(1, sizeof(LoRaMacCryptoBatchPool_t));
+
+	if (pool == NULL)
+	{
+		return NULL;
+	}
+	pool->Threads = calloc(nbWorkers, sizeof(pthread_t));
+	if ((pool->Threads == NULL) && (nbWorkers > 0))
+	{
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->CallLock, NULL);
+	pthread_mutex_init(&pool->Lock, NULL);
+	pthread_cond_init(&pool->Start, NULL);
+	pthread_cond_init(&pool->Done, NULL);
+
+	for (; pool->NbWorkers < nbWorkers; pool->NbWorkers++)
+	{
+		if (pthread_create(&pool->Threads[pool->NbWorkers], NULL, Worker, pool) != 0)
+		{
+			LoRaMacCryptoBatchPoolDestroy(pool);
+			return NULL;
+		}
+	}
+	return pool;
+}
+
+uint32_t LoRaMacCryptoBatchPoolVerify(LoRaMacCryptoBatchPool_t *pool, LoRaMacCryptoBatchFrame_t *frames, uint32_t nbFrames)
+{
+	uint32_t nbValid;
+
+	pthread_mutex_lock(&pool->CallLock);
+
+	pthread_mutex_lock(&pool->Lock);
+	pool->Frames = frames;
+	pool->NbFrames = nbFrames;
+	pool->Next = 0;
+	pool->NbValid = 0;
+	pool->NbBusy = pool->NbWorkers;
+	pool->Generation++;
+	pthread_cond_broadcast(&pool->Start);
+	pthread_mutex_unlock(&pool->Lock);
+
+	RunBatch(pool);
+
+	pthread_mutex_lock(&pool->Lock);
+	while (pool->NbBusy > 0)
+	{
+		pthread_cond_wait(&pool->Done, &pool->Lock);
+	}
+	nbValid = pool->NbValid;
+	pthread_mutex_unlock(&pool->Lock);
+
+	pthread_mutex_unlock(&pool->CallLock);
+
+	return nbValid;
+}
+
+void LoRaMacCryptoBatchPoolDestroy(LoRaMacCryptoBatchPool_t *pool)
+{
+	pthread_mutex_lock(&pool->Lock);
+	pool->Stop = true;
+	pthread_cond_broadcast(&pool->Start);
+	pthread_mutex_unlock(&pool->Lock);
+
+	for (uint8_t i = 0; i < pool->NbWorkers; i++)
+	{
+		pthread_join(pool->Threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->Done);
+	pthread_cond_destroy(&pool->Start);
+	pthread_mutex_destroy(&pool->Lock);
+	pthread_mutex_destroy(&pool->CallLock);
+	free(pool->Threads);
+	free(pool);
+}
+
+#endif
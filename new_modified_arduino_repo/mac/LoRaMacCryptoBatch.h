@@ -0,0 +1,140 @@
+/*!
+ * \file      LoRaMacCryptoBatch.h
+ *
+ * \brief     Batch verification of LoRaMAC frame MICs
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \defgroup  LORAMAC_CRYPTO_BATCH LoRa MAC layer batch frame verification
+ *            Verifies the MIC (and optionally decrypts the FRMPayload) of
+ *            many frames at once, e.g. in a network side ingestion service.
+ *            The CMAC chains of several frames are run in lock step, so the
+ *            AES blocks of different frames can be encrypted interleaved.
+ *
+ *            All functions are reentrant, the state lives on the stack of
+ *            the caller or in the caller provided structures.
+ */
+#ifndef __LORAMAC_CRYPTO_BATCH_H__
+#define __LORAMAC_CRYPTO_BATCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmac.h"
+
+/*!
+ * Number of CMAC chains run in lock step
+ */
+#ifndef LORAMAC_CRYPTO_BATCH_LANES
+#define LORAMAC_CRYPTO_BATCH_LANES 8
+#endif
+
+/*!
+ * The worker thread pool is available on POSIX hosts. Define
+ * LORAMAC_CRYPTO_BATCH_NO_POOL to leave it out.
+ */
+#if !defined(LORAMAC_CRYPTO_BATCH_NO_POOL) && !defined(ARDUINO) && \
+	(defined(__linux__) || defined(__APPLE__))
+#define LORAMAC_CRYPTO_BATCH_POOL
+#endif
+
+/*!
+ * Frame to be verified
+ */
+typedef struct sLoRaMacCryptoBatchFrame
+{
+	/*!
+	 * Frame, without the MIC field
+	 */
+	const uint8_t *Buffer;
+	/*!
+	 * Frame size, without the MIC field
+	 */
+	uint16_t Size;
+	/*!
+	 * Key used for the MIC (NwkSKey). Set up once per key with
+	 * AES_CMAC_SetKey, it is only read during the verification.
+	 */
+	const AES_CMAC_CTX *MicKey;
+	/*!
+	 * Key used for the FRMPayload, NULL to skip the decryption. Set up with
+	 * AES_CMAC_SetKey.
+	 */
+	const AES_CMAC_CTX *PayloadKey;
+	/*!
+	 * Index of the FRMPayload in Buffer
+	 */
+	uint8_t PayloadIndex;
+	/*!
+	 * Decrypted FRMPayload, only written if the MIC is valid
+	 */
+	uint8_t *DecBuffer;
+	/*!
+	 * Frame address
+	 */
+	uint32_t Address;
+	/*!
+	 * Frame direction [0: uplink, 1: downlink]
+	 */
+	uint8_t Dir;
+	/*!
+	 * Frame sequence counter
+	 */
+	uint32_t SequenceCounter;
+	/*!
+	 * Received MIC field
+	 */
+	uint32_t Mic;
+	/*!
+	 * Verification result, set to true if the MIC is valid
+	 */
+	bool MicOk;
+} LoRaMacCryptoBatchFrame_t;
+
+/*!
+ * Verifies the MIC of each frame and decrypts the FRMPayload of the frames
+ * with a valid MIC in the calling thread
+ *
+ * \param   frames          - Frames to verify
+ * \param   nbFrames        - Number of frames
+ * \retval  Number of frames with a valid MIC
+ */
+uint32_t LoRaMacCryptoBatchVerify(LoRaMacCryptoBatchFrame_t *frames, uint32_t nbFrames);
+
+#if defined(LORAMAC_CRYPTO_BATCH_POOL)
+
+/*!
+ * Worker thread pool
+ */
+typedef struct sLoRaMacCryptoBatchPool LoRaMacCryptoBatchPool_t;
+
+/*!
+ * Starts a worker thread pool
+ *
+ * \param   nbWorkers       - Number of worker threads. The thread calling
+ *                            LoRaMacCryptoBatchPoolVerify works as well.
+ * \retval  Pool, NULL if the pool could not be created
+ */
+LoRaMacCryptoBatchPool_t *LoRaMacCryptoBatchPoolCreate(uint8_t nbWorkers);
+
+/*!
+ * Same as LoRaMacCryptoBatchVerify, the frames are spread over the pool
+ *
+ * \remark A pool runs one batch at a time, concurrent calls are serialized
+ *
+ * \param   pool            - Pool
+ * \param   frames          - Frames to verify
+ * \param   nbFrames        - Number of frames
+ * \retval  Number of frames with a valid MIC
+ */
+uint32_t LoRaMacCryptoBatchPoolVerify(LoRaMacCryptoBatchPool_t *pool, LoRaMacCryptoBatchFrame_t *frames, uint32_t nbFrames);
+
+/*!
+ * Stops the worker threads and frees the pool
+ *
+ * \param   pool            - Pool
+ */
+void LoRaMacCryptoBatchPoolDestroy(LoRaMacCryptoBatchPool_t *pool);
+
+#endif
+
+#endif // __LORAMAC_CRYPTO_BATCH_H__
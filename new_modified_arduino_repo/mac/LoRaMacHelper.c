@@ -28,11 +28,10 @@
 #include "timer.h"
 #include "sx126x-debug.h"
 #include <string.h>
-extern LoRaMacParams_t LoRaMacParams;
 
-uint16_t ChannelsMask[6];
-uint16_t ChannelsDefaultMask[6];
-uint16_t ChannelsMaskRemaining[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[6];
+LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[6];
 
 size_t ch_mask_size = sizeof(ChannelsMask);
 
@@ -41,7 +40,6 @@ LoRaMacRegion_t region;
 bool _otaa = false;
 
 bool _dutyCycleEnabled = false;
-extern bool PublicNetwork;
 
 bool lmh_mac_is_busy = false;
 
@@ -107,6 +105,30 @@ static lmh_compliance_test_t m_compliance_test; /**< LoRaWAN compliance tests da
 static bool m_adr_enable_init;
 static TimerEvent_t ComplianceTestTxNextPacketTimer;
 
+/* Uplink queue, records of [size][port][flags][time, 4 bytes][data] */
+#define QUEUE_FLAG_CONFIRMED 0x01 /**< Record is sent in a confirmed frame */
+#define QUEUE_FLAG_TAKEN 0x02	  /**< Record is part of the frame being sent */
+
+static uint8_t m_queue[LMH_QUEUE_BUFFER_SIZE];
+static uint16_t m_queue_used;
+static uint16_t m_queue_count;
+static uint16_t m_queue_dropped;
+static uint8_t m_queue_frame[LORAWAN_APP_DATA_MAX_SIZE];
+static uint32_t m_queue_max_age = LMH_QUEUE_DEFAULT_MAX_AGE;
+static bool m_queue_flush;
+static TimerEvent_t QueueTimer;
+
+static void QueueProcess(void);
+
+/* Asynchronous send */
+static lmh_send_cb_t m_send_cb;
+static lmh_send_handle_t m_send_handle;
+static volatile lmh_send_status m_send_status = LMH_SEND_UNKNOWN;
+static TimerEvent_t SendTimeoutTimer;
+
+static void SendComplete(lmh_send_status status);
+static void SendTimeout(void);
+
 void lmh_setDevEui(uint8_t userDevEui[])
 {
 	memcpy(DevEui, userDevEui, 8);
@@ -409,9 +431,9 @@ static void McpsConfirm(McpsConfirm_t *mcpsConfirm)
 			m_callbacks->lmh_conf_result(mcpsConfirm->AckReceived);
 			// Workaround, reset MAC state
 			// Workaround for DR reset when ADR is active
-			int8_t preserve_dr = LoRaMacParams.ChannelsDatarate;
+			int8_t preserve_dr = LoRaMacGetDefaultContext()->Params.ChannelsDatarate;
 			lmh_reset_mac();
-			LoRaMacParams.ChannelsDatarate = preserve_dr;
+			LoRaMacGetDefaultContext()->Params.ChannelsDatarate = preserve_dr;
 		}
 		break;
 	}
@@ -424,6 +446,25 @@ static void McpsConfirm(McpsConfirm_t *mcpsConfirm)
 	default:
 		break;
 	}
+
+	if (m_send_status == LMH_SEND_PENDING)
+	{
+		if (mcpsConfirm->McpsRequest == MCPS_CONFIRMED)
+		{
+			SendComplete(mcpsConfirm->AckReceived ? LMH_SEND_ACKED : LMH_SEND_NO_ACK);
+		}
+		else
+		{
+			SendComplete(statusOk ? LMH_SEND_DONE : LMH_SEND_FAILED);
+		}
+	}
+
+	// Continue with the uplink queue once the MAC has finished
+	if (m_queue_count > 0)
+	{
+		TimerSetValue(&QueueTimer, 1);
+		TimerStart(&QueueTimer);
+	}
 }
 
 /**@brief MCPS-Indication event function
@@ -722,7 +763,10 @@ lmh_error_status lmh_init(lmh_init_params_t *params)
 
 	_dutyCycleEnabled = m_param.duty_cycle;
 
-	PublicNetwork = m_param.enable_public_network;
+	TimerInit(&QueueTimer, QueueProcess);
+	TimerInit(&SendTimeoutTimer, SendTimeout);
+
+	LoRaMacGetDefaultContext()->PublicNetwork = m_param.enable_public_network;
 
 #if (STATIC_DEVICE_EUI != 1)
 	m_callbacks->BoardGetUniqueId(DevEui);
@@ -949,10 +993,23 @@ void lmh_join(void)
 		mibReq.Param.IsNetworkJoined = JOIN_OK;
 		LoRaMacMibSetRequestConfirm(&mibReq);
 
+		// Without a session log this does nothing
+		LoRaMacStoreSession();
+
 		m_callbacks->lmh_has_joined();
 	}
 }
 
+lmh_error_status lmh_session_restore(LoRaMacNvm_t *nvm)
+{
+	if (LoRaMacRestoreSession(nvm) != LORAMAC_STATUS_OK)
+	{
+		return LMH_ERROR;
+	}
+	m_callbacks->lmh_has_joined();
+	return LMH_SUCCESS;
+}
+
 lmh_join_status lmh_join_status_get(void)
 {
 	MibRequestConfirm_t mibReq;
@@ -1042,29 +1099,337 @@ lmh_error_status lmh_send(lmh_app_data_t *app_data, lmh_confirm is_tx_confirmed)
 	return LMH_ERROR;
 }
 
+/**@brief Completes the pending asynchronous send
+ *
+ * @param status Result of the send
+ */
+static void SendComplete(lmh_send_status status)
+{
+	TimerStop(&SendTimeoutTimer);
+	m_send_status = status;
+	if (m_send_cb != NULL)
+	{
+		m_send_cb(m_send_handle, status);
+	}
+}
+
+/**@brief Timeout of the pending asynchronous send
+ */
+static void SendTimeout(void)
+{
+	if (m_send_status != LMH_SEND_PENDING)
+	{
+		return;
+	}
+	LOG_LIB("LMH", "async send timeout");
+	lmh_mac_is_busy = false;
+	SendComplete(LMH_SEND_TIMEOUT);
+}
+
+lmh_error_status lmh_send_async(lmh_app_data_t *app_data, lmh_confirm is_tx_confirmed, uint32_t time_out,
+								lmh_send_cb_t callback, lmh_send_handle_t *handle)
+{
+	lmh_error_status status;
+
+	if (m_send_status == LMH_SEND_PENDING)
+	{
+		return LMH_BUSY;
+	}
+
+	// Set up before the uplink is scheduled, the MAC may confirm it from
+	// another task before lmh_send returns
+	if (++m_send_handle == 0)
+	{
+		m_send_handle = 1;
+	}
+	m_send_cb = callback;
+	m_send_status = LMH_SEND_PENDING;
+
+	status = lmh_send(app_data, is_tx_confirmed);
+	if (status != LMH_SUCCESS)
+	{
+		m_send_status = LMH_SEND_UNKNOWN;
+		return status;
+	}
+
+	if (time_out > 0)
+	{
+		TimerSetValue(&SendTimeoutTimer, time_out);
+		TimerStart(&SendTimeoutTimer);
+	}
+	if (handle != NULL)
+	{
+		*handle = m_send_handle;
+	}
+	return LMH_SUCCESS;
+}
+
+lmh_send_status lmh_send_status_get(lmh_send_handle_t handle)
+{
+	if ((handle == 0) || (handle != m_send_handle))
+	{
+		return LMH_SEND_UNKNOWN;
+	}
+	return m_send_status;
+}
+
 lmh_error_status lmh_send_blocking(lmh_app_data_t *app_data, lmh_confirm is_tx_confirmed, uint32_t time_out)
 {
-	if (lmh_send(app_data, is_tx_confirmed) == LMH_SUCCESS)
+	lmh_send_handle_t handle;
+
+	// The timeout runs on the MAC timer, the loop only waits for the result
+	if (lmh_send_async(app_data, is_tx_confirmed, (time_out > 0) ? time_out : 1, NULL, &handle) == LMH_SUCCESS)
 	{
-		// uint32_t time_start = millis();
-		uint32_t time_start = TimerGetCurrentTime();
-		while (lmh_mac_is_busy)
+		while (lmh_send_status_get(handle) == LMH_SEND_PENDING)
 		{
-			if ((TimerGetCurrentTime() - time_start) > time_out)
-			{
-				LOG_LIB("LMH", "timeout at %ld", (TimerGetCurrentTime() - time_start));
-				lmh_mac_is_busy = false;
-				return LMH_ERROR;
-			}
 			// delay(250);
 			HAL_Delay(250);
 		}
-		return LMH_SUCCESS;
+		return (lmh_send_status_get(handle) == LMH_SEND_TIMEOUT) ? LMH_ERROR : LMH_SUCCESS;
 	}
 	LOG_LIB("LMH", "lmh_send returned LMH_ERROR");
 	return LMH_ERROR;
 }
 
+lmh_error_status lmh_precompute(lmh_app_data_t *app_data)
+{
+	if (lmh_mac_is_busy)
+	{
+		return LMH_BUSY;
+	}
+
+	switch (LoRaMacPrecomputeUplink(app_data->port, app_data->buffsize))
+	{
+	case LORAMAC_STATUS_OK:
+		return LMH_SUCCESS;
+	case LORAMAC_STATUS_BUSY:
+		return LMH_BUSY;
+	default:
+		return LMH_ERROR;
+	}
+}
+
+/**@brief Get the time a queued record was queued at
+ */
+static TimerTime_t QueueRecordTime(const uint8_t *record)
+{
+	return (TimerTime_t)record[3] | ((TimerTime_t)record[4] << 8) | ((TimerTime_t)record[5] << 16) | ((TimerTime_t)record[6] << 24);
+}
+
+/**@brief Remove the records taken into the frame, or release them
+ *
+ * @param remove true to remove the taken records, false to keep them
+ */
+static void QueueCompact(bool remove)
+{
+	uint16_t read = 0;
+	uint16_t write = 0;
+
+	while (read < m_queue_used)
+	{
+		uint16_t length = LMH_QUEUE_RECORD_OVERHEAD + m_queue[read];
+
+		if ((remove == true) && ((m_queue[read + 2] & QUEUE_FLAG_TAKEN) != 0))
+		{
+			m_queue_count--;
+		}
+		else
+		{
+			m_queue[read + 2] &= ~QUEUE_FLAG_TAKEN;
+			// Forward copy, write is never after read
+			memcpy1(m_queue + write, m_queue + read, length);
+			write += length;
+		}
+		read += length;
+	}
+	m_queue_used = write;
+	if (m_queue_count == 0)
+	{
+		// A flush ends with the last queued record
+		m_queue_flush = false;
+	}
+}
+
+/**@brief Start the queue timer
+ *
+ * @param delay Time until the queue is processed again [ms]
+ */
+static void QueueWait(uint32_t delay)
+{
+	TimerSetValue(&QueueTimer, (delay > 0) ? delay : 1);
+	TimerStart(&QueueTimer);
+}
+
+/**@brief Send the frame of the oldest queued record if it is due
+ *
+ * The frame holds the oldest record and the following records with the same
+ * port and confirmation type, as long as they fit into the maximum payload of
+ * the current datarate.
+ */
+static void QueueProcess(void)
+{
+	LoRaMacTxInfo_t txInfo;
+	TimerTime_t delay;
+	lmh_app_data_t app_data;
+	uint8_t *first = m_queue;
+	uint8_t frame_size = 0;
+	uint32_t age;
+	bool full = false;
+
+	TimerStop(&QueueTimer);
+
+	if (m_queue_count == 0)
+	{
+		return;
+	}
+	if (lmh_mac_is_busy)
+	{
+		// Resumed by McpsConfirm
+		return;
+	}
+	if (m_compliance_test.running == true)
+	{
+		QueueWait(m_queue_max_age);
+		return;
+	}
+
+	LoRaMacQueryTxPossible(0, &txInfo);
+
+	// Records larger than the frame can never be sent on this datarate
+	while ((m_queue_count > 0) && (first[0] > txInfo.MaxPossiblePayload))
+	{
+		LOG_LIB("LMH", "Queue: record of %d bytes dropped, max payload %d", first[0], txInfo.MaxPossiblePayload);
+		first[2] |= QUEUE_FLAG_TAKEN;
+		QueueCompact(true);
+		m_queue_dropped++;
+	}
+	if (m_queue_count == 0)
+	{
+		return;
+	}
+
+	for (uint8_t *record = m_queue; record < m_queue + m_queue_used; record += LMH_QUEUE_RECORD_OVERHEAD + record[0])
+	{
+		if ((record[1] != first[1]) || (((record[2] ^ first[2]) & QUEUE_FLAG_CONFIRMED) != 0))
+		{
+			continue;
+		}
+		if (frame_size + record[0] > txInfo.MaxPossiblePayload)
+		{
+			full = true;
+			break;
+		}
+		memcpy1(m_queue_frame + frame_size, record + LMH_QUEUE_RECORD_OVERHEAD, record[0]);
+		frame_size += record[0];
+		record[2] |= QUEUE_FLAG_TAKEN;
+	}
+	if (frame_size == txInfo.MaxPossiblePayload)
+	{
+		full = true;
+	}
+
+	age = TimerGetElapsedTime(QueueRecordTime(first));
+	if ((full == false) && (m_queue_flush == false) && (age < m_queue_max_age))
+	{
+		QueueCompact(false);
+		QueueWait(m_queue_max_age - age);
+		return;
+	}
+
+	// Hold the frame back until the duty cycle allows it, more records may
+	// join it meanwhile
+	if ((LoRaMacQueryTxDelay(&delay) == LORAMAC_STATUS_OK) && (delay > 0))
+	{
+		QueueCompact(false);
+		QueueWait(delay);
+		return;
+	}
+
+	app_data.buffer = m_queue_frame;
+	app_data.buffsize = frame_size;
+	app_data.port = first[1];
+	if (lmh_send(&app_data, ((first[2] & QUEUE_FLAG_CONFIRMED) != 0) ? LMH_CONFIRMED_MSG : LMH_UNCONFIRMED_MSG) == LMH_SUCCESS)
+	{
+		QueueCompact(true);
+	}
+	else
+	{
+		LOG_LIB("LMH", "Queue: lmh_send failed, retry later");
+		QueueCompact(false);
+		QueueWait(m_queue_max_age);
+	}
+}
+
+lmh_error_status lmh_queue_send(lmh_app_data_t *app_data, lmh_confirm is_txconfirmed)
+{
+	TimerTime_t now = TimerGetCurrentTime();
+	uint8_t *record = m_queue + m_queue_used;
+	LoRaMacTxInfo_t txInfo;
+
+	if ((app_data->buffsize == 0) || (app_data->buffsize > LORAWAN_APP_DATA_MAX_SIZE) ||
+		(LMH_QUEUE_RECORD_OVERHEAD + app_data->buffsize > LMH_QUEUE_BUFFER_SIZE))
+	{
+		return LMH_ERROR;
+	}
+	// Same limit as QueueProcess, a record it would drop is not accepted
+	LoRaMacQueryTxPossible(0, &txInfo);
+	if (app_data->buffsize > txInfo.MaxPossiblePayload)
+	{
+		return LMH_ERROR;
+	}
+	if (m_queue_used + LMH_QUEUE_RECORD_OVERHEAD + app_data->buffsize > LMH_QUEUE_BUFFER_SIZE)
+	{
+		// Full, send what is queued
+		m_queue_flush = true;
+		QueueProcess();
+		return LMH_BUSY;
+	}
+
+	record[0] = app_data->buffsize;
+	record[1] = app_data->port;
+	record[2] = (is_txconfirmed == LMH_CONFIRMED_MSG) ? QUEUE_FLAG_CONFIRMED : 0;
+	record[3] = now & 0xFF;
+	record[4] = (now >> 8) & 0xFF;
+	record[5] = (now >> 16) & 0xFF;
+	record[6] = (now >> 24) & 0xFF;
+	memcpy1(record + LMH_QUEUE_RECORD_OVERHEAD, app_data->buffer, app_data->buffsize);
+	m_queue_used += LMH_QUEUE_RECORD_OVERHEAD + app_data->buffsize;
+	m_queue_count++;
+
+	QueueProcess();
+	return LMH_SUCCESS;
+}
+
+lmh_error_status lmh_queue_flush(void)
+{
+	m_queue_flush = true;
+	if (lmh_mac_is_busy)
+	{
+		return LMH_BUSY;
+	}
+	QueueProcess();
+	return LMH_SUCCESS;
+}
+
+void lmh_queue_set_max_age(uint32_t max_age)
+{
+	m_queue_max_age = max_age;
+	if (m_queue_count > 0)
+	{
+		QueueProcess();
+	}
+}
+
+uint16_t lmh_queue_count(void)
+{
+	return m_queue_count;
+}
+
+uint16_t lmh_queue_dropped(void)
+{
+	return m_queue_dropped;
+}
+
 lmh_error_status lmh_class_request(DeviceClass_t newClass)
 {
 	lmh_error_status Errorstatus = LMH_SUCCESS;
@@ -1194,7 +1559,13 @@ void lmh_getAppSkey(uint8_t *key)
  */
 bool lmh_setAS923Version(uint8_t version)
 {
+#ifdef REGION_AS923
 	return RegionAS923SetVersion(version);
+#else
+	// Single region build without AS923
+	(void)version;
+	return false;
+#endif
 }
 
 /**
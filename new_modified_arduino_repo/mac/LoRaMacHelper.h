@@ -27,6 +27,8 @@
 // #include "boards/mcu/board.h"
 #include "LoRaMac.h"
 #include "Region.h"
+#include "LoRaMacContext.h"
+#include "LoRaMacNvm.h"
 #include "RegionUS915.h"
 #include "stdbool.h"
 
@@ -40,6 +42,14 @@ extern bool force_low_dr_opt;
 #define LORAWAN_DEFAULT_DATARATE DR_3		/**< LoRaWAN Default datarate*/
 #define LORAWAN_DEFAULT_TX_POWER TX_POWER_0 /**< LoRaWAN Default tx power*/
 
+#ifndef LMH_QUEUE_BUFFER_SIZE
+#define LMH_QUEUE_BUFFER_SIZE 256 /**< Size of the coalescing uplink queue, each record uses LMH_QUEUE_RECORD_OVERHEAD bytes more than its data */
+#endif
+#define LMH_QUEUE_RECORD_OVERHEAD 7 /**< Queue bytes used per record in addition to its data */
+#ifndef LMH_QUEUE_DEFAULT_MAX_AGE
+#define LMH_QUEUE_DEFAULT_MAX_AGE 60000 /**< Default time a record may wait in the uplink queue [ms] */
+#endif
+
 typedef struct lmh_param_s
 {
 	bool adr_enable;			/**< Activation state of adaptative Datarate */
@@ -71,6 +81,34 @@ typedef enum
 	LMH_CONFIRMED_MSG = !LMH_UNCONFIRMED_MSG
 } lmh_confirm;
 
+/**@brief Result of an asynchronous send
+ */
+typedef enum
+{
+	LMH_SEND_PENDING = 0, /**< TX/RX1/RX2 cycle running */
+	LMH_SEND_DONE,		  /**< Unconfirmed uplink sent, receive windows closed */
+	LMH_SEND_ACKED,		  /**< Confirmed uplink acknowledged */
+	LMH_SEND_NO_ACK,	  /**< Confirmed uplink not acknowledged after all trials */
+	LMH_SEND_FAILED,	  /**< The MAC reported an error */
+	LMH_SEND_TIMEOUT,	  /**< No confirmation from the MAC within the timeout */
+	LMH_SEND_UNKNOWN	  /**< The handle is not the one of the last asynchronous send */
+} lmh_send_status;
+
+/**@brief Handle of an asynchronous send, never 0
+ */
+typedef uint16_t lmh_send_handle_t;
+
+/**@brief Completion callback of an asynchronous send
+ *
+ * Called from the MAC event processing (McpsConfirm) or from the timeout
+ * timer. Keep it short, e.g. give a semaphore or set an RTOS event flag to
+ * wake up the application task.
+ *
+ * @param handle Handle returned by lmh_send_async
+ * @param status Result of the send
+ */
+typedef void (*lmh_send_cb_t)(lmh_send_handle_t handle, lmh_send_status status);
+
 /**@brief Application Data structure
  */
 typedef struct
@@ -181,8 +219,105 @@ typedef struct lmh_init_params_s
  */
 lmh_error_status lmh_send(lmh_app_data_t *app_data, lmh_confirm is_txconfirmed);
 
+/**@brief Send data without waiting for the end of the uplink
+ *
+ * Returns as soon as the uplink is scheduled. The MCU may sleep through the
+ * TX, RX1 and RX2 windows, the result is reported through the callback and
+ * lmh_send_status_get once the MAC has finished. Only one send can be in
+ * flight.
+ *
+ * @param app_data Pointer to data structure to be sent, the buffer must be
+ *                 kept until the frame is transmitted
+ * @param is_txconfirmed do we need confirmation?
+ * @param time_out Time after which the send completes with LMH_SEND_TIMEOUT
+ *                 if the MAC has not confirmed it [ms], 0 for no timeout.
+ *                 Runs on a MAC timer, nothing is polled.
+ * @param callback Completion callback, may be NULL
+ * @param handle Handle of the send, may be NULL
+ *
+ * @retval error status, the callback is only called on LMH_SUCCESS
+ */
+lmh_error_status lmh_send_async(lmh_app_data_t *app_data, lmh_confirm is_txconfirmed, uint32_t time_out,
+								lmh_send_cb_t callback, lmh_send_handle_t *handle);
+
+/**@brief Get the result of an asynchronous send
+ *
+ * Can be polled from another task instead of using the callback.
+ *
+ * @param handle Handle returned by lmh_send_async
+ *
+ * @retval LMH_SEND_PENDING while the uplink is running, the result after it,
+ *         LMH_SEND_UNKNOWN for the handle of an earlier send
+ */
+lmh_send_status lmh_send_status_get(lmh_send_handle_t handle);
+
+/**@brief Precompute the crypto of the next uplink while the MCU is idle
+ *
+ * Optional. Shortens the time lmh_send takes for a frame with the same
+ * port and size. Call it e.g. after the previous uplink completed.
+ *
+ * @param app_data Port and size of the next uplink, the buffer is not used
+ *
+ * @retval error status
+ */
+lmh_error_status lmh_precompute(lmh_app_data_t *app_data);
+
+/**@brief Queue a record for a coalesced uplink
+ *
+ * Records queued on the same port with the same confirmation type are sent
+ * together, concatenated into one FRMPayload of at most the maximum payload
+ * of the current datarate. Fewer, fuller frames save the frame overhead and
+ * airtime of the records sent in the same frame.
+ *
+ * A frame is sent when it is full, when its oldest record has waited for the
+ * maximum age or after lmh_queue_flush, and only once the MAC is idle and
+ * the duty cycle allows the uplink. Until then more records join it.
+ *
+ * @note The records are concatenated as they are, the receiver must be able
+ *       to split them (fixed size or self delimiting records). A record which
+ *       is larger than the maximum payload of the current datarate is not
+ *       queued. If the datarate drops before its frame is sent and the record
+ *       does not fit anymore, it is dropped and counted by lmh_queue_dropped.
+ *
+ * @param app_data Record to be queued, the data is copied
+ * @param is_txconfirmed do we need confirmation?
+ *
+ * @retval LMH_SUCCESS if queued, LMH_BUSY if the queue is full, LMH_ERROR if
+ *         the record does not fit into a frame of the current datarate
+ */
+lmh_error_status lmh_queue_send(lmh_app_data_t *app_data, lmh_confirm is_txconfirmed);
+
+/**@brief Send all queued records as soon as the duty cycle allows it
+ *
+ * @retval LMH_SUCCESS, LMH_BUSY if the MAC is busy, the records are then
+ *         sent after the current uplink
+ */
+lmh_error_status lmh_queue_flush(void);
+
+/**@brief Set the time a record may wait in the uplink queue
+ *
+ * @param max_age Maximum age [ms], default LMH_QUEUE_DEFAULT_MAX_AGE
+ */
+void lmh_queue_set_max_age(uint32_t max_age);
+
+/**@brief Get the number of records in the uplink queue
+ *
+ * @retval number of records
+ */
+uint16_t lmh_queue_count(void);
+
+/**@brief Get the number of queued records dropped because the datarate
+ *        dropped and they did not fit into a frame anymore
+ *
+ * @retval number of records dropped since the start
+ */
+uint16_t lmh_queue_dropped(void);
+
 /**@brief Send data and wait for RX2 window closed
  *  or timeout occurs
+ *
+ * @note Waits in HAL_Delay. Prefer lmh_send_async, which lets the MCU sleep.
+ *
  * @param app_data Pointer to data structure to be sent
  * @param is_txconfirmed do we need confirmation?
  * @param time_out time to wait in milliseconds
@@ -191,9 +326,25 @@ lmh_error_status lmh_send(lmh_app_data_t *app_data, lmh_confirm is_txconfirmed);
 lmh_error_status lmh_send_blocking(lmh_app_data_t *app_data, lmh_confirm is_tx_confirmed, uint32_t time_out);
 
 /**@brief Join a Lora Network in class A
+ *
+ * @note With a session log set by lmh_session_restore the new session is
+ *  persisted, after the join accept for OTAA or right away for ABP.
  */
 void lmh_join(void);
 
+/**@brief Restore the session stored before a reset
+ *
+ * Call after lmh_init. The session is persisted in the log from then on. If
+ * a session is restored the device is joined with its previous device
+ * address, keys and channels, and lmh_has_joined is called: lmh_join is not
+ * needed.
+ *
+ * @param nvm Session log initialized with LoRaMacNvmInit
+ * @retval LMH_SUCCESS if a session was restored, LMH_ERROR if lmh_join must
+ *  be called
+ */
+lmh_error_status lmh_session_restore(LoRaMacNvm_t *nvm);
+
 /**@brief Check whether the Device is joined to the network
  *
  * @retval returns LORAMACHELPER_SET if joined
@@ -0,0 +1,547 @@
+/*!
+ * \file      LoRaMacNvm.c
+ *
+ * \brief     LoRa MAC layer session persistence
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Sector header (16 bytes, little endian):
+ *            magic (4) | sequence (4) | version (2) | CRC (2) | 0xFF (4)
+ *
+ *            Record header (8 bytes), followed by the payload and padded to
+ *            LORAMAC_NVM_WRITE_ALIGN:
+ *            type (1) | 0x00 (1) | payload length (2) | CRC (2) | 0x00 (2)
+ *
+ *            The CRC is the CRC-16/CCITT of the header bytes before it, the
+ *            record CRC also covers the payload.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+#include "LoRaMacNvm.h"
+
+/*!
+ * Sector header magic, "LMNV"
+ */
+#define NVM_MAGIC 0x564E4D4C
+
+/*!
+ * Format version
+ */
+#define NVM_VERSION 1
+
+#define NVM_SECTOR_HEADER_SIZE 16
+
+#define NVM_RECORD_HEADER_SIZE 8
+
+/*!
+ * Current sector value when no sector holds a valid header
+ */
+#define NVM_NO_SECTOR 0xFF
+
+/*!
+ * Size of the buffer records are read and written through
+ */
+#define NVM_CHUNK_SIZE 32
+
+#if (NVM_SECTOR_HEADER_SIZE % LORAMAC_NVM_WRITE_ALIGN) != 0
+#error "LORAMAC_NVM_WRITE_ALIGN must be 1, 2, 4, 8 or 16"
+#endif
+
+/*!
+ * Record types
+ */
+typedef enum eNvmRecord
+{
+	NVM_RECORD_SESSION = 0x01,
+	NVM_RECORD_COUNTERS = 0x02,
+	/*!
+	 * The session before it was cleared
+	 */
+	NVM_RECORD_CLEAR = 0x03,
+	NVM_RECORD_FREE = 0xFF,
+} NvmRecord_t;
+
+/*!
+ * Payload size of a counters record
+ */
+#define NVM_COUNTERS_SIZE 8
+
+static uint16_t Crc16(uint16_t crc, const uint8_t *data, uint16_t size)
+{
+	while (size-- > 0)
+	{
+		crc ^= (uint16_t)(*data++) << 8;
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static void PutUint16(uint8_t *buffer, uint16_t value)
+{
+	buffer[0] = value & 0xFF;
+	buffer[1] = (value >> 8) & 0xFF;
+}
+
+static void PutUint32(uint8_t *buffer, uint32_t value)
+{
+	PutUint16(buffer, value & 0xFFFF);
+	PutUint16(buffer + 2, value >> 16);
+}
+
+static uint16_t GetUint16(const uint8_t *buffer)
+{
+	return (uint16_t)buffer[0] | ((uint16_t)buffer[1] << 8);
+}
+
+static uint32_t GetUint32(const uint8_t *buffer)
+{
+	return (uint32_t)GetUint16(buffer) | ((uint32_t)GetUint16(buffer + 2) << 16);
+}
+
+/*!
+ * \brief Returns the storage size of a record
+ */
+static uint32_t RecordSize(uint16_t length)
+{
+	uint32_t size = NVM_RECORD_HEADER_SIZE + length;
+
+	return (size + LORAMAC_NVM_WRITE_ALIGN - 1) & ~(uint32_t)(LORAMAC_NVM_WRITE_ALIGN - 1);
+}
+
+static uint32_t SectorAddress(const LoRaMacNvm_t *nvm, uint8_t sector)
+{
+	return (uint32_t)sector * nvm->Storage->SectorSize;
+}
+
+/*!
+ * \brief Reads the sector header
+ *
+ * \param   sequence        - Sequence number of the sector
+ * \retval  true if the header is valid
+ */
+static bool ReadSectorHeader(const LoRaMacNvm_t *nvm, uint8_t sector, uint32_t *sequence)
+{
+	uint8_t header[NVM_SECTOR_HEADER_SIZE];
+
+	if (nvm->Storage->Read(nvm->Storage->Context, SectorAddress(nvm, sector), header, sizeof(header)) == false)
+	{
+		return false;
+	}
+	if ((GetUint32(header) != NVM_MAGIC) || (GetUint16(header + 8) != NVM_VERSION) ||
+		(GetUint16(header + 10) != Crc16(0xFFFF, header, 10)))
+	{
+		return false;
+	}
+	*sequence = GetUint32(header + 4);
+	return true;
+}
+
+static bool WriteSectorHeader(const LoRaMacNvm_t *nvm, uint8_t sector, uint32_t sequence)
+{
+	uint8_t header[NVM_SECTOR_HEADER_SIZE];
+
+	memset1(header, 0xFF, sizeof(header));
+	PutUint32(header, NVM_MAGIC);
+	PutUint32(header + 4, sequence);
+	PutUint16(header + 8, NVM_VERSION);
+	PutUint16(header + 10, Crc16(0xFFFF, header, 10));
+	return nvm->Storage->Write(nvm->Storage->Context, SectorAddress(nvm, sector), header, sizeof(header));
+}
+
+/*!
+ * \brief Reads a record header and checks the CRC of the record
+ *
+ * \param   address         - Address of the record
+ * \param   end             - End of the sector
+ * \param   type            - Record type, NVM_RECORD_FREE at the end of the
+ *                            log
+ * \param   length          - Payload length
+ * \retval  false if the record is corrupted
+ */
+static bool ReadRecord(const LoRaMacNvm_t *nvm, uint32_t address, uint32_t end, uint8_t *type, uint16_t *length)
+{
+	uint8_t chunk[NVM_CHUNK_SIZE];
+	uint16_t crc;
+	uint16_t recordCrc;
+	uint16_t offset = 0;
+
+	if ((address + NVM_RECORD_HEADER_SIZE) > end)
+	{
+		*type = NVM_RECORD_FREE;
+		return true;
+	}
+	if (nvm->Storage->Read(nvm->Storage->Context, address, chunk, NVM_RECORD_HEADER_SIZE) == false)
+	{
+		return false;
+	}
+	*type = chunk[0];
+	*length = GetUint16(chunk + 2);
+	if ((*type == NVM_RECORD_FREE) && (*length == 0xFFFF))
+	{
+		return true;
+	}
+	// Not covered by the CRC, a record torn there is not complete either
+	if ((chunk[1] != 0) || (chunk[6] != 0) || (chunk[7] != 0))
+	{
+		return false;
+	}
+	if ((address + RecordSize(*length)) > end)
+	{
+		return false;
+	}
+
+	recordCrc = GetUint16(chunk + 4);
+	crc = Crc16(0xFFFF, chunk, 4);
+	while (offset < *length)
+	{
+		uint16_t size = *length - offset;
+
+		if (size > sizeof(chunk))
+		{
+			size = sizeof(chunk);
+		}
+		if (nvm->Storage->Read(nvm->Storage->Context, address + NVM_RECORD_HEADER_SIZE + offset, chunk, size) == false)
+		{
+			return false;
+		}
+		crc = Crc16(crc, chunk, size);
+		offset += size;
+	}
+	return crc == recordCrc;
+}
+
+/*!
+ * \brief Writes a record: header, payload and padding
+ *
+ * \param   address         - Address of the record, aligned
+ * \param   type            - Record type
+ * \param   payload         - Payload, read from the storage at source if
+ *                            NULL
+ * \param   source          - Address of the payload to copy
+ * \param   length          - Payload length
+ */
+static bool WriteRecord(const LoRaMacNvm_t *nvm, uint32_t address, uint8_t type, const uint8_t *payload, uint32_t source, uint16_t length)
+{
+	uint8_t chunk[NVM_CHUNK_SIZE];
+	uint16_t crc;
+	uint32_t size = RecordSize(length);
+	uint32_t offset;
+	uint16_t fill;
+
+	// CRC first, the header is written before the payload
+	chunk[0] = type;
+	chunk[1] = 0;
+	PutUint16(chunk + 2, length);
+	crc = Crc16(0xFFFF, chunk, 4);
+	for (offset = 0; offset < length; offset += fill)
+	{
+		fill = ((length - offset) > sizeof(chunk)) ? sizeof(chunk) : (length - offset);
+		if (payload != NULL)
+		{
+			crc = Crc16(crc, payload + offset, fill);
+		}
+		else
+		{
+			if (nvm->Storage->Read(nvm->Storage->Context, source + offset, chunk, fill) == false)
+			{
+				return false;
+			}
+			crc = Crc16(crc, chunk, fill);
+		}
+	}
+
+	// Stream header and payload through the chunk buffer
+	chunk[0] = type;
+	chunk[1] = 0;
+	PutUint16(chunk + 2, length);
+	PutUint16(chunk + 4, crc);
+	chunk[6] = 0;
+	chunk[7] = 0;
+	fill = NVM_RECORD_HEADER_SIZE;
+	offset = 0;
+	while (size > 0)
+	{
+		uint16_t copy = sizeof(chunk) - fill;
+
+		if (copy > (length - offset))
+		{
+			copy = length - offset;
+		}
+		if (copy > 0)
+		{
+			if (payload != NULL)
+			{
+				memcpy1(chunk + fill, payload + offset, copy);
+			}
+			else if (nvm->Storage->Read(nvm->Storage->Context, source + offset, chunk + fill, copy) == false)
+			{
+				return false;
+			}
+			fill += copy;
+			offset += copy;
+		}
+		if ((fill < sizeof(chunk)) && (fill < size))
+		{
+			// End of the payload, pad to the alignment
+			uint16_t padded = (fill + LORAMAC_NVM_WRITE_ALIGN - 1) & ~(LORAMAC_NVM_WRITE_ALIGN - 1);
+
+			memset1(chunk + fill, 0xFF, padded - fill);
+			fill = padded;
+		}
+		if (nvm->Storage->Write(nvm->Storage->Context, address, chunk, fill) == false)
+		{
+			return false;
+		}
+		address += fill;
+		size -= fill;
+		fill = 0;
+	}
+	return true;
+}
+
+/*!
+ * \brief Appends a record. Moves to the next sector if the current one is
+ *        full, the latest session is copied along unless the record
+ *        replaces it.
+ *
+ * \param   address         - Address the record was written to
+ */
+static LoRaMacNvmStatus_t Append(LoRaMacNvm_t *nvm, uint8_t type, const uint8_t *payload, uint16_t length, uint32_t *address)
+{
+	const LoRaMacNvmStorage_t *storage = nvm->Storage;
+	uint32_t size = RecordSize(length);
+
+	if ((nvm->Sector == NVM_NO_SECTOR) || ((nvm->WriteOffset + size) > storage->SectorSize))
+	{
+		uint8_t sector = (nvm->Sector == NVM_NO_SECTOR) ? 0 : (nvm->Sector + 1) % storage->NbSectors;
+		uint32_t base = SectorAddress(nvm, sector);
+		uint32_t offset = NVM_SECTOR_HEADER_SIZE;
+		uint32_t sessionAddress = nvm->SessionAddress;
+
+		if (storage->Erase(storage->Context, sector) == false)
+		{
+			return LORAMAC_NVM_STORAGE_ERROR;
+		}
+		nvm->NbErases++;
+
+		if ((nvm->HasSession == true) && (type != NVM_RECORD_SESSION) && (type != NVM_RECORD_CLEAR))
+		{
+			sessionAddress = base + offset;
+			if (WriteRecord(nvm, sessionAddress, NVM_RECORD_SESSION, NULL, nvm->SessionAddress + NVM_RECORD_HEADER_SIZE,
+							sizeof(LoRaMacNvmSession_t)) == false)
+			{
+				return LORAMAC_NVM_STORAGE_ERROR;
+			}
+			offset += RecordSize(sizeof(LoRaMacNvmSession_t));
+		}
+		if (WriteRecord(nvm, base + offset, type, payload, 0, length) == false)
+		{
+			return LORAMAC_NVM_STORAGE_ERROR;
+		}
+		// The sector becomes the current one once its header is written
+		if (WriteSectorHeader(nvm, sector, nvm->Sequence + 1) == false)
+		{
+			return LORAMAC_NVM_STORAGE_ERROR;
+		}
+		nvm->Sector = sector;
+		nvm->Sequence++;
+		nvm->SessionAddress = sessionAddress;
+		*address = base + offset;
+		nvm->WriteOffset = offset + size;
+		return LORAMAC_NVM_SUCCESS;
+	}
+
+	*address = SectorAddress(nvm, nvm->Sector) + nvm->WriteOffset;
+	nvm->WriteOffset += size;
+	if (WriteRecord(nvm, *address, type, payload, 0, length) == false)
+	{
+		// The scan stops at the torn record and would miss the records
+		// after it, the next one goes to a new sector
+		nvm->WriteOffset = storage->SectorSize;
+		return LORAMAC_NVM_STORAGE_ERROR;
+	}
+	return LORAMAC_NVM_SUCCESS;
+}
+
+LoRaMacNvmStatus_t LoRaMacNvmInit(LoRaMacNvm_t *nvm, const LoRaMacNvmStorage_t *storage, uint32_t stride)
+{
+	uint32_t sequence;
+	uint32_t base;
+	uint32_t end;
+	uint32_t offset;
+
+	if ((nvm == NULL) || (storage == NULL) || (storage->NbSectors < 2) || (storage->NbSectors == NVM_NO_SECTOR) ||
+		(storage->SectorSize < (NVM_SECTOR_HEADER_SIZE + RecordSize(sizeof(LoRaMacNvmSession_t)) + RecordSize(NVM_COUNTERS_SIZE))))
+	{
+		return LORAMAC_NVM_PARAMETER_INVALID;
+	}
+
+	memset1((uint8_t *)nvm, 0, sizeof(LoRaMacNvm_t));
+	nvm->Storage = storage;
+	nvm->Stride = (stride == 0) ? LORAMAC_NVM_DEFAULT_STRIDE : stride;
+	nvm->Sector = NVM_NO_SECTOR;
+
+	for (uint8_t sector = 0; sector < storage->NbSectors; sector++)
+	{
+		if ((ReadSectorHeader(nvm, sector, &sequence) == true) &&
+			((nvm->Sector == NVM_NO_SECTOR) || ((int32_t)(sequence - nvm->Sequence) > 0)))
+		{
+			nvm->Sector = sector;
+			nvm->Sequence = sequence;
+		}
+	}
+	if (nvm->Sector == NVM_NO_SECTOR)
+	{
+		return LORAMAC_NVM_EMPTY;
+	}
+
+	base = SectorAddress(nvm, nvm->Sector);
+	end = base + storage->SectorSize;
+	offset = NVM_SECTOR_HEADER_SIZE;
+	while (true)
+	{
+		uint8_t type;
+		uint16_t length;
+		uint8_t counters[NVM_COUNTERS_SIZE];
+
+		if (ReadRecord(nvm, base + offset, end, &type, &length) == false)
+		{
+			// Torn write, the rest of the sector may not be erased
+			LOG_LIB("NVM", "Corrupted record at %lu", (unsigned long)(base + offset));
+			offset = storage->SectorSize;
+			break;
+		}
+		if (type == NVM_RECORD_FREE)
+		{
+			break;
+		}
+
+		if ((type == NVM_RECORD_SESSION) && (length == sizeof(LoRaMacNvmSession_t)))
+		{
+			// The snapshot is stored as it is laid out in memory
+			nvm->SessionAddress = base + offset;
+			nvm->HasSession = true;
+			if ((storage->Read(storage->Context, nvm->SessionAddress + NVM_RECORD_HEADER_SIZE + offsetof(LoRaMacNvmSession_t, UpLinkCounter),
+							   (uint8_t *)&nvm->UpLinkCounter, sizeof(uint32_t)) == false) ||
+				(storage->Read(storage->Context, nvm->SessionAddress + NVM_RECORD_HEADER_SIZE + offsetof(LoRaMacNvmSession_t, DownLinkCounter),
+							   (uint8_t *)&nvm->DownLinkCounter, sizeof(uint32_t)) == false))
+			{
+				return LORAMAC_NVM_STORAGE_ERROR;
+			}
+		}
+		else if (type == NVM_RECORD_SESSION)
+		{
+			// Written by a firmware with another session layout
+			nvm->HasSession = false;
+		}
+		else if ((type == NVM_RECORD_COUNTERS) && (length == NVM_COUNTERS_SIZE) && (nvm->HasSession == true))
+		{
+			if (storage->Read(storage->Context, base + offset + NVM_RECORD_HEADER_SIZE, counters, NVM_COUNTERS_SIZE) == false)
+			{
+				return LORAMAC_NVM_STORAGE_ERROR;
+			}
+			nvm->UpLinkCounter = GetUint32(counters);
+			nvm->DownLinkCounter = GetUint32(counters + 4);
+		}
+		else if (type == NVM_RECORD_CLEAR)
+		{
+			nvm->HasSession = false;
+		}
+		offset += RecordSize(length);
+	}
+	nvm->WriteOffset = offset;
+
+	return (nvm->HasSession == true) ? LORAMAC_NVM_SUCCESS : LORAMAC_NVM_EMPTY;
+}
+
+LoRaMacNvmStatus_t LoRaMacNvmReadSession(LoRaMacNvm_t *nvm, LoRaMacNvmSession_t *session)
+{
+	if ((nvm == NULL) || (nvm->Storage == NULL) || (session == NULL))
+	{
+		return LORAMAC_NVM_PARAMETER_INVALID;
+	}
+	if (nvm->HasSession == false)
+	{
+		return LORAMAC_NVM_EMPTY;
+	}
+	if (nvm->Storage->Read(nvm->Storage->Context, nvm->SessionAddress + NVM_RECORD_HEADER_SIZE, (uint8_t *)session,
+						   sizeof(LoRaMacNvmSession_t)) == false)
+	{
+		return LORAMAC_NVM_STORAGE_ERROR;
+	}
+	session->UpLinkCounter = nvm->UpLinkCounter;
+	session->DownLinkCounter = nvm->DownLinkCounter;
+	return LORAMAC_NVM_SUCCESS;
+}
+
+LoRaMacNvmStatus_t LoRaMacNvmWriteSession(LoRaMacNvm_t *nvm, const LoRaMacNvmSession_t *session)
+{
+	LoRaMacNvmStatus_t status;
+	uint32_t address;
+
+	if ((nvm == NULL) || (nvm->Storage == NULL) || (session == NULL))
+	{
+		return LORAMAC_NVM_PARAMETER_INVALID;
+	}
+	status = Append(nvm, NVM_RECORD_SESSION, (const uint8_t *)session, sizeof(LoRaMacNvmSession_t), &address);
+	if (status == LORAMAC_NVM_SUCCESS)
+	{
+		nvm->SessionAddress = address;
+		nvm->HasSession = true;
+		nvm->UpLinkCounter = session->UpLinkCounter;
+		nvm->DownLinkCounter = session->DownLinkCounter;
+	}
+	return status;
+}
+
+LoRaMacNvmStatus_t LoRaMacNvmWriteCounters(LoRaMacNvm_t *nvm, uint32_t upLinkCounter, uint32_t downLinkCounter)
+{
+	LoRaMacNvmStatus_t status;
+	uint8_t counters[NVM_COUNTERS_SIZE];
+	uint32_t address;
+
+	if ((nvm == NULL) || (nvm->Storage == NULL))
+	{
+		return LORAMAC_NVM_PARAMETER_INVALID;
+	}
+	if (nvm->HasSession == false)
+	{
+		return LORAMAC_NVM_EMPTY;
+	}
+	PutUint32(counters, upLinkCounter);
+	PutUint32(counters + 4, downLinkCounter);
+	status = Append(nvm, NVM_RECORD_COUNTERS, counters, NVM_COUNTERS_SIZE, &address);
+	if (status == LORAMAC_NVM_SUCCESS)
+	{
+		nvm->UpLinkCounter = upLinkCounter;
+		nvm->DownLinkCounter = downLinkCounter;
+	}
+	return status;
+}
+
+LoRaMacNvmStatus_t LoRaMacNvmClear(LoRaMacNvm_t *nvm)
+{
+	LoRaMacNvmStatus_t status;
+	uint32_t address;
+
+	if ((nvm == NULL) || (nvm->Storage == NULL))
+	{
+		return LORAMAC_NVM_PARAMETER_INVALID;
+	}
+	if (nvm->HasSession == false)
+	{
+		return LORAMAC_NVM_SUCCESS;
+	}
+	status = Append(nvm, NVM_RECORD_CLEAR, NULL, 0, &address);
+	if (status == LORAMAC_NVM_SUCCESS)
+	{
+		nvm->HasSession = false;
+	}
+	return status;
+}
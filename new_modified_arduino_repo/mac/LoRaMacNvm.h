@@ -0,0 +1,282 @@
+/*!
+ * \file      LoRaMacNvm.h
+ *
+ * \brief     LoRa MAC layer session persistence
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \defgroup  LORAMAC_NVM LoRa MAC layer session persistence
+ *            Keeps the session (device address, session keys, frame
+ *            counters, MAC parameters and channel plan) in non volatile
+ *            memory, so a device restarts with its session instead of
+ *            joining again.
+ *
+ *            Log format
+ *            The storage is split into erase sectors used round robin. A
+ *            sector holds a header and a sequence of records appended one
+ *            after the other: full session snapshots and frame counter
+ *            checkpoints. The valid sector with the highest sequence number
+ *            is the current one, its last snapshot and the checkpoints
+ *            following it give the session. When the current sector is full
+ *            the next one is erased, the latest snapshot and checkpoint are
+ *            copied to it and its header is written last. A write torn by a
+ *            reset leaves either the previous sector current or a record
+ *            with a bad CRC, which ends the log of the sector.
+ *
+ *            Frame counters
+ *            The uplink counter is not written for every frame. A checkpoint
+ *            stores a ceiling Stride frames ahead, and is written before the
+ *            first frame reaching it is sent. A restored session starts at
+ *            the ceiling, so no frame counter value is used twice. The
+ *            downlink counter is checkpointed every Stride frames and
+ *            restored as is: up to Stride frames already received could be
+ *            accepted again, no new frame is rejected.
+ */
+#ifndef __LORAMAC_NVM_H__
+#define __LORAMAC_NVM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "LoRaMac.h"
+#include "region/Region.h"
+
+/*!
+ * Program granularity of the storage [byte]. Records start and end on a
+ * multiple of it, so each one is programmed on erased words only.
+ */
+#ifndef LORAMAC_NVM_WRITE_ALIGN
+#define LORAMAC_NVM_WRITE_ALIGN 8
+#endif
+
+/*!
+ * Default number of uplink frames between two frame counter checkpoints
+ */
+#define LORAMAC_NVM_DEFAULT_STRIDE 64
+
+/*!
+ * The file backed storage is available on POSIX hosts. Define
+ * LORAMAC_NVM_NO_FILE to leave it out.
+ */
+#if !defined(LORAMAC_NVM_NO_FILE) && !defined(ARDUINO) && \
+	(defined(__linux__) || defined(__APPLE__))
+#define LORAMAC_NVM_FILE
+#endif
+
+/*!
+ * Persistence operation status
+ */
+typedef enum eLoRaMacNvmStatus
+{
+	/*!
+	 * Operation done
+	 */
+	LORAMAC_NVM_SUCCESS = 0,
+	/*!
+	 * No session stored
+	 */
+	LORAMAC_NVM_EMPTY,
+	/*!
+	 * Invalid parameter, or a record larger than a sector
+	 */
+	LORAMAC_NVM_PARAMETER_INVALID,
+	/*!
+	 * The storage reported an error
+	 */
+	LORAMAC_NVM_STORAGE_ERROR,
+} LoRaMacNvmStatus_t;
+
+/*!
+ * Non volatile storage. Erased bytes read as 0xFF, a write only programs
+ * erased bytes (flash semantics). Each function returns false on error.
+ */
+typedef struct sLoRaMacNvmStorage
+{
+	/*!
+	 * Size of an erase sector [byte]
+	 */
+	uint32_t SectorSize;
+	/*!
+	 * Number of sectors, at least 2
+	 */
+	uint8_t NbSectors;
+	/*!
+	 * Reads from the storage
+	 *
+	 * \param   context         - Context of the storage
+	 * \param   address         - Offset from the start of the storage
+	 * \param   buffer          - Data read
+	 * \param   size            - Number of bytes
+	 */
+	bool (*Read)(void *context, uint32_t address, uint8_t *buffer, uint16_t size);
+	/*!
+	 * Programs erased bytes
+	 *
+	 * \param   context         - Context of the storage
+	 * \param   address         - Offset from the start of the storage, a
+	 *                            multiple of LORAMAC_NVM_WRITE_ALIGN
+	 * \param   buffer          - Data to write
+	 * \param   size            - Number of bytes, a multiple of
+	 *                            LORAMAC_NVM_WRITE_ALIGN
+	 */
+	bool (*Write)(void *context, uint32_t address, const uint8_t *buffer, uint16_t size);
+	/*!
+	 * Erases a sector
+	 *
+	 * \param   context         - Context of the storage
+	 * \param   sector          - Sector index
+	 */
+	bool (*Erase)(void *context, uint8_t sector);
+	/*!
+	 * Context passed to the functions
+	 */
+	void *Context;
+} LoRaMacNvmStorage_t;
+
+/*!
+ * Session snapshot
+ */
+typedef struct sLoRaMacNvmSession
+{
+	LoRaMacRegion_t Region;
+	uint32_t DevAddr;
+	uint32_t NetID;
+	uint8_t NwkSKey[16];
+	uint8_t AppSKey[16];
+	/*!
+	 * Uplink counter ceiling, the next uplink of a restored session uses it
+	 */
+	uint32_t UpLinkCounter;
+	uint32_t DownLinkCounter;
+	bool AdrCtrlOn;
+	uint8_t MaxDCycle;
+	uint16_t AggregatedDCycle;
+	LoRaMacParams_t Params;
+	ChannelParams_t Channels[REGION_MAX_NB_CHANNELS];
+	uint16_t ChannelsMask[6];
+	uint16_t ChannelsDefaultMask[6];
+} LoRaMacNvmSession_t;
+
+/*!
+ * Session log on a storage
+ */
+typedef struct sLoRaMacNvm
+{
+	const LoRaMacNvmStorage_t *Storage;
+	/*!
+	 * Number of uplink frames between two checkpoints
+	 */
+	uint32_t Stride;
+	/*!
+	 * Current sector, 0xFF if no sector holds a valid header
+	 */
+	uint8_t Sector;
+	/*!
+	 * Sequence number of the current sector
+	 */
+	uint32_t Sequence;
+	/*!
+	 * Offset of the free space in the current sector
+	 */
+	uint32_t WriteOffset;
+	/*!
+	 * Offset of the latest snapshot in the storage, valid if HasSession
+	 */
+	uint32_t SessionAddress;
+	bool HasSession;
+	/*!
+	 * Counters of the latest checkpoint (or snapshot)
+	 */
+	uint32_t UpLinkCounter;
+	uint32_t DownLinkCounter;
+	/*!
+	 * Number of sector erases since LoRaMacNvmInit
+	 */
+	uint32_t NbErases;
+} LoRaMacNvm_t;
+
+/*!
+ * \brief Scans the storage and finds the latest session
+ *
+ * \param   nvm             - Session log
+ * \param   storage         - Storage, must stay valid while nvm is used
+ * \param   stride          - Uplink frames between two checkpoints, 0 for
+ *                            LORAMAC_NVM_DEFAULT_STRIDE
+ * \retval  LORAMAC_NVM_SUCCESS if a session was found, LORAMAC_NVM_EMPTY
+ *          if none, or an error
+ */
+LoRaMacNvmStatus_t LoRaMacNvmInit(LoRaMacNvm_t *nvm, const LoRaMacNvmStorage_t *storage, uint32_t stride);
+
+/*!
+ * \brief Reads the latest session, with the counters of the latest
+ *        checkpoint
+ *
+ * \param   nvm             - Session log
+ * \param   session         - Session read
+ * \retval  Operation status
+ */
+LoRaMacNvmStatus_t LoRaMacNvmReadSession(LoRaMacNvm_t *nvm, LoRaMacNvmSession_t *session);
+
+/*!
+ * \brief Appends a session snapshot
+ *
+ * \param   nvm             - Session log
+ * \param   session         - Session to write
+ * \retval  Operation status
+ */
+LoRaMacNvmStatus_t LoRaMacNvmWriteSession(LoRaMacNvm_t *nvm, const LoRaMacNvmSession_t *session);
+
+/*!
+ * \brief Appends a frame counter checkpoint
+ *
+ * \param   nvm             - Session log
+ * \param   upLinkCounter   - Uplink counter ceiling
+ * \param   downLinkCounter - Downlink counter
+ * \retval  Operation status, LORAMAC_NVM_EMPTY if no session is stored
+ */
+LoRaMacNvmStatus_t LoRaMacNvmWriteCounters(LoRaMacNvm_t *nvm, uint32_t upLinkCounter, uint32_t downLinkCounter);
+
+/*!
+ * \brief Forgets the stored session, e.g. before a new join
+ *
+ * \param   nvm             - Session log
+ * \retval  Operation status
+ */
+LoRaMacNvmStatus_t LoRaMacNvmClear(LoRaMacNvm_t *nvm);
+
+#if defined(LORAMAC_NVM_FILE)
+
+/*!
+ * File backed storage for host tests. Behaves like a flash memory: writes
+ * only clear bits, erases set a whole sector to 0xFF.
+ */
+typedef struct sLoRaMacNvmFile
+{
+	LoRaMacNvmStorage_t Storage;
+	int Fd;
+	/*!
+	 * Number of erases of each sector since the file was opened
+	 */
+	uint32_t *EraseCounts;
+} LoRaMacNvmFile_t;
+
+/*!
+ * \brief Opens the file, creates it erased if it does not exist
+ *
+ * \param   file            - File storage
+ * \param   path            - Path of the file
+ * \param   sectorSize      - Size of a sector [byte]
+ * \param   nbSectors       - Number of sectors
+ * \retval  true on success
+ */
+bool LoRaMacNvmFileOpen(LoRaMacNvmFile_t *file, const char *path, uint32_t sectorSize, uint8_t nbSectors);
+
+/*!
+ * \brief Closes the file
+ *
+ * \param   file            - File storage
+ */
+void LoRaMacNvmFileClose(LoRaMacNvmFile_t *file);
+
+#endif
+
+#endif // __LORAMAC_NVM_H__
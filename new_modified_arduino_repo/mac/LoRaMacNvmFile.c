@@ -0,0 +1,147 @@
+/*!
+ * \file      LoRaMacNvmFile.c
+ *
+ * \brief     LoRa MAC layer file backed session storage for host tests
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    The file is the image of a flash memory. A write reads the
+ *            bytes back and clears bits only, like programming a flash word
+ *            does, so a record written over non erased bytes is corrupted
+ *            the same way as on the device.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+#include "LoRaMacNvm.h"
+
+#if defined(LORAMAC_NVM_FILE)
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static bool FileRead(void *context, uint32_t address, uint8_t *buffer, uint16_t size)
+{
+	LoRaMacNvmFile_t *file = context;
+
+	if ((address + size) > (file->Storage.SectorSize * file->Storage.NbSectors))
+	{
+		return false;
+	}
+	return pread(file->Fd, buffer, size, address) == size;
+}
+
+static bool FileWrite(void *context, uint32_t address, const uint8_t *buffer, uint16_t size)
+{
+	LoRaMacNvmFile_t *file = context;
+	uint8_t current[64];
+
+	while (size > 0)
+	{
+		uint16_t chunk = (size > sizeof(current)) ? sizeof(current) : size;
+
+		if (FileRead(file, address, current, chunk) == false)
+		{
+			return false;
+		}
+		for (uint16_t i = 0; i < chunk; i++)
+		{
+			current[i] &= buffer[i];
+		}
+		if (pwrite(file->Fd, current, chunk, address) != chunk)
+		{
+			return false;
+		}
+		address += chunk;
+		buffer += chunk;
+		size -= chunk;
+	}
+	return true;
+}
+
+static bool FileErase(void *context, uint8_t sector)
+{
+	LoRaMacNvmFile_t *file = context;
+	uint8_t erased[64];
+	uint32_t address = sector * file->Storage.SectorSize;
+
+	if (sector >= file->Storage.NbSectors)
+	{
+		return false;
+	}
+	memset1(erased, 0xFF, sizeof(erased));
+	for (uint32_t offset = 0; offset < file->Storage.SectorSize; offset += sizeof(erased))
+	{
+		uint32_t chunk = file->Storage.SectorSize - offset;
+
+		if (chunk > sizeof(erased))
+		{
+			chunk = sizeof(erased);
+		}
+		if (pwrite(file->Fd, erased, chunk, address + offset) != (ssize_t)chunk)
+		{
+			return false;
+		}
+	}
+	file->EraseCounts[sector]++;
+	return true;
+}
+
+bool LoRaMacNvmFileOpen(LoRaMacNvmFile_t *file, const char *path, uint32_t sectorSize, uint8_t nbSectors)
+{
+	struct stat info;
+
+	file->Storage.SectorSize = sectorSize;
+	file->Storage.NbSectors = nbSectors;
+	file->Storage.Read = FileRead;
+	file->Storage.Write = FileWrite;
+	file->Storage.Erase = FileErase;
+	file->Storage.Context = file;
+
+	file->EraseCounts = calloc(nbSectors, sizeof(uint32_t));
+	if (file->EraseCounts == NULL)
+	{
+		return false;
+	}
+	file->Fd = open(path, O_RDWR | O_CREAT, 0644);
+	if ((file->Fd < 0) || (fstat(file->Fd, &info) != 0))
+	{
+		LoRaMacNvmFileClose(file);
+		return false;
+	}
+	if (info.st_size != (off_t)sectorSize * nbSectors)
+	{
+		// New file, or one of another geometry: start erased
+		if (ftruncate(file->Fd, 0) != 0)
+		{
+			LoRaMacNvmFileClose(file);
+			return false;
+		}
+		for (uint8_t sector = 0; sector < nbSectors; sector++)
+		{
+			if (FileErase(file, sector) == false)
+			{
+				LoRaMacNvmFileClose(file);
+				return false;
+			}
+			file->EraseCounts[sector] = 0;
+		}
+	}
+	return true;
+}
+
+void LoRaMacNvmFileClose(LoRaMacNvmFile_t *file)
+{
+	if (file->Fd >= 0)
+	{
+		close(file->Fd);
+	}
+	file->Fd = -1;
+	free(file->EraseCounts);
+	file->EraseCounts = NULL;
+}
+
+#endif
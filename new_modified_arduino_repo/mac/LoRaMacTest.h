@@ -76,4 +76,13 @@ void LoRaMacTestSetDutyCycleOn(bool enable);
  */
 void LoRaMacTestSetChannel(uint8_t channel);
 
+/*!
+ * The functions below run on the given instance. Apart from that they are
+ * the same as the functions without the Ctx part in their name.
+ */
+void LoRaMacCtxTestRxWindowsOn(LoRaMacContext_t *ctx, bool enable);
+void LoRaMacCtxTestSetMic(LoRaMacContext_t *ctx, uint16_t txPacketCounter);
+void LoRaMacCtxTestSetDutyCycleOn(LoRaMacContext_t *ctx, bool enable);
+void LoRaMacCtxTestSetChannel(LoRaMacContext_t *ctx, uint8_t channel);
+
 #endif // __LORAMACTEST_H__
@@ -27,6 +27,14 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 
 // Regional includes
 #include "Region.h"
+#include "utilities.h"
+
+/*!
+ * Channel masks, shared by all regions
+ */
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[6];
 
 // Setup regions
 #ifdef REGION_AS923
@@ -102,6 +110,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define AS923_APPLY_DR_OFFSET() \
 	AS923_CASE { return RegionAS923ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define AS923_SAVE_CONTEXT()             \
+	AS923_CASE                           \
+	{                                    \
+		RegionAS923SaveContext(context); \
+		break;                           \
+	}
+#define AS923_RESTORE_CONTEXT()             \
+	AS923_CASE                              \
+	{                                       \
+		RegionAS923RestoreContext(context); \
+		break;                              \
+	}
 // AS923_2 starts here
 #define AS923_2_CASE case LORAMAC_REGION_AS923_2:
 #define AS923_2_IS_ACTIVE() \
@@ -174,6 +194,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define AS923_2_APPLY_DR_OFFSET() \
 	AS923_2_CASE { return RegionAS923ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define AS923_2_SAVE_CONTEXT()           \
+	AS923_2_CASE                         \
+	{                                    \
+		RegionAS923SaveContext(context); \
+		break;                           \
+	}
+#define AS923_2_RESTORE_CONTEXT()           \
+	AS923_2_CASE                            \
+	{                                       \
+		RegionAS923RestoreContext(context); \
+		break;                              \
+	}
 // AS923_3 starts here
 #define AS923_3_CASE case LORAMAC_REGION_AS923_3:
 #define AS923_3_IS_ACTIVE() \
@@ -246,6 +278,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define AS923_3_APPLY_DR_OFFSET() \
 	AS923_3_CASE { return RegionAS923ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define AS923_3_SAVE_CONTEXT()           \
+	AS923_3_CASE                         \
+	{                                    \
+		RegionAS923SaveContext(context); \
+		break;                           \
+	}
+#define AS923_3_RESTORE_CONTEXT()           \
+	AS923_3_CASE                            \
+	{                                       \
+		RegionAS923RestoreContext(context); \
+		break;                              \
+	}
 // AS923_4 starts here
 #define AS923_4_CASE case LORAMAC_REGION_AS923_4:
 #define AS923_4_IS_ACTIVE() \
@@ -318,6 +362,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define AS923_4_APPLY_DR_OFFSET() \
 	AS923_4_CASE { return RegionAS923ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define AS923_4_SAVE_CONTEXT()           \
+	AS923_4_CASE                         \
+	{                                    \
+		RegionAS923SaveContext(context); \
+		break;                           \
+	}
+#define AS923_4_RESTORE_CONTEXT()           \
+	AS923_4_CASE                            \
+	{                                       \
+		RegionAS923RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define AS923_IS_ACTIVE()
 #define AS923_GET_PHY_PARAM()
@@ -342,6 +398,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define AS923_CHANNEL_REMOVE()
 #define AS923_SET_CONTINUOUS_WAVE()
 #define AS923_APPLY_DR_OFFSET()
+#define AS923_SAVE_CONTEXT()
+#define AS923_RESTORE_CONTEXT()
 // AS923_2 starts here
 #define AS923_2_IS_ACTIVE()
 #define AS923_2_GET_PHY_PARAM()
@@ -366,6 +424,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define AS923_2_CHANNEL_REMOVE()
 #define AS923_2_SET_CONTINUOUS_WAVE()
 #define AS923_2_APPLY_DR_OFFSET()
+#define AS923_2_SAVE_CONTEXT()
+#define AS923_2_RESTORE_CONTEXT()
 //AS923_3 starts here
 #define AS923_3_IS_ACTIVE()
 #define AS923_3_GET_PHY_PARAM()
@@ -390,6 +450,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define AS923_3_CHANNEL_REMOVE()
 #define AS923_3_SET_CONTINUOUS_WAVE()
 #define AS923_3_APPLY_DR_OFFSET()
+#define AS923_3_SAVE_CONTEXT()
+#define AS923_3_RESTORE_CONTEXT()
 // AS923_4 starts here
 #define AS923_4_IS_ACTIVE()
 #define AS923_4_GET_PHY_PARAM()
@@ -414,6 +476,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define AS923_4_CHANNEL_REMOVE()
 #define AS923_4_SET_CONTINUOUS_WAVE()
 #define AS923_4_APPLY_DR_OFFSET()
+#define AS923_4_SAVE_CONTEXT()
+#define AS923_4_RESTORE_CONTEXT()
 
 #endif
 
@@ -490,6 +554,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define AU915_APPLY_DR_OFFSET() \
 	AU915_CASE { return RegionAU915ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define AU915_SAVE_CONTEXT()             \
+	AU915_CASE                           \
+	{                                    \
+		RegionAU915SaveContext(context); \
+		break;                           \
+	}
+#define AU915_RESTORE_CONTEXT()             \
+	AU915_CASE                              \
+	{                                       \
+		RegionAU915RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define AU915_IS_ACTIVE()
 #define AU915_GET_PHY_PARAM()
@@ -514,6 +590,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define AU915_CHANNEL_REMOVE()
 #define AU915_SET_CONTINUOUS_WAVE()
 #define AU915_APPLY_DR_OFFSET()
+#define AU915_SAVE_CONTEXT()
+#define AU915_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_CN470
@@ -589,6 +667,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define CN470_APPLY_DR_OFFSET() \
 	CN470_CASE { return RegionCN470ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define CN470_SAVE_CONTEXT()             \
+	CN470_CASE                           \
+	{                                    \
+		RegionCN470SaveContext(context); \
+		break;                           \
+	}
+#define CN470_RESTORE_CONTEXT()             \
+	CN470_CASE                              \
+	{                                       \
+		RegionCN470RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define CN470_IS_ACTIVE()
 #define CN470_GET_PHY_PARAM()
@@ -613,6 +703,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define CN470_CHANNEL_REMOVE()
 #define CN470_SET_CONTINUOUS_WAVE()
 #define CN470_APPLY_DR_OFFSET()
+#define CN470_SAVE_CONTEXT()
+#define CN470_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_CN779
@@ -688,6 +780,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define CN779_APPLY_DR_OFFSET() \
 	CN779_CASE { return RegionCN779ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define CN779_SAVE_CONTEXT()             \
+	CN779_CASE                           \
+	{                                    \
+		RegionCN779SaveContext(context); \
+		break;                           \
+	}
+#define CN779_RESTORE_CONTEXT()             \
+	CN779_CASE                              \
+	{                                       \
+		RegionCN779RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define CN779_IS_ACTIVE()
 #define CN779_GET_PHY_PARAM()
@@ -712,6 +816,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define CN779_CHANNEL_REMOVE()
 #define CN779_SET_CONTINUOUS_WAVE()
 #define CN779_APPLY_DR_OFFSET()
+#define CN779_SAVE_CONTEXT()
+#define CN779_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_EU433
@@ -787,6 +893,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define EU433_APPLY_DR_OFFSET() \
 	EU433_CASE { return RegionEU433ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define EU433_SAVE_CONTEXT()             \
+	EU433_CASE                           \
+	{                                    \
+		RegionEU433SaveContext(context); \
+		break;                           \
+	}
+#define EU433_RESTORE_CONTEXT()             \
+	EU433_CASE                              \
+	{                                       \
+		RegionEU433RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define EU433_IS_ACTIVE()
 #define EU433_GET_PHY_PARAM()
@@ -811,6 +929,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define EU433_CHANNEL_REMOVE()
 #define EU433_SET_CONTINUOUS_WAVE()
 #define EU433_APPLY_DR_OFFSET()
+#define EU433_SAVE_CONTEXT()
+#define EU433_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_EU868
@@ -886,6 +1006,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define EU868_APPLY_DR_OFFSET() \
 	EU868_CASE { return RegionEU868ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define EU868_SAVE_CONTEXT()             \
+	EU868_CASE                           \
+	{                                    \
+		RegionEU868SaveContext(context); \
+		break;                           \
+	}
+#define EU868_RESTORE_CONTEXT()             \
+	EU868_CASE                              \
+	{                                       \
+		RegionEU868RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define EU868_IS_ACTIVE()
 #define EU868_GET_PHY_PARAM()
@@ -910,6 +1042,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define EU868_CHANNEL_REMOVE()
 #define EU868_SET_CONTINUOUS_WAVE()
 #define EU868_APPLY_DR_OFFSET()
+#define EU868_SAVE_CONTEXT()
+#define EU868_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_KR920
@@ -985,6 +1119,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define KR920_APPLY_DR_OFFSET() \
 	KR920_CASE { return RegionKR920ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define KR920_SAVE_CONTEXT()             \
+	KR920_CASE                           \
+	{                                    \
+		RegionKR920SaveContext(context); \
+		break;                           \
+	}
+#define KR920_RESTORE_CONTEXT()             \
+	KR920_CASE                              \
+	{                                       \
+		RegionKR920RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define KR920_IS_ACTIVE()
 #define KR920_GET_PHY_PARAM()
@@ -1009,6 +1155,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define KR920_CHANNEL_REMOVE()
 #define KR920_SET_CONTINUOUS_WAVE()
 #define KR920_APPLY_DR_OFFSET()
+#define KR920_SAVE_CONTEXT()
+#define KR920_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_IN865
@@ -1084,6 +1232,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define IN865_APPLY_DR_OFFSET() \
 	IN865_CASE { return RegionIN865ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define IN865_SAVE_CONTEXT()             \
+	IN865_CASE                           \
+	{                                    \
+		RegionIN865SaveContext(context); \
+		break;                           \
+	}
+#define IN865_RESTORE_CONTEXT()             \
+	IN865_CASE                              \
+	{                                       \
+		RegionIN865RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define IN865_IS_ACTIVE()
 #define IN865_GET_PHY_PARAM()
@@ -1108,6 +1268,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define IN865_CHANNEL_REMOVE()
 #define IN865_SET_CONTINUOUS_WAVE()
 #define IN865_APPLY_DR_OFFSET()
+#define IN865_SAVE_CONTEXT()
+#define IN865_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_US915
@@ -1183,6 +1345,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define US915_APPLY_DR_OFFSET() \
 	US915_CASE { return RegionUS915ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define US915_SAVE_CONTEXT()             \
+	US915_CASE                           \
+	{                                    \
+		RegionUS915SaveContext(context); \
+		break;                           \
+	}
+#define US915_RESTORE_CONTEXT()             \
+	US915_CASE                              \
+	{                                       \
+		RegionUS915RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define US915_IS_ACTIVE()
 #define US915_GET_PHY_PARAM()
@@ -1207,6 +1381,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define US915_CHANNEL_REMOVE()
 #define US915_SET_CONTINUOUS_WAVE()
 #define US915_APPLY_DR_OFFSET()
+#define US915_SAVE_CONTEXT()
+#define US915_RESTORE_CONTEXT()
 #endif
 
 #ifdef REGION_RU864
@@ -1282,6 +1458,18 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 	}
 #define RU864_APPLY_DR_OFFSET() \
 	RU864_CASE { return RegionRU864ApplyDrOffset(downlinkDwellTime, dr, drOffset); }
+#define RU864_SAVE_CONTEXT()             \
+	RU864_CASE                           \
+	{                                    \
+		RegionRU864SaveContext(context); \
+		break;                           \
+	}
+#define RU864_RESTORE_CONTEXT()             \
+	RU864_CASE                              \
+	{                                       \
+		RegionRU864RestoreContext(context); \
+		break;                              \
+	}
 #else
 #define RU864_IS_ACTIVE()
 #define RU864_GET_PHY_PARAM()
@@ -1306,6 +1494,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #define RU864_CHANNEL_REMOVE()
 #define RU864_SET_CONTINUOUS_WAVE()
 #define RU864_APPLY_DR_OFFSET()
+#define RU864_SAVE_CONTEXT()
+#define RU864_RESTORE_CONTEXT()
 #endif
 
 bool RegionIsActive(LoRaMacRegion_t region)
@@ -1332,6 +1522,8 @@ bool RegionIsActive(LoRaMacRegion_t region)
 	}
 }
 
+#if !defined(LORAMAC_SINGLE_REGION)
+// In a single region build, Region.h calls the region directly
 PhyParam_t RegionGetPhyParam(LoRaMacRegion_t region, GetPhyParams_t *getPhy)
 {
 	PhyParam_t phyParam = {0};
@@ -1860,3 +2052,60 @@ uint8_t RegionApplyDrOffset(LoRaMacRegion_t region, uint8_t downlinkDwellTime, i
 	}
 	}
 }
+#endif
+
+void RegionSaveContext(LoRaMacRegion_t region, RegionContext_t *context)
+{
+	switch (region)
+	{
+		AS923_SAVE_CONTEXT();
+		AU915_SAVE_CONTEXT();
+		CN470_SAVE_CONTEXT();
+		CN779_SAVE_CONTEXT();
+		EU433_SAVE_CONTEXT();
+		EU868_SAVE_CONTEXT();
+		KR920_SAVE_CONTEXT();
+		IN865_SAVE_CONTEXT();
+		US915_SAVE_CONTEXT();
+		AS923_2_SAVE_CONTEXT();
+		AS923_3_SAVE_CONTEXT();
+		AS923_4_SAVE_CONTEXT();
+		RU864_SAVE_CONTEXT();
+	default:
+	{
+		break;
+	}
+	}
+
+	memcpy1((uint8_t *)context->ChannelsMask, (uint8_t *)ChannelsMask, sizeof(context->ChannelsMask));
+	memcpy1((uint8_t *)context->ChannelsMaskRemaining, (uint8_t *)ChannelsMaskRemaining, sizeof(context->ChannelsMaskRemaining));
+	memcpy1((uint8_t *)context->ChannelsDefaultMask, (uint8_t *)ChannelsDefaultMask, sizeof(context->ChannelsDefaultMask));
+}
+
+void RegionRestoreContext(LoRaMacRegion_t region, const RegionContext_t *context)
+{
+	switch (region)
+	{
+		AS923_RESTORE_CONTEXT();
+		AU915_RESTORE_CONTEXT();
+		CN470_RESTORE_CONTEXT();
+		CN779_RESTORE_CONTEXT();
+		EU433_RESTORE_CONTEXT();
+		EU868_RESTORE_CONTEXT();
+		KR920_RESTORE_CONTEXT();
+		IN865_RESTORE_CONTEXT();
+		US915_RESTORE_CONTEXT();
+		AS923_2_RESTORE_CONTEXT();
+		AS923_3_RESTORE_CONTEXT();
+		AS923_4_RESTORE_CONTEXT();
+		RU864_RESTORE_CONTEXT();
+	default:
+	{
+		break;
+	}
+	}
+
+	memcpy1((uint8_t *)ChannelsMask, (uint8_t *)context->ChannelsMask, sizeof(context->ChannelsMask));
+	memcpy1((uint8_t *)ChannelsMaskRemaining, (uint8_t *)context->ChannelsMaskRemaining, sizeof(context->ChannelsMaskRemaining));
+	memcpy1((uint8_t *)ChannelsDefaultMask, (uint8_t *)context->ChannelsDefaultMask, sizeof(context->ChannelsDefaultMask));
+}
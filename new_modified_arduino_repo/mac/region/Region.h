@@ -63,6 +63,18 @@
  */
 #define LC(channelIndex) (uint16_t)(1 << (channelIndex - 1))
 
+/*!
+ * Macro to compute the symbol time of a LoRa datarate in us, a constant
+ * expression for the datarate tables.
+ */
+#define REGION_LORA_SYMBOL_TIME(phyDr, bandwidth) ((uint32_t)((1UL << (phyDr)) * 1000000UL / (bandwidth)))
+
+/*!
+ * Macro to compute the symbol time of a FSK datarate in us (1 symbol equals
+ * 1 byte), a constant expression for the datarate tables.
+ */
+#define REGION_FSK_SYMBOL_TIME(phyDr) ((uint32_t)(8000UL / (phyDr)))
+
 /*!
  * Region       | SF
  * ------------ | :-----:
@@ -737,7 +749,15 @@ typedef enum ePhyAttribute
 	/*!
      * Next lower datarate.
      */
-	PHY_NEXT_LOWER_TX_DR
+	PHY_NEXT_LOWER_TX_DR,
+	/*!
+     * Bands.
+     */
+	PHY_BANDS,
+	/*!
+     * Time on air of a frame [ms].
+     */
+	PHY_TIME_ON_AIR
 } PhyAttribute_t;
 
 /*!
@@ -794,6 +814,10 @@ typedef union uPhyParam
      * Pointer to the channels.
      */
 	ChannelParams_t *Channels;
+	/*!
+     * Pointer to the bands.
+     */
+	Band_t *Bands;
 } PhyParam_t;
 
 /*!
@@ -808,7 +832,8 @@ typedef struct sGetPhyParams
 	/*!
      * Datarate.
      * The parameter is needed for the following queries:
-     * PHY_MAX_PAYLOAD, PHY_MAX_PAYLOAD_REPEATER, PHY_NEXT_LOWER_TX_DR.
+     * PHY_MAX_PAYLOAD, PHY_MAX_PAYLOAD_REPEATER, PHY_NEXT_LOWER_TX_DR,
+     * PHY_TIME_ON_AIR.
      */
 	int8_t Datarate;
 	/*!
@@ -823,6 +848,12 @@ typedef struct sGetPhyParams
      * PHY_MIN_RX_DR, PHY_MAX_PAYLOAD, PHY_MAX_PAYLOAD_REPEATER.
      */
 	uint8_t DownlinkDwellTime;
+	/*!
+     * Frame length [byte].
+     * The parameter is needed for the following queries:
+     * PHY_TIME_ON_AIR.
+     */
+	uint8_t PktLen;
 } GetPhyParams_t;
 
 /*!
@@ -1253,6 +1284,55 @@ typedef struct sContinuousWaveParams
 	uint16_t Timeout;
 } ContinuousWaveParams_t;
 
+/*!
+ * Largest number of channels of the enabled regions
+ */
+#if defined(REGION_CN470)
+#define REGION_MAX_NB_CHANNELS 96
+#elif defined(REGION_AU915) || defined(REGION_US915)
+#define REGION_MAX_NB_CHANNELS 72
+#else
+#define REGION_MAX_NB_CHANNELS 16
+#endif
+
+/*!
+ * Largest number of bands of the enabled regions
+ */
+#if defined(REGION_EU868)
+#define REGION_MAX_NB_BANDS 5
+#else
+#define REGION_MAX_NB_BANDS 1
+#endif
+
+/*!
+ * Region state of a LoRaMac instance. The region implementations keep the
+ * state of the active instance, RegionSaveContext and RegionRestoreContext
+ * move it in and out when another instance becomes active.
+ */
+typedef struct sRegionContext
+{
+	/*!
+     * Channels
+     */
+	ChannelParams_t Channels[REGION_MAX_NB_CHANNELS];
+	/*!
+     * Bands, including the duty cycle state
+     */
+	Band_t Bands[REGION_MAX_NB_BANDS];
+	/*!
+     * Channels mask
+     */
+	uint16_t ChannelsMask[6];
+	/*!
+     * Channels mask remaining
+     */
+	uint16_t ChannelsMaskRemaining[6];
+	/*!
+     * Channels default mask
+     */
+	uint16_t ChannelsDefaultMask[6];
+} RegionContext_t;
+
 /*!
  * \brief The function verifies if a region is active or not. If a region
  *        is not active, it cannot be used.
@@ -1575,4 +1655,119 @@ void RegionSetContinuousWave(LoRaMacRegion_t region, ContinuousWaveParams_t *con
  */
 uint8_t RegionApplyDrOffset(LoRaMacRegion_t region, uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset);
 
+/*!
+ * \brief Copies the region state (channels, bands, channel masks) into a
+ *        context.
+ *
+ * \param  region LoRaWAN region.
+ *
+ * \param  context Context to save the state to.
+ */
+void RegionSaveContext(LoRaMacRegion_t region, RegionContext_t *context);
+
+/*!
+ * \brief Loads the region state from a context saved with RegionSaveContext.
+ *
+ * \param  region LoRaWAN region.
+ *
+ * \param  context Context to load the state from.
+ */
+void RegionRestoreContext(LoRaMacRegion_t region, const RegionContext_t *context);
+
+#if defined(LORAMAC_SINGLE_REGION)
+/*
+ * Single region build, see Commissioning.h. The functions above call the
+ * functions of the region directly, without the switch of Region.c and
+ * without the region parameter, which must be the one of the build.
+ * RegionIsActive still rejects the other regions at initialization, and
+ * RegionSaveContext and RegionRestoreContext, which also save the channel
+ * masks, stay in Region.c.
+ */
+#define REGION_SINGLE_STR(x) #x
+#define REGION_SINGLE_XSTR(x) REGION_SINGLE_STR(x)
+#define REGION_SINGLE_FN(name) LORAMAC_SINGLE_REGION_XCAT(LORAMAC_SINGLE_REGION_XCAT(Region, LORAMAC_SINGLE_REGION), name)
+#define REGION_SINGLE_CONST(name) LORAMAC_SINGLE_REGION_XCAT(LORAMAC_SINGLE_REGION_XCAT(LORAMAC_SINGLE_REGION, _), name)
+
+#include REGION_SINGLE_XSTR(LORAMAC_SINGLE_REGION_XCAT(Region, LORAMAC_SINGLE_REGION).h)
+
+/*!
+ * \brief Returns the constant attributes of the region inline, so the MAC
+ *        gets them as constants, and the others from the region.
+ */
+static inline PhyParam_t RegionSingleGetPhyParam(GetPhyParams_t *getPhy)
+{
+	PhyParam_t phyParam = {0};
+
+	switch (getPhy->Attribute)
+	{
+	case PHY_DEF_TX_DR:
+		phyParam.Value = REGION_SINGLE_CONST(DEFAULT_DATARATE);
+		break;
+	case PHY_DEF_TX_POWER:
+		phyParam.Value = REGION_SINGLE_CONST(DEFAULT_TX_POWER);
+		break;
+	case PHY_DUTY_CYCLE:
+		phyParam.Value = REGION_SINGLE_CONST(DUTY_CYCLE_ENABLED);
+		break;
+	case PHY_MAX_RX_WINDOW:
+		phyParam.Value = REGION_SINGLE_CONST(MAX_RX_WINDOW);
+		break;
+	case PHY_RECEIVE_DELAY1:
+		phyParam.Value = REGION_SINGLE_CONST(RECEIVE_DELAY1);
+		break;
+	case PHY_RECEIVE_DELAY2:
+		phyParam.Value = REGION_SINGLE_CONST(RECEIVE_DELAY2);
+		break;
+	case PHY_JOIN_ACCEPT_DELAY1:
+		phyParam.Value = REGION_SINGLE_CONST(JOIN_ACCEPT_DELAY1);
+		break;
+	case PHY_JOIN_ACCEPT_DELAY2:
+		phyParam.Value = REGION_SINGLE_CONST(JOIN_ACCEPT_DELAY2);
+		break;
+	case PHY_MAX_FCNT_GAP:
+		phyParam.Value = REGION_SINGLE_CONST(MAX_FCNT_GAP);
+		break;
+	case PHY_DEF_DR1_OFFSET:
+		phyParam.Value = REGION_SINGLE_CONST(DEFAULT_RX1_DR_OFFSET);
+		break;
+	case PHY_DEF_RX2_DR:
+		phyParam.Value = REGION_SINGLE_CONST(RX_WND_2_DR);
+		break;
+	case PHY_MAX_NB_CHANNELS:
+		phyParam.Value = REGION_SINGLE_CONST(MAX_NB_CHANNELS);
+		break;
+	default:
+		phyParam = REGION_SINGLE_FN(GetPhyParam)(getPhy);
+		break;
+	}
+	return phyParam;
+}
+
+#define RegionGetPhyParam(region, getPhy) RegionSingleGetPhyParam(getPhy)
+#define RegionSetBandTxDone(region, txDone) REGION_SINGLE_FN(SetBandTxDone)(txDone)
+#define RegionInitDefaults(region, type) REGION_SINGLE_FN(InitDefaults)(type)
+#define RegionVerify(region, verify, phyAttribute) REGION_SINGLE_FN(Verify)(verify, phyAttribute)
+#define RegionApplyCFList(region, applyCFList) REGION_SINGLE_FN(ApplyCFList)(applyCFList)
+#define RegionChanMaskSet(region, chanMaskSet) REGION_SINGLE_FN(ChanMaskSet)(chanMaskSet)
+#define RegionAdrNext(region, adrNext, drOut, txPowOut, adrAckCounter) REGION_SINGLE_FN(AdrNext)(adrNext, drOut, txPowOut, adrAckCounter)
+#define RegionRxConfig(region, rxConfig, datarate) REGION_SINGLE_FN(RxConfig)(rxConfig, datarate)
+#define RegionComputeRxWindowParameters(region, datarate, minRxSymbols, rxError, rxConfigParams) \
+	REGION_SINGLE_FN(ComputeRxWindowParameters)(datarate, minRxSymbols, rxError, rxConfigParams)
+#define RegionTxConfig(region, txConfig, txPower, txTimeOnAir) REGION_SINGLE_FN(TxConfig)(txConfig, txPower, txTimeOnAir)
+#define RegionLinkAdrReq(region, linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed) \
+	REGION_SINGLE_FN(LinkAdrReq)(linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed)
+#define RegionRxParamSetupReq(region, rxParamSetupReq) REGION_SINGLE_FN(RxParamSetupReq)(rxParamSetupReq)
+#define RegionNewChannelReq(region, newChannelReq) REGION_SINGLE_FN(NewChannelReq)(newChannelReq)
+#define RegionTxParamSetupReq(region, txParamSetupReq) REGION_SINGLE_FN(TxParamSetupReq)(txParamSetupReq)
+#define RegionDlChannelReq(region, dlChannelReq) REGION_SINGLE_FN(DlChannelReq)(dlChannelReq)
+#define RegionAlternateDr(region, alternateDr) REGION_SINGLE_FN(AlternateDr)(alternateDr)
+#define RegionCalcBackOff(region, calcBackOff) REGION_SINGLE_FN(CalcBackOff)(calcBackOff)
+#define RegionNextChannel(region, nextChanParams, channel, time, aggregatedTimeOff) \
+	REGION_SINGLE_FN(NextChannel)(nextChanParams, channel, time, aggregatedTimeOff)
+#define RegionChannelAdd(region, channelAdd) REGION_SINGLE_FN(ChannelAdd)(channelAdd)
+#define RegionChannelsRemove(region, channelRemove) REGION_SINGLE_FN(ChannelsRemove)(channelRemove)
+#define RegionSetContinuousWave(region, continuousWave) REGION_SINGLE_FN(SetContinuousWave)(continuousWave)
+#define RegionApplyDrOffset(region, downlinkDwellTime, dr, drOffset) REGION_SINGLE_FN(ApplyDrOffset)(downlinkDwellTime, dr, drOffset)
+#endif
+
 #endif // __REGION_H__
@@ -42,34 +42,34 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 /*!
  * Second reception window channel frequency definition.
  */
-uint32_t AS923_RX_WND_2_FREQ = 923200000;
+LORAMAC_THREAD_LOCAL uint32_t AS923_RX_WND_2_FREQ = 923200000;
 
 /*!
  * LoRaMAC channels
  */
-static ChannelParams_t Channels[AS923_MAX_NB_CHANNELS];
+static LORAMAC_THREAD_LOCAL ChannelParams_t Channels[AS923_MAX_NB_CHANNELS];
 
 /*!
  * LoRaMac bands
  */
-static Band_t Bands[AS923_MAX_NB_BANDS] =
+static LORAMAC_THREAD_LOCAL Band_t Bands[AS923_MAX_NB_BANDS] =
 	{
 		AS923_BAND0};
 
 /*!
  * LoRaMac channels mask
  */
-extern uint16_t ChannelsMask[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
 
 /*!
  * LoRaMac channels remaining
  */
-extern uint16_t ChannelsMaskRemaining[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[];
 
 /*!
  * LoRaMac channels default mask
  */
-extern uint16_t ChannelsDefaultMask[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[];
 
 // Static functions
 static int8_t GetNextLowerTxDr(int8_t dr, int8_t minDr)
@@ -318,6 +318,17 @@ PhyParam_t RegionAS923GetPhyParam(GetPhyParams_t *getPhy)
 		phyParam.Channels = Channels;
 		break;
 	}
+	case PHY_BANDS:
+	{
+		phyParam.Bands = Bands;
+		break;
+	}
+	case PHY_TIME_ON_AIR:
+	{
+		phyParam.Value = RegionCommonComputeTimeOnAir((getPhy->Datarate == DR_7) ? MODEM_FSK : MODEM_LORA, GetBandwidth(getPhy->Datarate),
+													  DataratesAS923[getPhy->Datarate], getPhy->PktLen);
+		break;
+	}
 	case PHY_DEF_UPLINK_DWELL_TIME:
 	{
 		phyParam.Value = AS923_DEFAULT_UPLINK_DWELL_TIME;
@@ -364,6 +375,13 @@ void RegionAS923InitDefaults(InitType_t type)
 	{
 	case INIT_TYPE_INIT:
 	{
+		Band_t bands[AS923_MAX_NB_BANDS] =
+			{
+				AS923_BAND0};
+
+		// Bands
+		memcpy1((uint8_t *)Bands, (uint8_t *)bands, sizeof(Bands));
+
 		// Channels
 		Channels[0] = (ChannelParams_t)AS923_LC1;
 		Channels[1] = (ChannelParams_t)AS923_LC2;
@@ -596,22 +614,11 @@ bool RegionAS923AdrNext(AdrNextParams_t *adrNext, int8_t *drOut, int8_t *txPowOu
 
 void RegionAS923ComputeRxWindowParameters(int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams)
 {
-	double tSymbol = 0.0;
-
 	// Get the datarate, perform a boundary check
 	rxConfigParams->Datarate = T_MIN(datarate, AS923_RX_MAX_DATARATE);
 	rxConfigParams->Bandwidth = GetBandwidth(rxConfigParams->Datarate);
 
-	if (rxConfigParams->Datarate == DR_7)
-	{ // FSK
-		tSymbol = RegionCommonComputeSymbolTimeFsk(DataratesAS923[rxConfigParams->Datarate]);
-	}
-	else
-	{ // LoRa
-		tSymbol = RegionCommonComputeSymbolTimeLoRa(DataratesAS923[rxConfigParams->Datarate], BandwidthsAS923[rxConfigParams->Datarate]);
-	}
-
-	RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
+	RegionCommonGetRxWindowParameters(SymbolTimesAS923[rxConfigParams->Datarate], minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
 }
 
 bool RegionAS923RxConfig(RxConfigParams_t *rxConfig, int8_t *datarate)
@@ -703,7 +710,7 @@ bool RegionAS923TxConfig(TxConfigParams_t *txConfig, int8_t *txPower, TimerTime_
 	// Setup maximum payload lenght of the radio driver
 	Radio.SetMaxPayloadLength(modem, txConfig->PktLen);
 	// Get the time-on-air of the next tx frame
-	*txTimeOnAir = Radio.TimeOnAir(modem, txConfig->PktLen);
+	*txTimeOnAir = RegionCommonGetTimeOnAir(modem, bandwidth, phyDr, txConfig->PktLen);
 
 	*txPower = txPowerLimited;
 	return true;
@@ -1214,4 +1221,16 @@ bool RegionAS923SetVersion(uint8_t version)
 	return true;
 }
 
+void RegionAS923SaveContext(RegionContext_t *context)
+{
+	memcpy1((uint8_t *)context->Channels, (uint8_t *)Channels, sizeof(Channels));
+	memcpy1((uint8_t *)context->Bands, (uint8_t *)Bands, sizeof(Bands));
+}
+
+void RegionAS923RestoreContext(const RegionContext_t *context)
+{
+	memcpy1((uint8_t *)Channels, (const uint8_t *)context->Channels, sizeof(Channels));
+	memcpy1((uint8_t *)Bands, (const uint8_t *)context->Bands, sizeof(Bands));
+}
+
 #endif
\ No newline at end of file
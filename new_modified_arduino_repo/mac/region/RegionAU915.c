@@ -43,29 +43,34 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 /*!
  * LoRaMAC channels
  */
-static ChannelParams_t Channels[AU915_MAX_NB_CHANNELS];
+static LORAMAC_THREAD_LOCAL ChannelParams_t Channels[AU915_MAX_NB_CHANNELS];
 
 /*!
  * LoRaMac bands
  */
-static Band_t Bands[AU915_MAX_NB_BANDS] =
+static LORAMAC_THREAD_LOCAL Band_t Bands[AU915_MAX_NB_BANDS] =
 	{
 		AU915_BAND0};
 
+/*!
+ * Channel eligibility bitmaps of the channels
+ */
+static LORAMAC_THREAD_LOCAL RegionCommonChannelBitmaps_t ChannelBitmaps;
+
 /*!
  * LoRaMac channels mask
  */
-extern uint16_t ChannelsMask[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
 
 /*!
  * LoRaMac channels remaining
  */
-extern uint16_t ChannelsMaskRemaining[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[];
 
 /*!
  * LoRaMac channels default mask
  */
-extern uint16_t ChannelsDefaultMask[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[];
 
 // Static functions
 static int8_t GetNextLowerTxDr(int8_t dr, int8_t minDr)
@@ -107,40 +112,6 @@ static int8_t LimitTxPower(int8_t txPower, int8_t maxBandTxPower, int8_t datarat
 	return txPowerResult;
 }
 
-static uint8_t CountNbOfEnabledChannels(uint8_t datarate, uint16_t *channelsMask, ChannelParams_t *channels, Band_t *bands, uint8_t *enabledChannels, uint8_t *delayTx)
-{
-	uint8_t nbEnabledChannels = 0;
-	uint8_t delayTransmission = 0;
-
-	for (uint8_t i = 0, k = 0; i < AU915_MAX_NB_CHANNELS; i += 16, k++)
-	{
-		for (uint8_t j = 0; j < 16; j++)
-		{
-			if ((channelsMask[k] & (1 << j)) != 0)
-			{
-				if (channels[i + j].Frequency == 0)
-				{ // Check if the channel is enabled
-					continue;
-				}
-				if (RegionCommonValueInRange(datarate, channels[i + j].DrRange.Fields.Min,
-											 channels[i + j].DrRange.Fields.Max) == false)
-				{ // Check if the current channel selection supports the given datarate
-					continue;
-				}
-				if (bands[channels[i + j].Band].TimeOff > 0)
-				{ // Check if the band is available for transmission
-					delayTransmission++;
-					continue;
-				}
-				enabledChannels[nbEnabledChannels++] = i + j;
-			}
-		}
-	}
-
-	*delayTx = delayTransmission;
-	return nbEnabledChannels;
-}
-
 PhyParam_t RegionAU915GetPhyParam(GetPhyParams_t *getPhy)
 {
 	PhyParam_t phyParam = {0};
@@ -257,6 +228,16 @@ PhyParam_t RegionAU915GetPhyParam(GetPhyParams_t *getPhy)
 		phyParam.Channels = Channels;
 		break;
 	}
+	case PHY_BANDS:
+	{
+		phyParam.Bands = Bands;
+		break;
+	}
+	case PHY_TIME_ON_AIR:
+	{
+		phyParam.Value = RegionCommonComputeTimeOnAir(MODEM_LORA, GetBandwidth(getPhy->Datarate), DataratesAU915[getPhy->Datarate], getPhy->PktLen);
+		break;
+	}
 	case PHY_DEF_UPLINK_DWELL_TIME:
 	case PHY_DEF_DOWNLINK_DWELL_TIME:
 	{
@@ -299,6 +280,13 @@ void RegionAU915InitDefaults(InitType_t type)
 	{
 	case INIT_TYPE_INIT:
 	{
+		Band_t bands[AU915_MAX_NB_BANDS] =
+			{
+				AU915_BAND0};
+
+		// Bands
+		memcpy1((uint8_t *)Bands, (uint8_t *)bands, sizeof(Bands));
+
 		// Channels
 		// 125 kHz channels
 		for (uint8_t i = 0; i < AU915_MAX_NB_CHANNELS - 8; i++)
@@ -315,6 +303,9 @@ void RegionAU915InitDefaults(InitType_t type)
 			Channels[i].Band = 0;
 		}
 
+		// Channel bitmaps
+		RegionCommonChanBitmapsInit(&ChannelBitmaps, Channels, AU915_MAX_NB_CHANNELS);
+
 		// Initialize channels default mask
 		ChannelsDefaultMask[0] = 0xFFFF;
 		ChannelsDefaultMask[1] = 0xFFFF;
@@ -502,15 +493,11 @@ bool RegionAU915AdrNext(AdrNextParams_t *adrNext, int8_t *drOut, int8_t *txPowOu
 
 void RegionAU915ComputeRxWindowParameters(int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams)
 {
-	double tSymbol = 0.0;
-
 	// Get the datarate, perform a boundary check
 	rxConfigParams->Datarate = T_MIN(datarate, AU915_RX_MAX_DATARATE);
 	rxConfigParams->Bandwidth = GetBandwidth(rxConfigParams->Datarate);
 
-	tSymbol = RegionCommonComputeSymbolTimeLoRa(DataratesAU915[rxConfigParams->Datarate], BandwidthsAU915[rxConfigParams->Datarate]);
-
-	RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
+	RegionCommonGetRxWindowParameters(SymbolTimesAU915[rxConfigParams->Datarate], minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
 }
 
 bool RegionAU915RxConfig(RxConfigParams_t *rxConfig, int8_t *datarate)
@@ -573,7 +560,7 @@ bool RegionAU915TxConfig(TxConfigParams_t *txConfig, int8_t *txPower, TimerTime_
 	// Setup maximum payload lenght of the radio driver
 	Radio.SetMaxPayloadLength(MODEM_LORA, txConfig->PktLen);
 
-	*txTimeOnAir = Radio.TimeOnAir(MODEM_LORA, txConfig->PktLen);
+	*txTimeOnAir = RegionCommonGetTimeOnAir(MODEM_LORA, bandwidth, phyDr, txConfig->PktLen);
 	*txPower = txPowerLimited;
 
 	return true;
@@ -742,7 +729,7 @@ uint8_t RegionAU915DlChannelReq(DlChannelReqParams_t *dlChannelReq)
 
 int8_t RegionAU915AlternateDr(AlternateDrParams_t *alternateDr)
 {
-	static int8_t trialsCount = 0;
+	static LORAMAC_THREAD_LOCAL int8_t trialsCount = 0;
 	uint8_t currentDr = 0;
 
 	// Re-enable 500 kHz default channels
@@ -780,7 +767,7 @@ bool RegionAU915NextChannel(NextChanParams_t *nextChanParams, uint8_t *channel,
 {
 	uint8_t nbEnabledChannels = 0;
 	uint8_t delayTx = 0;
-	uint8_t enabledChannels[AU915_MAX_NB_CHANNELS] = {0};
+	uint16_t enabledChannels[CHANNELS_MASK_SIZE] = {0};
 	TimerTime_t nextTxDelay = 0;
 
 	// Count 125kHz channels
@@ -806,9 +793,9 @@ bool RegionAU915NextChannel(NextChanParams_t *nextChanParams, uint8_t *channel,
 		nextTxDelay = RegionCommonUpdateBandTimeOff(nextChanParams->Joined, nextChanParams->DutyCycleEnabled, Bands, AU915_MAX_NB_BANDS);
 
 		// Search how many channels are enabled
-		nbEnabledChannels = CountNbOfEnabledChannels(nextChanParams->Datarate,
-													 ChannelsMaskRemaining, Channels,
-													 Bands, enabledChannels, &delayTx);
+		nbEnabledChannels = RegionCommonChanBitmapsCount(&ChannelBitmaps, ChannelsMaskRemaining, CHANNELS_MASK_SIZE,
+														 nextChanParams->Datarate, Bands, AU915_MAX_NB_BANDS,
+														 enabledChannels, &delayTx);
 	}
 	else
 	{
@@ -819,7 +806,7 @@ bool RegionAU915NextChannel(NextChanParams_t *nextChanParams, uint8_t *channel,
 	if (nbEnabledChannels > 0)
 	{
 		// We found a valid channel
-		*channel = enabledChannels[randr(0, nbEnabledChannels - 1)];
+		*channel = RegionCommonChanFind(enabledChannels, CHANNELS_MASK_SIZE, randr(0, nbEnabledChannels - 1));
 		// Disable the channel in the mask
 		RegionCommonChanDisable(ChannelsMaskRemaining, *channel, AU915_MAX_NB_CHANNELS - 8);
 
@@ -873,4 +860,17 @@ uint8_t RegionAU915ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t dr
 	return datarate;
 }
 
+void RegionAU915SaveContext(RegionContext_t *context)
+{
+	memcpy1((uint8_t *)context->Channels, (uint8_t *)Channels, sizeof(Channels));
+	memcpy1((uint8_t *)context->Bands, (uint8_t *)Bands, sizeof(Bands));
+}
+
+void RegionAU915RestoreContext(const RegionContext_t *context)
+{
+	memcpy1((uint8_t *)Channels, (const uint8_t *)context->Channels, sizeof(Channels));
+	memcpy1((uint8_t *)Bands, (const uint8_t *)context->Bands, sizeof(Bands));
+	RegionCommonChanBitmapsInit(&ChannelBitmaps, Channels, AU915_MAX_NB_CHANNELS);
+}
+
 #endif
\ No newline at end of file
@@ -209,6 +209,28 @@ static const uint8_t DataratesAU915[] = {12, 11, 10, 9, 8, 7, 8, 0, 12, 11, 10,
  */
 static const uint32_t BandwidthsAU915[] = {125000, 125000, 125000, 125000, 125000, 125000, 500000, 0, 500000, 500000, 500000, 500000, 500000, 500000, 0, 0};
 
+/*!
+ * Symbol times table definition in us
+ */
+static const uint32_t SymbolTimesAU915[] = {
+	REGION_LORA_SYMBOL_TIME(12, 125000),        // DR_0
+	REGION_LORA_SYMBOL_TIME(11, 125000),        // DR_1
+	REGION_LORA_SYMBOL_TIME(10, 125000),        // DR_2
+	REGION_LORA_SYMBOL_TIME(9, 125000),         // DR_3
+	REGION_LORA_SYMBOL_TIME(8, 125000),         // DR_4
+	REGION_LORA_SYMBOL_TIME(7, 125000),         // DR_5
+	REGION_LORA_SYMBOL_TIME(8, 500000),         // DR_6
+	0,                                          // DR_7
+	REGION_LORA_SYMBOL_TIME(12, 500000),        // DR_8
+	REGION_LORA_SYMBOL_TIME(11, 500000),        // DR_9
+	REGION_LORA_SYMBOL_TIME(10, 500000),        // DR_10
+	REGION_LORA_SYMBOL_TIME(9, 500000),         // DR_11
+	REGION_LORA_SYMBOL_TIME(8, 500000),         // DR_12
+	REGION_LORA_SYMBOL_TIME(7, 500000),         // DR_13
+	0,                                          // DR_14
+	0                                           // DR_15
+};
+
 /*!
  * Up/Down link data rates offset definition
  */
@@ -463,4 +485,19 @@ void RegionAU915SetContinuousWave(ContinuousWaveParams_t *continuousWave);
  */
 uint8_t RegionAU915ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset);
 
+
+/*!
+ * \brief Copies the channels and bands into a context.
+ *
+ * \param  context Context to save the state to.
+ */
+void RegionAU915SaveContext(RegionContext_t *context);
+
+/*!
+ * \brief Loads the channels and bands from a context.
+ *
+ * \param  context Context to load the state from.
+ */
+void RegionAU915RestoreContext(const RegionContext_t *context);
+
 #endif // __REGION_AU915_H__
@@ -209,6 +209,18 @@ static const uint8_t DataratesCN470[] = {12, 11, 10, 9, 8, 7};
  */
 static const uint32_t BandwidthsCN470[] = {125000, 125000, 125000, 125000, 125000, 125000};
 
+/*!
+ * Symbol times table definition in us
+ */
+static const uint32_t SymbolTimesCN470[] = {
+	REGION_LORA_SYMBOL_TIME(12, 125000),        // DR_0
+	REGION_LORA_SYMBOL_TIME(11, 125000),        // DR_1
+	REGION_LORA_SYMBOL_TIME(10, 125000),        // DR_2
+	REGION_LORA_SYMBOL_TIME(9, 125000),         // DR_3
+	REGION_LORA_SYMBOL_TIME(8, 125000),         // DR_4
+	REGION_LORA_SYMBOL_TIME(7, 125000)          // DR_5
+};
+
 /*!
  * Maximum payload with respect to the datarate index. Cannot operate with repeater.
  */
@@ -449,4 +461,19 @@ void RegionCN470SetContinuousWave(ContinuousWaveParams_t *continuousWave);
  */
 uint8_t RegionCN470ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset);
 
+
+/*!
+ * \brief Copies the channels and bands into a context.
+ *
+ * \param  context Context to save the state to.
+ */
+void RegionCN470SaveContext(RegionContext_t *context);
+
+/*!
+ * \brief Loads the channels and bands from a context.
+ *
+ * \param  context Context to load the state from.
+ */
+void RegionCN470RestoreContext(const RegionContext_t *context);
+
 #endif // __REGION_CN470_H__
@@ -43,29 +43,29 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 /*!
  * LoRaMAC channels
  */
-static ChannelParams_t Channels[CN779_MAX_NB_CHANNELS];
+static LORAMAC_THREAD_LOCAL ChannelParams_t Channels[CN779_MAX_NB_CHANNELS];
 
 /*!
  * LoRaMac bands
  */
-static Band_t Bands[CN779_MAX_NB_BANDS] =
+static LORAMAC_THREAD_LOCAL Band_t Bands[CN779_MAX_NB_BANDS] =
 	{
 		CN779_BAND0};
 
 /*!
  * LoRaMac channels mask
  */
-extern uint16_t ChannelsMask[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
 
 /*!
  * LoRaMac channels remaining
  */
-extern uint16_t ChannelsMaskRemaining[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[];
 
 /*!
  * LoRaMac channels default mask
  */
-extern uint16_t ChannelsDefaultMask[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[];
 
 // Static functions
 static int8_t GetNextLowerTxDr(int8_t dr, int8_t minDr)
@@ -279,6 +279,17 @@ PhyParam_t RegionCN779GetPhyParam(GetPhyParams_t *getPhy)
 		phyParam.Channels = Channels;
 		break;
 	}
+	case PHY_BANDS:
+	{
+		phyParam.Bands = Bands;
+		break;
+	}
+	case PHY_TIME_ON_AIR:
+	{
+		phyParam.Value = RegionCommonComputeTimeOnAir((getPhy->Datarate == DR_7) ? MODEM_FSK : MODEM_LORA, GetBandwidth(getPhy->Datarate),
+													  DataratesCN779[getPhy->Datarate], getPhy->PktLen);
+		break;
+	}
 	case PHY_DEF_UPLINK_DWELL_TIME:
 	case PHY_DEF_DOWNLINK_DWELL_TIME:
 	{
@@ -321,6 +332,13 @@ void RegionCN779InitDefaults(InitType_t type)
 	{
 	case INIT_TYPE_INIT:
 	{
+		Band_t bands[CN779_MAX_NB_BANDS] =
+			{
+				CN779_BAND0};
+
+		// Bands
+		memcpy1((uint8_t *)Bands, (uint8_t *)bands, sizeof(Bands));
+
 		// Channels
 		Channels[0] = (ChannelParams_t)CN779_LC1;
 		Channels[1] = (ChannelParams_t)CN779_LC2;
@@ -526,22 +544,11 @@ bool RegionCN779AdrNext(AdrNextParams_t *adrNext, int8_t *drOut, int8_t *txPowOu
 
 void RegionCN779ComputeRxWindowParameters(int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams)
 {
-	double tSymbol = 0.0;
-
 	// Get the datarate, perform a boundary check
 	rxConfigParams->Datarate = T_MIN(datarate, CN779_RX_MAX_DATARATE);
 	rxConfigParams->Bandwidth = GetBandwidth(rxConfigParams->Datarate);
 
-	if (rxConfigParams->Datarate == DR_7)
-	{ // FSK
-		tSymbol = RegionCommonComputeSymbolTimeFsk(DataratesCN779[rxConfigParams->Datarate]);
-	}
-	else
-	{ // LoRa
-		tSymbol = RegionCommonComputeSymbolTimeLoRa(DataratesCN779[rxConfigParams->Datarate], BandwidthsCN779[rxConfigParams->Datarate]);
-	}
-
-	RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
+	RegionCommonGetRxWindowParameters(SymbolTimesCN779[rxConfigParams->Datarate], minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
 }
 
 bool RegionCN779RxConfig(RxConfigParams_t *rxConfig, int8_t *datarate)
@@ -631,7 +638,7 @@ bool RegionCN779TxConfig(TxConfigParams_t *txConfig, int8_t *txPower, TimerTime_
 	// Setup maximum payload lenght of the radio driver
 	Radio.SetMaxPayloadLength(modem, txConfig->PktLen);
 	// Get the time-on-air of the next tx frame
-	*txTimeOnAir = Radio.TimeOnAir(modem, txConfig->PktLen);
+	*txTimeOnAir = RegionCommonGetTimeOnAir(modem, bandwidth, phyDr, txConfig->PktLen);
 
 	*txPower = txPowerLimited;
 	return true;
@@ -1063,4 +1070,16 @@ uint8_t RegionCN779ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t dr
 	return datarate;
 }
 
+void RegionCN779SaveContext(RegionContext_t *context)
+{
+	memcpy1((uint8_t *)context->Channels, (uint8_t *)Channels, sizeof(Channels));
+	memcpy1((uint8_t *)context->Bands, (uint8_t *)Bands, sizeof(Bands));
+}
+
+void RegionCN779RestoreContext(const RegionContext_t *context)
+{
+	memcpy1((uint8_t *)Channels, (const uint8_t *)context->Channels, sizeof(Channels));
+	memcpy1((uint8_t *)Bands, (const uint8_t *)context->Bands, sizeof(Bands));
+}
+
 #endif
\ No newline at end of file
@@ -242,6 +242,20 @@ static const uint8_t DataratesCN779[] = {12, 11, 10, 9, 8, 7, 7, 50};
  */
 static const uint32_t BandwidthsCN779[] = {125000, 125000, 125000, 125000, 125000, 125000, 250000, 0};
 
+/*!
+ * Symbol times table definition in us
+ */
+static const uint32_t SymbolTimesCN779[] = {
+	REGION_LORA_SYMBOL_TIME(12, 125000),        // DR_0
+	REGION_LORA_SYMBOL_TIME(11, 125000),        // DR_1
+	REGION_LORA_SYMBOL_TIME(10, 125000),        // DR_2
+	REGION_LORA_SYMBOL_TIME(9, 125000),         // DR_3
+	REGION_LORA_SYMBOL_TIME(8, 125000),         // DR_4
+	REGION_LORA_SYMBOL_TIME(7, 125000),         // DR_5
+	REGION_LORA_SYMBOL_TIME(7, 250000),         // DR_6
+	REGION_FSK_SYMBOL_TIME(50)                  // DR_7
+};
+
 /*!
  * Maximum payload with respect to the datarate index. Cannot operate with repeater.
  */
@@ -482,4 +496,19 @@ void RegionCN779SetContinuousWave(ContinuousWaveParams_t *continuousWave);
  */
 uint8_t RegionCN779ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset);
 
+
+/*!
+ * \brief Copies the channels and bands into a context.
+ *
+ * \param  context Context to save the state to.
+ */
+void RegionCN779SaveContext(RegionContext_t *context);
+
+/*!
+ * \brief Loads the channels and bands from a context.
+ *
+ * \param  context Context to load the state from.
+ */
+void RegionCN779RestoreContext(const RegionContext_t *context);
+
 #endif // __REGION_CN779_H__
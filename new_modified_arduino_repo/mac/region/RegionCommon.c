@@ -28,23 +28,69 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #include "LoRaMac.h"
 #include "RegionCommon.h"
 #include "radio.h"
+#include "radio_toa.h"
 
 #define BACKOFF_DC_1_HOUR 100
 #define BACKOFF_DC_10_HOURS 1000
 #define BACKOFF_DC_24_HOURS 10000
 
-static uint8_t CountChannels(uint16_t mask, uint8_t nbBits)
+#if (REGION_COMMON_TIMING_CACHE_BITS > 0)
+
+/*!
+ * RX window parameters memo cache entry
+ */
+typedef struct sRxWindowCacheEntry
+{
+	uint32_t TSymbol;
+	uint32_t RxError;
+	uint32_t WakeUpTime;
+	uint8_t MinRxSymbols;
+	bool IsValid;
+	uint32_t WindowTimeout;
+	int32_t WindowOffset;
+} RxWindowCacheEntry_t;
+
+/*!
+ * Time on air memo cache entry
+ */
+typedef struct sTimeOnAirCacheEntry
+{
+	uint32_t Bandwidth;
+	uint32_t Datarate;
+	RadioModems_t Modem;
+	uint8_t PktLen;
+	bool IsValid;
+	TimerTime_t TimeOnAir;
+} TimeOnAirCacheEntry_t;
+
+/*!
+ * Memo caches, direct mapped. The entries are pure functions of their key,
+ * they are never invalidated.
+ */
+static LORAMAC_THREAD_LOCAL RxWindowCacheEntry_t RxWindowCache[1 << REGION_COMMON_TIMING_CACHE_BITS];
+static LORAMAC_THREAD_LOCAL TimeOnAirCacheEntry_t TimeOnAirCache[1 << REGION_COMMON_TIMING_CACHE_BITS];
+
+static uint8_t TimingCacheIndex(uint32_t key)
 {
-	uint8_t nbActiveBits = 0;
+	// Fibonacci hashing
+	return (uint32_t)(key * 2654435761UL) >> (32 - REGION_COMMON_TIMING_CACHE_BITS);
+}
 
-	for (uint8_t j = 0; j < nbBits; j++)
-	{
-		if ((mask & (1 << j)) == (1 << j))
-		{
-			nbActiveBits++;
-		}
-	}
-	return nbActiveBits;
+#endif
+
+static uint8_t CountChannels(uint16_t mask)
+{
+	// Sums the bits of each 2, 4, 8 then 16 bits
+	mask = mask - ((mask >> 1) & 0x5555);
+	mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+	mask = (mask + (mask >> 4)) & 0x0F0F;
+	return (mask + (mask >> 8)) & 0x001F;
+}
+
+static int32_t DivCeil(int32_t numerator, int32_t denominator)
+{
+	// The C division truncates towards 0, which is the ceiling of a negative quotient
+	return (numerator > 0) ? ((numerator + denominator - 1) / denominator) : (numerator / denominator);
 }
 
 uint16_t RegionCommonGetJoinDc(TimerTime_t elapsedTime)
@@ -126,7 +172,7 @@ uint8_t RegionCommonCountChannels(uint16_t *channelsMask, uint8_t startIdx, uint
 
 	for (uint8_t i = startIdx; i < stopIdx; i++)
 	{
-		nbChannels += CountChannels(channelsMask[i], 16);
+		nbChannels += CountChannels(channelsMask[i]);
 	}
 
 	return nbChannels;
@@ -143,6 +189,104 @@ void RegionCommonChanMaskCopy(uint16_t *channelsMaskDest, uint16_t *channelsMask
 	}
 }
 
+void RegionCommonChanBitmapsInit(RegionCommonChannelBitmaps_t *bitmaps, ChannelParams_t *channels, uint8_t nbChannels)
+{
+	memset1((uint8_t *)bitmaps, 0, sizeof(RegionCommonChannelBitmaps_t));
+
+	for (uint8_t i = 0; i < nbChannels; i++)
+	{
+		RegionCommonChanBitmapsUpdate(bitmaps, channels, i);
+	}
+}
+
+void RegionCommonChanBitmapsUpdate(RegionCommonChannelBitmaps_t *bitmaps, ChannelParams_t *channels, uint8_t id)
+{
+	uint8_t index = id / 16;
+	uint16_t bit = 1 << (id % 16);
+	ChannelParams_t *channel = &channels[id];
+
+	if (index >= REGION_COMMON_CHANNEL_BITMAP_WORDS)
+	{
+		return;
+	}
+
+	for (uint8_t dr = 0; dr < REGION_COMMON_CHANNEL_BITMAP_NB_DR; dr++)
+	{
+		if ((channel->Frequency != 0) &&
+			(RegionCommonValueInRange(dr, channel->DrRange.Fields.Min, channel->DrRange.Fields.Max) == 1))
+		{
+			bitmaps->Datarates[dr][index] |= bit;
+		}
+		else
+		{
+			bitmaps->Datarates[dr][index] &= ~bit;
+		}
+	}
+	for (uint8_t band = 0; band < REGION_MAX_NB_BANDS; band++)
+	{
+		if ((channel->Frequency != 0) && (channel->Band == band))
+		{
+			bitmaps->Bands[band][index] |= bit;
+		}
+		else
+		{
+			bitmaps->Bands[band][index] &= ~bit;
+		}
+	}
+}
+
+uint8_t RegionCommonChanBitmapsCount(const RegionCommonChannelBitmaps_t *bitmaps, uint16_t *channelsMask, uint8_t nbWords, int8_t datarate,
+									 Band_t *bands, uint8_t nbBands, uint16_t *enabledMask, uint8_t *delayTx)
+{
+	uint8_t nbEnabledChannels = 0;
+	uint8_t delayTransmission = 0;
+
+	for (uint8_t i = 0; i < nbWords; i++)
+	{
+		uint16_t supported = 0;
+		uint16_t available = 0;
+
+		if ((datarate >= 0) && (datarate < REGION_COMMON_CHANNEL_BITMAP_NB_DR))
+		{
+			supported = channelsMask[i] & bitmaps->Datarates[datarate][i];
+		}
+		for (uint8_t band = 0; band < nbBands; band++)
+		{
+			if (bands[band].TimeOff == 0)
+			{
+				available |= bitmaps->Bands[band][i];
+			}
+		}
+		enabledMask[i] = supported & available;
+		nbEnabledChannels += CountChannels(supported & available);
+		delayTransmission += CountChannels(supported & ~available);
+	}
+
+	*delayTx = delayTransmission;
+	return nbEnabledChannels;
+}
+
+uint8_t RegionCommonChanFind(uint16_t *channelsMask, uint8_t nbWords, uint8_t n)
+{
+	for (uint8_t i = 0; i < nbWords; i++)
+	{
+		uint16_t mask = channelsMask[i];
+		uint8_t nbChannels = CountChannels(mask);
+
+		if (n < nbChannels)
+		{
+			// Clear the n lowest active channels, the channel is then the lowest bit
+			for (; n > 0; n--)
+			{
+				mask &= mask - 1;
+			}
+			return (i * 16) + CountChannels((mask & (~mask + 1)) - 1);
+		}
+		n -= nbChannels;
+	}
+	return 0xFF;
+}
+
 void RegionCommonSetBandTxDone(bool joined, Band_t *band, TimerTime_t lastTxDone)
 {
 	if (joined == true)
@@ -201,6 +345,137 @@ TimerTime_t RegionCommonUpdateBandTimeOff(bool joined, bool dutyCycle, Band_t *b
 	return nextTxDelay;
 }
 
+void RegionCommonBandSchedulerReset(RegionCommonBandScheduler_t *scheduler)
+{
+	scheduler->NbBusyBands = 0;
+	scheduler->IsValid = false;
+}
+
+void RegionCommonBandSchedulerUpdateBand(RegionCommonBandScheduler_t *scheduler, Band_t *bands, uint8_t band)
+{
+	Band_t *bandParams = &bands[band];
+	TimerTime_t releaseTime;
+	uint8_t low = 0;
+	uint8_t high;
+
+	if (scheduler->IsValid == false)
+	{
+		return;
+	}
+
+	// Remove the band from the index
+	for (uint8_t i = 0; i < scheduler->NbBusyBands; i++)
+	{
+		if (scheduler->Index[i] == band)
+		{
+			scheduler->NbBusyBands--;
+#if (REGION_MAX_NB_BANDS > 1)
+			// Nothing follows the only band of a single band build
+			for (; i < scheduler->NbBusyBands; i++)
+			{
+				scheduler->Index[i] = scheduler->Index[i + 1];
+			}
+#endif
+			break;
+		}
+	}
+
+	if ((bandParams->TimeOff == 0) || ((scheduler->Joined == true) && (scheduler->DutyCycleEnabled == false)))
+	{
+		return;
+	}
+
+	// The time off runs from the same TX as in RegionCommonUpdateBandTimeOff:
+	// the last TX once joined, else the last join request, or the last TX if
+	// older and the duty cycle is on
+	if (scheduler->Joined == true)
+	{
+		releaseTime = bandParams->LastTxDoneTime;
+	}
+	else if ((scheduler->DutyCycleEnabled == true) && ((int32_t)(bandParams->LastJoinTxDoneTime - bandParams->LastTxDoneTime) > 0))
+	{
+		releaseTime = bandParams->LastTxDoneTime;
+	}
+	else
+	{
+		releaseTime = bandParams->LastJoinTxDoneTime;
+	}
+	releaseTime += bandParams->TimeOff;
+	scheduler->ReleaseTime[band] = releaseTime;
+
+	// Insert it after the bands released before or at the same time
+	high = scheduler->NbBusyBands;
+	while (low < high)
+	{
+		uint8_t middle = (low + high) / 2;
+
+		if ((int32_t)(scheduler->ReleaseTime[scheduler->Index[middle]] - releaseTime) <= 0)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	for (uint8_t i = scheduler->NbBusyBands; i > low; i--)
+	{
+		scheduler->Index[i] = scheduler->Index[i - 1];
+	}
+	scheduler->Index[low] = band;
+	scheduler->NbBusyBands++;
+}
+
+TimerTime_t RegionCommonBandSchedulerRelease(RegionCommonBandScheduler_t *scheduler, bool joined, bool dutyCycle, Band_t *bands, uint8_t nbBands, TimerTime_t now)
+{
+	if ((scheduler->IsValid == false) || (scheduler->Joined != joined) || (scheduler->DutyCycleEnabled != dutyCycle))
+	{
+		scheduler->Joined = joined;
+		scheduler->DutyCycleEnabled = dutyCycle;
+		scheduler->NbBusyBands = 0;
+		scheduler->IsValid = true;
+		for (uint8_t i = 0; i < nbBands; i++)
+		{
+			RegionCommonBandSchedulerUpdateBand(scheduler, bands, i);
+		}
+	}
+
+	if ((joined == true) && (dutyCycle == false))
+	{
+		for (uint8_t i = 0; i < nbBands; i++)
+		{
+			bands[i].TimeOff = 0;
+		}
+		return (nbBands > 0) ? 0 : (TimerTime_t)(-1);
+	}
+
+	while ((scheduler->NbBusyBands > 0) && ((int32_t)(now - scheduler->ReleaseTime[scheduler->Index[0]]) >= 0))
+	{
+		bands[scheduler->Index[0]].TimeOff = 0;
+		scheduler->NbBusyBands--;
+		for (uint8_t i = 0; i < scheduler->NbBusyBands; i++)
+		{
+			scheduler->Index[i] = scheduler->Index[i + 1];
+		}
+	}
+
+	return RegionCommonBandSchedulerNextRelease(scheduler, 0xFF, now);
+}
+
+TimerTime_t RegionCommonBandSchedulerNextRelease(RegionCommonBandScheduler_t *scheduler, uint8_t bandsMask, TimerTime_t now)
+{
+	for (uint8_t i = 0; i < scheduler->NbBusyBands; i++)
+	{
+		uint8_t band = scheduler->Index[i];
+
+		if ((bandsMask & (1 << band)) != 0)
+		{
+			return scheduler->ReleaseTime[band] - now;
+		}
+	}
+	return (TimerTime_t)(-1);
+}
+
 uint8_t RegionCommonParseLinkAdrReq(uint8_t *payload, RegionCommonLinkAdrParams_t *linkAdrParams)
 {
 	uint8_t retIndex = 0;
@@ -288,20 +563,88 @@ uint8_t RegionCommonLinkAdrReqVerifyParams(RegionCommonLinkAdrReqVerifyParams_t
 	return status;
 }
 
-double RegionCommonComputeSymbolTimeLoRa(uint8_t phyDr, uint32_t bandwidth)
+uint32_t RegionCommonComputeSymbolTimeLoRa(uint8_t phyDr, uint32_t bandwidth)
 {
-	return ((double)(1 << phyDr) / (double)bandwidth) * 1000;
+	return ((uint32_t)(1 << phyDr) * 1000000) / bandwidth;
 }
 
-double RegionCommonComputeSymbolTimeFsk(uint8_t phyDr)
+uint32_t RegionCommonComputeSymbolTimeFsk(uint8_t phyDr)
 {
-	return (8.0 / (double)phyDr); // 1 symbol equals 1 byte
+	return (8 * 1000) / (uint32_t)phyDr; // 1 symbol equals 1 byte
+}
+
+void RegionCommonComputeRxWindowParameters(uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset)
+{
+	int32_t timeout = DivCeil((2 * minRxSymbols - 8) * (int32_t)tSymbol + 2 * (int32_t)rxError * 1000, (int32_t)tSymbol);
+
+	*windowTimeout = T_MAX(timeout, (int32_t)minRxSymbols); // Computed number of symbols
+	// 4 * tSymbol - windowTimeout * tSymbol / 2, in ms
+	*windowOffset = DivCeil((8 - (int32_t)*windowTimeout) * (int32_t)tSymbol, 2000) - (int32_t)wakeUpTime;
+}
+
+void RegionCommonGetRxWindowParameters(uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset)
+{
+#if (REGION_COMMON_TIMING_CACHE_BITS > 0)
+	RxWindowCacheEntry_t *entry = &RxWindowCache[TimingCacheIndex(tSymbol ^ (rxError << 8) ^ ((uint32_t)minRxSymbols << 20) ^ (wakeUpTime << 28))];
+
+	if ((entry->IsValid == false) || (entry->TSymbol != tSymbol) || (entry->MinRxSymbols != minRxSymbols) ||
+		(entry->RxError != rxError) || (entry->WakeUpTime != wakeUpTime))
+	{
+		RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, wakeUpTime, &entry->WindowTimeout, &entry->WindowOffset);
+		entry->TSymbol = tSymbol;
+		entry->MinRxSymbols = minRxSymbols;
+		entry->RxError = rxError;
+		entry->WakeUpTime = wakeUpTime;
+		entry->IsValid = true;
+	}
+	*windowTimeout = entry->WindowTimeout;
+	*windowOffset = entry->WindowOffset;
+#else
+	RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, wakeUpTime, windowTimeout, windowOffset);
+#endif
+}
+
+TimerTime_t RegionCommonGetTimeOnAir(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t pktLen)
+{
+#if (REGION_COMMON_TIMING_CACHE_BITS > 0)
+	TimeOnAirCacheEntry_t *entry = &TimeOnAirCache[TimingCacheIndex(pktLen ^ (datarate << 8) ^ (bandwidth << 16) ^ ((uint32_t)modem << 31))];
+
+	if ((entry->IsValid == false) || (entry->PktLen != pktLen) || (entry->Datarate != datarate) ||
+		(entry->Bandwidth != bandwidth) || (entry->Modem != modem))
+	{
+		entry->TimeOnAir = Radio.TimeOnAir(modem, pktLen);
+		entry->PktLen = pktLen;
+		entry->Datarate = datarate;
+		entry->Bandwidth = bandwidth;
+		entry->Modem = modem;
+		entry->IsValid = true;
+	}
+	return entry->TimeOnAir;
+#else
+	return Radio.TimeOnAir(modem, pktLen);
+#endif
+}
+
+TimerTime_t RegionCommonComputeTimeOnAir(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t pktLen)
+{
+	if (modem == MODEM_FSK)
+	{
+		// Preamble of 5 bytes, 3 bytes sync word, variable length, CRC on
+		return RadioFskTimeOnAir(datarate * 1000, 5, 24, false, 2, pktLen);
+	}
+	// Coding rate 4/5, preamble of 8 symbols, explicit header, low datarate
+	// optimization as the SX126x driver sets it
+	bool ldro = ((bandwidth == 0) && ((datarate == 11) || (datarate == 12))) || ((bandwidth == 1) && (datarate == 12));
+
+	return RadioLoRaTimeOnAir(datarate, 125000 << bandwidth, 1, 8, false, ldro, pktLen);
 }
 
-void RegionCommonComputeRxWindowParameters(double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset)
+void RegionCommonClearTimingCache(void)
 {
-	*windowTimeout = T_MAX((uint32_t)ceil(((2 * minRxSymbols - 8) * tSymbol + 2 * rxError) / tSymbol), minRxSymbols); // Computed number of symbols
-	*windowOffset = (int32_t)ceil((4.0 * tSymbol) - ((*windowTimeout * tSymbol) / 2.0) - wakeUpTime);
+#if (REGION_COMMON_TIMING_CACHE_BITS > 0)
+	memset1((uint8_t *)RxWindowCache, 0, sizeof(RxWindowCache));
+	memset1((uint8_t *)TimeOnAirCache, 0, sizeof(TimeOnAirCache));
+#endif
 }
 
 int8_t RegionCommonComputeTxPower(int8_t txPowerIndex, float maxEirp, float antennaGain)
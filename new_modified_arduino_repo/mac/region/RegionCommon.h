@@ -37,6 +37,16 @@
 
 #include "timer.h"
 #include "LoRaMac.h"
+#include "radio.h"
+#include "Region.h"
+
+/*!
+ * log2 of the number of entries of the RX window and time on air memo
+ * caches, 0 disables them
+ */
+#ifndef REGION_COMMON_TIMING_CACHE_BITS
+#define REGION_COMMON_TIMING_CACHE_BITS 3
+#endif
 
 typedef struct sRegionCommonLinkAdrParams
 {
@@ -162,6 +172,67 @@ typedef struct sRegionCommonCalcBackOffParams
 	TimerTime_t TxTimeOnAir;
 } RegionCommonCalcBackOffParams_t;
 
+/*!
+ * Number of 16 bit words of the channel bitmaps, the size of the channels
+ * masks
+ */
+#define REGION_COMMON_CHANNEL_BITMAP_WORDS 6
+
+/*!
+ * Number of datarates of the channel bitmaps. No channel supports a
+ * datarate above, the regions using them transmit up to DR_6.
+ */
+#define REGION_COMMON_CHANNEL_BITMAP_NB_DR 8
+
+/*!
+ * Channel eligibility bitmaps, in the layout of the channels masks: channel
+ * id is bit ( id % 16 ) of word ( id / 16 ). They follow the channels of the
+ * region, the channels mask and the band time off are applied to them when
+ * a channel is selected.
+ */
+typedef struct sRegionCommonChannelBitmaps
+{
+	/*!
+     * Enabled channels (frequency not 0) supporting each datarate.
+     */
+	uint16_t Datarates[REGION_COMMON_CHANNEL_BITMAP_NB_DR][REGION_COMMON_CHANNEL_BITMAP_WORDS];
+	/*!
+     * Enabled channels of each band.
+     */
+	uint16_t Bands[REGION_MAX_NB_BANDS][REGION_COMMON_CHANNEL_BITMAP_WORDS];
+} RegionCommonChannelBitmaps_t;
+
+/*!
+ * Band scheduler: index of the bands with a time off, sorted by release
+ * time. It is updated when the time off or the last TX of a band changes,
+ * so a channel search releases the bands in O(1) per released band and
+ * finds the next release without scanning the bands.
+ */
+typedef struct sRegionCommonBandScheduler
+{
+	/*!
+     * Time when the time off of each band of the index ends.
+     */
+	TimerTime_t ReleaseTime[REGION_MAX_NB_BANDS];
+	/*!
+     * Bands with a time off, earliest release first.
+     */
+	uint8_t Index[REGION_MAX_NB_BANDS];
+	/*!
+     * Number of bands of the index.
+     */
+	uint8_t NbBusyBands;
+	/*!
+     * Join and duty cycle state the release times were computed for.
+     */
+	bool Joined;
+	bool DutyCycleEnabled;
+	/*!
+     * Set to false when the index must be built again.
+     */
+	bool IsValid;
+} RegionCommonBandScheduler_t;
+
 /*!
  * \brief Calculates the join duty cycle.
  *        This is a generic function and valid for all regions.
@@ -247,6 +318,72 @@ uint8_t RegionCommonCountChannels(uint16_t *channelsMask, uint8_t startIdx, uint
  */
 void RegionCommonChanMaskCopy(uint16_t *channelsMaskDest, uint16_t *channelsMaskSrc, uint8_t len);
 
+/*!
+ * \brief Builds the channel bitmaps of all channels, after the channels are
+ *        initialized or restored.
+ *
+ * \param  bitmaps Channel bitmaps of the region.
+ *
+ * \param  channels The channels of the region.
+ *
+ * \param  nbChannels Number of channels, at most
+ *                    16 * REGION_COMMON_CHANNEL_BITMAP_WORDS.
+ */
+void RegionCommonChanBitmapsInit(RegionCommonChannelBitmaps_t *bitmaps, ChannelParams_t *channels, uint8_t nbChannels);
+
+/*!
+ * \brief Updates the channel bitmaps after the frequency, the datarate range
+ *        or the band of a channel changed.
+ *
+ * \param  bitmaps Channel bitmaps of the region.
+ *
+ * \param  channels The channels of the region.
+ *
+ * \param  id Index of the channel.
+ */
+void RegionCommonChanBitmapsUpdate(RegionCommonChannelBitmaps_t *bitmaps, ChannelParams_t *channels, uint8_t id);
+
+/*!
+ * \brief Computes the channels available for a transmission: in the channels
+ *        mask, supporting the datarate and in a band without time off.
+ *
+ * \param  bitmaps Channel bitmaps of the region.
+ *
+ * \param  channelsMask The channels mask to select from.
+ *
+ * \param  nbWords Number of words of the channels mask.
+ *
+ * \param  datarate Datarate of the transmission.
+ *
+ * \param  bands The bands of the region.
+ *
+ * \param  nbBands Number of bands, at most REGION_MAX_NB_BANDS.
+ *
+ * \param  enabledMask Mask of the available channels, nbWords words.
+ *
+ * \param  delayTx Number of channels of the mask supporting the datarate
+ *                 in a band with time off.
+ *
+ * \retval Returns the number of available channels.
+ */
+uint8_t RegionCommonChanBitmapsCount(const RegionCommonChannelBitmaps_t *bitmaps, uint16_t *channelsMask, uint8_t nbWords, int8_t datarate,
+									 Band_t *bands, uint8_t nbBands, uint16_t *enabledMask, uint8_t *delayTx);
+
+/*!
+ * \brief Finds the n-th active channel of a channels mask, counted from
+ *        channel 0.
+ *
+ * \param  channelsMask The channels mask.
+ *
+ * \param  nbWords Number of words of the channels mask.
+ *
+ * \param  n Rank of the channel, from 0.
+ *
+ * \retval Returns the channel index, 0xFF if the mask has n or less active
+ *         channels.
+ */
+uint8_t RegionCommonChanFind(uint16_t *channelsMask, uint8_t nbWords, uint8_t n);
+
 /*!
  * \brief Sets the last tx done property.
  *        This is a generic function and valid for all regions.
@@ -275,6 +412,62 @@ void RegionCommonSetBandTxDone(bool joined, Band_t *band, TimerTime_t lastTxDone
  */
 TimerTime_t RegionCommonUpdateBandTimeOff(bool joined, bool dutyCycle, Band_t *bands, uint8_t nbBands);
 
+/*!
+ * \brief Empties the band scheduler, its index is built again from the
+ *        bands on the next RegionCommonBandSchedulerRelease. Call it after
+ *        the bands are initialized or restored.
+ *
+ * \param  scheduler Band scheduler of the region.
+ */
+void RegionCommonBandSchedulerReset(RegionCommonBandScheduler_t *scheduler);
+
+/*!
+ * \brief Moves a band in the index of the scheduler, after its time off or
+ *        its last TX time changed.
+ *
+ * \param  scheduler Band scheduler of the region.
+ *
+ * \param  bands The bands of the region.
+ *
+ * \param  band Index of the band.
+ */
+void RegionCommonBandSchedulerUpdateBand(RegionCommonBandScheduler_t *scheduler, Band_t *bands, uint8_t band);
+
+/*!
+ * \brief Ends the time off of the bands released at the given time. Same as
+ *        RegionCommonUpdateBandTimeOff, from the index of the scheduler.
+ *
+ * \param  scheduler Band scheduler of the region.
+ *
+ * \param  joined Set to true, if the node has joined the network.
+ *
+ * \param  dutyCycle Set to true, if the duty cycle is enabled.
+ *
+ * \param  bands The bands of the region.
+ *
+ * \param  nbBands Number of bands, at most REGION_MAX_NB_BANDS.
+ *
+ * \param  now Current time, TimerGetCurrentTime.
+ *
+ * \retval Returns the time to wait for the next band release,
+ *         ( TimerTime_t )( -1 ) if no band has a time off.
+ */
+TimerTime_t RegionCommonBandSchedulerRelease(RegionCommonBandScheduler_t *scheduler, bool joined, bool dutyCycle, Band_t *bands, uint8_t nbBands, TimerTime_t now);
+
+/*!
+ * \brief Gets the time to wait for the first release among some bands.
+ *
+ * \param  scheduler Band scheduler of the region.
+ *
+ * \param  bandsMask Bands to consider, bit n for band n.
+ *
+ * \param  now Current time, as given to RegionCommonBandSchedulerRelease.
+ *
+ * \retval Returns the time to wait, ( TimerTime_t )( -1 ) if none of the
+ *         bands has a time off.
+ */
+TimerTime_t RegionCommonBandSchedulerNextRelease(RegionCommonBandScheduler_t *scheduler, uint8_t bandsMask, TimerTime_t now);
+
 /*!
  * \brief Parses the parameter of an LinkAdrRequest.
  *        This is a generic function and valid for all regions.
@@ -310,25 +503,28 @@ uint8_t RegionCommonLinkAdrReqVerifyParams(RegionCommonLinkAdrReqVerifyParams_t
  *
  * \param  phyDr Physical datarate to use.
  *
- * \param  bandwidth Bandwidth to use.
+ * \param  bandwidth Bandwidth to use [Hz].
  *
- * \retval Returns the symbol time.
+ * \retval Returns the symbol time [us].
  */
-double RegionCommonComputeSymbolTimeLoRa(uint8_t phyDr, uint32_t bandwidth);
+uint32_t RegionCommonComputeSymbolTimeLoRa(uint8_t phyDr, uint32_t bandwidth);
 
 /*!
  * \brief Computes the symbol time for FSK modulation.
  *
- * \param  phyDr Physical datarate to use.
+ * \param  phyDr Physical datarate to use [kbps].
  *
- * \retval Returns the symbol time.
+ * \retval Returns the symbol time [us].
  */
-double RegionCommonComputeSymbolTimeFsk(uint8_t phyDr);
+uint32_t RegionCommonComputeSymbolTimeFsk(uint8_t phyDr);
 
 /*!
  * \brief Computes the RX window timeout and the RX window offset.
  *
- * \param  tSymbol Symbol timeout.
+ * \remark Integer arithmetic only. The results are exact for rxError up to
+ *         1000000 ms.
+ *
+ * \param  tSymbol Symbol time [us].
  *
  * \param  minRxSymbols Minimum required number of symbols to detect an Rx frame.
  *
@@ -341,7 +537,73 @@ double RegionCommonComputeSymbolTimeFsk(uint8_t phyDr);
  *
  * \param  windowOffset RX window time offset to be applied to the RX delay.
  */
-void RegionCommonComputeRxWindowParameters(double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset);
+void RegionCommonComputeRxWindowParameters(uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset);
+
+/*!
+ * \brief Gets the RX window timeout and the RX window offset from the memo
+ *        cache, computes them with RegionCommonComputeRxWindowParameters
+ *        on a miss.
+ *
+ * \param  tSymbol Symbol time [us].
+ *
+ * \param  minRxSymbols Minimum required number of symbols to detect an Rx frame.
+ *
+ * \param  rxError System maximum timing error of the receiver [ms].
+ *
+ * \param  wakeUpTime Wakeup time of the system.
+ *
+ * \param  windowTimeout RX window timeout.
+ *
+ * \param  windowOffset RX window time offset to be applied to the RX delay.
+ */
+void RegionCommonGetRxWindowParameters(uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset);
+
+/*!
+ * \brief Gets the time on air of a frame from the memo cache, calls
+ *        Radio.TimeOnAir on a miss.
+ *
+ * \remark The radio must be set up by Radio.SetTxConfig with the given
+ *         modem, bandwidth and datarate, and the other TX parameters must
+ *         be the same for every call with them, as they are in the regions.
+ *         Call RegionCommonClearTimingCache after changing a radio setting
+ *         the regions do not pass, e.g. with Radio.EnforceLowDRopt.
+ *
+ * \param  modem Radio modem.
+ *
+ * \param  bandwidth Bandwidth given to Radio.SetTxConfig.
+ *
+ * \param  datarate Physical datarate.
+ *
+ * \param  pktLen Frame length [byte].
+ *
+ * \retval Returns the time on air [ms].
+ */
+TimerTime_t RegionCommonGetTimeOnAir(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t pktLen);
+
+/*!
+ * \brief Computes the time on air of a frame sent with the TX parameters of
+ *        the regions, without the radio.
+ *
+ * \remark Used to project the time on air of a frame not sent yet. Gives
+ *         the same value as Radio.TimeOnAir of the SX126x driver for LoRa.
+ *
+ * \param  modem Radio modem.
+ *
+ * \param  bandwidth Bandwidth given to Radio.SetTxConfig [0: 125 kHz,
+ *         1: 250 kHz, 2: 500 kHz], not used for FSK.
+ *
+ * \param  datarate Physical datarate: spreading factor for LoRa, kbps for FSK.
+ *
+ * \param  pktLen Frame length [byte].
+ *
+ * \retval Returns the time on air [ms].
+ */
+TimerTime_t RegionCommonComputeTimeOnAir(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t pktLen);
+
+/*!
+ * \brief Empties the RX window and time on air memo caches.
+ */
+void RegionCommonClearTimingCache(void);
 
 /*!
  * \brief Computes the txPower, based on the max EIRP and the antenna gain.
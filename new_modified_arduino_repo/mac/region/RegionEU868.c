@@ -44,12 +44,12 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 /*!
  * LoRaMAC channels
  */
-static ChannelParams_t Channels[EU868_MAX_NB_CHANNELS];
+static LORAMAC_THREAD_LOCAL ChannelParams_t Channels[EU868_MAX_NB_CHANNELS];
 
 /*!
  * LoRaMac bands
  */
-static Band_t Bands[EU868_MAX_NB_BANDS] =
+static LORAMAC_THREAD_LOCAL Band_t Bands[EU868_MAX_NB_BANDS] =
 	{
 		EU868_BAND0,
 		EU868_BAND1,
@@ -58,20 +58,25 @@ static Band_t Bands[EU868_MAX_NB_BANDS] =
 		EU868_BAND4,
 };
 
+/*!
+ * Index of the bands with a time off
+ */
+static LORAMAC_THREAD_LOCAL RegionCommonBandScheduler_t BandScheduler;
+
 /*!
  * LoRaMac channels mask
  */
-extern uint16_t ChannelsMask[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
 
 /*!
  * LoRaMac channels remaining
  */
-extern uint16_t ChannelsMaskRemaining[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[];
 
 /*!
  * LoRaMac channels default mask
  */
-extern uint16_t ChannelsDefaultMask[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[];
 
 // Static functions
 static int8_t GetNextLowerTxDr(int8_t dr, int8_t minDr)
@@ -153,10 +158,10 @@ static bool VerifyTxFreq(uint32_t freq, uint8_t *band)
 	return true;
 }
 
-static uint8_t CountNbOfEnabledChannels(bool joined, uint8_t datarate, uint16_t *channelsMask, ChannelParams_t *channels, Band_t *bands, uint8_t *enabledChannels, uint8_t *delayTx)
+static uint8_t CountNbOfEnabledChannels(bool joined, uint8_t datarate, uint16_t *channelsMask, ChannelParams_t *channels, Band_t *bands, uint8_t *enabledChannels, uint8_t *delayBands)
 {
 	uint8_t nbEnabledChannels = 0;
-	uint8_t delayTransmission = 0;
+	uint8_t bandsWithTimeOff = 0;
 
 	for (uint8_t i = 0, k = 0; i < EU868_MAX_NB_CHANNELS; i += 16, k++)
 	{
@@ -183,7 +188,7 @@ static uint8_t CountNbOfEnabledChannels(bool joined, uint8_t datarate, uint16_t
 				}
 				if (bands[channels[i + j].Band].TimeOff > 0)
 				{ // Check if the band is available for transmission
-					delayTransmission++;
+					bandsWithTimeOff |= 1 << channels[i + j].Band;
 					continue;
 				}
 				enabledChannels[nbEnabledChannels++] = i + j;
@@ -192,7 +197,7 @@ static uint8_t CountNbOfEnabledChannels(bool joined, uint8_t datarate, uint16_t
 		}
 	}
 
-	*delayTx = delayTransmission;
+	*delayBands = bandsWithTimeOff;
 	return nbEnabledChannels;
 }
 
@@ -312,6 +317,17 @@ PhyParam_t RegionEU868GetPhyParam(GetPhyParams_t *getPhy)
 		phyParam.Channels = Channels;
 		break;
 	}
+	case PHY_BANDS:
+	{
+		phyParam.Bands = Bands;
+		break;
+	}
+	case PHY_TIME_ON_AIR:
+	{
+		phyParam.Value = RegionCommonComputeTimeOnAir((getPhy->Datarate == DR_7) ? MODEM_FSK : MODEM_LORA, GetBandwidth(getPhy->Datarate),
+													  DataratesEU868[getPhy->Datarate], getPhy->PktLen);
+		break;
+	}
 	case PHY_DEF_UPLINK_DWELL_TIME:
 	case PHY_DEF_DOWNLINK_DWELL_TIME:
 	{
@@ -346,6 +362,7 @@ PhyParam_t RegionEU868GetPhyParam(GetPhyParams_t *getPhy)
 void RegionEU868SetBandTxDone(SetBandTxDoneParams_t *txDone)
 {
 	RegionCommonSetBandTxDone(txDone->Joined, &Bands[Channels[txDone->Channel].Band], txDone->LastTxDoneTime);
+	RegionCommonBandSchedulerUpdateBand(&BandScheduler, Bands, Channels[txDone->Channel].Band);
 }
 
 void RegionEU868InitDefaults(InitType_t type)
@@ -354,6 +371,18 @@ void RegionEU868InitDefaults(InitType_t type)
 	{
 	case INIT_TYPE_INIT:
 	{
+		Band_t bands[EU868_MAX_NB_BANDS] =
+			{
+				EU868_BAND0,
+				EU868_BAND1,
+				EU868_BAND2,
+				EU868_BAND3,
+				EU868_BAND4};
+
+		// Bands
+		memcpy1((uint8_t *)Bands, (uint8_t *)bands, sizeof(Bands));
+		RegionCommonBandSchedulerReset(&BandScheduler);
+
 		// Channels
 		Channels[0] = (ChannelParams_t)EU868_LC1;
 		Channels[1] = (ChannelParams_t)EU868_LC2;
@@ -560,22 +589,11 @@ bool RegionEU868AdrNext(AdrNextParams_t *adrNext, int8_t *drOut, int8_t *txPowOu
 
 void RegionEU868ComputeRxWindowParameters(int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams)
 {
-	double tSymbol = 0.0;
-
 	// Get the datarate, perform a boundary check
 	rxConfigParams->Datarate = T_MIN(datarate, EU868_RX_MAX_DATARATE);
 	rxConfigParams->Bandwidth = GetBandwidth(rxConfigParams->Datarate);
 
-	if (rxConfigParams->Datarate == DR_7)
-	{ // FSK
-		tSymbol = RegionCommonComputeSymbolTimeFsk(DataratesEU868[rxConfigParams->Datarate]);
-	}
-	else
-	{ // LoRa
-		tSymbol = RegionCommonComputeSymbolTimeLoRa(DataratesEU868[rxConfigParams->Datarate], BandwidthsEU868[rxConfigParams->Datarate]);
-	}
-
-	RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
+	RegionCommonGetRxWindowParameters(SymbolTimesEU868[rxConfigParams->Datarate], minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
 }
 
 bool RegionEU868RxConfig(RxConfigParams_t *rxConfig, int8_t *datarate)
@@ -666,7 +684,7 @@ bool RegionEU868TxConfig(TxConfigParams_t *txConfig, int8_t *txPower, TimerTime_
 	// Setup maximum payload lenght of the radio driver
 	Radio.SetMaxPayloadLength(modem, txConfig->PktLen);
 	// Get the time-on-air of the next tx frame
-	*txTimeOnAir = Radio.TimeOnAir(modem, txConfig->PktLen);
+	*txTimeOnAir = RegionCommonGetTimeOnAir(modem, bandwidth, phyDr, txConfig->PktLen);
 
 	*txPower = txPowerLimited;
 	return true;
@@ -944,14 +962,17 @@ void RegionEU868CalcBackOff(CalcBackOffParams_t *calcBackOff)
 	calcBackOffParams.TxTimeOnAir = calcBackOff->TxTimeOnAir;
 
 	RegionCommonCalcBackOff(&calcBackOffParams);
+	RegionCommonBandSchedulerUpdateBand(&BandScheduler, Bands, Channels[calcBackOff->Channel].Band);
 }
 
 bool RegionEU868NextChannel(NextChanParams_t *nextChanParams, uint8_t *channel, TimerTime_t *time, TimerTime_t *aggregatedTimeOff)
 {
 	uint8_t nbEnabledChannels = 0;
 	uint8_t delayTx = 0;
+	uint8_t delayBands = 0;
 	uint8_t enabledChannels[EU868_MAX_NB_CHANNELS] = {0};
 	TimerTime_t nextTxDelay = 0;
+	TimerTime_t now = 0;
 
 	if (RegionCommonCountChannels(ChannelsMask, 0, 1) == 0)
 	{ // Reactivate default channels
@@ -964,12 +985,20 @@ bool RegionEU868NextChannel(NextChanParams_t *nextChanParams, uint8_t *channel,
 		*aggregatedTimeOff = 0;
 
 		// Update bands Time OFF
-		nextTxDelay = RegionCommonUpdateBandTimeOff(nextChanParams->Joined, nextChanParams->DutyCycleEnabled, Bands, EU868_MAX_NB_BANDS);
+		now = TimerGetCurrentTime();
+		nextTxDelay = RegionCommonBandSchedulerRelease(&BandScheduler, nextChanParams->Joined, nextChanParams->DutyCycleEnabled,
+													   Bands, EU868_MAX_NB_BANDS, now);
 
 		// Search how many channels are enabled
 		nbEnabledChannels = CountNbOfEnabledChannels(nextChanParams->Joined, nextChanParams->Datarate,
 													 ChannelsMask, Channels,
-													 Bands, enabledChannels, &delayTx);
+													 Bands, enabledChannels, &delayBands);
+		if (delayBands != 0)
+		{
+			// Wait for the first band with a channel usable at this datarate
+			delayTx++;
+			nextTxDelay = RegionCommonBandSchedulerNextRelease(&BandScheduler, delayBands, now);
+		}
 	}
 	else
 	{
@@ -1113,4 +1142,17 @@ uint8_t RegionEU868ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t dr
 	return datarate;
 }
 
+void RegionEU868SaveContext(RegionContext_t *context)
+{
+	memcpy1((uint8_t *)context->Channels, (uint8_t *)Channels, sizeof(Channels));
+	memcpy1((uint8_t *)context->Bands, (uint8_t *)Bands, sizeof(Bands));
+}
+
+void RegionEU868RestoreContext(const RegionContext_t *context)
+{
+	memcpy1((uint8_t *)Channels, (const uint8_t *)context->Channels, sizeof(Channels));
+	memcpy1((uint8_t *)Bands, (const uint8_t *)context->Bands, sizeof(Bands));
+	RegionCommonBandSchedulerReset(&BandScheduler);
+}
+
 #endif
\ No newline at end of file
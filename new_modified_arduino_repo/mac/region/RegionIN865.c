@@ -43,29 +43,29 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 /*!
  * LoRaMAC channels
  */
-static ChannelParams_t Channels[IN865_MAX_NB_CHANNELS];
+static LORAMAC_THREAD_LOCAL ChannelParams_t Channels[IN865_MAX_NB_CHANNELS];
 
 /*!
  * LoRaMac bands
  */
-static Band_t Bands[IN865_MAX_NB_BANDS] =
+static LORAMAC_THREAD_LOCAL Band_t Bands[IN865_MAX_NB_BANDS] =
 	{
 		IN865_BAND0};
 
 /*!
  * LoRaMac channels mask
  */
-extern uint16_t ChannelsMask[6];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMask[6];
 
 /*!
  * LoRaMac channels remaining
  */
-extern uint16_t ChannelsMaskRemaining[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsMaskRemaining[];
 
 /*!
  * LoRaMac channels default mask
  */
-extern uint16_t ChannelsDefaultMask[];
+extern LORAMAC_THREAD_LOCAL uint16_t ChannelsDefaultMask[];
 
 // Static functions
 static int8_t GetNextLowerTxDr(int8_t dr, int8_t minDr)
@@ -283,6 +283,17 @@ PhyParam_t RegionIN865GetPhyParam(GetPhyParams_t *getPhy)
 		phyParam.Channels = Channels;
 		break;
 	}
+	case PHY_BANDS:
+	{
+		phyParam.Bands = Bands;
+		break;
+	}
+	case PHY_TIME_ON_AIR:
+	{
+		phyParam.Value = RegionCommonComputeTimeOnAir((getPhy->Datarate == DR_7) ? MODEM_FSK : MODEM_LORA, GetBandwidth(getPhy->Datarate),
+													  DataratesIN865[getPhy->Datarate], getPhy->PktLen);
+		break;
+	}
 	case PHY_DEF_UPLINK_DWELL_TIME:
 	case PHY_DEF_DOWNLINK_DWELL_TIME:
 	{
@@ -325,6 +336,13 @@ void RegionIN865InitDefaults(InitType_t type)
 	{
 	case INIT_TYPE_INIT:
 	{
+		Band_t bands[IN865_MAX_NB_BANDS] =
+			{
+				IN865_BAND0};
+
+		// Bands
+		memcpy1((uint8_t *)Bands, (uint8_t *)bands, sizeof(Bands));
+
 		// Channels
 		Channels[0] = (ChannelParams_t)IN865_LC1;
 		Channels[1] = (ChannelParams_t)IN865_LC2;
@@ -530,22 +548,11 @@ bool RegionIN865AdrNext(AdrNextParams_t *adrNext, int8_t *drOut, int8_t *txPowOu
 
 void RegionIN865ComputeRxWindowParameters(int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams)
 {
-	double tSymbol = 0.0;
-
 	// Get the datarate, perform a boundary check
 	rxConfigParams->Datarate = T_MIN(datarate, IN865_RX_MAX_DATARATE);
 	rxConfigParams->Bandwidth = GetBandwidth(rxConfigParams->Datarate);
 
-	if (rxConfigParams->Datarate == DR_7)
-	{ // FSK
-		tSymbol = RegionCommonComputeSymbolTimeFsk(DataratesIN865[rxConfigParams->Datarate]);
-	}
-	else
-	{ // LoRa
-		tSymbol = RegionCommonComputeSymbolTimeLoRa(DataratesIN865[rxConfigParams->Datarate], BandwidthsIN865[rxConfigParams->Datarate]);
-	}
-
-	RegionCommonComputeRxWindowParameters(tSymbol, minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
+	RegionCommonGetRxWindowParameters(SymbolTimesIN865[rxConfigParams->Datarate], minRxSymbols, rxError, RADIO_WAKEUP_TIME, &rxConfigParams->WindowTimeout, &rxConfigParams->WindowOffset);
 }
 
 bool RegionIN865RxConfig(RxConfigParams_t *rxConfig, int8_t *datarate)
@@ -635,7 +642,7 @@ bool RegionIN865TxConfig(TxConfigParams_t *txConfig, int8_t *txPower, TimerTime_
 	// Setup maximum payload lenght of the radio driver
 	Radio.SetMaxPayloadLength(modem, txConfig->PktLen);
 	// Get the time-on-air of the next tx frame
-	*txTimeOnAir = Radio.TimeOnAir(modem, txConfig->PktLen);
+	*txTimeOnAir = RegionCommonGetTimeOnAir(modem, bandwidth, phyDr, txConfig->PktLen);
 
 	*txPower = txPowerLimited;
 	return true;
@@ -1063,4 +1070,16 @@ uint8_t RegionIN865ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t dr
 	return T_MIN(DR_5, T_MAX(DR_0, dr - EffectiveRx1DrOffsetIN865[drOffset]));
 }
 
+void RegionIN865SaveContext(RegionContext_t *context)
+{
+	memcpy1((uint8_t *)context->Channels, (uint8_t *)Channels, sizeof(Channels));
+	memcpy1((uint8_t *)context->Bands, (uint8_t *)Bands, sizeof(Bands));
+}
+
+void RegionIN865RestoreContext(const RegionContext_t *context)
+{
+	memcpy1((uint8_t *)Channels, (const uint8_t *)context->Channels, sizeof(Channels));
+	memcpy1((uint8_t *)Bands, (const uint8_t *)context->Bands, sizeof(Bands));
+}
+
 #endif
\ No newline at end of file
@@ -272,6 +272,18 @@ static const uint8_t DataratesKR920[] = {12, 11, 10, 9, 8, 7};
  */
 static const uint32_t BandwidthsKR920[] = {125000, 125000, 125000, 125000, 125000, 125000};
 
+/*!
+ * Symbol times table definition in us
+ */
+static const uint32_t SymbolTimesKR920[] = {
+	REGION_LORA_SYMBOL_TIME(12, 125000),        // DR_0
+	REGION_LORA_SYMBOL_TIME(11, 125000),        // DR_1
+	REGION_LORA_SYMBOL_TIME(10, 125000),        // DR_2
+	REGION_LORA_SYMBOL_TIME(9, 125000),         // DR_3
+	REGION_LORA_SYMBOL_TIME(8, 125000),         // DR_4
+	REGION_LORA_SYMBOL_TIME(7, 125000)          // DR_5
+};
+
 /*!
  * Maximum payload with respect to the datarate index. Can operate with and without a repeater.
  */
@@ -512,4 +524,19 @@ void RegionKR920SetContinuousWave(ContinuousWaveParams_t *continuousWave);
  */
 uint8_t RegionKR920ApplyDrOffset(uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset);
 
+
+/*!
+ * \brief Copies the channels and bands into a context.
+ *
+ * \param  context Context to save the state to.
+ */
+void RegionKR920SaveContext(RegionContext_t *context);
+
+/*!
+ * \brief Loads the channels and bands from a context.
+ *
+ * \param  context Context to load the state from.
+ */
+void RegionKR920RestoreContext(const RegionContext_t *context);
+
 #endif // __REGION_KR920_H__
@@ -464,6 +464,24 @@ struct Radio_s
 	 * \param   sleepTime     Structure describing sleep timeout value
 	 */
 	void (*SetRxDutyCycle)(uint32_t rxTime, uint32_t sleepTime);
+	/*!
+	 * \brief Writes a part of the next packet to the radio data buffer
+	 *
+	 * \remark Lets a packet be written in segments, e.g. header, payload and
+	 *         MIC, without assembling it in a RAM buffer first.
+	 *
+	 * \param   offset        Position of the part in the packet
+	 * \param   buffer        Part of the packet
+	 * \param   size          Size of the part
+	 */
+	void (*WriteTxBuffer)(uint8_t offset, const uint8_t *buffer, uint8_t size);
+	/*!
+	 * \brief Sends the packet written with WriteTxBuffer. Prepares the packet
+	 *        to be sent and sets the radio in transmission
+	 *
+	 * \param   size          Size of the packet
+	 */
+	void (*SendTxBuffer)(uint8_t size);
 };
 
 /*!
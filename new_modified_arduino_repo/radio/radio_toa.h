@@ -0,0 +1,46 @@
+/*!
+ * \file      radio_toa.h
+ *
+ * \brief     Time on air of the radio packets
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Integer arithmetic only, so the duty cycle bookkeeping does not
+ *            pull in the floating point library on MCUs without an FPU.
+ */
+#ifndef __RADIO_TOA_H__
+#define __RADIO_TOA_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * \brief Computes the time on air of a LoRa packet
+ *
+ * \remark Exact for the 125, 250 and 500 kHz bandwidths.
+ *
+ * \param   sf              - Spreading factor [7..12]
+ * \param   bandwidth       - Bandwidth [Hz]
+ * \param   cr              - Coding rate [1: 4/5, 2: 4/6, 3: 4/7, 4: 4/8]
+ * \param   preambleLen     - Preamble length [symbols]
+ * \param   fixLen          - Implicit header
+ * \param   ldro            - Low datarate optimization
+ * \param   pktLen          - Payload length [bytes]
+ * \retval  Time on air [ms]
+ */
+uint32_t RadioLoRaTimeOnAir(uint8_t sf, uint32_t bandwidth, uint8_t cr, uint16_t preambleLen, bool fixLen, bool ldro, uint8_t pktLen);
+
+/*!
+ * \brief Computes the time on air of a FSK packet
+ *
+ * \param   bitrate         - Bitrate [bps]
+ * \param   preambleLen     - Preamble length [bytes]
+ * \param   syncWordLen     - Sync word length [bits]
+ * \param   fixLen          - Fixed length packet, no length byte
+ * \param   crcLen          - CRC length [bytes]
+ * \param   pktLen          - Payload length [bytes]
+ * \retval  Time on air [ms], rounded to the nearest
+ */
+uint32_t RadioFskTimeOnAir(uint32_t bitrate, uint16_t preambleLen, uint8_t syncWordLen, bool fixLen, uint8_t crcLen, uint8_t pktLen);
+
+#endif // __RADIO_TOA_H__
@@ -24,6 +24,7 @@
 #include <string.h>
 // #include "boards/mcu/board.h"
 #include "radio.h"
+#include "radio_toa.h"
 #include "sx126x.h"
 // #include "boards/sx126x/sx126x-board.h"
 // #include "boards/mcu/timer.h"
@@ -395,6 +396,22 @@ void RadioSetRxDutyCycle(uint32_t rxTime, uint32_t sleepTime);
  */
 void RadioEnforceLowDRopt(bool enforce);
 
+/*!
+ * @brief Writes a part of the next packet to the radio data buffer
+ *
+ * @param  offset Position of the part in the packet
+ * @param  buffer Part of the packet
+ * @param  size Size of the part
+ */
+void RadioWriteTxBuffer(uint8_t offset, const uint8_t *buffer, uint8_t size);
+
+/*!
+ * @brief Sends the packet written with RadioWriteTxBuffer
+ *
+ * @param  size Size of the packet
+ */
+void RadioSendTxBuffer(uint8_t size);
+
 /*!
  * Radio driver structure initialization
  */
@@ -435,6 +452,8 @@ const struct Radio_s Radio =
 		RadioRxBoosted,
 		RadioEnforceLowDRopt,
 		RadioSetRxDutyCycle,
+		RadioWriteTxBuffer,
+		RadioSendTxBuffer,
 };
 
 /*
@@ -482,11 +501,6 @@ const FskBandwidth_t FskBandwidths[] =
 // const RadioLoRaBandwidths_t Bandwidths[] = {LORA_BW_125, LORA_BW_250, LORA_BW_500};
 const sx126x_lora_bw_t Bandwidths[] = {SX126X_LORA_BW_125, SX126X_LORA_BW_250, SX126X_LORA_BW_500, SX126X_LORA_BW_062, SX126X_LORA_BW_041, SX126X_LORA_BW_031, SX126X_LORA_BW_020, SX126X_LORA_BW_015, SX126X_LORA_BW_010, SX126X_LORA_BW_007};
 
-//                                          SF12    SF11    SF10    SF9    SF8    SF7
-static double RadioLoRaSymbTime[3][6] = {{32.768, 16.384, 8.192, 4.096, 2.048, 1.024}, // 125 KHz
-										 {16.384, 8.192, 4.096, 2.048, 1.024, 0.512},  // 250 KHz
-										 {8.192, 4.096, 2.048, 1.024, 0.512, 0.256}};  // 500 KHz
-
 uint8_t MaxPayloadLength = 0xFF;
 
 uint32_t TxTimeout = 0;
@@ -1164,31 +1178,9 @@ uint32_t RadioTimeOnAir(RadioModems_t modem, uint8_t pktLen)
 	// break;
 	case MODEM_LORA:
 	{
-		// double ts = RadioLoRaSymbTime[SX126x.ModulationParams.Params.LoRa.Bandwidth - 4][12 - SX126x.ModulationParams.Params.LoRa.SpreadingFactor];
-		double ts = RadioLoRaSymbTime[lora_mod_params.bw - 4][12 - lora_mod_params.sf];
-		// time of preamble
-		// double tPreamble = (SX126x.PacketParams.Params.LoRa.PreambleLength + 4.25) * ts;
-		double tPreamble = (lora_pkt_params.preamble_len_in_symb + 4.25) * ts;
-		// Symbol length of payload and time
-		// double tmp = ceil((8 * pktLen - 4 * SX126x.ModulationParams.Params.LoRa.SpreadingFactor +
-		// 				   28 + 16 * SX126x.PacketParams.Params.LoRa.CrcMode -
-		// 				   ((SX126x.PacketParams.Params.LoRa.HeaderType == LORA_PACKET_FIXED_LENGTH) ? 20 : 0)) /
-		// 				  (double)(4 * (SX126x.ModulationParams.Params.LoRa.SpreadingFactor -
-		// 								((SX126x.ModulationParams.Params.LoRa.LowDatarateOptimize > 0) ? 2 : 0)))) *
-		// 			 ((SX126x.ModulationParams.Params.LoRa.CodingRate % 4) + 4);
-
-		double tmp = ceil((8 * pktLen - 4 * lora_mod_params.sf +
-			28 + 16 * lora_mod_params.cr -
-			((lora_pkt_params.header_type == SX126X_LORA_PKT_IMPLICIT) ? 20 : 0)) /
-		   (double)(4 * (lora_mod_params.sf -
-						 ((lora_mod_params.ldro > 0) ? 2 : 0)))) *
-	  ((lora_mod_params.cr % 4) + 4);
-		double nPayload = 8 + ((tmp > 0) ? tmp : 0);
-		double tPayload = nPayload * ts;
-		// Time on air
-		double tOnAir = tPreamble + tPayload;
-		// return milli seconds
-		airTime = floor(tOnAir + 0.999);
+		airTime = RadioLoRaTimeOnAir(lora_mod_params.sf, sx126x_get_lora_bw_in_hz(lora_mod_params.bw), lora_mod_params.cr,
+									 lora_pkt_params.preamble_len_in_symb, lora_pkt_params.header_type == SX126X_LORA_PKT_IMPLICIT,
+									 lora_mod_params.ldro > 0, pktLen);
 	}
 	break;
 	}
@@ -1203,6 +1195,20 @@ uint32_t RadioTimeOnAir(RadioModems_t modem, uint8_t pktLen)
  * \param size       Buffer size
  */
 void RadioSend(uint8_t *buffer, uint8_t size)
+{
+	RadioWriteTxBuffer(0, buffer, size);
+	RadioSendTxBuffer(size);
+}
+
+void RadioWriteTxBuffer(uint8_t offset, const uint8_t *buffer, uint8_t size)
+{
+	radio_context_t* radio_context = radio_board_get_radio_context_reference( );
+
+	// The TX base address is 0
+	sx126x_write_buffer( radio_context, offset, buffer, size );
+}
+
+void RadioSendTxBuffer(uint8_t size)
 {
 	// SX126xTXena();
 	radio_context_t* radio_context = radio_board_get_radio_context_reference( );
@@ -1231,7 +1237,6 @@ void RadioSend(uint8_t *buffer, uint8_t size)
 	sx126x_set_lora_pkt_params( radio_context, &lora_pkt_params );
 
 	// SX126xSendPayload(buffer, size, 0);
-	sx126x_write_buffer( radio_context, 0, buffer, size );
 	sx126x_set_tx(radio_context, 0);
 	TimerSetValue(&TxTimeoutTimer, TxTimeout);
 	TimerStart(&TxTimeoutTimer);
@@ -0,0 +1,41 @@
+/*!
+ * \file      radio_toa.c
+ *
+ * \brief     Time on air of the radio packets
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio_toa.h"
+
+uint32_t RadioLoRaTimeOnAir(uint8_t sf, uint32_t bandwidth, uint8_t cr, uint16_t preambleLen, bool fixLen, bool ldro, uint8_t pktLen)
+{
+	// Symbol time [us / 4]
+	uint32_t ts = ((uint32_t)(1 << sf) * 250000) / bandwidth;
+	// The header term counts 16 * cr where the datasheet has 16 * CRC on,
+	// as the airtime, hence the duty cycle, was always computed that way
+	int32_t num = 8 * pktLen - 4 * sf + 28 + 16 * cr - ((fixLen == true) ? 20 : 0);
+	int32_t den = 4 * (sf - ((ldro == true) ? 2 : 0));
+	// Ceiling of the quotient, the C division truncates towards 0
+	int32_t tmp = ((num > 0) ? ((num + den - 1) / den) : (num / den)) * ((cr % 4) + 4);
+	uint32_t nPayload = 8 + ((tmp > 0) ? tmp : 0);
+	// Preamble, 4.25 symbols of sync word and payload [symbols * 4]
+	uint32_t nSymbols = 4 * (uint32_t)preambleLen + 17 + 4 * nPayload;
+
+	return (nSymbols * ts + 999) / 1000;
+}
+
+uint32_t RadioFskTimeOnAir(uint32_t bitrate, uint16_t preambleLen, uint8_t syncWordLen, bool fixLen, uint8_t crcLen, uint8_t pktLen)
+{
+	uint32_t nBits = 8 * (preambleLen + (syncWordLen >> 3) + ((fixLen == true) ? 0 : 1) + pktLen + crcLen);
+	uint32_t airTime = (nBits * 1000) / bitrate;
+	uint32_t rest = (nBits * 1000) % bitrate;
+
+	// Round half to even
+	if (((2 * rest) > bitrate) || (((2 * rest) == bitrate) && ((airTime & 1) != 0)))
+	{
+		airTime++;
+	}
+	return airTime;
+}
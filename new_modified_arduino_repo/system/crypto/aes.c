@@ -62,6 +62,14 @@
 #endif
 
 #include "aes.h"
+#include "aes_hw.h"
+
+/* the byte oriented round functions are not needed if all encryption
+   is done with T-tables and no decryption is compiled in */
+#if !defined(AES_ENC_TTABLE) || defined(AES_DEC_PREKEYED) || defined(AES_ENC_128_OTFK) || \
+	defined(AES_DEC_128_OTFK) || defined(AES_ENC_256_OTFK) || defined(AES_DEC_256_OTFK)
+#define BYTE_ROUNDS
+#endif
 
 // #if defined( HAVE_UINT_32T )
 //  typedef unsigned long uint32_t;
@@ -201,8 +209,10 @@ static const uint8_t sbox[256] = sb_data(f1);
 static const uint8_t isbox[256] = isb_data(f1);
 #endif
 
+#if defined(BYTE_ROUNDS)
 static const uint8_t gfm2_sbox[256] = sb_data(f2);
 static const uint8_t gfm3_sbox[256] = sb_data(f3);
+#endif
 
 #if defined(AES_DEC_PREKEYED)
 static const uint8_t gfmul_9[256] = mm_data(f9);
@@ -308,6 +318,66 @@ uint8_t inv_affine(const uint8_t x)
 
 #endif
 
+#if defined(AES_ENC_TTABLE)
+
+#if !defined(USE_TABLES)
+#error "AES_ENC_TTABLE requires USE_TABLES"
+#endif
+
+/* The T-tables combine sub_bytes and mix_columns for one state byte, the
+   column of the table entry being the byte position in the output column:
+   te0(x) = { 2.S(x), S(x), S(x), 3.S(x) } as a big endian word */
+
+#define te0(x) (((uint32_t)f2(x) << 24) | ((uint32_t)(x) << 16) | ((uint32_t)(x) << 8) | (uint32_t)f3(x))
+#define te1(x) (((uint32_t)f3(x) << 24) | ((uint32_t)f2(x) << 16) | ((uint32_t)(x) << 8) | (uint32_t)(x))
+#define te2(x) (((uint32_t)(x) << 24) | ((uint32_t)f3(x) << 16) | ((uint32_t)f2(x) << 8) | (uint32_t)(x))
+#define te3(x) (((uint32_t)(x) << 24) | ((uint32_t)(x) << 16) | ((uint32_t)f3(x) << 8) | (uint32_t)f2(x))
+
+static const uint32_t t_enc0[256] = sb_data(te0);
+
+#if defined(AES_ENC_TTABLE_COMPACT)
+#define rot_r(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define t_en0(x) t_enc0[(x)]
+#define t_en1(x) rot_r(t_enc0[(x)], 8)
+#define t_en2(x) rot_r(t_enc0[(x)], 16)
+#define t_en3(x) rot_r(t_enc0[(x)], 24)
+#else
+static const uint32_t t_enc1[256] = sb_data(te1);
+static const uint32_t t_enc2[256] = sb_data(te2);
+static const uint32_t t_enc3[256] = sb_data(te3);
+#define t_en0(x) t_enc0[(x)]
+#define t_en1(x) t_enc1[(x)]
+#define t_en2(x) t_enc2[(x)]
+#define t_en3(x) t_enc3[(x)]
+#endif
+
+#define word_in(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define word_out(p, v)            \
+	do                            \
+	{                             \
+		(p)[0] = (uint8_t)((v) >> 24); \
+		(p)[1] = (uint8_t)((v) >> 16); \
+		(p)[2] = (uint8_t)((v) >> 8);  \
+		(p)[3] = (uint8_t)(v);         \
+	} while (0)
+
+/* One full round on the four state columns */
+#define t_round(d0, d1, d2, d3, s0, s1, s2, s3, k)                                                                    \
+	do                                                                                                                \
+	{                                                                                                                 \
+		d0 = t_en0((s0) >> 24) ^ t_en1(((s1) >> 16) & 0xff) ^ t_en2(((s2) >> 8) & 0xff) ^ t_en3((s3)&0xff) ^ (k)[0]; \
+		d1 = t_en0((s1) >> 24) ^ t_en1(((s2) >> 16) & 0xff) ^ t_en2(((s3) >> 8) & 0xff) ^ t_en3((s0)&0xff) ^ (k)[1]; \
+		d2 = t_en0((s2) >> 24) ^ t_en1(((s3) >> 16) & 0xff) ^ t_en2(((s0) >> 8) & 0xff) ^ t_en3((s1)&0xff) ^ (k)[2]; \
+		d3 = t_en0((s3) >> 24) ^ t_en1(((s0) >> 16) & 0xff) ^ t_en2(((s1) >> 8) & 0xff) ^ t_en3((s2)&0xff) ^ (k)[3]; \
+	} while (0)
+
+/* The last round has no mix_columns step */
+#define t_last(s0, s1, s2, s3)                                                                                    \
+	(((uint32_t)s_box((s0) >> 24) << 24) | ((uint32_t)s_box(((s1) >> 16) & 0xff) << 16) | \
+	 ((uint32_t)s_box(((s2) >> 8) & 0xff) << 8) | (uint32_t)s_box((s3)&0xff))
+
+#endif
+
 #if defined(HAVE_MEMCPY)
 #define block_copy_nn(d, s, l) memcpy(d, s, l)
 #define block_copy(d, s) memcpy(d, s, N_BLOCK)
@@ -377,6 +447,8 @@ static void xor_block(void *d, const void *s)
 #endif
 }
 
+#if defined(BYTE_ROUNDS)
+
 static void copy_and_key(void *d, const void *s, const void *k)
 {
 #if defined(HAVE_UINT_32T)
@@ -504,6 +576,8 @@ static void mix_sub_columns(uint8_t dt[N_BLOCK], uint8_t st[N_BLOCK])
 	dt[15] = gfm3_sb(st[12]) ^ s_box(st[1]) ^ s_box(st[6]) ^ gfm2_sb(st[11]);
 }
 
+#endif
+
 #if defined(AES_DEC_PREKEYED)
 
 #if defined(VERSION_1)
@@ -589,6 +663,12 @@ return_type lora_aes_set_key(const uint8_t key[], length_type keylen, lora_aes_c
 		ctx->ksch[cc + 2] = ctx->ksch[tt + 2] ^ t2;
 		ctx->ksch[cc + 3] = ctx->ksch[tt + 3] ^ t3;
 	}
+#if defined(AES_ENC_TTABLE)
+	for (cc = 0; cc < (hi >> 2); ++cc)
+	{
+		ctx->ksch_w[cc] = word_in(ctx->ksch + 4 * cc);
+	}
+#endif
 	return 0;
 }
 
@@ -598,7 +678,49 @@ return_type lora_aes_set_key(const uint8_t key[], length_type keylen, lora_aes_c
 
 /*  Encrypt a single block of 16 bytes */
 
-return_type lora_aes_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+#if defined(AES_ENC_TTABLE)
+
+static return_type sw_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+{
+	if (ctx->rnd)
+	{
+		const uint32_t *rk = ctx->ksch_w;
+		uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+		uint8_t r;
+
+		s0 = word_in(in) ^ rk[0];
+		s1 = word_in(in + 4) ^ rk[1];
+		s2 = word_in(in + 8) ^ rk[2];
+		s3 = word_in(in + 12) ^ rk[3];
+
+		/* two rounds per iteration, the state swaps between s and t */
+		for (r = ctx->rnd >> 1;;)
+		{
+			t_round(t0, t1, t2, t3, s0, s1, s2, s3, rk + 4);
+			rk += 8;
+			if (--r == 0)
+				break;
+			t_round(s0, s1, s2, s3, t0, t1, t2, t3, rk);
+		}
+
+		s0 = t_last(t0, t1, t2, t3) ^ rk[0];
+		s1 = t_last(t1, t2, t3, t0) ^ rk[1];
+		s2 = t_last(t2, t3, t0, t1) ^ rk[2];
+		s3 = t_last(t3, t0, t1, t2) ^ rk[3];
+
+		word_out(out, s0);
+		word_out(out + 4, s1);
+		word_out(out + 8, s2);
+		word_out(out + 12, s3);
+	}
+	else
+		return (uint8_t)-1;
+	return 0;
+}
+
+#else
+
+static return_type sw_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
 {
 	if (ctx->rnd)
 	{
@@ -626,6 +748,152 @@ return_type lora_aes_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], co
 	return 0;
 }
 
+#endif
+
+static return_type sw_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1])
+{
+	while (n_block--)
+	{
+		if (sw_encrypt(in, out, ctx) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+		in += N_BLOCK;
+		out += N_BLOCK;
+	}
+	return EXIT_SUCCESS;
+}
+
+static return_type sw_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[])
+{
+	while (n_block--)
+	{
+		if (sw_encrypt(blocks, blocks, *ctx++) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+		blocks += N_BLOCK;
+	}
+	return EXIT_SUCCESS;
+}
+
+#if defined(AES_HW_ACCEL)
+
+static return_type hw_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+{
+	if (ctx->rnd)
+	{
+		lora_aes_hw_encrypt(in, out, ctx);
+	}
+	else
+		return (uint8_t)-1;
+	return 0;
+}
+
+static return_type hw_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1])
+{
+	if (ctx->rnd)
+	{
+		lora_aes_hw_ecb_encrypt(in, out, n_block, ctx);
+	}
+	else
+		return (uint8_t)-1;
+	return 0;
+}
+
+static return_type hw_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[])
+{
+	int32_t i;
+
+	for (i = 0; i < n_block; ++i)
+	{
+		if (!ctx[i]->rnd)
+			return (uint8_t)-1;
+	}
+	lora_aes_hw_multi_encrypt(blocks, n_block, ctx);
+	return 0;
+}
+
+static return_type detect_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1]);
+static return_type detect_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1]);
+static return_type detect_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[]);
+
+/* Resolved on first use to the CPU crypto instructions if they are
+   available, otherwise to the portable implementation. Accessed
+   atomically, the first use may happen on several threads at once */
+static return_type (*encrypt_impl)(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1]) = detect_encrypt;
+static return_type (*ecb_encrypt_impl)(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1]) = detect_ecb_encrypt;
+static return_type (*multi_encrypt_impl)(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[]) = detect_multi_encrypt;
+
+static void detect_impl(void)
+{
+	lora_aes_use_hw_accel(1);
+}
+
+void lora_aes_use_hw_accel(int enable)
+{
+	if (enable && lora_aes_hw_available())
+	{
+		__atomic_store_n(&encrypt_impl, hw_encrypt, __ATOMIC_RELAXED);
+		__atomic_store_n(&ecb_encrypt_impl, hw_ecb_encrypt, __ATOMIC_RELAXED);
+		__atomic_store_n(&multi_encrypt_impl, hw_multi_encrypt, __ATOMIC_RELAXED);
+	}
+	else
+	{
+		__atomic_store_n(&encrypt_impl, sw_encrypt, __ATOMIC_RELAXED);
+		__atomic_store_n(&ecb_encrypt_impl, sw_ecb_encrypt, __ATOMIC_RELAXED);
+		__atomic_store_n(&multi_encrypt_impl, sw_multi_encrypt, __ATOMIC_RELAXED);
+	}
+}
+
+static return_type detect_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+{
+	detect_impl();
+	return __atomic_load_n(&encrypt_impl, __ATOMIC_RELAXED)(in, out, ctx);
+}
+
+static return_type detect_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1])
+{
+	detect_impl();
+	return __atomic_load_n(&ecb_encrypt_impl, __ATOMIC_RELAXED)(in, out, n_block, ctx);
+}
+
+static return_type detect_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[])
+{
+	detect_impl();
+	return __atomic_load_n(&multi_encrypt_impl, __ATOMIC_RELAXED)(blocks, n_block, ctx);
+}
+
+return_type lora_aes_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+{
+	return __atomic_load_n(&encrypt_impl, __ATOMIC_RELAXED)(in, out, ctx);
+}
+
+return_type lora_aes_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1])
+{
+	return __atomic_load_n(&ecb_encrypt_impl, __ATOMIC_RELAXED)(in, out, n_block, ctx);
+}
+
+return_type lora_aes_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[])
+{
+	return __atomic_load_n(&multi_encrypt_impl, __ATOMIC_RELAXED)(blocks, n_block, ctx);
+}
+
+#else
+
+return_type lora_aes_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+{
+	return sw_encrypt(in, out, ctx);
+}
+
+return_type lora_aes_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1])
+{
+	return sw_ecb_encrypt(in, out, n_block, ctx);
+}
+
+return_type lora_aes_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[])
+{
+	return sw_multi_encrypt(blocks, n_block, ctx);
+}
+
+#endif
+
 /* CBC encrypt a number of blocks (input and return an IV) */
 
 return_type lora_aes_cbc_encrypt(const uint8_t *in, uint8_t *out,
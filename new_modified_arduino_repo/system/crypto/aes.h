@@ -49,6 +49,22 @@
 #if 0
 #define AES_DEC_256_OTFK /* AES decryption with 'on the fly' 256 bit keying */
 #endif
+#if 0
+#define AES_ENC_TTABLE /* AES encryption with 32-bit T-tables (4 KB of tables)  */
+#endif
+#if 0
+#define AES_ENC_TTABLE_COMPACT /* as above with a single 1 KB T-table       */
+#endif
+
+#if defined(AES_ENC_TTABLE_COMPACT) && !defined(AES_ENC_TTABLE)
+#define AES_ENC_TTABLE
+#endif
+
+/* On x86 hosts lora_aes_encrypt uses the AES-NI instructions when the CPU
+   reports them at run time. Define AES_NO_HW_ACCEL to always use this code. */
+#if !defined(AES_NO_HW_ACCEL) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_HW_ACCEL
+#endif
 
 #define N_ROW 4
 #define N_COL 4
@@ -67,6 +83,9 @@ typedef struct
 {
 	uint8_t ksch[(N_MAX_ROUNDS + 1) * N_BLOCK];
 	uint8_t rnd;
+#if defined(AES_ENC_TTABLE)
+	uint32_t ksch_w[(N_MAX_ROUNDS + 1) * N_COL]; /* ksch as big endian words */
+#endif
 } lora_aes_context;
 
 /*  The following calls are for a precomputed key schedule
@@ -95,6 +114,31 @@ return_type lora_aes_cbc_encrypt(const uint8_t *in,
 								 int32_t n_block,
 								 uint8_t iv[N_BLOCK],
 								 const lora_aes_context ctx[1]);
+
+/*  Encrypts n_block independent blocks (e.g. CTR mode counter blocks).
+    in and out may be the same buffer. With AES_HW_ACCEL the blocks
+    are run interleaved through the CPU AES pipeline.
+*/
+return_type lora_aes_ecb_encrypt(const uint8_t *in,
+								 uint8_t *out,
+								 int32_t n_block,
+								 const lora_aes_context ctx[1]);
+
+/*  Encrypts n_block blocks in place, block i with the key schedule ctx[i].
+    Used to run independent CBC-MAC chains with different keys in
+    lock step. With AES_HW_ACCEL the blocks are run interleaved.
+*/
+return_type lora_aes_multi_encrypt(uint8_t *blocks,
+								   int32_t n_block,
+								   const lora_aes_context *const ctx[]);
+
+#if defined(AES_HW_ACCEL)
+/*  Selects the code run by the three functions above: 1 for the CPU AES
+    instructions if the CPU has them (the default), 0 for the portable
+    code, e.g. to compare both.
+*/
+void lora_aes_use_hw_accel(int enable);
+#endif
 #endif
 
 #if defined(AES_DEC_PREKEYED)
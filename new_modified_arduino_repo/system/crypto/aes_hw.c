@@ -0,0 +1,126 @@
+/*!
+ * \file      aes_hw.c
+ *
+ * \brief     AES block encryption with the AES-NI instructions for x86 host
+ *            builds
+ *
+ * \remark    The functions are compiled with a target attribute, so the
+ *            file needs no special compiler flags. lora_aes_encrypt only
+ *            calls them after lora_aes_hw_available reported support.
+ */
+#include <stdint.h>
+#include "aes.h"
+#include "aes_hw.h"
+
+#if defined(AES_HW_ACCEL)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+int lora_aes_hw_available(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+	{
+		return 0;
+	}
+	return ((ecx & bit_AES) != 0) && ((edx & bit_SSE2) != 0);
+}
+
+__attribute__((target("aes,sse2"))) void lora_aes_hw_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1])
+{
+	const uint8_t *rk = ctx->ksch;
+	__m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128((const __m128i *)rk));
+	uint8_t r;
+
+	for (r = 1; r < ctx->rnd; ++r)
+	{
+		s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i *)(rk + r * N_BLOCK)));
+	}
+	s = _mm_aesenclast_si128(s, _mm_loadu_si128((const __m128i *)(rk + r * N_BLOCK)));
+	_mm_storeu_si128((__m128i *)out, s);
+}
+
+__attribute__((target("aes,sse2"))) void lora_aes_hw_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1])
+{
+	const uint8_t *rk = ctx->ksch;
+	__m128i k, s0, s1, s2, s3;
+	uint8_t r;
+
+	for (; n_block >= 4; n_block -= 4)
+	{
+		k = _mm_loadu_si128((const __m128i *)rk);
+		s0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 0 * N_BLOCK)), k);
+		s1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 1 * N_BLOCK)), k);
+		s2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 2 * N_BLOCK)), k);
+		s3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(in + 3 * N_BLOCK)), k);
+		for (r = 1; r < ctx->rnd; ++r)
+		{
+			k = _mm_loadu_si128((const __m128i *)(rk + r * N_BLOCK));
+			s0 = _mm_aesenc_si128(s0, k);
+			s1 = _mm_aesenc_si128(s1, k);
+			s2 = _mm_aesenc_si128(s2, k);
+			s3 = _mm_aesenc_si128(s3, k);
+		}
+		k = _mm_loadu_si128((const __m128i *)(rk + r * N_BLOCK));
+		_mm_storeu_si128((__m128i *)(out + 0 * N_BLOCK), _mm_aesenclast_si128(s0, k));
+		_mm_storeu_si128((__m128i *)(out + 1 * N_BLOCK), _mm_aesenclast_si128(s1, k));
+		_mm_storeu_si128((__m128i *)(out + 2 * N_BLOCK), _mm_aesenclast_si128(s2, k));
+		_mm_storeu_si128((__m128i *)(out + 3 * N_BLOCK), _mm_aesenclast_si128(s3, k));
+		in += 4 * N_BLOCK;
+		out += 4 * N_BLOCK;
+	}
+	for (; n_block > 0; --n_block)
+	{
+		lora_aes_hw_encrypt(in, out, ctx);
+		in += N_BLOCK;
+		out += N_BLOCK;
+	}
+}
+
+__attribute__((target("aes,sse2"))) void lora_aes_hw_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[])
+{
+	__m128i s0, s1, s2, s3;
+	uint8_t r;
+	uint8_t rnd;
+
+	for (; n_block >= 4; n_block -= 4)
+	{
+		rnd = ctx[0]->rnd;
+		if ((ctx[1]->rnd != rnd) || (ctx[2]->rnd != rnd) || (ctx[3]->rnd != rnd))
+		{
+			break;
+		}
+		s0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(blocks + 0 * N_BLOCK)), _mm_loadu_si128((const __m128i *)ctx[0]->ksch));
+		s1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(blocks + 1 * N_BLOCK)), _mm_loadu_si128((const __m128i *)ctx[1]->ksch));
+		s2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(blocks + 2 * N_BLOCK)), _mm_loadu_si128((const __m128i *)ctx[2]->ksch));
+		s3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(blocks + 3 * N_BLOCK)), _mm_loadu_si128((const __m128i *)ctx[3]->ksch));
+		for (r = 1; r < rnd; ++r)
+		{
+			s0 = _mm_aesenc_si128(s0, _mm_loadu_si128((const __m128i *)(ctx[0]->ksch + r * N_BLOCK)));
+			s1 = _mm_aesenc_si128(s1, _mm_loadu_si128((const __m128i *)(ctx[1]->ksch + r * N_BLOCK)));
+			s2 = _mm_aesenc_si128(s2, _mm_loadu_si128((const __m128i *)(ctx[2]->ksch + r * N_BLOCK)));
+			s3 = _mm_aesenc_si128(s3, _mm_loadu_si128((const __m128i *)(ctx[3]->ksch + r * N_BLOCK)));
+		}
+		_mm_storeu_si128((__m128i *)(blocks + 0 * N_BLOCK), _mm_aesenclast_si128(s0, _mm_loadu_si128((const __m128i *)(ctx[0]->ksch + r * N_BLOCK))));
+		_mm_storeu_si128((__m128i *)(blocks + 1 * N_BLOCK), _mm_aesenclast_si128(s1, _mm_loadu_si128((const __m128i *)(ctx[1]->ksch + r * N_BLOCK))));
+		_mm_storeu_si128((__m128i *)(blocks + 2 * N_BLOCK), _mm_aesenclast_si128(s2, _mm_loadu_si128((const __m128i *)(ctx[2]->ksch + r * N_BLOCK))));
+		_mm_storeu_si128((__m128i *)(blocks + 3 * N_BLOCK), _mm_aesenclast_si128(s3, _mm_loadu_si128((const __m128i *)(ctx[3]->ksch + r * N_BLOCK))));
+		blocks += 4 * N_BLOCK;
+		ctx += 4;
+	}
+	for (; n_block > 0; --n_block)
+	{
+		lora_aes_hw_encrypt(blocks, blocks, *ctx);
+		blocks += N_BLOCK;
+		ctx++;
+	}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,63 @@
+/*!
+ * \file      aes_hw.h
+ *
+ * \brief     AES block encryption with the CPU crypto instructions (AES-NI)
+ *
+ * \remark    Only available on host builds, see AES_HW_ACCEL in aes.h. The
+ *            functions take the regular lora_aes_context, the round keys of
+ *            the byte key schedule are used as is.
+ */
+#ifndef AES_HW_H
+#define AES_HW_H
+
+#include "aes.h"
+
+#if defined(AES_HW_ACCEL)
+
+/*!
+ * Checks if the CPU supports the AES-NI instructions
+ *
+ * \retval [1: supported, 0: not supported]
+ */
+int lora_aes_hw_available(void);
+
+/*!
+ * Encrypts a single block with the CPU AES instructions
+ *
+ * \remark Must only be called if lora_aes_hw_available returned 1 and with
+ *         an initialized key schedule
+ *
+ * \param   in              - Plain text block
+ * \param   out             - Cipher text block, may be the same as in
+ * \param   ctx             - Key schedule from lora_aes_set_key
+ */
+void lora_aes_hw_encrypt(const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const lora_aes_context ctx[1]);
+
+/*!
+ * Encrypts independent blocks with the CPU AES instructions. Four blocks are
+ * run interleaved, so the latency of the AES instructions is hidden.
+ *
+ * \remark Same restrictions as lora_aes_hw_encrypt
+ *
+ * \param   in              - Plain text blocks
+ * \param   out             - Cipher text blocks, may be the same as in
+ * \param   n_block         - Number of blocks
+ * \param   ctx             - Key schedule from lora_aes_set_key
+ */
+void lora_aes_hw_ecb_encrypt(const uint8_t *in, uint8_t *out, int32_t n_block, const lora_aes_context ctx[1]);
+
+/*!
+ * Encrypts blocks in place, each one with its own key schedule. Four blocks
+ * are run interleaved.
+ *
+ * \remark Same restrictions as lora_aes_hw_encrypt
+ *
+ * \param   blocks          - Blocks to encrypt
+ * \param   n_block         - Number of blocks
+ * \param   ctx             - Key schedule of each block
+ */
+void lora_aes_hw_multi_encrypt(uint8_t *blocks, int32_t n_block, const lora_aes_context *const ctx[]);
+
+#endif
+
+#endif
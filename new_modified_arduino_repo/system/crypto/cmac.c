@@ -65,12 +65,46 @@ void AES_CMAC_Init(AES_CMAC_CTX *ctx)
 	memset1(ctx->X, 0, sizeof ctx->X);
 	ctx->M_n = 0;
 	memset1(ctx->rijndael.ksch, '\0', 240);
+	memset1(ctx->K1, 0, sizeof ctx->K1);
+	memset1(ctx->K2, 0, sizeof ctx->K2);
 }
 
 void AES_CMAC_SetKey(AES_CMAC_CTX *ctx, const uint8_t key[AES_CMAC_KEY_LENGTH])
 {
 	//rijndael_set_key_enc_only(&ctx->rijndael, key, 128);
 	lora_aes_set_key(key, AES_CMAC_KEY_LENGTH, &ctx->rijndael);
+
+	/* generate subkey K1 */
+	memset1(ctx->K1, '\0', 16);
+	lora_aes_encrypt(ctx->K1, ctx->K1, &ctx->rijndael);
+	if (ctx->K1[0] & 0x80)
+	{
+		LSHIFT(ctx->K1, ctx->K1);
+		ctx->K1[15] ^= 0x87;
+	}
+	else
+		LSHIFT(ctx->K1, ctx->K1);
+
+	/* generate subkey K2 */
+	if (ctx->K1[0] & 0x80)
+	{
+		LSHIFT(ctx->K1, ctx->K2);
+		ctx->K2[15] ^= 0x87;
+	}
+	else
+		LSHIFT(ctx->K1, ctx->K2);
+}
+
+void AES_CMAC_Reset(AES_CMAC_CTX *ctx)
+{
+	memset1(ctx->X, 0, sizeof ctx->X);
+	ctx->M_n = 0;
+}
+
+void AES_CMAC_Restore(AES_CMAC_CTX *ctx, const uint8_t X[16])
+{
+	memcpy1(ctx->X, X, sizeof ctx->X);
+	ctx->M_n = 0;
 }
 
 void AES_CMAC_Update(AES_CMAC_CTX *ctx, const uint8_t *data, uint32_t len)
@@ -111,45 +145,21 @@ void AES_CMAC_Update(AES_CMAC_CTX *ctx, const uint8_t *data, uint32_t len)
 
 void AES_CMAC_Final(uint8_t digest[AES_CMAC_DIGEST_LENGTH], AES_CMAC_CTX *ctx)
 {
-	uint8_t K[16];
 	uint8_t in[16];
-	/* generate subkey K1 */
-	memset1(K, '\0', 16);
-
-	//rijndael_encrypt(&ctx->rijndael, K, K);
-
-	lora_aes_encrypt(K, K, &ctx->rijndael);
-
-	if (K[0] & 0x80)
-	{
-		LSHIFT(K, K);
-		K[15] ^= 0x87;
-	}
-	else
-		LSHIFT(K, K);
 
 	if (ctx->M_n == 16)
 	{
 		/* last block was a complete block */
-		XOR(K, ctx->M_last);
+		XOR(ctx->K1, ctx->M_last);
 	}
 	else
 	{
-		/* generate subkey K2 */
-		if (K[0] & 0x80)
-		{
-			LSHIFT(K, K);
-			K[15] ^= 0x87;
-		}
-		else
-			LSHIFT(K, K);
-
 		/* padding(M_last) */
 		ctx->M_last[ctx->M_n] = 0x80;
 		while (++ctx->M_n < 16)
 			ctx->M_last[ctx->M_n] = 0;
 
-		XOR(K, ctx->M_last);
+		XOR(ctx->K2, ctx->M_last);
 	}
 	XOR(ctx->M_last, ctx->X);
 
@@ -157,5 +167,4 @@ void AES_CMAC_Final(uint8_t digest[AES_CMAC_DIGEST_LENGTH], AES_CMAC_CTX *ctx)
 
 	memcpy1(in, &ctx->X[0], 16); //Bestela ez du ondo iten
 	lora_aes_encrypt(in, digest, &ctx->rijndael);
-	memset1(K, 0, sizeof K);
 }
@@ -44,6 +44,8 @@ DEALINGS WITH THE SOFTWARE
 typedef struct _AES_CMAC_CTX
 {
 	lora_aes_context rijndael;
+	uint8_t K1[16];
+	uint8_t K2[16];
 	uint8_t X[16];
 	uint8_t M_last[16];
 	uint32_t M_n;
@@ -54,6 +56,11 @@ typedef struct _AES_CMAC_CTX
 //__BEGIN_DECLS
 void AES_CMAC_Init(AES_CMAC_CTX *ctx);
 void AES_CMAC_SetKey(AES_CMAC_CTX *ctx, const uint8_t key[AES_CMAC_KEY_LENGTH]);
+/* Restarts the MAC computation, keeping the key schedule and the subkeys */
+void AES_CMAC_Reset(AES_CMAC_CTX *ctx);
+/* Restarts the MAC computation from the chaining value X reached after
+   absorbing whole blocks, at least one more byte must follow */
+void AES_CMAC_Restore(AES_CMAC_CTX *ctx, const uint8_t X[16]);
 void AES_CMAC_Update(AES_CMAC_CTX *ctx, const uint8_t *data, uint32_t len);
 //          __attribute__((__bounded__(__string__,2,3)));
 void AES_CMAC_Final(uint8_t digest[AES_CMAC_DIGEST_LENGTH], AES_CMAC_CTX *ctx);
@@ -0,0 +1,298 @@
+/*!
+ * \file      timer_wheel.c
+ *
+ * \brief     Hierarchical timer wheel
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ */
+#include <stddef.h>
+
+#include "timer_wheel.h"
+
+#if (TIMER_WHEEL_SLOT_BITS > 6) || (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS >= 64)
+#error "Unsupported timer wheel geometry"
+#endif
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/*!
+ * Level of the nodes in the overflow list
+ */
+#define LEVEL_OVERFLOW TIMER_WHEEL_LEVELS
+
+/*!
+ * Number of low bits of the time covered by the levels
+ */
+#define WHEEL_BITS (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)
+
+/*!
+ * \brief Returns the index of the lowest set bit of a non zero value
+ */
+static uint8_t LowestBit(uint64_t value)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(value);
+#else
+	uint8_t bit = 0;
+
+	while ((value & 1) == 0)
+	{
+		value >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/*!
+ * \brief Returns the index of the highest set bit of a non zero value
+ */
+static uint8_t HighestBit(uint64_t value)
+{
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(value);
+#else
+	uint8_t bit = 0;
+
+	while ((value >>= 1) != 0)
+	{
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/*!
+ * \brief Returns the digit of a time at a level
+ */
+static uint8_t Digit(TimerWheelTime_t time, uint8_t level)
+{
+	return (time >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK;
+}
+
+static void Link(TimerWheelNode_t **head, TimerWheelNode_t *node)
+{
+	node->Next = *head;
+	if (*head != NULL)
+	{
+		(*head)->Prev = &node->Next;
+	}
+	*head = node;
+	node->Prev = head;
+}
+
+static void Unlink(TimerWheel_t *wheel, TimerWheelNode_t *node)
+{
+	*node->Prev = node->Next;
+	if (node->Next != NULL)
+	{
+		node->Next->Prev = node->Prev;
+	}
+	node->Prev = NULL;
+	if ((node->Level != LEVEL_OVERFLOW) && (wheel->Slots[node->Level][node->Slot] == NULL))
+	{
+		wheel->Occupied[node->Level] &= ~((uint64_t)1 << node->Slot);
+	}
+}
+
+/*!
+ * \brief Queues a node at the level of the highest digit in which its expiry
+ *        differs from the current time
+ */
+static void Place(TimerWheel_t *wheel, TimerWheelNode_t *node)
+{
+	TimerWheelTime_t diff = node->Expiry ^ wheel->Now;
+	uint8_t level = (diff <= SLOT_MASK) ? 0 : HighestBit(diff) / TIMER_WHEEL_SLOT_BITS;
+
+	if (level >= TIMER_WHEEL_LEVELS)
+	{
+		node->Level = LEVEL_OVERFLOW;
+		Link(&wheel->Overflow, node);
+		return;
+	}
+	node->Level = level;
+	node->Slot = Digit(node->Expiry, level);
+	Link(&wheel->Slots[level][node->Slot], node);
+	wheel->Occupied[level] |= (uint64_t)1 << node->Slot;
+}
+
+/*!
+ * \brief Places the nodes of a list again
+ */
+static void Redistribute(TimerWheel_t *wheel, TimerWheelNode_t **head)
+{
+	TimerWheelNode_t *node = *head;
+
+	*head = NULL;
+	while (node != NULL)
+	{
+		TimerWheelNode_t *next = node->Next;
+
+		node->Prev = NULL;
+		Place(wheel, node);
+		node = next;
+	}
+}
+
+/*!
+ * \brief Advances the current time. No timer may expire before the new time.
+ *
+ * \param  wheel Wheel
+ * \param  now New current time
+ */
+static void Advance(TimerWheel_t *wheel, TimerWheelTime_t now)
+{
+	TimerWheelTime_t previous = wheel->Now;
+
+	wheel->Now = now;
+	if ((wheel->Overflow != NULL) && ((previous >> WHEEL_BITS) != (now >> WHEEL_BITS)))
+	{
+		Redistribute(wheel, &wheel->Overflow);
+	}
+	// The slot of the new time at each level now belongs to the lower levels
+	for (uint8_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+	{
+		uint8_t slot = Digit(now, level);
+
+		if ((wheel->Occupied[level] & ((uint64_t)1 << slot)) != 0)
+		{
+			wheel->Occupied[level] &= ~((uint64_t)1 << slot);
+			Redistribute(wheel, &wheel->Slots[level][slot]);
+		}
+	}
+}
+
+static TimerWheelTime_t MinExpiry(const TimerWheelNode_t *node)
+{
+	TimerWheelTime_t expiry = node->Expiry;
+
+	for (node = node->Next; node != NULL; node = node->Next)
+	{
+		if (node->Expiry < expiry)
+		{
+			expiry = node->Expiry;
+		}
+	}
+	return expiry;
+}
+
+void TimerWheelInit(TimerWheel_t *wheel, TimerWheelTime_t now)
+{
+	wheel->Now = now;
+	wheel->NextSeq = 0;
+	wheel->Count = 0;
+	wheel->Overflow = NULL;
+	for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		wheel->Occupied[level] = 0;
+		for (uint8_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+		{
+			wheel->Slots[level][slot] = NULL;
+		}
+	}
+}
+
+void TimerWheelInsert(TimerWheel_t *wheel, TimerWheelNode_t *node, TimerWheelTime_t expiry)
+{
+	node->Expiry = (expiry < wheel->Now) ? wheel->Now : expiry;
+	node->Seq = wheel->NextSeq++;
+	Place(wheel, node);
+	wheel->Count++;
+}
+
+void TimerWheelRemove(TimerWheel_t *wheel, TimerWheelNode_t *node)
+{
+	Unlink(wheel, node);
+	wheel->Count--;
+}
+
+bool TimerWheelIsQueued(const TimerWheelNode_t *node)
+{
+	return node->Prev != NULL;
+}
+
+bool TimerWheelNextExpiry(const TimerWheel_t *wheel, TimerWheelTime_t *expiry)
+{
+	if (wheel->Count == 0)
+	{
+		return false;
+	}
+	if (wheel->Occupied[0] != 0)
+	{
+		*expiry = (wheel->Now & ~(TimerWheelTime_t)SLOT_MASK) | LowestBit(wheel->Occupied[0]);
+		return true;
+	}
+	for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		if (wheel->Occupied[level] != 0)
+		{
+			*expiry = MinExpiry(wheel->Slots[level][LowestBit(wheel->Occupied[level])]);
+			return true;
+		}
+	}
+	*expiry = MinExpiry(wheel->Overflow);
+	return true;
+}
+
+TimerWheelNode_t *TimerWheelExpire(TimerWheel_t *wheel, TimerWheelTime_t now)
+{
+	while (wheel->Count > 0)
+	{
+		TimerWheelTime_t start;
+		uint8_t level;
+
+		if (wheel->Occupied[0] != 0)
+		{
+			uint8_t slot = LowestBit(wheel->Occupied[0]);
+			TimerWheelNode_t *node = wheel->Slots[0][slot];
+
+			start = (wheel->Now & ~(TimerWheelTime_t)SLOT_MASK) | slot;
+			if (start > now)
+			{
+				break;
+			}
+			// The nodes of a level 0 slot share their expiry, the first
+			// inserted one expires first
+			for (TimerWheelNode_t *other = node->Next; other != NULL; other = other->Next)
+			{
+				if ((int32_t)(other->Seq - node->Seq) < 0)
+				{
+					node = other;
+				}
+			}
+			wheel->Now = start;
+			TimerWheelRemove(wheel, node);
+			return node;
+		}
+
+		// Move to the start of the next non-empty slot, which cascades it
+		for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+		{
+			if (wheel->Occupied[level] != 0)
+			{
+				break;
+			}
+		}
+		if (level < TIMER_WHEEL_LEVELS)
+		{
+			uint8_t shift = (level + 1) * TIMER_WHEEL_SLOT_BITS;
+
+			start = ((wheel->Now >> shift) << shift) | ((TimerWheelTime_t)LowestBit(wheel->Occupied[level]) << (level * TIMER_WHEEL_SLOT_BITS));
+		}
+		else
+		{
+			start = MinExpiry(wheel->Overflow);
+		}
+		if (start > now)
+		{
+			break;
+		}
+		Advance(wheel, start);
+	}
+
+	if (now > wheel->Now)
+	{
+		Advance(wheel, now);
+	}
+	return NULL;
+}
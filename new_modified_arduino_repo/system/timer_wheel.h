@@ -0,0 +1,157 @@
+/*!
+ * \file      timer_wheel.h
+ *
+ * \brief     Hierarchical timer wheel
+ *
+ * \copyright Revised BSD License, see file LICENSE.
+ *
+ * \remark    Keeps any number of timers with O(1) insertion and removal,
+ *            meant as the backend of the TimerEvent_t API when many timers
+ *            run at once (multi-instance simulation, device emulation).
+ *
+ *            The wheel has TIMER_WHEEL_LEVELS levels of 2^TIMER_WHEEL_SLOT_BITS
+ *            slots. A timer is placed at the level of the highest digit in
+ *            which its expiry differs from the current time of the wheel,
+ *            in the slot given by that digit of its expiry. Timers of lower
+ *            levels therefore always expire before the ones of higher
+ *            levels, and a slot is only redistributed to the lower levels
+ *            when the current time reaches it. Each level keeps a bitmap of
+ *            its non-empty slots, so the next deadline is found without
+ *            stepping through empty ticks (tickless operation).
+ *
+ *            Timers with the same expiry expire in the order they were
+ *            inserted.
+ */
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Number of bits of the slot index, at most 6
+ */
+#ifndef TIMER_WHEEL_SLOT_BITS
+#define TIMER_WHEEL_SLOT_BITS 6
+#endif
+
+/*!
+ * Number of levels. Timers further away than
+ * 2^(TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS) ticks are kept in an
+ * unsorted overflow list.
+ */
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 6
+#endif
+
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+/*!
+ * Wheel time [ticks]
+ */
+typedef uint64_t TimerWheelTime_t;
+
+/*!
+ * Timer node, embedded in the timer object of the user
+ */
+typedef struct sTimerWheelNode
+{
+	struct sTimerWheelNode *Next;
+	/*!
+	 * Link pointing to this node, NULL when the node is not queued
+	 */
+	struct sTimerWheelNode **Prev;
+	TimerWheelTime_t Expiry;
+	/*!
+	 * Insertion order
+	 */
+	uint32_t Seq;
+	uint8_t Level;
+	uint8_t Slot;
+} TimerWheelNode_t;
+
+/*!
+ * Timer wheel
+ */
+typedef struct sTimerWheel
+{
+	/*!
+	 * Current time
+	 */
+	TimerWheelTime_t Now;
+	uint32_t NextSeq;
+	uint32_t Count;
+	/*!
+	 * Non-empty slots of each level
+	 */
+	uint64_t Occupied[TIMER_WHEEL_LEVELS];
+	TimerWheelNode_t *Slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	TimerWheelNode_t *Overflow;
+} TimerWheel_t;
+
+/*!
+ * \brief Initializes an empty wheel
+ *
+ * \param   wheel           - Wheel
+ * \param   now             - Current time
+ */
+void TimerWheelInit(TimerWheel_t *wheel, TimerWheelTime_t now);
+
+/*!
+ * \brief Queues a timer. An expiry in the past is taken as the current time.
+ *
+ * \param   wheel           - Wheel
+ * \param   node            - Timer, must not be queued
+ * \param   expiry          - Expiry time
+ */
+void TimerWheelInsert(TimerWheel_t *wheel, TimerWheelNode_t *node, TimerWheelTime_t expiry);
+
+/*!
+ * \brief Removes a queued timer
+ *
+ * \param   wheel           - Wheel
+ * \param   node            - Timer, must be queued
+ */
+void TimerWheelRemove(TimerWheel_t *wheel, TimerWheelNode_t *node);
+
+/*!
+ * \brief Returns true if the timer is queued
+ *
+ * \param   node            - Timer
+ */
+bool TimerWheelIsQueued(const TimerWheelNode_t *node);
+
+/*!
+ * \brief Returns the expiry of the next timer, for a tickless idle
+ *
+ * \param   wheel           - Wheel
+ * \param   expiry          - Expiry of the next timer
+ * \retval  false if the wheel is empty
+ */
+bool TimerWheelNextExpiry(const TimerWheel_t *wheel, TimerWheelTime_t *expiry);
+
+/*!
+ * \brief Removes and returns the next timer which expires at or before a
+ *        given time and advances the current time to its expiry. Advances
+ *        the current time to the given time when there is none.
+ *
+ *        The caller calls the callback of the returned timer, which may
+ *        insert and remove timers, and calls the function again until it
+ *        returns NULL.
+ *
+ * \param   wheel           - Wheel
+ * \param   now             - Time to advance to, not before the current time
+ * \retval  Expired timer, NULL if there is none
+ */
+TimerWheelNode_t *TimerWheelExpire(TimerWheel_t *wheel, TimerWheelTime_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TIMER_WHEEL_H__
@@ -26,7 +26,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 // Standard random functions redefinition start
 #define RAND_LOCAL_MAX 2147483647L
 
-static uint32_t next = 1;
+static LORAMAC_THREAD_LOCAL uint32_t next = 1;
 
 int32_t rand1(void)
 {
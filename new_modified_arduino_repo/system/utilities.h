@@ -28,6 +28,16 @@ Maintainer: Miguel Luis and Gregory Cristian
  */
 #define POW2(n) (1 << n)
 
+/*!
+ * Storage class of the state shared by all MAC instances of a thread (the
+ * active instance, the region tables, the random generator). A host running
+ * MAC instances in several threads defines it to a thread local storage
+ * class, e.g. _Thread_local.
+ */
+#ifndef LORAMAC_THREAD_LOCAL
+#define LORAMAC_THREAD_LOCAL
+#endif
+
 /*!
  * \brief Initializes the pseudo random generator initial value
  *